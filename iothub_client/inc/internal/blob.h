@@ -36,6 +36,12 @@ extern "C"
 #define MAX_BLOCK_COUNT 50000
 #endif
 
+/* Maximum size of a block, per server*/
+#define MAX_BLOCK_SIZE (100*1024*1024)
+
+/* Maximum count of blocks uploaded at the same time, each one buffered in memory (up to the block size) and over its own connection */
+#define MAX_CONCURRENT_BLOCKS 16
+
 #define BLOB_RESULT_VALUES \
     BLOB_OK,               \
     BLOB_ERROR,            \
@@ -46,6 +52,9 @@ extern "C"
 
 MU_DEFINE_ENUM_WITHOUT_INVALID(BLOB_RESULT, BLOB_RESULT_VALUES)
 
+/* Invoked on the calling thread each time a block, or a round of concurrent blocks, is uploaded, with the count of blocks uploaded in order */
+typedef void(*BLOB_UPLOAD_PROGRESS_CALLBACK)(unsigned int uploadedBlockCount, void* context);
+
 /**
 * @brief  Synchronously uploads a byte array to blob storage
 *
@@ -56,10 +65,27 @@ MU_DEFINE_ENUM_WITHOUT_INVALID(BLOB_RESULT, BLOB_RESULT_VALUES)
 * @param  httpResponse      A BUFFER_HANDLE that receives the HTTP response from the server (available only when the return value is BLOB_OK)
 * @param  certificates      A null terminated string containing CA certificates to be used
 * @param    proxyOptions    A structure that contains optional web proxy information
+* @param  concurrentBlocks  The count of blocks uploaded at the same time, up to MAX_CONCURRENT_BLOCKS. 0 and 1 upload the blocks one at a time.
+* @param  uploadedBlockCount Optional. On input, the count of blocks already uploaded to the blob by a previous attempt, which are
+*                            read from getDataCallbackEx but not uploaded again. On output, the count of blocks uploaded in order.
+* @param  uploadProgressCallback Optional. Invoked with the count of blocks uploaded in order after each block, or round of blocks, is uploaded.
+* @param  uploadProgressContext  Passed to uploadProgressCallback.
 *
 * @return    A @c BLOB_RESULT. BLOB_OK means the blob has been uploaded successfully. Any other value indicates an error
 */
-MOCKABLE_FUNCTION(, BLOB_RESULT, Blob_UploadMultipleBlocksFromSasUri, const char*, SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX, getDataCallbackEx, void*, context, unsigned int*, httpStatus, BUFFER_HANDLE, httpResponse, const char*, certificates, HTTP_PROXY_OPTIONS*, proxyOptions)
+MOCKABLE_FUNCTION(, BLOB_RESULT, Blob_UploadMultipleBlocksFromSasUri, const char*, SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX, getDataCallbackEx, void*, context, unsigned int*, httpStatus, BUFFER_HANDLE, httpResponse, const char*, certificates, HTTP_PROXY_OPTIONS*, proxyOptions, size_t, concurrentBlocks, unsigned int*, uploadedBlockCount, BLOB_UPLOAD_PROGRESS_CALLBACK, uploadProgressCallback, void*, uploadProgressContext)
+
+/**
+* @brief  Synchronously gets the count of blocks uploaded to a blob and not committed yet
+*
+* @param  SASURI            The URI of the blob
+* @param  certificates      A null terminated string containing CA certificates to be used
+* @param  proxyOptions      A structure that contains optional web proxy information
+* @param  blockCount        A pointer to an out argument receiving the count of consecutive blocks, from block id 0, uploaded and not committed
+*
+* @return    A @c BLOB_RESULT. BLOB_OK means blockCount is set, 0 if the blob has no block list. Any other value indicates an error
+*/
+MOCKABLE_FUNCTION(, BLOB_RESULT, Blob_GetUncommittedBlockCount, const char*, SASURI, const char*, certificates, HTTP_PROXY_OPTIONS*, proxyOptions, unsigned int*, blockCount)
 
 /**
 * @brief  Synchronously uploads a byte array as a new block to blob storage
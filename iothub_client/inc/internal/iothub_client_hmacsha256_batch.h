@@ -0,0 +1,46 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file   iothub_client_hmacsha256_batch.h
+*    @brief  Computes several HMAC-SHA256 signatures at once, one message per SIMD lane.
+*/
+
+#ifndef IOTHUB_CLIENT_HMACSHA256_BATCH_H
+#define IOTHUB_CLIENT_HMACSHA256_BATCH_H
+
+#include "umock_c/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C" {
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif
+
+#define HMACSHA256_BATCH_HASH_SIZE 32
+
+typedef struct HMACSHA256_BATCH_ITEM_TAG
+{
+    const unsigned char* key;
+    size_t key_length;
+    const unsigned char* payload;
+    size_t payload_length;
+    unsigned char hash[HMACSHA256_BATCH_HASH_SIZE];
+} HMACSHA256_BATCH_ITEM;
+
+    /**
+    * @brief    Fills in the @c hash of every item in @p items.
+    *
+    *           Items are signed in groups of up to eight, one per lane of the SHA-256 compression function (AVX2 when
+    *           the build targets it, plain C otherwise). Keys longer than one SHA-256 block and groups of a single item
+    *           are signed with @c HMACSHA256_ComputeHash instead.
+    *
+    * @return   0 if all the hashes were computed, non-zero otherwise.
+    */
+    MOCKABLE_FUNCTION(, int, HMACSHA256_Batch_ComputeHashes, HMACSHA256_BATCH_ITEM*, items, size_t, item_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_HMACSHA256_BATCH_H */
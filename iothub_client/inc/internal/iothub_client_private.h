@@ -49,6 +49,10 @@ typedef struct IOTHUB_MESSAGE_LIST_TAG
     DLIST_ENTRY entry;
     tickcounter_ms_t ms_timesOutAfter; /* a value of "0" means "no timeout", if the IOTHUBCLIENT_LL's handle tickcounter > msTimesOutAfer then the message shall timeout*/
     tickcounter_ms_t message_timeout_value;
+    uint64_t send_order_tag; /* position of the message in waitingToSend, assigned by IoTHubClientCore_LL_SendEventAsync according to the message priority */
+    tickcounter_ms_t ms_queuedAt; /* when the message was queued, used to measure the time it was held back by the rate limiter */
+    size_t message_size; /* payload size counted in the send queue bytes when the message was queued */
+    bool latency_tracked; /* ms_queuedAt was taken for the latency statistics */
 }IOTHUB_MESSAGE_LIST;
 
 typedef struct IOTHUB_DEVICE_TWIN_TAG
@@ -61,6 +65,8 @@ typedef struct IOTHUB_DEVICE_TWIN_TAG
     DLIST_ENTRY entry;
     IOTHUB_CLIENT_CORE_LL_HANDLE client_handle;
     IOTHUB_DEVICE_HANDLE device_handle;
+    tickcounter_ms_t ms_coalesceUntil; /* a value of "0" means the item is not held back waiting for more reported state to be merged into it */
+    struct IOTHUB_DEVICE_TWIN_TAG* next_merged_report; /* callers whose reported state was merged into this item, completed along with it */
 } IOTHUB_DEVICE_TWIN;
 
 union IOTHUB_IDENTITY_INFO_TAG
@@ -0,0 +1,41 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file   iothub_client_rate_limiter_private.h
+*    @brief  Functions used by IoTHubClient_LL to admit operations through a rate limiter.
+*/
+
+#ifndef IOTHUB_CLIENT_RATE_LIMITER_PRIVATE_H
+#define IOTHUB_CLIENT_RATE_LIMITER_PRIVATE_H
+
+#include "umock_c/umock_c_prod.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "iothub_client_rate_limiter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#else
+#include <stdbool.h>
+#endif
+
+    /**
+    * @brief    Takes a token of @p operationClass, if one is available.
+    *
+    * @param    waitedMs    Time the operation already waited for a token, recorded in the statistics when admitted.
+    *
+    * @return   true if the operation can go out, false if it has to wait.
+    */
+    MOCKABLE_FUNCTION(, bool, IoTHubClient_RateLimiter_TryAcquire, IOTHUB_CLIENT_RATE_LIMITER_HANDLE, rateLimiter, IOTHUB_CLIENT_RATE_LIMIT_CLASS, operationClass, tickcounter_ms_t, waitedMs);
+
+    /**
+    * @brief    Gives back a token taken by @c IoTHubClient_RateLimiter_TryAcquire for an operation that could not go out.
+    *
+    * @param    waitedMs    The value passed to @c IoTHubClient_RateLimiter_TryAcquire, removed from the statistics.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClient_RateLimiter_Refund, IOTHUB_CLIENT_RATE_LIMITER_HANDLE, rateLimiter, IOTHUB_CLIENT_RATE_LIMIT_CLASS, operationClass, tickcounter_ms_t, waitedMs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_RATE_LIMITER_PRIVATE_H */
@@ -0,0 +1,56 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file   iothub_client_trust_bundle.h
+*    @brief  Process wide cache of the trust bundle used by Edge module clients.
+*
+*    @details Every client created from the Edge environment trusts the same certificates, read
+*             from the file in EdgeModuleCACertificateFile or from the HSM. The cache loads them
+*             once and hands the same string to all the clients holding a reference to it.
+*/
+
+#ifndef IOTHUB_CLIENT_TRUST_BUNDLE_H
+#define IOTHUB_CLIENT_TRUST_BUNDLE_H
+
+#include "umock_c/umock_c_prod.h"
+#include "iothub_client_authorization.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+    * @brief    Creates the lock of the cache. Called by @c IoTHub_Init.
+    *
+    * @return   0 upon success, a non-zero value upon failure.
+    */
+    MOCKABLE_FUNCTION(, int, IoTHubClient_TrustBundle_Init);
+
+    /**
+    * @brief    Frees the cache and its lock. Called by @c IoTHub_Deinit, after all the clients are destroyed.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClient_TrustBundle_Deinit);
+
+    /**
+    * @brief    Gets a reference to the trust bundle read from @p certificate_file_name, or from the HSM if NULL.
+    *
+    * @details  The trust bundle is loaded with @c IoTHubClient_Auth_Get_TrustBundle only if the cache does not
+    *           hold it already, or if it was loaded 5 minutes ago or more, so a rotated edge CA is picked up.
+    *           Without @c IoTHub_Init, or for a file other than the cached one, the caller gets its own copy.
+    *
+    * @return   The trust bundle, to be given back with @c IoTHubClient_TrustBundle_Release, or NULL on failure.
+    */
+    MOCKABLE_FUNCTION(, const char*, IoTHubClient_TrustBundle_Acquire, IOTHUB_AUTHORIZATION_HANDLE, authorization_handle, const char*, certificate_file_name);
+
+    /**
+    * @brief    Gives back a reference returned by @c IoTHubClient_TrustBundle_Acquire. The cached trust bundle
+    *           is freed with its last reference.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClient_TrustBundle_Release, const char*, trust_bundle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_TRUST_BUNDLE_H */
@@ -0,0 +1,49 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file   iothub_client_twin_cache_private.h
+*    @brief  Functions used by IoTHubClient_LL to maintain the twin cache.
+*/
+
+#ifndef IOTHUB_CLIENT_TWIN_CACHE_PRIVATE_H
+#define IOTHUB_CLIENT_TWIN_CACHE_PRIVATE_H
+
+#include "azure_macro_utils/macro_utils.h"
+#include "umock_c/umock_c_prod.h"
+#include "iothub_client_core_common.h"
+#include "iothub_client_twin_cache.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C" {
+#else
+#include <stddef.h>
+#endif
+
+#define TWIN_CACHE_UPDATE_RESULT_VALUES     \
+    TWIN_CACHE_UPDATE_CHANGED,              \
+    TWIN_CACHE_UPDATE_UNCHANGED,            \
+    TWIN_CACHE_UPDATE_OUT_OF_SYNC,          \
+    TWIN_CACHE_UPDATE_ERROR
+
+MU_DEFINE_ENUM_WITHOUT_INVALID(TWIN_CACHE_UPDATE_RESULT, TWIN_CACHE_UPDATE_RESULT_VALUES);
+
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_TWIN_CACHE_HANDLE, IoTHubClient_TwinCache_Create);
+    MOCKABLE_FUNCTION(, void, IoTHubClient_TwinCache_Destroy, IOTHUB_CLIENT_TWIN_CACHE_HANDLE, twinCache);
+
+    /**
+    * @brief    Applies a twin payload received from the transport to the cache.
+    *
+    * @return   TWIN_CACHE_UPDATE_CHANGED if the desired properties moved to a newer version,
+    *           TWIN_CACHE_UPDATE_UNCHANGED if the payload carries a version already applied,
+    *           TWIN_CACHE_UPDATE_OUT_OF_SYNC if a partial update was applied but earlier versions
+    *           were missed, so the full twin should be retrieved again, and TWIN_CACHE_UPDATE_ERROR
+    *           if the payload could not be applied.
+    */
+    MOCKABLE_FUNCTION(, TWIN_CACHE_UPDATE_RESULT, IoTHubClient_TwinCache_Update, IOTHUB_CLIENT_TWIN_CACHE_HANDLE, twinCache, DEVICE_TWIN_UPDATE_STATE, update_state, const unsigned char*, payload, size_t, size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_TWIN_CACHE_PRIVATE_H */
@@ -0,0 +1,45 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file   iothub_client_twin_patch.h
+*    @brief  Combines device twin reported property patches, so several patches not yet
+*            sent to the service can go out as a single document.
+*/
+
+#ifndef IOTHUB_CLIENT_TWIN_PATCH_H
+#define IOTHUB_CLIENT_TWIN_PATCH_H
+
+#include "umock_c/umock_c_prod.h"
+#include "azure_c_shared_utility/constbuffer.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C" {
+#else
+#include <stddef.h>
+#endif
+
+/**
+    * @brief    Merges @p next_patch on top of @p patch following JSON merge patch rules: members of
+    *           @p next_patch replace the ones with the same name in @p patch, except when both are
+    *           JSON objects, in which case they are merged recursively. A null member is kept, so it
+    *           still removes the property when the merged patch is applied. Patches where a JSON
+    *           object member replaces a null or non-object member are not merged, since applying
+    *           them one after another replaces the whole member.
+    *
+    * @param    patch            The reported state patch waiting to be sent.
+    *
+    * @param    next_patch       The reported state patch to be merged into @p patch.
+    *
+    * @param    next_patch_size  Number of bytes in @p next_patch.
+    *
+    * @return   A new @c CONSTBUFFER_HANDLE with the merged patch, or NULL if either patch is not
+    *           a JSON object, the patches cannot be merged or any failure occurs.
+    */
+MOCKABLE_FUNCTION(, CONSTBUFFER_HANDLE, IoTHubClient_TwinPatch_Merge, CONSTBUFFER_HANDLE, patch, const unsigned char*, next_patch, size_t, next_patch_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_TWIN_PATCH_H */
@@ -9,6 +9,7 @@
 #include "azure_uamqp_c/cbs.h"
 #include "umock_c/umock_c_prod.h"
 #include "azure_c_shared_utility/optionhandler.h"
+#include "internal/iothubtransport_amqp_cbs_auth_scheduler.h"
 
 static const char* AUTHENTICATION_OPTION_SAVED_OPTIONS = "saved_authentication_options";
 static const char* AUTHENTICATION_OPTION_CBS_REQUEST_TIMEOUT_SECS = "cbs_request_timeout_secs";
@@ -51,6 +52,8 @@ extern "C"
 
         IOTHUB_AUTHORIZATION_HANDLE authorization_module;                   // with either SAS Token, x509 Certs, and Device SAS Token
 
+        AUTHENTICATION_REFRESH_SCHEDULER* refresh_scheduler;                // Optional; not owned by the authentication instance.
+
     } AUTHENTICATION_CONFIG;
 
     typedef struct AUTHENTICATION_INSTANCE* AUTHENTICATION_HANDLE;
@@ -62,6 +65,7 @@ extern "C"
     MOCKABLE_FUNCTION(, void, authentication_destroy, AUTHENTICATION_HANDLE, authentication_handle);
     MOCKABLE_FUNCTION(, int, authentication_set_option, AUTHENTICATION_HANDLE, authentication_handle, const char*, name, void*, value);
     MOCKABLE_FUNCTION(, OPTIONHANDLER_HANDLE, authentication_retrieve_options, AUTHENTICATION_HANDLE, authentication_handle);
+    MOCKABLE_FUNCTION(, void, authentication_sign_pending_sas_tokens, AUTHENTICATION_REFRESH_SCHEDULER*, refresh_scheduler);
 
 #ifdef __cplusplus
 }
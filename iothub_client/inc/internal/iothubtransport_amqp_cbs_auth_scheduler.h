@@ -0,0 +1,35 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUBTRANSPORT_AMQP_CBS_AUTH_SCHEDULER_H
+#define IOTHUBTRANSPORT_AMQP_CBS_AUTH_SCHEDULER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/tickcounter.h"
+#include "iothub_client_options.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    struct AUTHENTICATION_INSTANCE_TAG;
+
+    // Shared by the authentication instances of all devices multiplexed on the same CBS connection.
+    typedef struct AUTHENTICATION_REFRESH_SCHEDULER_TAG
+    {
+        size_t refresh_spread_secs;             // Each device refreshes up to this many seconds early, by a fixed offset derived from its id.
+        size_t max_concurrent_refreshes;        // Maximum SAS token refreshes in progress at a time; 0 (zero) means no limit.
+        size_t refreshes_in_progress;
+        bool batch_sas_token_signing;           // Device key SAS tokens are queued and signed together by authentication_sign_pending_sas_tokens().
+        struct AUTHENTICATION_INSTANCE_TAG* pending_sas_tokens;  // Instances waiting for their SAS token, most recent first.
+        TICK_COUNTER_HANDLE tick_counter;       // Times the refreshes for `metrics`; no latency is recorded if NULL.
+        IOTHUB_SAS_TOKEN_REFRESH_METRICS metrics;
+    } AUTHENTICATION_REFRESH_SCHEDULER;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*IOTHUBTRANSPORT_AMQP_CBS_AUTH_SCHEDULER_H*/
@@ -36,6 +36,11 @@ typedef struct AMQP_CONNECTION_CONFIG_TAG
     const void* on_state_changed_context;
     size_t svc2cl_keep_alive_timeout_secs;
     double cl2svc_keep_alive_send_ratio;
+
+    // Number of AMQP sessions to open on the connection, and their window sizes; 0 (zero) selects the defaults.
+    size_t session_count;
+    uint32_t session_incoming_window;
+    uint32_t session_outgoing_window;
 } AMQP_CONNECTION_CONFIG;
 
 typedef struct AMQP_CONNECTION_INSTANCE* AMQP_CONNECTION_HANDLE;
@@ -44,6 +49,7 @@ MOCKABLE_FUNCTION(, AMQP_CONNECTION_HANDLE, amqp_connection_create, AMQP_CONNECT
 MOCKABLE_FUNCTION(, void, amqp_connection_destroy, AMQP_CONNECTION_HANDLE, conn_handle);
 MOCKABLE_FUNCTION(, void, amqp_connection_do_work, AMQP_CONNECTION_HANDLE, conn_handle);
 MOCKABLE_FUNCTION(, int, amqp_connection_get_session_handle, AMQP_CONNECTION_HANDLE, conn_handle, SESSION_HANDLE*, session_handle);
+MOCKABLE_FUNCTION(, int, amqp_connection_get_shard_session_handle, AMQP_CONNECTION_HANDLE, conn_handle, size_t, shard_key, SESSION_HANDLE*, session_handle);
 MOCKABLE_FUNCTION(, int, amqp_connection_get_cbs_handle, AMQP_CONNECTION_HANDLE, conn_handle, CBS_HANDLE*, cbs_handle);
 MOCKABLE_FUNCTION(, int, amqp_connection_set_logging, AMQP_CONNECTION_HANDLE, conn_handle, bool, is_trace_on);
 
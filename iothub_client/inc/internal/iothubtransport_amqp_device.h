@@ -20,6 +20,8 @@ extern "C"
 // @brief    name of option to apply the instance obtained using amqp_device_retrieve_options
 static const char* DEVICE_OPTION_SAVED_OPTIONS = "saved_device_options";
 static const char* DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS = "event_send_timeout_secs";
+static const char* DEVICE_OPTION_EVENT_SEND_BATCH_LINGER_MS = "event_send_batch_linger_ms";
+static const char* DEVICE_OPTION_EVENT_SEND_BATCH_MIN_BYTES = "event_send_batch_min_bytes";
 static const char* DEVICE_OPTION_CBS_REQUEST_TIMEOUT_SECS = "cbs_request_timeout_secs";
 static const char* DEVICE_OPTION_SAS_TOKEN_REFRESH_TIME_SECS = "sas_token_refresh_time_secs";
 static const char* DEVICE_OPTION_SAS_TOKEN_LIFETIME_SECS = "sas_token_lifetime_secs";
@@ -103,6 +105,9 @@ typedef struct DEVICE_CONFIG_TAG
     // Auth module used to generating handle authorization
     // with either SAS Token, x509 Certs, and Device SAS Token
     IOTHUB_AUTHORIZATION_HANDLE authorization_module;
+
+    // SAS token refresh scheduler shared by the devices of a transport (optional, CBS authentication only).
+    struct AUTHENTICATION_REFRESH_SCHEDULER_TAG* sas_token_refresh_scheduler;
 } AMQP_DEVICE_CONFIG;
 
 typedef struct AMQP_DEVICE_INSTANCE* AMQP_DEVICE_HANDLE;
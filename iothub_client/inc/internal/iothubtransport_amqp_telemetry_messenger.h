@@ -21,6 +21,8 @@ extern "C"
 
 static const char* TELEMETRY_MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS = "telemetry_event_send_timeout_secs";
 static const char* TELEMETRY_MESSENGER_OPTION_SAVED_OPTIONS = "saved_telemetry_messenger_options";
+static const char* TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_MS = "telemetry_event_send_batch_linger_ms";
+static const char* TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_MIN_BYTES = "telemetry_event_send_batch_min_bytes";
 
 typedef struct TELEMETRY_MESSENGER_INSTANCE* TELEMETRY_MESSENGER_HANDLE;
 
@@ -13,9 +13,18 @@ extern "C"
 {
 #endif
 
+    typedef struct MESSAGE_ENCODING_CACHE_INSTANCE_TAG* MESSAGE_ENCODING_CACHE_HANDLE;
+
     MOCKABLE_FUNCTION(, int, message_create_IoTHubMessage_from_uamqp_message, MESSAGE_HANDLE, uamqp_message, IOTHUB_MESSAGE_HANDLE*, iothubclient_message);
     MOCKABLE_FUNCTION(, int, message_create_uamqp_encoding_from_iothub_message, MESSAGE_HANDLE, message_batch_container, IOTHUB_MESSAGE_HANDLE, message_handle, BINARY_DATA*, body_binary_data);
 
+    // The encoding cache keeps the pre-encoded application property keys and the encoding buffer of a device
+    // across messages. The BINARY_DATA returned by message_create_uamqp_encoding_from_iothub_message_with_cache
+    // points into the cache, must not be freed by the caller and is only valid until the next call using the same cache.
+    MOCKABLE_FUNCTION(, MESSAGE_ENCODING_CACHE_HANDLE, message_encoding_cache_create);
+    MOCKABLE_FUNCTION(, void, message_encoding_cache_destroy, MESSAGE_ENCODING_CACHE_HANDLE, encoding_cache);
+    MOCKABLE_FUNCTION(, int, message_create_uamqp_encoding_from_iothub_message_with_cache, MESSAGE_HANDLE, message_batch_container, IOTHUB_MESSAGE_HANDLE, message_handle, MESSAGE_ENCODING_CACHE_HANDLE, encoding_cache, BINARY_DATA*, body_binary_data);
+
 #ifdef __cplusplus
 }
 #endif
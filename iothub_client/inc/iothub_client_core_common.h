@@ -13,8 +13,11 @@
 #include "iothub_message.h"
 
 #ifdef __cplusplus
+#include <cstdint>
 extern "C"
 {
+#else
+#include <stdint.h>
 #endif
 
 #define IOTHUB_CLIENT_FILE_UPLOAD_RESULT_VALUES \
@@ -29,7 +32,8 @@ extern "C"
     IOTHUB_CLIENT_INVALID_ARG,            \
     IOTHUB_CLIENT_ERROR,                  \
     IOTHUB_CLIENT_INVALID_SIZE,           \
-    IOTHUB_CLIENT_INDEFINITE_TIME
+    IOTHUB_CLIENT_INDEFINITE_TIME,        \
+    IOTHUB_CLIENT_QUEUE_FULL
 
     /** @brief Enumeration specifying the status of calls to various APIs in this module.
     */
@@ -65,6 +69,41 @@ extern "C"
     */
     MU_DEFINE_ENUM_WITHOUT_INVALID(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_STATUS_VALUES);
 
+#define IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY_VALUES     \
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_REJECT,               \
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK,                \
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST,          \
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_LOWEST_PRIORITY
+
+    /** @brief Enumeration set with the @c OPTION_SEND_QUEUE_FULL_POLICY option to choose what
+    *           the client does with a new event when the send queue is full.
+    */
+    MU_DEFINE_ENUM_WITHOUT_INVALID(IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY, IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY_VALUES);
+
+    /** @brief Statistics of the client, read with ::IoTHubDeviceClient_LL_GetStatistics.
+    */
+    typedef struct IOTHUB_CLIENT_STATISTICS_TAG
+    {
+        size_t queued_messages;     /* events accepted by SendEventAsync and not completed yet, including the ones handed to the transport */
+        size_t queued_bytes;        /* payload size of the queued events */
+        uint64_t dropped_messages;  /* queued events completed with IOTHUB_CLIENT_CONFIRMATION_ERROR to make room for a new one */
+        uint64_t rejected_messages; /* events SendEventAsync failed with IOTHUB_CLIENT_QUEUE_FULL, or because they are larger than send_queue_max_bytes */
+        size_t in_flight_messages;  /* queued events handed to the transport and not acknowledged yet */
+        size_t in_flight_bytes;     /* payload size of the in flight events */
+        uint64_t acked_messages;    /* events completed with IOTHUB_CLIENT_CONFIRMATION_OK */
+        uint64_t timed_out_messages; /* events completed with IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT */
+        uint64_t failed_messages;   /* events the transport completed with IOTHUB_CLIENT_CONFIRMATION_ERROR */
+        uint64_t reconnects;        /* times the client was authenticated again after losing the connection */
+        uint64_t twin_updates_received; /* full twins and desired properties patches received */
+        uint64_t reported_states_completed; /* reported state updates acknowledged or failed by the service */
+        uint64_t method_invocations; /* device method requests received */
+        uint64_t latency_samples;   /* acknowledged events with a measured latency, 0 unless OPTION_LATENCY_STATISTICS is on */
+        uint64_t latency_p50_ms;    /* SendEventAsync to acknowledgement latency percentiles, in power of two buckets */
+        uint64_t latency_p90_ms;
+        uint64_t latency_p99_ms;
+        uint64_t latency_max_ms;
+    } IOTHUB_CLIENT_STATISTICS;
+
 #define IOTHUB_IDENTITY_TYPE_VALUE  \
     IOTHUB_TYPE_TELEMETRY,          \
     IOTHUB_TYPE_DEVICE_TWIN,        \
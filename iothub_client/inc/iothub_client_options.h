@@ -4,6 +4,8 @@
 #ifndef IOTHUB_CLIENT_OPTIONS_H
 #define IOTHUB_CLIENT_OPTIONS_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include "azure_c_shared_utility/const_defines.h"
 
 #ifdef __cplusplus
@@ -18,6 +20,18 @@ extern "C"
         const char* password;
     } IOTHUB_PROXY_OPTIONS;
 
+    /** @brief Filled in by the AMQP transports when the @c OPTION_SAS_TOKEN_REFRESH_METRICS option is set.
+    */
+    typedef struct IOTHUB_SAS_TOKEN_REFRESH_METRICS_TAG
+    {
+        size_t refresh_count;               /* SAS token refreshes accepted by CBS */
+        size_t refresh_failure_count;       /* SAS token refreshes that failed or timed out */
+        size_t refresh_deferred_count;      /* times a due refresh was postponed because max_concurrent_sas_token_refreshes were in progress */
+        uint64_t last_refresh_latency_ms;   /* time between the put-token request and the CBS response */
+        uint64_t max_refresh_latency_ms;
+        uint64_t total_refresh_latency_ms;
+    } IOTHUB_SAS_TOKEN_REFRESH_METRICS;
+
     static STATIC_VAR_UNUSED const char* OPTION_RETRY_INTERVAL_SEC = "retry_interval_sec";
     static STATIC_VAR_UNUSED const char* OPTION_RETRY_MAX_DELAY_SECS = "retry_max_delay_secs";
 
@@ -33,6 +47,13 @@ extern "C"
 
     static STATIC_VAR_UNUSED const char* OPTION_SAS_TOKEN_LIFETIME = "sas_token_lifetime";
     static STATIC_VAR_UNUSED const char* OPTION_SAS_TOKEN_REFRESH_TIME = "sas_token_refresh_time";
+
+    /*
+    * @brief Caches the SAS tokens created from the device key, so reconnects and token refreshes of the transports do not
+    *        compute a new one each time. A cached token is created again once this percentage of sas_token_lifetime has passed.
+    *        The value is a pointer to a size_t, from 1 to 15. The default value is 0 (zero), tokens are not cached.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_SAS_TOKEN_CACHE_REFRESH_PERCENT = "sas_token_cache_refresh_percent";
     static STATIC_VAR_UNUSED const char* OPTION_CBS_REQUEST_TIMEOUT = "cbs_request_timeout";
 
     static STATIC_VAR_UNUSED const char* OPTION_MIN_POLLING_TIME = "MinimumPollingTime";
@@ -41,8 +62,82 @@ extern "C"
     /* DEPRECATED:: OPTION_MESSAGE_TIMEOUT is DEPRECATED! Use OPTION_SERVICE_SIDE_KEEP_ALIVE_FREQ_SECS for AMQP; MQTT has no option available. OPTION_MESSAGE_TIMEOUT legacy variable will be kept for back-compat.  */
     static STATIC_VAR_UNUSED const char* OPTION_MESSAGE_TIMEOUT = "messageTimeout";
     static STATIC_VAR_UNUSED const char* OPTION_BLOB_UPLOAD_TIMEOUT_SECS = "blob_upload_timeout_secs";
+
+    /*
+    * @brief Count of blocks of a blob uploaded at the same time, each one over its own connection (size_t*).
+    *        Up to this count of blocks are buffered in memory. The default value is 0 (zero), blocks are uploaded one at a time.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_BLOB_UPLOAD_CONCURRENT_BLOCKS = "blob_upload_concurrent_blocks";
+
+    /*
+    * @brief Size in bytes of the blocks a blob is uploaded in (size_t*), from 4MB (the default value) up to 100MB.
+    *        Bigger blocks mean fewer requests for big files; each block being uploaded is buffered in memory.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_BLOB_UPLOAD_BLOCK_SIZE = "blob_upload_block_size";
+
+    /*
+    * @brief Path of the file recording the blob, the source and the count of blocks uploaded by a failed upload (const char*).
+    *        The next upload of the same unmodified file or buffer, with the same block size, resumes after the blocks still held by the blob storage.
+    *        Uploads of data handed out by a callback are not resumed. NULL, the default value, disables it.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_BLOB_UPLOAD_CHECKPOINT_FILE = "blob_upload_checkpoint_file";
     static STATIC_VAR_UNUSED const char* OPTION_PRODUCT_INFO = "product_info";
 
+    /*
+    * @brief Amount of time, in milliseconds, a reported state update waits for further updates to be merged into it (size_t*).
+    *        Reported state patches not yet sent to the service are JSON-merged into a single patch, and the callback of every merged update is invoked when it completes.
+    *        The default value is 0 (zero), which sends each reported state update on its own.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_TWIN_REPORTED_STATE_COALESCE_MS = "twin_reported_state_coalesce_ms";
+
+    /*
+    * @brief Maximum size, in bytes, of a coalesced reported state patch (size_t*). A patch reaching this size is sent right away.
+    *        The default value is 0 (zero), which does not limit the size of coalesced patches.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_TWIN_REPORTED_STATE_COALESCE_MAX_BYTES = "twin_reported_state_coalesce_max_bytes";
+
+    /*
+    * @brief Turns on the local twin cache (bool*). The client keeps the last full twin document, merges desired property updates into it by $version,
+    *        and skips the device twin callback for documents carrying a version it already has. Read it with IoTHubDeviceClient_LL_GetTwinCache.
+    *        The default value is false.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_TWIN_CACHE = "twin_cache";
+
+    /*
+    * @brief Assigns a rate limiter created with IoTHubClient_RateLimiter_Create (IOTHUB_CLIENT_RATE_LIMITER_HANDLE*). Telemetry messages, reported
+    *        state updates and device method responses are held back until the rate limiter has a token of their operation class.
+    *        The same rate limiter can be assigned to several clients. A NULL handle removes the rate limiter. The default is no rate limiter.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_RATE_LIMITER = "rate_limiter";
+
+    /*
+    * @brief Limits the number of events queued by SendEventAsync and not completed yet, including the ones handed to the transport.
+    *        The value is a pointer to a size_t. The default value is 0, which means no limit.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_SEND_QUEUE_MAX_MESSAGES = "send_queue_max_messages";
+
+    /*
+    * @brief Limits the total payload size, in bytes, of the events queued by SendEventAsync and not completed yet.
+    *        The value is a pointer to a size_t. The default value is 0, which means no limit. An event larger than the
+    *        limit can never be queued, SendEventAsync fails it with IOTHUB_CLIENT_INVALID_ARG whatever the policy.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_SEND_QUEUE_MAX_BYTES = "send_queue_max_bytes";
+
+    /*
+    * @brief Chooses what SendEventAsync does with an event that does not fit in the send queue. The value is a pointer to an
+    *        IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY. REJECT (the default) fails the call with IOTHUB_CLIENT_QUEUE_FULL, DROP_OLDEST and
+    *        DROP_LOWEST_PRIORITY complete queued events with IOTHUB_CLIENT_CONFIRMATION_ERROR to make room, and BLOCK makes
+    *        the convenience layer wait until there is room (the LL layer treats it like REJECT). Do not send from a client
+    *        callback with BLOCK, the callbacks run on the thread that makes room.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_SEND_QUEUE_FULL_POLICY = "send_queue_full_policy";
+
+    /*
+    * @brief Measures the time from SendEventAsync to the acknowledgement of each event, reported as percentiles by GetStatistics.
+    *        The value is a pointer to a bool. Off by default, it costs a tick count read per event sent and per batch acknowledged.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_LATENCY_STATISTICS = "latency_statistics";
+
     /*
     * @brief    Turns on automatic URL encoding of message properties + system properties. Only valid for use with MQTT Transport
     */
@@ -76,11 +171,89 @@ extern "C"
     */
     static STATIC_VAR_UNUSED const char* OPTION_EVENT_SEND_TIMEOUT_SECS = "event_send_timeout_secs";
 
+    /*
+    * @brief Maximum amount of time, in milliseconds, the client may hold back telemetry messages so they are sent together in a fuller batch.
+    *        Messages are sent as soon as the oldest one waiting reaches this age, or the ones waiting add up to OPTION_EVENT_SEND_BATCH_MIN_BYTES.
+    *        A message with IOTHUB_MESSAGE_PRIORITY_HIGH releases the batch right away.
+    *        The default value is 0 (zero), which sends whatever is waiting on each DoWork.
+    *        This option is applicable only to AMQP protocol.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_EVENT_SEND_BATCH_LINGER_MS = "event_send_batch_linger_ms";
+
+    /*
+    * @brief Amount of bytes of telemetry messages waiting to be sent that releases a batch before OPTION_EVENT_SEND_BATCH_LINGER_MS expires.
+    *        The default value is 0 (zero), in which case batches are only released by the linger time or the maximum message size of the link.
+    *        This option is applicable only to AMQP protocol.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_EVENT_SEND_BATCH_MIN_BYTES = "event_send_batch_min_bytes";
+
+    /*
+    * @brief Maximum amount of time, in seconds, a multiplexed device with nothing to send can go without being serviced by the transport DoWork.
+    *        Devices with telemetry waiting or in flight, or with pending subscriptions or twin requests, are always serviced.
+    *        Timers of idle devices (e.g. SAS token refresh) are checked at least this often, so keep it well below the token refresh time.
+    *        The default value is 0 (zero), which services every registered device on each DoWork.
+    *        This option is applicable only to AMQP protocol.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_IDLE_DEVICE_DO_WORK_INTERVAL_SECS = "idle_device_do_work_interval_secs";
+
+    /*
+    * @brief Number of AMQP sessions a multiplexed connection spreads its registered devices across (size_t*).
+    *        The default value is 1. Takes effect on the next connection to the IoT Hub.
+    *        This option is applicable only to AMQP protocol.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_AMQP_SESSION_COUNT = "amqp_session_count";
+
+    /*
+    * @brief Incoming and outgoing window sizes, in transfer frames, of the AMQP sessions (size_t*).
+    *        The defaults are UINT32_MAX (incoming) and 100 (outgoing). Take effect on the next connection to the IoT Hub.
+    *        These options are applicable only to AMQP protocol.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_AMQP_SESSION_INCOMING_WINDOW = "amqp_session_incoming_window";
+    static STATIC_VAR_UNUSED const char* OPTION_AMQP_SESSION_OUTGOING_WINDOW = "amqp_session_outgoing_window";
+
+    /*
+    * @brief Window, in seconds, across which the SAS token refreshes of multiplexed devices are spread (size_t*).
+    *        Each device refreshes its token up to this amount of time early, by an offset derived from its id, so devices
+    *        authenticated at the same time do not all refresh at the same time. The default value is 0 (zero), no spreading.
+    *        This option is applicable only to AMQP protocol.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_SAS_TOKEN_REFRESH_SPREAD_SECS = "sas_token_refresh_spread_secs";
+
+    /*
+    * @brief Maximum number of CBS SAS token refreshes of multiplexed devices in progress at a time (size_t*).
+    *        Due refreshes beyond this limit wait for a later DoWork. The default value is 0 (zero), no limit.
+    *        This option is applicable only to AMQP protocol.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_MAX_CONCURRENT_SAS_TOKEN_REFRESHES = "max_concurrent_sas_token_refreshes";
+
+    /*
+    * @brief Sign the device key SAS tokens of multiplexed devices together, once per DoWork (bool*).
+    *        The HMAC-SHA256 signatures of up to eight tokens are computed side by side in one pass. The default value is false.
+    *        This option is applicable only to AMQP protocol.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_SAS_TOKEN_BATCH_SIGNING = "sas_token_batch_signing";
+
+    /*
+    * @brief Reads the SAS token refresh counters and latencies of the multiplexed devices (IOTHUB_SAS_TOKEN_REFRESH_METRICS*).
+    *        Unlike the other options, setting it fills in the structure the value points to; nothing is stored.
+    *        This option is applicable only to AMQP protocol.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_SAS_TOKEN_REFRESH_METRICS = "sas_token_refresh_metrics";
+
     //diagnostic sampling percentage value, [0-100]
     static STATIC_VAR_UNUSED const char* OPTION_DIAGNOSTIC_SAMPLING_PERCENTAGE = "diag_sampling_percentage";
 
     static STATIC_VAR_UNUSED const char* OPTION_DO_WORK_FREQUENCY_IN_MS = "do_work_freq_ms";
 
+    /*
+    * @brief Maximum number of device methods the convenience layer client runs at the same time (size_t*).
+    *        Each method runs on a worker thread owned by the client; invocations of the same method name
+    *        run one after another, in the order they were received. The default value is 0 (zero), all
+    *        device methods run one at a time on the client's callback thread.
+    *        This option is not applicable to the LL layer.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_METHOD_MAX_CONCURRENCY = "method_max_concurrency";
+
 #ifdef __cplusplus
 }
 #endif
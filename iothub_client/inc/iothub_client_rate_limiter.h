@@ -0,0 +1,95 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file   iothub_client_rate_limiter.h
+*    @brief  Client side token bucket rate limiter for IoT Hub operations.
+*
+*    @details IoT Hub throttles devices that go over the operation quotas of the hub's units,
+*             and a throttled or disconnected client loses more throughput in retries than it
+*             would have by pacing itself. A rate limiter holds back telemetry messages, reported
+*             state updates and device method responses until a token of their operation class
+*             is available, so each class stays under its configured rate.
+*
+*             A rate limiter is assigned to a client with the @c OPTION_RATE_LIMITER option. The
+*             same rate limiter can be assigned to several clients, e.g. every device of a
+*             multiplexed transport, which then share the tokens. It must be destroyed after all
+*             the clients it is assigned to.
+*/
+
+#ifndef IOTHUB_CLIENT_RATE_LIMITER_H
+#define IOTHUB_CLIENT_RATE_LIMITER_H
+
+#include "azure_macro_utils/macro_utils.h"
+#include "umock_c/umock_c_prod.h"
+#include "iothub_client_core_common.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C" {
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#define IOTHUB_CLIENT_RATE_LIMIT_CLASS_VALUES       \
+    IOTHUB_CLIENT_RATE_LIMIT_D2C,                   \
+    IOTHUB_CLIENT_RATE_LIMIT_TWIN_UPDATE,           \
+    IOTHUB_CLIENT_RATE_LIMIT_METHOD_RESPONSE
+
+MU_DEFINE_ENUM_WITHOUT_INVALID(IOTHUB_CLIENT_RATE_LIMIT_CLASS, IOTHUB_CLIENT_RATE_LIMIT_CLASS_VALUES);
+
+typedef struct IOTHUB_CLIENT_RATE_LIMITER_TAG* IOTHUB_CLIENT_RATE_LIMITER_HANDLE;
+
+typedef struct IOTHUB_CLIENT_RATE_LIMIT_STATISTICS_TAG
+{
+    size_t available_tokens;    /* tokens left in the bucket, always 0 for a class without limit */
+    uint64_t admitted_count;    /* operations let through */
+    uint64_t delayed_count;     /* operations let through after waiting for a token */
+    uint64_t total_wait_ms;     /* sum of the time the delayed operations waited for a token */
+    uint64_t max_wait_ms;       /* longest time an operation waited for a token */
+} IOTHUB_CLIENT_RATE_LIMIT_STATISTICS;
+
+    /**
+    * @brief    Creates a rate limiter. All operation classes start without limit.
+    *
+    * @return   A handle to the rate limiter, or NULL on failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RATE_LIMITER_HANDLE, IoTHubClient_RateLimiter_Create);
+
+    /**
+    * @brief    Destroys a rate limiter. The clients it was assigned to must be destroyed first.
+    *
+    * @param    rateLimiter     The handle of the rate limiter.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClient_RateLimiter_Destroy, IOTHUB_CLIENT_RATE_LIMITER_HANDLE, rateLimiter);
+
+    /**
+    * @brief    Sets the rate of an operation class.
+    *
+    * @param    rateLimiter             The handle of the rate limiter.
+    * @param    operationClass          The operation class to limit.
+    * @param    operationsPerSecond     Sustained rate allowed for the class, 0 (zero) removes the limit.
+    * @param    burst                   Number of operations that can go out back to back after an idle
+    *                                   period; 0 (zero) allows one second worth of operations.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_RateLimiter_SetLimit, IOTHUB_CLIENT_RATE_LIMITER_HANDLE, rateLimiter, IOTHUB_CLIENT_RATE_LIMIT_CLASS, operationClass, size_t, operationsPerSecond, size_t, burst);
+
+    /**
+    * @brief    Gets the current token level and the wait statistics of an operation class.
+    *
+    * @param    rateLimiter     The handle of the rate limiter.
+    * @param    operationClass  The operation class.
+    * @param    statistics      Receives the statistics of the class.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_RateLimiter_GetStatistics, IOTHUB_CLIENT_RATE_LIMITER_HANDLE, rateLimiter, IOTHUB_CLIENT_RATE_LIMIT_CLASS, operationClass, IOTHUB_CLIENT_RATE_LIMIT_STATISTICS*, statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_RATE_LIMITER_H */
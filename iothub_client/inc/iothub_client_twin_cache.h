@@ -0,0 +1,101 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file   iothub_client_twin_cache.h
+*    @brief  Read access to the device twin document cached by the IoT Hub client.
+*
+*    @details When the @c OPTION_TWIN_CACHE option is enabled, the client keeps the last
+*             full twin document and merges every desired property update into it, based on
+*             the desired properties @c $version. The application can then read properties
+*             from the cache instead of parsing each twin payload itself.
+*
+*             The cache is owned by the client. Values returned by these functions are valid
+*             until the next call to the client's @c _DoWork, so they are best read from the
+*             device twin callback.
+*/
+
+#ifndef IOTHUB_CLIENT_TWIN_CACHE_H
+#define IOTHUB_CLIENT_TWIN_CACHE_H
+
+#include "umock_c/umock_c_prod.h"
+#include "iothub_client_core_common.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C" {
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#endif
+
+typedef struct IOTHUB_CLIENT_TWIN_CACHE_TAG* IOTHUB_CLIENT_TWIN_CACHE_HANDLE;
+
+    /**
+    * @brief    Gets the @c $version of the cached desired properties.
+    *
+    * @param    twinCache   The handle returned by @c IoTHubDeviceClient_LL_GetTwinCache or @c IoTHubModuleClient_LL_GetTwinCache.
+    * @param    version     Receives the desired properties version.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success, IOTHUB_CLIENT_ERROR if no twin document was received yet.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_TwinCache_GetDesiredVersion, IOTHUB_CLIENT_TWIN_CACHE_HANDLE, twinCache, uint32_t*, version);
+
+    /**
+    * @brief    Gets a string property from the cached twin document.
+    *
+    * @param    twinCache   The handle of the twin cache.
+    * @param    path        Dot separated path of the property from the root of the twin document,
+    *                       e.g. "desired.config.mode".
+    *
+    * @return   The property value, or NULL if the property does not exist or is not a string.
+    */
+    MOCKABLE_FUNCTION(, const char*, IoTHubClient_TwinCache_GetString, IOTHUB_CLIENT_TWIN_CACHE_HANDLE, twinCache, const char*, path);
+
+    /**
+    * @brief    Gets a number property from the cached twin document.
+    *
+    * @param    twinCache   The handle of the twin cache.
+    * @param    path        Dot separated path of the property from the root of the twin document.
+    * @param    value       Receives the property value.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success, IOTHUB_CLIENT_ERROR if the property does not exist or is not a number.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_TwinCache_GetNumber, IOTHUB_CLIENT_TWIN_CACHE_HANDLE, twinCache, const char*, path, double*, value);
+
+    /**
+    * @brief    Gets a boolean property from the cached twin document.
+    *
+    * @param    twinCache   The handle of the twin cache.
+    * @param    path        Dot separated path of the property from the root of the twin document.
+    * @param    value       Receives the property value.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success, IOTHUB_CLIENT_ERROR if the property does not exist or is not a boolean.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_TwinCache_GetBool, IOTHUB_CLIENT_TWIN_CACHE_HANDLE, twinCache, const char*, path, bool*, value);
+
+    /**
+    * @brief    Gets how many top level desired properties were added, changed or removed by the last update.
+    *
+    * @param    twinCache   The handle of the twin cache.
+    *
+    * @return   The number of changed desired properties, 0 if @p twinCache is NULL.
+    */
+    MOCKABLE_FUNCTION(, size_t, IoTHubClient_TwinCache_GetChangedCount, IOTHUB_CLIENT_TWIN_CACHE_HANDLE, twinCache);
+
+    /**
+    * @brief    Gets the name of a top level desired property changed by the last update.
+    *
+    * @param    twinCache   The handle of the twin cache.
+    * @param    index       Index of the changed property, lower than @c IoTHubClient_TwinCache_GetChangedCount.
+    *
+    * @return   The property name, or NULL if @p index is out of range.
+    */
+    MOCKABLE_FUNCTION(, const char*, IoTHubClient_TwinCache_GetChangedName, IOTHUB_CLIENT_TWIN_CACHE_HANDLE, twinCache, size_t, index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_TWIN_CACHE_H */
@@ -367,6 +367,23 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_UploadToBlobAsync, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, const char*, destinationFileName, const unsigned char*, source, size_t, size, IOTHUB_CLIENT_FILE_UPLOAD_CALLBACK, iotHubClientFileUploadCallback, void*, context);
 
+    /**
+    * @brief    IoTHubDeviceClient_UploadFileToBlobAsync uploads a local file to a file in Azure Blob Storage.
+    *
+    * @remarks  The file is mapped in memory and uploaded in blocks of the size set by the option
+    *           @c OPTION_BLOB_UPLOAD_BLOCK_SIZE, without being copied in a buffer first. It must not
+    *           be modified until @p iotHubClientFileUploadCallback is invoked.
+    *
+    * @param    iotHubClientHandle                  The handle created by a call to the IoTHubDeviceClient_Create function.
+    * @param    destinationFileName                 The name of the file to be created in Azure Blob Storage.
+    * @param    sourceFilePath                      The path of the local file to upload.
+    * @param    iotHubClientFileUploadCallback      A callback to be invoked when the file upload operation has finished.
+    * @param    context                             A user-provided context to be passed to the file upload callback.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_UploadFileToBlobAsync, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, const char*, destinationFileName, const char*, sourceFilePath, IOTHUB_CLIENT_FILE_UPLOAD_CALLBACK, iotHubClientFileUploadCallback, void*, context);
+
     /**
     * @brief                          Uploads a file to a Blob storage in chunks, fed through the callback function provided by the user.
     * @remarks                        This function allows users to upload large files in chunks, not requiring the whole file content to be passed in memory.
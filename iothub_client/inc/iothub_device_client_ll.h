@@ -146,6 +146,20 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG* IOTHUB_DEVICE_CLIENT_LL_HA
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_LL_GetSendStatus, IOTHUB_DEVICE_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus);
 
+    /**
+    * @brief    This function returns the statistics of the client: the events queued and in flight,
+    *           the events acknowledged, timed out, failed, dropped or rejected because the send queue
+    *           was full (see @c OPTION_SEND_QUEUE_MAX_MESSAGES), the reconnects, the twin and method
+    *           counts and, with @c OPTION_LATENCY_STATISTICS, the send latency percentiles. Unlike
+    *           GetSendStatus it can be polled to adapt the send rate to the backlog.
+    *
+    * @param    iotHubClientHandle        The handle created by a call to the create function.
+    * @param    statistics                Receives the statistics.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_LL_GetStatistics, IOTHUB_DEVICE_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATISTICS*, statistics);
+
     /**
     * @brief    Sets up the message callback to be invoked when IoT Hub issues a
     *           message to the device. This is a blocking call.
@@ -339,6 +353,18 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG* IOTHUB_DEVICE_CLIENT_LL_HA
      */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_LL_GetTwinAsync, IOTHUB_DEVICE_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK, deviceTwinCallback, void*, userContextCallback);
 
+     /**
+     * @brief	This API gets the local twin cache, turned on with the @c OPTION_TWIN_CACHE option.
+     *
+     * @param	iotHubClientHandle		The handle created by a call to the create function.
+     * @param	twinCache	            Receives the twin cache handle, owned by the client. Read it with
+     *                                  the functions in iothub_client_twin_cache.h, from the thread calling
+     *                                  ::IoTHubDeviceClient_LL_DoWork.
+     *
+     * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+     */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_LL_GetTwinCache, IOTHUB_DEVICE_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_TWIN_CACHE_HANDLE*, twinCache);
+
      /**
      * @brief    This API sets the callback for async cloud to device method calls.
      *
@@ -378,6 +404,21 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG* IOTHUB_DEVICE_CLIENT_LL_HA
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_LL_UploadToBlob, IOTHUB_DEVICE_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, destinationFileName, const unsigned char*, source, size_t, size);
 
+    /**
+    * @brief    This API uploads to Azure Storage the content of the file @p sourceFilePath
+    *           under the blob name devicename/@pdestinationFileName
+    *
+    * @remarks  The file is mapped in memory and uploaded in blocks of the size set by the option
+    *           @c OPTION_BLOB_UPLOAD_BLOCK_SIZE, without being copied in a buffer first.
+    *
+    * @param    iotHubClientHandle      The handle created by a call to the create function.
+    * @param    destinationFileName     name of the file.
+    * @param    sourceFilePath          path of the local file to upload.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_LL_UploadFileToBlob, IOTHUB_DEVICE_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, destinationFileName, const char*, sourceFilePath);
+
      /**
      * @brief    This API uploads to Azure Storage the content provided block by block by @p getDataCallback
      *           under the blob name devicename/@pdestinationFileName
@@ -42,6 +42,16 @@ IOTHUBMESSAGE_UNKNOWN \
 */
 MU_DEFINE_ENUM_WITHOUT_INVALID(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_CONTENT_TYPE_VALUES);
 
+#define IOTHUB_MESSAGE_PRIORITY_VALUES \
+IOTHUB_MESSAGE_PRIORITY_LOW, \
+IOTHUB_MESSAGE_PRIORITY_NORMAL, \
+IOTHUB_MESSAGE_PRIORITY_HIGH \
+
+/** @brief Enumeration specifying the lane in which a device-to-cloud message
+*          waits to be sent.
+*/
+MU_DEFINE_ENUM_WITHOUT_INVALID(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_VALUES);
+
 typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG* IOTHUB_MESSAGE_HANDLE;
 
 /** @brief diagnostic related data*/
@@ -387,6 +397,32 @@ MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_SetAsSecurityMessage, I
 */
 MOCKABLE_FUNCTION(, bool, IoTHubMessage_IsSecurityMessage, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
 
+/**
+* @brief   Sets the priority of a device-to-cloud message. Messages default to
+*          @c IOTHUB_MESSAGE_PRIORITY_NORMAL.
+*
+* @param   iotHubMessageHandle Handle to the message.
+* @param   priority            The priority lane of the message.
+*
+* @remarks Messages waiting to be sent are dequeued in weighted order: while all lanes
+*          have messages waiting, a high priority lane sends 4 messages for each normal
+*          priority one, and a normal priority lane 4 messages for each low priority one.
+*          The order of messages within the same lane is preserved.
+*
+* @return  Returns IOTHUB_MESSAGE_OK if the priority was set successfully
+*          or an error code otherwise.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_SetPriority, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, IOTHUB_MESSAGE_PRIORITY, priority);
+
+/**
+* @brief   Gets the priority of a device-to-cloud message.
+*
+* @param   iotHubMessageHandle Handle to the message.
+*
+* @return  The priority of the message, or @c IOTHUB_MESSAGE_PRIORITY_NORMAL if the handle is NULL.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_PRIORITY, IoTHubMessage_GetPriority, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
+
 /**
 * @brief   Frees all resources associated with the given message handle.
 *
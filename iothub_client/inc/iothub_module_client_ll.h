@@ -29,6 +29,7 @@
 
 #include "iothub_transport_ll.h"
 #include "iothub_client_core_common.h"
+#include "iothub_client_twin_cache.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -113,6 +114,20 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_GetSendStatus, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus);
 
+    /**
+    * @brief    This function returns the statistics of the client: the events queued and in flight,
+    *           the events acknowledged, timed out, failed, dropped or rejected because the send queue
+    *           was full (see @c OPTION_SEND_QUEUE_MAX_MESSAGES), the reconnects, the twin and method
+    *           counts and, with @c OPTION_LATENCY_STATISTICS, the send latency percentiles. Unlike
+    *           GetSendStatus it can be polled to adapt the send rate to the backlog.
+    *
+    * @param    iotHubModuleClientHandle  The handle created by a call to the create function.
+    * @param    statistics                Receives the statistics.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_GetStatistics, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_STATISTICS*, statistics);
+
     /**
     * @brief    Sets up the message callback to be invoked when Edge issues a
     *             message to the module. This is a blocking call.
@@ -303,6 +318,18 @@ extern "C"
      */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_GetTwinAsync, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK, deviceTwinCallback, void*, userContextCallback);
 
+     /**
+     * @brief	This API gets the local twin cache, turned on with the @c OPTION_TWIN_CACHE option.
+     *
+     * @param	iotHubModuleClientHandle	The handle created by a call to the create function.
+     * @param	twinCache	                Receives the twin cache handle, owned by the client. Read it with
+     *                                      the functions in iothub_client_twin_cache.h, from the thread calling
+     *                                      ::IoTHubModuleClient_LL_DoWork.
+     *
+     * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+     */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_GetTwinCache, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_TWIN_CACHE_HANDLE*, twinCache);
+
      /**
      * @brief    This API sets callback for async cloud to module method call.
      *
@@ -376,6 +403,9 @@ extern "C"
     * @param    responsePayload                 This pointer will be filled with the response payload
     * @param    responsePayloadSize             This pointer will be filled with the response payload size
     *
+    * @remarks  The call blocks until the device method returns. Consecutive invocations reuse the connection to edgeHub;
+    *           use IoTHubModuleClient_DeviceMethodInvokeAsync to invoke without blocking the calling thread.
+    *
     * @return   IOTHUB_CLIENT_OK upon success, or an error code upon failure.
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_DeviceMethodInvoke, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, const char*, deviceId, const char*, methodName, const char*, methodPayload, unsigned int, timeout, int*, responseStatus, unsigned char**, responsePayload, size_t*, responsePayloadSize);
@@ -393,6 +423,9 @@ extern "C"
     * @param    responsePayload                 This pointer will be filled with the response payload
     * @param    responsePayloadSize             This pointer will be filled with the response payload size
     *
+    * @remarks  The call blocks until the module method returns. Consecutive invocations reuse the connection to edgeHub;
+    *           use IoTHubModuleClient_ModuleMethodInvokeAsync to invoke without blocking the calling thread.
+    *
     * @return   IOTHUB_CLIENT_OK upon success, or an error code upon failure.
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_ModuleMethodInvoke, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, const char*, deviceId, const char*, moduleId, const char*, methodName, const char*, methodPayload, unsigned int, timeout, int*, responseStatus, unsigned char**, responsePayload, size_t*, responsePayloadSize);
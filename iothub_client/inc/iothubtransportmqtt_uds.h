@@ -0,0 +1,26 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUBTRANSPORTMQTT_UDS_H
+#define IOTHUBTRANSPORTMQTT_UDS_H
+
+#include "iothub_transport_ll.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+    * @brief    MQTT over a Unix domain socket to an edgeHub running on the same host, without TLS.
+    *
+    * @details  The socket is given by the IOTEDGE_EDGEHUBURI environment variable, as
+    *           unix://<path of the socket>. The trusted certificates option is ignored.
+    */
+    extern const TRANSPORT_PROVIDER* MQTT_UDS_Protocol(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*IOTHUBTRANSPORTMQTT_UDS_H*/
@@ -3,6 +3,8 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 
 #include "azure_c_shared_utility/gballoc.h"
 #include "internal/blob.h"
@@ -12,6 +14,20 @@
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/azure_base64.h"
 #include "azure_c_shared_utility/shared_util_options.h"
+#include "azure_c_shared_utility/threadapi.h"
+
+typedef struct BLOCK_UPLOAD_SLOT_TAG
+{
+    HTTPAPIEX_HANDLE httpApiExHandle; /*the first slot uses the connection of the Put Block List, the others have one each*/
+    THREAD_HANDLE thread;
+    const char* relativePath;
+    BUFFER_HANDLE requestContent;
+    unsigned int blockID;
+    STRING_HANDLE blockIDList; /*the <Latest> element of this block only, appended in block order to the XML*/
+    unsigned int httpStatus;
+    BUFFER_HANDLE httpResponse;
+    BLOB_RESULT result;
+} BLOCK_UPLOAD_SLOT;
 
 BLOB_RESULT Blob_UploadBlock(
         HTTPAPIEX_HANDLE httpApiExHandle,
@@ -131,257 +147,760 @@ BLOB_RESULT Blob_UploadBlock(
     return result;
 }
 
-BLOB_RESULT Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, HTTP_PROXY_OPTIONS *proxyOptions)
+static HTTPAPIEX_HANDLE create_http_api_handle(const char* hostname, const char* certificates, HTTP_PROXY_OPTIONS* proxyOptions)
+{
+    /*Codes_SRS_BLOB_02_018: [ Blob_UploadMultipleBlocksFromSasUri shall create a new HTTPAPI_EX_HANDLE by calling HTTPAPIEX_Create passing the hostname. ]*/
+    HTTPAPIEX_HANDLE result = HTTPAPIEX_Create(hostname);
+    if (result == NULL)
+    {
+        LogError("unable to create a HTTPAPIEX_HANDLE");
+    }
+    else if ((certificates != NULL) && (HTTPAPIEX_SetOption(result, "TrustedCerts", certificates) == HTTPAPIEX_ERROR))
+    {
+        LogError("failure in setting trusted certificates");
+        HTTPAPIEX_Destroy(result);
+        result = NULL;
+    }
+    else if ((proxyOptions != NULL && proxyOptions->host_address != NULL) && HTTPAPIEX_SetOption(result, OPTION_HTTP_PROXY, proxyOptions) == HTTPAPIEX_ERROR)
+    {
+        LogError("failure in setting proxy options");
+        HTTPAPIEX_Destroy(result);
+        result = NULL;
+    }
+    return result;
+}
+
+/*gets the next block from getDataCallbackEx, *source is set to NULL when there are no more blocks*/
+static BLOB_RESULT get_next_block(IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int blockID, unsigned char const ** source, size_t* size)
+{
+    BLOB_RESULT result;
+
+    if (getDataCallbackEx(FILE_UPLOAD_OK, source, size, context) == IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_ABORT)
+    {
+        /*Codes_SRS_BLOB_99_004: [ If `getDataCallbackEx` returns `IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT_ABORT`, then `Blob_UploadMultipleBlocksFromSasUri` shall exit the loop and return `BLOB_ABORTED`. ]*/
+        LogInfo("Upload to blob has been aborted by the user");
+        result = BLOB_ABORTED;
+    }
+    else if (*source == NULL || *size == 0)
+    {
+        /*Codes_SRS_BLOB_99_002: [ If the size of the block returned by `getDataCallbackEx` is 0 or if the data is NULL, then `Blob_UploadMultipleBlocksFromSasUri` shall exit the loop. ]*/
+        *source = NULL;
+        result = BLOB_OK;
+    }
+    else if (*size > MAX_BLOCK_SIZE)
+    {
+        /*Codes_SRS_BLOB_99_001: [ If the size of the block returned by `getDataCallbackEx` is bigger than `MAX_BLOCK_SIZE` (100MB), then `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
+        LogError("tried to upload block of size %lu, max allowed size is %d", (unsigned long)*size, MAX_BLOCK_SIZE);
+        result = BLOB_INVALID_ARG;
+    }
+    else if (blockID >= MAX_BLOCK_COUNT)
+    {
+        /*Codes_SRS_BLOB_99_003: [ If `getDataCallbackEx` returns more than 50000 blocks, then `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
+        LogError("unable to upload more than %lu blocks in one blob", (unsigned long)MAX_BLOCK_COUNT);
+        result = BLOB_INVALID_ARG;
+    }
+    else
+    {
+        result = BLOB_OK;
+    }
+
+    return result;
+}
+
+static void report_upload_progress(BLOB_UPLOAD_PROGRESS_CALLBACK uploadProgressCallback, void* uploadProgressContext, unsigned int uploadedCount)
+{
+    /*Codes_SRS_BLOB_09_016: [ If `uploadProgressCallback` is not NULL, `Blob_UploadMultipleBlocksFromSasUri` shall call it with `uploadProgressContext` and the count of blocks uploaded in order, the skipped ones included, each time a block, or a round of concurrent blocks, is uploaded. ]*/
+    if (uploadProgressCallback != NULL)
+    {
+        uploadProgressCallback(uploadedCount, uploadProgressContext);
+    }
+}
+
+static BLOB_RESULT upload_blocks_serially(HTTPAPIEX_HANDLE httpApiExHandle, const char* relativePath, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, STRING_HANDLE blockIDList, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, BLOB_UPLOAD_PROGRESS_CALLBACK uploadProgressCallback, void* uploadProgressContext, unsigned int* uploadedCount, unsigned int* isError)
+{
+    BLOB_RESULT result;
+    unsigned int blockID = *uploadedCount; /* incremented for each new block */
+    unsigned int uploadOneMoreBlock = 1; /* set to 1 while getDataCallbackEx returns correct blocks to upload */
+    unsigned char const * source; /* data set by getDataCallbackEx */
+    size_t size; /* source size set by getDataCallbackEx */
+
+    do
+    {
+        result = get_next_block(getDataCallbackEx, context, blockID, &source, &size);
+        if (result != BLOB_OK)
+        {
+            *isError = 1;
+        }
+        else if (source == NULL)
+        {
+            uploadOneMoreBlock = 0;
+        }
+        else
+        {
+            /*Codes_SRS_BLOB_02_023: [ Blob_UploadMultipleBlocksFromSasUri shall create a BUFFER_HANDLE from source and size parameters. ]*/
+            BUFFER_HANDLE requestContent = BUFFER_create(source, size);
+            if (requestContent == NULL)
+            {
+                /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+                LogError("unable to BUFFER_create");
+                result = BLOB_ERROR;
+                *isError = 1;
+            }
+            else
+            {
+                result = Blob_UploadBlock(
+                        httpApiExHandle,
+                        relativePath,
+                        requestContent,
+                        blockID,
+                        blockIDList,
+                        httpStatus,
+                        httpResponse);
+
+                BUFFER_delete(requestContent);
+
+                /*Codes_SRS_BLOB_02_026: [ Otherwise, if HTTP response code is >=300 then Blob_UploadMultipleBlocksFromSasUri shall succeed and return BLOB_OK. ]*/
+                if (result != BLOB_OK || *httpStatus >= 300)
+                {
+                    LogError("unable to Blob_UploadBlock. Returned value=%d, httpStatus=%u", result, (unsigned int)*httpStatus);
+                    *isError = 1;
+                }
+                else
+                {
+                    *uploadedCount = blockID + 1;
+                    report_upload_progress(uploadProgressCallback, uploadProgressContext, *uploadedCount);
+                }
+            }
+            blockID++;
+        }
+    }
+    while (uploadOneMoreBlock && !*isError);
+
+    return result;
+}
+
+static int upload_block_thread(void* arg)
+{
+    BLOCK_UPLOAD_SLOT* slot = (BLOCK_UPLOAD_SLOT*)arg;
+    slot->result = Blob_UploadBlock(slot->httpApiExHandle, slot->relativePath, slot->requestContent, slot->blockID, slot->blockIDList, &slot->httpStatus, slot->httpResponse);
+    return 0;
+}
+
+static void release_slot_block(BLOCK_UPLOAD_SLOT* slot)
+{
+    if (slot->requestContent != NULL)
+    {
+        BUFFER_delete(slot->requestContent);
+        slot->requestContent = NULL;
+    }
+    if (slot->blockIDList != NULL)
+    {
+        STRING_delete(slot->blockIDList);
+        slot->blockIDList = NULL;
+    }
+    if (slot->httpResponse != NULL)
+    {
+        BUFFER_delete(slot->httpResponse);
+        slot->httpResponse = NULL;
+    }
+}
+
+/*uploads rounds of up to concurrentBlocks blocks, one thread and one connection per block of the round. At most concurrentBlocks blocks are buffered.*/
+static BLOB_RESULT upload_blocks_concurrently(const char* hostname, HTTPAPIEX_HANDLE httpApiExHandle, const char* relativePath, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, size_t concurrentBlocks, STRING_HANDLE blockIDList, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, HTTP_PROXY_OPTIONS* proxyOptions, BLOB_UPLOAD_PROGRESS_CALLBACK uploadProgressCallback, void* uploadProgressContext, unsigned int* uploadedCount, unsigned int* isError)
+{
+    BLOB_RESULT result;
+    BLOCK_UPLOAD_SLOT* slots = (BLOCK_UPLOAD_SLOT*)malloc(sizeof(BLOCK_UPLOAD_SLOT) * concurrentBlocks);
+
+    if (slots == NULL)
+    {
+        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+        LogError("unable to allocate the block upload slots");
+        result = BLOB_ERROR;
+        *isError = 1;
+    }
+    else
+    {
+        unsigned int blockID = *uploadedCount;
+        unsigned int uploadOneMoreBlock = 1;
+        unsigned char const * source;
+        size_t size;
+        size_t i;
+
+        (void)memset(slots, 0, sizeof(BLOCK_UPLOAD_SLOT) * concurrentBlocks);
+        slots[0].httpApiExHandle = httpApiExHandle;
+        result = BLOB_OK;
+
+        while (uploadOneMoreBlock && !*isError)
+        {
+            size_t blockCount = 0;
+
+            /*Codes_SRS_BLOB_09_002: [ `Blob_UploadMultipleBlocksFromSasUri` shall get from `getDataCallbackEx` up to `concurrentBlocks` blocks, copied to one BUFFER_HANDLE each, before uploading them. ]*/
+            while (blockCount < concurrentBlocks && uploadOneMoreBlock && !*isError)
+            {
+                BLOCK_UPLOAD_SLOT* slot = &slots[blockCount];
+
+                result = get_next_block(getDataCallbackEx, context, blockID, &source, &size);
+                if (result != BLOB_OK)
+                {
+                    *isError = 1;
+                }
+                else if (source == NULL)
+                {
+                    uploadOneMoreBlock = 0;
+                }
+                /*Codes_SRS_BLOB_09_003: [ Each block after the first of a round shall be uploaded over its own `HTTPAPIEX_HANDLE`, created with the hostname, `certificates` and `proxyOptions` the first time it is needed and kept for the next rounds. ]*/
+                else if (slot->httpApiExHandle == NULL &&
+                    (slot->httpApiExHandle = create_http_api_handle(hostname, certificates, proxyOptions)) == NULL)
+                {
+                    /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+                    result = BLOB_ERROR;
+                    *isError = 1;
+                }
+                else if ((slot->requestContent = BUFFER_create(source, size)) == NULL ||
+                    (slot->blockIDList = STRING_new()) == NULL ||
+                    (slot->httpResponse = BUFFER_new()) == NULL)
+                {
+                    /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+                    LogError("unable to allocate the block %u", blockID);
+                    result = BLOB_ERROR;
+                    *isError = 1;
+                }
+                else
+                {
+                    slot->relativePath = relativePath;
+                    slot->blockID = blockID;
+                    slot->httpStatus = 0;
+                    blockID++;
+                    blockCount++;
+                }
+            }
+
+            if (!*isError && blockCount > 0)
+            {
+                unsigned int roundStartCount = *uploadedCount;
+
+                /*Codes_SRS_BLOB_09_004: [ The blocks of a round shall be uploaded concurrently with `Blob_UploadBlock`, the first one on the calling thread and the others on threads created with `ThreadAPI_Create`. ]*/
+                for (i = 1; i < blockCount; i++)
+                {
+                    if (ThreadAPI_Create(&slots[i].thread, upload_block_thread, &slots[i]) != THREADAPI_OK)
+                    {
+                        /*Codes_SRS_BLOB_09_005: [ If `ThreadAPI_Create` fails, the block shall be uploaded on the calling thread. ]*/
+                        LogError("unable to ThreadAPI_Create, uploading block %u on the calling thread", slots[i].blockID);
+                        slots[i].thread = NULL;
+                        (void)upload_block_thread(&slots[i]);
+                    }
+                }
+
+                (void)upload_block_thread(&slots[0]);
+
+                for (i = 1; i < blockCount; i++)
+                {
+                    if (slots[i].thread != NULL)
+                    {
+                        int threadResult;
+                        if (ThreadAPI_Join(slots[i].thread, &threadResult) != THREADAPI_OK)
+                        {
+                            LogError("unable to ThreadAPI_Join the upload of block %u", slots[i].blockID);
+                            slots[i].result = BLOB_ERROR;
+                        }
+                        slots[i].thread = NULL;
+                    }
+                }
+
+                /*Codes_SRS_BLOB_09_006: [ The block ids of a round shall be appended to the XML in block order, and the first block of the round that failed shall be reported as if the blocks were uploaded one at a time. ]*/
+                for (i = 0; i < blockCount && !*isError; i++)
+                {
+                    *httpStatus = slots[i].httpStatus;
+                    if (slots[i].result != BLOB_OK || slots[i].httpStatus >= 300)
+                    {
+                        LogError("unable to Blob_UploadBlock. Returned value=%d, httpStatus=%u", slots[i].result, slots[i].httpStatus);
+                        result = slots[i].result;
+                        *isError = 1;
+
+                        if (result == BLOB_OK)
+                        {
+                            const unsigned char* response = BUFFER_u_char(slots[i].httpResponse);
+                            size_t responseSize = BUFFER_length(slots[i].httpResponse);
+                            if (BUFFER_build(httpResponse, response, responseSize) != 0)
+                            {
+                                /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+                                LogError("unable to BUFFER_build");
+                                result = BLOB_ERROR;
+                            }
+                        }
+                    }
+                    else if (STRING_concat_with_STRING(blockIDList, slots[i].blockIDList) != 0)
+                    {
+                        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+                        LogError("unable to STRING_concat_with_STRING");
+                        result = BLOB_ERROR;
+                        *isError = 1;
+                    }
+                    else
+                    {
+                        *uploadedCount = slots[i].blockID + 1;
+                    }
+                }
+
+                if (*uploadedCount != roundStartCount)
+                {
+                    report_upload_progress(uploadProgressCallback, uploadProgressContext, *uploadedCount);
+                }
+            }
+
+            for (i = 0; i < concurrentBlocks; i++)
+            {
+                release_slot_block(&slots[i]);
+            }
+        }
+
+        for (i = 1; i < concurrentBlocks; i++)
+        {
+            if (slots[i].httpApiExHandle != NULL)
+            {
+                HTTPAPIEX_Destroy(slots[i].httpApiExHandle);
+            }
+        }
+        free(slots);
+    }
+
+    return result;
+}
+
+static int append_block_id(STRING_HANDLE blockIDList, unsigned int blockID)
+{
+    int result;
+    char temp[7]; /*this will contain 000000... 049999*/
+
+    if (sprintf(temp, "%6u", (unsigned int)blockID) != 6)
+    {
+        LogError("failed to sprintf");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        STRING_HANDLE blockIdString = Azure_Base64_Encode_Bytes((const unsigned char*)temp, 6);
+        if (blockIdString == NULL)
+        {
+            LogError("unable to Azure_Base64_Encode_Bytes");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            if (!(
+                (STRING_concat(blockIDList, "<Latest>") == 0) &&
+                (STRING_concat_with_STRING(blockIDList, blockIdString) == 0) &&
+                (STRING_concat(blockIDList, "</Latest>") == 0)
+                ))
+            {
+                LogError("unable to STRING_concat");
+                result = MU_FAILURE;
+            }
+            else
+            {
+                result = 0;
+            }
+            STRING_delete(blockIdString);
+        }
+    }
+
+    return result;
+}
+
+/*moves getDataCallbackEx past the blocks uploaded by a previous attempt, which are committed with the others by the Put Block List*/
+static BLOB_RESULT skip_uploaded_blocks(IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int blockCount, STRING_HANDLE blockIDList)
+{
+    BLOB_RESULT result = BLOB_OK;
+    unsigned int blockID;
+
+    for (blockID = 0; blockID < blockCount && result == BLOB_OK; blockID++)
+    {
+        unsigned char const * source;
+        size_t size;
+
+        if ((result = get_next_block(getDataCallbackEx, context, blockID, &source, &size)) != BLOB_OK)
+        {
+            LogError("unable to get block %u", blockID);
+        }
+        else if (source == NULL)
+        {
+            /*Codes_SRS_BLOB_09_009: [ If `getDataCallbackEx` returns less blocks than `uploadedBlockCount`, `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
+            LogError("the data ends at block %u, before the %u blocks already uploaded", blockID, blockCount);
+            result = BLOB_INVALID_ARG;
+        }
+        else if (append_block_id(blockIDList, blockID) != 0)
+        {
+            /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+            result = BLOB_ERROR;
+        }
+    }
+
+    return result;
+}
+
+/*splits SASURI in the hostname (a new string, to be freed by the caller) and the relative path of the blob (pointing in SASURI)*/
+static BLOB_RESULT split_sas_uri(const char* SASURI, char** hostname, const char** relativePath)
+{
+    BLOB_RESULT result;
+
+    /*Codes_SRS_BLOB_02_017: [ Blob_UploadMultipleBlocksFromSasUri shall copy from SASURI the hostname to a new const char* ]*/
+    /*to find the hostname, the following logic is applied:*/
+    /*the hostname starts at the first character after "://"*/
+    /*the hostname ends at the first character before the next "/" after "://"*/
+    const char* hostnameBegin = strstr(SASURI, "://");
+    if (hostnameBegin == NULL)
+    {
+        /*Codes_SRS_BLOB_02_005: [ If the hostname cannot be determined, then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
+        LogError("hostname cannot be determined");
+        result = BLOB_INVALID_ARG;
+    }
+    else
+    {
+        hostnameBegin += 3; /*have to skip 3 characters which are "://"*/
+        const char* hostnameEnd = strchr(hostnameBegin, '/');
+        if (hostnameEnd == NULL)
+        {
+            /*Codes_SRS_BLOB_02_005: [ If the hostname cannot be determined, then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
+            LogError("hostname cannot be determined");
+            result = BLOB_INVALID_ARG;
+        }
+        else
+        {
+            size_t hostnameSize = hostnameEnd - hostnameBegin;
+            *hostname = (char*)malloc(hostnameSize + 1); /*+1 because of '\0' at the end*/
+            if (*hostname == NULL)
+            {
+                /*Codes_SRS_BLOB_02_016: [ If the hostname copy cannot be made then then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+                LogError("oom - out of memory");
+                result = BLOB_ERROR;
+            }
+            else
+            {
+                (void)memcpy(*hostname, hostnameBegin, hostnameSize);
+                (*hostname)[hostnameSize] = '\0';
+
+                /*Codes_SRS_BLOB_02_019: [ Blob_UploadMultipleBlocksFromSasUri shall compute the base relative path of the request from the SASURI parameter. ]*/
+                *relativePath = hostnameEnd; /*this is where the relative path begins in the SasUri*/
+                result = BLOB_OK;
+            }
+        }
+    }
+
+    return result;
+}
+
+BLOB_RESULT Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, HTTP_PROXY_OPTIONS *proxyOptions, size_t concurrentBlocks, unsigned int* uploadedBlockCount, BLOB_UPLOAD_PROGRESS_CALLBACK uploadProgressCallback, void* uploadProgressContext)
 {
     BLOB_RESULT result;
+    char* hostname;
+    const char* relativePath;
+
     /*Codes_SRS_BLOB_02_001: [ If SASURI is NULL then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
     if (SASURI == NULL)
     {
         LogError("parameter SASURI is NULL");
         result = BLOB_INVALID_ARG;
     }
+    /*Codes_SRS_BLOB_02_002: [ If getDataCallbackEx is NULL then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
+    else if (getDataCallbackEx == NULL)
+    {
+        LogError("IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx is NULL");
+        result = BLOB_INVALID_ARG;
+    }
+    /*Codes_SRS_BLOB_09_001: [ If `concurrentBlocks` is bigger than `MAX_CONCURRENT_BLOCKS` then `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
+    else if (concurrentBlocks > MAX_CONCURRENT_BLOCKS)
+    {
+        LogError("unable to upload more than %d blocks concurrently (concurrentBlocks=%lu)", MAX_CONCURRENT_BLOCKS, (unsigned long)concurrentBlocks);
+        result = BLOB_INVALID_ARG;
+    }
+    else if ((result = split_sas_uri(SASURI, &hostname, &relativePath)) != BLOB_OK)
+    {
+        LogError("unable to determine the hostname and relative path of the SAS URI");
+    }
     else
     {
-        /*Codes_SRS_BLOB_02_002: [ If getDataCallbackEx is NULL then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
-        if (getDataCallbackEx == NULL)
+        HTTPAPIEX_HANDLE httpApiExHandle;
+
+        /*Codes_SRS_BLOB_02_037: [ If certificates is non-NULL then Blob_UploadMultipleBlocksFromSasUri shall pass certificates to HTTPAPI_EX_HANDLE by calling HTTPAPIEX_SetOption with the option name "TrustedCerts". ]*/
+        httpApiExHandle = create_http_api_handle(hostname, certificates, proxyOptions);
+        if (httpApiExHandle == NULL)
         {
-            LogError("IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx is NULL");
-            result = BLOB_INVALID_ARG;
+            /*Codes_SRS_BLOB_02_007: [ If HTTPAPIEX_Create fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR. ]*/
+            /*Codes_SRS_BLOB_02_038: [ If HTTPAPIEX_SetOption fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR. ]*/
+            result = BLOB_ERROR;
         }
-        /*the below define avoid a "condition always false" on some compilers*/
         else
         {
-            /*Codes_SRS_BLOB_02_017: [ Blob_UploadMultipleBlocksFromSasUri shall copy from SASURI the hostname to a new const char* ]*/
-            /*to find the hostname, the following logic is applied:*/
-            /*the hostname starts at the first character after "://"*/
-            /*the hostname ends at the first character before the next "/" after "://"*/
-            const char* hostnameBegin = strstr(SASURI, "://");
-            if (hostnameBegin == NULL)
+            /*Codes_SRS_BLOB_02_028: [ Blob_UploadMultipleBlocksFromSasUri shall construct an XML string with the following content: ]*/
+            STRING_HANDLE blockIDList = STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>"); /*the XML "build as we go"*/
+            if (blockIDList == NULL)
             {
-                /*Codes_SRS_BLOB_02_005: [ If the hostname cannot be determined, then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
-                LogError("hostname cannot be determined");
-                result = BLOB_INVALID_ARG;
+                /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+                LogError("failed to STRING_construct");
+                result = BLOB_HTTP_ERROR;
             }
             else
             {
-                hostnameBegin += 3; /*have to skip 3 characters which are "://"*/
-                const char* hostnameEnd = strchr(hostnameBegin, '/');
-                if (hostnameEnd == NULL)
+                unsigned int isError = 0; /* set to 1 if a block upload fails or if getDataCallbackEx returns incorrect blocks to upload */
+                unsigned int blockCount = (uploadedBlockCount == NULL) ? 0 : *uploadedBlockCount; /* blocks uploaded in order, the next block ID */
+
+                /*Codes_SRS_BLOB_09_007: [ If `uploadedBlockCount` points to a value bigger than 0, `Blob_UploadMultipleBlocksFromSasUri` shall get that many blocks from `getDataCallbackEx` without uploading them and add their block ids to the XML. ]*/
+                if (blockCount > 0 && (result = skip_uploaded_blocks(getDataCallbackEx, context, blockCount, blockIDList)) != BLOB_OK)
+                {
+                    LogError("unable to skip the %u blocks already uploaded", blockCount);
+                    blockCount = 0;
+                    isError = 1;
+                }
+                /*Codes_SRS_BLOB_02_021: [ For every block returned by `getDataCallbackEx` the following operations shall happen: ]*/
+                else if (concurrentBlocks > 1)
                 {
-                    /*Codes_SRS_BLOB_02_005: [ If the hostname cannot be determined, then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
-                    LogError("hostname cannot be determined");
-                    result = BLOB_INVALID_ARG;
+                    result = upload_blocks_concurrently(hostname, httpApiExHandle, relativePath, getDataCallbackEx, context, concurrentBlocks, blockIDList, httpStatus, httpResponse, certificates, proxyOptions, uploadProgressCallback, uploadProgressContext, &blockCount, &isError);
                 }
                 else
                 {
-                    size_t hostnameSize = hostnameEnd - hostnameBegin;
-                    char* hostname = (char*)malloc(hostnameSize + 1); /*+1 because of '\0' at the end*/
-                    if (hostname == NULL)
+                    result = upload_blocks_serially(httpApiExHandle, relativePath, getDataCallbackEx, context, blockIDList, httpStatus, httpResponse, uploadProgressCallback, uploadProgressContext, &blockCount, &isError);
+                }
+
+                /*Codes_SRS_BLOB_09_008: [ If `uploadedBlockCount` is not NULL, `Blob_UploadMultipleBlocksFromSasUri` shall set it to the count of blocks uploaded in order, the skipped ones included. ]*/
+                if (uploadedBlockCount != NULL)
+                {
+                    *uploadedBlockCount = blockCount;
+                }
+
+                if (isError || result != BLOB_OK)
+                {
+                    /*do nothing, it will be reported "as is"*/
+                }
+                else
+                {
+                    /*complete the XML*/
+                    if (STRING_concat(blockIDList, "</BlockList>") != 0)
                     {
-                        /*Codes_SRS_BLOB_02_016: [ If the hostname copy cannot be made then then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
-                        LogError("oom - out of memory");
+                        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+                        LogError("failed to STRING_concat");
                         result = BLOB_ERROR;
                     }
                     else
                     {
-                        HTTPAPIEX_HANDLE httpApiExHandle;
-                        (void)memcpy(hostname, hostnameBegin, hostnameSize);
-                        hostname[hostnameSize] = '\0';
-
-                        /*Codes_SRS_BLOB_02_018: [ Blob_UploadMultipleBlocksFromSasUri shall create a new HTTPAPI_EX_HANDLE by calling HTTPAPIEX_Create passing the hostname. ]*/
-                        httpApiExHandle = HTTPAPIEX_Create(hostname);
-                        if (httpApiExHandle == NULL)
+                        /*Codes_SRS_BLOB_02_029: [Blob_UploadMultipleBlocksFromSasUri shall construct a new relativePath from following string : base relativePath + "&comp=blocklist"]*/
+                        STRING_HANDLE newRelativePath = STRING_construct(relativePath);
+                        if (newRelativePath == NULL)
                         {
-                            /*Codes_SRS_BLOB_02_007: [ If HTTPAPIEX_Create fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR. ]*/
-                            LogError("unable to create a HTTPAPIEX_HANDLE");
+                            /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+                            LogError("failed to STRING_construct");
                             result = BLOB_ERROR;
                         }
                         else
                         {
-                            if ((certificates != NULL)&& (HTTPAPIEX_SetOption(httpApiExHandle, "TrustedCerts", certificates) == HTTPAPIEX_ERROR))
-                            {
-                                LogError("failure in setting trusted certificates");
-                                result = BLOB_ERROR;
-                            }
-                            else if ((proxyOptions != NULL && proxyOptions->host_address != NULL) && HTTPAPIEX_SetOption(httpApiExHandle, OPTION_HTTP_PROXY, proxyOptions) == HTTPAPIEX_ERROR)
+                            if (STRING_concat(newRelativePath, "&comp=blocklist") != 0)
                             {
-                                LogError("failure in setting proxy options");
+                                /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+                                LogError("failed to STRING_concat");
                                 result = BLOB_ERROR;
                             }
                             else
                             {
-                                /*Codes_SRS_BLOB_02_019: [ Blob_UploadMultipleBlocksFromSasUri shall compute the base relative path of the request from the SASURI parameter. ]*/
-                                const char* relativePath = hostnameEnd; /*this is where the relative path begins in the SasUri*/
-
-                                /*Codes_SRS_BLOB_02_028: [ Blob_UploadMultipleBlocksFromSasUri shall construct an XML string with the following content: ]*/
-                                STRING_HANDLE blockIDList = STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>"); /*the XML "build as we go"*/
-                                if (blockIDList == NULL)
+                                /*Codes_SRS_BLOB_02_030: [ Blob_UploadMultipleBlocksFromSasUri shall call HTTPAPIEX_ExecuteRequest with a PUT operation, passing the new relativePath, httpStatus and httpResponse and the XML string as content. ]*/
+                                const char* s = STRING_c_str(blockIDList);
+                                BUFFER_HANDLE blockIDListAsBuffer = BUFFER_create((const unsigned char*)s, strlen(s));
+                                if (blockIDListAsBuffer == NULL)
                                 {
                                     /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
-                                    LogError("failed to STRING_construct");
-                                    result = BLOB_HTTP_ERROR;
+                                    LogError("failed to BUFFER_create");
+                                    result = BLOB_ERROR;
                                 }
                                 else
                                 {
-                                    /*Codes_SRS_BLOB_02_021: [ For every block returned by `getDataCallbackEx` the following operations shall happen: ]*/
-                                    unsigned int blockID = 0; /* incremented for each new block */
-                                    unsigned int isError = 0; /* set to 1 if a block upload fails or if getDataCallbackEx returns incorrect blocks to upload */
-                                    unsigned int uploadOneMoreBlock = 1; /* set to 1 while getDataCallbackEx returns correct blocks to upload */
-                                    unsigned char const * source; /* data set by getDataCallbackEx */
-                                    size_t size; /* source size set by getDataCallbackEx */
-                                    IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT getDataReturnValue;
-
-                                    do
-                                    {
-                                        getDataReturnValue = getDataCallbackEx(FILE_UPLOAD_OK, &source, &size, context);
-                                        if (getDataReturnValue == IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_ABORT)
-                                        {
-                                            /*Codes_SRS_BLOB_99_004: [ If `getDataCallbackEx` returns `IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT_ABORT`, then `Blob_UploadMultipleBlocksFromSasUri` shall exit the loop and return `BLOB_ABORTED`. ]*/
-                                            LogInfo("Upload to blob has been aborted by the user");
-                                            uploadOneMoreBlock = 0;
-                                            result = BLOB_ABORTED;
-                                        }
-                                        else if (source == NULL || size == 0)
-                                        {
-                                            /*Codes_SRS_BLOB_99_002: [ If the size of the block returned by `getDataCallbackEx` is 0 or if the data is NULL, then `Blob_UploadMultipleBlocksFromSasUri` shall exit the loop. ]*/
-                                            uploadOneMoreBlock = 0;
-                                            result = BLOB_OK;
-                                        }
-                                        else
-                                        {
-                                            if (size > BLOCK_SIZE)
-                                            {
-                                                /*Codes_SRS_BLOB_99_001: [ If the size of the block returned by `getDataCallbackEx` is bigger than 4MB, then `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
-                                                LogError("tried to upload block of size %lu, max allowed size is %d", (unsigned long)size, BLOCK_SIZE);
-                                                result = BLOB_INVALID_ARG;
-                                                isError = 1;
-                                            }
-                                            else if (blockID >= MAX_BLOCK_COUNT)
-                                            {
-                                                /*Codes_SRS_BLOB_99_003: [ If `getDataCallbackEx` returns more than 50000 blocks, then `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
-                                                LogError("unable to upload more than %lu blocks in one blob", (unsigned long)MAX_BLOCK_COUNT);
-                                                result = BLOB_INVALID_ARG;
-                                                isError = 1;
-                                            }
-                                            else
-                                            {
-                                                /*Codes_SRS_BLOB_02_023: [ Blob_UploadMultipleBlocksFromSasUri shall create a BUFFER_HANDLE from source and size parameters. ]*/
-                                                BUFFER_HANDLE requestContent = BUFFER_create(source, size);
-                                                if (requestContent == NULL)
-                                                {
-                                                    /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                    LogError("unable to BUFFER_create");
-                                                    result = BLOB_ERROR;
-                                                    isError = 1;
-                                                }
-                                                else
-                                                {
-                                                    result = Blob_UploadBlock(
-                                                            httpApiExHandle,
-                                                            relativePath,
-                                                            requestContent,
-                                                            blockID,
-                                                            blockIDList,
-                                                            httpStatus,
-                                                            httpResponse);
-
-                                                    BUFFER_delete(requestContent);
-                                                }
-
-                                                /*Codes_SRS_BLOB_02_026: [ Otherwise, if HTTP response code is >=300 then Blob_UploadMultipleBlocksFromSasUri shall succeed and return BLOB_OK. ]*/
-                                                if (result != BLOB_OK || *httpStatus >= 300)
-                                                {
-                                                    LogError("unable to Blob_UploadBlock. Returned value=%d, httpStatus=%u", result, (unsigned int)*httpStatus);
-                                                    isError = 1;
-                                                }
-                                            }
-                                            blockID++;
-                                        }
-                                    }
-                                    while(uploadOneMoreBlock && !isError);
-
-                                    if (isError || result != BLOB_OK)
+                                    if (HTTPAPIEX_ExecuteRequest(
+                                        httpApiExHandle,
+                                        HTTPAPI_REQUEST_PUT,
+                                        STRING_c_str(newRelativePath),
+                                        NULL,
+                                        blockIDListAsBuffer,
+                                        httpStatus,
+                                        NULL,
+                                        httpResponse
+                                    ) != HTTPAPIEX_OK)
                                     {
-                                        /*do nothing, it will be reported "as is"*/
+                                        /*Codes_SRS_BLOB_02_031: [ If HTTPAPIEX_ExecuteRequest fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
+                                        LogError("unable to HTTPAPIEX_ExecuteRequest");
+                                        result = BLOB_HTTP_ERROR;
                                     }
                                     else
                                     {
-                                        /*complete the XML*/
-                                        if (STRING_concat(blockIDList, "</BlockList>") != 0)
-                                        {
-                                            /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
-                                            LogError("failed to STRING_concat");
-                                            result = BLOB_ERROR;
-                                        }
-                                        else
-                                        {
-                                            /*Codes_SRS_BLOB_02_029: [Blob_UploadMultipleBlocksFromSasUri shall construct a new relativePath from following string : base relativePath + "&comp=blocklist"]*/
-                                            STRING_HANDLE newRelativePath = STRING_construct(relativePath);
-                                            if (newRelativePath == NULL)
-                                            {
-                                                /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                LogError("failed to STRING_construct");
-                                                result = BLOB_ERROR;
-                                            }
-                                            else
-                                            {
-                                                if (STRING_concat(newRelativePath, "&comp=blocklist") != 0)
-                                                {
-                                                    /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                    LogError("failed to STRING_concat");
-                                                    result = BLOB_ERROR;
-                                                }
-                                                else
-                                                {
-                                                    /*Codes_SRS_BLOB_02_030: [ Blob_UploadMultipleBlocksFromSasUri shall call HTTPAPIEX_ExecuteRequest with a PUT operation, passing the new relativePath, httpStatus and httpResponse and the XML string as content. ]*/
-                                                    const char* s = STRING_c_str(blockIDList);
-                                                    BUFFER_HANDLE blockIDListAsBuffer = BUFFER_create((const unsigned char*)s, strlen(s));
-                                                    if (blockIDListAsBuffer == NULL)
-                                                    {
-                                                        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                        LogError("failed to BUFFER_create");
-                                                        result = BLOB_ERROR;
-                                                    }
-                                                    else
-                                                    {
-                                                        if (HTTPAPIEX_ExecuteRequest(
-                                                            httpApiExHandle,
-                                                            HTTPAPI_REQUEST_PUT,
-                                                            STRING_c_str(newRelativePath),
-                                                            NULL,
-                                                            blockIDListAsBuffer,
-                                                            httpStatus,
-                                                            NULL,
-                                                            httpResponse
-                                                        ) != HTTPAPIEX_OK)
-                                                        {
-                                                            /*Codes_SRS_BLOB_02_031: [ If HTTPAPIEX_ExecuteRequest fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
-                                                            LogError("unable to HTTPAPIEX_ExecuteRequest");
-                                                            result = BLOB_HTTP_ERROR;
-                                                        }
-                                                        else
-                                                        {
-                                                            /*Codes_SRS_BLOB_02_032: [ Otherwise, Blob_UploadMultipleBlocksFromSasUri shall succeed and return BLOB_OK. ]*/
-                                                            result = BLOB_OK;
-                                                        }
-                                                        BUFFER_delete(blockIDListAsBuffer);
-                                                    }
-                                                }
-                                                STRING_delete(newRelativePath);
-                                            }
-                                        }
+                                        /*Codes_SRS_BLOB_02_032: [ Otherwise, Blob_UploadMultipleBlocksFromSasUri shall succeed and return BLOB_OK. ]*/
+                                        result = BLOB_OK;
                                     }
-                                    STRING_delete(blockIDList);
+                                    BUFFER_delete(blockIDListAsBuffer);
                                 }
-
                             }
-                            HTTPAPIEX_Destroy(httpApiExHandle);
+                            STRING_delete(newRelativePath);
                         }
-                        free(hostname);
                     }
                 }
+                STRING_delete(blockIDList);
             }
+            HTTPAPIEX_Destroy(httpApiExHandle);
         }
+        free(hostname);
     }
     return result;
 }
+
+/*marks in blockUploaded the block ids of the <Name> elements of the Get Block List response*/
+static BLOB_RESULT mark_listed_blocks(const char* blockList, bool* blockUploaded)
+{
+    BLOB_RESULT result = BLOB_OK;
+    const char* name = blockList;
+
+    while (result == BLOB_OK && (name = strstr(name, "<Name>")) != NULL)
+    {
+        const char* nameEnd;
+
+        name += 6; /*skip "<Name>"*/
+        if ((nameEnd = strstr(name, "</Name>")) == NULL)
+        {
+            LogError("malformed block list");
+            result = BLOB_ERROR;
+        }
+        else
+        {
+            /*block ids of this client are 6 characters, 8 once base64 encoded. Others were not uploaded by this client.*/
+            if (nameEnd - name == 8)
+            {
+                char encodedBlockID[9];
+                BUFFER_HANDLE blockIdBuffer;
+
+                (void)memcpy(encodedBlockID, name, 8);
+                encodedBlockID[8] = '\0';
+
+                if ((blockIdBuffer = Azure_Base64_Decode(encodedBlockID)) == NULL)
+                {
+                    LogError("unable to Azure_Base64_Decode block id %s", encodedBlockID);
+                    result = BLOB_ERROR;
+                }
+                else
+                {
+                    if (BUFFER_length(blockIdBuffer) == 6)
+                    {
+                        char temp[7];
+                        unsigned long blockID;
+
+                        (void)memcpy(temp, BUFFER_u_char(blockIdBuffer), 6);
+                        temp[6] = '\0';
+                        blockID = strtoul(temp, NULL, 10);
+
+                        if (blockID < MAX_BLOCK_COUNT)
+                        {
+                            blockUploaded[blockID] = true;
+                        }
+                    }
+                    BUFFER_delete(blockIdBuffer);
+                }
+            }
+            name = nameEnd;
+        }
+    }
+
+    return result;
+}
+
+BLOB_RESULT Blob_GetUncommittedBlockCount(const char* SASURI, const char* certificates, HTTP_PROXY_OPTIONS* proxyOptions, unsigned int* blockCount)
+{
+    BLOB_RESULT result;
+    char* hostname;
+    const char* relativePath;
+
+    /*Codes_SRS_BLOB_09_010: [ If `SASURI` or `blockCount` are NULL then `Blob_GetUncommittedBlockCount` shall fail and return `BLOB_INVALID_ARG`. ]*/
+    if (SASURI == NULL || blockCount == NULL)
+    {
+        LogError("invalid argument detected SASURI=%p blockCount=%p", SASURI, blockCount);
+        result = BLOB_INVALID_ARG;
+    }
+    else if ((result = split_sas_uri(SASURI, &hostname, &relativePath)) != BLOB_OK)
+    {
+        LogError("unable to determine the hostname and relative path of the SAS URI");
+    }
+    else
+    {
+        HTTPAPIEX_HANDLE httpApiExHandle;
+        STRING_HANDLE blockListRelativePath = NULL;
+        BUFFER_HANDLE httpResponse = NULL;
+        bool* blockUploaded = NULL;
+        unsigned int httpStatus;
+
+        *blockCount = 0;
+
+        if ((httpApiExHandle = create_http_api_handle(hostname, certificates, proxyOptions)) == NULL)
+        {
+            result = BLOB_ERROR;
+        }
+        /*Codes_SRS_BLOB_09_011: [ `Blob_GetUncommittedBlockCount` shall call `HTTPAPIEX_ExecuteRequest` with a GET operation on the base relative path + "&comp=blocklist&blocklisttype=uncommitted". ]*/
+        else if ((blockListRelativePath = STRING_construct(relativePath)) == NULL ||
+            STRING_concat(blockListRelativePath, "&comp=blocklist&blocklisttype=uncommitted") != 0 ||
+            (httpResponse = BUFFER_new()) == NULL)
+        {
+            /*Codes_SRS_BLOB_09_015: [ If any other operation fails, `Blob_GetUncommittedBlockCount` shall fail and return `BLOB_ERROR`. ]*/
+            LogError("unable to build the Get Block List request");
+            result = BLOB_ERROR;
+        }
+        else if (HTTPAPIEX_ExecuteRequest(httpApiExHandle, HTTPAPI_REQUEST_GET, STRING_c_str(blockListRelativePath), NULL, NULL, &httpStatus, NULL, httpResponse) != HTTPAPIEX_OK)
+        {
+            /*Codes_SRS_BLOB_09_012: [ If `HTTPAPIEX_ExecuteRequest` fails then `Blob_GetUncommittedBlockCount` shall fail and return `BLOB_HTTP_ERROR`. ]*/
+            LogError("unable to HTTPAPIEX_ExecuteRequest");
+            result = BLOB_HTTP_ERROR;
+        }
+        else if (httpStatus >= 300)
+        {
+            /*Codes_SRS_BLOB_09_013: [ If the HTTP response code is >=300 then `Blob_GetUncommittedBlockCount` shall set `blockCount` to 0 and return `BLOB_OK`. ]*/
+            LogInfo("no block list for the blob (HTTP status %u)", httpStatus);
+            result = BLOB_OK;
+        }
+        else
+        {
+            size_t responseSize = BUFFER_length(httpResponse);
+            char* blockList = (char*)malloc(responseSize + 1);
+
+            if (blockList == NULL ||
+                (blockUploaded = (bool*)malloc(sizeof(bool) * MAX_BLOCK_COUNT)) == NULL)
+            {
+                /*Codes_SRS_BLOB_09_015: [ If any other operation fails, `Blob_GetUncommittedBlockCount` shall fail and return `BLOB_ERROR`. ]*/
+                LogError("unable to allocate the block list");
+                result = BLOB_ERROR;
+            }
+            else
+            {
+                (void)memcpy(blockList, BUFFER_u_char(httpResponse), responseSize);
+                blockList[responseSize] = '\0';
+                (void)memset(blockUploaded, 0, sizeof(bool) * MAX_BLOCK_COUNT);
+
+                /*Codes_SRS_BLOB_09_014: [ `Blob_GetUncommittedBlockCount` shall decode the block ids of the response and set `blockCount` to the count of consecutive block ids listed starting at 0. ]*/
+                if ((result = mark_listed_blocks(blockList, blockUploaded)) == BLOB_OK)
+                {
+                    while (*blockCount < MAX_BLOCK_COUNT && blockUploaded[*blockCount])
+                    {
+                        (*blockCount)++;
+                    }
+                }
+            }
+            free(blockList);
+        }
+
+        free(blockUploaded);
+        if (httpResponse != NULL)
+        {
+            BUFFER_delete(httpResponse);
+        }
+        if (blockListRelativePath != NULL)
+        {
+            STRING_delete(blockListRelativePath);
+        }
+        if (httpApiExHandle != NULL)
+        {
+            HTTPAPIEX_Destroy(httpApiExHandle);
+        }
+        free(hostname);
+    }
+
+    return result;
+}
@@ -8,6 +8,10 @@
 #include "azure_macro_utils/macro_utils.h"
 #include "iothub.h"
 
+#ifdef USE_EDGE_MODULES
+#include "internal/iothub_client_trust_bundle.h"
+#endif
+
 int IoTHub_Init(void)
 {
     int result;
@@ -16,6 +20,14 @@ int IoTHub_Init(void)
         LogError("Platform initialization failed");
         result = MU_FAILURE;
     }
+#ifdef USE_EDGE_MODULES
+    else if (IoTHubClient_TrustBundle_Init() != 0)
+    {
+        LogError("Trust bundle cache initialization failed");
+        platform_deinit();
+        result = MU_FAILURE;
+    }
+#endif
     else
     {
         result = 0;
@@ -25,5 +37,8 @@ int IoTHub_Init(void)
 
 void IoTHub_Deinit(void)
 {
+#ifdef USE_EDGE_MODULES
+    IoTHubClient_TrustBundle_Deinit();
+#endif
     platform_deinit();
 }
@@ -13,16 +13,34 @@
 #include "azure_c_shared_utility/shared_util_options.h"
 #include "azure_c_shared_utility/azure_base64.h"
 #include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/urlencode.h"
+#include "azure_c_shared_utility/lock.h"
 
 #ifdef USE_PROV_MODULE
 #include "azure_prov_client/internal/iothub_auth_client.h"
 #endif
 
 #include "internal/iothub_client_authorization.h"
+#include "internal/iothub_client_hmacsha256_batch.h"
 
 #define DEFAULT_SAS_TOKEN_EXPIRY_TIME_SECS          3600
 #define INDEFINITE_TIME                             ((time_t)(-1))
 #define MIN_SAS_EXPIRY_TIME                         5  // 5 seconds
+#define SAS_TOKEN_CACHE_SIZE                        4
+// The transports refresh their token at 80% of its lifetime from the moment they get it,
+// so a cached token handed out must have well over 80% of its lifetime left.
+#define MAX_SAS_TOKEN_CACHE_REFRESH_PERCENT         15
+#define SAS_TOKEN_FORMAT                            "SharedAccessSignature sr=%s&sig=%s&se=%s%s%s"
+#define SAS_TOKEN_KEY_NAME_FIELD                    "&skn="
+#define SAS_TOKEN_EXPIRY_MAX_LENGTH                 21
+
+typedef struct SAS_TOKEN_CACHE_ENTRY_TAG
+{
+    char* scope;
+    char* key_name;
+    char* sas_token;
+    size_t created_at_sec;
+} SAS_TOKEN_CACHE_ENTRY;
 
 typedef struct IOTHUB_AUTHORIZATION_DATA_TAG
 {
@@ -31,12 +49,25 @@ typedef struct IOTHUB_AUTHORIZATION_DATA_TAG
     char* device_id;
     char* module_id;
     size_t token_expiry_time_sec;
+    size_t token_cache_refresh_percent; // 0 means SAS tokens are not cached
+    SAS_TOKEN_CACHE_ENTRY token_cache[SAS_TOKEN_CACHE_SIZE];
+    // Guards the token cache, its lifetime and refresh percent; the handle is shared by the transport, upload to blob and method invoke threads
+    LOCK_HANDLE token_cache_lock;
     IOTHUB_CREDENTIAL_TYPE cred_type;
 #ifdef USE_PROV_MODULE
     IOTHUB_SECURITY_HANDLE device_auth_handle;
 #endif
 } IOTHUB_AUTHORIZATION_DATA;
 
+// A device key token of a IoTHubClient_Auth_Get_SasToken_Batch call, from the string to sign to its signature
+typedef struct SAS_TOKEN_SIGNING_TAG
+{
+    IOTHUB_SAS_TOKEN_REQUEST* request;
+    BUFFER_HANDLE key;
+    char* string_to_sign;
+    char expiry[SAS_TOKEN_EXPIRY_MAX_LENGTH];
+} SAS_TOKEN_SIGNING;
+
 static int get_seconds_since_epoch(size_t* seconds)
 {
     int result;
@@ -54,6 +85,154 @@ static int get_seconds_since_epoch(size_t* seconds)
     return result;
 }
 
+static void clear_sas_token_cache_entry(SAS_TOKEN_CACHE_ENTRY* entry)
+{
+    free(entry->scope);
+    free(entry->key_name);
+    free(entry->sas_token);
+    memset(entry, 0, sizeof(SAS_TOKEN_CACHE_ENTRY));
+}
+
+static void clear_sas_token_cache(IOTHUB_AUTHORIZATION_DATA* handle)
+{
+    size_t index;
+    for (index = 0; index < SAS_TOKEN_CACHE_SIZE; index++)
+    {
+        if (handle->token_cache[index].sas_token != NULL)
+        {
+            clear_sas_token_cache_entry(&handle->token_cache[index]);
+        }
+    }
+}
+
+static bool are_key_names_equal(const char* left, const char* right)
+{
+    return (left == NULL || right == NULL) ? (left == right) : (strcmp(left, right) == 0);
+}
+
+static SAS_TOKEN_CACHE_ENTRY* find_cached_sas_token(IOTHUB_AUTHORIZATION_DATA* handle, const char* scope, const char* key_name, size_t sec_since_epoch)
+{
+    SAS_TOKEN_CACHE_ENTRY* result = NULL;
+
+    if (handle->token_cache_refresh_percent != 0)
+    {
+        size_t refresh_after_sec = handle->token_expiry_time_sec * handle->token_cache_refresh_percent / 100;
+        size_t index;
+
+        for (index = 0; index < SAS_TOKEN_CACHE_SIZE; index++)
+        {
+            SAS_TOKEN_CACHE_ENTRY* entry = &handle->token_cache[index];
+            if (entry->sas_token != NULL && strcmp(entry->scope, scope) == 0 && are_key_names_equal(entry->key_name, key_name))
+            {
+                // Codes_SRS_IoTHub_Authorization_09_002: [ A cached token shall be regenerated once the configured percentage of the token lifetime has passed since it was created, or if the clock went back. ]
+                if (sec_since_epoch < entry->created_at_sec || sec_since_epoch - entry->created_at_sec >= refresh_after_sec)
+                {
+                    clear_sas_token_cache_entry(entry);
+                }
+                else
+                {
+                    result = entry;
+                }
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+static void insert_cached_sas_token(IOTHUB_AUTHORIZATION_DATA* handle, const char* scope, const char* key_name, const char* sas_token, size_t sec_since_epoch)
+{
+    SAS_TOKEN_CACHE_ENTRY* entry = &handle->token_cache[0];
+    size_t index;
+
+    // Codes_SRS_IoTHub_Authorization_09_003: [ A new token shall take a free cache entry, or the entry of the oldest cached token if there is none. ]
+    for (index = 0; index < SAS_TOKEN_CACHE_SIZE; index++)
+    {
+        if (handle->token_cache[index].sas_token != NULL &&
+            strcmp(handle->token_cache[index].scope, scope) == 0 && are_key_names_equal(handle->token_cache[index].key_name, key_name))
+        {
+            // Another thread cached a token for the same scope while this one was being created
+            entry = &handle->token_cache[index];
+            break;
+        }
+        else if (handle->token_cache[index].sas_token == NULL)
+        {
+            entry = &handle->token_cache[index];
+            break;
+        }
+        else if (handle->token_cache[index].created_at_sec < entry->created_at_sec)
+        {
+            entry = &handle->token_cache[index];
+        }
+    }
+
+    if (entry->sas_token != NULL)
+    {
+        clear_sas_token_cache_entry(entry);
+    }
+
+    if (mallocAndStrcpy_s(&entry->scope, scope) != 0 ||
+        (key_name != NULL && mallocAndStrcpy_s(&entry->key_name, key_name) != 0) ||
+        mallocAndStrcpy_s(&entry->sas_token, sas_token) != 0)
+    {
+        // Not caching the token only costs a new one on the next call
+        LogError("Failed caching the sas token");
+        clear_sas_token_cache_entry(entry);
+    }
+    else
+    {
+        entry->created_at_sec = sec_since_epoch;
+    }
+}
+
+// Codes_SRS_IoTHub_Authorization_09_015: [ The sas token cache shall only be read and changed while holding the lock of the handle. ]
+static bool copy_cached_sas_token(IOTHUB_AUTHORIZATION_DATA* handle, const char* scope, const char* key_name, size_t sec_since_epoch, char** sas_token)
+{
+    bool result = false;
+
+    if (Lock(handle->token_cache_lock) != LOCK_OK)
+    {
+        LogError("Failed locking the sas token cache");
+    }
+    else
+    {
+        SAS_TOKEN_CACHE_ENTRY* cached_token = find_cached_sas_token(handle, scope, key_name, sec_since_epoch);
+
+        if (cached_token != NULL)
+        {
+            result = true;
+
+            if (mallocAndStrcpy_s(sas_token, cached_token->sas_token) != 0)
+            {
+                LogError("Failed copying cached sas token");
+                *sas_token = NULL;
+            }
+        }
+
+        (void)Unlock(handle->token_cache_lock);
+    }
+
+    return result;
+}
+
+static void cache_sas_token(IOTHUB_AUTHORIZATION_DATA* handle, const char* scope, const char* key_name, const char* sas_token, size_t sec_since_epoch)
+{
+    if (Lock(handle->token_cache_lock) != LOCK_OK)
+    {
+        LogError("Failed locking the sas token cache");
+    }
+    else
+    {
+        if (handle->token_cache_refresh_percent != 0)
+        {
+            insert_cached_sas_token(handle, scope, key_name, sas_token, sec_since_epoch);
+        }
+
+        (void)Unlock(handle->token_cache_lock);
+    }
+}
+
 static IOTHUB_AUTHORIZATION_DATA* initialize_auth_client(const char* device_id, const char* module_id)
 {
     IOTHUB_AUTHORIZATION_DATA* result;
@@ -84,6 +263,15 @@ static IOTHUB_AUTHORIZATION_DATA* initialize_auth_client(const char* device_id,
             free(result);
             result = NULL;
         }
+        else if ((result->token_cache_lock = Lock_Init()) == NULL)
+        {
+            /* Codes_SRS_IoTHub_Authorization_07_019: [ On error IoTHubClient_Auth_Create shall return NULL. ] */
+            LogError("Failed creating the sas token cache lock");
+            free(result->device_id);
+            free(result->module_id);
+            free(result);
+            result = NULL;
+        }
         else
         {
             result->token_expiry_time_sec = DEFAULT_SAS_TOKEN_EXPIRY_TIME_SECS;
@@ -133,6 +321,7 @@ IOTHUB_AUTHORIZATION_HANDLE IoTHubClient_Auth_Create(const char* device_key, con
         {
             /* Codes_SRS_IoTHub_Authorization_07_019: [ On error IoTHubClient_Auth_Create shall return NULL. ] */
             LogError("Failed allocating device_key");
+            Lock_Deinit(result->token_cache_lock);
             free(result->device_id);
             free(result->module_id);
             free(result);
@@ -153,6 +342,7 @@ IOTHUB_AUTHORIZATION_HANDLE IoTHubClient_Auth_Create(const char* device_key, con
                 {
                     /* Codes_SRS_IoTHub_Authorization_07_019: [ On error IoTHubClient_Auth_Create shall return NULL. ] */
                     LogError("Failed allocating device_key");
+                    Lock_Deinit(result->token_cache_lock);
                     free(result->device_key);
                     free(result->device_id);
                     free(result->module_id);
@@ -193,6 +383,7 @@ IOTHUB_AUTHORIZATION_HANDLE IoTHubClient_Auth_CreateFromDeviceAuth(const char* d
             if (result->device_auth_handle == NULL)
             {
                 LogError("Failed allocating IOTHUB_AUTHORIZATION_DATA");
+                Lock_Deinit(result->token_cache_lock);
                 free(result->device_id);
                 free(result->module_id);
                 free(result);
@@ -233,6 +424,8 @@ void IoTHubClient_Auth_Destroy(IOTHUB_AUTHORIZATION_HANDLE handle)
         free(handle->device_id);
         free(handle->module_id);
         free(handle->device_sas_token);
+        clear_sas_token_cache(handle);
+        Lock_Deinit(handle->token_cache_lock);
         free(handle);
     }
 }
@@ -473,6 +666,11 @@ char* IoTHubClient_Auth_Get_SasToken(IOTHUB_AUTHORIZATION_HANDLE handle, const c
                     LogError("failure getting seconds from epoch");
                     result = NULL;
                 }
+                /* Codes_SRS_IoTHub_Authorization_09_001: [ If the sas token cache is on and holds a token for scope and key_name that is not due for refresh, IoTHubClient_Auth_Get_SasToken shall return a copy of it instead of creating a new one. ] */
+                else if (copy_cached_sas_token(handle, scope, key_name, sec_since_epoch, &result))
+                {
+                    // result holds the copy of the cached token, or NULL if it could not be copied
+                }
                 else
                 {
                     /* Codes_SRS_IoTHub_Authorization_07_011: [ IoTHubClient_Auth_Get_ConnString shall call SASToken_CreateString to construct the sas token. ] */
@@ -492,6 +690,10 @@ char* IoTHubClient_Auth_Get_SasToken(IOTHUB_AUTHORIZATION_HANDLE handle, const c
                             LogError("Failed copying result");
                             result = NULL;
                         }
+                        else
+                        {
+                            cache_sas_token(handle, scope, key_name, result, sec_since_epoch);
+                        }
                         STRING_delete(sas_token);
                     }
                 }
@@ -506,6 +708,190 @@ char* IoTHubClient_Auth_Get_SasToken(IOTHUB_AUTHORIZATION_HANDLE handle, const c
     return result;
 }
 
+static int prepare_sas_token_signing(SAS_TOKEN_SIGNING* signing, HMACSHA256_BATCH_ITEM* item, size_t sec_since_epoch)
+{
+    int result;
+    IOTHUB_AUTHORIZATION_DATA* handle = signing->request->handle;
+    size_t string_to_sign_length;
+
+    (void)snprintf(signing->expiry, sizeof(signing->expiry), "%lu", (unsigned long)(sec_since_epoch + handle->token_expiry_time_sec));
+    string_to_sign_length = strlen(signing->request->scope) + 1 + strlen(signing->expiry);
+
+    if ((signing->key = Azure_Base64_Decode(handle->device_key)) == NULL)
+    {
+        LogError("Failed decoding the device key");
+        result = MU_FAILURE;
+    }
+    else if ((signing->string_to_sign = (char*)malloc(string_to_sign_length + 1)) == NULL)
+    {
+        LogError("Failed allocating the string to sign");
+        BUFFER_delete(signing->key);
+        signing->key = NULL;
+        result = MU_FAILURE;
+    }
+    else
+    {
+        // Same string to sign as SASToken_CreateString: the scope and the expiry on separate lines
+        (void)snprintf(signing->string_to_sign, string_to_sign_length + 1, "%s\n%s", signing->request->scope, signing->expiry);
+
+        item->key = BUFFER_u_char(signing->key);
+        item->key_length = BUFFER_length(signing->key);
+        item->payload = (const unsigned char*)signing->string_to_sign;
+        item->payload_length = string_to_sign_length;
+        result = 0;
+    }
+
+    return result;
+}
+
+static char* create_sas_token_from_hash(const SAS_TOKEN_SIGNING* signing, const unsigned char* hash)
+{
+    char* result;
+    STRING_HANDLE signature;
+
+    if ((signature = Azure_Base64_Encode_Bytes(hash, HMACSHA256_BATCH_HASH_SIZE)) == NULL)
+    {
+        LogError("Failed encoding the sas token signature");
+        result = NULL;
+    }
+    else
+    {
+        STRING_HANDLE url_encoded_signature;
+
+        if ((url_encoded_signature = URL_Encode(signature)) == NULL)
+        {
+            LogError("Failed url encoding the sas token signature");
+            result = NULL;
+        }
+        else
+        {
+            const char* key_name_field = (signing->request->key_name == NULL) ? "" : SAS_TOKEN_KEY_NAME_FIELD;
+            const char* key_name = (signing->request->key_name == NULL) ? "" : signing->request->key_name;
+            int length = snprintf(NULL, 0, SAS_TOKEN_FORMAT, signing->request->scope, STRING_c_str(url_encoded_signature), signing->expiry, key_name_field, key_name);
+
+            if (length < 0 || (result = (char*)malloc((size_t)length + 1)) == NULL)
+            {
+                LogError("Failed allocating the sas token");
+                result = NULL;
+            }
+            else
+            {
+                (void)snprintf(result, (size_t)length + 1, SAS_TOKEN_FORMAT, signing->request->scope, STRING_c_str(url_encoded_signature), signing->expiry, key_name_field, key_name);
+            }
+
+            STRING_delete(url_encoded_signature);
+        }
+
+        STRING_delete(signature);
+    }
+
+    return result;
+}
+
+int IoTHubClient_Auth_Get_SasToken_Batch(IOTHUB_SAS_TOKEN_REQUEST* requests, size_t request_count)
+{
+    int result;
+
+    if (requests == NULL || request_count == 0)
+    {
+        /* Codes_SRS_IoTHub_Authorization_09_007: [ If `requests` is NULL or `request_count` is 0, IoTHubClient_Auth_Get_SasToken_Batch shall fail and return non-zero. ] */
+        LogError("Invalid Parameter requests: %p, request_count: %lu", requests, (unsigned long)request_count);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        SAS_TOKEN_SIGNING* signings = (SAS_TOKEN_SIGNING*)calloc(request_count, sizeof(SAS_TOKEN_SIGNING));
+        HMACSHA256_BATCH_ITEM* items = (HMACSHA256_BATCH_ITEM*)calloc(request_count, sizeof(HMACSHA256_BATCH_ITEM));
+        size_t sec_since_epoch;
+        size_t signing_count = 0;
+        size_t index;
+
+        if (signings == NULL || items == NULL || get_seconds_since_epoch(&sec_since_epoch) != 0)
+        {
+            /* Codes_SRS_IoTHub_Authorization_09_008: [ If the batch cannot be set up, IoTHubClient_Auth_Get_SasToken_Batch shall create each token with IoTHubClient_Auth_Get_SasToken. ] */
+            LogError("Failed setting up the sas token batch, creating the tokens one at a time");
+            for (index = 0; index < request_count; index++)
+            {
+                requests[index].sas_token = IoTHubClient_Auth_Get_SasToken(requests[index].handle, requests[index].scope, 0, requests[index].key_name);
+            }
+        }
+        else
+        {
+            for (index = 0; index < request_count; index++)
+            {
+                IOTHUB_SAS_TOKEN_REQUEST* request = &requests[index];
+
+                request->sas_token = NULL;
+
+                if (request->handle == NULL || request->scope == NULL || request->handle->cred_type != IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY)
+                {
+                    /* Codes_SRS_IoTHub_Authorization_09_009: [ Requests whose handle does not hold a device key shall be served by IoTHubClient_Auth_Get_SasToken. ] */
+                    request->sas_token = IoTHubClient_Auth_Get_SasToken(request->handle, request->scope, 0, request->key_name);
+                }
+                /* Codes_SRS_IoTHub_Authorization_09_010: [ A device key request with a usable cached token shall get a copy of it, as in IoTHubClient_Auth_Get_SasToken. ] */
+                else if (copy_cached_sas_token(request->handle, request->scope, request->key_name, sec_since_epoch, &request->sas_token))
+                {
+                    // request->sas_token holds the copy of the cached token, or NULL if it could not be copied
+                }
+                else
+                {
+                    signings[signing_count].request = request;
+
+                    if (prepare_sas_token_signing(&signings[signing_count], &items[signing_count], sec_since_epoch) != 0)
+                    {
+                        /* Codes_SRS_IoTHub_Authorization_09_013: [ A request whose token cannot be created shall be left with a NULL `sas_token`. ] */
+                        LogError("Failed preparing the sas token of %s", request->scope);
+                    }
+                    else
+                    {
+                        signing_count++;
+                    }
+                }
+            }
+
+            if (signing_count > 0)
+            {
+                /* Codes_SRS_IoTHub_Authorization_09_011: [ The other device key requests shall be signed together with HMACSHA256_Batch_ComputeHashes, over the same string to sign as SASToken_CreateString. ] */
+                if (HMACSHA256_Batch_ComputeHashes(items, signing_count) != 0)
+                {
+                    LogError("Failed signing %lu sas tokens", (unsigned long)signing_count);
+                }
+                else
+                {
+                    for (index = 0; index < signing_count; index++)
+                    {
+                        IOTHUB_SAS_TOKEN_REQUEST* request = signings[index].request;
+
+                        /* Codes_SRS_IoTHub_Authorization_09_012: [ Each signed token shall have the SASToken_CreateString format and be cached when the sas token cache is on. ] */
+                        if ((request->sas_token = create_sas_token_from_hash(&signings[index], items[index].hash)) == NULL)
+                        {
+                            LogError("Failed creating the sas token of %s", request->scope);
+                        }
+                        else
+                        {
+                            cache_sas_token(request->handle, request->scope, request->key_name, request->sas_token, sec_since_epoch);
+                        }
+                    }
+                }
+
+                for (index = 0; index < signing_count; index++)
+                {
+                    BUFFER_delete(signings[index].key);
+                    free(signings[index].string_to_sign);
+                }
+            }
+        }
+
+        free(signings);
+        free(items);
+
+        /* Codes_SRS_IoTHub_Authorization_09_014: [ Otherwise IoTHubClient_Auth_Get_SasToken_Batch shall return 0. ] */
+        result = 0;
+    }
+
+    return result;
+}
+
 const char* IoTHubClient_Auth_Get_DeviceId(IOTHUB_AUTHORIZATION_HANDLE handle)
 {
     const char* result;
@@ -704,9 +1090,21 @@ int IoTHubClient_Auth_Set_SasToken_Expiry(IOTHUB_AUTHORIZATION_HANDLE handle, si
         LogError("Failure setting expiry time to value %lu min value is %d", (unsigned long)expiry_time_seconds, MIN_SAS_EXPIRY_TIME);
         result = MU_FAILURE;
     }
+    // Codes_SRS_IoTHub_Authorization_09_015: [ The sas token cache shall only be read and changed while holding the lock of the handle. ]
+    else if (Lock(handle->token_cache_lock) != LOCK_OK)
+    {
+        LogError("Failed locking the sas token cache");
+        result = MU_FAILURE;
+    }
     else
     {
+        if (handle->token_expiry_time_sec != expiry_time_seconds)
+        {
+            // Codes_SRS_IoTHub_Authorization_09_004: [ Changing the token lifetime shall drop the cached sas tokens. ]
+            clear_sas_token_cache(handle);
+        }
         handle->token_expiry_time_sec = expiry_time_seconds;
+        (void)Unlock(handle->token_cache_lock);
         result = 0;
     }
     return result;
@@ -726,3 +1124,37 @@ size_t IoTHubClient_Auth_Get_SasToken_Expiry(IOTHUB_AUTHORIZATION_HANDLE handle)
     }
     return result;
 }
+
+int IoTHubClient_Auth_Set_SasToken_Cache_Refresh_Percent(IOTHUB_AUTHORIZATION_HANDLE handle, size_t refresh_percent)
+{
+    int result;
+    if (handle == NULL)
+    {
+        LogError("Invalid handle value handle: NULL");
+        result = MU_FAILURE;
+    }
+    // Codes_SRS_IoTHub_Authorization_09_005: [ IoTHubClient_Auth_Set_SasToken_Cache_Refresh_Percent shall fail if refresh_percent is over MAX_SAS_TOKEN_CACHE_REFRESH_PERCENT. ]
+    else if (refresh_percent > MAX_SAS_TOKEN_CACHE_REFRESH_PERCENT)
+    {
+        LogError("Failure setting sas token cache refresh percent to %lu max value is %d", (unsigned long)refresh_percent, MAX_SAS_TOKEN_CACHE_REFRESH_PERCENT);
+        result = MU_FAILURE;
+    }
+    // Codes_SRS_IoTHub_Authorization_09_015: [ The sas token cache shall only be read and changed while holding the lock of the handle. ]
+    else if (Lock(handle->token_cache_lock) != LOCK_OK)
+    {
+        LogError("Failed locking the sas token cache");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        // Codes_SRS_IoTHub_Authorization_09_006: [ Setting refresh_percent to 0 shall turn the sas token cache off and drop the cached sas tokens. ]
+        if (refresh_percent == 0)
+        {
+            clear_sas_token_cache(handle);
+        }
+        handle->token_cache_refresh_percent = refresh_percent;
+        (void)Unlock(handle->token_cache_lock);
+        result = 0;
+    }
+    return result;
+}
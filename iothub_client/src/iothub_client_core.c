@@ -16,6 +16,7 @@
 #include "internal/iothubtransport.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
@@ -25,9 +26,18 @@
 
 
 #define DO_WORK_FREQ_DEFAULT 1
+#define HTTP_WORKER_POOL_SIZE 4
+#define HTTP_WORKER_IDLE_TIMEOUT_MS 30000
 
 struct IOTHUB_QUEUE_CONTEXT_TAG;
 
+typedef struct HTTP_WORKER_TAG
+{
+    IOTHUB_CLIENT_CORE_HANDLE iotHubClientInstance;
+    THREAD_HANDLE threadHandle; /*joined before the slot is reused, or by IoTHubClient_Destroy*/
+    bool running;
+} HTTP_WORKER;
+
 typedef struct IOTHUB_CLIENT_CORE_INSTANCE_TAG
 {
     IOTHUB_CLIENT_CORE_LL_HANDLE IoTHubClientLLHandle;
@@ -35,7 +45,7 @@ typedef struct IOTHUB_CLIENT_CORE_INSTANCE_TAG
     THREAD_HANDLE ThreadHandle;
     LOCK_HANDLE LockHandle;
     sig_atomic_t StopThread;
-    SINGLYLINKEDLIST_HANDLE httpWorkerThreadInfoList; /*list containing HTTPWORKER_THREAD_INFO*/
+    SINGLYLINKEDLIST_HANDLE httpWorkerThreadInfoList; /*list containing the HTTPWORKER_THREAD_INFO of the method worker threads*/
     int created_with_transport_handle;
     VECTOR_HANDLE saved_user_callback_list;
     IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK desired_state_callback;
@@ -49,18 +59,33 @@ typedef struct IOTHUB_CLIENT_CORE_INSTANCE_TAG
     struct IOTHUB_QUEUE_CONTEXT_TAG* method_user_context;
     tickcounter_ms_t do_work_freq_ms;
     tickcounter_ms_t currentMessageTimeout;
+    size_t method_max_concurrency;
+    size_t method_worker_count;
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY send_queue_full_policy; /*copy of the policy given to the LL layer, IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK is carried out here*/
+    bool stop_method_workers;
+    SINGLYLINKEDLIST_HANDLE method_invocation_list; /*list containing DEVICE_METHOD_INVOCATION*/
+    SINGLYLINKEDLIST_HANDLE http_upload_job_list; /*list containing the upload HTTPWORKER_THREAD_INFO waiting for an HTTP worker*/
+    SINGLYLINKEDLIST_HANDLE http_invoke_job_list; /*list containing the method invoke HTTPWORKER_THREAD_INFO waiting for an HTTP worker, taken before any upload*/
+    COND_HANDLE http_job_condition; /*posted when a job is queued for an idle HTTP worker, or when the HTTP workers are stopped*/
+    size_t http_worker_count;
+    size_t http_upload_worker_count; /*HTTP workers running an upload, kept below HTTP_WORKER_POOL_SIZE so a worker is left for method invokes*/
+    size_t http_idle_worker_count;
+    bool stop_http_workers;
+    HTTP_WORKER http_workers[HTTP_WORKER_POOL_SIZE];
 } IOTHUB_CLIENT_CORE_INSTANCE;
 
 typedef enum HTTPWORKER_THREAD_TYPE_TAG
 {
     HTTPWORKER_THREAD_UPLOAD_TO_BLOB,
-    HTTPWORKER_THREAD_INVOKE_METHOD
+    HTTPWORKER_THREAD_INVOKE_METHOD,
+    HTTPWORKER_THREAD_DEVICE_METHOD
 } HTTPWORKER_THREAD_TYPE;
 
 typedef struct UPLOADTOBLOB_SAVED_DATA_TAG
 {
     unsigned char* source;
     size_t size;
+    char* sourceFilePath; /*uploaded instead of source when not NULL*/
     IOTHUB_CLIENT_FILE_UPLOAD_CALLBACK iotHubClientFileUploadCallback;
 }UPLOADTOBLOB_SAVED_DATA;
 
@@ -84,7 +109,8 @@ typedef struct HTTPWORKER_THREAD_INFO_TAG
 {
     HTTPWORKER_THREAD_TYPE workerThreadType;
     char* destinationFileName;
-    THREAD_HANDLE threadHandle;
+    THREAD_START_FUNC jobFunc; /*run by an HTTP worker*/
+    THREAD_HANDLE threadHandle; /*method worker threads only*/
     LOCK_HANDLE lockGarbage;
     int canBeGarbageCollected; /*flag indicating that the structure can be freed because the thread deadling with it finished*/
     IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle;
@@ -163,6 +189,13 @@ typedef struct USER_CALLBACK_INFO_TAG
     } iothub_callback;
 } USER_CALLBACK_INFO;
 
+typedef struct DEVICE_METHOD_INVOCATION_TAG
+{
+    USER_CALLBACK_INFO callback_info;
+    const char* method_name; /*points past the end of this structure, so it outlives callback_info's method_name*/
+    bool running;
+} DEVICE_METHOD_INVOCATION;
+
 typedef struct IOTHUB_QUEUE_CONTEXT_TAG
 {
     IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientHandle;
@@ -207,10 +240,17 @@ typedef enum CREATE_HUB_INSTANCE_TYPE_TAG
 
 static void freeHttpWorkerThreadInfo(HTTPWORKER_THREAD_INFO* threadInfo)
 {
-    Lock_Deinit(threadInfo->lockGarbage);
+    if (threadInfo->lockGarbage != NULL)
+    {
+        Lock_Deinit(threadInfo->lockGarbage);
+    }
     if (threadInfo->workerThreadType == HTTPWORKER_THREAD_UPLOAD_TO_BLOB)
     {
         free(threadInfo->uploadBlobSavedData.source);
+        if (threadInfo->uploadBlobSavedData.sourceFilePath != NULL)
+        {
+            free(threadInfo->uploadBlobSavedData.sourceFilePath);
+        }
         free(threadInfo->destinationFileName);
     }
     else if (threadInfo->workerThreadType == HTTPWORKER_THREAD_INVOKE_METHOD)
@@ -224,11 +264,11 @@ static void freeHttpWorkerThreadInfo(HTTPWORKER_THREAD_INFO* threadInfo)
     free(threadInfo);
 }
 
-/*this function is called from _Destroy and from ScheduleWork_Thread to join finished blobUpload threads and free that memory*/
+/*this function is called from _Destroy and before starting a method worker to join finished method worker threads and free that memory*/
 static void garbageCollectorImpl(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance)
 {
     /*see if any savedData structures can be disposed of*/
-    /*Codes_SRS_IOTHUBCLIENT_02_072: [ All threads marked as disposable (upon completion of a file upload) shall be joined and the data structures build for them shall be freed. ]*/
+    /*Codes_SRS_IOTHUBCLIENT_02_072: [ All threads marked as disposable (upon completion of a device method) shall be joined and the data structures build for them shall be freed. ]*/
     LIST_ITEM_HANDLE item = singlylinkedlist_get_head_item(iotHubClientInstance->httpWorkerThreadInfoList);
     while (item != NULL)
     {
@@ -268,6 +308,26 @@ static void garbageCollectorImpl(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstan
     }
 }
 
+static int markThreadReadyToBeGarbageCollected(HTTPWORKER_THREAD_INFO* threadInfo)
+{
+    if (Lock(threadInfo->lockGarbage) != LOCK_OK)
+    {
+        LogError("unable to Lock - trying anyway");
+        threadInfo->canBeGarbageCollected = 1;
+    }
+    else
+    {
+        threadInfo->canBeGarbageCollected = 1;
+
+        if (Unlock(threadInfo->lockGarbage) != LOCK_OK)
+        {
+            LogError("unable to Unlock after locking");
+        }
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
 
 static bool iothub_ll_message_callback(MESSAGE_CALLBACK_INFO* messageData, void* userContextCallback)
 {
@@ -521,64 +581,644 @@ static void iothub_ll_device_twin_callback(DEVICE_TWIN_UPDATE_STATE update_state
             }
         }
     }
-    else
-    {
-        LogError("device twin callback userContextCallback NULL");
-    }
+    else
+    {
+        LogError("device twin callback userContextCallback NULL");
+    }
+}
+
+static void iothub_ll_get_device_twin_async_callback(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* userContextCallback)
+{
+    IOTHUB_QUEUE_CONSOLIDATED_CONTEXT* queue_context = (IOTHUB_QUEUE_CONSOLIDATED_CONTEXT*)userContextCallback;
+
+    if (queue_context != NULL)
+    {
+        USER_CALLBACK_INFO queue_cb_info;
+        queue_cb_info.type = CALLBACK_TYPE_DEVICE_TWIN;
+        queue_cb_info.userContextCallback = queue_context->userContext;
+        queue_cb_info.iothub_callback.dev_twin_cb_info.update_state = update_state;
+        queue_cb_info.iothub_callback.dev_twin_cb_info.userCallback = queue_context->userCallback.getTwin;
+        queue_cb_info.iothub_callback.dev_twin_cb_info.userContext = queue_context->userContext;
+
+        if (payLoad == NULL)
+        {
+            queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad = NULL;
+            queue_cb_info.iothub_callback.dev_twin_cb_info.size = 0;
+        }
+        else
+        {
+            queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad = (unsigned char*)malloc(size);
+
+            if (queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad == NULL)
+            {
+                LogError("Failure allocating payload in get device twin callback.");
+                queue_cb_info.iothub_callback.dev_twin_cb_info.size = 0;
+            }
+            else
+            {
+                (void)memcpy(queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad, payLoad, size);
+                queue_cb_info.iothub_callback.dev_twin_cb_info.size = size;
+            }
+        }
+
+        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+        {
+            LogError("device twin callback userContextCallback vector push failed.");
+
+            if (queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad != NULL)
+            {
+                free(queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad);
+            }
+        }
+
+        free(queue_context);
+    }
+    else
+    {
+        LogError("Get device twin callback userContextCallback NULL");
+    }
+}
+
+static void invoke_device_method(USER_CALLBACK_INFO* queued_cb, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC device_method_callback, IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK inbound_device_method_callback, IOTHUB_CLIENT_CORE_HANDLE method_user_context_handle)
+{
+    const char* method_name = STRING_c_str(queued_cb->iothub_callback.method_cb_info.method_name);
+    const unsigned char* payload = BUFFER_u_char(queued_cb->iothub_callback.method_cb_info.payload);
+    size_t payload_len = BUFFER_length(queued_cb->iothub_callback.method_cb_info.payload);
+
+    if (queued_cb->type == CALLBACK_TYPE_DEVICE_METHOD && device_method_callback != NULL)
+    {
+        unsigned char* payload_resp = NULL;
+        size_t response_size = 0;
+        int status = device_method_callback(method_name, payload, payload_len, &payload_resp, &response_size, queued_cb->userContextCallback);
+
+        if (payload_resp && (response_size > 0))
+        {
+            IOTHUB_CLIENT_RESULT result = IoTHubClientCore_DeviceMethodResponse(method_user_context_handle, queued_cb->iothub_callback.method_cb_info.method_id, (const unsigned char*)payload_resp, response_size, status);
+            if (result != IOTHUB_CLIENT_OK)
+            {
+                LogError("IoTHubClientCore_LL_DeviceMethodResponse failed");
+            }
+        }
+
+        BUFFER_delete(queued_cb->iothub_callback.method_cb_info.payload);
+        STRING_delete(queued_cb->iothub_callback.method_cb_info.method_name);
+
+        if (payload_resp)
+        {
+            free(payload_resp);
+        }
+    }
+    else if (queued_cb->type == CALLBACK_TYPE_INBOUD_DEVICE_METHOD && inbound_device_method_callback != NULL)
+    {
+        inbound_device_method_callback(method_name, payload, payload_len, queued_cb->iothub_callback.method_cb_info.method_id, queued_cb->userContextCallback);
+
+        BUFFER_delete(queued_cb->iothub_callback.method_cb_info.payload);
+        STRING_delete(queued_cb->iothub_callback.method_cb_info.method_name);
+    }
+    else
+    {
+        LogError("No callback set for device method '%s', ignoring it", method_name);
+        BUFFER_delete(queued_cb->iothub_callback.method_cb_info.payload);
+        STRING_delete(queued_cb->iothub_callback.method_cb_info.method_name);
+    }
+}
+
+static bool is_running_invocation_of_method(LIST_ITEM_HANDLE list_item, const void* match_context)
+{
+    const DEVICE_METHOD_INVOCATION* invocation = (const DEVICE_METHOD_INVOCATION*)singlylinkedlist_item_get_value(list_item);
+    return (invocation->running && strcmp(invocation->method_name, (const char*)match_context) == 0);
+}
+
+/*called with LockHandle held; returns the oldest invocation whose method name is not already running*/
+static LIST_ITEM_HANDLE get_next_device_method_invocation(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance)
+{
+    LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(iotHubClientInstance->method_invocation_list);
+
+    while (list_item != NULL)
+    {
+        const DEVICE_METHOD_INVOCATION* invocation = (const DEVICE_METHOD_INVOCATION*)singlylinkedlist_item_get_value(list_item);
+
+        if (!invocation->running &&
+            singlylinkedlist_find(iotHubClientInstance->method_invocation_list, is_running_invocation_of_method, invocation->method_name) == NULL)
+        {
+            break;
+        }
+
+        list_item = singlylinkedlist_get_next_item(list_item);
+    }
+
+    return list_item;
+}
+
+static int deviceMethodWorker_thread(void* data)
+{
+    HTTPWORKER_THREAD_INFO* threadInfo = (HTTPWORKER_THREAD_INFO*)data;
+    IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)threadInfo->iotHubClientHandle;
+    LIST_ITEM_HANDLE invocation_item = NULL;
+    bool done = false;
+
+    while (!done)
+    {
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            LogError("failed locking for device method worker - will retry");
+            (void)ThreadAPI_Sleep(1);
+        }
+        else
+        {
+            IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC device_method_callback;
+            IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK inbound_device_method_callback;
+            DEVICE_METHOD_INVOCATION* invocation;
+
+            if (invocation_item != NULL)
+            {
+                invocation = (DEVICE_METHOD_INVOCATION*)singlylinkedlist_item_get_value(invocation_item);
+                (void)singlylinkedlist_remove(iotHubClientInstance->method_invocation_list, invocation_item);
+                free(invocation);
+            }
+
+            /*Codes_SRS_IOTHUBCLIENT_09_019: [ A method worker thread shall exit when no queued device method can run or when IoTHubClient_Destroy is called. ]*/
+            if (iotHubClientInstance->stop_method_workers ||
+                (invocation_item = get_next_device_method_invocation(iotHubClientInstance)) == NULL)
+            {
+                invocation_item = NULL;
+                iotHubClientInstance->method_worker_count--;
+                done = true;
+                (void)Unlock(iotHubClientInstance->LockHandle);
+            }
+            else
+            {
+                invocation = (DEVICE_METHOD_INVOCATION*)singlylinkedlist_item_get_value(invocation_item);
+                invocation->running = true;
+                device_method_callback = iotHubClientInstance->device_method_callback;
+                inbound_device_method_callback = iotHubClientInstance->inbound_device_method_callback;
+                (void)Unlock(iotHubClientInstance->LockHandle);
+
+                invoke_device_method(&invocation->callback_info, device_method_callback, inbound_device_method_callback, iotHubClientInstance);
+            }
+        }
+    }
+
+    return markThreadReadyToBeGarbageCollected(threadInfo);
+}
+
+/*called with LockHandle held*/
+static int start_device_method_worker(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance)
+{
+    int result;
+    HTTPWORKER_THREAD_INFO* threadInfo;
+
+    garbageCollectorImpl(iotHubClientInstance);
+
+    if ((threadInfo = (HTTPWORKER_THREAD_INFO*)malloc(sizeof(HTTPWORKER_THREAD_INFO))) == NULL)
+    {
+        LogError("unable to allocate device method worker thread info");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        LIST_ITEM_HANDLE item;
+
+        (void)memset(threadInfo, 0, sizeof(HTTPWORKER_THREAD_INFO));
+        threadInfo->workerThreadType = HTTPWORKER_THREAD_DEVICE_METHOD;
+        threadInfo->iotHubClientHandle = iotHubClientInstance;
+
+        if ((threadInfo->lockGarbage = Lock_Init()) == NULL)
+        {
+            LogError("unable to Lock_Init");
+            free(threadInfo);
+            result = MU_FAILURE;
+        }
+        else if ((item = singlylinkedlist_add(iotHubClientInstance->httpWorkerThreadInfoList, threadInfo)) == NULL)
+        {
+            LogError("Adding item to list failed");
+            freeHttpWorkerThreadInfo(threadInfo);
+            result = MU_FAILURE;
+        }
+        else if (ThreadAPI_Create(&threadInfo->threadHandle, deviceMethodWorker_thread, threadInfo) != THREADAPI_OK)
+        {
+            LogError("unable to ThreadAPI_Create");
+            (void)singlylinkedlist_remove(iotHubClientInstance->httpWorkerThreadInfoList, item);
+            freeHttpWorkerThreadInfo(threadInfo);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            iotHubClientInstance->method_worker_count++;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static int queue_device_method_invocation(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, const USER_CALLBACK_INFO* queued_cb)
+{
+    int result;
+    const char* method_name = STRING_c_str(queued_cb->iothub_callback.method_cb_info.method_name);
+    size_t method_name_length = (method_name == NULL) ? 0 : strlen(method_name);
+    DEVICE_METHOD_INVOCATION* invocation;
+
+    if ((invocation = (DEVICE_METHOD_INVOCATION*)malloc(sizeof(DEVICE_METHOD_INVOCATION) + method_name_length + 1)) == NULL)
+    {
+        LogError("unable to allocate device method invocation");
+        result = MU_FAILURE;
+    }
+    else if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    {
+        LogError("failed locking for queuing device method");
+        free(invocation);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        LIST_ITEM_HANDLE item;
+        char* method_name_copy = (char*)(invocation + 1);
+
+        (void)memcpy(method_name_copy, method_name == NULL ? "" : method_name, method_name_length + 1);
+        invocation->callback_info = *queued_cb;
+        invocation->method_name = method_name_copy;
+        invocation->running = false;
+
+        if ((item = singlylinkedlist_add(iotHubClientInstance->method_invocation_list, invocation)) == NULL)
+        {
+            LogError("unable to queue device method invocation");
+            free(invocation);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_09_018: [ A new method worker thread shall be started only while fewer than `method_max_concurrency` are running; otherwise the invocation waits for a running worker. ]*/
+            if (iotHubClientInstance->method_worker_count < iotHubClientInstance->method_max_concurrency &&
+                start_device_method_worker(iotHubClientInstance) != 0)
+            {
+                LogError("unable to start a device method worker");
+            }
+
+            if (iotHubClientInstance->method_worker_count == 0)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_09_020: [ If no method worker thread is running and starting one fails, the device method shall be invoked on the callback thread. ]*/
+                (void)singlylinkedlist_remove(iotHubClientInstance->method_invocation_list, item);
+                free(invocation);
+                result = MU_FAILURE;
+            }
+            else
+            {
+                result = 0;
+            }
+        }
+
+        (void)Unlock(iotHubClientInstance->LockHandle);
+    }
+
+    return result;
+}
+
+/*waits for the method worker threads to finish their current invocation, then frees the invocations that did not run*/
+static void destroy_device_method_invocations(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance)
+{
+    bool workers_running = true;
+    LIST_ITEM_HANDLE item;
+
+    while (workers_running)
+    {
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            LogError("unable to Lock - - will still proceed to free device method invocations");
+            workers_running = false;
+        }
+        else
+        {
+            iotHubClientInstance->stop_method_workers = true;
+            workers_running = (iotHubClientInstance->method_worker_count > 0);
+            (void)Unlock(iotHubClientInstance->LockHandle);
+
+            if (workers_running)
+            {
+                (void)ThreadAPI_Sleep(1);
+            }
+        }
+    }
+
+    while ((item = singlylinkedlist_get_head_item(iotHubClientInstance->method_invocation_list)) != NULL)
+    {
+        DEVICE_METHOD_INVOCATION* invocation = (DEVICE_METHOD_INVOCATION*)singlylinkedlist_item_get_value(item);
+        STRING_delete(invocation->callback_info.iothub_callback.method_cb_info.method_name);
+        BUFFER_delete(invocation->callback_info.iothub_callback.method_cb_info.payload);
+        (void)singlylinkedlist_remove(iotHubClientInstance->method_invocation_list, item);
+        free(invocation);
+    }
+
+    singlylinkedlist_destroy(iotHubClientInstance->method_invocation_list);
+}
+
+#if !defined(DONT_USE_UPLOADTOBLOB) || defined(USE_EDGE_MODULES)
+/*called with LockHandle held; returns the next job an HTTP worker may run and the list holding it*/
+static LIST_ITEM_HANDLE get_next_http_job(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, SINGLYLINKEDLIST_HANDLE* job_list)
+{
+    LIST_ITEM_HANDLE result = NULL;
+
+    /*Codes_SRS_IOTHUBCLIENT_09_037: [ An HTTP worker thread shall run the queued method invokes before the queued uploads. ]*/
+    if (iotHubClientInstance->http_invoke_job_list != NULL &&
+        (result = singlylinkedlist_get_head_item(iotHubClientInstance->http_invoke_job_list)) != NULL)
+    {
+        *job_list = iotHubClientInstance->http_invoke_job_list;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_09_038: [ An HTTP worker thread shall not start an upload while `HTTP_WORKER_POOL_SIZE` - 1 workers run uploads, so that a worker is left for method invokes. ]*/
+    else if (iotHubClientInstance->http_upload_job_list != NULL &&
+        iotHubClientInstance->http_upload_worker_count < HTTP_WORKER_POOL_SIZE - 1 &&
+        (result = singlylinkedlist_get_head_item(iotHubClientInstance->http_upload_job_list)) != NULL)
+    {
+        *job_list = iotHubClientInstance->http_upload_job_list;
+    }
+
+    return result;
+}
+
+/*runs the queued HTTP jobs and waits for new ones until it is idle for HTTP_WORKER_IDLE_TIMEOUT_MS or stopped by IoTHubClient_Destroy;
+the thread is joined when its slot is reused or by IoTHubClient_Destroy*/
+static int httpWorker_thread(void* data)
+{
+    HTTP_WORKER* worker = (HTTP_WORKER*)data;
+    IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)worker->iotHubClientInstance;
+    HTTPWORKER_THREAD_INFO* job = NULL;
+    bool ran_upload = false;
+    bool done = false;
+
+    srand((unsigned int)get_time(NULL));
+
+    while (!done)
+    {
+        if (job != NULL)
+        {
+            ran_upload = (job->workerThreadType == HTTPWORKER_THREAD_UPLOAD_TO_BLOB);
+            /*Codes_SRS_IOTHUBCLIENT_02_071: [ The structure shall be freed by the HTTP worker thread once the upload completes. ]*/
+            freeHttpWorkerThreadInfo(job);
+            job = NULL;
+        }
+
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            LogError("failed locking for HTTP worker - will retry");
+            (void)ThreadAPI_Sleep(1);
+        }
+        else
+        {
+            LIST_ITEM_HANDLE job_item;
+            SINGLYLINKEDLIST_HANDLE job_list = NULL;
+            COND_RESULT wait_result = COND_OK;
+
+            if (ran_upload)
+            {
+                iotHubClientInstance->http_upload_worker_count--;
+                ran_upload = false;
+            }
+
+            /*Codes_SRS_IOTHUBCLIENT_09_034: [ An HTTP worker thread with no job to run shall wait up to `HTTP_WORKER_IDLE_TIMEOUT_MS` for a new job before exiting. ]*/
+            while ((job_item = get_next_http_job(iotHubClientInstance, &job_list)) == NULL &&
+                !iotHubClientInstance->stop_http_workers &&
+                wait_result == COND_OK)
+            {
+                iotHubClientInstance->http_idle_worker_count++;
+                wait_result = Condition_Wait(iotHubClientInstance->http_job_condition, iotHubClientInstance->LockHandle, HTTP_WORKER_IDLE_TIMEOUT_MS);
+                iotHubClientInstance->http_idle_worker_count--;
+            }
+
+            /*Codes_SRS_IOTHUBCLIENT_09_030: [ An HTTP worker thread shall run the queued method invokes and the queued uploads each in the order they were queued and exit when none is left after waiting, or when `IoTHubClient_Destroy` stops it. ]*/
+            if (job_item == NULL)
+            {
+                worker->running = false;
+                iotHubClientInstance->http_worker_count--;
+                done = true;
+            }
+            else
+            {
+                job = (HTTPWORKER_THREAD_INFO*)singlylinkedlist_item_get_value(job_item);
+                (void)singlylinkedlist_remove(job_list, job_item);
+
+                if (job->workerThreadType == HTTPWORKER_THREAD_UPLOAD_TO_BLOB)
+                {
+                    iotHubClientInstance->http_upload_worker_count++;
+                }
+            }
+
+            (void)Unlock(iotHubClientInstance->LockHandle);
+
+            if (job != NULL)
+            {
+                (void)job->jobFunc(job);
+            }
+        }
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+/*called with LockHandle held*/
+static int start_http_worker(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance)
+{
+    int result;
+    HTTP_WORKER* worker = NULL;
+    size_t index;
+
+    for (index = 0; index < HTTP_WORKER_POOL_SIZE; index++)
+    {
+        if (!iotHubClientInstance->http_workers[index].running)
+        {
+            worker = &iotHubClientInstance->http_workers[index];
+            break;
+        }
+    }
+
+    if (worker == NULL)
+    {
+        LogError("all the HTTP workers are running");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_09_031: [ An HTTP worker thread that exited shall be joined before a new worker thread takes its place. ]*/
+        if (worker->threadHandle != NULL)
+        {
+            int notUsed;
+            if (ThreadAPI_Join(worker->threadHandle, &notUsed) != THREADAPI_OK)
+            {
+                LogError("unable to ThreadAPI_Join");
+            }
+            worker->threadHandle = NULL;
+        }
+
+        worker->iotHubClientInstance = iotHubClientInstance;
+
+        if (ThreadAPI_Create(&worker->threadHandle, httpWorker_thread, worker) != THREADAPI_OK)
+        {
+            LogError("unable to ThreadAPI_Create");
+            worker->threadHandle = NULL;
+            result = MU_FAILURE;
+        }
+        else
+        {
+            worker->running = true;
+            iotHubClientInstance->http_worker_count++;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT queueHttpWorkerJob(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, HTTPWORKER_THREAD_INFO* threadInfo, THREAD_START_FUNC httpWorkerJobFunc)
+{
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)iotHubClientHandle;
+    /*Codes_SRS_IOTHUBCLIENT_09_039: [ Method invokes shall be queued apart from uploads, so that they do not wait behind long uploads. ]*/
+    SINGLYLINKEDLIST_HANDLE* job_list = (threadInfo->workerThreadType == HTTPWORKER_THREAD_INVOKE_METHOD) ?
+        &iotHubClientInstance->http_invoke_job_list : &iotHubClientInstance->http_upload_job_list;
+
+    threadInfo->jobFunc = httpWorkerJobFunc;
+
+    if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    {
+        LogError("Lock failed");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        LIST_ITEM_HANDLE item;
+
+        if (*job_list == NULL &&
+            (*job_list = singlylinkedlist_create()) == NULL)
+        {
+            LogError("unable to singlylinkedlist_create");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if (iotHubClientInstance->http_job_condition == NULL &&
+            (iotHubClientInstance->http_job_condition = Condition_Init()) == NULL)
+        {
+            LogError("unable to Condition_Init");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_09_028: [ The structure shall be queued as a job for the HTTP worker threads of the client. ]*/
+        else if ((item = singlylinkedlist_add(*job_list, threadInfo)) == NULL)
+        {
+            LogError("Adding item to list failed");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            if (iotHubClientInstance->http_idle_worker_count > 0)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_09_035: [ If an HTTP worker thread is waiting for a job, it shall be woken up to run the job instead of starting a new worker thread. ]*/
+                if (Condition_Post(iotHubClientInstance->http_job_condition) != COND_OK)
+                {
+                    LogError("unable to Condition_Post");
+                }
+            }
+            /*Codes_SRS_IOTHUBCLIENT_09_029: [ A new HTTP worker thread shall be started only while fewer than `HTTP_WORKER_POOL_SIZE` are running; otherwise the job waits for a running worker. ]*/
+            else if (iotHubClientInstance->http_worker_count < HTTP_WORKER_POOL_SIZE &&
+                start_http_worker(iotHubClientInstance) != 0)
+            {
+                LogError("unable to start an HTTP worker");
+            }
+
+            if (iotHubClientInstance->http_worker_count == 0)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_02_053: [ If copying to the structure or spawning the thread fails, then IoTHubClient_UploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+                (void)singlylinkedlist_remove(*job_list, item);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+
+        (void)Unlock(iotHubClientInstance->LockHandle);
+    }
+
+    return result;
 }
 
-static void iothub_ll_get_device_twin_async_callback(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* userContextCallback)
+/*stops the HTTP worker threads once they run the queued jobs, then joins them*/
+static void destroy_http_workers(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance)
 {
-    IOTHUB_QUEUE_CONSOLIDATED_CONTEXT* queue_context = (IOTHUB_QUEUE_CONSOLIDATED_CONTEXT*)userContextCallback;
+    bool workers_running = true;
+    size_t index;
 
-    if (queue_context != NULL)
+    if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
     {
-        USER_CALLBACK_INFO queue_cb_info;
-        queue_cb_info.type = CALLBACK_TYPE_DEVICE_TWIN;
-        queue_cb_info.userContextCallback = queue_context->userContext;
-        queue_cb_info.iothub_callback.dev_twin_cb_info.update_state = update_state;
-        queue_cb_info.iothub_callback.dev_twin_cb_info.userCallback = queue_context->userCallback.getTwin;
-        queue_cb_info.iothub_callback.dev_twin_cb_info.userContext = queue_context->userContext;
+        LogError("unable to Lock - - will still proceed to stop the HTTP workers");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_09_036: [ `IoTHubClient_Destroy` shall wake up each of the HTTP worker threads waiting for a job so that they exit. ]*/
+        iotHubClientInstance->stop_http_workers = true;
 
-        if (payLoad == NULL)
+        if (iotHubClientInstance->http_job_condition != NULL)
         {
-            queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad = NULL;
-            queue_cb_info.iothub_callback.dev_twin_cb_info.size = 0;
+            /*a post wakes up a single waiting worker, so there is one per running worker*/
+            for (index = 0; index < iotHubClientInstance->http_worker_count; index++)
+            {
+                if (Condition_Post(iotHubClientInstance->http_job_condition) != COND_OK)
+                {
+                    LogError("unable to Condition_Post");
+                }
+            }
+        }
+
+        (void)Unlock(iotHubClientInstance->LockHandle);
+    }
+
+    while (workers_running)
+    {
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            LogError("unable to Lock - - will still proceed to join the HTTP workers");
+            workers_running = false;
         }
         else
         {
-            queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad = (unsigned char*)malloc(size);
+            workers_running = (iotHubClientInstance->http_worker_count > 0);
+            (void)Unlock(iotHubClientInstance->LockHandle);
 
-            if (queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad == NULL)
-            {
-                LogError("Failure allocating payload in get device twin callback.");
-                queue_cb_info.iothub_callback.dev_twin_cb_info.size = 0;
-            }
-            else
+            if (workers_running)
             {
-                (void)memcpy(queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad, payLoad, size);
-                queue_cb_info.iothub_callback.dev_twin_cb_info.size = size;
+                (void)ThreadAPI_Sleep(1);
             }
         }
+    }
 
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+    for (index = 0; index < HTTP_WORKER_POOL_SIZE; index++)
+    {
+        if (iotHubClientInstance->http_workers[index].threadHandle != NULL)
         {
-            LogError("device twin callback userContextCallback vector push failed.");
-
-            if (queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad != NULL)
+            int notUsed;
+            if (ThreadAPI_Join(iotHubClientInstance->http_workers[index].threadHandle, &notUsed) != THREADAPI_OK)
             {
-                free(queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad);
+                LogError("unable to ThreadAPI_Join");
             }
         }
+    }
 
-        free(queue_context);
+    if (iotHubClientInstance->http_upload_job_list != NULL)
+    {
+        singlylinkedlist_destroy(iotHubClientInstance->http_upload_job_list);
     }
-    else
+
+    if (iotHubClientInstance->http_invoke_job_list != NULL)
     {
-        LogError("Get device twin callback userContextCallback NULL");
+        singlylinkedlist_destroy(iotHubClientInstance->http_invoke_job_list);
+    }
+
+    if (iotHubClientInstance->http_job_condition != NULL)
+    {
+        Condition_Deinit(iotHubClientInstance->http_job_condition);
     }
 }
 
+#endif // !defined(DONT_USE_UPLOADTOBLOB) || defined(USE_EDGE_MODULES)
+
 static void dispatch_user_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, VECTOR_HANDLE call_backs)
 {
     size_t callbacks_length = VECTOR_size(call_backs);
@@ -591,6 +1231,7 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientIns
     IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC message_callback = NULL;
     IOTHUB_CLIENT_CORE_HANDLE message_user_context_handle = NULL;
     IOTHUB_CLIENT_CORE_HANDLE method_user_context_handle = NULL;
+    size_t method_max_concurrency = 0;
 
     // Make a local copy of these callbacks, as we don't run with a lock held and iotHubClientInstance may change mid-run.
     if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
@@ -604,6 +1245,7 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientIns
         device_method_callback = iotHubClientInstance->device_method_callback;
         inbound_device_method_callback = iotHubClientInstance->inbound_device_method_callback;
         message_callback = iotHubClientInstance->message_callback;
+        method_max_concurrency = iotHubClientInstance->method_max_concurrency;
         if (iotHubClientInstance->method_user_context)
         {
             method_user_context_handle = iotHubClientInstance->method_user_context->iotHubClientHandle;
@@ -673,43 +1315,20 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientIns
             case CALLBACK_TYPE_DEVICE_METHOD:
                 if (device_method_callback)
                 {
-                    const char* method_name = STRING_c_str(queued_cb->iothub_callback.method_cb_info.method_name);
-                    const unsigned char* payload = BUFFER_u_char(queued_cb->iothub_callback.method_cb_info.payload);
-                    size_t payload_len = BUFFER_length(queued_cb->iothub_callback.method_cb_info.payload);
-
-                    unsigned char* payload_resp = NULL;
-                    size_t response_size = 0;
-                    int status = device_method_callback(method_name, payload, payload_len, &payload_resp, &response_size, queued_cb->userContextCallback);
-
-                    if (payload_resp && (response_size > 0))
-                    {
-                        IOTHUB_CLIENT_RESULT result = IoTHubClientCore_DeviceMethodResponse(method_user_context_handle, queued_cb->iothub_callback.method_cb_info.method_id, (const unsigned char*)payload_resp, response_size, status);
-                        if (result != IOTHUB_CLIENT_OK)
-                        {
-                            LogError("IoTHubClientCore_LL_DeviceMethodResponse failed");
-                        }
-                    }
-
-                    BUFFER_delete(queued_cb->iothub_callback.method_cb_info.payload);
-                    STRING_delete(queued_cb->iothub_callback.method_cb_info.method_name);
-
-                    if (payload_resp)
+                    /*Codes_SRS_IOTHUBCLIENT_09_017: [ If `method_max_concurrency` is greater than 0, the device method shall be queued to run on a method worker thread. ]*/
+                    if (method_max_concurrency == 0 || queue_device_method_invocation(iotHubClientInstance, queued_cb) != 0)
                     {
-                        free(payload_resp);
+                        invoke_device_method(queued_cb, device_method_callback, NULL, method_user_context_handle);
                     }
                 }
                 break;
             case CALLBACK_TYPE_INBOUD_DEVICE_METHOD:
                 if (inbound_device_method_callback)
                 {
-                    const char* method_name = STRING_c_str(queued_cb->iothub_callback.method_cb_info.method_name);
-                    const unsigned char* payload = BUFFER_u_char(queued_cb->iothub_callback.method_cb_info.payload);
-                    size_t payload_len = BUFFER_length(queued_cb->iothub_callback.method_cb_info.payload);
-
-                    inbound_device_method_callback(method_name, payload, payload_len, queued_cb->iothub_callback.method_cb_info.method_id, queued_cb->userContextCallback);
-
-                    BUFFER_delete(queued_cb->iothub_callback.method_cb_info.payload);
-                    STRING_delete(queued_cb->iothub_callback.method_cb_info.method_name);
+                    if (method_max_concurrency == 0 || queue_device_method_invocation(iotHubClientInstance, queued_cb) != 0)
+                    {
+                        invoke_device_method(queued_cb, NULL, inbound_device_method_callback, method_user_context_handle);
+                    }
                 }
                 break;
             case CALLBACK_TYPE_MESSAGE:
@@ -767,7 +1386,6 @@ static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
 {
     IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)iotHubClientHandle;
 
-    garbageCollectorImpl(iotHubClientInstance);
     if (Lock(iotHubClientInstance->LockHandle) == LOCK_OK)
     {
         VECTOR_HANDLE call_backs = VECTOR_move(iotHubClientInstance->saved_user_callback_list);
@@ -811,7 +1429,6 @@ static int ScheduleWork_Thread(void* threadArgument)
                 /* Codes_SRS_IOTHUBCLIENT_01_039: [All calls to IoTHubClientCore_LL_DoWork shall be protected by the lock created in IotHubClient_Create.] */
                 IoTHubClientCore_LL_DoWork(iotHubClientInstance->IoTHubClientLLHandle);
 
-                garbageCollectorImpl(iotHubClientInstance);
                 VECTOR_HANDLE call_backs = VECTOR_move(iotHubClientInstance->saved_user_callback_list);
                 sleeptime_in_ms = (unsigned int)iotHubClientInstance->do_work_freq_ms; // Update the sleepval within the locked thread.
                 (void)Unlock(iotHubClientInstance->LockHandle);
@@ -1217,13 +1834,27 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
             IoTHubTransport_JoinWorkerThread(iotHubClientInstance->TransportHandle, iotHubClientHandle);
         }
 
+        /*Codes_SRS_IOTHUBCLIENT_09_021: [ IoTHubClient_Destroy shall wait for the method worker threads to finish the device methods they run and free the queued device methods that did not run. ]*/
+        if (iotHubClientInstance->method_invocation_list != NULL)
+        {
+            destroy_device_method_invocations(iotHubClientInstance);
+        }
+
+#if !defined(DONT_USE_UPLOADTOBLOB) || defined(USE_EDGE_MODULES)
+        /*Codes_SRS_IOTHUBCLIENT_02_069: [ IoTHubClient_Destroy shall free all data created by IoTHubClient_UploadToBlobAsync ]*/
+        /*Codes_SRS_IOTHUBCLIENT_09_032: [ IoTHubClient_Destroy shall wait for the HTTP worker threads to run the queued HTTP jobs and join them. ]*/
+        if (iotHubClientInstance->http_upload_job_list != NULL || iotHubClientInstance->http_invoke_job_list != NULL)
+        {
+            destroy_http_workers(iotHubClientInstance);
+        }
+#endif
+
         if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
         {
             LogError("unable to Lock - - will still proceed to try to end the thread without locking");
         }
 
-        /*Codes_SRS_IOTHUBCLIENT_02_069: [ IoTHubClient_Destroy shall free all data created by IoTHubClient_UploadToBlobAsync ]*/
-        /*wait for all uploading threads to finish*/
+        /*wait for all method worker threads to finish*/
         while (singlylinkedlist_get_head_item(iotHubClientInstance->httpWorkerThreadInfoList) != NULL)
         {
             garbageCollectorImpl(iotHubClientInstance);
@@ -1298,6 +1929,42 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
     }
 }
 
+static IOTHUB_CLIENT_RESULT send_event_to_ll(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientInstance->created_with_transport_handle != 0 || eventConfirmationCallback == NULL)
+    {
+        result = IoTHubClientCore_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBCLIENT_07_001: [ IoTHubClient_SendEventAsync shall allocate a IOTHUB_QUEUE_CONTEXT object to be sent to the IoTHubClientCore_LL_SendEventAsync function as a user context. ] */
+        IOTHUB_QUEUE_CONTEXT* queue_context = (IOTHUB_QUEUE_CONTEXT*)malloc(sizeof(IOTHUB_QUEUE_CONTEXT));
+        if (queue_context == NULL)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Failed allocating QUEUE_CONTEXT");
+        }
+        else
+        {
+            queue_context->iotHubClientHandle = iotHubClientInstance;
+            queue_context->userContextCallback = userContextCallback;
+            queue_context->callbackFunction.eventConfirmationCallback = eventConfirmationCallback;
+            /* Codes_SRS_IOTHUBCLIENT_01_012: [IoTHubClient_SendEventAsync shall call IoTHubClientCore_LL_SendEventAsync, while passing the IoTHubClientCore_LL handle created by IoTHubClient_Create and the parameters eventMessageHandle, eventConfirmationCallback and userContextCallback.] */
+            /* Codes_SRS_IOTHUBCLIENT_01_013: [When IoTHubClientCore_LL_SendEventAsync is called, IoTHubClient_SendEventAsync shall return the result of IoTHubClientCore_LL_SendEventAsync.] */
+            result = IoTHubClientCore_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, iothub_ll_event_confirm_callback, queue_context);
+            if (result != IOTHUB_CLIENT_OK)
+            {
+                LogError("IoTHubClientCore_LL_SendEventAsync failed");
+                free(queue_context);
+            }
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1330,37 +1997,35 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE i
             }
             else
             {
-                if (iotHubClientInstance->created_with_transport_handle != 0 || eventConfirmationCallback == NULL)
-                {
-                    result = IoTHubClientCore_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
-                }
-                else
+                bool locked = true;
+
+                if (iotHubClientInstance->send_queue_full_policy == IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK)
                 {
-                    /* Codes_SRS_IOTHUBCLIENT_07_001: [ IoTHubClient_SendEventAsync shall allocate a IOTHUB_QUEUE_CONTEXT object to be sent to the IoTHubClientCore_LL_SendEventAsync function as a user context. ] */
-                    IOTHUB_QUEUE_CONTEXT* queue_context = (IOTHUB_QUEUE_CONTEXT*)malloc(sizeof(IOTHUB_QUEUE_CONTEXT));
-                    if (queue_context == NULL)
-                    {
-                        result = IOTHUB_CLIENT_ERROR;
-                        LogError("Failed allocating QUEUE_CONTEXT");
-                    }
-                    else
+                    /* Codes_SRS_IOTHUBCLIENT_09_022: [ If the send queue full policy is `IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK`, `IoTHubClient_SendEventAsync` shall call `IoTHubClientCore_LL_CheckSendQueueRoom` and, while it returns `IOTHUB_CLIENT_QUEUE_FULL`, release the lock, sleep for `do_work_freq_ms` and check again. ]*/
+                    // Only the room is checked while waiting, so the LL layer sees a single send and counts a rejection at most once.
+                    while (IoTHubClientCore_LL_CheckSendQueueRoom(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle) == IOTHUB_CLIENT_QUEUE_FULL)
                     {
-                        queue_context->iotHubClientHandle = iotHubClientInstance;
-                        queue_context->userContextCallback = userContextCallback;
-                        queue_context->callbackFunction.eventConfirmationCallback = eventConfirmationCallback;
-                        /* Codes_SRS_IOTHUBCLIENT_01_012: [IoTHubClient_SendEventAsync shall call IoTHubClientCore_LL_SendEventAsync, while passing the IoTHubClientCore_LL handle created by IoTHubClient_Create and the parameters eventMessageHandle, eventConfirmationCallback and userContextCallback.] */
-                        /* Codes_SRS_IOTHUBCLIENT_01_013: [When IoTHubClientCore_LL_SendEventAsync is called, IoTHubClient_SendEventAsync shall return the result of IoTHubClientCore_LL_SendEventAsync.] */
-                        result = IoTHubClientCore_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, iothub_ll_event_confirm_callback, queue_context);
-                        if (result != IOTHUB_CLIENT_OK)
+                        (void)Unlock(iotHubClientInstance->LockHandle);
+                        ThreadAPI_Sleep((unsigned int)iotHubClientInstance->do_work_freq_ms);
+
+                        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
                         {
-                            LogError("IoTHubClientCore_LL_SendEventAsync failed");
-                            free(queue_context);
+                            result = IOTHUB_CLIENT_ERROR;
+                            LogError("Could not acquire lock");
+                            locked = false;
+                            break;
                         }
                     }
                 }
 
-                /* Codes_SRS_IOTHUBCLIENT_01_025: [IoTHubClient_SendEventAsync shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
-                (void)Unlock(iotHubClientInstance->LockHandle);
+                if (locked)
+                {
+                    /* Codes_SRS_IOTHUBCLIENT_09_033: [ An event that can never fit in the send queue shall not be waited for; `IoTHubClient_SendEventAsync` shall return the result of `IoTHubClientCore_LL_SendEventAsync` for it. ]*/
+                    result = send_event_to_ll(iotHubClientInstance, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+
+                    /* Codes_SRS_IOTHUBCLIENT_01_025: [IoTHubClient_SendEventAsync shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
+                    (void)Unlock(iotHubClientInstance->LockHandle);
+                }
             }
         }
     }
@@ -1756,6 +2421,22 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SetOption(IOTHUB_CLIENT_CORE_HANDLE iotHub
                     LogError("invalid value: OPTION_MESSAGE_TIMEOUT cannot exceed the value of OPTION_DO_WORK_FREQUENCY_IN_MS ");
                 }
             }
+            /*Codes_SRS_IOTHUBCLIENT_09_016: [ If parameter `optionName` is `OPTION_METHOD_MAX_CONCURRENCY` then `IoTHubClientCore_SetOption` shall set `method_max_concurrency` parameter of `IoTHubClientInstance` ]*/
+            else if (strcmp(OPTION_METHOD_MAX_CONCURRENCY, optionName) == 0)
+            {
+                if (*(const size_t*)value > 0 &&
+                    iotHubClientInstance->method_invocation_list == NULL &&
+                    (iotHubClientInstance->method_invocation_list = singlylinkedlist_create()) == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("unable to create the device method invocation list");
+                }
+                else
+                {
+                    iotHubClientInstance->method_max_concurrency = *(const size_t*)value;
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
             else
             {
                 /*Codes_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClientCore_LL_SetOption passing the same parameters and return what IoTHubClientCore_LL_SetOption returns.] */
@@ -1764,6 +2445,11 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SetOption(IOTHUB_CLIENT_CORE_HANDLE iotHub
                 {
                     LogError("IoTHubClientCore_LL_SetOption failed");
                 }
+                /*Codes_SRS_IOTHUBCLIENT_09_023: [ If parameter `optionName` is `OPTION_SEND_QUEUE_FULL_POLICY` and `IoTHubClientCore_LL_SetOption` succeeds, `IoTHubClientCore_SetOption` shall keep the policy to carry out `IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK`. ]*/
+                else if (strcmp(OPTION_SEND_QUEUE_FULL_POLICY, optionName) == 0)
+                {
+                    iotHubClientInstance->send_queue_full_policy = *(const IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY*)value;
+                }
             }
             (void)Unlock(iotHubClientInstance->LockHandle);
         }
@@ -2183,74 +2869,6 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_DeviceMethodResponse(IOTHUB_CLIENT_CORE_HA
     return result;
 }
 
-#if !defined(DONT_USE_UPLOADTOBLOB) || defined(USE_EDGE_MODULES)
-static IOTHUB_CLIENT_RESULT startHttpWorkerThread(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, HTTPWORKER_THREAD_INFO* threadInfo, THREAD_START_FUNC httpWorkerThreadFunc)
-{
-    IOTHUB_CLIENT_RESULT result;
-
-    LIST_ITEM_HANDLE item;
-
-    // StartWorkerThreadIfNeeded creates the "main" worker thread used for transports.  Though its not used
-    // for these HTTP based worker threads (see ThreadAPI_Create call below) the main one is needed for garbage collection.
-    if ((result = StartWorkerThreadIfNeeded(iotHubClientHandle)) != IOTHUB_CLIENT_OK)
-    {
-        /*Codes_SRS_IOTHUBCLIENT_02_053: [ If copying to the structure or spawning the thread fails, then IoTHubClient_UploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
-        LogError("Could not start worker thread");
-    }
-    else if (Lock(threadInfo->iotHubClientHandle->LockHandle) != LOCK_OK)
-    {
-        LogError("Lock failed");
-        result = IOTHUB_CLIENT_ERROR;
-    }
-    else
-    {
-        if ((item = singlylinkedlist_add(threadInfo->iotHubClientHandle->httpWorkerThreadInfoList, threadInfo)) == NULL)
-        {
-            LogError("Adding item to list failed");
-            result = IOTHUB_CLIENT_ERROR;
-        }
-        else if (ThreadAPI_Create(&threadInfo->threadHandle, httpWorkerThreadFunc, threadInfo) != THREADAPI_OK)
-        {
-            /*Codes_SRS_IOTHUBCLIENT_02_053: [ If copying to the structure or spawning the thread fails, then IoTHubClient_UploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
-            LogError("unable to ThreadAPI_Create");
-            // Remove the item from linked list here, while we're still under lock.  Final garbage collector also does it under lock.
-            (void)singlylinkedlist_remove(threadInfo->iotHubClientHandle->httpWorkerThreadInfoList, item);
-            result = IOTHUB_CLIENT_ERROR;
-        }
-        else
-        {
-            result = IOTHUB_CLIENT_OK;
-        }
-        (void)Unlock(threadInfo->iotHubClientHandle->LockHandle);
-    }
-
-    return result;
-}
-
-static int markThreadReadyToBeGarbageCollected(HTTPWORKER_THREAD_INFO* threadInfo)
-{
-    /*Codes_SRS_IOTHUBCLIENT_02_071: [ The thread shall mark itself as disposable. ]*/
-    if (Lock(threadInfo->lockGarbage) != LOCK_OK)
-    {
-        LogError("unable to Lock - trying anyway");
-        threadInfo->canBeGarbageCollected = 1;
-    }
-    else
-    {
-        threadInfo->canBeGarbageCollected = 1;
-
-        if (Unlock(threadInfo->lockGarbage) != LOCK_OK)
-        {
-            LogError("unable to Unlock after locking");
-        }
-    }
-
-    ThreadAPI_Exit(0);
-    return 0;
-}
-
-#endif // !defined(DONT_USE_UPLOADTOBLOB) || defined(USE_EDGE_MODULES)
-
 #if !defined(DONT_USE_UPLOADTOBLOB)
 static HTTPWORKER_THREAD_INFO* allocateUploadToBlob(const char* destinationFileName, IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, void* context)
 {
@@ -2273,12 +2891,6 @@ static HTTPWORKER_THREAD_INFO* allocateUploadToBlob(const char* destinationFileN
             freeHttpWorkerThreadInfo(threadInfo);
             threadInfo = NULL;
         }
-        else if ((threadInfo->lockGarbage = Lock_Init()) == NULL)
-        {
-            LogError("unable to allocate a lock");
-            freeHttpWorkerThreadInfo(threadInfo);
-            threadInfo = NULL;
-        }
     }
 
     return threadInfo;
@@ -2314,17 +2926,28 @@ static IOTHUB_CLIENT_RESULT initializeUploadToBlobData(HTTPWORKER_THREAD_INFO* t
 }
 
 
-static int uploadingThread(void *data)
+static int uploadToBlob_job(void *data)
 {
     IOTHUB_CLIENT_FILE_UPLOAD_RESULT upload_result;
     HTTPWORKER_THREAD_INFO* threadInfo = (HTTPWORKER_THREAD_INFO*)data;
 
-    srand((unsigned int)get_time(NULL));
-
     /*it so happens that IoTHubClientCore_LL_UploadToBlob is thread-safe because there's no saved state in the handle and there are no globals, so no need to protect it*/
     /*not having it protected means multiple simultaneous uploads can happen*/
+    if (threadInfo->uploadBlobSavedData.sourceFilePath != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_09_026: [ The thread shall call `IoTHubClientCore_LL_UploadFileToBlob` passing the information packed in the structure. ]*/
+        if (IoTHubClientCore_LL_UploadFileToBlob(threadInfo->iotHubClientHandle->IoTHubClientLLHandle, threadInfo->destinationFileName, threadInfo->uploadBlobSavedData.sourceFilePath) == IOTHUB_CLIENT_OK)
+        {
+            upload_result = FILE_UPLOAD_OK;
+        }
+        else
+        {
+            LogError("unable to IoTHubClientCore_LL_UploadFileToBlob");
+            upload_result = FILE_UPLOAD_ERROR;
+        }
+    }
     /*Codes_SRS_IOTHUBCLIENT_02_054: [ The thread shall call IoTHubClientCore_LL_UploadToBlob passing the information packed in the structure. ]*/
-    if (IoTHubClientCore_LL_UploadToBlob(threadInfo->iotHubClientHandle->IoTHubClientLLHandle, threadInfo->destinationFileName, threadInfo->uploadBlobSavedData.source, threadInfo->uploadBlobSavedData.size) == IOTHUB_CLIENT_OK)
+    else if (IoTHubClientCore_LL_UploadToBlob(threadInfo->iotHubClientHandle->IoTHubClientLLHandle, threadInfo->destinationFileName, threadInfo->uploadBlobSavedData.source, threadInfo->uploadBlobSavedData.size) == IOTHUB_CLIENT_OK)
     {
         upload_result = FILE_UPLOAD_OK;
     }
@@ -2340,7 +2963,7 @@ static int uploadingThread(void *data)
         threadInfo->uploadBlobSavedData.iotHubClientFileUploadCallback(upload_result, threadInfo->context);
     }
 
-    return markThreadReadyToBeGarbageCollected(threadInfo);
+    return 0;
 }
 
 IOTHUB_CLIENT_RESULT IoTHubClientCore_UploadToBlobAsync(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, const char* destinationFileName, const unsigned char* source, size_t size, IOTHUB_CLIENT_FILE_UPLOAD_CALLBACK iotHubClientFileUploadCallback, void* context)
@@ -2381,8 +3004,8 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_UploadToBlobAsync(IOTHUB_CLIENT_CORE_HANDL
             LogError("unable to initialize upload blob info");
             result = IOTHUB_CLIENT_ERROR;
         }
-        /*Codes_SRS_IOTHUBCLIENT_02_052: [ IoTHubClient_UploadToBlobAsync shall spawn a thread passing the structure build in SRS IOTHUBCLIENT 02 051 as thread data.]*/
-        else if ((result = startHttpWorkerThread(iotHubClientHandle, threadInfo, uploadingThread)) != IOTHUB_CLIENT_OK)
+        /*Codes_SRS_IOTHUBCLIENT_02_052: [ IoTHubClient_UploadToBlobAsync shall queue the structure build in SRS IOTHUBCLIENT 02 051 as an HTTP job. ]*/
+        else if ((result = queueHttpWorkerJob(iotHubClientHandle, threadInfo, uploadToBlob_job)) != IOTHUB_CLIENT_OK)
         {
             /*Codes_SRS_IOTHUBCLIENT_02_053: [ If copying to the structure or spawning the thread fails, then IoTHubClient_UploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
             LogError("unable to start upload thread");
@@ -2397,7 +3020,53 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_UploadToBlobAsync(IOTHUB_CLIENT_CORE_HANDL
     return result;
 }
 
-static int uploadMultipleBlock_thread(void* data)
+IOTHUB_CLIENT_RESULT IoTHubClientCore_UploadFileToBlobAsync(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, const char* destinationFileName, const char* sourceFilePath, IOTHUB_CLIENT_FILE_UPLOAD_CALLBACK iotHubClientFileUploadCallback, void* context)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_09_024: [ If `iotHubClientHandle`, `destinationFileName` or `sourceFilePath` are NULL, `IoTHubClientCore_UploadFileToBlobAsync` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (destinationFileName == NULL) ||
+        (sourceFilePath == NULL)
+        )
+    {
+        LogError("invalid parameters iotHubClientHandle = %p, destinationFileName = %p, sourceFilePath = %p", iotHubClientHandle, destinationFileName, sourceFilePath);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_09_025: [ `IoTHubClientCore_UploadFileToBlobAsync` shall copy `destinationFileName`, `sourceFilePath`, `iotHubClientFileUploadCallback` and `context` into a structure and queue it as an HTTP job. ]*/
+        HTTPWORKER_THREAD_INFO *threadInfo = allocateUploadToBlob(destinationFileName, iotHubClientHandle, context);
+        if (threadInfo == NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_09_027: [ If copying to the structure or spawning the thread fails, `IoTHubClientCore_UploadFileToBlobAsync` shall fail and return `IOTHUB_CLIENT_ERROR`. ]*/
+            LogError("unable to create upload thread info");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if (mallocAndStrcpy_s(&threadInfo->uploadBlobSavedData.sourceFilePath, sourceFilePath) != 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_09_027: [ If copying to the structure or spawning the thread fails, `IoTHubClientCore_UploadFileToBlobAsync` shall fail and return `IOTHUB_CLIENT_ERROR`. ]*/
+            LogError("unable to copy the source file path");
+            freeHttpWorkerThreadInfo(threadInfo);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            threadInfo->uploadBlobSavedData.iotHubClientFileUploadCallback = iotHubClientFileUploadCallback;
+
+            if ((result = queueHttpWorkerJob(iotHubClientHandle, threadInfo, uploadToBlob_job)) != IOTHUB_CLIENT_OK)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_09_027: [ If copying to the structure or spawning the thread fails, `IoTHubClientCore_UploadFileToBlobAsync` shall fail and return `IOTHUB_CLIENT_ERROR`. ]*/
+                LogError("unable to start upload thread");
+                freeHttpWorkerThreadInfo(threadInfo);
+            }
+        }
+    }
+
+    return result;
+}
+
+static int uploadMultipleBlock_job(void* data)
 {
     HTTPWORKER_THREAD_INFO* threadInfo = (HTTPWORKER_THREAD_INFO*)data;
     IOTHUB_CLIENT_CORE_LL_HANDLE llHandle = threadInfo->iotHubClientHandle->IoTHubClientLLHandle;
@@ -2405,8 +3074,6 @@ static int uploadMultipleBlock_thread(void* data)
     /*Codes_SRS_IOTHUBCLIENT_99_078: [ The thread shall call `IoTHubClientCore_LL_UploadMultipleBlocksToBlob` or `IoTHubClientCore_LL_UploadMultipleBlocksToBlobEx` passing the information packed in the structure. ]*/
     IOTHUB_CLIENT_RESULT result;
 
-    srand((unsigned int)get_time(NULL));
-
     if (threadInfo->uploadBlobMultiblockSavedData.getDataCallback != NULL)
     {
         result = IoTHubClientCore_LL_UploadMultipleBlocksToBlob(llHandle, threadInfo->destinationFileName, threadInfo->uploadBlobMultiblockSavedData.getDataCallback, threadInfo->context);
@@ -2415,7 +3082,6 @@ static int uploadMultipleBlock_thread(void* data)
     {
         result = IoTHubClientCore_LL_UploadMultipleBlocksToBlobEx(llHandle, threadInfo->destinationFileName, threadInfo->uploadBlobMultiblockSavedData.getDataCallbackEx, threadInfo->context);
     }
-    (void)markThreadReadyToBeGarbageCollected(threadInfo);
 
     return result;
 }
@@ -2457,7 +3123,8 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_UploadMultipleBlocksToBlobAsync(IOTHUB_CLI
             threadInfo->uploadBlobMultiblockSavedData.getDataCallback = getDataCallback;
             threadInfo->uploadBlobMultiblockSavedData.getDataCallbackEx = getDataCallbackEx;
 
-            if ((result = startHttpWorkerThread(iotHubClientHandle, threadInfo, uploadMultipleBlock_thread)) != IOTHUB_CLIENT_OK)
+            /*Codes_SRS_IOTHUBCLIENT_99_076: [ `IoTHubClient_UploadMultipleBlocksToBlobAsync(Ex)` shall queue the structure build in SRS IOTHUBCLIENT 99 075 as an HTTP job. ]*/
+            if ((result = queueHttpWorkerJob(iotHubClientHandle, threadInfo, uploadMultipleBlock_job)) != IOTHUB_CLIENT_OK)
             {
                 /*Codes_SRS_IOTHUBCLIENT_02_053: [ If copying to the structure or spawning the thread fails, then IoTHubClient_UploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
                 LogError("unable to start upload thread");
@@ -2575,25 +3242,17 @@ HTTPWORKER_THREAD_INFO * allocateMethodInvoke(IOTHUB_CLIENT_CORE_HANDLE iotHubCl
             freeHttpWorkerThreadInfo(threadInfo);
             threadInfo = NULL;
         }
-        else if ((threadInfo->lockGarbage = Lock_Init()) == NULL)
-        {
-            LogError("unable to allocate a lock");
-            freeHttpWorkerThreadInfo(threadInfo);
-            threadInfo = NULL;
-        }
     }
 
     return threadInfo;
 }
 
-static int uploadMethodInvoke_thread(void* data)
+static int methodInvoke_job(void* data)
 {
     IOTHUB_CLIENT_RESULT result;
 
     HTTPWORKER_THREAD_INFO* threadInfo = (HTTPWORKER_THREAD_INFO*)data;
 
-    srand((unsigned int)get_time(NULL));
-
     int responseStatus;
     unsigned char* responsePayload = NULL;
     size_t responsePayloadSize;
@@ -2618,7 +3277,6 @@ static int uploadMethodInvoke_thread(void* data)
         free(responsePayload);
     }
 
-    (void)markThreadReadyToBeGarbageCollected(threadInfo);
     return result;
 }
 
@@ -2638,7 +3296,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_GenericMethodInvoke(IOTHUB_CLIENT_CORE_HAN
         LogError("failed allocating method invoke thread info");
         result = IOTHUB_CLIENT_ERROR;
     }
-    else if ((result = startHttpWorkerThread(iotHubClientHandle, threadInfo, uploadMethodInvoke_thread)) != IOTHUB_CLIENT_OK)
+    else if ((result = queueHttpWorkerJob(iotHubClientHandle, threadInfo, methodInvoke_job)) != IOTHUB_CLIENT_OK)
     {
         LogError("unable to start method invoke thread");
         freeHttpWorkerThreadInfo(threadInfo);
@@ -25,6 +25,9 @@
 #include "internal/iothub_client_authorization.h"
 #include "internal/iothub_client_private.h"
 #include "internal/iothub_client_diagnostic.h"
+#include "internal/iothub_client_twin_patch.h"
+#include "internal/iothub_client_twin_cache_private.h"
+#include "internal/iothub_client_rate_limiter_private.h"
 #include "internal/iothubtransport.h"
 
 #ifndef DONT_USE_UPLOADTOBLOB
@@ -35,15 +38,21 @@
 #include "azure_c_shared_utility/envvariable.h"
 #include "azure_prov_client/iothub_security_factory.h"
 #include "internal/iothub_client_edge.h"
+#include "internal/iothub_client_trust_bundle.h"
 #endif
 
 #define LOG_ERROR_RESULT LogError("result = %s", MU_ENUM_TO_STRING(IOTHUB_CLIENT_RESULT, result));
 #define INDEFINITE_TIME ((time_t)(-1))
 
+#define INPUT_ROUTE_INITIAL_BUCKET_COUNT 8
+#define FNV_32_OFFSET_BASIS 2166136261u
+#define FNV_32_PRIME 16777619u
+
 MU_DEFINE_ENUM_STRINGS_WITHOUT_INVALID(IOTHUB_CLIENT_FILE_UPLOAD_RESULT, IOTHUB_CLIENT_FILE_UPLOAD_RESULT_VALUES);
 MU_DEFINE_ENUM_STRINGS_WITHOUT_INVALID(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
 MU_DEFINE_ENUM_STRINGS_WITHOUT_INVALID(IOTHUB_CLIENT_RETRY_POLICY, IOTHUB_CLIENT_RETRY_POLICY_VALUES);
 MU_DEFINE_ENUM_STRINGS_WITHOUT_INVALID(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_STATUS_VALUES);
+MU_DEFINE_ENUM_STRINGS_WITHOUT_INVALID(IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY, IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY_VALUES);
 MU_DEFINE_ENUM_STRINGS_WITHOUT_INVALID(IOTHUB_IDENTITY_TYPE, IOTHUB_IDENTITY_TYPE_VALUE);
 MU_DEFINE_ENUM_STRINGS_WITHOUT_INVALID(IOTHUB_PROCESS_ITEM_RESULT, IOTHUB_PROCESS_ITEM_RESULT_VALUE);
 MU_DEFINE_ENUM_STRINGS_WITHOUT_INVALID(IOTHUB_CLIENT_IOTHUB_METHOD_STATUS, IOTHUB_CLIENT_IOTHUB_METHOD_STATUS_VALUES);
@@ -79,6 +88,8 @@ typedef struct IOTHUB_EVENT_CALLBACK_TAG
     IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC_EX callbackAsyncEx;
     void* userContextCallback;
     void* userContextCallbackEx;
+    uint32_t inputNameHash;
+    struct IOTHUB_EVENT_CALLBACK_TAG* nextRoute; /*next named callback in the same input route bucket*/
 }IOTHUB_EVENT_CALLBACK;
 
 typedef struct IOTHUB_MESSAGE_CALLBACK_DATA_TAG
@@ -89,17 +100,37 @@ typedef struct IOTHUB_MESSAGE_CALLBACK_DATA_TAG
     void* userContextCallback;
 }IOTHUB_MESSAGE_CALLBACK_DATA;
 
+typedef struct IOTHUB_METHOD_RESPONSE_TAG
+{
+    DLIST_ENTRY entry;
+    METHOD_HANDLE method_id;
+    unsigned char* response;
+    size_t response_size;
+    int status_response;
+    tickcounter_ms_t ms_queuedAt;
+} IOTHUB_METHOD_RESPONSE;
+
 typedef struct GET_TWIN_CONTEXT_TAG
 {
     IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK callback;
     void* context;
 } GET_TWIN_CONTEXT;
 
+/*waitingToSend is kept ordered by a send order tag. Each message advances the tag of its priority lane by the cost below,
+so while all lanes have messages waiting 4 high priority messages are sent for each normal one, and 4 normal ones for each low one.*/
+#define PRIORITY_LANE_COUNT 3
+static const uint64_t PRIORITY_LANE_SEND_COST[PRIORITY_LANE_COUNT] = { 1, 4, 16 }; /*high, normal, low*/
+
+/*the send latencies are kept in power of two buckets, the last one also takes everything over 2^30 ms*/
+#define LATENCY_HISTOGRAM_BUCKETS 32
+
 typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG
 {
     DLIST_ENTRY waitingToSend;
+    DLIST_ENTRY waitingToAdmit; /*events held back by rate_limiter, in the order they will be moved to waitingToSend*/
     DLIST_ENTRY iot_msg_queue;
     DLIST_ENTRY iot_ack_queue;
+    DLIST_ENTRY waitingMethodResponses; /*device method responses held back by rate_limiter*/
     TRANSPORT_LL_HANDLE transportHandle;
     bool isSharedTransport;
     IOTHUB_DEVICE_HANDLE deviceHandle;
@@ -121,6 +152,7 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG
 #endif
 #ifdef USE_EDGE_MODULES
     IOTHUB_CLIENT_EDGE_HANDLE methodHandle;
+    const char* trusted_certificate;    // Reference to the trust bundle shared by the clients created from the environment.
 #endif
     uint32_t data_msg_id;
     bool complete_twin_update_encountered;
@@ -128,6 +160,38 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG
     STRING_HANDLE product_info;
     IOTHUB_DIAGNOSTIC_SETTING_DATA diagnostic_setting;
     SINGLYLINKEDLIST_HANDLE event_callbacks;  // List of IOTHUB_EVENT_CALLBACK's
+    IOTHUB_EVENT_CALLBACK** input_routes; /*named entries of event_callbacks hashed by input name, chained through nextRoute*/
+    size_t input_route_bucket_count;
+    size_t input_route_count;
+    IOTHUB_EVENT_CALLBACK* default_input_route; /*entry of event_callbacks registered without an input name*/
+    uint64_t last_send_order_tag_in_lane[PRIORITY_LANE_COUNT]; /*send order tag of the newest message of each priority lane*/
+    uint64_t last_send_order_tag; /*highest send order tag handed out so far*/
+    size_t reported_state_coalesce_ms; /*0 means reported state updates are not held back to be merged*/
+    size_t reported_state_coalesce_max_bytes; /*0 means coalesced reported state patches are not limited in size*/
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache; /*NULL unless OPTION_TWIN_CACHE is turned on*/
+    bool twin_cache_resync_pending;
+    IOTHUB_CLIENT_RATE_LIMITER_HANDLE rate_limiter; /*NULL unless OPTION_RATE_LIMITER is set, owned by the application*/
+    bool twin_update_throttled; /*the head of iot_msg_queue is waiting for a twin update token since twin_update_throttled_since*/
+    tickcounter_ms_t twin_update_throttled_since;
+    size_t send_queue_max_messages; /*0 means the number of queued events is not limited*/
+    size_t send_queue_max_bytes; /*0 means the size of the queued events is not limited*/
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY send_queue_full_policy;
+    size_t queued_messages; /*events accepted by SendEventAsync and not completed yet, wherever they are (waitingToAdmit, waitingToSend or the transport)*/
+    size_t queued_bytes;
+    uint64_t dropped_messages;
+    uint64_t rejected_messages;
+    uint64_t acked_messages;
+    uint64_t timed_out_messages;
+    uint64_t failed_messages;
+    bool is_connected;
+    bool was_connected; /*authenticated at least once, a later authentication is a reconnect*/
+    uint64_t reconnects;
+    uint64_t twin_updates_received;
+    uint64_t reported_states_completed;
+    uint64_t method_invocations;
+    bool latency_statistics;
+    uint64_t latency_histogram[LATENCY_HISTOGRAM_BUCKETS]; /*bucket i counts the latencies that need i bits, i.e. [2^(i-1), 2^i) ms*/
+    uint64_t latency_max_ms;
 }IOTHUB_CLIENT_CORE_LL_HANDLE_DATA;
 
 static const char HOSTNAME_TOKEN[] = "HostName";
@@ -328,10 +392,150 @@ static bool is_event_equal_for_match(LIST_ITEM_HANDLE list_item, const void* mat
     return is_event_equal((IOTHUB_EVENT_CALLBACK*)singlylinkedlist_item_get_value(list_item), (const char*)match_context);
 }
 
+static uint32_t get_input_name_hash(const char* input_name)
+{
+    uint32_t hash = FNV_32_OFFSET_BASIS;
+
+    while (*input_name != '\0')
+    {
+        hash ^= (uint32_t)(unsigned char)*input_name;
+        hash *= FNV_32_PRIME;
+        input_name++;
+    }
+
+    return hash;
+}
+
+static IOTHUB_EVENT_CALLBACK* find_input_route(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, const char* input_name)
+{
+    IOTHUB_EVENT_CALLBACK* result = NULL;
+
+    if ((input_name != NULL) && (handleData->input_routes != NULL))
+    {
+        uint32_t hash = get_input_name_hash(input_name);
+
+        result = handleData->input_routes[hash & (handleData->input_route_bucket_count - 1)];
+
+        while (result != NULL)
+        {
+            const char* route_input_name;
+
+            if ((result->inputNameHash == hash) &&
+                ((route_input_name = STRING_c_str(result->inputName)) != NULL) &&
+                (strcmp(route_input_name, input_name) == 0))
+            {
+                break;
+            }
+
+            result = result->nextRoute;
+        }
+    }
+
+    return result;
+}
+
+static int resize_input_routes(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, size_t bucket_count)
+{
+    int result;
+    IOTHUB_EVENT_CALLBACK** buckets;
+
+    if ((buckets = (IOTHUB_EVENT_CALLBACK**)malloc(bucket_count * sizeof(IOTHUB_EVENT_CALLBACK*))) == NULL)
+    {
+        LogError("Failed allocating input route table");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        size_t i;
+
+        memset(buckets, 0, bucket_count * sizeof(IOTHUB_EVENT_CALLBACK*));
+
+        for (i = 0; i < handleData->input_route_bucket_count; i++)
+        {
+            IOTHUB_EVENT_CALLBACK* route = handleData->input_routes[i];
+
+            while (route != NULL)
+            {
+                IOTHUB_EVENT_CALLBACK* next = route->nextRoute;
+                IOTHUB_EVENT_CALLBACK** bucket = &buckets[route->inputNameHash & (bucket_count - 1)];
+
+                route->nextRoute = *bucket;
+                *bucket = route;
+                route = next;
+            }
+        }
+
+        free(handleData->input_routes);
+        handleData->input_routes = buckets;
+        handleData->input_route_bucket_count = bucket_count;
+        result = 0;
+    }
+
+    return result;
+}
+
+static void add_input_route(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_EVENT_CALLBACK* event_callback)
+{
+    if (event_callback->inputName == NULL)
+    {
+        handleData->default_input_route = event_callback;
+    }
+    else
+    {
+        IOTHUB_EVENT_CALLBACK** bucket;
+
+        // Keeping the load factor at 1 keeps the chains short. If the table cannot grow, the routes stay valid in the current one.
+        if ((handleData->input_route_count >= handleData->input_route_bucket_count) &&
+            (resize_input_routes(handleData, handleData->input_route_bucket_count * 2) != 0))
+        {
+            LogError("Failed growing input route table, keeping %lu buckets", (unsigned long)handleData->input_route_bucket_count);
+        }
+
+        bucket = &handleData->input_routes[event_callback->inputNameHash & (handleData->input_route_bucket_count - 1)];
+        event_callback->nextRoute = *bucket;
+        *bucket = event_callback;
+        handleData->input_route_count++;
+    }
+}
+
+static void remove_input_route(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_EVENT_CALLBACK* event_callback)
+{
+    if (event_callback == handleData->default_input_route)
+    {
+        handleData->default_input_route = NULL;
+    }
+    else if (handleData->input_routes != NULL)
+    {
+        IOTHUB_EVENT_CALLBACK** link = &handleData->input_routes[event_callback->inputNameHash & (handleData->input_route_bucket_count - 1)];
+
+        while ((*link != NULL) && (*link != event_callback))
+        {
+            link = &(*link)->nextRoute;
+        }
+
+        if (*link != NULL)
+        {
+            *link = event_callback->nextRoute;
+            event_callback->nextRoute = NULL;
+            handleData->input_route_count--;
+        }
+    }
+}
+
 static void device_twin_data_destroy(IOTHUB_DEVICE_TWIN* client_item)
 {
-    CONSTBUFFER_DecRef(client_item->report_data_handle);
-    free(client_item);
+    while (client_item != NULL)
+    {
+        IOTHUB_DEVICE_TWIN* next_item = client_item->next_merged_report;
+
+        /*merged callers do not hold report data of their own*/
+        if (client_item->report_data_handle != NULL)
+        {
+            CONSTBUFFER_DecRef(client_item->report_data_handle);
+        }
+        free(client_item);
+        client_item = next_item;
+    }
 }
 
 static int create_edge_handle(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handle_data, const IOTHUB_CLIENT_CONFIG* config, const char* module_id)
@@ -487,6 +691,43 @@ static STRING_HANDLE make_product_info(const char* product, PLATFORM_INFO_OPTION
     return result;
 }
 
+/*Codes_SRS_IOTHUBCLIENT_LL_09_048: [ An event shall leave the send queue counters when it is completed, times out or is dropped. ]*/
+static void release_send_queue_space(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* queuedEvent)
+{
+    /*saturating, the transport could complete events it was handed before the counters were reset*/
+    if (handleData->queued_messages > 0)
+    {
+        handleData->queued_messages--;
+    }
+
+    if (handleData->queued_bytes > queuedEvent->message_size)
+    {
+        handleData->queued_bytes -= queuedEvent->message_size;
+    }
+    else
+    {
+        handleData->queued_bytes = 0;
+    }
+}
+
+static void record_send_latency(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, tickcounter_ms_t latency)
+{
+    size_t bucket = 0;
+    uint64_t remaining = (uint64_t)latency;
+
+    while ((remaining != 0) && (bucket < LATENCY_HISTOGRAM_BUCKETS - 1))
+    {
+        remaining >>= 1;
+        bucket++;
+    }
+
+    handleData->latency_histogram[bucket]++;
+    if ((uint64_t)latency > handleData->latency_max_ms)
+    {
+        handleData->latency_max_ms = (uint64_t)latency;
+    }
+}
+
 static void IoTHubClientCore_LL_SendComplete(PDLIST_ENTRY completed, IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* ctx)
 {
     /*Codes_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL, or parameter handle is NULL then IoTHubClientCore_LL_SendBatch shall return.]*/
@@ -502,10 +743,36 @@ static void IoTHubClientCore_LL_SendComplete(PDLIST_ENTRY completed, IOTHUB_CLIE
     {
         /*Codes_SRS_IOTHUBCLIENT_LL_02_027: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_ERROR then IoTHubClientCore_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_ERROR and the context set to the context passed originally in the SendEventAsync call.] */
         /*Codes_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClientCore_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
         PDLIST_ENTRY oldest;
+        tickcounter_ms_t nowTick;
+        /*Codes_SRS_IOTHUBCLIENT_LL_09_059: [ If the latency statistics are on, IoTHubClientCore_LL_SendComplete shall record the time since IoTHubClientCore_LL_SendEventAsync of each acknowledged event, reading the tick count once per call. ]*/
+        bool measure_latency = (result == IOTHUB_CLIENT_CONFIRMATION_OK) && handleData->latency_statistics &&
+            (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) == 0);
+
         while ((oldest = DList_RemoveHeadList(completed)) != completed)
         {
             IOTHUB_MESSAGE_LIST* messageList = (IOTHUB_MESSAGE_LIST*)containingRecord(oldest, IOTHUB_MESSAGE_LIST, entry);
+            release_send_queue_space(handleData, messageList);
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_057: [ IoTHubClientCore_LL_SendComplete shall count each completed event as acknowledged, timed out or failed according to result. ]*/
+            switch (result)
+            {
+                case IOTHUB_CLIENT_CONFIRMATION_OK:
+                    handleData->acked_messages++;
+                    if (measure_latency && messageList->latency_tracked)
+                    {
+                        record_send_latency(handleData, nowTick - messageList->ms_queuedAt);
+                    }
+                    break;
+                case IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT:
+                    handleData->timed_out_messages++;
+                    break;
+                case IOTHUB_CLIENT_CONFIRMATION_ERROR:
+                    handleData->failed_messages++;
+                    break;
+                default:
+                    break;
+            }
             /*Codes_SRS_IOTHUBCLIENT_LL_02_026: [If any callback is NULL then there shall not be a callback call.]*/
             if (messageList->callback != NULL)
             {
@@ -517,6 +784,54 @@ static void IoTHubClientCore_LL_SendComplete(PDLIST_ENTRY completed, IOTHUB_CLIE
     }
 }
 
+static void on_twin_cache_resync_completed(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* userContextCallback);
+
+static void request_twin_cache_resync(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    if (!handleData->twin_cache_resync_pending)
+    {
+        if (handleData->IoTHubTransport_GetTwinAsync(handleData->deviceHandle, on_twin_cache_resync_completed, handleData) != IOTHUB_CLIENT_OK)
+        {
+            LogError("Failed requesting the full twin to resynchronize the twin cache");
+        }
+        else
+        {
+            handleData->twin_cache_resync_pending = true;
+        }
+    }
+}
+
+static bool should_deliver_twin_update(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size)
+{
+    bool result;
+
+    if (handleData->twin_cache == NULL)
+    {
+        result = true;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBCLIENT_LL_09_025: [ If the twin cache is turned on, IoTHubClientCore_LL_RetrievePropertyComplete shall apply the update to it using IoTHubClient_TwinCache_Update before calling deviceTwinCallback. ]*/
+        switch (IoTHubClient_TwinCache_Update(handleData->twin_cache, update_state, payLoad, size))
+        {
+            case TWIN_CACHE_UPDATE_UNCHANGED:
+                /* Codes_SRS_IOTHUBCLIENT_LL_09_026: [ If the twin cache already has the desired properties version of the update, deviceTwinCallback shall not be called. ]*/
+                result = false;
+                break;
+            case TWIN_CACHE_UPDATE_OUT_OF_SYNC:
+                /* Codes_SRS_IOTHUBCLIENT_LL_09_027: [ If the twin cache missed desired properties versions, IoTHubClientCore_LL_RetrievePropertyComplete shall request the full twin using IoTHubTransport_GetTwinAsync, unless such request is already pending. ]*/
+                request_twin_cache_resync(handleData);
+                result = true;
+                break;
+            default:
+                result = true;
+                break;
+        }
+    }
+
+    return result;
+}
+
 static void IoTHubClientCore_LL_RetrievePropertyComplete(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* ctx)
 {
     if (ctx == NULL)
@@ -527,6 +842,8 @@ static void IoTHubClientCore_LL_RetrievePropertyComplete(DEVICE_TWIN_UPDATE_STAT
     else
     {
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
+        /*Codes_SRS_IOTHUBCLIENT_LL_09_060: [ IoTHubClientCore_LL_RetrievePropertyComplete, IoTHubClientCore_LL_ReportedStateComplete and IoTHubClientCore_LL_DeviceMethodComplete shall count the twin updates received, the reported state updates completed and the method requests received. ]*/
+        handleData->twin_updates_received++;
         /* Codes_SRS_IOTHUBCLIENT_LL_07_014: [ If deviceTwinCallback is NULL then IoTHubClientCore_LL_RetrievePropertyComplete shall do nothing.] */
         if (handleData->deviceTwinCallback)
         {
@@ -535,7 +852,7 @@ static void IoTHubClientCore_LL_RetrievePropertyComplete(DEVICE_TWIN_UPDATE_STAT
             {
                 handleData->complete_twin_update_encountered = true;
             }
-            if (handleData->complete_twin_update_encountered)
+            if (handleData->complete_twin_update_encountered && should_deliver_twin_update(handleData, update_state, payLoad, size))
             {
                 /* Codes_SRS_IOTHUBCLIENT_LL_07_016: [ If deviceTwinCallback is set and DEVICE_TWIN_UPDATE_COMPLETE has been encountered then IoTHubClientCore_LL_RetrievePropertyComplete shall call deviceTwinCallback.] */
                 handleData->deviceTwinCallback(update_state, payLoad, size, handleData->deviceTwinContextCallback);
@@ -544,6 +861,23 @@ static void IoTHubClientCore_LL_RetrievePropertyComplete(DEVICE_TWIN_UPDATE_STAT
     }
 }
 
+static void on_twin_cache_resync_completed(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* userContextCallback)
+{
+    IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)userContextCallback;
+
+    handleData->twin_cache_resync_pending = false;
+
+    if (payLoad == NULL)
+    {
+        LogError("Failed retrieving the full twin to resynchronize the twin cache");
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBCLIENT_LL_09_028: [ The full twin retrieved to resynchronize the twin cache shall be processed as any other twin update. ]*/
+        IoTHubClientCore_LL_RetrievePropertyComplete(update_state, payLoad, size, handleData);
+    }
+}
+
 static void IoTHubClientCore_LL_ReportedStateComplete(uint32_t item_id, int status_code, void* ctx)
 {
     /* Codes_SRS_IOTHUBCLIENT_LL_07_002: [ if handle or queue_handle are NULL then IoTHubClientCore_LL_ReportedStateComplete shall do nothing. ] */
@@ -564,9 +898,17 @@ static void IoTHubClientCore_LL_ReportedStateComplete(uint32_t item_id, int stat
             IOTHUB_DEVICE_TWIN* queue_data = containingRecord(client_item, IOTHUB_DEVICE_TWIN, entry);
             if (queue_data->item_id == item_id)
             {
-                if (queue_data->reported_state_callback != NULL)
+                IOTHUB_DEVICE_TWIN* report = queue_data;
+
+                /*Codes_SRS_IOTHUBCLIENT_LL_09_023: [ IoTHubClientCore_LL_ReportedStateComplete shall invoke the callback of every reported state update merged into the completed item, in the order they were sent. ]*/
+                while (report != NULL)
                 {
-                    queue_data->reported_state_callback(status_code, queue_data->context);
+                    handleData->reported_states_completed++;
+                    if (report->reported_state_callback != NULL)
+                    {
+                        report->reported_state_callback(status_code, report->context);
+                    }
+                    report = report->next_merged_report;
                 }
                 /*Codes_SRS_IOTHUBCLIENT_LL_07_009: [ IoTHubClientCore_LL_ReportedStateComplete shall remove the IOTHUB_DEVICE_TWIN item from the ack queue.]*/
                 DList_RemoveEntryList(client_item);
@@ -590,6 +932,21 @@ static void IoTHubClientCore_LL_ConnectionStatusCallBack(IOTHUB_CLIENT_CONNECTIO
     {
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
 
+        /*Codes_SRS_IOTHUBCLIENT_LL_09_058: [ IoTHubClientCore_LL_ConnectionStatusCallBack shall count a reconnect each time the client is authenticated after having lost a previous connection. ]*/
+        if (status == IOTHUB_CLIENT_CONNECTION_AUTHENTICATED)
+        {
+            if (!handleData->is_connected && handleData->was_connected)
+            {
+                handleData->reconnects++;
+            }
+            handleData->is_connected = true;
+            handleData->was_connected = true;
+        }
+        else
+        {
+            handleData->is_connected = false;
+        }
+
         /*Codes_SRS_IOTHUBCLIENT_LL_25_114: [IoTHubClientCore_LL_ConnectionStatusCallBack shall call non-callback set by the user from IoTHubClientCore_LL_SetConnectionStatusCallback passing the status, reason and the passed userContextCallback.]*/
         if (handleData->conStatusCallback != NULL)
         {
@@ -641,51 +998,41 @@ static bool IoTHubClientCore_LL_MessageCallbackFromInput(MESSAGE_CALLBACK_INFO*
     {
         const char* inputName = IoTHubMessage_GetInputName(messageData->messageHandle);
 
-        LIST_ITEM_HANDLE item_handle = NULL;
-
-        item_handle = singlylinkedlist_find(handleData->event_callbacks, is_event_equal_for_match, (const void*)inputName);
+        // Codes_SRS_IOTHUBCLIENT_LL_09_034: [ `IoTHubClient_LL_MessageCallbackFromInput` shall look up the handler of inputName in the input route table, without scanning the callback list. ]
+        IOTHUB_EVENT_CALLBACK* event_callback = find_input_route(handleData, inputName);
 
-        if (item_handle == NULL)
+        if (event_callback == NULL)
         {
             // Codes_SRS_IOTHUBCLIENT_LL_31_138: [ If there is no registered handler for the inputName from `IoTHubMessage_GetInputName`, then `IoTHubClient_LL_MessageCallbackFromInput` shall attempt invoke the default handler handler.** ]
-            item_handle = singlylinkedlist_find(handleData->event_callbacks, is_event_equal_for_match, NULL);
+            event_callback = handleData->default_input_route;
         }
 
-        if (item_handle == NULL)
+        if (event_callback == NULL)
         {
             LogError("Could not find callback (explicit or default) for input queue %s", inputName);
             result = false;
         }
         else
         {
-            IOTHUB_EVENT_CALLBACK* event_callback = (IOTHUB_EVENT_CALLBACK*)singlylinkedlist_item_get_value(item_handle);
-            if (NULL == event_callback)
+            // Codes_SRS_IOTHUBCLIENT_LL_09_004: [IoTHubClient_LL_GetLastMessageReceiveTime shall return lastMessageReceiveTime in localtime]
+            handleData->lastMessageReceiveTime = get_time(NULL);
+
+            if (event_callback->callbackAsyncEx != NULL)
             {
-                LogError("singlylinkedlist_item_get_value for event_callback failed");
-                result = false;
+                // Codes_SRS_IOTHUBCLIENT_LL_31_139: [ `IoTHubClient_LL_MessageCallbackFromInput` shall the callback from the given inputName queue if it has been registered.** ]
+                result = event_callback->callbackAsyncEx(messageData, event_callback->userContextCallbackEx);
             }
             else
             {
-                // Codes_SRS_IOTHUBCLIENT_LL_09_004: [IoTHubClient_LL_GetLastMessageReceiveTime shall return lastMessageReceiveTime in localtime]
-                handleData->lastMessageReceiveTime = get_time(NULL);
+                // Codes_SRS_IOTHUBCLIENT_LL_31_139: [ `IoTHubClient_LL_MessageCallbackFromInput` shall the callback from the given inputName queue if it has been registered.** ]
+                IOTHUBMESSAGE_DISPOSITION_RESULT cb_result = event_callback->callbackAsync(messageData->messageHandle, event_callback->userContextCallback);
 
-                if (event_callback->callbackAsyncEx != NULL)
-                {
-                    // Codes_SRS_IOTHUBCLIENT_LL_31_139: [ `IoTHubClient_LL_MessageCallbackFromInput` shall the callback from the given inputName queue if it has been registered.** ]
-                    result = event_callback->callbackAsyncEx(messageData, event_callback->userContextCallbackEx);
-                }
-                else
+                // Codes_SRS_IOTHUBCLIENT_LL_31_140: [ `IoTHubClient_LL_MessageCallbackFromInput` shall send the message disposition as returned by the client to the underlying layer and return `true` if an input queue match is found.** ]
+                if (handleData->IoTHubTransport_SendMessageDisposition(messageData, cb_result) != IOTHUB_CLIENT_OK)
                 {
-                    // Codes_SRS_IOTHUBCLIENT_LL_31_139: [ `IoTHubClient_LL_MessageCallbackFromInput` shall the callback from the given inputName queue if it has been registered.** ]
-                    IOTHUBMESSAGE_DISPOSITION_RESULT cb_result = event_callback->callbackAsync(messageData->messageHandle, event_callback->userContextCallback);
-
-                    // Codes_SRS_IOTHUBCLIENT_LL_31_140: [ `IoTHubClient_LL_MessageCallbackFromInput` shall send the message disposition as returned by the client to the underlying layer and return `true` if an input queue match is found.** ]
-                    if (handleData->IoTHubTransport_SendMessageDisposition(messageData, cb_result) != IOTHUB_CLIENT_OK)
-                    {
-                        LogError("IoTHubTransport_SendMessageDisposition failed");
-                    }
-                    result = true;
+                    LogError("IoTHubTransport_SendMessageDisposition failed");
                 }
+                result = true;
             }
         }
     }
@@ -715,6 +1062,75 @@ static bool IoTHubClientCore_LL_MessageCallback(MESSAGE_CALLBACK_INFO* messageDa
     return result;
 }
 
+static int hold_device_method_response(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, METHOD_HANDLE method_id, const unsigned char* response, size_t response_size, int status_response)
+{
+    int result;
+    IOTHUB_METHOD_RESPONSE* held_response;
+
+    if ((held_response = (IOTHUB_METHOD_RESPONSE*)malloc(sizeof(IOTHUB_METHOD_RESPONSE))) == NULL)
+    {
+        LogError("Failed allocating held device method response");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        memset(held_response, 0, sizeof(IOTHUB_METHOD_RESPONSE));
+
+        if ((response != NULL) && (response_size > 0) && ((held_response->response = (unsigned char*)malloc(response_size)) == NULL))
+        {
+            LogError("Failed allocating held device method response payload");
+            free(held_response);
+            result = MU_FAILURE;
+        }
+        else if (tickcounter_get_current_ms(handleData->tickCounter, &held_response->ms_queuedAt) != 0)
+        {
+            LogError("unable to get the current relative tickcount");
+            free(held_response->response);
+            free(held_response);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            if (held_response->response != NULL)
+            {
+                (void)memcpy(held_response->response, response, response_size);
+            }
+            held_response->method_id = method_id;
+            held_response->response_size = response_size;
+            held_response->status_response = status_response;
+            DList_InsertTailList(&(handleData->waitingMethodResponses), &(held_response->entry));
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static int send_device_method_response(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, METHOD_HANDLE method_id, const unsigned char* response, size_t response_size, int status_response)
+{
+    int result;
+
+    if (handleData->rate_limiter == NULL)
+    {
+        result = handleData->IoTHubTransport_DeviceMethod_Response(handleData->deviceHandle, method_id, response, response_size, status_response);
+    }
+    else if ((handleData->waitingMethodResponses.Flink == &(handleData->waitingMethodResponses)) &&
+        IoTHubClient_RateLimiter_TryAcquire(handleData->rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_METHOD_RESPONSE, 0))
+    {
+        if ((result = handleData->IoTHubTransport_DeviceMethod_Response(handleData->deviceHandle, method_id, response, response_size, status_response)) != 0)
+        {
+            IoTHubClient_RateLimiter_Refund(handleData->rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_METHOD_RESPONSE, 0);
+        }
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_09_041: [ If a rate limiter is set and it has no method response token available, or other responses are already held back, the device method response shall be copied and held back until IoTHubClientCore_LL_DoWork gets a token for it. ]*/
+        result = hold_device_method_response(handleData, method_id, response, response_size, status_response);
+    }
+
+    return result;
+}
+
 static int IoTHubClientCore_LL_DeviceMethodComplete(const char* method_name, const unsigned char* payLoad, size_t size, METHOD_HANDLE response_id, void* ctx)
 {
     int result;
@@ -728,6 +1144,7 @@ static int IoTHubClientCore_LL_DeviceMethodComplete(const char* method_name, con
     {
         /* Codes_SRS_IOTHUBCLIENT_LL_07_018: [ If deviceMethodCallback is not NULL IoTHubClientCore_LL_DeviceMethodComplete shall execute deviceMethodCallback and return the status. ] */
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
+        handleData->method_invocations++;
         switch (handleData->methodCallback.type)
         {
             case CALLBACK_TYPE_SYNC:
@@ -738,7 +1155,7 @@ static int IoTHubClientCore_LL_DeviceMethodComplete(const char* method_name, con
                 /* Codes_SRS_IOTHUBCLIENT_LL_07_020: [ deviceMethodCallback shall build the BUFFER_HANDLE with the response payload from the IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC callback. ] */
                 if (payload_resp != NULL && response_size > 0)
                 {
-                    result = handleData->IoTHubTransport_DeviceMethod_Response(handleData->deviceHandle, response_id, payload_resp, response_size, result);
+                    result = send_device_method_response(handleData, response_id, payload_resp, response_size, result);
                 }
                 else
                 {
@@ -1018,8 +1435,10 @@ static IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_
                 {
                     /*Codes_SRS_IOTHUBCLIENT_LL_02_004: [Otherwise IoTHubClientCore_LL_Create shall initialize a new DLIST (further called "waitingToSend") containing records with fields of the following types: IOTHUB_MESSAGE_HANDLE, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, void*.]*/
                     DList_InitializeListHead(&(result->waitingToSend));
+                    DList_InitializeListHead(&(result->waitingToAdmit));
                     DList_InitializeListHead(&(result->iot_msg_queue));
                     DList_InitializeListHead(&(result->iot_ack_queue));
+                    DList_InitializeListHead(&(result->waitingMethodResponses));
                     result->messageCallback.type = CALLBACK_TYPE_NONE;
                     result->methodCallback.type = CALLBACK_TYPE_NONE;
                     result->lastMessageReceiveTime = INDEFINITE_TIME;
@@ -1120,6 +1539,8 @@ static IOTHUB_DEVICE_TWIN* dev_twin_data_create(IOTHUB_CLIENT_CORE_LL_HANDLE_DAT
         {
             result->item_id = id;
             result->ms_timesOutAfter = 0;
+            result->ms_coalesceUntil = 0;
+            result->next_merged_report = NULL;
             result->context = userContextCallback;
             result->reported_state_callback = reportedStateCallback;
             result->client_handle = handleData;
@@ -1171,6 +1592,12 @@ static void delete_event_callback_list(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handle
         singlylinkedlist_destroy(handleData->event_callbacks);
         handleData->event_callbacks = NULL;
     }
+
+    free(handleData->input_routes);
+    handleData->input_routes = NULL;
+    handleData->input_route_bucket_count = 0;
+    handleData->input_route_count = 0;
+    handleData->default_input_route = NULL;
 }
 
 
@@ -1648,23 +2075,21 @@ IOTHUB_CLIENT_CORE_LL_HANDLE IoTHubClientCore_LL_CreateFromEnvironment(IOTHUB_CL
     {
         // Because the Edge Hub almost always use self-signed certificates, we need to specify which certificates to trust.  We need to do
         // this regardless of how we created the underlying IOTHUB_CLIENT_CORE_LL_HANDLE_DATA.
+        // The trust bundle is loaded once per process and shared by all the clients holding a reference to it.
         IOTHUB_CLIENT_RESULT setTrustResult;
-        char* trustedCertificate = IoTHubClient_Auth_Get_TrustBundle(result->authorization_module, edge_environment_variables.ca_trusted_certificate_file);
 
-        if (trustedCertificate == NULL)
+        if ((result->trusted_certificate = IoTHubClient_TrustBundle_Acquire(result->authorization_module, edge_environment_variables.ca_trusted_certificate_file)) == NULL)
         {
-            LogError("IoTHubClient_Auth_Get_TrustBundle failed");
+            LogError("IoTHubClient_TrustBundle_Acquire failed");
             IoTHubClientCore_LL_Destroy(result);
             result = NULL;
         }
-        else if ((setTrustResult = IoTHubClientCore_LL_SetOption(result, OPTION_TRUSTED_CERT, trustedCertificate)) != IOTHUB_CLIENT_OK)
+        else if ((setTrustResult = IoTHubClientCore_LL_SetOption(result, OPTION_TRUSTED_CERT, result->trusted_certificate)) != IOTHUB_CLIENT_OK)
         {
             LogError("IoTHubClientCore_LL_SetOption failed, err = %d", setTrustResult);
             IoTHubClientCore_LL_Destroy(result);
             result = NULL;
         }
-
-        free(trustedCertificate);
     }
 
     free(edge_environment_variables.iothub_buffer);
@@ -1701,8 +2126,21 @@ void IoTHubClientCore_LL_Destroy(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle
     if (iotHubClientHandle != NULL)
     {
         PDLIST_ENTRY unsend;
-        /*Codes_SRS_IOTHUBCLIENT_LL_17_010: [IoTHubClientCore_LL_Destroy  shall call the underlaying layer's _Unregister function] */
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_09_094: [ Before unregistering the device, IoTHubClientCore_LL_Destroy shall hand the device method responses held back by the rate limiter to the transport, which sends them and releases their method handles. ]*/
+        while ((unsend = DList_RemoveHeadList(&(handleData->waitingMethodResponses))) != &(handleData->waitingMethodResponses))
+        {
+            IOTHUB_METHOD_RESPONSE* temp = containingRecord(unsend, IOTHUB_METHOD_RESPONSE, entry);
+            if (handleData->IoTHubTransport_DeviceMethod_Response(handleData->deviceHandle, temp->method_id, temp->response, temp->response_size, temp->status_response) != 0)
+            {
+                LogError("IoTHubTransport_DeviceMethod_Response failed for a held back response");
+            }
+            free(temp->response);
+            free(temp);
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_17_010: [IoTHubClientCore_LL_Destroy  shall call the underlaying layer's _Unregister function] */
         handleData->IoTHubTransport_Unregister(handleData->deviceHandle);
         if (handleData->isSharedTransport == false)
         {
@@ -1721,6 +2159,17 @@ void IoTHubClientCore_LL_Destroy(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle
             IoTHubMessage_Destroy(temp->messageHandle);
             free(temp);
         }
+        /*Codes_SRS_IOTHUBCLIENT_LL_09_043: [ IoTHubClientCore_LL_Destroy shall complete the events held back by the rate limiter with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY. ]*/
+        while ((unsend = DList_RemoveHeadList(&(handleData->waitingToAdmit))) != &(handleData->waitingToAdmit))
+        {
+            IOTHUB_MESSAGE_LIST* temp = containingRecord(unsend, IOTHUB_MESSAGE_LIST, entry);
+            if (temp->callback != NULL)
+            {
+                temp->callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, temp->context);
+            }
+            IoTHubMessage_Destroy(temp->messageHandle);
+            free(temp);
+        }
 
         /* Codes_SRS_IOTHUBCLIENT_LL_07_007: [ IoTHubClientCore_LL_Destroy shall iterate the device twin queues and destroy any remaining items. ] */
         while ((unsend = DList_RemoveHeadList(&(handleData->iot_msg_queue))) != &(handleData->iot_msg_queue))
@@ -1745,8 +2194,13 @@ void IoTHubClientCore_LL_Destroy(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle
 #endif
 #ifdef USE_EDGE_MODULES
         IoTHubClient_EdgeHandle_Destroy(handleData->methodHandle);
+        IoTHubClient_TrustBundle_Release(handleData->trusted_certificate);
 #endif
         STRING_delete(handleData->product_info);
+        if (handleData->twin_cache != NULL)
+        {
+            IoTHubClient_TwinCache_Destroy(handleData->twin_cache);
+        }
         free(handleData);
     }
 }
@@ -1780,32 +2234,251 @@ static int attach_ms_timesOutAfter(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData
     return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventAsync(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+static size_t get_priority_lane(IOTHUB_MESSAGE_HANDLE messageHandle)
 {
-    IOTHUB_CLIENT_RESULT result;
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_011: [IoTHubClientCore_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandle is NULL.]*/
-    if (
-        (iotHubClientHandle == NULL) ||
-        (eventMessageHandle == NULL) ||
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_012: [IoTHubClientCore_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter eventConfirmationCallback is NULL and userContextCallback is not NULL.] */
-        ((eventConfirmationCallback == NULL) && (userContextCallback != NULL))
-        )
+    size_t result;
+
+    switch (IoTHubMessage_GetPriority(messageHandle))
     {
-        result = IOTHUB_CLIENT_INVALID_ARG;
-        LOG_ERROR_RESULT;
+        case IOTHUB_MESSAGE_PRIORITY_HIGH:
+            result = 0;
+            break;
+        case IOTHUB_MESSAGE_PRIORITY_LOW:
+            result = 2;
+            break;
+        case IOTHUB_MESSAGE_PRIORITY_NORMAL:
+        default:
+            result = 1;
+            break;
     }
-    else
-    {
-        IOTHUB_MESSAGE_LIST *newEntry = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST));
-        if (newEntry == NULL)
+
+    return result;
+}
+
+/*Codes_SRS_IOTHUBCLIENT_LL_09_019: [ IoTHubClientCore_LL_SendEventAsync shall insert the new record in waitingToSend after all records with a send order tag lower than or equal to its own. ]*/
+static void insert_by_send_order(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, PDLIST_ENTRY events, IOTHUB_MESSAGE_LIST* newEntry)
+{
+    size_t lane = get_priority_lane(newEntry->messageHandle);
+    uint64_t virtual_time;
+    PDLIST_ENTRY currentEntry;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_09_018: [ The send order tag of the new record shall be the greater of the tag of the oldest record in waitingToSend (or the highest tag handed out, if waitingToSend is empty) and the tag of the newest record of the same priority, plus the send cost of the message priority. ]*/
+    if (events->Flink == events)
+    {
+        virtual_time = handleData->last_send_order_tag;
+    }
+    else
+    {
+        virtual_time = containingRecord(events->Flink, IOTHUB_MESSAGE_LIST, entry)->send_order_tag;
+    }
+
+    if (handleData->last_send_order_tag_in_lane[lane] > virtual_time)
+    {
+        virtual_time = handleData->last_send_order_tag_in_lane[lane];
+    }
+
+    newEntry->send_order_tag = virtual_time + PRIORITY_LANE_SEND_COST[lane];
+    handleData->last_send_order_tag_in_lane[lane] = newEntry->send_order_tag;
+
+    if (newEntry->send_order_tag > handleData->last_send_order_tag)
+    {
+        handleData->last_send_order_tag = newEntry->send_order_tag;
+    }
+
+    /*messages of a single priority always land at the tail, so only messages overtaking others walk the list*/
+    currentEntry = events;
+    if (events->Blink != events &&
+        containingRecord(events->Blink, IOTHUB_MESSAGE_LIST, entry)->send_order_tag > newEntry->send_order_tag)
+    {
+        currentEntry = events->Flink;
+        while (containingRecord(currentEntry, IOTHUB_MESSAGE_LIST, entry)->send_order_tag <= newEntry->send_order_tag)
+        {
+            currentEntry = currentEntry->Flink;
+        }
+    }
+
+    /*inserting at the "tail" of currentEntry places newEntry right before it*/
+    DList_InsertTailList(currentEntry, &(newEntry->entry));
+}
+
+/*Codes_SRS_IOTHUBCLIENT_LL_09_039: [ Events held back by the rate limiter shall be moved to the tail of waitingToSend in order, as long as the rate limiter has a D2C token for the oldest one, or right away if the rate limiter was removed. ]*/
+static void admit_held_events(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, tickcounter_ms_t current_time)
+{
+    while (handleData->waitingToAdmit.Flink != &(handleData->waitingToAdmit))
+    {
+        IOTHUB_MESSAGE_LIST* held_event = containingRecord(handleData->waitingToAdmit.Flink, IOTHUB_MESSAGE_LIST, entry);
+
+        if ((handleData->rate_limiter != NULL) &&
+            !IoTHubClient_RateLimiter_TryAcquire(handleData->rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_D2C, current_time - held_event->ms_queuedAt))
+        {
+            break;
+        }
+
+        (void)DList_RemoveEntryList(&(held_event->entry));
+        DList_InsertTailList(&(handleData->waitingToSend), &(held_event->entry));
+    }
+}
+
+static size_t get_message_size(IOTHUB_MESSAGE_HANDLE messageHandle)
+{
+    size_t result = 0;
+    const unsigned char* buffer;
+    const char* string;
+
+    switch (IoTHubMessage_GetContentType(messageHandle))
+    {
+        case IOTHUBMESSAGE_BYTEARRAY:
+            if (IoTHubMessage_GetByteArray(messageHandle, &buffer, &result) != IOTHUB_MESSAGE_OK)
+            {
+                result = 0;
+            }
+            break;
+        case IOTHUBMESSAGE_STRING:
+            if ((string = IoTHubMessage_GetString(messageHandle)) != NULL)
+            {
+                result = strlen(string);
+            }
+            break;
+        default:
+            break;
+    }
+
+    return result;
+}
+
+static bool send_queue_has_room(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, size_t messageSize)
+{
+    return ((handleData->send_queue_max_messages == 0) || (handleData->queued_messages < handleData->send_queue_max_messages)) &&
+        ((handleData->send_queue_max_bytes == 0) || (handleData->queued_bytes + messageSize <= handleData->send_queue_max_bytes));
+}
+
+static bool send_queue_can_never_fit(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, size_t messageSize)
+{
+    /*dropping or completing every queued event would not make room for it*/
+    return (handleData->send_queue_max_bytes != 0) && (messageSize > handleData->send_queue_max_bytes);
+}
+
+/*events already handed to the transport cannot be taken back, so only waitingToSend and waitingToAdmit are looked at*/
+static IOTHUB_MESSAGE_LIST* find_event_to_drop(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE newMessage)
+{
+    IOTHUB_MESSAGE_LIST* result = NULL;
+
+    if (handleData->send_queue_full_policy == IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_09_050: [ If the policy is IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST, the event dropped shall be the head of waitingToSend, or the head of the events held back by the rate limiter if waitingToSend is empty. ]*/
+        if (handleData->waitingToSend.Flink != &(handleData->waitingToSend))
+        {
+            result = containingRecord(handleData->waitingToSend.Flink, IOTHUB_MESSAGE_LIST, entry);
+        }
+        else if (handleData->waitingToAdmit.Flink != &(handleData->waitingToAdmit))
+        {
+            result = containingRecord(handleData->waitingToAdmit.Flink, IOTHUB_MESSAGE_LIST, entry);
+        }
+    }
+    else if (handleData->send_queue_full_policy == IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_LOWEST_PRIORITY)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_09_051: [ If the policy is IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_LOWEST_PRIORITY, the event dropped shall be the first queued event of the lowest priority, provided its priority is not higher than the priority of the new event. ]*/
+        PDLIST_ENTRY lists[2];
+        size_t lowest_lane = get_priority_lane(newMessage);
+        size_t i;
+
+        lists[0] = &(handleData->waitingToSend);
+        lists[1] = &(handleData->waitingToAdmit);
+
+        for (i = 0; i < sizeof(lists) / sizeof(lists[0]); i++)
+        {
+            PDLIST_ENTRY currentEntry;
+            for (currentEntry = lists[i]->Flink; currentEntry != lists[i]; currentEntry = currentEntry->Flink)
+            {
+                IOTHUB_MESSAGE_LIST* queuedEvent = containingRecord(currentEntry, IOTHUB_MESSAGE_LIST, entry);
+                size_t lane = get_priority_lane(queuedEvent->messageHandle);
+
+                if ((result == NULL) ? (lane >= lowest_lane) : (lane > lowest_lane))
+                {
+                    result = queuedEvent;
+                    lowest_lane = lane;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+/*Codes_SRS_IOTHUBCLIENT_LL_09_049: [ If the new event does not fit in the send queue, IoTHubClientCore_LL_SendEventAsync shall drop queued events as the send queue full policy says, completing each of them with IOTHUB_CLIENT_CONFIRMATION_ERROR, until it fits. ]*/
+static int make_room_in_send_queue(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE newMessage, size_t messageSize)
+{
+    int result = 0;
+
+    while (!send_queue_has_room(handleData, messageSize))
+    {
+        IOTHUB_MESSAGE_LIST* droppedEvent = find_event_to_drop(handleData, newMessage);
+        if (droppedEvent == NULL)
+        {
+            result = MU_FAILURE;
+            break;
+        }
+
+        (void)DList_RemoveEntryList(&(droppedEvent->entry));
+        release_send_queue_space(handleData, droppedEvent);
+        handleData->dropped_messages++;
+        if (droppedEvent->callback != NULL)
+        {
+            droppedEvent->callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, droppedEvent->context);
+        }
+        IoTHubMessage_Destroy(droppedEvent->messageHandle);
+        free(droppedEvent);
+    }
+
+    if (result != 0)
+    {
+        handleData->rejected_messages++;
+        LogError("The send queue is full (%lu messages, %lu bytes), the event is rejected", (unsigned long)handleData->queued_messages, (unsigned long)handleData->queued_bytes);
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventAsync(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_011: [IoTHubClientCore_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandle is NULL.]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (eventMessageHandle == NULL) ||
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_012: [IoTHubClientCore_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter eventConfirmationCallback is NULL and userContextCallback is not NULL.] */
+        ((eventConfirmationCallback == NULL) && (userContextCallback != NULL))
+        )
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+        size_t messageSize = get_message_size(eventMessageHandle);
+        IOTHUB_MESSAGE_LIST *newEntry;
+
+        if (send_queue_can_never_fit(handleData, messageSize))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_082: [ If the payload of the new event is larger than `send_queue_max_bytes`, IoTHubClientCore_LL_SendEventAsync shall count it as rejected, fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+            handleData->rejected_messages++;
+            LogError("The event (%lu bytes) is larger than the send queue (%lu bytes), it can never be sent", (unsigned long)messageSize, (unsigned long)handleData->send_queue_max_bytes);
+            result = IOTHUB_CLIENT_INVALID_ARG;
+        }
+        else if (((handleData->send_queue_max_messages != 0) || (handleData->send_queue_max_bytes != 0)) &&
+            (make_room_in_send_queue(handleData, eventMessageHandle, messageSize) != 0))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_047: [ If the new event does not fit in the send queue and no queued event can be dropped for it, IoTHubClientCore_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_QUEUE_FULL. ]*/
+            result = IOTHUB_CLIENT_QUEUE_FULL;
+        }
+        else if ((newEntry = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST))) == NULL)
         {
             result = IOTHUB_CLIENT_ERROR;
             LOG_ERROR_RESULT;
         }
         else
         {
-            IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
-
             if (attach_ms_timesOutAfter(handleData, newEntry) != 0)
             {
                 result = IOTHUB_CLIENT_ERROR;
@@ -1829,12 +2502,33 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventAsync(IOTHUB_CLIENT_CORE_LL_HA
                     free(newEntry);
                     LOG_ERROR_RESULT;
                 }
+                else if (((handleData->rate_limiter != NULL) || handleData->latency_statistics) && (tickcounter_get_current_ms(handleData->tickCounter, &newEntry->ms_queuedAt) != 0))
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    IoTHubMessage_Destroy(newEntry->messageHandle);
+                    free(newEntry);
+                    LOG_ERROR_RESULT;
+                }
                 else
                 {
                     /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClientCore_LL_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
                     newEntry->callback = eventConfirmationCallback;
                     newEntry->context = userContextCallback;
-                    DList_InsertTailList(&(iotHubClientHandle->waitingToSend), &(newEntry->entry));
+                    /*Codes_SRS_IOTHUBCLIENT_LL_09_046: [ IoTHubClientCore_LL_SendEventAsync shall count the new event and its payload size in the send queue counters. ]*/
+                    newEntry->message_size = messageSize;
+                    newEntry->latency_tracked = handleData->latency_statistics;
+                    handleData->queued_messages++;
+                    handleData->queued_bytes += messageSize;
+                    if (handleData->rate_limiter == NULL)
+                    {
+                        insert_by_send_order(handleData, &(handleData->waitingToSend), newEntry);
+                    }
+                    else
+                    {
+                        /*Codes_SRS_IOTHUBCLIENT_LL_09_038: [ If a rate limiter is set, IoTHubClientCore_LL_SendEventAsync shall insert the new record in the list of events held back by the rate limiter, by send order tag, and then move to waitingToSend the events the rate limiter admits. ]*/
+                        insert_by_send_order(handleData, &(handleData->waitingToAdmit), newEntry);
+                        admit_held_events(handleData, newEntry->ms_queuedAt);
+                    }
                     /*Codes_SRS_IOTHUBCLIENT_LL_02_015: [Otherwise IoTHubClientCore_LL_SendEventAsync shall succeed and return IOTHUB_CLIENT_OK.] */
                     result = IOTHUB_CLIENT_OK;
                 }
@@ -2004,6 +2698,34 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendMessageDisposition(IOTHUB_CLIENT_CO
     return result;
 }
 
+static void DoEventTimeouts(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, PDLIST_ENTRY events, tickcounter_ms_t nowTick)
+{
+    DLIST_ENTRY* currentItemInWaitingToSend = events->Flink;
+    while (currentItemInWaitingToSend != events) /*while we are not at the end of the list*/
+    {
+        IOTHUB_MESSAGE_LIST* fullEntry = containingRecord(currentItemInWaitingToSend, IOTHUB_MESSAGE_LIST, entry);
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClientCore_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+        if ((fullEntry->ms_timesOutAfter != 0) && ((nowTick - fullEntry->ms_timesOutAfter) > fullEntry->message_timeout_value))
+        {
+            PDLIST_ENTRY theNext = currentItemInWaitingToSend->Flink; /*need to save the next item, because the below operations are destructive*/
+            DList_RemoveEntryList(currentItemInWaitingToSend);
+            release_send_queue_space(handleData, fullEntry);
+            handleData->timed_out_messages++;
+            if (fullEntry->callback != NULL)
+            {
+                fullEntry->callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, fullEntry->context);
+            }
+            IoTHubMessage_Destroy(fullEntry->messageHandle); /*because it has been cloned*/
+            free(fullEntry);
+            currentItemInWaitingToSend = theNext;
+        }
+        else
+        {
+            currentItemInWaitingToSend = currentItemInWaitingToSend->Flink;
+        }
+    }
+}
+
 static void DoTimeouts(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
 {
     tickcounter_ms_t nowTick;
@@ -2013,29 +2735,98 @@ static void DoTimeouts(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
     }
     else
     {
-        DLIST_ENTRY* currentItemInWaitingToSend = handleData->waitingToSend.Flink;
-        while (currentItemInWaitingToSend != &(handleData->waitingToSend)) /*while we are not at the end of the list*/
+        DoEventTimeouts(handleData, &(handleData->waitingToSend), nowTick);
+        /*Codes_SRS_IOTHUBCLIENT_LL_09_044: [ Events held back by the rate limiter shall time out like the ones in waitingToSend. ]*/
+        DoEventTimeouts(handleData, &(handleData->waitingToAdmit), nowTick);
+    }
+}
+
+static bool is_coalescing_window_open(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_DEVICE_TWIN* client_item)
+{
+    bool result;
+    tickcounter_ms_t current_time;
+
+    if (tickcounter_get_current_ms(handleData->tickCounter, &current_time) != 0)
+    {
+        LogError("unable to get the current relative tickcount; sending reported state right away");
+        result = false;
+    }
+    else
+    {
+        result = (current_time < client_item->ms_coalesceUntil);
+    }
+
+    return result;
+}
+
+static void send_held_method_responses(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, tickcounter_ms_t current_time)
+{
+    while (handleData->waitingMethodResponses.Flink != &(handleData->waitingMethodResponses))
+    {
+        IOTHUB_METHOD_RESPONSE* held_response = containingRecord(handleData->waitingMethodResponses.Flink, IOTHUB_METHOD_RESPONSE, entry);
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_09_042: [ IoTHubClientCore_LL_DoWork shall send the held back device method responses in order, as long as the rate limiter has a method response token for the oldest one, or right away if the rate limiter was removed. ]*/
+        if ((handleData->rate_limiter != NULL) &&
+            !IoTHubClient_RateLimiter_TryAcquire(handleData->rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_METHOD_RESPONSE, current_time - held_response->ms_queuedAt))
+        {
+            break;
+        }
+
+        (void)DList_RemoveEntryList(&(held_response->entry));
+        if (handleData->IoTHubTransport_DeviceMethod_Response(handleData->deviceHandle, held_response->method_id, held_response->response, held_response->response_size, held_response->status_response) != 0)
+        {
+            LogError("IoTHubTransport_DeviceMethod_Response failed for a held back response");
+        }
+        free(held_response->response);
+        free(held_response);
+    }
+}
+
+static void release_held_operations(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    if ((handleData->waitingToAdmit.Flink != &(handleData->waitingToAdmit)) ||
+        (handleData->waitingMethodResponses.Flink != &(handleData->waitingMethodResponses)))
+    {
+        tickcounter_ms_t current_time;
+
+        if (tickcounter_get_current_ms(handleData->tickCounter, &current_time) != 0)
+        {
+            LogError("unable to get the current relative tickcount; held back operations not released");
+        }
+        else
+        {
+            admit_held_events(handleData, current_time);
+            send_held_method_responses(handleData, current_time);
+        }
+    }
+}
+
+/*Codes_SRS_IOTHUBCLIENT_LL_09_040: [ If a rate limiter is set, IoTHubClientCore_LL_DoWork shall not hand a device twin item to the transport until the rate limiter gives it a twin update token, and shall give the token back if the transport does not take the item. ]*/
+static bool try_acquire_twin_update_token(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, tickcounter_ms_t* waited_ms)
+{
+    bool result;
+    tickcounter_ms_t current_time;
+
+    if (tickcounter_get_current_ms(handleData->tickCounter, &current_time) != 0)
+    {
+        LogError("unable to get the current relative tickcount; twin update wait time not measured");
+        *waited_ms = 0;
+        result = IoTHubClient_RateLimiter_TryAcquire(handleData->rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_TWIN_UPDATE, 0);
+    }
+    else
+    {
+        if (!handleData->twin_update_throttled)
         {
-            IOTHUB_MESSAGE_LIST* fullEntry = containingRecord(currentItemInWaitingToSend, IOTHUB_MESSAGE_LIST, entry);
-            /*Codes_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClientCore_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-            if ((fullEntry->ms_timesOutAfter != 0) && ((nowTick - fullEntry->ms_timesOutAfter) > fullEntry->message_timeout_value))
-            {
-                PDLIST_ENTRY theNext = currentItemInWaitingToSend->Flink; /*need to save the next item, because the below operations are destructive*/
-                DList_RemoveEntryList(currentItemInWaitingToSend);
-                if (fullEntry->callback != NULL)
-                {
-                    fullEntry->callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, fullEntry->context);
-                }
-                IoTHubMessage_Destroy(fullEntry->messageHandle); /*because it has been cloned*/
-                free(fullEntry);
-                currentItemInWaitingToSend = theNext;
-            }
-            else
-            {
-                currentItemInWaitingToSend = currentItemInWaitingToSend->Flink;
-            }
+            handleData->twin_update_throttled_since = current_time;
         }
+        *waited_ms = current_time - handleData->twin_update_throttled_since;
+        result = IoTHubClient_RateLimiter_TryAcquire(handleData->rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_TWIN_UPDATE, *waited_ms);
     }
+
+    /*the wait is measured from the first DoWork that could not get a token for the head of iot_msg_queue*/
+    handleData->twin_update_throttled = !result;
+
+    return result;
 }
 
 void IoTHubClientCore_LL_DoWork(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle)
@@ -2045,6 +2836,7 @@ void IoTHubClientCore_LL_DoWork(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle)
     {
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
         DoTimeouts(handleData);
+        release_held_operations(handleData);
 
         /*Codes_SRS_IOTHUBCLIENT_LL_07_008: [ IoTHubClientCore_LL_DoWork shall iterate the message queue and execute the underlying transports IoTHubTransport_ProcessItem function for each item. ] */
         DLIST_ENTRY* client_item = handleData->iot_msg_queue.Flink;
@@ -2053,11 +2845,29 @@ void IoTHubClientCore_LL_DoWork(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle)
             PDLIST_ENTRY next_item = client_item->Flink;
 
             IOTHUB_DEVICE_TWIN* queue_data = containingRecord(client_item, IOTHUB_DEVICE_TWIN, entry);
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_022: [ IoTHubClientCore_LL_DoWork shall not hand a device twin item to the transport while its coalescing window is open. ]*/
+            if (queue_data->ms_coalesceUntil != 0 && is_coalescing_window_open(handleData, queue_data))
+            {
+                break;
+            }
+
+            tickcounter_ms_t waited_ms = 0;
+            if ((handleData->rate_limiter != NULL) && !try_acquire_twin_update_token(handleData, &waited_ms))
+            {
+                break;
+            }
+
             IOTHUB_IDENTITY_INFO identity_info;
             identity_info.device_twin = queue_data;
             IOTHUB_PROCESS_ITEM_RESULT process_results =  handleData->IoTHubTransport_ProcessItem(handleData->transportHandle, IOTHUB_TYPE_DEVICE_TWIN, &identity_info);
             if (process_results == IOTHUB_PROCESS_CONTINUE || process_results == IOTHUB_PROCESS_NOT_CONNECTED)
             {
+                if (handleData->rate_limiter != NULL)
+                {
+                    IoTHubClient_RateLimiter_Refund(handleData->rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_TWIN_UPDATE, waited_ms);
+                }
+
                 /*Codes_SRS_IOTHUBCLIENT_LL_07_010: [ If 'IoTHubTransport_ProcessItem' returns IOTHUB_PROCESS_CONTINUE or IOTHUB_PROCESS_NOT_CONNECTED IoTHubClientCore_LL_DoWork shall continue on to call the underlaying layer's _DoWork function. ]*/
                 break;
             }
@@ -2101,7 +2911,16 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GetSendStatus(IOTHUB_CLIENT_CORE_LL_HAN
 
         /* Codes_SRS_IOTHUBCLIENT_09_008: [IoTHubClient_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_IDLE if there is currently no items to be sent] */
         /* Codes_SRS_IOTHUBCLIENT_09_009: [IoTHubClient_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY if there are currently items to be sent] */
-        result = handleData->IoTHubTransport_GetSendStatus(handleData->deviceHandle, iotHubClientStatus);
+        if (handleData->waitingToAdmit.Flink != &(handleData->waitingToAdmit))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_045: [ If events are held back by the rate limiter, IoTHubClientCore_LL_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY. ]*/
+            *iotHubClientStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else
+        {
+            result = handleData->IoTHubTransport_GetSendStatus(handleData->deviceHandle, iotHubClientStatus);
+        }
     }
 
     return result;
@@ -2273,6 +3092,95 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetOption(IOTHUB_CLIENT_CORE_LL_HANDLE
                 result = IOTHUB_CLIENT_OK;
             }
         }
+        else if (strcmp(optionName, OPTION_TWIN_REPORTED_STATE_COALESCE_MS) == 0)
+        {
+            handleData->reported_state_coalesce_ms = *(const size_t*)value;
+
+            if (handleData->reported_state_coalesce_ms == 0)
+            {
+                /*release whatever is being held back*/
+                DLIST_ENTRY* client_item = handleData->iot_msg_queue.Flink;
+                while (client_item != &(handleData->iot_msg_queue))
+                {
+                    containingRecord(client_item, IOTHUB_DEVICE_TWIN, entry)->ms_coalesceUntil = 0;
+                    client_item = client_item->Flink;
+                }
+            }
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_TWIN_REPORTED_STATE_COALESCE_MAX_BYTES) == 0)
+        {
+            handleData->reported_state_coalesce_max_bytes = *(const size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_TWIN_CACHE) == 0)
+        {
+            if (handleData->twin_cache != NULL && !*(const bool*)value)
+            {
+                /* Codes_SRS_IOTHUBCLIENT_LL_09_030: [ Setting "twin_cache" to false shall destroy the twin cache. ]*/
+                IoTHubClient_TwinCache_Destroy(handleData->twin_cache);
+                handleData->twin_cache = NULL;
+                result = IOTHUB_CLIENT_OK;
+            }
+            else if (handleData->twin_cache != NULL || !*(const bool*)value)
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+            /* Codes_SRS_IOTHUBCLIENT_LL_09_029: [ Setting "twin_cache" to true shall create the twin cache using IoTHubClient_TwinCache_Create. ]*/
+            else if ((handleData->twin_cache = IoTHubClient_TwinCache_Create()) == NULL)
+            {
+                LogError("Failed creating the twin cache");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(optionName, OPTION_RATE_LIMITER) == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_037: [ rate_limiter - shall set the rate limiter events, device twin updates and device method responses are admitted through; value is a pointer to an IOTHUB_CLIENT_RATE_LIMITER_HANDLE, NULL removes the rate limiter. ]*/
+            handleData->rate_limiter = *(const IOTHUB_CLIENT_RATE_LIMITER_HANDLE*)value;
+            handleData->twin_update_throttled = false;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_SEND_QUEUE_MAX_MESSAGES) == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_052: [ send_queue_max_messages - shall set the maximum number of events queued and not completed yet; value is a pointer to a size_t, 0 means no limit. Events already queued are not dropped. ]*/
+            handleData->send_queue_max_messages = *(const size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_SEND_QUEUE_MAX_BYTES) == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_053: [ send_queue_max_bytes - shall set the maximum total payload size of the events queued and not completed yet; value is a pointer to a size_t, 0 means no limit. Events already queued are not dropped. ]*/
+            handleData->send_queue_max_bytes = *(const size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_SEND_QUEUE_FULL_POLICY) == 0)
+        {
+            IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = *(const IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY*)value;
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_054: [ send_queue_full_policy - shall set what IoTHubClientCore_LL_SendEventAsync does with an event that does not fit in the send queue; value is a pointer to an IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY, any other value fails with IOTHUB_CLIENT_INVALID_ARG. ]*/
+            if ((policy != IOTHUB_CLIENT_SEND_QUEUE_FULL_REJECT) &&
+                (policy != IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK) &&
+                (policy != IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST) &&
+                (policy != IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_LOWEST_PRIORITY))
+            {
+                LogError("Invalid send queue full policy %d", (int)policy);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                handleData->send_queue_full_policy = policy;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(optionName, OPTION_LATENCY_STATISTICS) == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_061: [ latency_statistics - shall turn on or off the measurement of the time from IoTHubClientCore_LL_SendEventAsync to the acknowledgement of the events sent from then on; value is a pointer to a bool. ]*/
+            handleData->latency_statistics = *(const bool*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
         else if (strcmp(optionName, OPTION_DIAGNOSTIC_SAMPLING_PERCENTAGE) == 0)
         {
             uint32_t percentage = *(uint32_t*)value;
@@ -2290,11 +3198,16 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetOption(IOTHUB_CLIENT_CORE_LL_HANDLE
                 result = IOTHUB_CLIENT_OK;
             }
         }
-        else if ((strcmp(optionName, OPTION_BLOB_UPLOAD_TIMEOUT_SECS) == 0) || (strcmp(optionName, OPTION_CURL_VERBOSE) == 0))
+        else if ((strcmp(optionName, OPTION_BLOB_UPLOAD_TIMEOUT_SECS) == 0) || (strcmp(optionName, OPTION_BLOB_UPLOAD_CONCURRENT_BLOCKS) == 0) ||
+            (strcmp(optionName, OPTION_BLOB_UPLOAD_CHECKPOINT_FILE) == 0) || (strcmp(optionName, OPTION_BLOB_UPLOAD_BLOCK_SIZE) == 0) ||
+            (strcmp(optionName, OPTION_CURL_VERBOSE) == 0))
         {
 #ifndef DONT_USE_UPLOADTOBLOB
             // This option just gets passed down into IoTHubClientCore_LL_UploadToBlob
             /*Codes_SRS_IOTHUBCLIENT_LL_30_010: [ blob_xfr_timeout - IoTHubClientCore_LL_SetOption shall pass this option to IoTHubClient_UploadToBlob_SetOption and return its result. ]*/
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_067: [ `blob_upload_concurrent_blocks` - `IoTHubClient_LL_SetOption` shall pass this option to `IoTHubClient_UploadToBlob_SetOption` and return its result. ]*/
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_071: [ `blob_upload_checkpoint_file` - `IoTHubClient_LL_SetOption` shall pass this option to `IoTHubClient_UploadToBlob_SetOption` and return its result. ]*/
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_081: [ `blob_upload_block_size` - `IoTHubClient_LL_SetOption` shall pass this option to `IoTHubClient_UploadToBlob_SetOption` and return its result. ]*/
             result = IoTHubClient_LL_UploadToBlob_SetOption(handleData->uploadToBlobHandle, optionName, value);
             if(result != IOTHUB_CLIENT_OK)
             {
@@ -2319,6 +3232,19 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetOption(IOTHUB_CLIENT_CORE_LL_HANDLE
                 result = IOTHUB_CLIENT_OK;
             }
         }
+        else if (strcmp(optionName, OPTION_SAS_TOKEN_CACHE_REFRESH_PERCENT) == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_064: [ sas_token_cache_refresh_percent - shall pass value, a pointer to a size_t, to IoTHubClient_Auth_Set_SasToken_Cache_Refresh_Percent and fail with IOTHUB_CLIENT_ERROR if it fails. ]*/
+            if (IoTHubClient_Auth_Set_SasToken_Cache_Refresh_Percent(handleData->authorization_module, *(const size_t*)value) != 0)
+            {
+                LogError("Failed setting the sas token cache refresh percent");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
         else
         {
             // This section is unusual for SetOption calls because it attempts to pass unhandled options
@@ -2382,6 +3308,102 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetDeviceTwinCallback(IOTHUB_CLIENT_COR
     return result;
 }
 
+static void start_coalescing_window(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_DEVICE_TWIN* client_data, size_t size)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_09_021: [ If "twin_reported_state_coalesce_ms" is set, a new device twin item shall be held back for that long, unless its size reaches "twin_reported_state_coalesce_max_bytes". ]*/
+    if (handleData->reported_state_coalesce_ms > 0 &&
+        (handleData->reported_state_coalesce_max_bytes == 0 || size < handleData->reported_state_coalesce_max_bytes))
+    {
+        tickcounter_ms_t current_time;
+
+        if (tickcounter_get_current_ms(handleData->tickCounter, &current_time) != 0)
+        {
+            LogError("unable to get the current relative tickcount; reported state will not be coalesced");
+        }
+        else
+        {
+            client_data->ms_coalesceUntil = current_time + handleData->reported_state_coalesce_ms;
+        }
+    }
+}
+
+/*returns 0 if reportedState was merged into the newest device twin item still waiting to be sent, any other value otherwise*/
+static int coalesce_reported_state(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, const unsigned char* reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback, void* userContextCallback)
+{
+    int result;
+    IOTHUB_DEVICE_TWIN* pending_report;
+    IOTHUB_DEVICE_TWIN* merged_caller;
+    CONSTBUFFER_HANDLE merged_patch;
+
+    if (handleData->reported_state_coalesce_ms == 0 || DList_IsListEmpty(&(handleData->iot_msg_queue)))
+    {
+        result = MU_FAILURE;
+    }
+    else if ((pending_report = containingRecord(handleData->iot_msg_queue.Blink, IOTHUB_DEVICE_TWIN, entry))->ms_coalesceUntil == 0)
+    {
+        /*this item was released to be sent as is*/
+        result = MU_FAILURE;
+    }
+    else if ((merged_caller = (IOTHUB_DEVICE_TWIN*)malloc(sizeof(IOTHUB_DEVICE_TWIN))) == NULL)
+    {
+        LogError("Failure allocating device twin information");
+        result = MU_FAILURE;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_09_020: [ If "twin_reported_state_coalesce_ms" is set and the newest device twin item was not handed to the transport yet, IoTHubClientCore_LL_SendReportedState shall merge reportedState into it using IoTHubClient_TwinPatch_Merge. ]*/
+    else if ((merged_patch = IoTHubClient_TwinPatch_Merge(pending_report->report_data_handle, reportedState, size)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_09_088: [ If the patches cannot be merged, the newest item shall be released to be sent and reportedState shall be queued as a new item. ]*/
+        free(merged_caller);
+        pending_report->ms_coalesceUntil = 0;
+        result = MU_FAILURE;
+    }
+    else
+    {
+        size_t merged_size = CONSTBUFFER_GetContent(merged_patch)->size;
+
+        if (handleData->reported_state_coalesce_max_bytes > 0 && merged_size > handleData->reported_state_coalesce_max_bytes)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_024: [ If the merged patch would exceed "twin_reported_state_coalesce_max_bytes", the newest item shall be released to be sent and reportedState shall be queued as a new item. ]*/
+            CONSTBUFFER_DecRef(merged_patch);
+            free(merged_caller);
+            pending_report->ms_coalesceUntil = 0;
+            result = MU_FAILURE;
+        }
+        else
+        {
+            IOTHUB_DEVICE_TWIN* last_report = pending_report;
+
+            CONSTBUFFER_DecRef(pending_report->report_data_handle);
+            pending_report->report_data_handle = merged_patch;
+
+            merged_caller->item_id = pending_report->item_id;
+            merged_caller->ms_timesOutAfter = 0;
+            merged_caller->reported_state_callback = reportedStateCallback;
+            merged_caller->report_data_handle = NULL;
+            merged_caller->context = userContextCallback;
+            merged_caller->client_handle = handleData;
+            merged_caller->device_handle = handleData->deviceHandle;
+            merged_caller->ms_coalesceUntil = 0;
+            merged_caller->next_merged_report = NULL;
+
+            while (last_report->next_merged_report != NULL)
+            {
+                last_report = last_report->next_merged_report;
+            }
+            last_report->next_merged_report = merged_caller;
+
+            if (handleData->reported_state_coalesce_max_bytes > 0 && merged_size == handleData->reported_state_coalesce_max_bytes)
+            {
+                pending_report->ms_coalesceUntil = 0;
+            }
+
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendReportedState(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, const unsigned char* reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -2396,9 +3418,14 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendReportedState(IOTHUB_CLIENT_CORE_LL
     else
     {
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+        IOTHUB_DEVICE_TWIN* client_data;
+
+        if (coalesce_reported_state(handleData, reportedState, size, reportedStateCallback, userContextCallback) == 0)
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
         /* Codes_SRS_IOTHUBCLIENT_LL_10_014: [IoTHubClientCore_LL_SendReportedState shall construct and queue the reported a Device_Twin structure for transmition by the underlying transport.] */
-        IOTHUB_DEVICE_TWIN* client_data = dev_twin_data_create(handleData, get_next_item_id(handleData), reportedState, size, reportedStateCallback, userContextCallback);
-        if (client_data == NULL)
+        else if ((client_data = dev_twin_data_create(handleData, get_next_item_id(handleData), reportedState, size, reportedStateCallback, userContextCallback)) == NULL)
         {
             /* Codes_SRS_IOTHUBCLIENT_LL_10_015: [If any error is encountered IoTHubClientCore_LL_SendReportedState shall return IOTHUB_CLIENT_ERROR.] */
             LogError("Failure constructing device twin data");
@@ -2416,6 +3443,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendReportedState(IOTHUB_CLIENT_CORE_LL
             {
                 /* Codes_SRS_IOTHUBCLIENT_LL_07_001: [ IoTHubClientCore_LL_SendReportedState shall queue the constructed reportedState data to be consumed by the targeted transport. ] */
                 DList_InsertTailList(&(iotHubClientHandle->iot_msg_queue), &(client_data->entry));
+                start_coalescing_window(handleData, client_data, size);
 
                 /* Codes_SRS_IOTHUBCLIENT_LL_10_016: [ Otherwise IoTHubClientCore_LL_SendReportedState shall succeed and return IOTHUB_CLIENT_OK.] */
                 result = IOTHUB_CLIENT_OK;
@@ -2479,6 +3507,173 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GetTwinAsync(IOTHUB_CLIENT_CORE_LL_HAND
     return result;
 }
 
+static void count_waiting_events(PDLIST_ENTRY events, size_t* messages, size_t* bytes)
+{
+    PDLIST_ENTRY currentEntry;
+
+    for (currentEntry = events->Flink; currentEntry != events; currentEntry = currentEntry->Flink)
+    {
+        IOTHUB_MESSAGE_LIST* waitingEvent = containingRecord(currentEntry, IOTHUB_MESSAGE_LIST, entry);
+        (*messages)++;
+        (*bytes) += waitingEvent->message_size;
+    }
+}
+
+static uint64_t get_latency_percentile(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, uint64_t samples, uint64_t percent)
+{
+    uint64_t result = 0;
+    uint64_t rank = (samples * percent + 99) / 100;
+    uint64_t seen = 0;
+    size_t bucket;
+
+    for (bucket = 0; bucket < LATENCY_HISTOGRAM_BUCKETS; bucket++)
+    {
+        seen += handleData->latency_histogram[bucket];
+        if (seen >= rank)
+        {
+            /*bucket 0 only holds 0 ms, bucket i holds latencies up to 2^i - 1 ms*/
+            result = (bucket == 0) ? 0 : (((uint64_t)1 << bucket) - 1);
+            break;
+        }
+    }
+
+    return (result < handleData->latency_max_ms) ? result : handleData->latency_max_ms;
+}
+
+static void fill_latency_percentiles(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_CLIENT_STATISTICS* statistics)
+{
+    uint64_t samples = 0;
+    size_t bucket;
+
+    for (bucket = 0; bucket < LATENCY_HISTOGRAM_BUCKETS; bucket++)
+    {
+        samples += handleData->latency_histogram[bucket];
+    }
+
+    statistics->latency_samples = samples;
+    if (samples == 0)
+    {
+        statistics->latency_p50_ms = 0;
+        statistics->latency_p90_ms = 0;
+        statistics->latency_p99_ms = 0;
+    }
+    else
+    {
+        statistics->latency_p50_ms = get_latency_percentile(handleData, samples, 50);
+        statistics->latency_p90_ms = get_latency_percentile(handleData, samples, 90);
+        statistics->latency_p99_ms = get_latency_percentile(handleData, samples, 99);
+    }
+    statistics->latency_max_ms = handleData->latency_max_ms;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_CheckSendQueueRoom(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    // Codes_SRS_IOTHUBCLIENT_LL_09_083: [ If `iotHubClientHandle` or `eventMessageHandle` are `NULL`, `IoTHubClientCore_LL_CheckSendQueueRoom` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]
+    if (iotHubClientHandle == NULL || eventMessageHandle == NULL)
+    {
+        LogError("Invalid argument iothubClientHandle=%p, eventMessageHandle=%p", iotHubClientHandle, eventMessageHandle);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if ((iotHubClientHandle->send_queue_max_messages == 0) && (iotHubClientHandle->send_queue_max_bytes == 0))
+    {
+        // Codes_SRS_IOTHUBCLIENT_LL_09_084: [ If the send queue is not limited, `IoTHubClientCore_LL_CheckSendQueueRoom` shall return `IOTHUB_CLIENT_OK`. ]
+        result = IOTHUB_CLIENT_OK;
+    }
+    else
+    {
+        size_t messageSize = get_message_size(eventMessageHandle);
+
+        if (send_queue_can_never_fit(iotHubClientHandle, messageSize))
+        {
+            // Codes_SRS_IOTHUBCLIENT_LL_09_085: [ If the payload of the event is larger than `send_queue_max_bytes`, `IoTHubClientCore_LL_CheckSendQueueRoom` shall return `IOTHUB_CLIENT_INVALID_ARG`. ]
+            result = IOTHUB_CLIENT_INVALID_ARG;
+        }
+        else if (!send_queue_has_room(iotHubClientHandle, messageSize))
+        {
+            // Codes_SRS_IOTHUBCLIENT_LL_09_086: [ If the event does not fit in the send queue until queued events complete, `IoTHubClientCore_LL_CheckSendQueueRoom` shall return `IOTHUB_CLIENT_QUEUE_FULL`. ]
+            result = IOTHUB_CLIENT_QUEUE_FULL;
+        }
+        else
+        {
+            // Codes_SRS_IOTHUBCLIENT_LL_09_087: [ Otherwise `IoTHubClientCore_LL_CheckSendQueueRoom` shall return `IOTHUB_CLIENT_OK`. ]
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GetStatistics(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATISTICS* statistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    // Codes_SRS_IOTHUBCLIENT_LL_09_055: [ If `iotHubClientHandle` or `statistics` are `NULL`, `IoTHubClientCore_LL_GetStatistics` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]
+    if (iotHubClientHandle == NULL || statistics == NULL)
+    {
+        LogError("Invalid argument iothubClientHandle=%p, statistics=%p", iotHubClientHandle, statistics);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        size_t waiting_messages = 0;
+        size_t waiting_bytes = 0;
+
+        // Codes_SRS_IOTHUBCLIENT_LL_09_056: [ Otherwise `IoTHubClientCore_LL_GetStatistics` shall fill `statistics` with the send queue counters and return `IOTHUB_CLIENT_OK`. ]
+        statistics->queued_messages = iotHubClientHandle->queued_messages;
+        statistics->queued_bytes = iotHubClientHandle->queued_bytes;
+        statistics->dropped_messages = iotHubClientHandle->dropped_messages;
+        statistics->rejected_messages = iotHubClientHandle->rejected_messages;
+
+        // Codes_SRS_IOTHUBCLIENT_LL_09_062: [ The in flight counters shall be the queued counters minus the events still in waitingToSend or held back by the rate limiter. ]
+        count_waiting_events(&(iotHubClientHandle->waitingToSend), &waiting_messages, &waiting_bytes);
+        count_waiting_events(&(iotHubClientHandle->waitingToAdmit), &waiting_messages, &waiting_bytes);
+        statistics->in_flight_messages = (iotHubClientHandle->queued_messages > waiting_messages) ? iotHubClientHandle->queued_messages - waiting_messages : 0;
+        statistics->in_flight_bytes = (iotHubClientHandle->queued_bytes > waiting_bytes) ? iotHubClientHandle->queued_bytes - waiting_bytes : 0;
+
+        statistics->acked_messages = iotHubClientHandle->acked_messages;
+        statistics->timed_out_messages = iotHubClientHandle->timed_out_messages;
+        statistics->failed_messages = iotHubClientHandle->failed_messages;
+        statistics->reconnects = iotHubClientHandle->reconnects;
+        statistics->twin_updates_received = iotHubClientHandle->twin_updates_received;
+        statistics->reported_states_completed = iotHubClientHandle->reported_states_completed;
+        statistics->method_invocations = iotHubClientHandle->method_invocations;
+
+        // Codes_SRS_IOTHUBCLIENT_LL_09_063: [ Each latency percentile shall be the upper bound of the histogram bucket holding it, capped by the longest latency measured. ]
+        fill_latency_percentiles(iotHubClientHandle, statistics);
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GetTwinCache(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_TWIN_CACHE_HANDLE* twinCache)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    // Codes_SRS_IOTHUBCLIENT_LL_09_031: [ If `iotHubClientHandle` or `twinCache` are `NULL`, `IoTHubClientCore_LL_GetTwinCache` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]
+    if (iotHubClientHandle == NULL || twinCache == NULL)
+    {
+        LogError("Invalid argument iothubClientHandle=%p, twinCache=%p", iotHubClientHandle, twinCache);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    // Codes_SRS_IOTHUBCLIENT_LL_09_032: [ If "twin_cache" was not turned on, `IoTHubClientCore_LL_GetTwinCache` shall fail and return `IOTHUB_CLIENT_ERROR`. ]
+    else if (iotHubClientHandle->twin_cache == NULL)
+    {
+        LogError("The twin cache is not turned on (see OPTION_TWIN_CACHE)");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        // Codes_SRS_IOTHUBCLIENT_LL_09_033: [ Otherwise `IoTHubClientCore_LL_GetTwinCache` shall return the twin cache in `twinCache` and `IOTHUB_CLIENT_OK`. ]
+        *twinCache = iotHubClientHandle->twin_cache;
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
 
 IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetDeviceMethodCallback(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC deviceMethodCallback, void* userContextCallback)
 {
@@ -2640,7 +3835,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_DeviceMethodResponse(IOTHUB_CLIENT_CORE
     {
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
         /* Codes_SRS_IOTHUBCLIENT_LL_07_027: [ IoTHubClientCore_LL_DeviceMethodResponse shall call the IoTHubTransport_DeviceMethod_Response transport function.] */
-        if (handleData->IoTHubTransport_DeviceMethod_Response(handleData->deviceHandle, methodId, response, response_size, status_response) != 0)
+        if (send_device_method_response(handleData, methodId, response, response_size, status_response) != 0)
         {
             LogError("IoTHubTransport_DeviceMethod_Response failed");
             result = IOTHUB_CLIENT_ERROR;
@@ -2676,6 +3871,27 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_UploadToBlob(IOTHUB_CLIENT_CORE_LL_HAND
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_UploadFileToBlob(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, const char* destinationFileName, const char* sourceFilePath)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_09_079: [ If `iotHubClientHandle`, `destinationFileName` or `sourceFilePath` are `NULL`, `IoTHubClientCore_LL_UploadFileToBlob` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (destinationFileName == NULL) ||
+        (sourceFilePath == NULL)
+        )
+    {
+        LogError("invalid parameters IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle=%p, const char* destinationFileName=%p, const char* sourceFilePath=%p", iotHubClientHandle, destinationFileName, sourceFilePath);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_09_080: [ `IoTHubClientCore_LL_UploadFileToBlob` shall call `IoTHubClient_LL_UploadFileToBlob_Impl` and return its result. ]*/
+        result = IoTHubClient_LL_UploadFileToBlob_Impl(iotHubClientHandle->uploadToBlobHandle, destinationFileName, sourceFilePath);
+    }
+    return result;
+}
+
 typedef struct UPLOAD_MULTIPLE_BLOCKS_WRAPPER_CONTEXT_TAG
 {
     IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK getDataCallback;
@@ -2778,6 +3994,12 @@ static IOTHUB_CLIENT_RESULT create_event_handler_callback(IOTHUB_CLIENT_CORE_LL_
         LogError("Could not allocate linked list for callbacks");
         result = IOTHUB_CLIENT_ERROR;
     }
+    // Codes_SRS_IOTHUBCLIENT_LL_09_035: [ `IoTHubClient_LL_SetInputMessageCallback` shall keep an input route table with each registered inputName hashed to its callback handle, and the default handler apart. ]
+    else if ((handleData->input_routes == NULL) && (resize_input_routes(handleData, INPUT_ROUTE_INITIAL_BUCKET_COUNT) != 0))
+    {
+        LogError("Could not allocate input route table");
+        result = IOTHUB_CLIENT_ERROR;
+    }
     else
     {
         IOTHUB_EVENT_CALLBACK* event_callback = NULL;
@@ -2812,6 +4034,7 @@ static IOTHUB_CLIENT_RESULT create_event_handler_callback(IOTHUB_CLIENT_CORE_LL_
             if ((inputName != NULL) && (event_callback->inputName == NULL))
             {
                 event_callback->inputName = STRING_construct(inputName);
+                event_callback->inputNameHash = get_input_name_hash(inputName);
             }
 
             if ((inputName == NULL) || (event_callback->inputName != NULL))
@@ -2847,6 +4070,11 @@ static IOTHUB_CLIENT_RESULT create_event_handler_callback(IOTHUB_CLIENT_CORE_LL_
                         // Codes_SRS_IOTHUBCLIENT_LL_31_141: [`IoTHubClient_LL_SetInputMessageCallbackEx` shall copy the data passed in extended context. ]
                         memcpy(event_callback->userContextCallbackEx, userContextCallbackEx, userContextCallbackExLength);
                     }
+
+                    if (add_to_list == true)
+                    {
+                        add_input_route(handleData, event_callback);
+                    }
                     result = IOTHUB_CLIENT_OK;
                 }
             }
@@ -2882,6 +4110,8 @@ static IOTHUB_CLIENT_RESULT remove_event_unsubscribe_if_needed(IOTHUB_CLIENT_COR
         }
         else
         {
+            // Codes_SRS_IOTHUBCLIENT_LL_09_036: [ If `eventHandlerCallback` is NULL, `IoTHubClient_LL_SetInputMessageCallback` shall remove the callback handle of `inputName` from the input route table. ]
+            remove_input_route(handleData, event_callback);
             delete_event(event_callback);
             // Codes_SRS_IOTHUBCLIENT_LL_31_131: [ If `eventHandlerCallback` is NULL, `IoTHubClient_LL_SetInputMessageCallback` shall remove the `inputName` from its callback list if present. ]
             if (singlylinkedlist_remove(handleData->event_callbacks, item_handle) != 0)
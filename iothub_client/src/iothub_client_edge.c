@@ -14,6 +14,7 @@
 #include "azure_c_shared_utility/shared_util_options.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/envvariable.h"
+#include "azure_c_shared_utility/lock.h"
 
 #include "parson.h"
 
@@ -22,6 +23,7 @@
 #include "iothub_client_core_common.h"
 #include "iothub_client_version.h"
 #include "internal/iothub_client_edge.h"
+#include "internal/iothub_client_trust_bundle.h"
 
 #define  HTTP_HEADER_KEY_AUTHORIZATION  "Authorization"
 #define  HTTP_HEADER_VAL_AUTHORIZATION  " "
@@ -36,6 +38,9 @@
 
 #define SASTOKEN_LIFETIME 3600
 
+// Idle connections to edgeHub kept by a handle, one per HTTP worker thread of the client invoking methods concurrently.
+#define HTTP_CONNECTION_POOL_SIZE 4
+
 static const char* const URL_API_VERSION = "?api-version=2018-06-27";
 static const char* const RELATIVE_PATH_FMT_MODULE_METHOD = "/twins/%s/modules/%s/methods%s";
 static const char* const RELATIVE_PATH_FMT_DEVICE_METHOD = "/twins/%s/methods%s";
@@ -51,6 +56,10 @@ typedef struct IOTHUB_CLIENT_EDGE_HANDLE_DATA_TAG
     char* deviceId;
     char* moduleId;
     IOTHUB_AUTHORIZATION_HANDLE authorizationHandle;
+    const char* trustedCertificate; // Acquired for the first new connection, released with the handle or when a request fails.
+    LOCK_HANDLE lock;               // Method invokes run on the HTTP worker threads of the client.
+    HTTPAPIEX_HANDLE idleConnections[HTTP_CONNECTION_POOL_SIZE];
+    size_t idleConnectionCount;
 } IOTHUB_CLIENT_EDGE_HANDLE_DATA;
 
 
@@ -91,6 +100,12 @@ IOTHUB_CLIENT_EDGE_HANDLE IoTHubClient_EdgeHandle_Create(const IOTHUB_CLIENT_CON
             IoTHubClient_EdgeHandle_Destroy(handleData);
             handleData = NULL;
         }
+        else if ((handleData->lock = Lock_Init()) == NULL)
+        {
+            LogError("Failed to create lock");
+            IoTHubClient_EdgeHandle_Destroy(handleData);
+            handleData = NULL;
+        }
     }
 
     return (IOTHUB_CLIENT_EDGE_HANDLE)handleData;
@@ -100,9 +115,20 @@ void IoTHubClient_EdgeHandle_Destroy(IOTHUB_CLIENT_EDGE_HANDLE methodHandle)
 {
     if (methodHandle != NULL)
     {
+        size_t index;
+
         free(methodHandle->hostname);
         free(methodHandle->deviceId);
         free(methodHandle->moduleId);
+        for (index = 0; index < methodHandle->idleConnectionCount; index++)
+        {
+            HTTPAPIEX_Destroy(methodHandle->idleConnections[index]);
+        }
+        IoTHubClient_TrustBundle_Release(methodHandle->trustedCertificate);
+        if (methodHandle->lock != NULL)
+        {
+            (void)Lock_Deinit(methodHandle->lock);
+        }
         //Do not free authorizationHandle for now, since its a pointer to something owned by Core_LL_Handle
         free(methodHandle);
     }
@@ -372,6 +398,74 @@ static STRING_HANDLE createRelativePath(const char* deviceId, const char* module
     return result;
 }
 
+// Takes an idle connection to edgeHub, so the TLS session of a previous invoke is reused, or opens a new one.
+static HTTPAPIEX_HANDLE acquireHttpConnection(IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle, const char* caTrustedCertificateFile)
+{
+    HTTPAPIEX_HANDLE result;
+
+    if (Lock(moduleMethodHandle->lock) != LOCK_OK)
+    {
+        LogError("Failed to lock the Edge handle");
+        result = NULL;
+    }
+    else
+    {
+        if (moduleMethodHandle->idleConnectionCount > 0)
+        {
+            moduleMethodHandle->idleConnectionCount--;
+            result = moduleMethodHandle->idleConnections[moduleMethodHandle->idleConnectionCount];
+        }
+        // The trust bundle is set while holding the lock, as a failed request on another thread releases it.
+        else if (moduleMethodHandle->trustedCertificate == NULL &&
+            (moduleMethodHandle->trustedCertificate = IoTHubClient_TrustBundle_Acquire(moduleMethodHandle->authorizationHandle, caTrustedCertificateFile)) == NULL)
+        {
+            LogError("Failed to get TrustBundle");
+            result = NULL;
+        }
+        else if ((result = HTTPAPIEX_Create(moduleMethodHandle->hostname)) == NULL)
+        {
+            LogError("HTTPAPIEX_Create failed");
+        }
+        else if (HTTPAPIEX_SetOption(result, OPTION_TRUSTED_CERT, moduleMethodHandle->trustedCertificate) != HTTPAPIEX_OK)
+        {
+            LogError("Setting trusted certificate failed");
+            HTTPAPIEX_Destroy(result);
+            result = NULL;
+        }
+
+        (void)Unlock(moduleMethodHandle->lock);
+    }
+
+    return result;
+}
+
+// Keeps the connection for the next invoke unless its request failed or the pool is full.
+// A failed request may come from a rotated edge CA, so the next connection acquires the trust bundle again.
+static void releaseHttpConnection(IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle, HTTPAPIEX_HANDLE httpExApiHandle, bool reusable)
+{
+    if (Lock(moduleMethodHandle->lock) == LOCK_OK)
+    {
+        if (!reusable)
+        {
+            IoTHubClient_TrustBundle_Release(moduleMethodHandle->trustedCertificate);
+            moduleMethodHandle->trustedCertificate = NULL;
+        }
+        else if (moduleMethodHandle->idleConnectionCount < HTTP_CONNECTION_POOL_SIZE)
+        {
+            moduleMethodHandle->idleConnections[moduleMethodHandle->idleConnectionCount] = httpExApiHandle;
+            moduleMethodHandle->idleConnectionCount++;
+            httpExApiHandle = NULL;
+        }
+
+        (void)Unlock(moduleMethodHandle->lock);
+    }
+
+    if (httpExApiHandle != NULL)
+    {
+        HTTPAPIEX_Destroy(httpExApiHandle);
+    }
+}
+
 static IOTHUB_CLIENT_RESULT sendHttpRequestMethod(IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle, const char* deviceId, const char* moduleId, BUFFER_HANDLE deviceJsonBuffer, BUFFER_HANDLE responseBuffer)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -380,7 +474,6 @@ static IOTHUB_CLIENT_RESULT sendHttpRequestMethod(IOTHUB_CLIENT_EDGE_HANDLE modu
     HTTP_HEADERS_HANDLE httpHeader;
     STRING_HANDLE relativePath;
     const char* relativePath_s;
-    char* trustedCertificate;
     unsigned int statusCode = 0;
 
     // The environment variable ENVIRONMENT_VAR_EDGEHUB_CACERTIFICATEFILE is *optional*; it will not be present in 
@@ -411,35 +504,27 @@ static IOTHUB_CLIENT_RESULT sendHttpRequestMethod(IOTHUB_CLIENT_EDGE_HANDLE modu
         STRING_delete(relativePath);
         result = IOTHUB_CLIENT_ERROR;
     }
-    else if ((httpExApiHandle = HTTPAPIEX_Create(moduleMethodHandle->hostname)) == NULL)
-    {
-        LogError("HTTPAPIEX_Create failed");
-        HTTPHeaders_Free(httpHeader);
-        STRING_delete(relativePath);
-        result = IOTHUB_CLIENT_ERROR;
-    }
-    else if ((trustedCertificate = IoTHubClient_Auth_Get_TrustBundle(moduleMethodHandle->authorizationHandle, caTrustedCertificateFile)) == NULL)
+    else if ((httpExApiHandle = acquireHttpConnection(moduleMethodHandle, caTrustedCertificateFile)) == NULL)
     {
-        LogError("Failed to get TrustBundle");
+        LogError("Failed getting a connection to edgeHub");
         HTTPHeaders_Free(httpHeader);
         STRING_delete(relativePath);
-        HTTPAPIEX_Destroy(httpExApiHandle);
         result = IOTHUB_CLIENT_ERROR;
     }
     else
     {
-        if (HTTPAPIEX_SetOption(httpExApiHandle, OPTION_TRUSTED_CERT, trustedCertificate) != HTTPAPIEX_OK)
-        {
-            LogError("Setting trusted certificate failed");
-            result = IOTHUB_CLIENT_ERROR;
-        }
-        else if (HTTPAPIEX_ExecuteRequest(httpExApiHandle, HTTPAPI_REQUEST_POST, relativePath_s, httpHeader, deviceJsonBuffer, &statusCode, NULL, responseBuffer) != HTTPAPIEX_OK)
+        bool requestSent;
+
+        if (HTTPAPIEX_ExecuteRequest(httpExApiHandle, HTTPAPI_REQUEST_POST, relativePath_s, httpHeader, deviceJsonBuffer, &statusCode, NULL, responseBuffer) != HTTPAPIEX_OK)
         {
             LogError("HTTPAPIEX_ExecuteRequest failed");
+            requestSent = false;
             result = IOTHUB_CLIENT_ERROR;
         }
         else
         {
+            requestSent = true;
+
             if (statusCode == 200)
             {
                 result = IOTHUB_CLIENT_OK;
@@ -453,8 +538,7 @@ static IOTHUB_CLIENT_RESULT sendHttpRequestMethod(IOTHUB_CLIENT_EDGE_HANDLE modu
 
         HTTPHeaders_Free(httpHeader);
         STRING_delete(relativePath);
-        HTTPAPIEX_Destroy(httpExApiHandle);
-        free(trustedCertificate);
+        releaseHttpConnection(moduleMethodHandle, httpExApiHandle, requestSent);
     }
 
     return result;
@@ -0,0 +1,458 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include "azure_macro_utils/macro_utils.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/hmacsha256.h"
+
+#include "internal/iothub_client_hmacsha256_batch.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define HMACSHA256_BATCH_LANES 8
+#define SHA256_BLOCK_SIZE 64
+#define SHA256_STATE_WORDS 8
+#define SHA256_LENGTH_SIZE 8
+#define HMAC_IPAD 0x36
+#define HMAC_OPAD 0x5c
+
+static const uint32_t SHA256_K[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t SHA256_H0[SHA256_STATE_WORDS] =
+{
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/*SHA-256 state of every lane, word major so that word i of all the lanes sits in one vector*/
+typedef struct SHA256_LANES_STATE_TAG
+{
+    uint32_t h[SHA256_STATE_WORDS][HMACSHA256_BATCH_LANES];
+} SHA256_LANES_STATE;
+
+/*what one lane is hashing: the padded tail of its message lives in tail, the rest is read from the payload*/
+typedef struct HMACSHA256_LANE_TAG
+{
+    HMACSHA256_BATCH_ITEM* item;
+    size_t block_count;
+    size_t payload_block_count;
+    unsigned char pad_block[SHA256_BLOCK_SIZE];
+    unsigned char tail[2 * SHA256_BLOCK_SIZE];
+} HMACSHA256_LANE;
+
+static uint32_t load_be32(const unsigned char* source)
+{
+    return ((uint32_t)source[0] << 24) | ((uint32_t)source[1] << 16) | ((uint32_t)source[2] << 8) | (uint32_t)source[3];
+}
+
+static void store_be32(unsigned char* destination, uint32_t value)
+{
+    destination[0] = (unsigned char)(value >> 24);
+    destination[1] = (unsigned char)(value >> 16);
+    destination[2] = (unsigned char)(value >> 8);
+    destination[3] = (unsigned char)value;
+}
+
+#if defined(__AVX2__)
+
+#define ROTR_LANES(x, n) _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+
+static void sha256_compress_lanes(SHA256_LANES_STATE* state, const unsigned char* const blocks[HMACSHA256_BATCH_LANES])
+{
+    __m256i w[64];
+    __m256i v[SHA256_STATE_WORDS];
+    int i;
+
+    for (i = 0; i < 16; i++)
+    {
+        w[i] = _mm256_setr_epi32(
+            (int)load_be32(blocks[0] + 4 * i), (int)load_be32(blocks[1] + 4 * i), (int)load_be32(blocks[2] + 4 * i), (int)load_be32(blocks[3] + 4 * i),
+            (int)load_be32(blocks[4] + 4 * i), (int)load_be32(blocks[5] + 4 * i), (int)load_be32(blocks[6] + 4 * i), (int)load_be32(blocks[7] + 4 * i));
+    }
+
+    for (i = 16; i < 64; i++)
+    {
+        __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROTR_LANES(w[i - 15], 7), ROTR_LANES(w[i - 15], 18)), _mm256_srli_epi32(w[i - 15], 3));
+        __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROTR_LANES(w[i - 2], 17), ROTR_LANES(w[i - 2], 19)), _mm256_srli_epi32(w[i - 2], 10));
+        w[i] = _mm256_add_epi32(_mm256_add_epi32(w[i - 16], s0), _mm256_add_epi32(w[i - 7], s1));
+    }
+
+    for (i = 0; i < SHA256_STATE_WORDS; i++)
+    {
+        v[i] = _mm256_loadu_si256((const __m256i*)state->h[i]);
+    }
+
+    for (i = 0; i < 64; i++)
+    {
+        __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROTR_LANES(v[4], 6), ROTR_LANES(v[4], 11)), ROTR_LANES(v[4], 25));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(v[4], v[5]), _mm256_andnot_si256(v[4], v[6]));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(_mm256_add_epi32(v[7], s1), _mm256_add_epi32(ch, _mm256_set1_epi32((int)SHA256_K[i]))), w[i]);
+        __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROTR_LANES(v[0], 2), ROTR_LANES(v[0], 13)), ROTR_LANES(v[0], 22));
+        __m256i maj = _mm256_xor_si256(_mm256_xor_si256(_mm256_and_si256(v[0], v[1]), _mm256_and_si256(v[0], v[2])), _mm256_and_si256(v[1], v[2]));
+        __m256i t2 = _mm256_add_epi32(s0, maj);
+
+        v[7] = v[6];
+        v[6] = v[5];
+        v[5] = v[4];
+        v[4] = _mm256_add_epi32(v[3], t1);
+        v[3] = v[2];
+        v[2] = v[1];
+        v[1] = v[0];
+        v[0] = _mm256_add_epi32(t1, t2);
+    }
+
+    for (i = 0; i < SHA256_STATE_WORDS; i++)
+    {
+        _mm256_storeu_si256((__m256i*)state->h[i], _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)state->h[i]), v[i]));
+    }
+}
+
+#else
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/*same rounds as the vector version, with the lane loop innermost so the compiler can vectorize it*/
+static void sha256_compress_lanes(SHA256_LANES_STATE* state, const unsigned char* const blocks[HMACSHA256_BATCH_LANES])
+{
+    uint32_t w[64][HMACSHA256_BATCH_LANES];
+    uint32_t v[SHA256_STATE_WORDS][HMACSHA256_BATCH_LANES];
+    int i;
+    int lane;
+
+    for (i = 0; i < 16; i++)
+    {
+        for (lane = 0; lane < HMACSHA256_BATCH_LANES; lane++)
+        {
+            w[i][lane] = load_be32(blocks[lane] + 4 * i);
+        }
+    }
+
+    for (i = 16; i < 64; i++)
+    {
+        for (lane = 0; lane < HMACSHA256_BATCH_LANES; lane++)
+        {
+            uint32_t s0 = ROTR32(w[i - 15][lane], 7) ^ ROTR32(w[i - 15][lane], 18) ^ (w[i - 15][lane] >> 3);
+            uint32_t s1 = ROTR32(w[i - 2][lane], 17) ^ ROTR32(w[i - 2][lane], 19) ^ (w[i - 2][lane] >> 10);
+            w[i][lane] = w[i - 16][lane] + s0 + w[i - 7][lane] + s1;
+        }
+    }
+
+    (void)memcpy(v, state->h, sizeof(v));
+
+    for (i = 0; i < 64; i++)
+    {
+        for (lane = 0; lane < HMACSHA256_BATCH_LANES; lane++)
+        {
+            uint32_t s1 = ROTR32(v[4][lane], 6) ^ ROTR32(v[4][lane], 11) ^ ROTR32(v[4][lane], 25);
+            uint32_t ch = (v[4][lane] & v[5][lane]) ^ (~v[4][lane] & v[6][lane]);
+            uint32_t t1 = v[7][lane] + s1 + ch + SHA256_K[i] + w[i][lane];
+            uint32_t s0 = ROTR32(v[0][lane], 2) ^ ROTR32(v[0][lane], 13) ^ ROTR32(v[0][lane], 22);
+            uint32_t maj = (v[0][lane] & v[1][lane]) ^ (v[0][lane] & v[2][lane]) ^ (v[1][lane] & v[2][lane]);
+            uint32_t t2 = s0 + maj;
+
+            v[7][lane] = v[6][lane];
+            v[6][lane] = v[5][lane];
+            v[5][lane] = v[4][lane];
+            v[4][lane] = v[3][lane] + t1;
+            v[3][lane] = v[2][lane];
+            v[2][lane] = v[1][lane];
+            v[1][lane] = v[0][lane];
+            v[0][lane] = t1 + t2;
+        }
+    }
+
+    for (i = 0; i < SHA256_STATE_WORDS; i++)
+    {
+        for (lane = 0; lane < HMACSHA256_BATCH_LANES; lane++)
+        {
+            state->h[i][lane] += v[i][lane];
+        }
+    }
+}
+
+#endif
+
+static void init_lanes_state(SHA256_LANES_STATE* state)
+{
+    int i;
+    int lane;
+
+    for (i = 0; i < SHA256_STATE_WORDS; i++)
+    {
+        for (lane = 0; lane < HMACSHA256_BATCH_LANES; lane++)
+        {
+            state->h[i][lane] = SHA256_H0[i];
+        }
+    }
+}
+
+static void store_lane_digest(const SHA256_LANES_STATE* state, int lane, unsigned char* digest)
+{
+    int i;
+
+    for (i = 0; i < SHA256_STATE_WORDS; i++)
+    {
+        store_be32(digest + 4 * i, state->h[i][lane]);
+    }
+}
+
+/*appends the 0x80 terminator and the big endian bit length of a message that started with one block (the key pad)*/
+static size_t pad_message_tail(unsigned char* tail, const unsigned char* remainder, size_t remainder_length, size_t message_length)
+{
+    size_t block_count = (remainder_length + 1 + SHA256_LENGTH_SIZE <= SHA256_BLOCK_SIZE) ? 1 : 2;
+    uint64_t bit_length = ((uint64_t)SHA256_BLOCK_SIZE + message_length) * 8;
+    size_t i;
+
+    (void)memset(tail, 0, 2 * SHA256_BLOCK_SIZE);
+    if (remainder_length > 0)
+    {
+        (void)memcpy(tail, remainder, remainder_length);
+    }
+    tail[remainder_length] = 0x80;
+
+    for (i = 0; i < SHA256_LENGTH_SIZE; i++)
+    {
+        tail[block_count * SHA256_BLOCK_SIZE - 1 - i] = (unsigned char)(bit_length >> (8 * i));
+    }
+
+    return block_count;
+}
+
+static void prepare_lane(HMACSHA256_LANE* lane, HMACSHA256_BATCH_ITEM* item)
+{
+    size_t payload_block_count = item->payload_length / SHA256_BLOCK_SIZE;
+    size_t i;
+
+    lane->item = item;
+    lane->payload_block_count = payload_block_count;
+    lane->block_count = payload_block_count + pad_message_tail(lane->tail, item->payload + payload_block_count * SHA256_BLOCK_SIZE, item->payload_length - payload_block_count * SHA256_BLOCK_SIZE, item->payload_length);
+
+    (void)memset(lane->pad_block, 0, SHA256_BLOCK_SIZE);
+    if (item->key_length > 0)
+    {
+        (void)memcpy(lane->pad_block, item->key, item->key_length);
+    }
+    for (i = 0; i < SHA256_BLOCK_SIZE; i++)
+    {
+        lane->pad_block[i] ^= HMAC_IPAD;
+    }
+}
+
+/*signs up to HMACSHA256_BATCH_LANES items with keys no longer than one block; unused lanes hash a zero block*/
+static void compute_hashes_in_lanes(HMACSHA256_BATCH_ITEM** items, size_t item_count)
+{
+    static const unsigned char zero_block[SHA256_BLOCK_SIZE] = { 0 };
+    HMACSHA256_LANE lanes[HMACSHA256_BATCH_LANES];
+    const unsigned char* blocks[HMACSHA256_BATCH_LANES];
+    SHA256_LANES_STATE state;
+    SHA256_LANES_STATE previous_state;
+    size_t max_block_count = 0;
+    size_t block_index;
+    size_t lane;
+    size_t i;
+
+    for (lane = 0; lane < item_count; lane++)
+    {
+        prepare_lane(&lanes[lane], items[lane]);
+        if (lanes[lane].block_count > max_block_count)
+        {
+            max_block_count = lanes[lane].block_count;
+        }
+    }
+
+    // Inner hash: H((K ^ ipad) || payload).
+    init_lanes_state(&state);
+    for (lane = 0; lane < HMACSHA256_BATCH_LANES; lane++)
+    {
+        blocks[lane] = (lane < item_count) ? lanes[lane].pad_block : zero_block;
+    }
+    sha256_compress_lanes(&state, blocks);
+
+    for (block_index = 0; block_index < max_block_count; block_index++)
+    {
+        previous_state = state;
+
+        for (lane = 0; lane < HMACSHA256_BATCH_LANES; lane++)
+        {
+            if (lane >= item_count || block_index >= lanes[lane].block_count)
+            {
+                blocks[lane] = zero_block;
+            }
+            else if (block_index < lanes[lane].payload_block_count)
+            {
+                blocks[lane] = lanes[lane].item->payload + block_index * SHA256_BLOCK_SIZE;
+            }
+            else
+            {
+                blocks[lane] = lanes[lane].tail + (block_index - lanes[lane].payload_block_count) * SHA256_BLOCK_SIZE;
+            }
+        }
+
+        sha256_compress_lanes(&state, blocks);
+
+        // Lanes whose message already ended keep the state they had before this block.
+        for (lane = 0; lane < item_count; lane++)
+        {
+            if (block_index >= lanes[lane].block_count)
+            {
+                for (i = 0; i < SHA256_STATE_WORDS; i++)
+                {
+                    state.h[i][lane] = previous_state.h[i][lane];
+                }
+            }
+        }
+    }
+
+    // Outer hash: H((K ^ opad) || inner hash), always two blocks long.
+    for (lane = 0; lane < item_count; lane++)
+    {
+        unsigned char inner_hash[HMACSHA256_BATCH_HASH_SIZE];
+
+        for (i = 0; i < SHA256_BLOCK_SIZE; i++)
+        {
+            lanes[lane].pad_block[i] ^= (HMAC_IPAD ^ HMAC_OPAD);
+        }
+
+        store_lane_digest(&state, (int)lane, inner_hash);
+        (void)pad_message_tail(lanes[lane].tail, inner_hash, sizeof(inner_hash), sizeof(inner_hash));
+    }
+
+    init_lanes_state(&state);
+    for (lane = 0; lane < HMACSHA256_BATCH_LANES; lane++)
+    {
+        blocks[lane] = (lane < item_count) ? lanes[lane].pad_block : zero_block;
+    }
+    sha256_compress_lanes(&state, blocks);
+
+    for (lane = 0; lane < HMACSHA256_BATCH_LANES; lane++)
+    {
+        blocks[lane] = (lane < item_count) ? lanes[lane].tail : zero_block;
+    }
+    sha256_compress_lanes(&state, blocks);
+
+    for (lane = 0; lane < item_count; lane++)
+    {
+        store_lane_digest(&state, (int)lane, lanes[lane].item->hash);
+    }
+}
+
+static int compute_hash_one_by_one(HMACSHA256_BATCH_ITEM* item)
+{
+    int result;
+    BUFFER_HANDLE hash;
+
+    if ((hash = BUFFER_new()) == NULL)
+    {
+        LogError("Failed allocating the hash buffer");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        if (HMACSHA256_ComputeHash(item->key, item->key_length, item->payload, item->payload_length, hash) != HMACSHA256_OK)
+        {
+            LogError("Failed computing HMAC-SHA256");
+            result = MU_FAILURE;
+        }
+        else if (BUFFER_length(hash) != HMACSHA256_BATCH_HASH_SIZE)
+        {
+            LogError("Unexpected HMAC-SHA256 length (%lu)", (unsigned long)BUFFER_length(hash));
+            result = MU_FAILURE;
+        }
+        else
+        {
+            (void)memcpy(item->hash, BUFFER_u_char(hash), HMACSHA256_BATCH_HASH_SIZE);
+            result = 0;
+        }
+
+        BUFFER_delete(hash);
+    }
+
+    return result;
+}
+
+int HMACSHA256_Batch_ComputeHashes(HMACSHA256_BATCH_ITEM* items, size_t item_count)
+{
+    int result;
+
+    if (items == NULL || item_count == 0)
+    {
+        // Codes_SRS_IOTHUB_CLIENT_HMACSHA256_BATCH_09_001: [ If `items` is NULL or `item_count` is zero, HMACSHA256_Batch_ComputeHashes shall fail and return non-zero. ]
+        LogError("Invalid argument (items=%p, item_count=%lu)", items, (unsigned long)item_count);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        HMACSHA256_BATCH_ITEM* group[HMACSHA256_BATCH_LANES];
+        size_t group_count = 0;
+        size_t i;
+
+        result = 0;
+
+        for (i = 0; i < item_count; i++)
+        {
+            if (items[i].payload == NULL && items[i].payload_length > 0)
+            {
+                // Codes_SRS_IOTHUB_CLIENT_HMACSHA256_BATCH_09_002: [ If any item has a NULL `payload` with a non-zero `payload_length`, or a NULL `key` with a non-zero `key_length`, HMACSHA256_Batch_ComputeHashes shall fail and return non-zero. ]
+                LogError("Invalid payload on item %lu", (unsigned long)i);
+                result = MU_FAILURE;
+            }
+            else if (items[i].key == NULL && items[i].key_length > 0)
+            {
+                LogError("Invalid key on item %lu", (unsigned long)i);
+                result = MU_FAILURE;
+            }
+            else if (items[i].key_length > SHA256_BLOCK_SIZE)
+            {
+                // Codes_SRS_IOTHUB_CLIENT_HMACSHA256_BATCH_09_003: [ Items with a key longer than 64 bytes shall be signed with HMACSHA256_ComputeHash. ]
+                if (compute_hash_one_by_one(&items[i]) != 0)
+                {
+                    result = MU_FAILURE;
+                }
+            }
+            else
+            {
+                // Codes_SRS_IOTHUB_CLIENT_HMACSHA256_BATCH_09_004: [ The other items shall be signed in groups of up to 8, each item in its own lane of the SHA-256 compression. ]
+                group[group_count++] = &items[i];
+
+                if (group_count == HMACSHA256_BATCH_LANES)
+                {
+                    compute_hashes_in_lanes(group, group_count);
+                    group_count = 0;
+                }
+            }
+        }
+
+        if (group_count == 1)
+        {
+            // Codes_SRS_IOTHUB_CLIENT_HMACSHA256_BATCH_09_005: [ A group of a single item shall be signed with HMACSHA256_ComputeHash. ]
+            if (compute_hash_one_by_one(group[0]) != 0)
+            {
+                result = MU_FAILURE;
+            }
+        }
+        else if (group_count > 1)
+        {
+            compute_hashes_in_lanes(group, group_count);
+        }
+    }
+
+    return result;
+}
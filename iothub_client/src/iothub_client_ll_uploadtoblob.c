@@ -4,7 +4,22 @@
 #ifndef DONT_USE_UPLOADTOBLOB
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
 #include <string.h>
+#include <errno.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/string_tokenizer.h"
@@ -14,6 +29,7 @@
 #include "azure_c_shared_utility/httpapiexsas.h"
 #include "azure_c_shared_utility/shared_util_options.h"
 #include "azure_c_shared_utility/urlencode.h"
+#include "azure_c_shared_utility/sha.h"
 
 #include "iothub_client_core_ll.h"
 #include "iothub_client_options.h"
@@ -27,6 +43,9 @@
 
 #define API_VERSION "?api-version=2016-11-14"
 
+// "<block size> <source size> <content id>", identifying the source of an upload in the checkpoint
+#define UPLOAD_SOURCE_ID_SIZE 128
+
 #ifdef WINCE
 #include <stdarg.h>
 // Returns number of characters copied.
@@ -83,13 +102,41 @@ typedef struct IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA_TAG
     HTTP_PROXY_OPTIONS http_proxy_options;
     UPOADTOBLOB_CURL_VERBOSITY curl_verbosity_level;
     size_t blob_upload_timeout_secs;
+    size_t blob_upload_concurrent_blocks;
+    char* blob_upload_checkpoint_file;
+    size_t blob_upload_block_size;
 }IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA;
 
+typedef struct UPLOAD_SOURCE_FILE_TAG
+{
+#if defined(__unix__) || defined(__APPLE__)
+    int fd;
+    uint64_t size;
+    uint64_t offset; /* offset of the next block */
+    size_t pageSize; /* mappings start at a multiple of the page size */
+    void* window; /* read-only mapping of the block handed out last, NULL if none */
+    size_t windowSize;
+#elif defined(_WIN32) && !defined(WINCE)
+    HANDLE file;
+    HANDLE mapping; /* NULL for an empty file, which cannot be mapped */
+    uint64_t size;
+    uint64_t offset; /* offset of the next block */
+    DWORD allocationGranularity; /* views start at a multiple of the allocation granularity */
+    void* window; /* read-only view of the block handed out last, NULL if none */
+#else
+    FILE* file;
+    unsigned char* block; /* buffer the blocks are read into, one at a time */
+#endif
+} UPLOAD_SOURCE_FILE;
+
 typedef struct BLOB_UPLOAD_CONTEXT_TAG
 {
     const unsigned char* blobSource; /* source to upload */
     size_t blobSourceSize; /* size of the source */
     size_t remainingSizeToUpload; /* size not yet uploaded */
+    size_t blockSize; /* size of the blocks the source is split into */
+    UPLOAD_SOURCE_FILE* sourceFile; /* file the blocks are mapped or read from instead of blobSource, NULL if none */
+    bool sourceFileFailed; /* set when a block of sourceFile could not be mapped or read, the upload is then aborted as failed */
 } BLOB_UPLOAD_CONTEXT;
 
 static int send_http_sas_request(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_client, const char* uri_resource, HTTPAPIEX_HANDLE http_api_handle, const char* relative_path, HTTP_HEADERS_HANDLE request_header, BUFFER_HANDLE blobBuffer, BUFFER_HANDLE response_buff)
@@ -261,6 +308,7 @@ IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE IoTHubClient_LL_UploadToBlob_Create(const I
             memset(upload_data, 0, sizeof(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA));
 
             upload_data->authorization_module = auth_handle;
+            upload_data->blob_upload_block_size = BLOCK_SIZE;
 
             size_t iotHubNameLength = strlen(config->iotHubName);
             size_t iotHubSuffixLength = strlen(config->iotHubSuffix);
@@ -612,9 +660,279 @@ static int IoTHubClient_LL_UploadToBlob_step3(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HAND
     return result;
 }
 
+#if defined(__unix__) || defined(__APPLE__)
+static int open_source_file(const char* source_file_path, UPLOAD_SOURCE_FILE* source_file)
+{
+    int result;
+    struct stat file_stat;
+    long page_size;
+    int fd = open(source_file_path, O_RDONLY);
+
+    if (fd == -1)
+    {
+        LogError("unable to open %s (errno %d)", source_file_path, errno);
+        result = MU_FAILURE;
+    }
+    else if (fstat(fd, &file_stat) != 0)
+    {
+        LogError("unable to get the size of %s (errno %d)", source_file_path, errno);
+        (void)close(fd);
+        result = MU_FAILURE;
+    }
+    else if ((page_size = sysconf(_SC_PAGESIZE)) <= 0)
+    {
+        LogError("unable to get the page size (errno %d)", errno);
+        (void)close(fd);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        source_file->fd = fd;
+        source_file->size = (uint64_t)file_stat.st_size;
+        source_file->offset = 0;
+        source_file->pageSize = (size_t)page_size;
+        source_file->window = NULL;
+        source_file->windowSize = 0;
+        result = 0;
+    }
+
+    return result;
+}
+
+static void release_source_file_block(UPLOAD_SOURCE_FILE* source_file)
+{
+    if (source_file->window != NULL)
+    {
+        (void)munmap(source_file->window, source_file->windowSize);
+        source_file->window = NULL;
+        source_file->windowSize = 0;
+    }
+}
+
+// maps the next block of the file, the mapping of the previous block is released first
+static int get_next_source_file_block(UPLOAD_SOURCE_FILE* source_file, size_t block_size, unsigned char const ** data, size_t* size)
+{
+    int result;
+
+    release_source_file_block(source_file);
+
+    if (source_file->offset >= source_file->size)
+    {
+        // the whole file has been handed out
+        *data = NULL;
+        *size = 0;
+        result = 0;
+    }
+    else
+    {
+        uint64_t remaining = source_file->size - source_file->offset;
+        size_t length = (remaining > (uint64_t)block_size) ? block_size : (size_t)remaining;
+        // the block starts window_delta bytes into a window mapped from a page boundary
+        size_t window_delta = (size_t)(source_file->offset % source_file->pageSize);
+        uint64_t window_offset = source_file->offset - window_delta;
+        void* window;
+
+        if ((uint64_t)(off_t)window_offset != window_offset)
+        {
+            LogError("offset %llu of the file cannot be mapped on this platform", (unsigned long long)window_offset);
+            result = MU_FAILURE;
+        }
+        else if ((window = mmap(NULL, window_delta + length, PROT_READ, MAP_PRIVATE, source_file->fd, (off_t)window_offset)) == MAP_FAILED)
+        {
+            LogError("unable to map %lu bytes of the file at offset %llu (errno %d)", (unsigned long)length, (unsigned long long)source_file->offset, errno);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            // the block is read once, in order
+            (void)posix_madvise(window, window_delta + length, POSIX_MADV_SEQUENTIAL);
+            source_file->window = window;
+            source_file->windowSize = window_delta + length;
+            source_file->offset += length;
+            *data = (const unsigned char*)window + window_delta;
+            *size = length;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static void close_source_file(UPLOAD_SOURCE_FILE* source_file)
+{
+    release_source_file_block(source_file);
+    (void)close(source_file->fd);
+}
+#elif defined(_WIN32) && !defined(WINCE)
+static int open_source_file(const char* source_file_path, UPLOAD_SOURCE_FILE* source_file)
+{
+    int result;
+    LARGE_INTEGER file_size;
+    HANDLE file = CreateFileA(source_file_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        LogError("unable to open %s (error %lu)", source_file_path, (unsigned long)GetLastError());
+        result = MU_FAILURE;
+    }
+    else if (!GetFileSizeEx(file, &file_size))
+    {
+        LogError("unable to get the size of %s (error %lu)", source_file_path, (unsigned long)GetLastError());
+        (void)CloseHandle(file);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        // an empty file cannot be mapped, it is uploaded as an empty blob
+        HANDLE mapping = (file_size.QuadPart == 0) ? NULL : CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+        if (file_size.QuadPart != 0 && mapping == NULL)
+        {
+            LogError("unable to map %s in memory (error %lu)", source_file_path, (unsigned long)GetLastError());
+            (void)CloseHandle(file);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            SYSTEM_INFO system_info;
+            GetSystemInfo(&system_info);
+
+            source_file->file = file;
+            source_file->mapping = mapping;
+            source_file->size = (uint64_t)file_size.QuadPart;
+            source_file->offset = 0;
+            source_file->allocationGranularity = system_info.dwAllocationGranularity;
+            source_file->window = NULL;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static void release_source_file_block(UPLOAD_SOURCE_FILE* source_file)
+{
+    if (source_file->window != NULL)
+    {
+        (void)UnmapViewOfFile(source_file->window);
+        source_file->window = NULL;
+    }
+}
+
+// maps a view of the next block of the file, the view of the previous block is released first
+static int get_next_source_file_block(UPLOAD_SOURCE_FILE* source_file, size_t block_size, unsigned char const ** data, size_t* size)
+{
+    int result;
+
+    release_source_file_block(source_file);
+
+    if (source_file->offset >= source_file->size)
+    {
+        // the whole file has been handed out
+        *data = NULL;
+        *size = 0;
+        result = 0;
+    }
+    else
+    {
+        uint64_t remaining = source_file->size - source_file->offset;
+        size_t length = (remaining > (uint64_t)block_size) ? block_size : (size_t)remaining;
+        // the block starts window_delta bytes into a view mapped from an allocation granularity boundary
+        size_t window_delta = (size_t)(source_file->offset % source_file->allocationGranularity);
+        uint64_t window_offset = source_file->offset - window_delta;
+        void* window = MapViewOfFile(source_file->mapping, FILE_MAP_READ, (DWORD)(window_offset >> 32), (DWORD)(window_offset & 0xFFFFFFFF), window_delta + length);
+
+        if (window == NULL)
+        {
+            LogError("unable to map %lu bytes of the file at offset %llu (error %lu)", (unsigned long)length, (unsigned long long)source_file->offset, (unsigned long)GetLastError());
+            result = MU_FAILURE;
+        }
+        else
+        {
+            source_file->window = window;
+            source_file->offset += length;
+            *data = (const unsigned char*)window + window_delta;
+            *size = length;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static void close_source_file(UPLOAD_SOURCE_FILE* source_file)
+{
+    release_source_file_block(source_file);
+    if (source_file->mapping != NULL)
+    {
+        (void)CloseHandle(source_file->mapping);
+    }
+    (void)CloseHandle(source_file->file);
+}
+#else
+// no memory mapped files on this platform, the blocks are read one at a time
+static int open_source_file(const char* source_file_path, UPLOAD_SOURCE_FILE* source_file)
+{
+    int result;
+    FILE* file = fopen(source_file_path, "rb");
+
+    if (file == NULL)
+    {
+        LogError("unable to open %s", source_file_path);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        source_file->file = file;
+        source_file->block = NULL;
+        result = 0;
+    }
+
+    return result;
+}
+
+// reads the next block of the file, over the previous block
+static int get_next_source_file_block(UPLOAD_SOURCE_FILE* source_file, size_t block_size, unsigned char const ** data, size_t* size)
+{
+    int result;
+
+    if (source_file->block == NULL && (source_file->block = (unsigned char*)malloc(block_size)) == NULL)
+    {
+        LogError("unable to allocate %lu bytes to read the file", (unsigned long)block_size);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        size_t length = fread(source_file->block, 1, block_size, source_file->file);
+
+        if (ferror(source_file->file) != 0)
+        {
+            LogError("unable to read the file");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            // a block of 0 (zero) bytes ends the upload
+            *data = (length == 0) ? NULL : source_file->block;
+            *size = length;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static void close_source_file(UPLOAD_SOURCE_FILE* source_file)
+{
+    free(source_file->block);
+    (void)fclose(source_file->file);
+}
+#endif
+
 // this callback splits the source data into blocks to be fed to IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)_Impl
 static IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT FileUpload_GetData_Callback(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result, unsigned char const ** data, size_t* size, void* context)
 {
+    IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT getDataResult = IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_OK;
     BLOB_UPLOAD_CONTEXT* uploadContext = (BLOB_UPLOAD_CONTEXT*) context;
 
     if (data == NULL || size == NULL)
@@ -627,6 +945,19 @@ static IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT FileUpload_GetData_Callback(IOT
         *data = NULL;
         *size = 0;
     }
+    else if (uploadContext->sourceFile != NULL)
+    {
+        // Map or read the next block of the file
+        if (get_next_source_file_block(uploadContext->sourceFile, uploadContext->blockSize, data, size) != 0)
+        {
+            // no block would end the upload and commit a truncated blob, it is aborted instead and reported as failed, not as aborted by the user
+            LogError("unable to get the next block of the file to upload");
+            *data = NULL;
+            *size = 0;
+            uploadContext->sourceFileFailed = true;
+            getDataResult = IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_ABORT;
+        }
+    }
     else if (uploadContext->remainingSizeToUpload == 0)
     {
         // Everything has been uploaded
@@ -636,13 +967,13 @@ static IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT FileUpload_GetData_Callback(IOT
     else
     {
         // Upload next block
-        size_t thisBlockSize = (uploadContext->remainingSizeToUpload > BLOCK_SIZE) ? BLOCK_SIZE : uploadContext->remainingSizeToUpload;
+        size_t thisBlockSize = (uploadContext->remainingSizeToUpload > uploadContext->blockSize) ? uploadContext->blockSize : uploadContext->remainingSizeToUpload;
         *data = (unsigned char*)uploadContext->blobSource + (uploadContext->blobSourceSize - uploadContext->remainingSizeToUpload);
         *size = thisBlockSize;
         uploadContext->remainingSizeToUpload -= thisBlockSize;
     }
 
-    return IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_OK;
+    return getDataResult;
 }
 
 static HTTPAPIEX_RESULT set_transfer_timeout(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_data, HTTPAPIEX_HANDLE iotHubHttpApiExHandle)
@@ -661,7 +992,190 @@ static HTTPAPIEX_RESULT set_transfer_timeout(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDL
     return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context)
+// the checkpoint identifies the blob by its SAS URI without the query, so the SAS token is never written to disk
+static size_t get_blob_uri_length(const char* sas_uri)
+{
+    const char* query = strchr(sas_uri, '?');
+    return (query == NULL) ? strlen(sas_uri) : (size_t)(query - sas_uri);
+}
+
+typedef struct UPLOAD_CHECKPOINT_TAG
+{
+    char* file_name;
+    const char* sas_uri;
+    const char* source_id;
+} UPLOAD_CHECKPOINT;
+
+// FNV-1a, only to tell apart the checkpoints of the blobs uploaded at the same time, the file itself names its blob
+static uint32_t get_blob_uri_hash(const char* sas_uri)
+{
+    uint32_t result = 2166136261u;
+    size_t blob_uri_length = get_blob_uri_length(sas_uri);
+    size_t i;
+
+    for (i = 0; i < blob_uri_length; i++)
+    {
+        result = (result ^ (unsigned char)sas_uri[i]) * 16777619u;
+    }
+
+    return result;
+}
+
+// each destination blob has its own checkpoint, "<blob_upload_checkpoint_file>.<hash of the blob uri>", so concurrent uploads do not overwrite each other's
+static int create_upload_checkpoint(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_data, const char* sas_uri, const char* source_id, UPLOAD_CHECKPOINT* checkpoint)
+{
+    int result;
+    size_t file_name_size;
+
+    if (upload_data->blob_upload_checkpoint_file == NULL || source_id == NULL)
+    {
+        // Resumable uploads are disabled, or the source cannot be told apart from other data.
+        result = MU_FAILURE;
+    }
+    else if ((checkpoint->file_name = (char*)malloc((file_name_size = strlen(upload_data->blob_upload_checkpoint_file) + 10))) == NULL)
+    {
+        LogError("Cannot allocate the name of the upload checkpoint");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        (void)snprintf(checkpoint->file_name, file_name_size, "%s.%08lx", upload_data->blob_upload_checkpoint_file, (unsigned long)get_blob_uri_hash(sas_uri));
+        checkpoint->sas_uri = sas_uri;
+        checkpoint->source_id = source_id;
+        result = 0;
+    }
+
+    return result;
+}
+
+// returns the count of blocks the checkpoint file records as uploaded to the blob of sas_uri from the source source_id, 0 if none
+static unsigned int read_upload_checkpoint(const char* checkpoint_file, const char* sas_uri, const char* source_id)
+{
+    unsigned int result = 0;
+    FILE* file_stream;
+
+    if ((file_stream = fopen(checkpoint_file, "r")) == NULL)
+    {
+        // No checkpoint, the upload starts from the first block.
+    }
+    else
+    {
+        long int file_size;
+        char* checkpoint;
+
+        if (fseek(file_stream, 0, SEEK_END) != 0 || (file_size = ftell(file_stream)) <= 0)
+        {
+            LogError("unable to get the size of %s, errno=%d", checkpoint_file, errno);
+        }
+        else if ((checkpoint = (char*)calloc(1, file_size + 1)) == NULL)
+        {
+            LogError("Cannot allocate %lu bytes", (unsigned long)file_size);
+        }
+        else
+        {
+            rewind(file_stream);
+
+            if ((fread(checkpoint, 1, file_size, file_stream) == 0) || (ferror(file_stream) != 0))
+            {
+                LogError("fread failed on file %s, errno=%d", checkpoint_file, errno);
+            }
+            else
+            {
+                char* blob_uri;
+                unsigned long block_count = strtoul(checkpoint, &blob_uri, 10);
+                size_t blob_uri_length = get_blob_uri_length(sas_uri);
+                size_t source_id_length = strlen(source_id);
+
+                if (*blob_uri == '\n' &&
+                    strncmp(blob_uri + 1, sas_uri, blob_uri_length) == 0 &&
+                    blob_uri[1 + blob_uri_length] == '\n' &&
+                    strncmp(blob_uri + 2 + blob_uri_length, source_id, source_id_length) == 0 &&
+                    blob_uri[2 + blob_uri_length + source_id_length] == '\n' &&
+                    block_count <= MAX_BLOCK_COUNT)
+                {
+                    result = (unsigned int)block_count;
+                }
+                else
+                {
+                    LogInfo("checkpoint %s is not for this blob and source, uploading from the first block", checkpoint_file);
+                }
+            }
+            free(checkpoint);
+        }
+        fclose(file_stream);
+    }
+
+    return result;
+}
+
+static void write_upload_checkpoint(const char* checkpoint_file, const char* sas_uri, const char* source_id, unsigned int block_count)
+{
+    FILE* file_stream;
+
+    if ((file_stream = fopen(checkpoint_file, "w")) == NULL)
+    {
+        LogError("Cannot open file %s, errno=%d", checkpoint_file, errno);
+    }
+    else
+    {
+        if (fprintf(file_stream, "%u\n%.*s\n%s\n", block_count, (int)get_blob_uri_length(sas_uri), sas_uri, source_id) < 0)
+        {
+            LogError("unable to write the checkpoint to %s, errno=%d", checkpoint_file, errno);
+        }
+        fclose(file_stream);
+    }
+}
+
+// returns the count of blocks a previous attempt uploaded to the blob of sas_uri from the same source, that the blob storage still has
+static unsigned int get_resumable_block_count(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_data, const UPLOAD_CHECKPOINT* checkpoint)
+{
+    unsigned int result;
+
+    if ((result = read_upload_checkpoint(checkpoint->file_name, checkpoint->sas_uri, checkpoint->source_id)) == 0)
+    {
+        // Nothing to resume.
+    }
+    else
+    {
+        unsigned int uncommitted_block_count;
+
+        if (Blob_GetUncommittedBlockCount(checkpoint->sas_uri, upload_data->certificates, &(upload_data->http_proxy_options), &uncommitted_block_count) != BLOB_OK)
+        {
+            LogError("unable to get the block list of the blob, uploading from the first block");
+            result = 0;
+        }
+        else if (uncommitted_block_count < result)
+        {
+            result = uncommitted_block_count;
+        }
+    }
+
+    return result;
+}
+
+// called by Blob_UploadMultipleBlocksFromSasUri after each block, or round of blocks, is uploaded, so a crash loses at most one round
+static void on_blob_upload_progress(unsigned int uploaded_block_count, void* context)
+{
+    UPLOAD_CHECKPOINT* checkpoint = (UPLOAD_CHECKPOINT*)context;
+    write_upload_checkpoint(checkpoint->file_name, checkpoint->sas_uri, checkpoint->source_id, uploaded_block_count);
+}
+
+static void complete_upload_checkpoint(UPLOAD_CHECKPOINT* checkpoint, bool upload_completed, unsigned int uploaded_block_count)
+{
+    if (upload_completed || uploaded_block_count == 0)
+    {
+        (void)remove(checkpoint->file_name);
+    }
+    else
+    {
+        write_upload_checkpoint(checkpoint->file_name, checkpoint->sas_uri, checkpoint->source_id, uploaded_block_count);
+    }
+    free(checkpoint->file_name);
+}
+
+// source_id identifies the data getDataCallbackEx hands out for the upload checkpoint, NULL if the data cannot be identified
+// source_failed, if not NULL, is set by getDataCallbackEx when it aborts the upload because the source could not be read
+static IOTHUB_CLIENT_RESULT upload_multiple_blocks_to_blob(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, const char* source_id, const bool* source_failed)
 {
     IOTHUB_CLIENT_RESULT result;
 
@@ -785,8 +1299,31 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(IOTHUB_CLIE
                                     }
                                     else
                                     {
+                                        /*Codes_SRS_IOTHUBCLIENT_LL_09_069: [ If `blob_upload_checkpoint_file` is set and the checkpoint of the blob records blocks uploaded from the same source, `IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)` shall resume after the blocks that are also listed by `Blob_GetUncommittedBlockCount`. ]*/
+                                        const char* blobSasUri = STRING_c_str(sasUri);
+                                        UPLOAD_CHECKPOINT checkpoint;
+                                        bool hasCheckpoint = (create_upload_checkpoint(upload_data, blobSasUri, source_id, &checkpoint) == 0);
+                                        unsigned int uploadedBlockCount = hasCheckpoint ? get_resumable_block_count(upload_data, &checkpoint) : 0;
+
                                         /*Codes_SRS_IOTHUBCLIENT_LL_02_083: [ IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall call Blob_UploadFromSasUri and capture the HTTP return code and HTTP body. ]*/
-                                        BLOB_RESULT uploadMultipleBlocksResult = Blob_UploadMultipleBlocksFromSasUri(STRING_c_str(sasUri), getDataCallbackEx, context, &httpResponse, responseToIoTHub, upload_data->certificates, &(upload_data->http_proxy_options));
+                                        /*Codes_SRS_IOTHUBCLIENT_LL_09_070: [ If `blob_upload_checkpoint_file` is set, `IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)` shall record in the checkpoint of the blob the blob, the source and the count of blocks uploaded each time `Blob_UploadMultipleBlocksFromSasUri` reports progress, and delete that checkpoint once the upload completes or is aborted. ]*/
+                                        BLOB_RESULT uploadMultipleBlocksResult = Blob_UploadMultipleBlocksFromSasUri(blobSasUri, getDataCallbackEx, context, &httpResponse, responseToIoTHub, upload_data->certificates, &(upload_data->http_proxy_options), upload_data->blob_upload_concurrent_blocks, &uploadedBlockCount,
+                                            hasCheckpoint ? on_blob_upload_progress : NULL, &checkpoint);
+
+                                        if (uploadMultipleBlocksResult == BLOB_ABORTED && source_failed != NULL && *source_failed)
+                                        {
+                                            /*Codes_SRS_IOTHUBCLIENT_LL_09_093: [ If the upload was aborted because the source failed to be read, `IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)` shall handle it as a failure of `Blob_UploadMultipleBlocksFromSasUri`, keeping the checkpoint of the blob. ]*/
+                                            LogError("the upload was aborted because the source could not be read");
+                                            uploadMultipleBlocksResult = BLOB_ERROR;
+                                        }
+
+                                        if (hasCheckpoint)
+                                        {
+                                            complete_upload_checkpoint(&checkpoint,
+                                                (uploadMultipleBlocksResult == BLOB_ABORTED) || (uploadMultipleBlocksResult == BLOB_OK && httpResponse < 300),
+                                                uploadedBlockCount);
+                                        }
+
                                         if (uploadMultipleBlocksResult == BLOB_ABORTED)
                                         {
                                             /*Codes_SRS_IOTHUBCLIENT_LL_99_008: [ If step 2 is aborted by the client, then the HTTP message body shall look like:  ]*/
@@ -920,6 +1457,70 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(IOTHUB_CLIE
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_09_089: [ `IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)` shall not resume nor record uploads of data handed out by `getDataCallbackEx`, since it cannot tell whether the data changed between two uploads. ]*/
+    return upload_multiple_blocks_to_blob(handle, destinationFileName, getDataCallbackEx, context, NULL, NULL);
+}
+
+// the source id is the block size, the size of the source and a SHA-256 digest of its content
+static int get_source_buffer_id(const unsigned char* source, size_t size, size_t block_size, char* source_id, size_t source_id_size)
+{
+    int result;
+    SHA256Context sha_context;
+    uint8_t digest[SHA256HashSize];
+    size_t hashed_size = 0;
+
+    if (SHA256Reset(&sha_context) != 0)
+    {
+        LogError("Failed sha256 reset");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = 0;
+
+        while (result == 0 && hashed_size < size)
+        {
+            unsigned int chunk_size = (size - hashed_size > UINT_MAX) ? UINT_MAX : (unsigned int)(size - hashed_size);
+
+            if (SHA256Input(&sha_context, source + hashed_size, chunk_size) != 0)
+            {
+                LogError("Failed SHA256Input");
+                result = MU_FAILURE;
+            }
+            else
+            {
+                hashed_size += chunk_size;
+            }
+        }
+
+        if (result != 0)
+        {
+            // already logged
+        }
+        else if (SHA256Result(&sha_context, digest) != 0)
+        {
+            LogError("Failed SHA256Result");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            int length = snprintf(source_id, source_id_size, "%lu %llu ", (unsigned long)block_size, (unsigned long long)size);
+            size_t i;
+
+            for (i = 0; i < SHA256HashSize && length > 0 && (size_t)length + 2 < source_id_size; i++)
+            {
+                length += snprintf(source_id + length, source_id_size - length, "%02x", digest[i]);
+            }
+
+            result = (i == SHA256HashSize) ? 0 : MU_FAILURE;
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, const unsigned char* source, size_t size)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -942,9 +1543,120 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTO
         context.blobSource = source;
         context.blobSourceSize = size;
         context.remainingSizeToUpload = size;
+        context.blockSize = ((IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA*)handle)->blob_upload_block_size;
+        context.sourceFile = NULL;
+        context.sourceFileFailed = false;
+
+        char source_id[UPLOAD_SOURCE_ID_SIZE];
+        bool has_source_id = false;
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_09_090: [ If `blob_upload_checkpoint_file` is set, `IoTHubClient_LL_UploadToBlob` shall identify `source` in the checkpoint by the block size, `size` and a SHA-256 digest of `source`. ]*/
+        if (((IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA*)handle)->blob_upload_checkpoint_file != NULL)
+        {
+            if (get_source_buffer_id(source, size, context.blockSize, source_id, sizeof(source_id)) != 0)
+            {
+                LogError("unable to identify the data to upload, the upload cannot be resumed");
+            }
+            else
+            {
+                has_source_id = true;
+            }
+        }
 
         /*Codes_SRS_IOTHUBCLIENT_LL_99_002: [ `IoTHubClient_LL_UploadToBlob` shall call `IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl` with `FileUpload_GetData_Callback` as `getDataCallbackEx` and pass the struct created at step SRS_IOTHUBCLIENT_LL_99_001 as `context` ]*/
-        result = IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(handle, destinationFileName, FileUpload_GetData_Callback, &context);
+        result = upload_multiple_blocks_to_blob(handle, destinationFileName, FileUpload_GetData_Callback, &context, has_source_id ? source_id : NULL, NULL);
+    }
+    return result;
+}
+
+// the source id is the block size, the size of the file and the time it was last modified
+static int get_source_file_id(const char* source_file_path, size_t block_size, char* source_id, size_t source_id_size)
+{
+    int result;
+#if defined(__unix__) || defined(__APPLE__) || defined(_WIN32)
+#if defined(__unix__) || defined(__APPLE__)
+    struct stat file_stat;
+
+    if (stat(source_file_path, &file_stat) != 0)
+#else
+    struct _stat64 file_stat;
+
+    if (_stat64(source_file_path, &file_stat) != 0)
+#endif
+    {
+        LogError("unable to get the status of %s (errno %d)", source_file_path, errno);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        int length = snprintf(source_id, source_id_size, "%lu %llu %lld", (unsigned long)block_size, (unsigned long long)file_stat.st_size, (long long)file_stat.st_mtime);
+        result = (length > 0 && (size_t)length < source_id_size) ? 0 : MU_FAILURE;
+    }
+#else
+    (void)source_file_path;
+    (void)block_size;
+    (void)source_id;
+    (void)source_id_size;
+    LogInfo("the modification time of files is not available on this platform");
+    result = MU_FAILURE;
+#endif
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadFileToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, const char* sourceFilePath)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_09_074: [ If `handle`, `destinationFileName` or `sourceFilePath` are NULL, `IoTHubClient_LL_UploadFileToBlob` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+    if (handle == NULL || destinationFileName == NULL || sourceFilePath == NULL)
+    {
+        LogError("Invalid parameter handle:%p destinationFileName:%p sourceFilePath:%p", handle, destinationFileName, sourceFilePath);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        UPLOAD_SOURCE_FILE source_file;
+        size_t block_size = ((IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA*)handle)->blob_upload_block_size;
+        char source_id[UPLOAD_SOURCE_ID_SIZE];
+        bool has_source_id = false;
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_09_091: [ If `blob_upload_checkpoint_file` is set, `IoTHubClient_LL_UploadFileToBlob` shall identify `sourceFilePath` in the checkpoint by the block size, the size of the file and the time it was last modified. ]*/
+        if (((IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA*)handle)->blob_upload_checkpoint_file != NULL)
+        {
+            if (get_source_file_id(sourceFilePath, block_size, source_id, sizeof(source_id)) != 0)
+            {
+                LogError("unable to identify %s, the upload cannot be resumed", sourceFilePath);
+            }
+            else
+            {
+                has_source_id = true;
+            }
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_09_075: [ `IoTHubClient_LL_UploadFileToBlob` shall open `sourceFilePath` read-only, without mapping nor reading its content. ]*/
+        if (open_source_file(sourceFilePath, &source_file) != 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_076: [ If `sourceFilePath` fails to be opened, `IoTHubClient_LL_UploadFileToBlob` shall fail and return `IOTHUB_CLIENT_ERROR`. ]*/
+            LogError("unable to open the file to upload %s", sourceFilePath);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            BLOB_UPLOAD_CONTEXT context;
+            context.blobSource = NULL;
+            context.blobSourceSize = 0;
+            context.remainingSizeToUpload = 0;
+            context.blockSize = block_size;
+            context.sourceFile = &source_file;
+            context.sourceFileFailed = false;
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_077: [ `IoTHubClient_LL_UploadFileToBlob` shall call `IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl` with `FileUpload_GetData_Callback`, which maps the next `blob_upload_block_size` bytes of the file read-only for each block, releasing the mapping of the previous block, or reads them in a buffer of one block on platforms without memory mapped files. ]*/
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_092: [ If the next block of the file fails to be mapped or read, `FileUpload_GetData_Callback` shall return `IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_ABORT` and report the source as failed. ]*/
+            result = upload_multiple_blocks_to_blob(handle, destinationFileName, FileUpload_GetData_Callback, &context, has_source_id ? source_id : NULL, &context.sourceFileFailed);
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_078: [ `IoTHubClient_LL_UploadFileToBlob` shall release the mapping of the last block and close `sourceFilePath` once the upload finishes. ]*/
+            close_source_file(&source_file);
+        }
     }
     return result;
 }
@@ -986,6 +1698,10 @@ void IoTHubClient_LL_UploadToBlob_Destroy(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h
         {
             free((char *)upload_data->http_proxy_options.password);
         }
+        if (upload_data->blob_upload_checkpoint_file != NULL)
+        {
+            free(upload_data->blob_upload_checkpoint_file);
+        }
         free(upload_data);
     }
 }
@@ -1162,6 +1878,58 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_SetOption(IOTHUB_CLIENT_LL_UPL
             upload_data->blob_upload_timeout_secs = *(size_t*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        else if (strcmp(optionName, OPTION_BLOB_UPLOAD_CONCURRENT_BLOCKS) == 0)
+        {
+            size_t concurrent_blocks = *(size_t*)value;
+            if (concurrent_blocks > MAX_CONCURRENT_BLOCKS)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_09_066: [ If `blob_upload_concurrent_blocks` is bigger than `MAX_CONCURRENT_BLOCKS`, `IoTHubClient_LL_UploadToBlob_SetOption` shall return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+                LogError("invalid value for %s (%lu), max is %d", optionName, (unsigned long)concurrent_blocks, MAX_CONCURRENT_BLOCKS);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_09_065: [ `blob_upload_concurrent_blocks` - shall set the count of blocks uploaded at the same time, passed to `Blob_UploadMultipleBlocksFromSasUri`. ]*/
+                upload_data->blob_upload_concurrent_blocks = concurrent_blocks;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(optionName, OPTION_BLOB_UPLOAD_BLOCK_SIZE) == 0)
+        {
+            size_t block_size = *(size_t*)value;
+            if (block_size < BLOCK_SIZE || block_size > MAX_BLOCK_SIZE)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_09_073: [ If `blob_upload_block_size` is smaller than `BLOCK_SIZE` or bigger than `MAX_BLOCK_SIZE`, `IoTHubClient_LL_UploadToBlob_SetOption` shall return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+                LogError("invalid value for %s (%lu), it must be between %d and %d", optionName, (unsigned long)block_size, BLOCK_SIZE, MAX_BLOCK_SIZE);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_09_072: [ `blob_upload_block_size` - shall set the size of the blocks `IoTHubClient_LL_UploadToBlob` and `IoTHubClient_LL_UploadFileToBlob` split the source into. ]*/
+                upload_data->blob_upload_block_size = block_size;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(optionName, OPTION_BLOB_UPLOAD_CHECKPOINT_FILE) == 0)
+        {
+            char* checkpoint_file = NULL;
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_068: [ `blob_upload_checkpoint_file` - shall set the path of the files recording the progress of the uploads, one per blob named after the path and a hash of the blob URI, or disable resumable uploads if the value is NULL. ]*/
+            if (value != NULL && mallocAndStrcpy_s(&checkpoint_file, (const char*)value) != 0)
+            {
+                LogError("failure in mallocAndStrcpy_s");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                if (upload_data->blob_upload_checkpoint_file != NULL)
+                {
+                    free(upload_data->blob_upload_checkpoint_file);
+                }
+                upload_data->blob_upload_checkpoint_file = checkpoint_file;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
         else
         {
             /*Codes_SRS_IOTHUBCLIENT_LL_02_102: [ If an unknown option is presented then IoTHubClient_LL_UploadToBlob_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
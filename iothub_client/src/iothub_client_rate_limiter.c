@@ -0,0 +1,286 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "azure_macro_utils/macro_utils.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#include "iothub_client_rate_limiter.h"
+#include "internal/iothub_client_rate_limiter_private.h"
+
+MU_DEFINE_ENUM_STRINGS_WITHOUT_INVALID(IOTHUB_CLIENT_RATE_LIMIT_CLASS, IOTHUB_CLIENT_RATE_LIMIT_CLASS_VALUES);
+
+#define RATE_LIMIT_CLASS_COUNT 3
+/*tokens are counted in thousandths, so a bucket refilled at N operations per second gains N of them every millisecond*/
+#define MILLI_TOKENS_PER_TOKEN 1000
+
+typedef struct RATE_LIMIT_BUCKET_TAG
+{
+    size_t operations_per_second; /*0 means the class is not limited*/
+    uint64_t capacity;            /*burst, in thousandths of a token*/
+    uint64_t milli_tokens;
+    tickcounter_ms_t last_refill_time;
+    IOTHUB_CLIENT_RATE_LIMIT_STATISTICS statistics;
+} RATE_LIMIT_BUCKET;
+
+typedef struct IOTHUB_CLIENT_RATE_LIMITER_TAG
+{
+    LOCK_HANDLE lock; /*a rate limiter can be shared by clients running on different threads*/
+    TICK_COUNTER_HANDLE tick_counter;
+    RATE_LIMIT_BUCKET buckets[RATE_LIMIT_CLASS_COUNT];
+} IOTHUB_CLIENT_RATE_LIMITER;
+
+static void refill_bucket(IOTHUB_CLIENT_RATE_LIMITER* rate_limiter, RATE_LIMIT_BUCKET* bucket)
+{
+    tickcounter_ms_t current_time;
+
+    if (tickcounter_get_current_ms(rate_limiter->tick_counter, &current_time) != 0)
+    {
+        LogError("Failed getting the current time, rate limiter tokens not refilled");
+    }
+    else
+    {
+        // Codes_SRS_IOTHUB_RATE_LIMITER_09_008: [ A limited class shall gain `operationsPerSecond` tokens per second, up to its burst. ]
+        bucket->milli_tokens += (uint64_t)(current_time - bucket->last_refill_time) * bucket->operations_per_second;
+        if (bucket->milli_tokens > bucket->capacity)
+        {
+            bucket->milli_tokens = bucket->capacity;
+        }
+        bucket->last_refill_time = current_time;
+    }
+}
+
+static void record_admission(RATE_LIMIT_BUCKET* bucket, tickcounter_ms_t waited_ms)
+{
+    bucket->statistics.admitted_count++;
+
+    if (waited_ms > 0)
+    {
+        bucket->statistics.delayed_count++;
+        bucket->statistics.total_wait_ms += waited_ms;
+
+        if (waited_ms > bucket->statistics.max_wait_ms)
+        {
+            bucket->statistics.max_wait_ms = waited_ms;
+        }
+    }
+}
+
+IOTHUB_CLIENT_RATE_LIMITER_HANDLE IoTHubClient_RateLimiter_Create(void)
+{
+    IOTHUB_CLIENT_RATE_LIMITER* result;
+
+    // Codes_SRS_IOTHUB_RATE_LIMITER_09_001: [ `IoTHubClient_RateLimiter_Create` shall allocate a rate limiter with a lock and a tick counter, with no limit on any operation class. ]
+    if ((result = (IOTHUB_CLIENT_RATE_LIMITER*)malloc(sizeof(IOTHUB_CLIENT_RATE_LIMITER))) == NULL)
+    {
+        LogError("Failed allocating rate limiter");
+    }
+    else
+    {
+        memset(result, 0, sizeof(IOTHUB_CLIENT_RATE_LIMITER));
+
+        if ((result->lock = Lock_Init()) == NULL)
+        {
+            // Codes_SRS_IOTHUB_RATE_LIMITER_09_002: [ If any failure occurs, `IoTHubClient_RateLimiter_Create` shall return NULL. ]
+            LogError("Failed creating rate limiter lock");
+            free(result);
+            result = NULL;
+        }
+        else if ((result->tick_counter = tickcounter_create()) == NULL)
+        {
+            // Codes_SRS_IOTHUB_RATE_LIMITER_09_002: [ If any failure occurs, `IoTHubClient_RateLimiter_Create` shall return NULL. ]
+            LogError("Failed creating rate limiter tick counter");
+            (void)Lock_Deinit(result->lock);
+            free(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+void IoTHubClient_RateLimiter_Destroy(IOTHUB_CLIENT_RATE_LIMITER_HANDLE rateLimiter)
+{
+    // Codes_SRS_IOTHUB_RATE_LIMITER_09_003: [ `IoTHubClient_RateLimiter_Destroy` shall free the rate limiter, or do nothing if `rateLimiter` is NULL. ]
+    if (rateLimiter != NULL)
+    {
+        tickcounter_destroy(rateLimiter->tick_counter);
+        (void)Lock_Deinit(rateLimiter->lock);
+        free(rateLimiter);
+    }
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_RateLimiter_SetLimit(IOTHUB_CLIENT_RATE_LIMITER_HANDLE rateLimiter, IOTHUB_CLIENT_RATE_LIMIT_CLASS operationClass, size_t operationsPerSecond, size_t burst)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    // Codes_SRS_IOTHUB_RATE_LIMITER_09_004: [ If `rateLimiter` is NULL or `operationClass` is not a valid class, `IoTHubClient_RateLimiter_SetLimit` shall return IOTHUB_CLIENT_INVALID_ARG. ]
+    if (rateLimiter == NULL || (size_t)operationClass >= RATE_LIMIT_CLASS_COUNT)
+    {
+        LogError("Invalid argument (rateLimiter=%p, operationClass=%d)", rateLimiter, (int)operationClass);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        RATE_LIMIT_BUCKET* bucket = &rateLimiter->buckets[operationClass];
+        tickcounter_ms_t current_time;
+
+        if (tickcounter_get_current_ms(rateLimiter->tick_counter, &current_time) != 0)
+        {
+            LogError("Failed getting the current time");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if (Lock(rateLimiter->lock) != LOCK_OK)
+        {
+            LogError("Failed locking rate limiter");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            // Codes_SRS_IOTHUB_RATE_LIMITER_09_005: [ `IoTHubClient_RateLimiter_SetLimit` shall set the rate and the burst of `operationClass` and fill its bucket; a `burst` of 0 shall allow one second worth of operations. ]
+            bucket->operations_per_second = operationsPerSecond;
+            bucket->capacity = (uint64_t)(burst > 0 ? burst : (operationsPerSecond > 0 ? operationsPerSecond : 1)) * MILLI_TOKENS_PER_TOKEN;
+            bucket->milli_tokens = bucket->capacity;
+            bucket->last_refill_time = current_time;
+            (void)Unlock(rateLimiter->lock);
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_RateLimiter_GetStatistics(IOTHUB_CLIENT_RATE_LIMITER_HANDLE rateLimiter, IOTHUB_CLIENT_RATE_LIMIT_CLASS operationClass, IOTHUB_CLIENT_RATE_LIMIT_STATISTICS* statistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    // Codes_SRS_IOTHUB_RATE_LIMITER_09_006: [ If `rateLimiter` or `statistics` are NULL or `operationClass` is not a valid class, `IoTHubClient_RateLimiter_GetStatistics` shall return IOTHUB_CLIENT_INVALID_ARG. ]
+    if (rateLimiter == NULL || statistics == NULL || (size_t)operationClass >= RATE_LIMIT_CLASS_COUNT)
+    {
+        LogError("Invalid argument (rateLimiter=%p, operationClass=%d, statistics=%p)", rateLimiter, (int)operationClass, statistics);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if (Lock(rateLimiter->lock) != LOCK_OK)
+    {
+        LogError("Failed locking rate limiter");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        RATE_LIMIT_BUCKET* bucket = &rateLimiter->buckets[operationClass];
+
+        // Codes_SRS_IOTHUB_RATE_LIMITER_09_007: [ `IoTHubClient_RateLimiter_GetStatistics` shall copy the statistics of `operationClass`, with the number of whole tokens currently in its bucket. ]
+        if (bucket->operations_per_second > 0)
+        {
+            refill_bucket(rateLimiter, bucket);
+            bucket->statistics.available_tokens = (size_t)(bucket->milli_tokens / MILLI_TOKENS_PER_TOKEN);
+        }
+        else
+        {
+            bucket->statistics.available_tokens = 0;
+        }
+
+        *statistics = bucket->statistics;
+        (void)Unlock(rateLimiter->lock);
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+bool IoTHubClient_RateLimiter_TryAcquire(IOTHUB_CLIENT_RATE_LIMITER_HANDLE rateLimiter, IOTHUB_CLIENT_RATE_LIMIT_CLASS operationClass, tickcounter_ms_t waitedMs)
+{
+    bool result;
+
+    if (rateLimiter == NULL || (size_t)operationClass >= RATE_LIMIT_CLASS_COUNT)
+    {
+        LogError("Invalid argument (rateLimiter=%p, operationClass=%d)", rateLimiter, (int)operationClass);
+        result = true;
+    }
+    else if (Lock(rateLimiter->lock) != LOCK_OK)
+    {
+        // Codes_SRS_IOTHUB_RATE_LIMITER_09_012: [ If the rate limiter cannot be locked, `IoTHubClient_RateLimiter_TryAcquire` shall let the operation go out rather than hold it back indefinitely. ]
+        LogError("Failed locking rate limiter, operation not limited");
+        result = true;
+    }
+    else
+    {
+        RATE_LIMIT_BUCKET* bucket = &rateLimiter->buckets[operationClass];
+
+        if (bucket->operations_per_second == 0)
+        {
+            // Codes_SRS_IOTHUB_RATE_LIMITER_09_009: [ `IoTHubClient_RateLimiter_TryAcquire` shall always admit an operation of a class without limit. ]
+            result = true;
+        }
+        else
+        {
+            refill_bucket(rateLimiter, bucket);
+
+            // Codes_SRS_IOTHUB_RATE_LIMITER_09_010: [ `IoTHubClient_RateLimiter_TryAcquire` shall take one token and return true if the bucket of `operationClass` has one, and return false otherwise. ]
+            if (bucket->milli_tokens >= MILLI_TOKENS_PER_TOKEN)
+            {
+                bucket->milli_tokens -= MILLI_TOKENS_PER_TOKEN;
+                result = true;
+            }
+            else
+            {
+                result = false;
+            }
+        }
+
+        if (result)
+        {
+            // Codes_SRS_IOTHUB_RATE_LIMITER_09_011: [ An admitted operation shall be counted in the statistics of its class, with `waitedMs` added to its wait time if not 0. ]
+            record_admission(bucket, waitedMs);
+        }
+
+        (void)Unlock(rateLimiter->lock);
+    }
+
+    return result;
+}
+
+void IoTHubClient_RateLimiter_Refund(IOTHUB_CLIENT_RATE_LIMITER_HANDLE rateLimiter, IOTHUB_CLIENT_RATE_LIMIT_CLASS operationClass, tickcounter_ms_t waitedMs)
+{
+    if (rateLimiter == NULL || (size_t)operationClass >= RATE_LIMIT_CLASS_COUNT)
+    {
+        LogError("Invalid argument (rateLimiter=%p, operationClass=%d)", rateLimiter, (int)operationClass);
+    }
+    else if (Lock(rateLimiter->lock) != LOCK_OK)
+    {
+        LogError("Failed locking rate limiter, token not refunded");
+    }
+    else
+    {
+        RATE_LIMIT_BUCKET* bucket = &rateLimiter->buckets[operationClass];
+
+        // Codes_SRS_IOTHUB_RATE_LIMITER_09_013: [ `IoTHubClient_RateLimiter_Refund` shall put one token back in the bucket of `operationClass`, up to its burst, and undo the statistics recorded for the admission. ]
+        if (bucket->operations_per_second > 0)
+        {
+            bucket->milli_tokens += MILLI_TOKENS_PER_TOKEN;
+            if (bucket->milli_tokens > bucket->capacity)
+            {
+                bucket->milli_tokens = bucket->capacity;
+            }
+        }
+
+        if (bucket->statistics.admitted_count > 0)
+        {
+            bucket->statistics.admitted_count--;
+        }
+
+        if (waitedMs > 0 && bucket->statistics.delayed_count > 0)
+        {
+            bucket->statistics.delayed_count--;
+            bucket->statistics.total_wait_ms -= (waitedMs < bucket->statistics.total_wait_ms ? waitedMs : bucket->statistics.total_wait_ms);
+        }
+
+        (void)Unlock(rateLimiter->lock);
+    }
+}
@@ -0,0 +1,307 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef USE_EDGE_MODULES
+//trying to compile iothub_client_trust_bundle.c while the symbol USE_EDGE_MODULES is not defined
+#else
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "azure_macro_utils/macro_utils.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/agenttime.h"
+
+#include "internal/iothub_client_authorization.h"
+#include "internal/iothub_client_trust_bundle.h"
+
+#define TRUST_BUNDLE_CACHE_LIFETIME_SECS    300
+
+typedef struct RETIRED_TRUST_BUNDLE_TAG
+{
+    char* trust_bundle;
+    size_t ref_count;
+    struct RETIRED_TRUST_BUNDLE_TAG* next;
+} RETIRED_TRUST_BUNDLE;
+
+typedef struct TRUST_BUNDLE_CACHE_TAG
+{
+    LOCK_HANDLE lock;               /*clients acquiring the trust bundle can be created on different threads*/
+    char* certificate_file_name;    /*NULL for the trust bundle of the HSM*/
+    char* trust_bundle;             /*NULL while no client holds a reference*/
+    size_t ref_count;
+    time_t load_time;               /*the trust bundle is loaded again once TRUST_BUNDLE_CACHE_LIFETIME_SECS old, so a rotated edge CA is picked up*/
+    RETIRED_TRUST_BUNDLE* retired;  /*trust bundles replaced by a newer one while clients still hold a reference*/
+} TRUST_BUNDLE_CACHE;
+
+static TRUST_BUNDLE_CACHE g_trust_bundle_cache;
+
+static void clear_cached_trust_bundle(void)
+{
+    free(g_trust_bundle_cache.certificate_file_name);
+    free(g_trust_bundle_cache.trust_bundle);
+    g_trust_bundle_cache.certificate_file_name = NULL;
+    g_trust_bundle_cache.trust_bundle = NULL;
+    g_trust_bundle_cache.ref_count = 0;
+}
+
+static bool is_cached_certificate_file(const char* certificate_file_name)
+{
+    bool result;
+
+    if (g_trust_bundle_cache.certificate_file_name == NULL || certificate_file_name == NULL)
+    {
+        result = (g_trust_bundle_cache.certificate_file_name == certificate_file_name);
+    }
+    else
+    {
+        result = (strcmp(g_trust_bundle_cache.certificate_file_name, certificate_file_name) == 0);
+    }
+
+    return result;
+}
+
+static bool is_cached_trust_bundle_expired(time_t now)
+{
+    return (now != INDEFINITE_TIME && get_difftime(now, g_trust_bundle_cache.load_time) >= TRUST_BUNDLE_CACHE_LIFETIME_SECS);
+}
+
+/*loads the expired cached trust bundle again; the cached one is retired if the new one differs*/
+static char* reload_cached_trust_bundle(IOTHUB_AUTHORIZATION_HANDLE authorization_handle, const char* certificate_file_name, time_t now)
+{
+    char* result;
+    RETIRED_TRUST_BUNDLE* retired;
+
+    if ((result = IoTHubClient_Auth_Get_TrustBundle(authorization_handle, certificate_file_name)) == NULL)
+    {
+        // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_016: [ If the trust bundle fails to be loaded again, `IoTHubClient_TrustBundle_Acquire` shall add a reference to the cached trust bundle and return it. ]
+        LogError("Failed loading the trust bundle again, keeping the cached one");
+        result = g_trust_bundle_cache.trust_bundle;
+    }
+    else if (strcmp(result, g_trust_bundle_cache.trust_bundle) == 0)
+    {
+        free(result);
+        result = g_trust_bundle_cache.trust_bundle;
+        g_trust_bundle_cache.load_time = now;
+    }
+    else if ((retired = (RETIRED_TRUST_BUNDLE*)malloc(sizeof(RETIRED_TRUST_BUNDLE))) == NULL)
+    {
+        // Not cached; the caller owns this copy.
+        LogError("Failed retiring the cached trust bundle, new trust bundle not cached");
+    }
+    else
+    {
+        // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_015: [ If the loaded trust bundle differs from the cached one, `IoTHubClient_TrustBundle_Acquire` shall cache it in place of the cached one, which stays valid until its last reference is released. ]
+        retired->trust_bundle = g_trust_bundle_cache.trust_bundle;
+        retired->ref_count = g_trust_bundle_cache.ref_count;
+        retired->next = g_trust_bundle_cache.retired;
+        g_trust_bundle_cache.retired = retired;
+
+        g_trust_bundle_cache.trust_bundle = result;
+        g_trust_bundle_cache.ref_count = 0;
+        g_trust_bundle_cache.load_time = now;
+    }
+
+    if (result == g_trust_bundle_cache.trust_bundle)
+    {
+        g_trust_bundle_cache.ref_count++;
+    }
+
+    return result;
+}
+
+static bool release_retired_trust_bundle(const char* trust_bundle)
+{
+    bool result;
+    RETIRED_TRUST_BUNDLE** retired = &g_trust_bundle_cache.retired;
+
+    while (*retired != NULL && (*retired)->trust_bundle != trust_bundle)
+    {
+        retired = &(*retired)->next;
+    }
+
+    if (*retired == NULL)
+    {
+        result = false;
+    }
+    else
+    {
+        (*retired)->ref_count--;
+
+        if ((*retired)->ref_count == 0)
+        {
+            RETIRED_TRUST_BUNDLE* released = *retired;
+            *retired = released->next;
+            free(released->trust_bundle);
+            free(released);
+        }
+
+        result = true;
+    }
+
+    return result;
+}
+
+int IoTHubClient_TrustBundle_Init(void)
+{
+    int result;
+
+    // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_001: [ If the cache is already initialized, `IoTHubClient_TrustBundle_Init` shall return 0. ]
+    if (g_trust_bundle_cache.lock != NULL)
+    {
+        result = 0;
+    }
+    // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_002: [ `IoTHubClient_TrustBundle_Init` shall create the lock of the cache. ]
+    else if ((g_trust_bundle_cache.lock = Lock_Init()) == NULL)
+    {
+        // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_003: [ If the lock fails to be created, `IoTHubClient_TrustBundle_Init` shall return a non-zero value. ]
+        LogError("Failed creating trust bundle cache lock");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+void IoTHubClient_TrustBundle_Deinit(void)
+{
+    // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_004: [ `IoTHubClient_TrustBundle_Deinit` shall free the cached trust bundle, the retired ones and the lock of the cache. ]
+    if (g_trust_bundle_cache.lock != NULL)
+    {
+        if (g_trust_bundle_cache.ref_count != 0)
+        {
+            LogError("Trust bundle still referenced by %lu clients", (unsigned long)g_trust_bundle_cache.ref_count);
+        }
+
+        clear_cached_trust_bundle();
+        while (g_trust_bundle_cache.retired != NULL)
+        {
+            RETIRED_TRUST_BUNDLE* retired = g_trust_bundle_cache.retired;
+            g_trust_bundle_cache.retired = retired->next;
+            free(retired->trust_bundle);
+            free(retired);
+        }
+        (void)Lock_Deinit(g_trust_bundle_cache.lock);
+        g_trust_bundle_cache.lock = NULL;
+    }
+}
+
+const char* IoTHubClient_TrustBundle_Acquire(IOTHUB_AUTHORIZATION_HANDLE authorization_handle, const char* certificate_file_name)
+{
+    char* result;
+
+    // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_005: [ If `authorization_handle` is NULL, `IoTHubClient_TrustBundle_Acquire` shall return NULL. ]
+    if (authorization_handle == NULL)
+    {
+        LogError("Invalid argument (authorization_handle is NULL)");
+        result = NULL;
+    }
+    // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_006: [ If the cache is not initialized, `IoTHubClient_TrustBundle_Acquire` shall return a copy of the trust bundle owned by the caller, obtained with `IoTHubClient_Auth_Get_TrustBundle`. ]
+    else if (g_trust_bundle_cache.lock == NULL)
+    {
+        result = IoTHubClient_Auth_Get_TrustBundle(authorization_handle, certificate_file_name);
+    }
+    else if (Lock(g_trust_bundle_cache.lock) != LOCK_OK)
+    {
+        // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_010: [ If any failure occurs, `IoTHubClient_TrustBundle_Acquire` shall return NULL. ]
+        LogError("Failed locking trust bundle cache");
+        result = NULL;
+    }
+    else
+    {
+        time_t now = get_time(NULL);
+
+        if (g_trust_bundle_cache.trust_bundle != NULL)
+        {
+            if (!is_cached_certificate_file(certificate_file_name))
+            {
+                // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_008: [ If the cache holds the trust bundle of another certificate file, `IoTHubClient_TrustBundle_Acquire` shall return a copy owned by the caller. ]
+                result = IoTHubClient_Auth_Get_TrustBundle(authorization_handle, certificate_file_name);
+            }
+            // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_014: [ If the cached trust bundle of `certificate_file_name` was loaded `TRUST_BUNDLE_CACHE_LIFETIME_SECS` or more ago, `IoTHubClient_TrustBundle_Acquire` shall load it again with `IoTHubClient_Auth_Get_TrustBundle`, add a reference to it and return it. ]
+            else if (is_cached_trust_bundle_expired(now))
+            {
+                result = reload_cached_trust_bundle(authorization_handle, certificate_file_name, now);
+            }
+            else
+            {
+                // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_007: [ If the cache holds the trust bundle of `certificate_file_name`, `IoTHubClient_TrustBundle_Acquire` shall add a reference to it and return it. ]
+                g_trust_bundle_cache.ref_count++;
+                result = g_trust_bundle_cache.trust_bundle;
+            }
+        }
+        // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_009: [ Otherwise `IoTHubClient_TrustBundle_Acquire` shall load the trust bundle with `IoTHubClient_Auth_Get_TrustBundle`, cache it with one reference and return it. ]
+        else if ((result = IoTHubClient_Auth_Get_TrustBundle(authorization_handle, certificate_file_name)) == NULL)
+        {
+            // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_010: [ If any failure occurs, `IoTHubClient_TrustBundle_Acquire` shall return NULL. ]
+            LogError("Failed loading the trust bundle");
+        }
+        else if (certificate_file_name != NULL && mallocAndStrcpy_s(&g_trust_bundle_cache.certificate_file_name, certificate_file_name) != 0)
+        {
+            // Not cached; the caller owns this copy.
+            LogError("Failed copying the certificate file name, trust bundle not cached");
+        }
+        else
+        {
+            g_trust_bundle_cache.trust_bundle = result;
+            g_trust_bundle_cache.ref_count = 1;
+            g_trust_bundle_cache.load_time = now;
+        }
+
+        (void)Unlock(g_trust_bundle_cache.lock);
+    }
+
+    return result;
+}
+
+void IoTHubClient_TrustBundle_Release(const char* trust_bundle)
+{
+    // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_011: [ If `trust_bundle` is NULL, `IoTHubClient_TrustBundle_Release` shall return. ]
+    if (trust_bundle == NULL)
+    {
+        // Nothing to release.
+    }
+    // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_012: [ If `trust_bundle` is a copy owned by the caller, `IoTHubClient_TrustBundle_Release` shall free it. ]
+    else if (g_trust_bundle_cache.lock == NULL)
+    {
+        free((char*)trust_bundle);
+    }
+    else if (Lock(g_trust_bundle_cache.lock) != LOCK_OK)
+    {
+        LogError("Failed locking trust bundle cache, reference not released");
+    }
+    else
+    {
+        if (trust_bundle == g_trust_bundle_cache.trust_bundle)
+        {
+            // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_013: [ `IoTHubClient_TrustBundle_Release` shall remove a reference to the cached trust bundle, and free it with its last reference. ]
+            g_trust_bundle_cache.ref_count--;
+
+            if (g_trust_bundle_cache.ref_count == 0)
+            {
+                clear_cached_trust_bundle();
+            }
+        }
+        // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_017: [ `IoTHubClient_TrustBundle_Release` shall remove a reference to a retired trust bundle, and free it with its last reference. ]
+        else if (release_retired_trust_bundle(trust_bundle))
+        {
+            // Reference released.
+        }
+        else
+        {
+            // Codes_SRS_IOTHUB_TRUST_BUNDLE_09_012: [ If `trust_bundle` is a copy owned by the caller, `IoTHubClient_TrustBundle_Release` shall free it. ]
+            free((char*)trust_bundle);
+        }
+
+        (void)Unlock(g_trust_bundle_cache.lock);
+    }
+}
+
+#endif /* USE_EDGE_MODULES */
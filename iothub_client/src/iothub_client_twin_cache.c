@@ -0,0 +1,485 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "azure_macro_utils/macro_utils.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "parson.h"
+
+#include "iothub_client_twin_cache.h"
+#include "internal/iothub_client_twin_cache_private.h"
+
+#define TWIN_DESIRED_SECTION "desired"
+#define TWIN_VERSION_PROPERTY "$version"
+
+typedef struct IOTHUB_CLIENT_TWIN_CACHE_TAG
+{
+    JSON_Value* document;       /*last full twin document, with the desired updates received since merged into it*/
+    JSON_Value* changed_names;  /*array with the top level desired properties touched by the last update*/
+    uint32_t desired_version;
+} IOTHUB_CLIENT_TWIN_CACHE;
+
+static JSON_Value* parse_twin_payload(const unsigned char* payload, size_t size)
+{
+    JSON_Value* result;
+    char* json_string;
+
+    if ((json_string = (char*)malloc(size + 1)) == NULL)
+    {
+        LogError("Failed allocating memory to parse twin payload");
+        result = NULL;
+    }
+    else
+    {
+        (void)memcpy(json_string, payload, size);
+        json_string[size] = '\0';
+
+        if ((result = json_parse_string(json_string)) == NULL)
+        {
+            LogError("Failed parsing twin payload");
+        }
+        else if (json_value_get_type(result) != JSONObject)
+        {
+            LogError("Twin payload is not a JSON object");
+            json_value_free(result);
+            result = NULL;
+        }
+
+        free(json_string);
+    }
+
+    return result;
+}
+
+static bool get_version(const JSON_Object* desired, uint32_t* version)
+{
+    bool result;
+    JSON_Value* version_value = json_object_get_value(desired, TWIN_VERSION_PROPERTY);
+
+    if (version_value == NULL || json_value_get_type(version_value) != JSONNumber)
+    {
+        result = false;
+    }
+    else
+    {
+        *version = (uint32_t)json_value_get_number(version_value);
+        result = true;
+    }
+
+    return result;
+}
+
+static int add_changed_name(JSON_Value* changed_names, const char* name)
+{
+    int result;
+
+    if (strcmp(name, TWIN_VERSION_PROPERTY) == 0)
+    {
+        result = 0;
+    }
+    else if (json_array_append_string(json_value_get_array(changed_names), name) != JSONSuccess)
+    {
+        LogError("Failed recording changed twin property '%s'", name);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static int merge_object(JSON_Object* target, const JSON_Object* patch)
+{
+    int result = 0;
+    size_t count = json_object_get_count(patch);
+    size_t i;
+
+    for (i = 0; i < count && result == 0; i++)
+    {
+        const char* name = json_object_get_name(patch, i);
+        JSON_Value* value = json_object_get_value_at(patch, i);
+        JSON_Value* target_value = json_object_get_value(target, name);
+
+        if (json_value_get_type(value) == JSONNull)
+        {
+            // Codes_SRS_IOTHUB_TWIN_CACHE_09_008: [ A newer partial update shall be merged into the cached desired properties following JSON merge patch rules; a null member shall remove the property. ]
+            if (target_value != NULL)
+            {
+                (void)json_object_remove(target, name);
+            }
+        }
+        else if (json_value_get_type(value) == JSONObject && target_value != NULL && json_value_get_type(target_value) == JSONObject)
+        {
+            result = merge_object(json_value_get_object(target_value), json_value_get_object(value));
+        }
+        else
+        {
+            JSON_Value* copy;
+
+            if ((copy = json_value_deep_copy(value)) == NULL)
+            {
+                LogError("Failed copying twin property '%s'", name);
+                result = MU_FAILURE;
+            }
+            else if (json_object_set_value(target, name, copy) != JSONSuccess)
+            {
+                LogError("Failed setting twin property '%s'", name);
+                json_value_free(copy);
+                result = MU_FAILURE;
+            }
+        }
+    }
+
+    return result;
+}
+
+static int diff_desired(JSON_Value* changed_names, const JSON_Object* previous, const JSON_Object* current)
+{
+    int result = 0;
+    size_t count = json_object_get_count(current);
+    size_t i;
+
+    for (i = 0; i < count && result == 0; i++)
+    {
+        const char* name = json_object_get_name(current, i);
+        JSON_Value* previous_value = (previous == NULL ? NULL : json_object_get_value(previous, name));
+
+        if (previous_value == NULL || !json_value_equals(previous_value, json_object_get_value_at(current, i)))
+        {
+            result = add_changed_name(changed_names, name);
+        }
+    }
+
+    count = (previous == NULL ? 0 : json_object_get_count(previous));
+    for (i = 0; i < count && result == 0; i++)
+    {
+        const char* name = json_object_get_name(previous, i);
+
+        if (json_object_get_value(current, name) == NULL)
+        {
+            result = add_changed_name(changed_names, name);
+        }
+    }
+
+    return result;
+}
+
+static TWIN_CACHE_UPDATE_RESULT apply_complete_twin(IOTHUB_CLIENT_TWIN_CACHE* twin_cache, JSON_Value* document, JSON_Value* changed_names)
+{
+    TWIN_CACHE_UPDATE_RESULT result;
+    JSON_Object* desired = json_object_get_object(json_value_get_object(document), TWIN_DESIRED_SECTION);
+    uint32_t version = 0;
+
+    if (desired == NULL)
+    {
+        LogError("Full twin document has no desired properties");
+        result = TWIN_CACHE_UPDATE_ERROR;
+    }
+    // Codes_SRS_IOTHUB_TWIN_CACHE_09_005: [ For a full twin document, the changed properties shall be the top level desired properties added, modified or removed compared to the cached document. ]
+    else if (diff_desired(changed_names, (twin_cache->document == NULL ? NULL : json_object_get_object(json_value_get_object(twin_cache->document), TWIN_DESIRED_SECTION)), desired) != 0)
+    {
+        result = TWIN_CACHE_UPDATE_ERROR;
+    }
+    else
+    {
+        (void)get_version(desired, &version);
+
+        // Codes_SRS_IOTHUB_TWIN_CACHE_09_006: [ If a full twin document has the same desired `$version` and desired properties as the cache, IoTHubClient_TwinCache_Update shall replace the cached document and return TWIN_CACHE_UPDATE_UNCHANGED. ]
+        result = (twin_cache->document != NULL && twin_cache->desired_version == version && json_array_get_count(json_value_get_array(changed_names)) == 0) ?
+            TWIN_CACHE_UPDATE_UNCHANGED : TWIN_CACHE_UPDATE_CHANGED;
+
+        // Codes_SRS_IOTHUB_TWIN_CACHE_09_004: [ A full twin document shall replace the cached document. ]
+        if (twin_cache->document != NULL)
+        {
+            json_value_free(twin_cache->document);
+        }
+        twin_cache->document = document;
+        twin_cache->desired_version = version;
+    }
+
+    return result;
+}
+
+static TWIN_CACHE_UPDATE_RESULT apply_partial_twin(IOTHUB_CLIENT_TWIN_CACHE* twin_cache, const JSON_Object* patch_object, JSON_Value* changed_names)
+{
+    TWIN_CACHE_UPDATE_RESULT result;
+    JSON_Object* desired;
+    uint32_t version = 0;
+    bool has_version = get_version(patch_object, &version);
+
+    if (twin_cache->document == NULL)
+    {
+        // Codes_SRS_IOTHUB_TWIN_CACHE_09_010: [ If no full twin document was received yet, IoTHubClient_TwinCache_Update shall ignore a partial update and return TWIN_CACHE_UPDATE_OUT_OF_SYNC. ]
+        result = TWIN_CACHE_UPDATE_OUT_OF_SYNC;
+    }
+    else if (has_version && version <= twin_cache->desired_version)
+    {
+        // Codes_SRS_IOTHUB_TWIN_CACHE_09_007: [ A partial update with a `$version` not newer than the cache shall be ignored and IoTHubClient_TwinCache_Update shall return TWIN_CACHE_UPDATE_UNCHANGED. ]
+        result = TWIN_CACHE_UPDATE_UNCHANGED;
+    }
+    else if ((desired = json_object_get_object(json_value_get_object(twin_cache->document), TWIN_DESIRED_SECTION)) == NULL)
+    {
+        LogError("Cached twin document has no desired properties");
+        result = TWIN_CACHE_UPDATE_ERROR;
+    }
+    else
+    {
+        size_t count = json_object_get_count(patch_object);
+        size_t i;
+        int merge_result = 0;
+
+        // Codes_SRS_IOTHUB_TWIN_CACHE_09_009: [ For a partial update, the changed properties shall be the top level members of the update. ]
+        for (i = 0; i < count && merge_result == 0; i++)
+        {
+            merge_result = add_changed_name(changed_names, json_object_get_name(patch_object, i));
+        }
+
+        // Codes_SRS_IOTHUB_TWIN_CACHE_09_008: [ A newer partial update shall be merged into the cached desired properties following JSON merge patch rules; a null member shall remove the property. ]
+        if (merge_result != 0 || merge_object(desired, patch_object) != 0)
+        {
+            /*the cached document may be partially updated; make the next full twin replace it*/
+            twin_cache->desired_version = 0;
+            result = TWIN_CACHE_UPDATE_ERROR;
+        }
+        // Codes_SRS_IOTHUB_TWIN_CACHE_09_011: [ If the partial update skips one or more versions, IoTHubClient_TwinCache_Update shall keep the cached desired `$version` and return TWIN_CACHE_UPDATE_OUT_OF_SYNC. ]
+        else if (has_version && version != twin_cache->desired_version + 1)
+        {
+            /*the cache misses the skipped versions until the next full twin, which must not be taken as already applied*/
+            result = TWIN_CACHE_UPDATE_OUT_OF_SYNC;
+        }
+        else
+        {
+            if (has_version)
+            {
+                twin_cache->desired_version = version;
+            }
+            result = TWIN_CACHE_UPDATE_CHANGED;
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_TWIN_CACHE_HANDLE IoTHubClient_TwinCache_Create(void)
+{
+    IOTHUB_CLIENT_TWIN_CACHE* result;
+
+    // Codes_SRS_IOTHUB_TWIN_CACHE_09_001: [ IoTHubClient_TwinCache_Create shall allocate an empty twin cache. ]
+    if ((result = (IOTHUB_CLIENT_TWIN_CACHE*)malloc(sizeof(IOTHUB_CLIENT_TWIN_CACHE))) == NULL)
+    {
+        // Codes_SRS_IOTHUB_TWIN_CACHE_09_002: [ If any failure occurs, IoTHubClient_TwinCache_Create shall return NULL. ]
+        LogError("Failed allocating twin cache");
+    }
+    else if ((result->changed_names = json_value_init_array()) == NULL)
+    {
+        LogError("Failed creating the changed properties list");
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        result->document = NULL;
+        result->desired_version = 0;
+    }
+
+    return result;
+}
+
+void IoTHubClient_TwinCache_Destroy(IOTHUB_CLIENT_TWIN_CACHE_HANDLE twinCache)
+{
+    if (twinCache != NULL)
+    {
+        if (twinCache->document != NULL)
+        {
+            json_value_free(twinCache->document);
+        }
+        if (twinCache->changed_names != NULL)
+        {
+            json_value_free(twinCache->changed_names);
+        }
+        free(twinCache);
+    }
+}
+
+TWIN_CACHE_UPDATE_RESULT IoTHubClient_TwinCache_Update(IOTHUB_CLIENT_TWIN_CACHE_HANDLE twinCache, DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payload, size_t size)
+{
+    TWIN_CACHE_UPDATE_RESULT result;
+    JSON_Value* update;
+    JSON_Value* changed_names;
+
+    // Codes_SRS_IOTHUB_TWIN_CACHE_09_003: [ If `twinCache` or `payload` are NULL, or `size` is 0, IoTHubClient_TwinCache_Update shall return TWIN_CACHE_UPDATE_ERROR. ]
+    if (twinCache == NULL || payload == NULL || size == 0)
+    {
+        LogError("Invalid argument (twinCache=%p, payload=%p, size=%lu)", twinCache, payload, (unsigned long)size);
+        result = TWIN_CACHE_UPDATE_ERROR;
+    }
+    else if ((update = parse_twin_payload(payload, size)) == NULL)
+    {
+        result = TWIN_CACHE_UPDATE_ERROR;
+    }
+    else if ((changed_names = json_value_init_array()) == NULL)
+    {
+        LogError("Failed creating the changed properties list");
+        json_value_free(update);
+        result = TWIN_CACHE_UPDATE_ERROR;
+    }
+    else
+    {
+        if (update_state == DEVICE_TWIN_UPDATE_COMPLETE)
+        {
+            result = apply_complete_twin(twinCache, update, changed_names);
+        }
+        else
+        {
+            result = apply_partial_twin(twinCache, json_value_get_object(update), changed_names);
+        }
+
+        /*a full twin document that was applied is now owned by the cache*/
+        if (update_state != DEVICE_TWIN_UPDATE_COMPLETE || result == TWIN_CACHE_UPDATE_ERROR)
+        {
+            json_value_free(update);
+        }
+
+        if (result == TWIN_CACHE_UPDATE_ERROR)
+        {
+            json_value_free(changed_names);
+        }
+        else
+        {
+            if (twinCache->changed_names != NULL)
+            {
+                json_value_free(twinCache->changed_names);
+            }
+            twinCache->changed_names = changed_names;
+        }
+    }
+
+    // Codes_SRS_IOTHUB_TWIN_CACHE_09_012: [ If the update fails, the list of changed properties shall be empty. ]
+    if (result == TWIN_CACHE_UPDATE_ERROR && twinCache != NULL && twinCache->changed_names != NULL)
+    {
+        (void)json_array_clear(json_value_get_array(twinCache->changed_names));
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_TwinCache_GetDesiredVersion(IOTHUB_CLIENT_TWIN_CACHE_HANDLE twinCache, uint32_t* version)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    // Codes_SRS_IOTHUB_TWIN_CACHE_09_013: [ If `twinCache` or `version` are NULL, IoTHubClient_TwinCache_GetDesiredVersion shall return IOTHUB_CLIENT_INVALID_ARG. ]
+    if (twinCache == NULL || version == NULL)
+    {
+        LogError("Invalid argument (twinCache=%p, version=%p)", twinCache, version);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    // Codes_SRS_IOTHUB_TWIN_CACHE_09_014: [ If no full twin document was received yet, IoTHubClient_TwinCache_GetDesiredVersion shall return IOTHUB_CLIENT_ERROR. ]
+    else if (twinCache->document == NULL)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        *version = twinCache->desired_version;
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+static JSON_Value* get_property(IOTHUB_CLIENT_TWIN_CACHE_HANDLE twinCache, const char* path)
+{
+    JSON_Value* result;
+
+    if (twinCache == NULL || path == NULL)
+    {
+        LogError("Invalid argument (twinCache=%p, path=%p)", twinCache, path);
+        result = NULL;
+    }
+    else if (twinCache->document == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        // Codes_SRS_IOTHUB_TWIN_CACHE_09_015: [ The typed getters shall look up `path` as a dot separated path from the root of the cached twin document. ]
+        result = json_object_dotget_value(json_value_get_object(twinCache->document), path);
+    }
+
+    return result;
+}
+
+const char* IoTHubClient_TwinCache_GetString(IOTHUB_CLIENT_TWIN_CACHE_HANDLE twinCache, const char* path)
+{
+    JSON_Value* property = get_property(twinCache, path);
+
+    // Codes_SRS_IOTHUB_TWIN_CACHE_09_016: [ If the property does not exist or is not of the requested type, the typed getters shall fail. ]
+    return (property == NULL ? NULL : json_value_get_string(property));
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_TwinCache_GetNumber(IOTHUB_CLIENT_TWIN_CACHE_HANDLE twinCache, const char* path, double* value)
+{
+    IOTHUB_CLIENT_RESULT result;
+    JSON_Value* property;
+
+    if (value == NULL)
+    {
+        LogError("Invalid argument value=NULL");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if ((property = get_property(twinCache, path)) == NULL || json_value_get_type(property) != JSONNumber)
+    {
+        // Codes_SRS_IOTHUB_TWIN_CACHE_09_016: [ If the property does not exist or is not of the requested type, the typed getters shall fail. ]
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        *value = json_value_get_number(property);
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_TwinCache_GetBool(IOTHUB_CLIENT_TWIN_CACHE_HANDLE twinCache, const char* path, bool* value)
+{
+    IOTHUB_CLIENT_RESULT result;
+    JSON_Value* property;
+
+    if (value == NULL)
+    {
+        LogError("Invalid argument value=NULL");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if ((property = get_property(twinCache, path)) == NULL || json_value_get_type(property) != JSONBoolean)
+    {
+        // Codes_SRS_IOTHUB_TWIN_CACHE_09_016: [ If the property does not exist or is not of the requested type, the typed getters shall fail. ]
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        *value = (json_value_get_boolean(property) != 0);
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+size_t IoTHubClient_TwinCache_GetChangedCount(IOTHUB_CLIENT_TWIN_CACHE_HANDLE twinCache)
+{
+    // Codes_SRS_IOTHUB_TWIN_CACHE_09_017: [ IoTHubClient_TwinCache_GetChangedCount and IoTHubClient_TwinCache_GetChangedName shall expose the properties changed by the last update. ]
+    return (twinCache == NULL || twinCache->changed_names == NULL ? 0 : json_array_get_count(json_value_get_array(twinCache->changed_names)));
+}
+
+const char* IoTHubClient_TwinCache_GetChangedName(IOTHUB_CLIENT_TWIN_CACHE_HANDLE twinCache, size_t index)
+{
+    // Codes_SRS_IOTHUB_TWIN_CACHE_09_017: [ IoTHubClient_TwinCache_GetChangedCount and IoTHubClient_TwinCache_GetChangedName shall expose the properties changed by the last update. ]
+    return (twinCache == NULL || twinCache->changed_names == NULL ? NULL : json_array_get_string(json_value_get_array(twinCache->changed_names), index));
+}
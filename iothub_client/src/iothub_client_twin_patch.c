@@ -0,0 +1,154 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "azure_macro_utils/macro_utils.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/constbuffer.h"
+
+#include "parson.h"
+
+#include "internal/iothub_client_twin_patch.h"
+
+static JSON_Value* parse_patch(const unsigned char* data, size_t size)
+{
+    JSON_Value* result;
+    char* json_string;
+
+    if ((json_string = (char*)malloc(size + 1)) == NULL)
+    {
+        LogError("Failed allocating memory to parse twin patch");
+        result = NULL;
+    }
+    else
+    {
+        (void)memcpy(json_string, data, size);
+        json_string[size] = '\0';
+
+        // Codes_SRS_IOTHUB_TWIN_PATCH_09_003: [ If either patch is not a JSON object, IoTHubClient_TwinPatch_Merge shall return NULL. ]
+        if ((result = json_parse_string(json_string)) != NULL && json_value_get_type(result) != JSONObject)
+        {
+            json_value_free(result);
+            result = NULL;
+        }
+
+        free(json_string);
+    }
+
+    return result;
+}
+
+static int merge_object(JSON_Object* target, const JSON_Object* patch)
+{
+    int result = 0;
+    size_t count = json_object_get_count(patch);
+    size_t i;
+
+    for (i = 0; i < count && result == 0; i++)
+    {
+        const char* name = json_object_get_name(patch, i);
+        JSON_Value* value = json_object_get_value_at(patch, i);
+        JSON_Value* target_value = json_object_get_value(target, name);
+
+        if (json_value_get_type(value) == JSONObject && target_value != NULL && json_value_get_type(target_value) == JSONObject)
+        {
+            // Codes_SRS_IOTHUB_TWIN_PATCH_09_005: [ Members that are JSON objects in both patches shall be merged recursively. ]
+            result = merge_object(json_value_get_object(target_value), json_value_get_object(value));
+        }
+        else if (json_value_get_type(value) == JSONObject && target_value != NULL)
+        {
+            // Codes_SRS_IOTHUB_TWIN_PATCH_09_008: [ If a member of `next_patch` is a JSON object and the same member of `patch` is null or not a JSON object, IoTHubClient_TwinPatch_Merge shall return NULL. ]
+            // The service replaces the whole member when such patches are applied one after another, which a single merged patch cannot express.
+            result = MU_FAILURE;
+        }
+        else
+        {
+            // Codes_SRS_IOTHUB_TWIN_PATCH_09_004: [ Every other member of `next_patch`, including null ones, shall replace the member with the same name in `patch`. ]
+            JSON_Value* copy;
+
+            if ((copy = json_value_deep_copy(value)) == NULL)
+            {
+                LogError("Failed copying twin patch member '%s'", name);
+                result = MU_FAILURE;
+            }
+            else if (json_object_set_value(target, name, copy) != JSONSuccess)
+            {
+                LogError("Failed setting twin patch member '%s'", name);
+                json_value_free(copy);
+                result = MU_FAILURE;
+            }
+        }
+    }
+
+    return result;
+}
+
+CONSTBUFFER_HANDLE IoTHubClient_TwinPatch_Merge(CONSTBUFFER_HANDLE patch, const unsigned char* next_patch, size_t next_patch_size)
+{
+    CONSTBUFFER_HANDLE result;
+    const CONSTBUFFER* patch_content;
+
+    // Codes_SRS_IOTHUB_TWIN_PATCH_09_001: [ If `patch` or `next_patch` are NULL, or `next_patch_size` is 0, IoTHubClient_TwinPatch_Merge shall return NULL. ]
+    if (patch == NULL || next_patch == NULL || next_patch_size == 0)
+    {
+        LogError("Invalid argument (patch=%p, next_patch=%p, next_patch_size=%lu)", patch, next_patch, (unsigned long)next_patch_size);
+        result = NULL;
+    }
+    else if ((patch_content = CONSTBUFFER_GetContent(patch)) == NULL)
+    {
+        LogError("Failed getting the content of the twin patch");
+        result = NULL;
+    }
+    else
+    {
+        // Codes_SRS_IOTHUB_TWIN_PATCH_09_002: [ IoTHubClient_TwinPatch_Merge shall parse both patches as JSON. ]
+        JSON_Value* merged_value;
+        JSON_Value* next_value;
+
+        if ((merged_value = parse_patch(patch_content->buffer, patch_content->size)) == NULL)
+        {
+            result = NULL;
+        }
+        else
+        {
+            if ((next_value = parse_patch(next_patch, next_patch_size)) == NULL)
+            {
+                result = NULL;
+            }
+            else
+            {
+                char* merged_string;
+
+                if (merge_object(json_value_get_object(merged_value), json_value_get_object(next_value)) != 0)
+                {
+                    result = NULL;
+                }
+                // Codes_SRS_IOTHUB_TWIN_PATCH_09_006: [ IoTHubClient_TwinPatch_Merge shall return the serialized merged patch in a new CONSTBUFFER_HANDLE. ]
+                else if ((merged_string = json_serialize_to_string(merged_value)) == NULL)
+                {
+                    LogError("Failed serializing the merged twin patch");
+                    result = NULL;
+                }
+                else
+                {
+                    if ((result = CONSTBUFFER_Create((const unsigned char*)merged_string, strlen(merged_string))) == NULL)
+                    {
+                        LogError("Failed creating the merged twin patch buffer");
+                    }
+
+                    json_free_serialized_string(merged_string);
+                }
+
+                json_value_free(next_value);
+            }
+
+            json_value_free(merged_value);
+        }
+    }
+
+    // Codes_SRS_IOTHUB_TWIN_PATCH_09_007: [ If any failure occurs, IoTHubClient_TwinPatch_Merge shall return NULL. ]
+    return result;
+}
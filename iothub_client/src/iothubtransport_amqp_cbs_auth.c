@@ -6,6 +6,7 @@
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/sastoken.h"
 
@@ -16,6 +17,8 @@
 #define IOTHUB_DEVICES_MODULE_PATH_FMT            "%s/devices/%s/modules/%s"
 #define DEFAULT_CBS_REQUEST_TIMEOUT_SECS          UINT32_MAX
 #define SAS_REFRESH_MULTIPLIER                    .8
+#define FNV_32_OFFSET_BASIS                       2166136261u
+#define FNV_32_PRIME                              16777619u
 
 typedef struct AUTHENTICATION_INSTANCE_TAG
 {
@@ -39,11 +42,25 @@ typedef struct AUTHENTICATION_INSTANCE_TAG
 
     time_t current_sas_token_put_time;
 
+    AUTHENTICATION_REFRESH_SCHEDULER* refresh_scheduler;
+    uint32_t refresh_offset_hash;
+    bool holds_refresh_slot;
+    bool is_refresh_put_time_set;
+    tickcounter_ms_t refresh_put_time_ms;
+    bool is_sas_token_pending;
+    struct AUTHENTICATION_INSTANCE_TAG* next_pending_sas_token;
+
     // Auth module used to generating handle authorization
     // with either SAS Token, x509 Certs, and Device SAS Token
     IOTHUB_AUTHORIZATION_HANDLE authorization_module;
 } AUTHENTICATION_INSTANCE;
 
+typedef struct PENDING_SAS_TOKEN_TAG
+{
+    AUTHENTICATION_INSTANCE* instance;
+    STRING_HANDLE devices_and_modules_path;
+} PENDING_SAS_TOKEN;
+
 
 // Helper functions:
 
@@ -69,6 +86,127 @@ static void notify_error(AUTHENTICATION_INSTANCE* instance, AUTHENTICATION_ERROR
     }
 }
 
+static uint32_t get_refresh_offset_hash(const char* device_id, const char* module_id)
+{
+    uint32_t hash = FNV_32_OFFSET_BASIS;
+    const char* ids[2];
+    size_t i;
+
+    ids[0] = device_id;
+    ids[1] = module_id;
+
+    for (i = 0; i < sizeof(ids) / sizeof(ids[0]); i++)
+    {
+        const char* c = ids[i];
+
+        while (c != NULL && *c != '\0')
+        {
+            hash ^= (uint32_t)(unsigned char)*c;
+            hash *= FNV_32_PRIME;
+            c++;
+        }
+    }
+
+    return hash;
+}
+
+// @brief    Reserves one of the refresh slots of the shared scheduler, if any.
+// @returns  true if the SAS token refresh can start now, false if it shall be retried on a later do_work.
+static bool acquire_refresh_slot(AUTHENTICATION_INSTANCE* instance)
+{
+    bool result;
+    AUTHENTICATION_REFRESH_SCHEDULER* scheduler = instance->refresh_scheduler;
+
+    if (scheduler == NULL)
+    {
+        result = true;
+    }
+    else if (scheduler->max_concurrent_refreshes != 0 && scheduler->refreshes_in_progress >= scheduler->max_concurrent_refreshes)
+    {
+        scheduler->metrics.refresh_deferred_count++;
+        result = false;
+    }
+    else
+    {
+        scheduler->refreshes_in_progress++;
+        instance->holds_refresh_slot = true;
+        result = true;
+    }
+
+    return result;
+}
+
+static void release_refresh_slot(AUTHENTICATION_INSTANCE* instance, bool refresh_succeeded)
+{
+    if (instance->holds_refresh_slot)
+    {
+        AUTHENTICATION_REFRESH_SCHEDULER* scheduler = instance->refresh_scheduler;
+
+        scheduler->refreshes_in_progress--;
+        instance->holds_refresh_slot = false;
+
+        if (!refresh_succeeded)
+        {
+            scheduler->metrics.refresh_failure_count++;
+        }
+        else
+        {
+            tickcounter_ms_t current_time_ms;
+
+            scheduler->metrics.refresh_count++;
+
+            if (instance->is_refresh_put_time_set && tickcounter_get_current_ms(scheduler->tick_counter, &current_time_ms) == 0)
+            {
+                tickcounter_ms_t latency_ms = current_time_ms - instance->refresh_put_time_ms;
+
+                scheduler->metrics.last_refresh_latency_ms = latency_ms;
+                scheduler->metrics.total_refresh_latency_ms += latency_ms;
+
+                if (latency_ms > scheduler->metrics.max_refresh_latency_ms)
+                {
+                    scheduler->metrics.max_refresh_latency_ms = latency_ms;
+                }
+            }
+        }
+
+        instance->is_refresh_put_time_set = false;
+    }
+}
+
+static bool is_sas_token_signing_batched(AUTHENTICATION_INSTANCE* instance)
+{
+    return instance->refresh_scheduler != NULL && instance->refresh_scheduler->batch_sas_token_signing &&
+        IoTHubClient_Auth_Get_Credential_Type(instance->authorization_module) == IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY;
+}
+
+static void queue_pending_sas_token(AUTHENTICATION_INSTANCE* instance)
+{
+    instance->next_pending_sas_token = instance->refresh_scheduler->pending_sas_tokens;
+    instance->refresh_scheduler->pending_sas_tokens = instance;
+    instance->is_sas_token_pending = true;
+}
+
+static void remove_pending_sas_token(AUTHENTICATION_INSTANCE* instance)
+{
+    if (instance->is_sas_token_pending)
+    {
+        AUTHENTICATION_INSTANCE** link = &instance->refresh_scheduler->pending_sas_tokens;
+
+        while (*link != NULL && *link != instance)
+        {
+            link = &(*link)->next_pending_sas_token;
+        }
+
+        if (*link == instance)
+        {
+            *link = instance->next_pending_sas_token;
+        }
+
+        instance->next_pending_sas_token = NULL;
+        instance->is_sas_token_pending = false;
+    }
+}
+
 static int verify_cbs_put_token_timeout(AUTHENTICATION_INSTANCE* instance, bool* is_timed_out)
 {
     int result;
@@ -126,14 +264,23 @@ static int verify_sas_token_refresh_timeout(AUTHENTICATION_INSTANCE* instance, b
             result = MU_FAILURE;
             LogError("Failed verifying if SAS token refresh timed out (get_time failed)");
         }
-        else if ((uint32_t)get_difftime(current_time, instance->current_sas_token_put_time) >= (sas_token_expiry*SAS_REFRESH_MULTIPLIER))
-        {
-            *is_timed_out = true;
-            result = RESULT_OK;
-        }
         else
         {
-            *is_timed_out = false;
+            double refresh_time_secs = sas_token_expiry * SAS_REFRESH_MULTIPLIER;
+
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_133: [If `instance->refresh_scheduler->refresh_spread_secs` is not zero, the SAS token refresh shall be brought forward by the device hash modulo (`refresh_spread_secs` + 1) seconds]
+            // Spreads the refreshes of devices authenticated at the same time (e.g., all devices on a gateway start) across the refresh window.
+            if (instance->refresh_scheduler != NULL && instance->refresh_scheduler->refresh_spread_secs != 0)
+            {
+                size_t offset_secs = instance->refresh_offset_hash % (instance->refresh_scheduler->refresh_spread_secs + 1);
+
+                if ((double)offset_secs < refresh_time_secs)
+                {
+                    refresh_time_secs -= (double)offset_secs;
+                }
+            }
+
+            *is_timed_out = ((uint32_t)get_difftime(current_time, instance->current_sas_token_put_time) >= refresh_time_secs);
             result = RESULT_OK;
         }
     }
@@ -173,6 +320,9 @@ static void on_cbs_put_token_complete_callback(void* context, CBS_OPERATION_RESU
     instance->is_cbs_put_token_in_progress = false;
 
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_091: [If `result` is CBS_OPERATION_RESULT_OK `instance->state` shall be set to AUTHENTICATION_STATE_STARTED and `instance->on_state_changed_callback` invoked]
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_132: [If a SAS token refresh slot is held, it shall be released and the refresh result and latency recorded in `instance->refresh_scheduler->metrics`, the latency in milliseconds since the put-token request as read with tickcounter_get_current_ms()]
+    release_refresh_slot(instance, operation_result == CBS_OPERATION_RESULT_OK);
+
     if (operation_result == CBS_OPERATION_RESULT_OK)
     {
         update_state(instance, AUTHENTICATION_STATE_STARTED);
@@ -235,6 +385,10 @@ static int put_SAS_token_to_cbs(AUTHENTICATION_INSTANCE* instance, STRING_HANDLE
 
         instance->current_sas_token_put_time = current_time; // If it failed, fear not. `current_sas_token_put_time` shall be checked for INDEFINITE_TIME wherever it is used.
 
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_142: [If a SAS token refresh slot is held and `instance->refresh_scheduler->tick_counter` is not NULL, the time of the put-token request shall be read with tickcounter_get_current_ms() to measure the refresh latency]
+        instance->is_refresh_put_time_set = instance->holds_refresh_slot && instance->refresh_scheduler->tick_counter != NULL &&
+            tickcounter_get_current_ms(instance->refresh_scheduler->tick_counter, &instance->refresh_put_time_ms) == 0;
+
         result = RESULT_OK;
     }
 
@@ -339,6 +493,47 @@ static int create_and_put_SAS_token_to_cbs(AUTHENTICATION_INSTANCE* instance)
     return result;
 }
 
+// @brief    Moves the instance to AUTHENTICATION_STATE_ERROR after its SAS token could not be created or put to CBS.
+static void fail_sas_token_put(AUTHENTICATION_INSTANCE* instance)
+{
+    if (instance->is_sas_token_refresh_in_progress)
+    {
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_120: [If cbs_put_token() fails, `instance->is_sas_token_refresh_in_progress` shall be set to FALSE]
+        instance->is_sas_token_refresh_in_progress = false;
+
+        release_refresh_slot(instance, false);
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_079: [If cbs_put_token() fails, `instance->state` shall be updated to AUTHENTICATION_STATE_ERROR and `instance->on_state_changed_callback` invoked]
+        update_state(instance, AUTHENTICATION_STATE_ERROR);
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_080: [If cbs_put_token() fails, `instance->on_error_callback` shall be invoked with AUTHENTICATION_ERROR_SAS_REFRESH_FAILED]
+        notify_error(instance, AUTHENTICATION_ERROR_SAS_REFRESH_FAILED);
+    }
+    else
+    {
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_061: [If cbs_put_token() fails, `instance->state` shall be updated to AUTHENTICATION_STATE_ERROR and `instance->on_state_changed_callback` invoked]
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_121: [If cbs_put_token() fails, `instance->state` shall be updated to AUTHENTICATION_STATE_ERROR and `instance->on_state_changed_callback` invoked]
+        update_state(instance, AUTHENTICATION_STATE_ERROR);
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_062: [If cbs_put_token() fails, `instance->on_error_callback` shall be invoked with AUTHENTICATION_ERROR_AUTH_FAILED]
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_122: [If cbs_put_token() fails, `instance->on_error_callback` shall be invoked with AUTHENTICATION_ERROR_AUTH_FAILED]
+        notify_error(instance, AUTHENTICATION_ERROR_AUTH_FAILED);
+    }
+}
+
+static void create_and_put_SAS_token_or_fail(AUTHENTICATION_INSTANCE* instance)
+{
+    if (create_and_put_SAS_token_to_cbs(instance) != RESULT_OK)
+    {
+        LogError("Failed putting a SAS token to CBS for device '%s'", instance->device_id);
+    }
+
+    if (!instance->is_cbs_put_token_in_progress)
+    {
+        fail_sas_token_put(instance);
+    }
+}
+
 // ---------- Set/Retrieve Options Helpers ----------//
 static void* authentication_clone_option(const char* name, const void* value)
 {
@@ -458,6 +653,12 @@ int authentication_stop(AUTHENTICATION_HANDLE authentication_handle)
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_033: [`instance->cbs_handle` shall be set to NULL]
             instance->cbs_handle = NULL;
 
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_136: [If `instance` is waiting for its SAS token to be signed, it shall be removed from `instance->refresh_scheduler->pending_sas_tokens`]
+            remove_pending_sas_token(instance);
+
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_131: [If a SAS token refresh slot of `instance->refresh_scheduler` is held, it shall be released]
+            release_refresh_slot(instance, false);
+
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_034: [`instance->state` shall be set to AUTHENTICATION_STATE_STOPPED and `instance->on_state_changed_callback` invoked]
             update_state(instance, AUTHENTICATION_STATE_STOPPED);
 
@@ -570,6 +771,10 @@ AUTHENTICATION_HANDLE authentication_create(const AUTHENTICATION_CONFIG* config)
 
                 instance->authorization_module = config->authorization_module;
 
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_129: [authentication_create() shall save `config->refresh_scheduler` into `instance->refresh_scheduler`, and a hash of the device and module ids used to stagger the SAS token refreshes]
+                instance->refresh_scheduler = config->refresh_scheduler;
+                instance->refresh_offset_hash = get_refresh_offset_hash(instance->device_id, instance->module_id);
+
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_024: [If no failure occurs, authentication_create() shall return a reference to the AUTHENTICATION_INSTANCE handle]
                 result = (AUTHENTICATION_HANDLE)instance;
             }
@@ -607,6 +812,8 @@ void authentication_do_work(AUTHENTICATION_HANDLE authentication_handle)
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_085: [`instance->is_cbs_put_token_in_progress` shall be set to FALSE]
                 instance->is_cbs_put_token_in_progress = false;
 
+                release_refresh_slot(instance, false);
+
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_086: [`instance->state` shall be updated to AUTHENTICATION_STATE_ERROR and `instance->on_state_changed_callback` invoked]
                 update_state(instance, AUTHENTICATION_STATE_ERROR);
 
@@ -625,6 +832,11 @@ void authentication_do_work(AUTHENTICATION_HANDLE authentication_handle)
                 instance->is_sas_token_refresh_in_progress = false;
             }
         }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_135: [If `instance` is waiting for authentication_sign_pending_sas_tokens() to sign its SAS token, authentication_do_work() shall return]
+        else if (instance->is_sas_token_pending)
+        {
+            // Nothing to be done until the pending SAS tokens are signed.
+        }
         else if (instance->state == AUTHENTICATION_STATE_STARTED)
         {
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_040: [If `instance->state` is AUTHENTICATION_STATE_STARTED and user-provided SAS token was used, authentication_do_work() shall return]
@@ -634,49 +846,38 @@ void authentication_do_work(AUTHENTICATION_HANDLE authentication_handle)
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_039: [If `instance->state` is AUTHENTICATION_STATE_STARTED and device keys were used, authentication_do_work() shall only verify the SAS token refresh time]
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_066: [If SAS token does not need to be refreshed, authentication_do_work() shall return]
                 bool is_timed_out;
-                if (verify_sas_token_refresh_timeout(instance, &is_timed_out) == RESULT_OK && is_timed_out)
+                if (verify_sas_token_refresh_timeout(instance, &is_timed_out) == RESULT_OK && is_timed_out &&
+                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_130: [If `instance->refresh_scheduler` already has `max_concurrent_refreshes` SAS token refreshes in progress, the refresh shall be postponed to a later authentication_do_work() call]
+                    acquire_refresh_slot(instance))
                 {
                     // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_119: [authentication_do_work() shall set `instance->is_sas_token_refresh_in_progress` to TRUE]
                     instance->is_sas_token_refresh_in_progress = true;
 
-                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_067: [authentication_do_work() shall create a SAS token using `instance->device_primary_key`, unless it has failed previously]
-                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_069: [If using `instance->device_primary_key` has failed previously, a SAS token shall be created using `instance->device_secondary_key`]
-                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_068: [If using `instance->device_primary_key` has failed previously and `instance->device_secondary_key` is not provided,  authentication_do_work() shall fail and return]
-                    if (create_and_put_SAS_token_to_cbs(instance) != RESULT_OK)
+                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_134: [If `instance->refresh_scheduler->batch_sas_token_signing` is TRUE and device keys are used, authentication_do_work() shall queue `instance` on `instance->refresh_scheduler->pending_sas_tokens` instead of creating the SAS token]
+                    if (is_sas_token_signing_batched(instance))
                     {
-                        LogError("Failed refreshing SAS token '%s'", instance->device_id);
+                        queue_pending_sas_token(instance);
                     }
-
-                    if (!instance->is_cbs_put_token_in_progress)
+                    else
                     {
-                        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_120: [If cbs_put_token() fails, `instance->is_sas_token_refresh_in_progress` shall be set to FALSE]
-                        instance->is_sas_token_refresh_in_progress = false;
-
-                        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_079: [If cbs_put_token() fails, `instance->state` shall be updated to AUTHENTICATION_STATE_ERROR and `instance->on_state_changed_callback` invoked]
-                        update_state(instance, AUTHENTICATION_STATE_ERROR);
-
-                        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_080: [If cbs_put_token() fails, `instance->on_error_callback` shall be invoked with AUTHENTICATION_ERROR_SAS_REFRESH_FAILED]
-                        notify_error(instance, AUTHENTICATION_ERROR_SAS_REFRESH_FAILED);
+                        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_067: [authentication_do_work() shall create a SAS token using `instance->device_primary_key`, unless it has failed previously]
+                        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_069: [If using `instance->device_primary_key` has failed previously, a SAS token shall be created using `instance->device_secondary_key`]
+                        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_068: [If using `instance->device_primary_key` has failed previously and `instance->device_secondary_key` is not provided,  authentication_do_work() shall fail and return]
+                        create_and_put_SAS_token_or_fail(instance);
                     }
                 }
             }
         }
         else if (instance->state == AUTHENTICATION_STATE_STARTING)
         {
-            if (create_and_put_SAS_token_to_cbs(instance) != RESULT_OK)
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_134: [If `instance->refresh_scheduler->batch_sas_token_signing` is TRUE and device keys are used, authentication_do_work() shall queue `instance` on `instance->refresh_scheduler->pending_sas_tokens` instead of creating the SAS token]
+            if (is_sas_token_signing_batched(instance))
             {
-                LogError("Failed authenticating device '%s' using device keys", instance->device_id);
+                queue_pending_sas_token(instance);
             }
-
-            if (!instance->is_cbs_put_token_in_progress)
+            else
             {
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_061: [If cbs_put_token() fails, `instance->state` shall be updated to AUTHENTICATION_STATE_ERROR and `instance->on_state_changed_callback` invoked]
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_121: [If cbs_put_token() fails, `instance->state` shall be updated to AUTHENTICATION_STATE_ERROR and `instance->on_state_changed_callback` invoked]
-                update_state(instance, AUTHENTICATION_STATE_ERROR);
-
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_062: [If cbs_put_token() fails, `instance->on_error_callback` shall be invoked with AUTHENTICATION_ERROR_AUTH_FAILED]
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_122: [If cbs_put_token() fails, `instance->on_error_callback` shall be invoked with AUTHENTICATION_ERROR_AUTH_FAILED]
-                notify_error(instance, AUTHENTICATION_ERROR_AUTH_FAILED);
+                create_and_put_SAS_token_or_fail(instance);
             }
         }
         else
@@ -781,3 +982,100 @@ OPTIONHANDLER_HANDLE authentication_retrieve_options(AUTHENTICATION_HANDLE authe
     }
     return result;
 }
+
+void authentication_sign_pending_sas_tokens(AUTHENTICATION_REFRESH_SCHEDULER* refresh_scheduler)
+{
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_137: [If `refresh_scheduler` is NULL, authentication_sign_pending_sas_tokens() shall return]
+    if (refresh_scheduler == NULL)
+    {
+        LogError("authentication_sign_pending_sas_tokens failed (refresh_scheduler is NULL)");
+    }
+    else if (refresh_scheduler->pending_sas_tokens != NULL)
+    {
+        AUTHENTICATION_INSTANCE* pending = refresh_scheduler->pending_sas_tokens;
+        AUTHENTICATION_INSTANCE* instance;
+        IOTHUB_SAS_TOKEN_REQUEST* requests;
+        PENDING_SAS_TOKEN* pending_tokens;
+        size_t pending_count = 0;
+        size_t request_count = 0;
+        size_t index;
+
+        // The instances are taken off the list up front, so the callbacks invoked below cannot change it under us.
+        refresh_scheduler->pending_sas_tokens = NULL;
+
+        for (instance = pending; instance != NULL; instance = instance->next_pending_sas_token)
+        {
+            pending_count++;
+        }
+
+        requests = (IOTHUB_SAS_TOKEN_REQUEST*)calloc(pending_count, sizeof(IOTHUB_SAS_TOKEN_REQUEST));
+        pending_tokens = (PENDING_SAS_TOKEN*)calloc(pending_count, sizeof(PENDING_SAS_TOKEN));
+
+        while (pending != NULL)
+        {
+            instance = pending;
+            pending = instance->next_pending_sas_token;
+            instance->next_pending_sas_token = NULL;
+            instance->is_sas_token_pending = false;
+
+            if (requests == NULL || pending_tokens == NULL)
+            {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_141: [If the batch cannot be allocated, each pending SAS token shall be created and put to CBS as in authentication_do_work()]
+                create_and_put_SAS_token_or_fail(instance);
+            }
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_138: [authentication_sign_pending_sas_tokens() shall create the `devices_and_modules_path` of each pending instance and sign all their SAS tokens with a single call to IoTHubClient_Auth_Get_SasToken_Batch]
+            else if ((pending_tokens[request_count].devices_and_modules_path = create_device_and_module_path(instance->iothub_host_fqdn, instance->device_id, instance->module_id)) == NULL)
+            {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_140: [If a SAS token cannot be created or put to CBS, `instance->state` shall be updated to AUTHENTICATION_STATE_ERROR and `instance->on_error_callback` invoked as in authentication_do_work()]
+                LogError("Failed creating a SAS token (create_device_and_module_path() failed)");
+                fail_sas_token_put(instance);
+            }
+            else
+            {
+                pending_tokens[request_count].instance = instance;
+                requests[request_count].handle = instance->authorization_module;
+                requests[request_count].scope = STRING_c_str(pending_tokens[request_count].devices_and_modules_path);
+                request_count++;
+            }
+        }
+
+        if (request_count > 0)
+        {
+            if (IoTHubClient_Auth_Get_SasToken_Batch(requests, request_count) != 0)
+            {
+                LogError("Failed signing %lu SAS tokens", (unsigned long)request_count);
+            }
+
+            for (index = 0; index < request_count; index++)
+            {
+                instance = pending_tokens[index].instance;
+
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_139: [Each SAS token shall be put to CBS as in authentication_do_work()]
+                if (requests[index].sas_token == NULL)
+                {
+                    LogError("Failed creating the SAS token of device '%s'", instance->device_id);
+                }
+                else
+                {
+                    if (put_SAS_token_to_cbs(instance, pending_tokens[index].devices_and_modules_path, requests[index].sas_token) != RESULT_OK)
+                    {
+                        LogError("Failed putting SAS token to CBS");
+                    }
+
+                    free(requests[index].sas_token);
+                }
+
+                if (!instance->is_cbs_put_token_in_progress)
+                {
+                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_140: [If a SAS token cannot be created or put to CBS, `instance->state` shall be updated to AUTHENTICATION_STATE_ERROR and `instance->on_error_callback` invoked as in authentication_do_work()]
+                    fail_sas_token_put(instance);
+                }
+
+                STRING_delete(pending_tokens[index].devices_and_modules_path);
+            }
+        }
+
+        free(requests);
+        free(pending_tokens);
+    }
+}
@@ -8,6 +8,7 @@
 #include <limits.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
@@ -34,6 +35,7 @@
 #include "internal/iothubtransport_amqp_common.h"
 #include "internal/iothubtransport_amqp_connection.h"
 #include "internal/iothubtransport_amqp_device.h"
+#include "internal/iothubtransport_amqp_cbs_auth.h"
 #include "internal/iothubtransport.h"
 #include "iothub_client_version.h"
 #include "internal/iothub_transport_ll_private.h"
@@ -51,6 +53,11 @@
 // DEFAULT_MAX_RETRY_TIME_IN_SECS = 0 means infinite retry.
 #define DEFAULT_MAX_RETRY_TIME_IN_SECS            0
 #define MAX_SERVICE_KEEP_ALIVE_RATIO              0.9
+#define DEVICE_INDEX_INITIAL_BUCKET_COUNT         16
+#define DEVICE_INDEX_MAX_LOAD_FACTOR              2
+#define FNV_32_OFFSET_BASIS                       2166136261u
+#define FNV_32_PRIME                              16777619u
+#define DEFAULT_AMQP_SESSION_COUNT                1
 
 // ---------- Data Definitions ---------- //
 
@@ -103,6 +110,9 @@ typedef struct AMQP_TRANSPORT_INSTANCE_TAG
     AMQP_CONNECTION_STATE amqp_connection_state;                        // Current state of the amqp_connection.
     AMQP_TRANSPORT_AUTHENTICATION_MODE preferred_authentication_mode;   // Used to avoid registered devices using different authentication modes.
     SINGLYLINKEDLIST_HANDLE registered_devices;                         // List of devices currently registered in this transport.
+    struct AMQP_TRANSPORT_DEVICE_INSTANCE_TAG** device_index_buckets;   // Hash index of the registered devices by device id (chained buckets).
+    size_t device_index_bucket_count;                                   // Number of buckets in `device_index_buckets`.
+    size_t device_index_count;                                          // Number of devices currently in `device_index_buckets`.
     bool is_trace_on;                                                   // Turns logging on and off.
     OPTIONHANDLER_HANDLE saved_tls_options;                             // Here are the options from the xio layer if any is saved.
     AMQP_TRANSPORT_STATE state;                                         // Current state of the transport.
@@ -117,6 +127,13 @@ typedef struct AMQP_TRANSPORT_INSTANCE_TAG
 
     size_t option_cbs_request_timeout_secs;                             // Device-specific option.
     size_t option_send_event_timeout_secs;                              // Device-specific option.
+    size_t option_event_send_batch_linger_ms;                           // Device-specific option.
+    size_t option_event_send_batch_min_bytes;                           // Device-specific option.
+    size_t option_idle_device_do_work_interval_secs;                    // Maximum time an idle device can go without a device-specific do_work (0 means never skip).
+    size_t option_amqp_session_count;                                   // Number of AMQP sessions the registered devices are sharded across.
+    uint32_t option_amqp_session_incoming_window;                       // AMQP session incoming window (0 means the amqp_connection default).
+    uint32_t option_amqp_session_outgoing_window;                       // AMQP session outgoing window (0 means the amqp_connection default).
+    AUTHENTICATION_REFRESH_SCHEDULER sas_token_refresh_scheduler;       // Staggers and bounds the CBS SAS token refreshes of all registered devices.
 
                                                                         // Auth module used to generating handle authorization
     IOTHUB_AUTHORIZATION_HANDLE authorization_module;                   // with either SAS Token, x509 Certs, and Device SAS Token
@@ -128,6 +145,10 @@ typedef struct AMQP_TRANSPORT_INSTANCE_TAG
 typedef struct AMQP_TRANSPORT_DEVICE_INSTANCE_TAG
 {
     STRING_HANDLE device_id;                                            // Identity of the device.
+    char* module_id;                                                    // Identity of the module, or NULL if the client is a device.
+    uint32_t device_id_hash;                                            // Hash of `device_id` and `module_id`, used by the transport device index.
+    struct AMQP_TRANSPORT_DEVICE_INSTANCE_TAG* next_in_index_bucket;    // Next device in the same bucket of the transport device index.
+    LIST_ITEM_HANDLE registered_devices_item;                           // Item of the device in the transport registered_devices list, used to unregister it.
     AMQP_DEVICE_HANDLE device_handle;                                   // Logic unit that performs authentication, messaging, etc.
     AMQP_TRANSPORT_INSTANCE* transport_instance;                        // Saved reference to the transport the device is registered on.
     PDLIST_ENTRY waiting_to_send;                                       // List of events waiting to be sent to the iot hub (i.e., haven't been processed by the transport yet).
@@ -136,6 +157,8 @@ typedef struct AMQP_TRANSPORT_DEVICE_INSTANCE_TAG
     size_t number_of_send_event_complete_failures;                      // Number of times on_event_send_complete was called in row with an error.
     time_t time_of_last_state_change;                                   // Time the device_handle last changed state; used to track timeouts of amqp_device_start_async and amqp_device_stop.
     unsigned int max_state_change_timeout_secs;                         // Maximum number of seconds allowed for device_handle to complete start and stop state changes.
+    time_t time_of_last_do_work;                                        // Time the device-specific do_work was last invoked; only tracked if idle devices can be skipped.
+    bool is_do_work_requested;                                          // Set when an API call queued work that must not wait for the idle device interval.
     // the methods portion
     IOTHUBTRANSPORT_AMQP_METHODS_HANDLE methods_handle;                 // Handle to instance of module that deals with device methods for AMQP.
     // is subscription for methods needed?
@@ -238,6 +261,11 @@ static void internal_destroy_amqp_device_instance(AMQP_TRANSPORT_DEVICE_INSTANCE
         STRING_delete(trdev_inst->device_id);
     }
 
+    if (trdev_inst->module_id != NULL)
+    {
+        free(trdev_inst->module_id);
+    }
+
     free(trdev_inst);
 }
 
@@ -314,62 +342,222 @@ static void on_device_state_changed_callback(void* context, DEVICE_STATE previou
     }
 }
 
-// @brief    Auxiliary function to be used to find a device in the registered_devices list.
-// @returns  true if the device ids match, false otherwise.
-static bool find_device_by_id_callback(LIST_ITEM_HANDLE list_item, const void* match_context)
+static size_t get_number_of_registered_devices(AMQP_TRANSPORT_INSTANCE* transport)
+{
+    size_t result = 0;
+
+    LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(transport->registered_devices);
+
+    while (list_item != NULL)
+    {
+        result++;
+        list_item = singlylinkedlist_get_next_item(list_item);
+    }
+
+    return result;
+}
+
+static uint32_t add_to_fnv_hash(uint32_t hash, const char* value)
+{
+    while (*value != '\0')
+    {
+        hash ^= (unsigned char)(*value);
+        hash *= FNV_32_PRIME;
+        value++;
+    }
+
+    return hash;
+}
+
+// @brief    FNV-1a hash of a device id and optional module id, used to place devices in the transport device index.
+// @remarks  A device without module id hashes the same as its device id alone.
+static uint32_t get_device_id_hash(const char* device_id, const char* module_id)
+{
+    uint32_t hash = add_to_fnv_hash(FNV_32_OFFSET_BASIS, device_id);
+
+    if (module_id != NULL)
+    {
+        hash = add_to_fnv_hash(hash, "/");
+        hash = add_to_fnv_hash(hash, module_id);
+    }
+
+    return hash;
+}
+
+static bool are_module_ids_equal(const char* module_id_1, const char* module_id_2)
 {
     bool result;
 
-    if (match_context == NULL)
+    if (module_id_1 == NULL || module_id_2 == NULL)
     {
-        result = false;
+        result = (module_id_1 == module_id_2);
     }
     else
     {
-        AMQP_TRANSPORT_DEVICE_INSTANCE* device_instance = (AMQP_TRANSPORT_DEVICE_INSTANCE*)singlylinkedlist_item_get_value(list_item);
-
-        if (device_instance == NULL ||
-            device_instance->device_id == NULL ||
-            STRING_c_str(device_instance->device_id) != match_context)
-        {
-            result = false;
-        }
-        else
-        {
-            result = true;
-        }
+        result = (strcmp(module_id_1, module_id_2) == 0);
     }
 
     return result;
 }
 
-// @brief       Verifies if a device is already registered within the transport that owns the list of registered devices.
-// @remarks     Returns the correspoding LIST_ITEM_HANDLE in registered_devices, if found.
-// @returns     true if the device is already in the list, false otherwise.
-static bool is_device_registered_ex(SINGLYLINKEDLIST_HANDLE registered_devices, const char* device_id, LIST_ITEM_HANDLE *list_item)
+// @brief    Looks up a registered device by its device id and module id using the transport device index.
+// @returns  The registered device instance, or NULL if no device with those ids is registered.
+static AMQP_TRANSPORT_DEVICE_INSTANCE* find_device_in_index(AMQP_TRANSPORT_INSTANCE* transport, const char* device_id, const char* module_id, uint32_t device_id_hash)
 {
-    return ((*list_item = singlylinkedlist_find(registered_devices, find_device_by_id_callback, device_id)) != NULL ? 1 : 0);
+    AMQP_TRANSPORT_DEVICE_INSTANCE* result = transport->device_index_buckets[device_id_hash % transport->device_index_bucket_count];
+
+    while (result != NULL &&
+        (result->device_id_hash != device_id_hash ||
+         strcmp(STRING_c_str(result->device_id), device_id) != 0 ||
+         !are_module_ids_equal(result->module_id, module_id)))
+    {
+        result = result->next_in_index_bucket;
+    }
+
+    return result;
 }
 
-// @brief       Verifies if a device is already registered within the transport that owns the list of registered devices.
-// @returns     true if the device is already in the list, false otherwise.
+// @brief       Verifies if a device is registered within the transport it references, using the transport device index.
+// @returns     true if the device is registered, false otherwise.
 static bool is_device_registered(AMQP_TRANSPORT_DEVICE_INSTANCE* amqp_device_instance)
 {
-    LIST_ITEM_HANDLE list_item;
     const char* device_id = STRING_c_str(amqp_device_instance->device_id);
-    return is_device_registered_ex(amqp_device_instance->transport_instance->registered_devices, device_id, &list_item);
+
+    return (device_id != NULL &&
+        find_device_in_index(amqp_device_instance->transport_instance, device_id, amqp_device_instance->module_id, amqp_device_instance->device_id_hash) == amqp_device_instance);
 }
 
-static size_t get_number_of_registered_devices(AMQP_TRANSPORT_INSTANCE* transport)
+// @brief    Doubles the number of buckets of the transport device index.
+// @remarks  If the new buckets cannot be allocated the index keeps working with longer chains.
+static void grow_device_index(AMQP_TRANSPORT_INSTANCE* transport)
 {
-    size_t result = 0;
+    size_t new_bucket_count = transport->device_index_bucket_count * 2;
+    AMQP_TRANSPORT_DEVICE_INSTANCE** new_buckets;
 
-    LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(transport->registered_devices);
+    if ((new_buckets = (AMQP_TRANSPORT_DEVICE_INSTANCE**)malloc(new_bucket_count * sizeof(AMQP_TRANSPORT_DEVICE_INSTANCE*))) == NULL)
+    {
+        LogError("Failed growing the registered devices index to %lu buckets (malloc failed)", (unsigned long)new_bucket_count);
+    }
+    else
+    {
+        size_t i;
 
-    while (list_item != NULL)
+        memset(new_buckets, 0, new_bucket_count * sizeof(AMQP_TRANSPORT_DEVICE_INSTANCE*));
+
+        for (i = 0; i < transport->device_index_bucket_count; i++)
+        {
+            AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = transport->device_index_buckets[i];
+
+            while (registered_device != NULL)
+            {
+                AMQP_TRANSPORT_DEVICE_INSTANCE* next_device = registered_device->next_in_index_bucket;
+                size_t new_bucket = registered_device->device_id_hash % new_bucket_count;
+
+                registered_device->next_in_index_bucket = new_buckets[new_bucket];
+                new_buckets[new_bucket] = registered_device;
+                registered_device = next_device;
+            }
+        }
+
+        free(transport->device_index_buckets);
+        transport->device_index_buckets = new_buckets;
+        transport->device_index_bucket_count = new_bucket_count;
+    }
+}
+
+static void add_device_to_index(AMQP_TRANSPORT_INSTANCE* transport, AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device)
+{
+    size_t bucket;
+
+    if (transport->device_index_count >= transport->device_index_bucket_count * DEVICE_INDEX_MAX_LOAD_FACTOR)
     {
-        result++;
-        list_item = singlylinkedlist_get_next_item(list_item);
+        grow_device_index(transport);
+    }
+
+    bucket = registered_device->device_id_hash % transport->device_index_bucket_count;
+    registered_device->next_in_index_bucket = transport->device_index_buckets[bucket];
+    transport->device_index_buckets[bucket] = registered_device;
+    transport->device_index_count++;
+}
+
+static void remove_device_from_index(AMQP_TRANSPORT_INSTANCE* transport, AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device)
+{
+    AMQP_TRANSPORT_DEVICE_INSTANCE** link = &transport->device_index_buckets[registered_device->device_id_hash % transport->device_index_bucket_count];
+
+    while (*link != NULL && *link != registered_device)
+    {
+        link = &(*link)->next_in_index_bucket;
+    }
+
+    if (*link != NULL)
+    {
+        *link = registered_device->next_in_index_bucket;
+        registered_device->next_in_index_bucket = NULL;
+        transport->device_index_count--;
+    }
+}
+
+// @brief    Flags a device so the next IoTHubTransport_AMQP_Common_DoWork does not skip it as idle.
+static void request_device_do_work(AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device)
+{
+    registered_device->is_do_work_requested = true;
+}
+
+// @brief    Gets the AMQP session a device shall use.
+// @remarks  If OPTION_AMQP_SESSION_COUNT is greater than 1, devices are spread across the sessions by their device id hash.
+static int get_device_session_handle(AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device, SESSION_HANDLE* session_handle)
+{
+    int result;
+    AMQP_TRANSPORT_INSTANCE* transport_instance = registered_device->transport_instance;
+
+    if (transport_instance->option_amqp_session_count > 1)
+    {
+        result = amqp_connection_get_shard_session_handle(transport_instance->amqp_connection, (size_t)registered_device->device_id_hash, session_handle);
+    }
+    else
+    {
+        result = amqp_connection_get_session_handle(transport_instance->amqp_connection, session_handle);
+    }
+
+    return result;
+}
+
+// @brief    Verifies if the device-specific do_work can be skipped on this IoTHubTransport_AMQP_Common_DoWork call.
+// @remarks  Only applies if OPTION_IDLE_DEVICE_DO_WORK_INTERVAL_SECS is set. A started device is idle if it has no events
+//           waiting to be sent or in flight, no requested work and its last do_work ran less than that interval ago.
+// @returns  true if the device is idle, false otherwise.
+static bool is_device_idle(AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device)
+{
+    bool result;
+    size_t interval_secs = registered_device->transport_instance->option_idle_device_do_work_interval_secs;
+
+    if (interval_secs == 0 ||
+        registered_device->device_state != DEVICE_STATE_STARTED ||
+        registered_device->is_do_work_requested ||
+        (registered_device->subscribe_methods_needed && !registered_device->subscribed_for_methods) ||
+        !DList_IsListEmpty(registered_device->waiting_to_send))
+    {
+        result = false;
+    }
+    else
+    {
+        DEVICE_SEND_STATUS send_status;
+        bool is_timed_out;
+
+        if (amqp_device_get_send_status(registered_device->device_handle, &send_status) != RESULT_OK ||
+            send_status != DEVICE_SEND_STATUS_IDLE)
+        {
+            result = false;
+        }
+        else if (is_timeout_reached(registered_device->time_of_last_do_work, (unsigned int)interval_secs, &is_timed_out) != RESULT_OK ||
+            is_timed_out)
+        {
+            result = false;
+        }
+        else
+        {
+            result = true;
+        }
     }
 
     return result;
@@ -534,7 +722,7 @@ static int subscribe_methods(AMQP_TRANSPORT_DEVICE_INSTANCE* deviceState)
     {
         SESSION_HANDLE session_handle;
 
-        if ((amqp_connection_get_session_handle(deviceState->transport_instance->amqp_connection, &session_handle)) != RESULT_OK)
+        if (get_device_session_handle(deviceState, &session_handle) != RESULT_OK)
         {
             LogError("Device '%s' failed subscribing for methods (failed getting session handle)", STRING_c_str(deviceState->device_id));
             result = MU_FAILURE;
@@ -825,6 +1013,10 @@ static int establish_amqp_connection(AMQP_TRANSPORT_INSTANCE* transport_instance
         amqp_connection_config.svc2cl_keep_alive_timeout_secs = transport_instance->svc2cl_keep_alive_timeout_secs;
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_99_001: [AMQP connection will be configured using the `remote_idle_timeout_ratio` value from SetOption ]
         amqp_connection_config.cl2svc_keep_alive_send_ratio = transport_instance->cl2svc_keep_alive_send_ratio;
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_167: [AMQP connection will be configured using the session count and window sizes set with SetOption]
+        amqp_connection_config.session_count = transport_instance->option_amqp_session_count;
+        amqp_connection_config.session_incoming_window = transport_instance->option_amqp_session_incoming_window;
+        amqp_connection_config.session_outgoing_window = transport_instance->option_amqp_session_outgoing_window;
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_027: [If `transport->preferred_authentication_method` is CBS, AMQP_CONNECTION_CONFIG shall be set with `create_sasl_io` = true and `create_cbs_connection` = true]
         if (transport_instance->preferred_authentication_mode == AMQP_TRANSPORT_AUTHENTICATION_MODE_CBS)
@@ -1095,7 +1287,8 @@ static int IoTHubTransport_AMQP_Common_Device_DoWork(AMQP_TRANSPORT_DEVICE_INSTA
             CBS_HANDLE cbs_handle = NULL;
 
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_039: [amqp_connection_get_session_handle() shall be invoked on `instance->connection`]
-            if (amqp_connection_get_session_handle(registered_device->transport_instance->amqp_connection, &session_handle) != RESULT_OK)
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_166: [If OPTION_AMQP_SESSION_COUNT is greater than 1, amqp_connection_get_shard_session_handle() shall be invoked instead, passing the device id hash as shard key]
+            if (get_device_session_handle(registered_device, &session_handle) != RESULT_OK)
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_040: [If amqp_connection_get_session_handle() fails, IoTHubTransport_AMQP_Common_DoWork shall fail and return]
                 LogError("Failed performing DoWork for device '%s' (failed to get the amqp_connection session_handle)", STRING_c_str(registered_device->device_id));
@@ -1217,6 +1410,25 @@ static int replicate_device_options_to(AMQP_TRANSPORT_DEVICE_INSTANCE* dev_insta
         LogError("Failed to apply option DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS to device '%s' (amqp_device_set_option failed)", STRING_c_str(dev_instance->device_id));
         result = MU_FAILURE;
     }
+    // Batching options are only replicated if they were set, since they are disabled by default on the device.
+    else if (dev_instance->transport_instance->option_event_send_batch_linger_ms != 0 &&
+        amqp_device_set_option(
+            dev_instance->device_handle,
+            DEVICE_OPTION_EVENT_SEND_BATCH_LINGER_MS,
+            &dev_instance->transport_instance->option_event_send_batch_linger_ms) != RESULT_OK)
+    {
+        LogError("Failed to apply option DEVICE_OPTION_EVENT_SEND_BATCH_LINGER_MS to device '%s' (amqp_device_set_option failed)", STRING_c_str(dev_instance->device_id));
+        result = MU_FAILURE;
+    }
+    else if (dev_instance->transport_instance->option_event_send_batch_min_bytes != 0 &&
+        amqp_device_set_option(
+            dev_instance->device_handle,
+            DEVICE_OPTION_EVENT_SEND_BATCH_MIN_BYTES,
+            &dev_instance->transport_instance->option_event_send_batch_min_bytes) != RESULT_OK)
+    {
+        LogError("Failed to apply option DEVICE_OPTION_EVENT_SEND_BATCH_MIN_BYTES to device '%s' (amqp_device_set_option failed)", STRING_c_str(dev_instance->device_id));
+        result = MU_FAILURE;
+    }
     else if (auth_mode == DEVICE_AUTH_MODE_CBS)
     {
         if (amqp_device_set_option(
@@ -1254,6 +1466,14 @@ static const char* get_device_option_name_from(const char* iothubclient_option_n
     {
         device_option_name = DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS;
     }
+    else if (strcmp(OPTION_EVENT_SEND_BATCH_LINGER_MS, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_EVENT_SEND_BATCH_LINGER_MS;
+    }
+    else if (strcmp(OPTION_EVENT_SEND_BATCH_MIN_BYTES, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_EVENT_SEND_BATCH_MIN_BYTES;
+    }
     else
     {
         device_option_name = NULL;
@@ -1342,6 +1562,12 @@ static void internal_destroy_instance(AMQP_TRANSPORT_INSTANCE* instance)
         /* SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_043: [ `IoTHubTransport_AMQP_Common_Destroy` shall free the stored proxy options. ]*/
         free_proxy_data(instance);
 
+        if (instance->sas_token_refresh_scheduler.tick_counter != NULL)
+        {
+            tickcounter_destroy(instance->sas_token_refresh_scheduler.tick_counter);
+        }
+
+        free(instance->device_index_buckets);
         free(instance);
     }
 }
@@ -1441,8 +1667,25 @@ TRANSPORT_LL_HANDLE IoTHubTransport_AMQP_Common_Create(const IOTHUBTRANSPORT_CON
                 LogError("Failed to initialize the internal list of registered devices (singlylinkedlist_create failed)");
                 result = NULL;
             }
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_160: [`instance->device_index_buckets` shall be allocated with DEVICE_INDEX_INITIAL_BUCKET_COUNT empty buckets]
+            else if ((instance->device_index_buckets = (AMQP_TRANSPORT_DEVICE_INSTANCE**)malloc(DEVICE_INDEX_INITIAL_BUCKET_COUNT * sizeof(AMQP_TRANSPORT_DEVICE_INSTANCE*))) == NULL)
+            {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_161: [If the device index fails to be allocated, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
+                LogError("Failed to initialize the index of registered devices (malloc failed)");
+                result = NULL;
+            }
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_181: [`instance->sas_token_refresh_scheduler.tick_counter` shall be set using tickcounter_create()]
+            else if ((instance->sas_token_refresh_scheduler.tick_counter = tickcounter_create()) == NULL)
+            {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_182: [If tickcounter_create() fails, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
+                LogError("Failed to create the tick counter of the SAS token refreshes");
+                result = NULL;
+            }
             else
             {
+                memset(instance->device_index_buckets, 0, DEVICE_INDEX_INITIAL_BUCKET_COUNT * sizeof(AMQP_TRANSPORT_DEVICE_INSTANCE*));
+                instance->device_index_bucket_count = DEVICE_INDEX_INITIAL_BUCKET_COUNT;
+
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_010: [`get_io_transport` shall be saved on `instance->underlying_io_transport_provider`]
                 instance->underlying_io_transport_provider = get_io_transport;
                 instance->is_trace_on = false;
@@ -1452,6 +1695,7 @@ TRANSPORT_LL_HANDLE IoTHubTransport_AMQP_Common_Create(const IOTHUBTRANSPORT_CON
                 instance->svc2cl_keep_alive_timeout_secs = DEFAULT_SERVICE_KEEP_ALIVE_FREQ_SECS;
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_99_001: [The remote idle timeout ratio shall be set to 0.5 using connection_set_remote_idle_timeout_empty_frame_send_ratio()]
                 instance->cl2svc_keep_alive_send_ratio = DEFAULT_REMOTE_IDLE_PING_RATIO;
+                instance->option_amqp_session_count = DEFAULT_AMQP_SESSION_COUNT;
 
                 instance->transport_ctx = ctx;
                 instance->transport_callbacks.msg_input_cb = cb_info->msg_input_cb;
@@ -1522,6 +1766,8 @@ IOTHUB_PROCESS_ITEM_RESULT IoTHubTransport_AMQP_Common_ProcessItem(TRANSPORT_LL_
                 }
                 else
                 {
+                    request_device_do_work(registered_device);
+
                     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_150: [If no errors occur, `IoTHubTransport_AMQP_Common_ProcessItem` shall return IOTHUB_PROCESS_OK.]
                     result = IOTHUB_PROCESS_OK;
                 }
@@ -1610,19 +1856,40 @@ void IoTHubTransport_AMQP_Common_DoWork(TRANSPORT_LL_HANDLE handle)
 
                             update_state(transport_instance, AMQP_TRANSPORT_STATE_RECONNECTION_REQUIRED);
                         }
-                        else if (IoTHubTransport_AMQP_Common_Device_DoWork(registered_device) != RESULT_OK)
+                        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_164: [If OPTION_IDLE_DEVICE_DO_WORK_INTERVAL_SECS is set, the device-specific do_work shall be skipped for started devices with no pending work whose last do_work ran within that interval]
+                        else if (is_device_idle(registered_device))
                         {
-                            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_021: [If DoWork fails for the registered device for more than MAX_NUMBER_OF_DEVICE_FAILURES, connection retry shall be triggered]
-                            if (registered_device->number_of_previous_failures >= MAX_NUMBER_OF_DEVICE_FAILURES)
+                            // Nothing to be done for this device on this call.
+                        }
+                        else
+                        {
+                            if (IoTHubTransport_AMQP_Common_Device_DoWork(registered_device) != RESULT_OK)
                             {
-                                LogError("Device '%s' reported a critical failure; connection retry will be triggered.", STRING_c_str(registered_device->device_id));
+                                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_021: [If DoWork fails for the registered device for more than MAX_NUMBER_OF_DEVICE_FAILURES, connection retry shall be triggered]
+                                if (registered_device->number_of_previous_failures >= MAX_NUMBER_OF_DEVICE_FAILURES)
+                                {
+                                    LogError("Device '%s' reported a critical failure; connection retry will be triggered.", STRING_c_str(registered_device->device_id));
+
+                                    update_state(transport_instance, AMQP_TRANSPORT_STATE_RECONNECTION_REQUIRED);
+                                }
+                            }
 
-                                update_state(transport_instance, AMQP_TRANSPORT_STATE_RECONNECTION_REQUIRED);
+                            if (transport_instance->option_idle_device_do_work_interval_secs != 0)
+                            {
+                                registered_device->time_of_last_do_work = get_time(NULL);
                             }
+
+                            registered_device->is_do_work_requested = false;
                         }
 
                         list_item = singlylinkedlist_get_next_item(list_item);
                     }
+
+                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_179: [If OPTION_SAS_TOKEN_BATCH_SIGNING is set, the SAS tokens queued by the device-specific do_work calls shall be signed together with authentication_sign_pending_sas_tokens()]
+                    if (transport_instance->sas_token_refresh_scheduler.batch_sas_token_signing)
+                    {
+                        authentication_sign_pending_sas_tokens(&transport_instance->sas_token_refresh_scheduler);
+                    }
                 }
             }
 
@@ -1664,6 +1931,8 @@ int IoTHubTransport_AMQP_Common_Subscribe(IOTHUB_DEVICE_HANDLE handle)
         }
         else
         {
+            request_device_do_work(amqp_device_instance);
+
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_088: [If no failures occur, IoTHubTransport_AMQP_Common_Subscribe shall return 0]
             result = RESULT_OK;
         }
@@ -1693,6 +1962,10 @@ void IoTHubTransport_AMQP_Common_Unsubscribe(IOTHUB_DEVICE_HANDLE handle)
         {
             LogError("Device '%s' failed unsubscribing to cloud-to-device messages (amqp_device_unsubscribe_message failed)", STRING_c_str(amqp_device_instance->device_id));
         }
+        else
+        {
+            request_device_do_work(amqp_device_instance);
+        }
     }
 }
 
@@ -1741,6 +2014,9 @@ int IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE handle
                     break;
                 }
 
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_177: [If amqp_device_subscribe_for_twin_updates() succeeds, the next IoTHubTransport_AMQP_Common_DoWork shall not skip the device as idle]
+                request_device_do_work(registered_device);
+
                 list_item = singlylinkedlist_get_next_item(list_item);
             }
         }
@@ -1785,6 +2061,9 @@ void IoTHubTransport_AMQP_Common_Unsubscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE han
                     break;
                 }
 
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_178: [If amqp_device_unsubscribe_for_twin_updates() succeeds, the next IoTHubTransport_AMQP_Common_DoWork shall not skip the device as idle]
+                request_device_do_work(registered_device);
+
                 list_item = singlylinkedlist_get_next_item(list_item);
             }
         }
@@ -1836,6 +2115,8 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_GetTwinAsync(IOTHUB_DEVICE_HAND
                 }
                 else
                 {
+                    request_device_do_work(registered_device);
+
                     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_157: [ If no errors occur, `IoTHubTransport_AMQP_Common_GetTwinAsync` shall return IOTHUB_CLIENT_OK ]
                     result = IOTHUB_CLIENT_OK;
                 }
@@ -1998,6 +2279,16 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SetOption(TRANSPORT_LL_HANDLE h
             is_device_specific_option = true;
             transport_instance->option_send_event_timeout_secs = *(size_t*)value;
         }
+        else if (strcmp(OPTION_EVENT_SEND_BATCH_LINGER_MS, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_event_send_batch_linger_ms = *(size_t*)value;
+        }
+        else if (strcmp(OPTION_EVENT_SEND_BATCH_MIN_BYTES, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_event_send_batch_min_bytes = *(size_t*)value;
+        }
         else
         {
             is_device_specific_option = false;
@@ -2045,6 +2336,75 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SetOption(TRANSPORT_LL_HANDLE h
             transport_instance->svc2cl_keep_alive_timeout_secs = *(size_t*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_165: [If `option` is OPTION_IDLE_DEVICE_DO_WORK_INTERVAL_SECS, `value` shall be saved as the maximum interval idle devices can go without a device-specific do_work]
+        else if (strcmp(OPTION_IDLE_DEVICE_DO_WORK_INTERVAL_SECS, option) == 0)
+        {
+            transport_instance->option_idle_device_do_work_interval_secs = *(size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_168: [If `option` is OPTION_AMQP_SESSION_COUNT, `value` shall be saved as the number of AMQP sessions used on the next connection]
+        else if (strcmp(OPTION_AMQP_SESSION_COUNT, option) == 0)
+        {
+            if (*(size_t*)value == 0)
+            {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_169: [If OPTION_AMQP_SESSION_COUNT or a session window size is zero, IoTHubTransport_AMQP_Common_SetOption shall fail and return IOTHUB_CLIENT_INVALID_ARG]
+                LogError("Invalid AMQP session count (zero)");
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                transport_instance->option_amqp_session_count = *(size_t*)value;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_171: [If `option` is OPTION_SAS_TOKEN_REFRESH_SPREAD_SECS, `value` shall be saved as the window the SAS token refreshes of the registered devices are spread across]
+        else if (strcmp(OPTION_SAS_TOKEN_REFRESH_SPREAD_SECS, option) == 0)
+        {
+            transport_instance->sas_token_refresh_scheduler.refresh_spread_secs = *(size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_172: [If `option` is OPTION_MAX_CONCURRENT_SAS_TOKEN_REFRESHES, `value` shall be saved as the maximum number of SAS token refreshes in progress at a time]
+        else if (strcmp(OPTION_MAX_CONCURRENT_SAS_TOKEN_REFRESHES, option) == 0)
+        {
+            transport_instance->sas_token_refresh_scheduler.max_concurrent_refreshes = *(size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_180: [If `option` is OPTION_SAS_TOKEN_BATCH_SIGNING, `value` shall be saved as whether the SAS tokens of the registered devices are signed together]
+        else if (strcmp(OPTION_SAS_TOKEN_BATCH_SIGNING, option) == 0)
+        {
+            transport_instance->sas_token_refresh_scheduler.batch_sas_token_signing = *(bool*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_173: [If `option` is OPTION_SAS_TOKEN_REFRESH_METRICS, the IOTHUB_SAS_TOKEN_REFRESH_METRICS pointed to by `value` shall be set with the SAS token refresh metrics of all devices registered on the transport]
+        else if (strcmp(OPTION_SAS_TOKEN_REFRESH_METRICS, option) == 0)
+        {
+            *(IOTHUB_SAS_TOKEN_REFRESH_METRICS*)value = transport_instance->sas_token_refresh_scheduler.metrics;
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_170: [If `option` is OPTION_AMQP_SESSION_INCOMING_WINDOW or OPTION_AMQP_SESSION_OUTGOING_WINDOW, `value` shall be saved as the respective window size of the AMQP sessions created on the next connection]
+        else if ((strcmp(OPTION_AMQP_SESSION_INCOMING_WINDOW, option) == 0) || (strcmp(OPTION_AMQP_SESSION_OUTGOING_WINDOW, option) == 0))
+        {
+            size_t window_size = *(size_t*)value;
+
+            if (window_size == 0 || window_size > UINT32_MAX)
+            {
+                LogError("Invalid AMQP session window size (%lu)", (unsigned long)window_size);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                if (strcmp(OPTION_AMQP_SESSION_INCOMING_WINDOW, option) == 0)
+                {
+                    transport_instance->option_amqp_session_incoming_window = (uint32_t)window_size;
+                }
+                else
+                {
+                    transport_instance->option_amqp_session_outgoing_window = (uint32_t)window_size;
+                }
+
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
         else if (strcmp(OPTION_REMOTE_IDLE_TIMEOUT_RATIO, option) == 0)
         {
 
@@ -2225,11 +2585,12 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
     }
     else
     {
-        LIST_ITEM_HANDLE list_item;
         AMQP_TRANSPORT_INSTANCE* transport_instance = (AMQP_TRANSPORT_INSTANCE*)handle;
+        uint32_t device_id_hash = get_device_id_hash(device->deviceId, device->moduleId);
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_064: [If the device is already registered, IoTHubTransport_AMQP_Common_Register shall fail and return NULL.]
-        if (is_device_registered_ex(transport_instance->registered_devices, device->deviceId, &list_item))
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_183: [A device is considered already registered only if both its `deviceId` and `moduleId` match a registered device.]
+        if (find_device_in_index(transport_instance, device->deviceId, device->moduleId, device_id_hash) != NULL)
         {
             LogError("IoTHubTransport_AMQP_Common_Register failed (device '%s' already registered on this transport instance)", device->deviceId);
             result = NULL;
@@ -2260,6 +2621,8 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                 amqp_device_instance->waiting_to_send = waitingToSend;
                 amqp_device_instance->device_state = DEVICE_STATE_STOPPED;
                 amqp_device_instance->max_state_change_timeout_secs = DEFAULT_DEVICE_STATE_CHANGE_TIMEOUT_SECS;
+                amqp_device_instance->time_of_last_do_work = INDEFINITE_TIME;
+                amqp_device_instance->device_id_hash = device_id_hash;
                 amqp_device_instance->subscribe_methods_needed = false;
                 amqp_device_instance->subscribed_for_methods = false;
                 amqp_device_instance->transport_ctx = transport_instance->transport_ctx;
@@ -2272,6 +2635,13 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                     LogError("Transport failed to register device '%s' (failed to copy the deviceId)", device->deviceId);
                     result = NULL;
                 }
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_184: [If `config->moduleId` is not NULL, a copy of it shall be saved into `device_state->module_id`]
+                else if (device->moduleId != NULL && mallocAndStrcpy_s(&amqp_device_instance->module_id, device->moduleId) != 0)
+                {
+                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_185: [If mallocAndStrcpy_s() fails, IoTHubTransport_AMQP_Common_Register shall fail and return NULL]
+                    LogError("Transport failed to register device '%s' (failed to copy the moduleId)", device->deviceId);
+                    result = NULL;
+                }
                 else
                 {
                     AMQP_DEVICE_CONFIG device_config;
@@ -2285,6 +2655,7 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                     device_config.on_state_changed_context = amqp_device_instance;
                     device_config.prod_info_cb = transport_instance->transport_callbacks.prod_info_cb;
                     device_config.prod_info_ctx = transport_instance->transport_ctx;
+                    device_config.sas_token_refresh_scheduler = &transport_instance->sas_token_refresh_scheduler;
 
                     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_071: [`amqp_device_instance->device_handle` shall be set using amqp_device_create()]
                     if ((amqp_device_instance->device_handle = amqp_device_create(&device_config)) == NULL)
@@ -2313,7 +2684,7 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                                 result = NULL;
                             }
                             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_074: [IoTHubTransport_AMQP_Common_Register shall add the `amqp_device_instance` to `instance->registered_devices`]
-                            else if (singlylinkedlist_add(transport_instance->registered_devices, amqp_device_instance) == NULL)
+                            else if ((amqp_device_instance->registered_devices_item = singlylinkedlist_add(transport_instance->registered_devices, amqp_device_instance)) == NULL)
                             {
                                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_075: [If it fails to add `amqp_device_instance`, IoTHubTransport_AMQP_Common_Register shall fail and return NULL]
                                 LogError("Transport failed to register device '%s' (singlylinkedlist_add failed)", device->deviceId);
@@ -2321,6 +2692,9 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                             }
                             else
                             {
+                                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_162: [IoTHubTransport_AMQP_Common_Register shall add the `amqp_device_instance` to the transport device index]
+                                add_device_to_index(transport_instance, amqp_device_instance);
+
                                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_076: [If the device is the first being registered on the transport, IoTHubTransport_AMQP_Common_Register shall save its authentication mode as the transport preferred authentication mode]
                                 if (transport_instance->preferred_authentication_mode == AMQP_TRANSPORT_AUTHENTICATION_MODE_NOT_SET &&
                                     is_first_device_being_registered)
@@ -2365,7 +2739,6 @@ void IoTHubTransport_AMQP_Common_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
     {
         AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)deviceHandle;
         const char* device_id;
-        LIST_ITEM_HANDLE list_item;
 
         if ((device_id = STRING_c_str(registered_device->device_id)) == NULL)
         {
@@ -2377,19 +2750,22 @@ void IoTHubTransport_AMQP_Common_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
             LogError("Failed to unregister device '%s' (deviceHandle does not have a transport state associated to).", device_id);
         }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_081: [If the device is not registered with this transport, IoTHubTransport_AMQP_Common_Unregister shall return]
-        else if (!is_device_registered_ex(registered_device->transport_instance->registered_devices, device_id, &list_item))
+        else if (find_device_in_index(registered_device->transport_instance, device_id, registered_device->module_id, registered_device->device_id_hash) != registered_device)
         {
             LogError("Failed to unregister device '%s' (device is not registered within this transport).", device_id);
         }
         else
         {
             // Removing it first so the race hazzard is reduced between this function and DoWork. Best would be to use locks.
-            if (singlylinkedlist_remove(registered_device->transport_instance->registered_devices, list_item) != RESULT_OK)
+            if (singlylinkedlist_remove(registered_device->transport_instance->registered_devices, registered_device->registered_devices_item) != RESULT_OK)
             {
                 LogError("Failed to unregister device '%s' (singlylinkedlist_remove failed).", device_id);
             }
             else
             {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_163: [`device_instance` shall be removed from the transport device index]
+                remove_device_from_index(registered_device->transport_instance, registered_device);
+
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_012: [IoTHubTransport_AMQP_Common_Unregister shall destroy the C2D methods handler by calling iothubtransportamqp_methods_destroy]
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_083: [IoTHubTransport_AMQP_Common_Unregister shall free all the memory allocated for the `device_instance`]
                 internal_destroy_amqp_device_instance(registered_device);
@@ -2565,4 +2941,4 @@ int IoTHubTransport_AMQP_Common_GetSupportedPlatformInfo(TRANSPORT_LL_HANDLE han
     }
 
     return result;
-}
\ No newline at end of file
+}
@@ -27,6 +27,10 @@ typedef struct AMQP_CONNECTION_INSTANCE_TAG
     CBS_HANDLE cbs_handle;
     CONNECTION_HANDLE connection_handle;
     SESSION_HANDLE session_handle;
+    SESSION_HANDLE* extra_session_handles;
+    size_t extra_session_count;
+    uint32_t session_incoming_window;
+    uint32_t session_outgoing_window;
     XIO_HANDLE sasl_io;
     SASL_MECHANISM_HANDLE sasl_mechanism;
     bool has_cbs;
@@ -229,32 +233,77 @@ static int create_connection_handle(AMQP_CONNECTION_INSTANCE* instance)
     return result;
 }
 
-static int create_session_handle(AMQP_CONNECTION_INSTANCE* instance)
+static SESSION_HANDLE create_configured_session(AMQP_CONNECTION_INSTANCE* instance)
 {
-    int result;
+    SESSION_HANDLE result;
 
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_024: [`instance->session_handle` shall be created using session_create(), passing `instance->connection_handle`]
-    if ((instance->session_handle = session_create(instance->connection_handle, NULL, NULL)) == NULL)
+    if ((result = session_create(instance->connection_handle, NULL, NULL)) == NULL)
     {
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_025: [If session_create() fails, amqp_connection_create() shall fail and return NULL]
-        result = MU_FAILURE;
-        LogError("Failed creating the AMQP connection (connection_create2 failed)");
+        LogError("Failed creating the AMQP session (session_create failed)");
     }
     else
     {
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_026: [The `instance->session_handle` incoming window size shall be set as UINT_MAX using session_set_incoming_window()]
-        if (session_set_incoming_window(instance->session_handle, (uint32_t)DEFAULT_INCOMING_WINDOW_SIZE) != 0)
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_080: [If `config->session_incoming_window` is not zero, it shall be used instead of the default incoming window size]
+        if (session_set_incoming_window(result, instance->session_incoming_window) != 0)
         {
             LogError("Failed to set the AMQP session incoming window size.");
         }
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_027: [The `instance->session_handle` outgoing window size shall be set as 100 using session_set_outgoing_window()]
-        if (session_set_outgoing_window(instance->session_handle, DEFAULT_OUTGOING_WINDOW_SIZE) != 0)
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_081: [If `config->session_outgoing_window` is not zero, it shall be used instead of the default outgoing window size]
+        if (session_set_outgoing_window(result, instance->session_outgoing_window) != 0)
         {
             LogError("Failed to set the AMQP session outgoing window size.");
         }
+    }
+
+    return result;
+}
+
+static int create_session_handle(AMQP_CONNECTION_INSTANCE* instance)
+{
+    int result;
+
+    if ((instance->session_handle = create_configured_session(instance)) == NULL)
+    {
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = RESULT_OK;
+    }
+
+    return result;
+}
 
+static int create_extra_session_handles(AMQP_CONNECTION_INSTANCE* instance, size_t extra_session_count)
+{
+    int result;
+
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_082: [If `config->session_count` is greater than 1, amqp_connection_create() shall create `config->session_count` - 1 additional sessions on the same connection]
+    if ((instance->extra_session_handles = (SESSION_HANDLE*)malloc(extra_session_count * sizeof(SESSION_HANDLE))) == NULL)
+    {
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_083: [If any of the additional sessions fails to be created, amqp_connection_create() shall fail and return NULL]
+        result = MU_FAILURE;
+        LogError("Failed allocating the additional AMQP sessions (malloc failed)");
+    }
+    else
+    {
         result = RESULT_OK;
+
+        while (instance->extra_session_count < extra_session_count)
+        {
+            if ((instance->extra_session_handles[instance->extra_session_count] = create_configured_session(instance)) == NULL)
+            {
+                result = MU_FAILURE;
+                break;
+            }
+
+            instance->extra_session_count++;
+        }
     }
 
     return result;
@@ -302,6 +351,19 @@ void amqp_connection_destroy(AMQP_CONNECTION_HANDLE conn_handle)
             cbs_destroy(instance->cbs_handle);
         }
 
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_084: [amqp_connection_destroy() shall destroy the additional sessions, if any, using session_destroy()]
+        if (instance->extra_session_handles != NULL)
+        {
+            size_t i;
+
+            for (i = 0; i < instance->extra_session_count; i++)
+            {
+                session_destroy(instance->extra_session_handles[i]);
+            }
+
+            free(instance->extra_session_handles);
+        }
+
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_037: [amqp_connection_destroy() shall destroy `instance->session_handle` if set using session_destroy()]
         if (instance->session_handle != NULL)
         {
@@ -396,6 +458,8 @@ AMQP_CONNECTION_HANDLE amqp_connection_create(AMQP_CONNECTION_CONFIG* config)
 
                 instance->svc2cl_keep_alive_timeout_secs = (uint32_t)config->svc2cl_keep_alive_timeout_secs;
                 instance->cl2svc_keep_alive_send_ratio = (double)config->cl2svc_keep_alive_send_ratio;
+                instance->session_incoming_window = (config->session_incoming_window != 0 ? config->session_incoming_window : (uint32_t)DEFAULT_INCOMING_WINDOW_SIZE);
+                instance->session_outgoing_window = (config->session_outgoing_window != 0 ? config->session_outgoing_window : (uint32_t)DEFAULT_OUTGOING_WINDOW_SIZE);
 
                 instance->current_state = AMQP_CONNECTION_STATE_CLOSED;
 
@@ -415,6 +479,11 @@ AMQP_CONNECTION_HANDLE amqp_connection_create(AMQP_CONNECTION_CONFIG* config)
                     result = NULL;
                     LogError("amqp_connection_create failed (failed creating the AMQP session)");
                 }
+                else if (config->session_count > 1 && create_extra_session_handles(instance, config->session_count - 1) != RESULT_OK)
+                {
+                    result = NULL;
+                    LogError("amqp_connection_create failed (failed creating the additional AMQP sessions)");
+                }
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_028: [Only if `config->create_cbs_connection` is true, amqp_connection_create() shall create and open the CBS_HANDLE]
                 else if (config->create_cbs_connection && create_cbs_handle(instance) != RESULT_OK)
                 {
@@ -480,6 +549,38 @@ int amqp_connection_get_session_handle(AMQP_CONNECTION_HANDLE conn_handle, SESSI
     return result;
 }
 
+int amqp_connection_get_shard_session_handle(AMQP_CONNECTION_HANDLE conn_handle, size_t shard_key, SESSION_HANDLE* session_handle)
+{
+    int result;
+
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_085: [If `conn_handle` or `session_handle` are NULL, amqp_connection_get_shard_session_handle() shall fail and return MU_FAILURE]
+    if (conn_handle == NULL || session_handle == NULL)
+    {
+        result = MU_FAILURE;
+        LogError("amqp_connection_get_shard_session_handle failed (conn_handle=%p, session_handle=%p)", conn_handle, session_handle);
+    }
+    else
+    {
+        AMQP_CONNECTION_INSTANCE* instance = (AMQP_CONNECTION_INSTANCE*)conn_handle;
+        size_t session_index = shard_key % (instance->extra_session_count + 1);
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_086: [`session_handle` shall be set to the session at index `shard_key` modulo the number of sessions, where index 0 is `instance->session_handle`]
+        if (session_index == 0)
+        {
+            *session_handle = instance->session_handle;
+        }
+        else
+        {
+            *session_handle = instance->extra_session_handles[session_index - 1];
+        }
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_087: [amqp_connection_get_shard_session_handle() shall return success code 0]
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
 int amqp_connection_get_cbs_handle(AMQP_CONNECTION_HANDLE conn_handle, CBS_HANDLE* cbs_handle)
 {
     int result;
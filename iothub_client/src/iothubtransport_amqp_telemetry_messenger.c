@@ -11,6 +11,7 @@
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_uamqp_c/link.h"
 #include "azure_uamqp_c/messaging.h"
 #include "azure_uamqp_c/message_sender.h"
@@ -33,6 +34,8 @@
 #define MESSAGE_RECEIVER_MAX_LINK_SIZE                  65536
 #define DEFAULT_EVENT_SEND_RETRY_LIMIT                  10
 #define DEFAULT_EVENT_SEND_TIMEOUT_SECS                 600
+#define DEFAULT_EVENT_SEND_BATCH_LINGER_MS              0
+#define DEFAULT_EVENT_SEND_BATCH_MIN_BYTES              0
 #define MAX_MESSAGE_SENDER_STATE_CHANGE_TIMEOUT_SECS    300
 #define MAX_MESSAGE_RECEIVER_STATE_CHANGE_TIMEOUT_SECS  300
 #define UNIQUE_ID_BUFFER_SIZE                           37
@@ -72,6 +75,12 @@ typedef struct TELEMETRY_MESSENGER_INSTANCE_TAG
     size_t event_send_retry_limit;
     size_t event_send_error_count;
     size_t event_send_timeout_secs;
+    size_t event_send_batch_linger_ms;         // Maximum time the oldest waiting event can be held back to fill a batch; 0 disables lingering.
+    size_t event_send_batch_min_bytes;         // Amount of bytes waiting that releases a batch before the linger time expires.
+    TICK_COUNTER_HANDLE tick_counter;          // Only created if event_send_batch_linger_ms is set.
+    size_t bytes_waiting_to_send;              // Sum of `message_size` of the events in waiting_to_send.
+    size_t high_priority_events_waiting;       // Number of events in waiting_to_send with `is_high_priority` set.
+    MESSAGE_ENCODING_CACHE_HANDLE encoding_cache;
     time_t last_message_sender_state_change_time;
     time_t last_message_receiver_state_change_time;
 } TELEMETRY_MESSENGER_INSTANCE;
@@ -83,6 +92,9 @@ typedef struct MESSENGER_SEND_EVENT_CALLER_INFORMATION_TAG
     IOTHUB_MESSAGE_LIST* message;
     ON_TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE on_event_send_complete_callback;
     void* context;
+    tickcounter_ms_t enqueue_time_ms;  // Only set if batch lingering is enabled.
+    size_t message_size;               // Only set if batch lingering is enabled.
+    bool is_high_priority;             // Only set if batch lingering is enabled; such events are never held back.
 } MESSENGER_SEND_EVENT_CALLER_INFORMATION;
 
 // MESSENGER_SEND_EVENT_TASK interfaces with underlying uAMQP layer.  It receives the callback
@@ -926,6 +938,41 @@ static int copy_events_from_in_progress_to_waiting_list(TELEMETRY_MESSENGER_INST
 }
 
 
+static void add_to_waiting_to_send_totals(TELEMETRY_MESSENGER_INSTANCE* instance, MESSENGER_SEND_EVENT_CALLER_INFORMATION* caller_info)
+{
+    instance->bytes_waiting_to_send += caller_info->message_size;
+
+    if (caller_info->is_high_priority)
+    {
+        instance->high_priority_events_waiting++;
+    }
+}
+
+static void remove_from_waiting_to_send_totals(TELEMETRY_MESSENGER_INSTANCE* instance, MESSENGER_SEND_EVENT_CALLER_INFORMATION* caller_info)
+{
+    instance->bytes_waiting_to_send -= caller_info->message_size;
+
+    if (caller_info->is_high_priority)
+    {
+        instance->high_priority_events_waiting--;
+    }
+}
+
+// @brief    Recomputes the waiting_to_send totals after the list has been rebuilt.
+static void reset_waiting_to_send_totals(TELEMETRY_MESSENGER_INSTANCE* instance)
+{
+    LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(instance->waiting_to_send);
+
+    instance->bytes_waiting_to_send = 0;
+    instance->high_priority_events_waiting = 0;
+
+    while (list_item != NULL)
+    {
+        add_to_waiting_to_send_totals(instance, (MESSENGER_SEND_EVENT_CALLER_INFORMATION*)singlylinkedlist_item_get_value(list_item));
+        list_item = singlylinkedlist_get_next_item(list_item);
+    }
+}
+
 static int move_events_to_wait_to_send_list(TELEMETRY_MESSENGER_INSTANCE* instance)
 {
     int result;
@@ -972,6 +1019,7 @@ static int move_events_to_wait_to_send_list(TELEMETRY_MESSENGER_INSTANCE* instan
                 singlylinkedlist_destroy(instance->in_progress_list);
                 instance->waiting_to_send = new_wait_to_send_list;
                 instance->in_progress_list = new_in_progress_list;
+                reset_waiting_to_send_totals(instance);
                 result = RESULT_OK;
             }
         }
@@ -1084,6 +1132,10 @@ static MESSENGER_SEND_EVENT_CALLER_INFORMATION* get_next_caller_message_to_send(
         {
             LogError("Failed removing item from waiting_to_send list (singlylinkedlist_remove failed)");
         }
+        else
+        {
+            remove_from_waiting_to_send_totals(instance, caller_info);
+        }
     }
 
     return caller_info;
@@ -1178,6 +1230,83 @@ static int get_max_message_size_for_batching(TELEMETRY_MESSENGER_INSTANCE* insta
     return result;
 }
 
+// @brief
+//     Gets the size of the body of an IOTHUB_MESSAGE_HANDLE, used to estimate how full a batch would be.
+// @returns
+//     The number of bytes in the message body, or 0 if it cannot be determined.
+static size_t get_message_body_size(IOTHUB_MESSAGE_HANDLE message)
+{
+    size_t result;
+    IOTHUBMESSAGE_CONTENT_TYPE content_type = IoTHubMessage_GetContentType(message);
+
+    if (content_type == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        const unsigned char* buffer;
+
+        if (IoTHubMessage_GetByteArray(message, &buffer, &result) != IOTHUB_MESSAGE_OK)
+        {
+            result = 0;
+        }
+    }
+    else if (content_type == IOTHUBMESSAGE_STRING)
+    {
+        const char* value = IoTHubMessage_GetString(message);
+        result = (value == NULL ? 0 : strlen(value));
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+// @brief
+//     Verifies if the events in waiting_to_send should be held back so more events can be added to the same batch.
+// @remarks
+//     Events are held back while the oldest one has waited less than `event_send_batch_linger_ms`, none of them
+//     has IOTHUB_MESSAGE_PRIORITY_HIGH and, if `event_send_batch_min_bytes` is set, the events waiting add up
+//     to less than that amount of bytes. Only the head of waiting_to_send is read; the priority and size of the
+//     other events come from the running totals kept as events enter and leave the list.
+// @returns
+//     true if the events shall not be sent on this call, false otherwise.
+static bool should_linger_before_sending(TELEMETRY_MESSENGER_INSTANCE* instance)
+{
+    bool result;
+    LIST_ITEM_HANDLE list_item;
+
+    if (instance->event_send_batch_linger_ms == 0 || instance->tick_counter == NULL)
+    {
+        result = false;
+    }
+    else if ((list_item = singlylinkedlist_get_head_item(instance->waiting_to_send)) == NULL)
+    {
+        result = false;
+    }
+    else if (instance->high_priority_events_waiting > 0 ||
+        (instance->event_send_batch_min_bytes > 0 && instance->bytes_waiting_to_send >= instance->event_send_batch_min_bytes))
+    {
+        result = false;
+    }
+    else
+    {
+        MESSENGER_SEND_EVENT_CALLER_INFORMATION* oldest_caller_info = (MESSENGER_SEND_EVENT_CALLER_INFORMATION*)singlylinkedlist_item_get_value(list_item);
+        tickcounter_ms_t current_time_ms;
+
+        if (tickcounter_get_current_ms(instance->tick_counter, &current_time_ms) != 0)
+        {
+            LogError("Failed verifying batch linger time (tickcounter_get_current_ms failed); sending events right away");
+            result = false;
+        }
+        else
+        {
+            result = ((current_time_ms - oldest_caller_info->enqueue_time_ms) < (tickcounter_ms_t)instance->event_send_batch_linger_ms);
+        }
+    }
+
+    return result;
+}
+
 static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
 {
     int result = RESULT_OK;
@@ -1196,11 +1325,7 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_199: [Errors specific to a message (e.g. failure to encode) are NOT fatal but we'll keep processing.  More general errors (e.g. out of memory) will stop processing.]
     while ((caller_info = get_next_caller_message_to_send(instance)) != NULL)
     {
-        if (body_binary_data.bytes != NULL)
-        {
-            // Free here as this may have been set during previous run through loop.
-            free((unsigned char*)body_binary_data.bytes);
-        }
+        // body_binary_data points into instance->encoding_cache, so it is not freed here.
         memset(&body_binary_data, 0, sizeof(body_binary_data));
 
         if ((0 == max_messagesize) && (get_max_message_size_for_batching(instance, &max_messagesize)) != 0)
@@ -1220,10 +1345,10 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
             break;
         }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_200: [Retrieve an AMQP encoded representation of this message for later appending to main batched message.  On error, invoke callback but continue send loop; this is NOT a fatal error.]
-        else if (message_create_uamqp_encoding_from_iothub_message(send_pending_events_state.message_batch_container, caller_info->message->messageHandle, &body_binary_data) != RESULT_OK)
+        else if (message_create_uamqp_encoding_from_iothub_message_with_cache(send_pending_events_state.message_batch_container, caller_info->message->messageHandle, instance->encoding_cache, &body_binary_data) != RESULT_OK)
         {
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_201: [If message_create_uamqp_encoding_from_iothub_message fails, invoke callback with TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE]
-            LogError("message_create_uamqp_encoding_from_iothub_message() failed.  Will continue to try to process messages, result");
+            LogError("message_create_uamqp_encoding_from_iothub_message_with_cache() failed.  Will continue to try to process messages, result");
             invoke_callback_on_error(caller_info, TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE);
             free(caller_info);
             continue;
@@ -1289,11 +1414,6 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
         }
     }
 
-    if (body_binary_data.bytes != NULL)
-    {
-        free((unsigned char*)body_binary_data.bytes);
-    }
-
     // A non-NULL task indicates error, since otherwise send_batched_message_and_reset_state would've sent off messages and reset send_pending_events_state
     if (send_pending_events_state.task != NULL)
     {
@@ -1395,6 +1515,8 @@ static void* telemetry_messenger_clone_option(const char* name, const void* valu
     else
     {
         if (strcmp(TELEMETRY_MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS, name) == 0 ||
+            strcmp(TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_MS, name) == 0 ||
+            strcmp(TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_MIN_BYTES, name) == 0 ||
             strcmp(TELEMETRY_MESSENGER_OPTION_SAVED_OPTIONS, name) == 0)
         {
             result = (void*)value;
@@ -1624,6 +1746,20 @@ int telemetry_messenger_send_async(TELEMETRY_MESSENGER_HANDLE messenger_handle,
             caller_info->on_event_send_complete_callback = on_messenger_event_send_complete_callback;
             caller_info->context = context;
 
+            if (instance->tick_counter != NULL)
+            {
+                if (tickcounter_get_current_ms(instance->tick_counter, &caller_info->enqueue_time_ms) != 0)
+                {
+                    // An enqueue time of zero only causes the event not to be held back for batching.
+                    LogError("Failed getting the enqueue time of event (tickcounter_get_current_ms failed)");
+                    caller_info->enqueue_time_ms = 0;
+                }
+
+                caller_info->message_size = get_message_body_size(message->messageHandle);
+                caller_info->is_high_priority = (IoTHubMessage_GetPriority(message->messageHandle) == IOTHUB_MESSAGE_PRIORITY_HIGH);
+                add_to_waiting_to_send_totals(instance, caller_info);
+            }
+
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_143: [If no failures occur, telemetry_messenger_send_async() shall return zero]
             result = RESULT_OK;
         }
@@ -1883,7 +2019,8 @@ void telemetry_messenger_do_work(TELEMETRY_MESSENGER_HANDLE messenger_handle)
             {
                 update_messenger_state(instance, TELEMETRY_MESSENGER_STATE_ERROR);
             }
-            else if (send_pending_events(instance) != RESULT_OK && instance->event_send_retry_limit > 0)
+            // Events held back by the batch linger time stay in waiting_to_send until a later call.
+            else if (!should_linger_before_sending(instance) && send_pending_events(instance) != RESULT_OK && instance->event_send_retry_limit > 0)
             {
                 instance->event_send_error_count++;
 
@@ -1962,6 +2099,13 @@ void telemetry_messenger_destroy(TELEMETRY_MESSENGER_HANDLE messenger_handle)
 
         STRING_delete(instance->module_id);
 
+        if (instance->tick_counter != NULL)
+        {
+            tickcounter_destroy(instance->tick_counter);
+        }
+
+        message_encoding_cache_destroy(instance->encoding_cache);
+
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_114: [telemetry_messenger_destroy() shall destroy `instance` with free()]
         (void)free(instance);
     }
@@ -2010,6 +2154,8 @@ TELEMETRY_MESSENGER_HANDLE telemetry_messenger_create(const TELEMETRY_MESSENGER_
             instance->message_receiver_previous_state = MESSAGE_RECEIVER_STATE_IDLE;
             instance->event_send_retry_limit = DEFAULT_EVENT_SEND_RETRY_LIMIT;
             instance->event_send_timeout_secs = DEFAULT_EVENT_SEND_TIMEOUT_SECS;
+            instance->event_send_batch_linger_ms = DEFAULT_EVENT_SEND_BATCH_LINGER_MS;
+            instance->event_send_batch_min_bytes = DEFAULT_EVENT_SEND_BATCH_MIN_BYTES;
             instance->last_message_sender_state_change_time = INDEFINITE_TIME;
             instance->last_message_receiver_state_change_time = INDEFINITE_TIME;
 
@@ -2046,6 +2192,11 @@ TELEMETRY_MESSENGER_HANDLE telemetry_messenger_create(const TELEMETRY_MESSENGER_
                 handle = NULL;
                 LogError("telemetry_messenger_create failed (singlylinkedlist_create failed to create in_progress_list)");
             }
+            else if ((instance->encoding_cache = message_encoding_cache_create()) == NULL)
+            {
+                handle = NULL;
+                LogError("telemetry_messenger_create failed (message_encoding_cache_create failed)");
+            }
             else
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_013: [`messenger_config->on_state_changed_callback` shall be saved into `instance->on_state_changed_callback`]
@@ -2092,6 +2243,26 @@ int telemetry_messenger_set_option(TELEMETRY_MESSENGER_HANDLE messenger_handle,
             instance->event_send_timeout_secs = *((size_t*)value);
             result = RESULT_OK;
         }
+        else if (strcmp(TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_MS, name) == 0)
+        {
+            size_t linger_ms = *((size_t*)value);
+
+            if (linger_ms > 0 && instance->tick_counter == NULL && (instance->tick_counter = tickcounter_create()) == NULL)
+            {
+                LogError("telemetry_messenger_set_option failed (tickcounter_create failed)");
+                result = MU_FAILURE;
+            }
+            else
+            {
+                instance->event_send_batch_linger_ms = linger_ms;
+                result = RESULT_OK;
+            }
+        }
+        else if (strcmp(TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_MIN_BYTES, name) == 0)
+        {
+            instance->event_send_batch_min_bytes = *((size_t*)value);
+            result = RESULT_OK;
+        }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_169: [If name matches TELEMETRY_MESSENGER_OPTION_SAVED_OPTIONS, `value` shall be applied using OptionHandler_FeedOptions]
         else if (strcmp(TELEMETRY_MESSENGER_OPTION_SAVED_OPTIONS, name) == 0)
         {
@@ -2150,6 +2321,16 @@ OPTIONHANDLER_HANDLE telemetry_messenger_retrieve_options(TELEMETRY_MESSENGER_HA
                 LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", TELEMETRY_MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS);
                 result = NULL;
             }
+            else if (OptionHandler_AddOption(options, TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_MS, (void*)&instance->event_send_batch_linger_ms) != OPTIONHANDLER_OK)
+            {
+                LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_MS);
+                result = NULL;
+            }
+            else if (OptionHandler_AddOption(options, TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_MIN_BYTES, (void*)&instance->event_send_batch_min_bytes) != OPTIONHANDLER_OK)
+            {
+                LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_MIN_BYTES);
+                result = NULL;
+            }
             else
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_179: [If no failures occur, telemetry_messenger_retrieve_options shall return the OPTIONHANDLER_HANDLE instance]
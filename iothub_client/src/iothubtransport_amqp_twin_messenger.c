@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
@@ -29,6 +30,8 @@ MU_DEFINE_ENUM_STRINGS_WITHOUT_INVALID(TWIN_UPDATE_TYPE, TWIN_UPDATE_TYPE_VALUES
 #define INDEFINITE_TIME ((time_t)(-1))
 
 #define UNIQUE_ID_BUFFER_SIZE                           37
+#define TWIN_OPERATION_ID_BUFFER_SIZE                   11
+#define TWIN_OPERATION_INDEX_BUCKET_COUNT               64
 
 #define EMPTY_TWIN_BODY_DATA                            ((const unsigned char*)" ")
 #define EMPTY_TWIN_BODY_SIZE                            1
@@ -100,6 +103,10 @@ typedef struct TWIN_MESSENGER_INSTANCE_TAG
     SINGLYLINKEDLIST_HANDLE pending_patches;
     SINGLYLINKEDLIST_HANDLE operations;
 
+    // Outstanding operations hashed by their numeric correlation-id, so responses are matched without scanning `operations`.
+    struct TWIN_OPERATION_CONTEXT_TAG* operation_index[TWIN_OPERATION_INDEX_BUCKET_COUNT];
+    uint32_t last_operation_id;
+
     TWIN_MESSENGER_STATE_CHANGED_CALLBACK on_state_changed_callback;
     void* on_state_changed_context;
 
@@ -125,7 +132,10 @@ typedef struct TWIN_OPERATION_CONTEXT_TAG
 {
     TWIN_OPERATION_TYPE type;
     TWIN_MESSENGER_INSTANCE* msgr;
-    char* correlation_id;
+    uint32_t id;
+    char correlation_id[TWIN_OPERATION_ID_BUFFER_SIZE];
+    LIST_ITEM_HANDLE list_item;
+    struct TWIN_OPERATION_CONTEXT_TAG* next_in_index;
     union {
         struct REPORTED_PROPERTIES_TAG
         {
@@ -400,26 +410,64 @@ static TWIN_OPERATION_CONTEXT* create_twin_operation_context(TWIN_MESSENGER_INST
     {
         memset(result, 0, sizeof(TWIN_OPERATION_CONTEXT));
 
-        if ((result->correlation_id = generate_unique_id()) == NULL)
+        // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_117: [Each TWIN operation shall be given the next non-zero value of a per-messenger counter as id, and its correlation-id shall be that id formatted once as a decimal string]
+        if (++twin_msgr->last_operation_id == 0)
         {
-            LogError("Failed setting context correlation-id (%s, %s)", MU_ENUM_TO_STRING(TWIN_OPERATION_TYPE, type), twin_msgr->device_id);
-            free(result);
-            result = NULL;
+            twin_msgr->last_operation_id = 1;
         }
-        else
+
+        result->id = twin_msgr->last_operation_id;
+        (void)sprintf(result->correlation_id, "%" PRIu32, result->id);
+        result->type = type;
+        result->msgr = twin_msgr;
+    }
+
+    return result;
+}
+
+static TWIN_OPERATION_CONTEXT* find_twin_operation_by_correlation_id(TWIN_MESSENGER_INSTANCE* twin_msgr, const char* correlation_id)
+{
+    TWIN_OPERATION_CONTEXT* result;
+    char* end;
+    unsigned long long id;
+
+    // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_119: [If the correlation-id is not a decimal number or no outstanding operation has it, the incoming message shall not be matched to any TWIN request]
+    if (correlation_id[0] < '0' || correlation_id[0] > '9')
+    {
+        result = NULL;
+    }
+    else if ((id = strtoull(correlation_id, &end, 10)) == 0 || id > UINT32_MAX || *end != '\0')
+    {
+        result = NULL;
+    }
+    else
+    {
+        // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_118: [The TWIN request an incoming message responds to shall be looked up in `twin_msgr->operation_index` by the numeric value of its correlation-id]
+        result = twin_msgr->operation_index[id % TWIN_OPERATION_INDEX_BUCKET_COUNT];
+
+        while (result != NULL && result->id != (uint32_t)id)
         {
-            result->type = type;
-            result->msgr = twin_msgr;
+            result = result->next_in_index;
         }
     }
 
     return result;
 }
 
-static bool find_twin_operation_by_correlation_id(LIST_ITEM_HANDLE list_item, const void* match_context)
+static void remove_twin_operation_context_from_index(TWIN_OPERATION_CONTEXT* twin_op_ctx)
 {
-    TWIN_OPERATION_CONTEXT* twin_op_ctx = (TWIN_OPERATION_CONTEXT*)singlylinkedlist_item_get_value(list_item);
-    return (strcmp(twin_op_ctx->correlation_id, (const char*)match_context) == 0);
+    TWIN_OPERATION_CONTEXT** link = &twin_op_ctx->msgr->operation_index[twin_op_ctx->id % TWIN_OPERATION_INDEX_BUCKET_COUNT];
+
+    while (*link != NULL && *link != twin_op_ctx)
+    {
+        link = &(*link)->next_in_index;
+    }
+
+    if (*link != NULL)
+    {
+        *link = twin_op_ctx->next_in_index;
+        twin_op_ctx->next_in_index = NULL;
+    }
 }
 
 static bool find_twin_operation_by_type(LIST_ITEM_HANDLE list_item, const void* match_context)
@@ -430,7 +478,7 @@ static bool find_twin_operation_by_type(LIST_ITEM_HANDLE list_item, const void*
 
 static void destroy_twin_operation_context(TWIN_OPERATION_CONTEXT* op_ctx)
 {
-    free(op_ctx->correlation_id);
+    remove_twin_operation_context_from_index(op_ctx);
     free(op_ctx);
 }
 
@@ -438,13 +486,17 @@ static int add_twin_operation_context_to_queue(TWIN_OPERATION_CONTEXT* twin_op_c
 {
     int result;
 
-    if (singlylinkedlist_add(twin_op_ctx->msgr->operations, (const void*)twin_op_ctx) == NULL)
+    if ((twin_op_ctx->list_item = singlylinkedlist_add(twin_op_ctx->msgr->operations, (const void*)twin_op_ctx)) == NULL)
     {
         LogError("Failed adding TWIN operation context to queue (%s, %s)", MU_ENUM_TO_STRING(TWIN_OPERATION_TYPE, twin_op_ctx->type), twin_op_ctx->correlation_id);
         result = MU_FAILURE;
     }
     else
     {
+        TWIN_OPERATION_CONTEXT** bucket = &twin_op_ctx->msgr->operation_index[twin_op_ctx->id % TWIN_OPERATION_INDEX_BUCKET_COUNT];
+
+        twin_op_ctx->next_in_index = *bucket;
+        *bucket = twin_op_ctx;
         result = RESULT_OK;
     }
 
@@ -454,13 +506,12 @@ static int add_twin_operation_context_to_queue(TWIN_OPERATION_CONTEXT* twin_op_c
 static int remove_twin_operation_context_from_queue(TWIN_OPERATION_CONTEXT* twin_op_ctx)
 {
     int result;
-    LIST_ITEM_HANDLE list_item;
 
-    if ((list_item = singlylinkedlist_find(twin_op_ctx->msgr->operations, find_twin_operation_by_correlation_id, (const void*)twin_op_ctx->correlation_id)) == NULL)
+    if (twin_op_ctx->list_item == NULL)
     {
         result = RESULT_OK;
     }
-    else if (singlylinkedlist_remove(twin_op_ctx->msgr->operations, list_item) != 0)
+    else if (singlylinkedlist_remove(twin_op_ctx->msgr->operations, twin_op_ctx->list_item) != 0)
     {
         LogError("Failed removing TWIN operation context from queue (%s, %s, %s)",
             twin_op_ctx->msgr->device_id, MU_ENUM_TO_STRING(TWIN_OPERATION_TYPE, twin_op_ctx->type), twin_op_ctx->correlation_id);
@@ -468,6 +519,7 @@ static int remove_twin_operation_context_from_queue(TWIN_OPERATION_CONTEXT* twin
     }
     else
     {
+        twin_op_ctx->list_item = NULL;
         result = RESULT_OK;
     }
 
@@ -790,7 +842,7 @@ static MESSAGE_HANDLE create_amqp_message_for_twin_operation(TWIN_OPERATION_TYPE
                 message_destroy(result);
                 result = NULL;
             }
-            // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_068: [The `correlation-id` property of `amqp_message` shall be set with an UUID string]
+            // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_068: [The `correlation-id` property of `amqp_message` shall be set with the correlation-id of the TWIN operation]
             else if (set_message_correlation_id(result, correlation_id) != RESULT_OK)
             {
                 // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_069: [If setting `correlation-id` fails, message_create_for_twin_operation shall fail and return NULL]
@@ -1406,169 +1458,163 @@ static AMQP_MESSENGER_DISPOSITION_RESULT on_amqp_message_received_callback(MESSA
             {
                 // It is supposed to be a request sent previously (reported properties PATCH, GET, PUT or DELETE).
 
-                LIST_ITEM_HANDLE list_item;
-                if ((list_item = singlylinkedlist_find(twin_msgr->operations, find_twin_operation_by_correlation_id, (const void*)correlation_id)) == NULL)
+                TWIN_OPERATION_CONTEXT* twin_op_ctx;
+
+                if ((twin_op_ctx = find_twin_operation_by_correlation_id(twin_msgr, correlation_id)) == NULL)
                 {
                     LogError("Could not find context of TWIN incoming message (%s, %s)", twin_msgr->device_id, correlation_id);
                 }
                 else
                 {
-                    TWIN_OPERATION_CONTEXT* twin_op_ctx;
+                    LIST_ITEM_HANDLE list_item = twin_op_ctx->list_item;
 
-                    if ((twin_op_ctx = (TWIN_OPERATION_CONTEXT*)singlylinkedlist_item_get_value(list_item)) == NULL)
-                    {
-                        LogError("Could not get context for incoming TWIN message (%s, %s)", twin_msgr->device_id, correlation_id);
-                    }
-                    else
+                    if (twin_op_ctx->type == TWIN_OPERATION_TYPE_PATCH)
                     {
-                        if (twin_op_ctx->type == TWIN_OPERATION_TYPE_PATCH)
+                        if (!has_status_code)
                         {
-                            if (!has_status_code)
-                            {
-                                // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_086: [If `message` is a failed response for a PATCH request, the `on_report_state_complete_callback` shall be invoked if provided passing RESULT_ERROR and the status_code zero]
-                                LogError("Received an incoming TWIN message for a PATCH operation, but with no status code (%s, %s)", twin_msgr->device_id, correlation_id);
+                            // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_086: [If `message` is a failed response for a PATCH request, the `on_report_state_complete_callback` shall be invoked if provided passing RESULT_ERROR and the status_code zero]
+                            LogError("Received an incoming TWIN message for a PATCH operation, but with no status code (%s, %s)", twin_msgr->device_id, correlation_id);
 
-                                disposition_result = AMQP_MESSENGER_DISPOSITION_RESULT_REJECTED;
+                            disposition_result = AMQP_MESSENGER_DISPOSITION_RESULT_REJECTED;
 
-                                if (twin_op_ctx->cb.reported_properties.callback != NULL)
-                                {
-                                    twin_op_ctx->cb.reported_properties.callback(TWIN_REPORT_STATE_RESULT_ERROR, TWIN_REPORT_STATE_REASON_INVALID_RESPONSE, 0, twin_op_ctx->cb.reported_properties.context);
-                                }
-                            }
-                            else
+                            if (twin_op_ctx->cb.reported_properties.callback != NULL)
                             {
-                                // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_085: [If `message` is a success response for a PATCH request, the `on_report_state_complete_callback` shall be invoked if provided passing RESULT_SUCCESS and the status_code received]
-                                if (twin_op_ctx->cb.reported_properties.callback != NULL)
-                                {
-                                    twin_op_ctx->cb.reported_properties.callback(TWIN_REPORT_STATE_RESULT_SUCCESS, TWIN_REPORT_STATE_REASON_NONE, status_code, twin_op_ctx->cb.reported_properties.context);
-                                }
+                                twin_op_ctx->cb.reported_properties.callback(TWIN_REPORT_STATE_RESULT_ERROR, TWIN_REPORT_STATE_REASON_INVALID_RESPONSE, 0, twin_op_ctx->cb.reported_properties.context);
                             }
                         }
-                        else if (twin_op_ctx->type == TWIN_OPERATION_TYPE_GET)
+                        else
                         {
-                            if (!has_twin_report)
+                            // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_085: [If `message` is a success response for a PATCH request, the `on_report_state_complete_callback` shall be invoked if provided passing RESULT_SUCCESS and the status_code received]
+                            if (twin_op_ctx->cb.reported_properties.callback != NULL)
                             {
-                                // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_089: [If `message` is a failed response for a GET request, the TWIN messenger shall attempt to send another GET request]
-                                LogError("Received an incoming TWIN message for a GET operation, but with no report (%s, %s)", twin_msgr->device_id, correlation_id);
-
-                                disposition_result = AMQP_MESSENGER_DISPOSITION_RESULT_REJECTED;
+                                twin_op_ctx->cb.reported_properties.callback(TWIN_REPORT_STATE_RESULT_SUCCESS, TWIN_REPORT_STATE_REASON_NONE, status_code, twin_op_ctx->cb.reported_properties.context);
+                            }
+                        }
+                    }
+                    else if (twin_op_ctx->type == TWIN_OPERATION_TYPE_GET)
+                    {
+                        if (!has_twin_report)
+                        {
+                            // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_089: [If `message` is a failed response for a GET request, the TWIN messenger shall attempt to send another GET request]
+                            LogError("Received an incoming TWIN message for a GET operation, but with no report (%s, %s)", twin_msgr->device_id, correlation_id);
 
-                                if (twin_op_ctx->msgr->on_message_received_callback != NULL)
-                                {
-                                    twin_op_ctx->msgr->on_message_received_callback(TWIN_UPDATE_TYPE_COMPLETE, NULL, 0, twin_op_ctx->msgr->on_message_received_context);
-                                }
+                            disposition_result = AMQP_MESSENGER_DISPOSITION_RESULT_REJECTED;
 
-                                if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_GETTING_COMPLETE_PROPERTIES)
-                                {
-                                    twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_GET_COMPLETE_PROPERTIES;
-                                    twin_msgr->subscription_error_count++;
-                                }
-                            }
-                            else
+                            if (twin_op_ctx->msgr->on_message_received_callback != NULL)
                             {
-                                // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_087: [If `message` is a success response for a GET request, `on_message_received_callback` shall be invoked with TWIN_UPDATE_TYPE_COMPLETE and the message body received]
-                                if (twin_op_ctx->msgr->on_message_received_callback != NULL)
-                                {
-                                    twin_op_ctx->msgr->on_message_received_callback(TWIN_UPDATE_TYPE_COMPLETE, (const char*)twin_report.bytes, twin_report.length, twin_op_ctx->msgr->on_message_received_context);
-                                }
+                                twin_op_ctx->msgr->on_message_received_callback(TWIN_UPDATE_TYPE_COMPLETE, NULL, 0, twin_op_ctx->msgr->on_message_received_context);
+                            }
 
-                                // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_088: [If `message` is a success response for a GET request, the TWIN messenger shall trigger the subscription for partial updates]
-                                if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_GETTING_COMPLETE_PROPERTIES)
-                                {
-                                    twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_SUBSCRIBE_FOR_UPDATES;
-                                    twin_msgr->subscription_error_count = 0;
-                                }
+                            if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_GETTING_COMPLETE_PROPERTIES)
+                            {
+                                twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_GET_COMPLETE_PROPERTIES;
+                                twin_msgr->subscription_error_count++;
                             }
                         }
-                        else if (twin_op_ctx->type == TWIN_OPERATION_TYPE_GET_ON_DEMAND)
+                        else
                         {
-                            if (!has_twin_report)
+                            // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_087: [If `message` is a success response for a GET request, `on_message_received_callback` shall be invoked with TWIN_UPDATE_TYPE_COMPLETE and the message body received]
+                            if (twin_op_ctx->msgr->on_message_received_callback != NULL)
                             {
-                                LogError("Received an incoming TWIN message for a GET operation, but with no report (%s, %s)", twin_msgr->device_id, correlation_id);
-
-                                disposition_result = AMQP_MESSENGER_DISPOSITION_RESULT_REJECTED;
-
-                                twin_op_ctx->cb.get_twin.callback(TWIN_UPDATE_TYPE_COMPLETE, NULL, 0, twin_op_ctx->cb.get_twin.context);
+                                twin_op_ctx->msgr->on_message_received_callback(TWIN_UPDATE_TYPE_COMPLETE, (const char*)twin_report.bytes, twin_report.length, twin_op_ctx->msgr->on_message_received_context);
                             }
-                            else
+
+                            // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_088: [If `message` is a success response for a GET request, the TWIN messenger shall trigger the subscription for partial updates]
+                            if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_GETTING_COMPLETE_PROPERTIES)
                             {
-                                twin_op_ctx->cb.get_twin.callback(TWIN_UPDATE_TYPE_COMPLETE, (const char*)twin_report.bytes, twin_report.length, twin_op_ctx->cb.get_twin.context);
+                                twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_SUBSCRIBE_FOR_UPDATES;
+                                twin_msgr->subscription_error_count = 0;
                             }
                         }
-                        else if (twin_op_ctx->type == TWIN_OPERATION_TYPE_PUT)
+                    }
+                    else if (twin_op_ctx->type == TWIN_OPERATION_TYPE_GET_ON_DEMAND)
+                    {
+                        if (!has_twin_report)
+                        {
+                            LogError("Received an incoming TWIN message for a GET operation, but with no report (%s, %s)", twin_msgr->device_id, correlation_id);
+
+                            disposition_result = AMQP_MESSENGER_DISPOSITION_RESULT_REJECTED;
+
+                            twin_op_ctx->cb.get_twin.callback(TWIN_UPDATE_TYPE_COMPLETE, NULL, 0, twin_op_ctx->cb.get_twin.context);
+                        }
+                        else
                         {
-                            if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_SUBSCRIBED)
+                            twin_op_ctx->cb.get_twin.callback(TWIN_UPDATE_TYPE_COMPLETE, (const char*)twin_report.bytes, twin_report.length, twin_op_ctx->cb.get_twin.context);
+                        }
+                    }
+                    else if (twin_op_ctx->type == TWIN_OPERATION_TYPE_PUT)
+                    {
+                        if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_SUBSCRIBED)
+                        {
+                            bool subscription_succeeded = true;
+
+                            if (!has_status_code)
                             {
-                                bool subscription_succeeded = true;
+                                LogError("Received an incoming TWIN message for a PUT operation, but with no status code (%s, %s)", twin_msgr->device_id, correlation_id);
 
-                                if (!has_status_code)
-                                {
-                                    LogError("Received an incoming TWIN message for a PUT operation, but with no status code (%s, %s)", twin_msgr->device_id, correlation_id);
+                                subscription_succeeded = false;
+                            }
+                            else if (status_code < 200 || status_code >= 300)
+                            {
+                                LogError("Received status code %d for TWIN subscription request (%s, %s)", status_code, twin_msgr->device_id, correlation_id);
 
-                                    subscription_succeeded = false;
-                                }
-                                else if (status_code < 200 || status_code >= 300)
-                                {
-                                    LogError("Received status code %d for TWIN subscription request (%s, %s)", status_code, twin_msgr->device_id, correlation_id);
+                                subscription_succeeded = false;
+                            }
 
-                                    subscription_succeeded = false;
+                            if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_SUBSCRIBING)
+                            {
+                                if (subscription_succeeded)
+                                {
+                                    twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_SUBSCRIBED;
+                                    twin_msgr->subscription_error_count = 0;
                                 }
-
-                                if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_SUBSCRIBING)
+                                else
                                 {
-                                    if (subscription_succeeded)
-                                    {
-                                        twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_SUBSCRIBED;
-                                        twin_msgr->subscription_error_count = 0;
-                                    }
-                                    else
-                                    {
-                                        // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_090: [If `message` is a failed response for a PUT request, the TWIN messenger shall attempt to send another PUT request]
-                                        twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_SUBSCRIBE_FOR_UPDATES;
-                                        twin_msgr->subscription_error_count++;
-                                    }
+                                    // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_090: [If `message` is a failed response for a PUT request, the TWIN messenger shall attempt to send another PUT request]
+                                    twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_SUBSCRIBE_FOR_UPDATES;
+                                    twin_msgr->subscription_error_count++;
                                 }
                             }
                         }
-                        else if (twin_op_ctx->type == TWIN_OPERATION_TYPE_DELETE)
+                    }
+                    else if (twin_op_ctx->type == TWIN_OPERATION_TYPE_DELETE)
+                    {
+                        if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_NOT_SUBSCRIBED)
                         {
-                            if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_NOT_SUBSCRIBED)
+                            bool unsubscription_succeeded = true;
+
+                            if (!has_status_code)
                             {
-                                bool unsubscription_succeeded = true;
+                                LogError("Received an incoming TWIN message for a DELETE operation, but with no status code (%s, %s)", twin_msgr->device_id, correlation_id);
 
-                                if (!has_status_code)
-                                {
-                                    LogError("Received an incoming TWIN message for a DELETE operation, but with no status code (%s, %s)", twin_msgr->device_id, correlation_id);
+                                unsubscription_succeeded = false;
+                            }
+                            else if (status_code < 200 || status_code >= 300)
+                            {
+                                LogError("Received status code %d for TWIN unsubscription request (%s, %s)", status_code, twin_msgr->device_id, correlation_id);
 
-                                    unsubscription_succeeded = false;
-                                }
-                                else if (status_code < 200 || status_code >= 300)
-                                {
-                                    LogError("Received status code %d for TWIN unsubscription request (%s, %s)", status_code, twin_msgr->device_id, correlation_id);
+                                unsubscription_succeeded = false;
+                            }
 
-                                    unsubscription_succeeded = false;
+                            if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_UNSUBSCRIBING)
+                            {
+                                if (unsubscription_succeeded)
+                                {
+                                    twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_NOT_SUBSCRIBED;
+                                    twin_msgr->subscription_error_count = 0;
                                 }
-
-                                if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_UNSUBSCRIBING)
+                                else
                                 {
-                                    if (unsubscription_succeeded)
-                                    {
-                                        twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_NOT_SUBSCRIBED;
-                                        twin_msgr->subscription_error_count = 0;
-                                    }
-                                    else
-                                    {
-                                        // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_091: [If `message` is a failed response for a DELETE request, the TWIN messenger shall attempt to send another DELETE request]
-                                        twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_UNSUBSCRIBE;
-                                        twin_msgr->subscription_error_count++;
-                                    }
+                                    // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_091: [If `message` is a failed response for a DELETE request, the TWIN messenger shall attempt to send another DELETE request]
+                                    twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_UNSUBSCRIBE;
+                                    twin_msgr->subscription_error_count++;
                                 }
                             }
                         }
-
-                        destroy_twin_operation_context(twin_op_ctx);
                     }
 
+                    destroy_twin_operation_context(twin_op_ctx);
+
                     // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_092: [The corresponding TWIN request shall be removed from `twin_msgr->operations` and destroyed]
                     if (singlylinkedlist_remove(twin_msgr->operations, list_item) != 0)
                     {
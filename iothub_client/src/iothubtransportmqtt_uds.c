@@ -0,0 +1,246 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "iothubtransportmqtt_uds.h"
+#include "azure_c_shared_utility/xio.h"
+#include "azure_c_shared_utility/socketio.h"
+#include "azure_c_shared_utility/envvariable.h"
+#include "azure_c_shared_utility/shared_util_options.h"
+#include "internal/iothubtransport_mqtt_common.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+static const char* ENVIRONMENT_VAR_EDGEHUBURI = "IOTEDGE_EDGEHUBURI";
+static const char* UNIX_DOMAIN_SOCKET_PREFIX = "unix://";
+
+static XIO_HANDLE getUdsIOTransport(const char* fully_qualified_name, const MQTT_TRANSPORT_PROXY_OPTIONS* mqtt_transport_proxy_options)
+{
+    XIO_HANDLE result;
+    const char* edgehub_uri;
+    const IO_INTERFACE_DESCRIPTION* io_interface_description;
+    size_t prefix_length = strlen(UNIX_DOMAIN_SOCKET_PREFIX);
+
+    // The MQTT CONNECT still carries the host name, only the socket path matters here.
+    (void)fully_qualified_name;
+
+    if (mqtt_transport_proxy_options != NULL)
+    {
+        /* Codes_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_001: [ If `mqtt_transport_proxy_options` is not NULL, `getUdsIOTransport` shall return NULL. ] */
+        LogError("A proxy cannot be used with a Unix domain socket");
+        result = NULL;
+    }
+    /* Codes_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_002: [ `getUdsIOTransport` shall read the socket of edgeHub from the `IOTEDGE_EDGEHUBURI` environment variable, as `unix://` followed by the path of the socket. ] */
+    else if ((edgehub_uri = environment_get_variable(ENVIRONMENT_VAR_EDGEHUBURI)) == NULL)
+    {
+        /* Codes_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_003: [ If the variable is not set, does not start with `unix://` or has no path, `getUdsIOTransport` shall return NULL. ] */
+        LogError("Environment variable %s is not set", ENVIRONMENT_VAR_EDGEHUBURI);
+        result = NULL;
+    }
+    else if (strncmp(edgehub_uri, UNIX_DOMAIN_SOCKET_PREFIX, prefix_length) != 0 || edgehub_uri[prefix_length] == '\0')
+    {
+        /* Codes_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_003: [ If the variable is not set, does not start with `unix://` or has no path, `getUdsIOTransport` shall return NULL. ] */
+        LogError("%s=%s is not a unix domain socket", ENVIRONMENT_VAR_EDGEHUBURI, edgehub_uri);
+        result = NULL;
+    }
+    /* Codes_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_004: [ `getUdsIOTransport` shall obtain the socket IO interface handle by calling `socketio_get_interface_description`. ] */
+    else if ((io_interface_description = socketio_get_interface_description()) == NULL)
+    {
+        /* Codes_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_005: [ If `socketio_get_interface_description` returns NULL, `getUdsIOTransport` shall return NULL. ] */
+        LogError("Failure constructing the provider interface");
+        result = NULL;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_006: [ `getUdsIOTransport` shall call `xio_create` with a `SOCKETIO_CONFIG` whose `hostname` is the path of the socket, `port` is 0 and `accepted_socket` is NULL. ] */
+        SOCKETIO_CONFIG socketio_config;
+        socketio_config.hostname = edgehub_uri + prefix_length;
+        socketio_config.port = 0;
+        socketio_config.accepted_socket = NULL;
+
+        if ((result = xio_create(io_interface_description, &socketio_config)) == NULL)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_007: [ If `xio_create` or `xio_setoption` fails, `getUdsIOTransport` shall return NULL. ] */
+            LogError("Failed creating the socket IO");
+        }
+        /* Codes_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_008: [ `getUdsIOTransport` shall set `OPTION_ADDRESS_TYPE` to `OPTION_ADDRESS_TYPE_DOMAIN_SOCKET` on the socket IO and return it. ] */
+        else if (xio_setoption(result, OPTION_ADDRESS_TYPE, OPTION_ADDRESS_TYPE_DOMAIN_SOCKET) != 0)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_007: [ If `xio_create` or `xio_setoption` fails, `getUdsIOTransport` shall return NULL. ] */
+            LogError("Failed setting the socket IO to a unix domain socket");
+            xio_destroy(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+static TRANSPORT_LL_HANDLE IoTHubTransportMqtt_UDS_Create(const IOTHUBTRANSPORT_CONFIG* config, TRANSPORT_CALLBACKS_INFO* cb_info, void* ctx)
+{
+    /* Codes_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_009: [ `IoTHubTransportMqtt_UDS_Create` shall create a TRANSPORT_LL_HANDLE by calling into the `IoTHubTransport_MQTT_Common_Create` function with `getUdsIOTransport`. ] */
+    return IoTHubTransport_MQTT_Common_Create(config, getUdsIOTransport, cb_info, ctx);
+}
+
+static void IoTHubTransportMqtt_UDS_Destroy(TRANSPORT_LL_HANDLE handle)
+{
+    IoTHubTransport_MQTT_Common_Destroy(handle);
+}
+
+static int IoTHubTransportMqtt_UDS_Subscribe(IOTHUB_DEVICE_HANDLE handle)
+{
+    return IoTHubTransport_MQTT_Common_Subscribe(handle);
+}
+
+static void IoTHubTransportMqtt_UDS_Unsubscribe(IOTHUB_DEVICE_HANDLE handle)
+{
+    IoTHubTransport_MQTT_Common_Unsubscribe(handle);
+}
+
+static int IoTHubTransportMqtt_UDS_Subscribe_DeviceMethod(IOTHUB_DEVICE_HANDLE handle)
+{
+    return IoTHubTransport_MQTT_Common_Subscribe_DeviceMethod(handle);
+}
+
+static void IoTHubTransportMqtt_UDS_Unsubscribe_DeviceMethod(IOTHUB_DEVICE_HANDLE handle)
+{
+    IoTHubTransport_MQTT_Common_Unsubscribe_DeviceMethod(handle);
+}
+
+static int IoTHubTransportMqtt_UDS_Subscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE handle)
+{
+    return IoTHubTransport_MQTT_Common_Subscribe_DeviceTwin(handle);
+}
+
+static void IoTHubTransportMqtt_UDS_Unsubscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE handle)
+{
+    IoTHubTransport_MQTT_Common_Unsubscribe_DeviceTwin(handle);
+}
+
+static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_UDS_GetTwinAsync(IOTHUB_DEVICE_HANDLE handle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK completionCallback, void* callbackContext)
+{
+    return IoTHubTransport_MQTT_Common_GetTwinAsync(handle, completionCallback, callbackContext);
+}
+
+static int IoTHubTransportMqtt_UDS_DeviceMethod_Response(IOTHUB_DEVICE_HANDLE handle, METHOD_HANDLE methodId, const unsigned char* response, size_t response_size, int status_response)
+{
+    return IoTHubTransport_MQTT_Common_DeviceMethod_Response(handle, methodId, response, response_size, status_response);
+}
+
+static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_UDS_SendMessageDisposition(MESSAGE_CALLBACK_INFO* message_data, IOTHUBMESSAGE_DISPOSITION_RESULT disposition)
+{
+    return IoTHubTransport_MQTT_Common_SendMessageDisposition(message_data, disposition);
+}
+
+static IOTHUB_PROCESS_ITEM_RESULT IoTHubTransportMqtt_UDS_ProcessItem(TRANSPORT_LL_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
+{
+    return IoTHubTransport_MQTT_Common_ProcessItem(handle, item_type, iothub_item);
+}
+
+static void IoTHubTransportMqtt_UDS_DoWork(TRANSPORT_LL_HANDLE handle)
+{
+    IoTHubTransport_MQTT_Common_DoWork(handle);
+}
+
+static int IoTHubTransportMqtt_UDS_SetRetryPolicy(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_RETRY_POLICY retryPolicy, size_t retryTimeoutLimitInSeconds)
+{
+    return IoTHubTransport_MQTT_Common_SetRetryPolicy(handle, retryPolicy, retryTimeoutLimitInSeconds);
+}
+
+static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_UDS_GetSendStatus(IOTHUB_DEVICE_HANDLE handle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
+{
+    return IoTHubTransport_MQTT_Common_GetSendStatus(handle, iotHubClientStatus);
+}
+
+static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_UDS_SetOption(TRANSPORT_LL_HANDLE handle, const char* option, const void* value)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (handle == NULL || option == NULL || value == NULL)
+    {
+        /* Codes_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_010: [ If `handle`, `option` or `value` is NULL, `IoTHubTransportMqtt_UDS_SetOption` shall return `IOTHUB_CLIENT_INVALID_ARG`. ] */
+        LogError("Invalid argument (handle=%p, option=%p, value=%p)", handle, option, value);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if (strcmp(OPTION_TRUSTED_CERT, option) == 0)
+    {
+        /* Codes_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_011: [ `IoTHubTransportMqtt_UDS_SetOption` shall ignore the `OPTION_TRUSTED_CERT` option and return `IOTHUB_CLIENT_OK`. ] */
+        // There is no TLS on the socket, the certificates set by IoTHubModuleClient_LL_CreateFromEnvironment have nothing to verify.
+        result = IOTHUB_CLIENT_OK;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_012: [ Otherwise `IoTHubTransportMqtt_UDS_SetOption` shall call into the `IoTHubTransport_MQTT_Common_SetOption` function. ] */
+        result = IoTHubTransport_MQTT_Common_SetOption(handle, option, value);
+    }
+
+    return result;
+}
+
+static IOTHUB_DEVICE_HANDLE IoTHubTransportMqtt_UDS_Register(TRANSPORT_LL_HANDLE handle, const IOTHUB_DEVICE_CONFIG* device, PDLIST_ENTRY waitingToSend)
+{
+    return IoTHubTransport_MQTT_Common_Register(handle, device, waitingToSend);
+}
+
+static void IoTHubTransportMqtt_UDS_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
+{
+    IoTHubTransport_MQTT_Common_Unregister(deviceHandle);
+}
+
+static STRING_HANDLE IoTHubTransportMqtt_UDS_GetHostname(TRANSPORT_LL_HANDLE handle)
+{
+    return IoTHubTransport_MQTT_Common_GetHostname(handle);
+}
+
+static int IotHubTransportMqtt_UDS_Subscribe_InputQueue(IOTHUB_DEVICE_HANDLE handle)
+{
+    return IoTHubTransport_MQTT_Common_Subscribe_InputQueue(handle);
+}
+
+static void IotHubTransportMqtt_UDS_Unsubscribe_InputQueue(IOTHUB_DEVICE_HANDLE handle)
+{
+    IoTHubTransport_MQTT_Common_Unsubscribe_InputQueue(handle);
+}
+
+static int IotHubTransportMqtt_UDS_SetCallbackContext(TRANSPORT_LL_HANDLE handle, void* ctx)
+{
+    return IoTHubTransport_MQTT_SetCallbackContext(handle, ctx);
+}
+
+static int IotHubTransportMqtt_UDS_GetSupportedPlatformInfo(TRANSPORT_LL_HANDLE handle, PLATFORM_INFO_OPTION* info)
+{
+    return IoTHubTransport_MQTT_GetSupportedPlatformInfo(handle, info);
+}
+
+static TRANSPORT_PROVIDER myfunc =
+{
+    IoTHubTransportMqtt_UDS_SendMessageDisposition,     /*pfIotHubTransport_SendMessageDisposition IoTHubTransport_SendMessageDisposition;*/
+    IoTHubTransportMqtt_UDS_Subscribe_DeviceMethod,     /*pfIoTHubTransport_Subscribe_DeviceMethod IoTHubTransport_Subscribe_DeviceMethod;*/
+    IoTHubTransportMqtt_UDS_Unsubscribe_DeviceMethod,   /*pfIoTHubTransport_Unsubscribe_DeviceMethod IoTHubTransport_Unsubscribe_DeviceMethod;*/
+    IoTHubTransportMqtt_UDS_DeviceMethod_Response,      /*pfIoTHubTransport_DeviceMethod_Response IoTHubTransport_DeviceMethod_Response;*/
+    IoTHubTransportMqtt_UDS_Subscribe_DeviceTwin,       /*pfIoTHubTransport_Subscribe_DeviceTwin IoTHubTransport_Subscribe_DeviceTwin;*/
+    IoTHubTransportMqtt_UDS_Unsubscribe_DeviceTwin,     /*pfIoTHubTransport_Unsubscribe_DeviceTwin IoTHubTransport_Unsubscribe_DeviceTwin;*/
+    IoTHubTransportMqtt_UDS_ProcessItem,                /*pfIoTHubTransport_ProcessItem IoTHubTransport_ProcessItem;*/
+    IoTHubTransportMqtt_UDS_GetHostname,                /*pfIoTHubTransport_GetHostname IoTHubTransport_GetHostname;*/
+    IoTHubTransportMqtt_UDS_SetOption,                  /*pfIoTHubTransport_SetOption IoTHubTransport_SetOption;*/
+    IoTHubTransportMqtt_UDS_Create,                     /*pfIoTHubTransport_Create IoTHubTransport_Create;*/
+    IoTHubTransportMqtt_UDS_Destroy,                    /*pfIoTHubTransport_Destroy IoTHubTransport_Destroy;*/
+    IoTHubTransportMqtt_UDS_Register,                   /*pfIotHubTransport_Register IoTHubTransport_Register;*/
+    IoTHubTransportMqtt_UDS_Unregister,                 /*pfIotHubTransport_Unregister IoTHubTransport_Unegister;*/
+    IoTHubTransportMqtt_UDS_Subscribe,                  /*pfIoTHubTransport_Subscribe IoTHubTransport_Subscribe;*/
+    IoTHubTransportMqtt_UDS_Unsubscribe,                /*pfIoTHubTransport_Unsubscribe IoTHubTransport_Unsubscribe;*/
+    IoTHubTransportMqtt_UDS_DoWork,                     /*pfIoTHubTransport_DoWork IoTHubTransport_DoWork;*/
+    IoTHubTransportMqtt_UDS_SetRetryPolicy,             /*pfIoTHubTransport_DoWork IoTHubTransport_SetRetryPolicy;*/
+    IoTHubTransportMqtt_UDS_GetSendStatus,              /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    IotHubTransportMqtt_UDS_Subscribe_InputQueue,       /*pfIoTHubTransport_Subscribe_InputQueue IoTHubTransport_Subscribe_InputQueue; */
+    IotHubTransportMqtt_UDS_Unsubscribe_InputQueue,     /*pfIoTHubTransport_Unsubscribe_InputQueue IoTHubTransport_Unsubscribe_InputQueue; */
+    IotHubTransportMqtt_UDS_SetCallbackContext,         /*pfIoTHubTransport_SetCallbackContext IoTHubTransport_SetCallbackContext; */
+    IoTHubTransportMqtt_UDS_GetTwinAsync,               /*pfIoTHubTransport_GetTwinAsync IoTHubTransport_GetTwinAsync;*/
+    IotHubTransportMqtt_UDS_GetSupportedPlatformInfo    /*pfIoTHubTransport_GetSupportedPlatformInfo IoTHubTransport_GetSupportedPlatformInfo;*/
+};
+
+/* Codes_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_013: [ `MQTT_UDS_Protocol` shall return a pointer to a structure of type TRANSPORT_PROVIDER whose other functions call into the IoTHubTransport_MQTT_Common functions. ] */
+extern const TRANSPORT_PROVIDER* MQTT_UDS_Protocol(void)
+{
+    return &myfunc;
+}
@@ -2,13 +2,14 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/agenttime.h"
 #include "azure_c_shared_utility/xlogging.h"
-#include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
 
 typedef struct MESSAGE_QUEUE_TAG MESSAGE_QUEUE;
 
@@ -16,12 +17,29 @@ typedef struct MESSAGE_QUEUE_TAG MESSAGE_QUEUE;
 
 #define RESULT_OK 0
 #define INDEFINITE_TIME ((time_t)(-1))
+// Must be a power of 2, as bucket indexes are computed with a bit mask.
+#define DEFAULT_IN_PROGRESS_INDEX_SIZE 16
 
 static const char* SAVED_OPTION_MAX_RETRY_COUNT = "SAVED_OPTION_MAX_RETRY_COUNT";
 static const char* SAVED_OPTION_MAX_ENQUEUE_TIME_SECS = "SAVED_OPTION_MAX_ENQUEUE_TIME_SECS";
 static const char* SAVED_OPTION_MAX_PROCESSING_TIME_SECS = "SAVED_OPTION_MAX_PROCESSING_TIME_SECS";
 
 
+typedef struct MESSAGE_QUEUE_ITEM_TAG
+{
+    MQ_MESSAGE_HANDLE message;
+    MESSAGE_PROCESSING_COMPLETED_CALLBACK on_message_processing_completed_callback;
+    void* user_context;
+    time_t enqueue_time;
+    time_t processing_start_time;
+    size_t number_of_attempts;
+
+    DLIST_ENTRY list_entry;                                     // Links the item into either `pending` or `in_progress`.
+    DLIST_ENTRY enqueue_time_entry;                             // Links the item into `by_enqueue_time`.
+    struct MESSAGE_QUEUE_ITEM_TAG* next_in_index_bucket;        // Only meaningful while the item is in `in_progress`.
+    bool is_in_progress;
+} MESSAGE_QUEUE_ITEM;
+
 struct MESSAGE_QUEUE_TAG
 {
     size_t max_message_enqueued_time_secs;
@@ -31,40 +49,113 @@ struct MESSAGE_QUEUE_TAG
     PROCESS_MESSAGE_CALLBACK on_process_message_callback;
     void* on_process_message_context;
 
-    SINGLYLINKEDLIST_HANDLE pending;
-    SINGLYLINKEDLIST_HANDLE in_progress;
+    DLIST_ENTRY pending;                                        // In the order items shall be processed.
+    DLIST_ENTRY in_progress;                                    // Ordered by `processing_start_time`.
+    DLIST_ENTRY by_enqueue_time;                                // All items, pending or in progress, ordered by `enqueue_time`.
+
+    // Hash index of the items in `in_progress` by message, so completions do not need to search the list.
+    MESSAGE_QUEUE_ITEM** in_progress_index;
+    size_t in_progress_index_size;
+    size_t in_progress_count;
 };
 
-typedef struct MESSAGE_QUEUE_ITEM_TAG
+
+
+// ---------- Helper Functions ---------- //
+
+static size_t get_in_progress_index_bucket(size_t index_size, MQ_MESSAGE_HANDLE message)
 {
-    MQ_MESSAGE_HANDLE message;
-    MESSAGE_PROCESSING_COMPLETED_CALLBACK on_message_processing_completed_callback;
-    void* user_context;
-    time_t enqueue_time;
-    time_t processing_start_time;
-    size_t number_of_attempts;
-} MESSAGE_QUEUE_ITEM;
+    // Messages are heap pointers, so the lowest bits are mostly alignment and are discarded.
+    return (size_t)(((uintptr_t)message >> 3) & (index_size - 1));
+}
 
+static void grow_in_progress_index(MESSAGE_QUEUE_HANDLE message_queue)
+{
+    size_t new_index_size = message_queue->in_progress_index_size * 2;
+    MESSAGE_QUEUE_ITEM** new_index;
 
+    if ((new_index = (MESSAGE_QUEUE_ITEM**)malloc(new_index_size * sizeof(MESSAGE_QUEUE_ITEM*))) == NULL)
+    {
+        // Not fatal; the current index still works, only with longer buckets.
+        LogError("failed growing the in-progress index (malloc failed)");
+    }
+    else
+    {
+        size_t i;
 
-// ---------- Helper Functions ---------- //
+        memset(new_index, 0, new_index_size * sizeof(MESSAGE_QUEUE_ITEM*));
+
+        for (i = 0; i < message_queue->in_progress_index_size; i++)
+        {
+            MESSAGE_QUEUE_ITEM* mq_item = message_queue->in_progress_index[i];
+
+            while (mq_item != NULL)
+            {
+                MESSAGE_QUEUE_ITEM* next_item = mq_item->next_in_index_bucket;
+                size_t bucket = get_in_progress_index_bucket(new_index_size, mq_item->message);
+
+                mq_item->next_in_index_bucket = new_index[bucket];
+                new_index[bucket] = mq_item;
+                mq_item = next_item;
+            }
+        }
 
-static bool find_item_by_message_ptr(LIST_ITEM_HANDLE list_item, const void* match_context)
+        free(message_queue->in_progress_index);
+        message_queue->in_progress_index = new_index;
+        message_queue->in_progress_index_size = new_index_size;
+    }
+}
+
+static void add_to_in_progress_index(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUEUE_ITEM* mq_item)
 {
-    bool result;
-    MESSAGE_QUEUE_ITEM* current_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
-    MQ_MESSAGE_HANDLE* target_item = (MQ_MESSAGE_HANDLE*)match_context;
+    size_t bucket;
 
-    if (current_item == NULL)
+    // Codes_SRS_MESSAGE_QUEUE_09_076: [If `message_queue->in_progress_index` holds as many items as it has buckets, its number of buckets shall be doubled]
+    if (message_queue->in_progress_count >= message_queue->in_progress_index_size)
     {
-        LogError("Failed finding item: current_item is NULL");
-        result = false;
+        // Codes_SRS_MESSAGE_QUEUE_09_077: [If `message_queue->in_progress_index` fails to be grown, the current index shall be kept]
+        grow_in_progress_index(message_queue);
+    }
+
+    bucket = get_in_progress_index_bucket(message_queue->in_progress_index_size, mq_item->message);
+    mq_item->next_in_index_bucket = message_queue->in_progress_index[bucket];
+    message_queue->in_progress_index[bucket] = mq_item;
+    mq_item->is_in_progress = true;
+    message_queue->in_progress_count++;
+}
+
+static void remove_from_in_progress_index(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUEUE_ITEM* mq_item)
+{
+    MESSAGE_QUEUE_ITEM** link = &message_queue->in_progress_index[get_in_progress_index_bucket(message_queue->in_progress_index_size, mq_item->message)];
+
+    while (*link != NULL && *link != mq_item)
+    {
+        link = &(*link)->next_in_index_bucket;
+    }
+
+    if (*link == NULL)
+    {
+        LogError("internal error, message not found in the in-progress index (%p)", mq_item->message);
     }
     else
     {
-        result = (current_item->message == target_item);
+        *link = mq_item->next_in_index_bucket;
+        mq_item->next_in_index_bucket = NULL;
+        mq_item->is_in_progress = false;
+        message_queue->in_progress_count--;
     }
-    return result;
+}
+
+static MESSAGE_QUEUE_ITEM* find_in_progress_item(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE message)
+{
+    MESSAGE_QUEUE_ITEM* mq_item = message_queue->in_progress_index[get_in_progress_index_bucket(message_queue->in_progress_index_size, message)];
+
+    while (mq_item != NULL && mq_item->message != message)
+    {
+        mq_item = mq_item->next_in_index_bucket;
+    }
+
+    return mq_item;
 }
 
 static void fire_message_callback(MESSAGE_QUEUE_ITEM* mq_item, MESSAGE_QUEUE_RESULT result, void* reason)
@@ -85,39 +176,22 @@ static bool should_retry_sending(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUE
     return (result == MESSAGE_QUEUE_RETRYABLE_ERROR && mq_item->number_of_attempts <= message_queue->max_retry_count);
 }
 
-static int retry_sending_message(MESSAGE_QUEUE_HANDLE message_queue, LIST_ITEM_HANDLE list_item)
+static void retry_sending_message(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUEUE_ITEM* mq_item)
 {
-    int result;
-    MESSAGE_QUEUE_ITEM* mq_item;
-
-    mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
-
-    if (singlylinkedlist_remove(message_queue->in_progress, list_item))
-    {
-        LogError("Failed removing message from in-progress list");
-        result = MU_FAILURE;
-    }
-    else if (singlylinkedlist_add(message_queue->pending, (const void*)mq_item) == NULL)
-    {
-        LogError("Failed moving message back to pending list");
-        result = MU_FAILURE;
-    }
-    else
-    {
-        result = RESULT_OK;
-    }
-
-    return result;
+    (void)DList_RemoveEntryList(&mq_item->list_entry);
+    remove_from_in_progress_index(message_queue, mq_item);
+    DList_InsertTailList(&message_queue->pending, &mq_item->list_entry);
 }
 
-static void dequeue_message_and_fire_callback(SINGLYLINKEDLIST_HANDLE list, LIST_ITEM_HANDLE list_item, MESSAGE_QUEUE_RESULT result, void* reason)
+static void dequeue_message_and_fire_callback(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUEUE_ITEM* mq_item, MESSAGE_QUEUE_RESULT result, void* reason)
 {
-    MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
-
     // Codes_SRS_MESSAGE_QUEUE_09_045: [If `message` is present in `message_queue->in_progress`, it shall be removed]
-    if (singlylinkedlist_remove(list, list_item))
+    (void)DList_RemoveEntryList(&mq_item->list_entry);
+    (void)DList_RemoveEntryList(&mq_item->enqueue_time_entry);
+
+    if (mq_item->is_in_progress)
     {
-        LogError("failed removing message from list (%p)", list);
+        remove_from_in_progress_index(message_queue, mq_item);
     }
 
     // Codes_SRS_MESSAGE_QUEUE_09_049: [Otherwise `mq_item->on_message_processing_completed_callback` shall be invoked passing `mq_item->message`, `result`, `reason` and `mq_item->user_context`]
@@ -136,23 +210,22 @@ static void on_process_message_completed_callback(MESSAGE_QUEUE_HANDLE message_q
     }
     else
     {
-        LIST_ITEM_HANDLE list_item;
+        MESSAGE_QUEUE_ITEM* mq_item;
 
-        if ((list_item = singlylinkedlist_find(message_queue->in_progress, find_item_by_message_ptr, message)) == NULL)
+        if ((mq_item = find_in_progress_item(message_queue, message)) == NULL)
         {
             // Codes_SRS_MESSAGE_QUEUE_09_044: [If `message` is not present in `message_queue->in_progress`, it shall be ignored]
             LogError("on_process_message_completed_callback invoked for a message not in the in-progress list (%p)", message);
         }
+        // Codes_SRS_MESSAGE_QUEUE_09_047: [If `result` is MESSAGE_QUEUE_RETRYABLE_ERROR and `mq_item->number_of_attempts` is less than or equal `message_queue->max_retry_count`, the `message` shall be moved to `message_queue->pending` to be re-sent]
+        else if (should_retry_sending(message_queue, mq_item, result))
+        {
+            retry_sending_message(message_queue, mq_item);
+        }
         else
         {
-            MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
-
-            // Codes_SRS_MESSAGE_QUEUE_09_047: [If `result` is MESSAGE_QUEUE_RETRYABLE_ERROR and `mq_item->number_of_attempts` is less than or equal `message_queue->max_retry_count`, the `message` shall be moved to `message_queue->pending` to be re-sent]
             // Codes_SRS_MESSAGE_QUEUE_09_048: [If `result` is MESSAGE_QUEUE_RETRYABLE_ERROR and `mq_item->number_of_attempts` is greater than `message_queue->max_retry_count`, result shall be changed to MESSAGE_QUEUE_ERROR]
-            if (!should_retry_sending(message_queue, mq_item, result) || retry_sending_message(message_queue, list_item) != RESULT_OK)
-            {
-                dequeue_message_and_fire_callback(message_queue->in_progress, list_item, result, reason);
-            }
+            dequeue_message_and_fire_callback(message_queue, mq_item, result, reason);
         }
     }
 }
@@ -167,74 +240,37 @@ static void process_timeouts(MESSAGE_QUEUE_HANDLE message_queue)
     }
     else
     {
-        // Codes_SRS_MESSAGE_QUEUE_09_035: [If `message_queue->max_message_enqueued_time_secs` is greater than zero, `message_queue->in_progress` and `message_queue->pending` items shall be checked for timeout]
+        // Codes_SRS_MESSAGE_QUEUE_09_035: [If `message_queue->max_message_enqueued_time_secs` is greater than zero, `message_queue->by_enqueue_time` items shall be checked for timeout, oldest first, until one has not expired]
         if (message_queue->max_message_enqueued_time_secs > 0)
         {
-            LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(message_queue->pending);
-
-            while (list_item != NULL)
+            while (!DList_IsListEmpty(&message_queue->by_enqueue_time))
             {
-                LIST_ITEM_HANDLE current_list_item = list_item;
-                MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(current_list_item);
-
-                list_item = singlylinkedlist_get_next_item(list_item);
+                MESSAGE_QUEUE_ITEM* mq_item = containingRecord(message_queue->by_enqueue_time.Flink, MESSAGE_QUEUE_ITEM, enqueue_time_entry);
 
-                if (mq_item == NULL)
-                {
-                    LogError("failed processing timeouts (unexpected NULL pointer to MESSAGE_QUEUE_ITEM)");
-                }
-                else if (get_difftime(current_time, mq_item->enqueue_time) >= message_queue->max_message_enqueued_time_secs)
+                if (get_difftime(current_time, mq_item->enqueue_time) >= message_queue->max_message_enqueued_time_secs)
                 {
                     // Codes_SRS_MESSAGE_QUEUE_09_036: [If any items are in `message_queue` lists for `message_queue->max_message_enqueued_time_secs` or more, they shall be removed and `message_queue->on_message_processing_completed_callback` invoked with MESSAGE_QUEUE_TIMEOUT]
-                    dequeue_message_and_fire_callback(message_queue->pending, current_list_item, MESSAGE_QUEUE_TIMEOUT, NULL);
+                    dequeue_message_and_fire_callback(message_queue, mq_item, MESSAGE_QUEUE_TIMEOUT, NULL);
                 }
                 else
                 {
-                    // The pending list order is already based on enqueue time, so if one message is not expired, later ones won't be either.
+                    // Items are appended to `by_enqueue_time` as they are added, so later ones have not expired either.
                     break;
                 }
             }
-
-            list_item = singlylinkedlist_get_head_item(message_queue->in_progress);
-
-            while (list_item != NULL)
-            {
-                LIST_ITEM_HANDLE current_list_item = list_item;
-                MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(current_list_item);
-
-                list_item = singlylinkedlist_get_next_item(list_item);
-
-                if (mq_item == NULL)
-                {
-                    LogError("failed processing timeouts (unexpected NULL pointer to MESSAGE_QUEUE_ITEM)");
-                }
-                else if (get_difftime(current_time, mq_item->enqueue_time) >= message_queue->max_message_enqueued_time_secs)
-                {
-                    // Codes_SRS_MESSAGE_QUEUE_09_038: [If any items are in `message_queue->in_progress` for `message_queue->max_message_processing_time_secs` or more, they shall be removed and `message_queue->on_message_processing_completed_callback` invoked with MESSAGE_QUEUE_TIMEOUT]
-                    dequeue_message_and_fire_callback(message_queue->in_progress, current_list_item, MESSAGE_QUEUE_TIMEOUT, NULL);
-                }
-            }
         }
 
-        // Codes_SRS_MESSAGE_QUEUE_09_037: [If `message_queue->max_message_processing_time_secs` is greater than zero, `message_queue->in_progress` items shall be checked for timeout]
+        // Codes_SRS_MESSAGE_QUEUE_09_037: [If `message_queue->max_message_processing_time_secs` is greater than zero, `message_queue->in_progress` items shall be checked for timeout, oldest first, until one has not expired]
         if (message_queue->max_message_processing_time_secs > 0)
         {
-            LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(message_queue->in_progress);
-
-            while (list_item != NULL)
+            while (!DList_IsListEmpty(&message_queue->in_progress))
             {
-                LIST_ITEM_HANDLE current_list_item = list_item;
-                MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(current_list_item);
+                MESSAGE_QUEUE_ITEM* mq_item = containingRecord(message_queue->in_progress.Flink, MESSAGE_QUEUE_ITEM, list_entry);
 
-                list_item = singlylinkedlist_get_next_item(list_item);
-
-                if (mq_item == NULL)
-                {
-                    LogError("failed processing timeouts (unexpected NULL pointer to MESSAGE_QUEUE_ITEM)");
-                }
-                else if (get_difftime(current_time, mq_item->processing_start_time) >= message_queue->max_message_processing_time_secs)
+                if (get_difftime(current_time, mq_item->processing_start_time) >= message_queue->max_message_processing_time_secs)
                 {
-                    dequeue_message_and_fire_callback(message_queue->in_progress, current_list_item, MESSAGE_QUEUE_TIMEOUT, NULL);
+                    // Codes_SRS_MESSAGE_QUEUE_09_038: [If any items are in `message_queue->in_progress` for `message_queue->max_message_processing_time_secs` or more, they shall be removed and `message_queue->on_message_processing_completed_callback` invoked with MESSAGE_QUEUE_TIMEOUT]
+                    dequeue_message_and_fire_callback(message_queue, mq_item, MESSAGE_QUEUE_TIMEOUT, NULL);
                 }
                 else
                 {
@@ -248,49 +284,18 @@ static void process_timeouts(MESSAGE_QUEUE_HANDLE message_queue)
 
 static void process_pending_messages(MESSAGE_QUEUE_HANDLE message_queue)
 {
-    LIST_ITEM_HANDLE list_item;
+    PDLIST_ENTRY list_entry;
 
-    while ((list_item = singlylinkedlist_get_head_item(message_queue->pending)) != NULL)
+    while ((list_entry = DList_RemoveHeadList(&message_queue->pending)) != &message_queue->pending)
     {
-        MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
-
-        if (mq_item == NULL)
-        {
-            LogError("internal error, failed to retrieve list node value");
-            break;
-        }
-        else if (singlylinkedlist_remove(message_queue->pending, list_item) != 0)
-        {
-            LogError("failed moving message out of pending list (%p)", mq_item->message);
-
-            // Codes_SRS_MESSAGE_QUEUE_09_042: [If any failures occur, `mq_item->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_ERROR and `mq_item` freed]
-            if (mq_item->on_message_processing_completed_callback != NULL)
-            {
-                mq_item->on_message_processing_completed_callback(mq_item->message, MESSAGE_QUEUE_ERROR, NULL, mq_item->user_context);
-            }
+        MESSAGE_QUEUE_ITEM* mq_item = containingRecord(list_entry, MESSAGE_QUEUE_ITEM, list_entry);
 
-            // Not freeing since this would cause a memory A/V on the next call.
-
-            break; // Trying to avoid an infinite loop
-        }
         // Codes_SRS_MESSAGE_QUEUE_09_040: [`mq_item->processing_start_time` shall be set using get_time()]
-        else if ((mq_item->processing_start_time = get_time(NULL)) == INDEFINITE_TIME)
+        if ((mq_item->processing_start_time = get_time(NULL)) == INDEFINITE_TIME)
         {
-            // Codes_SRS_MESSAGE_QUEUE_09_041: [If get_time() fails, `mq_item` shall be removed from `message_queue->in_progress`]
+            // Codes_SRS_MESSAGE_QUEUE_09_041: [If get_time() fails, `mq_item` shall be removed from `message_queue->by_enqueue_time`]
             LogError("failed setting message processing_start_time (%p)", mq_item->message);
-
-            // Codes_SRS_MESSAGE_QUEUE_09_042: [If any failures occur, `mq_item->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_ERROR and `mq_item` freed]
-            if (mq_item->on_message_processing_completed_callback != NULL)
-            {
-                mq_item->on_message_processing_completed_callback(mq_item->message, MESSAGE_QUEUE_ERROR, NULL, mq_item->user_context);
-            }
-
-            free(mq_item);
-        }
-        // Codes_SRS_MESSAGE_QUEUE_09_039: [Each `mq_item` in `message_queue->pending` shall be moved to `message_queue->in_progress`]
-        else if (singlylinkedlist_add(message_queue->in_progress, (const void*)mq_item) == NULL)
-        {
-            LogError("failed moving message to in-progress list (%p)", mq_item->message);
+            (void)DList_RemoveEntryList(&mq_item->enqueue_time_entry);
 
             // Codes_SRS_MESSAGE_QUEUE_09_042: [If any failures occur, `mq_item->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_ERROR and `mq_item` freed]
             if (mq_item->on_message_processing_completed_callback != NULL)
@@ -302,6 +307,9 @@ static void process_pending_messages(MESSAGE_QUEUE_HANDLE message_queue)
         }
         else
         {
+            // Codes_SRS_MESSAGE_QUEUE_09_039: [Each `mq_item` in `message_queue->pending` shall be moved to `message_queue->in_progress`]
+            DList_InsertTailList(&message_queue->in_progress, &mq_item->list_entry);
+            add_to_in_progress_index(message_queue, mq_item);
             mq_item->number_of_attempts++;
 
             // Codes_SRS_MESSAGE_QUEUE_09_043: [If no failures occur, `message_queue->on_process_message_callback` shall be invoked passing `mq_item->message` and `on_process_message_completed_callback`]
@@ -368,61 +376,23 @@ void message_queue_remove_all(MESSAGE_QUEUE_HANDLE message_queue)
     // Codes_SRS_MESSAGE_QUEUE_09_026: [If `message_queue` is NULL, message_queue_retrieve_options shall return]
     if (message_queue != NULL)
     {
-        LIST_ITEM_HANDLE list_item;
-
         // Codes_SRS_MESSAGE_QUEUE_09_027: [Each `mq_item` in `message_queue->pending` and `message_queue->in_progress` lists shall be removed]
-        while ((list_item = singlylinkedlist_get_head_item(message_queue->in_progress)) != NULL)
+        while (!DList_IsListEmpty(&message_queue->in_progress))
         {
             // Codes_SRS_MESSAGE_QUEUE_09_028: [`message_queue->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_CANCELLED for each `mq_item` removed]
             // Codes_SRS_MESSAGE_QUEUE_09_029: [Each `mq_item` shall be freed]
-            dequeue_message_and_fire_callback(message_queue->in_progress, list_item, MESSAGE_QUEUE_CANCELLED, NULL);
+            dequeue_message_and_fire_callback(message_queue, containingRecord(message_queue->in_progress.Flink, MESSAGE_QUEUE_ITEM, list_entry), MESSAGE_QUEUE_CANCELLED, NULL);
         }
 
-        while ((list_item = singlylinkedlist_get_head_item(message_queue->pending)) != NULL)
+        while (!DList_IsListEmpty(&message_queue->pending))
         {
             // Codes_SRS_MESSAGE_QUEUE_09_028: [`message_queue->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_CANCELLED for each `mq_item` removed]
             // Codes_SRS_MESSAGE_QUEUE_09_029: [Each `mq_item` shall be freed]
-            dequeue_message_and_fire_callback(message_queue->pending, list_item, MESSAGE_QUEUE_CANCELLED, NULL);
+            dequeue_message_and_fire_callback(message_queue, containingRecord(message_queue->pending.Flink, MESSAGE_QUEUE_ITEM, list_entry), MESSAGE_QUEUE_CANCELLED, NULL);
         }
     }
 }
 
-static int move_messages_between_lists(SINGLYLINKEDLIST_HANDLE from_list, SINGLYLINKEDLIST_HANDLE to_list)
-{
-    int result;
-    LIST_ITEM_HANDLE list_item;
-
-    result = RESULT_OK;
-
-    while ((list_item = singlylinkedlist_get_head_item(from_list)) != NULL)
-    {
-        MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
-
-        if (singlylinkedlist_remove(from_list, list_item) != 0)
-        {
-            LogError("failed removing message from list");
-            result = MU_FAILURE;
-            break;
-        }
-        else if (mq_item == NULL)
-        {
-            LogError("failed moving message to list");
-            result = MU_FAILURE;
-            break;
-        }
-        else if (singlylinkedlist_add(to_list, (const void*)mq_item) == NULL)
-        {
-            LogError("failed moving message to list");
-            fire_message_callback(mq_item, MESSAGE_QUEUE_CANCELLED, NULL);
-            free(mq_item);
-            result = MU_FAILURE;
-            break;
-        }
-    }
-
-    return result;
-}
-
 int message_queue_move_all_back_to_pending(MESSAGE_QUEUE_HANDLE message_queue)
 {
     int result;
@@ -436,27 +406,17 @@ int message_queue_move_all_back_to_pending(MESSAGE_QUEUE_HANDLE message_queue)
     else
     {
         // Codes_SRS_MESSAGE_QUEUE_21_070: [The message_queue_move_all_back_to_pending shall add all in_progress message in front of the pending messages.]
-        if (move_messages_between_lists(message_queue->pending, message_queue->in_progress) != 0)
-        {
-            LogError("failed moving pending messages at the end of in-progress");
-            result = MU_FAILURE;
-        }
-        else if (move_messages_between_lists(message_queue->in_progress, message_queue->pending) != 0)
+        // Moving from the tail of in-progress to the head of pending keeps the original order.
+        while (!DList_IsListEmpty(&message_queue->in_progress))
         {
-            LogError("failed moving all in-progress messages back to pending");
-            result = MU_FAILURE;
-        }
-        else
-        {
-            result = RESULT_OK;
-        }
+            MESSAGE_QUEUE_ITEM* mq_item = containingRecord(message_queue->in_progress.Blink, MESSAGE_QUEUE_ITEM, list_entry);
 
-        // Codes_SRS_MESSAGE_QUEUE_21_072: [If move pending messages failed, the message_queue_move_all_back_to_pending shall delete all elements in the queue and return non-zero.]
-        // Codes_SRS_MESSAGE_QUEUE_21_073: [If move in_progress messages failed, the message_queue_move_all_back_to_pending shall delete all elements in the queue and return non-zero.]
-        if (result != RESULT_OK)
-        {
-            message_queue_remove_all(message_queue);
+            (void)DList_RemoveEntryList(&mq_item->list_entry);
+            remove_from_in_progress_index(message_queue, mq_item);
+            DList_InsertHeadList(&message_queue->pending, &mq_item->list_entry);
         }
+
+        result = RESULT_OK;
     }
 
     return result;
@@ -471,16 +431,7 @@ void message_queue_destroy(MESSAGE_QUEUE_HANDLE message_queue)
         message_queue_remove_all(message_queue);
 
         // Codes_SRS_MESSAGE_QUEUE_09_015: [message_queue_destroy shall free all memory allocated and pointed by `message_queue`]
-        if (message_queue->pending != NULL)
-        {
-            singlylinkedlist_destroy(message_queue->pending);
-        }
-
-        if (message_queue->in_progress != NULL)
-        {
-            singlylinkedlist_destroy(message_queue->in_progress);
-        }
-
+        free(message_queue->in_progress_index);
         free(message_queue);
     }
 }
@@ -512,29 +463,27 @@ MESSAGE_QUEUE_HANDLE message_queue_create(MESSAGE_QUEUE_CONFIG* config)
     {
         memset(result, 0, sizeof(MESSAGE_QUEUE));
 
-        // Codes_SRS_MESSAGE_QUEUE_09_006: [`message_queue->pending` shall be set using singlylinkedlist_create()]
-        if ((result->pending = singlylinkedlist_create()) == NULL)
-        {
-            // Codes_SRS_MESSAGE_QUEUE_09_007: [If singlylinkedlist_create fails, message_queue_create shall fail and return NULL]
-            LogError("failed allocating MESSAGE_QUEUE pending list");
-            // Codes_SRS_MESSAGE_QUEUE_09_011: [If any failures occur, message_queue_create shall release all memory it has allocated]
-            message_queue_destroy(result);
-            result = NULL;
-        }
-        // Codes_SRS_MESSAGE_QUEUE_09_008: [`message_queue->in_progress` shall be set using singlylinkedlist_create()]
-        else if ((result->in_progress = singlylinkedlist_create()) == NULL)
+        // Codes_SRS_MESSAGE_QUEUE_09_006: [`message_queue->pending`, `message_queue->in_progress` and `message_queue->by_enqueue_time` shall be initialized using DList_InitializeListHead()]
+        DList_InitializeListHead(&result->pending);
+        DList_InitializeListHead(&result->in_progress);
+        DList_InitializeListHead(&result->by_enqueue_time);
+
+        // Codes_SRS_MESSAGE_QUEUE_09_074: [`message_queue->in_progress_index` shall be allocated with DEFAULT_IN_PROGRESS_INDEX_SIZE buckets]
+        if ((result->in_progress_index = (MESSAGE_QUEUE_ITEM**)malloc(DEFAULT_IN_PROGRESS_INDEX_SIZE * sizeof(MESSAGE_QUEUE_ITEM*))) == NULL)
         {
-            // Codes_SRS_MESSAGE_QUEUE_09_009: [If singlylinkedlist_create fails, message_queue_create shall fail and return NULL]
-            LogError("failed allocating MESSAGE_QUEUE in-progress list");
+            // Codes_SRS_MESSAGE_QUEUE_09_075: [If `message_queue->in_progress_index` cannot be allocated, message_queue_create shall fail and return NULL]
+            LogError("failed allocating MESSAGE_QUEUE in-progress index");
             // Codes_SRS_MESSAGE_QUEUE_09_011: [If any failures occur, message_queue_create shall release all memory it has allocated]
-            message_queue_destroy(result);
+            free(result);
             result = NULL;
         }
         else
         {
+            memset(result->in_progress_index, 0, DEFAULT_IN_PROGRESS_INDEX_SIZE * sizeof(MESSAGE_QUEUE_ITEM*));
+            result->in_progress_index_size = DEFAULT_IN_PROGRESS_INDEX_SIZE;
+
             // Codes_SRS_MESSAGE_QUEUE_09_010: [All arguments in `config` shall be saved into `message_queue`]
             // Codes_SRS_MESSAGE_QUEUE_09_012: [If no failures occur, message_queue_create shall return the `message_queue` pointer]
-
             result->max_message_enqueued_time_secs = config->max_message_enqueued_time_secs;
             result->max_message_processing_time_secs = config->max_message_processing_time_secs;
             result->max_retry_count = config->max_retry_count;
@@ -579,15 +528,6 @@ int message_queue_add(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE mess
                 free(mq_item);
                 result = MU_FAILURE;
             }
-            // Codes_SRS_MESSAGE_QUEUE_09_021: [`mq_item` shall be added to `message_queue->pending` list]
-            else if (singlylinkedlist_add(message_queue->pending, (const void*)mq_item) == NULL)
-            {
-                // Codes_SRS_MESSAGE_QUEUE_09_022: [`mq_item` fails to be added to `message_queue->pending`, message_queue_add shall fail and return non-zero]
-                LogError("failed enqueing message");
-                // Codes_SRS_MESSAGE_QUEUE_09_024: [If any failures occur, message_queue_add shall release all memory it has allocated]
-                free(mq_item);
-                result = MU_FAILURE;
-            }
             else
             {
                 // Codes_SRS_MESSAGE_QUEUE_09_023: [`message` shall be saved into `mq_item->message`]
@@ -595,6 +535,11 @@ int message_queue_add(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE mess
                 mq_item->on_message_processing_completed_callback = on_message_processing_completed_callback;
                 mq_item->user_context = user_context;
                 mq_item->processing_start_time = INDEFINITE_TIME;
+
+                // Codes_SRS_MESSAGE_QUEUE_09_021: [`mq_item` shall be added to the tail of `message_queue->pending` and `message_queue->by_enqueue_time`]
+                DList_InsertTailList(&message_queue->pending, &mq_item->list_entry);
+                DList_InsertTailList(&message_queue->by_enqueue_time, &mq_item->enqueue_time_entry);
+
                 // Codes_SRS_MESSAGE_QUEUE_09_025: [If no failures occur, message_queue_add shall return 0]
                 result = RESULT_OK;
             }
@@ -618,7 +563,7 @@ int message_queue_is_empty(MESSAGE_QUEUE_HANDLE message_queue, bool* is_empty)
     {
         // Codes_SRS_MESSAGE_QUEUE_09_031: [If `message_queue->pending` and `message_queue->in_progress` are empty, `is_empty` shall be set to true]
         // Codes_SRS_MESSAGE_QUEUE_09_032: [Otherwise `is_empty` shall be set to false]
-        *is_empty = (singlylinkedlist_get_head_item(message_queue->pending) == NULL && singlylinkedlist_get_head_item(message_queue->in_progress) == NULL);
+        *is_empty = (DList_IsListEmpty(&message_queue->pending) && DList_IsListEmpty(&message_queue->in_progress));
         // Codes_SRS_MESSAGE_QUEUE_09_033: [If no failures occur, message_queue_is_empty shall return 0]
         result = RESULT_OK;
     }
@@ -15,6 +15,7 @@
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/uuid.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_uamqp_c/amqp_definitions.h"
 #include "azure_uamqp_c/message.h"
 #include "azure_uamqp_c/amqpvalue.h"
@@ -32,6 +33,38 @@
 #define AMQP_DIAGNOSTIC_CONTEXT_KEY "Correlation-Context"
 #define AMQP_DIAGNOSTIC_CREATION_TIME_UTC_KEY "creationtimeutc"
 
+#define AMQP_FORMAT_CODE_DESCRIBED 0x00
+#define AMQP_FORMAT_CODE_SMALLULONG 0x53
+#define AMQP_FORMAT_CODE_VBIN8 0xa0
+#define AMQP_FORMAT_CODE_STR8 0xa1
+#define AMQP_FORMAT_CODE_VBIN32 0xb0
+#define AMQP_FORMAT_CODE_STR32 0xb1
+#define AMQP_FORMAT_CODE_MAP32 0xd1
+#define AMQP_APPLICATION_PROPERTIES_DESCRIPTOR 0x74
+#define AMQP_DATA_DESCRIPTOR 0x75
+#define AMQP_MAX_SMALL_VARIABLE_WIDTH_LENGTH 255
+#define AMQP_MAX_VARIABLE_WIDTH_HEADER_SIZE 5
+
+#define ENCODING_CACHE_MAX_PROPERTY_KEYS 16
+#define ENCODING_CACHE_INITIAL_BUFFER_SIZE 256
+
+typedef struct ENCODED_PROPERTY_KEY_TAG
+{
+    char* key;
+    unsigned char* encoded;
+    size_t encoded_length;
+} ENCODED_PROPERTY_KEY;
+
+// Per-device state reused across calls to message_create_uamqp_encoding_from_iothub_message_with_cache.
+typedef struct MESSAGE_ENCODING_CACHE_INSTANCE_TAG
+{
+    ENCODED_PROPERTY_KEY property_keys[ENCODING_CACHE_MAX_PROPERTY_KEYS];
+    size_t property_key_count;
+    unsigned char* encoding_buffer;
+    size_t encoding_buffer_size;
+    size_t encoded_length;
+} MESSAGE_ENCODING_CACHE_INSTANCE;
+
 static int encode_callback(void* context, const unsigned char* bytes, size_t length)
 {
     BINARY_DATA* message_body_binary = (BINARY_DATA*)context;
@@ -596,23 +629,23 @@ static int create_message_annotations_to_encode(IOTHUB_MESSAGE_HANDLE messageHan
     return result;
 }
 
-// Codes_SRS_UAMQP_MESSAGING_31_118: [Gets data associated with IOTHUB_MESSAGE_HANDLE to encode, either from underlying byte array or string format.]
-static int create_data_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE *data_value, size_t *data_length)
+static int get_message_body(IOTHUB_MESSAGE_HANDLE messageHandle, const char** messageContent, size_t* messageContentSize)
 {
     int result;
 
     IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(messageHandle);
-    const char* messageContent = NULL;
-    size_t messageContentSize = 0;
+
+    *messageContent = NULL;
+    *messageContentSize = 0;
 
     if ((contentType == IOTHUBMESSAGE_BYTEARRAY) &&
-        IoTHubMessage_GetByteArray(messageHandle, (const unsigned char **)&messageContent, &messageContentSize) != IOTHUB_MESSAGE_OK)
+        IoTHubMessage_GetByteArray(messageHandle, (const unsigned char **)messageContent, messageContentSize) != IOTHUB_MESSAGE_OK)
     {
         LogError("Failed getting the BYTE array representation of the IOTHUB_MESSAGE_HANDLE instance.");
         result = MU_FAILURE;
     }
     else if ((contentType == IOTHUBMESSAGE_STRING) &&
-        ((messageContent = IoTHubMessage_GetString(messageHandle)) == NULL))
+        ((*messageContent = IoTHubMessage_GetString(messageHandle)) == NULL))
     {
         LogError("Failed getting the STRING representation of the IOTHUB_MESSAGE_HANDLE instance.");
         result = MU_FAILURE;
@@ -626,9 +659,30 @@ static int create_data_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE
     {
         if (contentType == IOTHUBMESSAGE_STRING)
         {
-            messageContentSize = strlen(messageContent);
+            *messageContentSize = strlen(*messageContent);
         }
 
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+// Codes_SRS_UAMQP_MESSAGING_31_118: [Gets data associated with IOTHUB_MESSAGE_HANDLE to encode, either from underlying byte array or string format.]
+static int create_data_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE *data_value, size_t *data_length)
+{
+    int result;
+
+    const char* messageContent;
+    size_t messageContentSize;
+
+    if (get_message_body(messageHandle, &messageContent, &messageContentSize) != RESULT_OK)
+    {
+        LogError("Failed getting the body of the IOTHUB_MESSAGE_HANDLE instance.");
+        result = MU_FAILURE;
+    }
+    else
+    {
         data bin_data;
         bin_data.bytes = (const unsigned char *)messageContent;
         bin_data.length = (uint32_t)messageContentSize;
@@ -745,6 +799,382 @@ int message_create_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_bat
     return result;
 }
 
+static void write_uint32_big_endian(unsigned char* destination, uint32_t value)
+{
+    destination[0] = (unsigned char)((value >> 24) & 0xFF);
+    destination[1] = (unsigned char)((value >> 16) & 0xFF);
+    destination[2] = (unsigned char)((value >> 8) & 0xFF);
+    destination[3] = (unsigned char)(value & 0xFF);
+}
+
+// Writes the AMQP constructor and length of a variable-width value (string or binary), picking the
+// one-byte length form whenever possible. Returns the number of bytes written to `header`.
+static size_t write_variable_width_header(unsigned char* header, unsigned char format_code_8, unsigned char format_code_32, size_t length)
+{
+    size_t header_length;
+
+    if (length <= AMQP_MAX_SMALL_VARIABLE_WIDTH_LENGTH)
+    {
+        header[0] = format_code_8;
+        header[1] = (unsigned char)length;
+        header_length = 2;
+    }
+    else
+    {
+        header[0] = format_code_32;
+        write_uint32_big_endian(header + 1, (uint32_t)length);
+        header_length = 5;
+    }
+
+    return header_length;
+}
+
+static int ensure_encoding_buffer_capacity(MESSAGE_ENCODING_CACHE_INSTANCE* encoding_cache, size_t additional_length)
+{
+    int result;
+    size_t required_size = encoding_cache->encoded_length + additional_length;
+
+    if (required_size <= encoding_cache->encoding_buffer_size)
+    {
+        result = RESULT_OK;
+    }
+    else
+    {
+        size_t new_size = (encoding_cache->encoding_buffer_size == 0 ? ENCODING_CACHE_INITIAL_BUFFER_SIZE : encoding_cache->encoding_buffer_size);
+        unsigned char* new_buffer;
+
+        while (new_size < required_size)
+        {
+            new_size *= 2;
+        }
+
+        if ((new_buffer = (unsigned char*)realloc(encoding_cache->encoding_buffer, new_size)) == NULL)
+        {
+            LogError("Failed growing the encoding buffer to %lu bytes", (unsigned long)new_size);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            encoding_cache->encoding_buffer = new_buffer;
+            encoding_cache->encoding_buffer_size = new_size;
+            result = RESULT_OK;
+        }
+    }
+
+    return result;
+}
+
+static int append_to_encoding_buffer(MESSAGE_ENCODING_CACHE_INSTANCE* encoding_cache, const unsigned char* bytes, size_t length)
+{
+    int result;
+
+    if (ensure_encoding_buffer_capacity(encoding_cache, length) != RESULT_OK)
+    {
+        result = MU_FAILURE;
+    }
+    else
+    {
+        (void)memcpy(encoding_cache->encoding_buffer + encoding_cache->encoded_length, bytes, length);
+        encoding_cache->encoded_length += length;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+static int encoding_cache_encode_callback(void* context, const unsigned char* bytes, size_t length)
+{
+    return append_to_encoding_buffer((MESSAGE_ENCODING_CACHE_INSTANCE*)context, bytes, length);
+}
+
+static int append_variable_width_value(MESSAGE_ENCODING_CACHE_INSTANCE* encoding_cache, unsigned char format_code_8, unsigned char format_code_32, const unsigned char* value, size_t length)
+{
+    int result;
+    unsigned char header[AMQP_MAX_VARIABLE_WIDTH_HEADER_SIZE];
+    size_t header_length = write_variable_width_header(header, format_code_8, format_code_32, length);
+
+    if (append_to_encoding_buffer(encoding_cache, header, header_length) != RESULT_OK ||
+        append_to_encoding_buffer(encoding_cache, value, length) != RESULT_OK)
+    {
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+static int append_string_value(MESSAGE_ENCODING_CACHE_INSTANCE* encoding_cache, const char* value)
+{
+    return append_variable_width_value(encoding_cache, AMQP_FORMAT_CODE_STR8, AMQP_FORMAT_CODE_STR32, (const unsigned char*)value, strlen(value));
+}
+
+// Returns the cached encoding of an application property key, adding it to the cache if there is room left.
+// NULL means the key is not cached and must be encoded in-line.
+static ENCODED_PROPERTY_KEY* get_encoded_property_key(MESSAGE_ENCODING_CACHE_INSTANCE* encoding_cache, const char* key)
+{
+    ENCODED_PROPERTY_KEY* result = NULL;
+    size_t i;
+
+    for (i = 0; i < encoding_cache->property_key_count; i++)
+    {
+        if (strcmp(encoding_cache->property_keys[i].key, key) == 0)
+        {
+            result = &encoding_cache->property_keys[i];
+            break;
+        }
+    }
+
+    if (result == NULL && encoding_cache->property_key_count < ENCODING_CACHE_MAX_PROPERTY_KEYS)
+    {
+        ENCODED_PROPERTY_KEY* new_entry = &encoding_cache->property_keys[encoding_cache->property_key_count];
+        size_t key_length = strlen(key);
+        unsigned char header[AMQP_MAX_VARIABLE_WIDTH_HEADER_SIZE];
+        size_t header_length = write_variable_width_header(header, AMQP_FORMAT_CODE_STR8, AMQP_FORMAT_CODE_STR32, key_length);
+
+        if (mallocAndStrcpy_s(&new_entry->key, key) != 0)
+        {
+            LogError("Failed caching application property key (mallocAndStrcpy_s failed)");
+        }
+        else if ((new_entry->encoded = (unsigned char*)malloc(header_length + key_length)) == NULL)
+        {
+            LogError("Failed caching application property key (malloc failed)");
+            free(new_entry->key);
+            new_entry->key = NULL;
+        }
+        else
+        {
+            (void)memcpy(new_entry->encoded, header, header_length);
+            (void)memcpy(new_entry->encoded + header_length, key, key_length);
+            new_entry->encoded_length = header_length + key_length;
+            encoding_cache->property_key_count++;
+            result = new_entry;
+        }
+    }
+
+    return result;
+}
+
+// Writes the application-properties section straight into the encoding buffer, as a described map32 of
+// string keys and values. The map size and count are patched in once all pairs have been written.
+static int encode_application_properties_into_cache(MESSAGE_ENCODING_CACHE_INSTANCE* encoding_cache, MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE messageHandle)
+{
+    MAP_HANDLE properties_map;
+    const char* const* property_keys;
+    const char* const* property_values;
+    size_t property_count = 0;
+    int result;
+
+    if ((properties_map = IoTHubMessage_Properties(messageHandle)) == NULL)
+    {
+        LogError("Failed to get property map from IoTHub message.");
+        result = MU_FAILURE;
+    }
+    else if (Map_GetInternals(properties_map, &property_keys, &property_values, &property_count) != MAP_OK)
+    {
+        LogError("Failed reading the incoming uAMQP message properties");
+        result = MU_FAILURE;
+    }
+    else if (property_count > 0)
+    {
+        bool override_for_fault_injection = false;
+        result = override_fault_injection_properties_if_needed(message_batch_container, property_keys, property_values, property_count, &override_for_fault_injection);
+
+        if (override_for_fault_injection == false)
+        {
+            static const unsigned char section_header[] = { AMQP_FORMAT_CODE_DESCRIBED, AMQP_FORMAT_CODE_SMALLULONG, AMQP_APPLICATION_PROPERTIES_DESCRIPTOR, AMQP_FORMAT_CODE_MAP32 };
+            unsigned char map_size_and_count[2 * sizeof(uint32_t)] = { 0 };
+            size_t map_size_offset = encoding_cache->encoded_length + sizeof(section_header);
+            size_t i;
+
+            if (append_to_encoding_buffer(encoding_cache, section_header, sizeof(section_header)) != RESULT_OK ||
+                append_to_encoding_buffer(encoding_cache, map_size_and_count, sizeof(map_size_and_count)) != RESULT_OK)
+            {
+                LogError("Failed encoding application properties header");
+                result = MU_FAILURE;
+            }
+            else
+            {
+                for (i = 0; i < property_count; i++)
+                {
+                    ENCODED_PROPERTY_KEY* encoded_key = get_encoded_property_key(encoding_cache, property_keys[i]);
+                    int key_result;
+
+                    if (encoded_key != NULL)
+                    {
+                        key_result = append_to_encoding_buffer(encoding_cache, encoded_key->encoded, encoded_key->encoded_length);
+                    }
+                    else
+                    {
+                        key_result = append_string_value(encoding_cache, property_keys[i]);
+                    }
+
+                    if (key_result != RESULT_OK)
+                    {
+                        LogError("Failed encoding application property key");
+                        result = MU_FAILURE;
+                        break;
+                    }
+                    else if (append_string_value(encoding_cache, property_values[i]) != RESULT_OK)
+                    {
+                        LogError("Failed encoding application property value");
+                        result = MU_FAILURE;
+                        break;
+                    }
+                }
+
+                if (result == RESULT_OK)
+                {
+                    // The map32 size covers the count field and all the encoded pairs that follow it.
+                    write_uint32_big_endian(encoding_cache->encoding_buffer + map_size_offset, (uint32_t)(encoding_cache->encoded_length - map_size_offset - sizeof(uint32_t)));
+                    write_uint32_big_endian(encoding_cache->encoding_buffer + map_size_offset + sizeof(uint32_t), (uint32_t)(property_count * 2));
+                }
+            }
+        }
+    }
+    else
+    {
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+static int encode_data_into_cache(MESSAGE_ENCODING_CACHE_INSTANCE* encoding_cache, IOTHUB_MESSAGE_HANDLE messageHandle)
+{
+    static const unsigned char section_header[] = { AMQP_FORMAT_CODE_DESCRIBED, AMQP_FORMAT_CODE_SMALLULONG, AMQP_DATA_DESCRIPTOR };
+    int result;
+    const char* messageContent;
+    size_t messageContentSize;
+
+    if (get_message_body(messageHandle, &messageContent, &messageContentSize) != RESULT_OK)
+    {
+        LogError("Failed getting the body of the IOTHUB_MESSAGE_HANDLE instance.");
+        result = MU_FAILURE;
+    }
+    else if (append_to_encoding_buffer(encoding_cache, section_header, sizeof(section_header)) != RESULT_OK ||
+        append_variable_width_value(encoding_cache, AMQP_FORMAT_CODE_VBIN8, AMQP_FORMAT_CODE_VBIN32, (const unsigned char*)messageContent, messageContentSize) != RESULT_OK)
+    {
+        LogError("Failed encoding message body");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+MESSAGE_ENCODING_CACHE_HANDLE message_encoding_cache_create(void)
+{
+    MESSAGE_ENCODING_CACHE_INSTANCE* result;
+
+    if ((result = (MESSAGE_ENCODING_CACHE_INSTANCE*)malloc(sizeof(MESSAGE_ENCODING_CACHE_INSTANCE))) == NULL)
+    {
+        LogError("Failed allocating MESSAGE_ENCODING_CACHE_INSTANCE");
+    }
+    else
+    {
+        memset(result, 0, sizeof(MESSAGE_ENCODING_CACHE_INSTANCE));
+    }
+
+    return result;
+}
+
+void message_encoding_cache_destroy(MESSAGE_ENCODING_CACHE_HANDLE encoding_cache)
+{
+    if (encoding_cache != NULL)
+    {
+        size_t i;
+
+        for (i = 0; i < encoding_cache->property_key_count; i++)
+        {
+            free(encoding_cache->property_keys[i].key);
+            free(encoding_cache->property_keys[i].encoded);
+        }
+
+        free(encoding_cache->encoding_buffer);
+        free(encoding_cache);
+    }
+}
+
+int message_create_uamqp_encoding_from_iothub_message_with_cache(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, MESSAGE_ENCODING_CACHE_HANDLE encoding_cache, BINARY_DATA* body_binary_data)
+{
+    int result;
+
+    if (message_handle == NULL || encoding_cache == NULL || body_binary_data == NULL)
+    {
+        LogError("Invalid argument (message_handle=%p, encoding_cache=%p, body_binary_data=%p)", message_handle, encoding_cache, body_binary_data);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        AMQP_VALUE message_properties = NULL;
+        AMQP_VALUE message_annotations = NULL;
+        size_t message_properties_length = 0;
+        size_t message_annotations_length = 0;
+
+        body_binary_data->bytes = NULL;
+        body_binary_data->length = 0;
+        encoding_cache->encoded_length = 0;
+
+        if (create_message_properties_to_encode(message_handle, &message_properties, &message_properties_length) != RESULT_OK)
+        {
+            LogError("create_message_properties_to_encode() failed");
+            result = MU_FAILURE;
+        }
+        else if (ensure_encoding_buffer_capacity(encoding_cache, message_properties_length) != RESULT_OK ||
+            amqpvalue_encode(message_properties, &encoding_cache_encode_callback, encoding_cache) != RESULT_OK)
+        {
+            LogError("amqpvalue_encode() for message properties failed");
+            result = MU_FAILURE;
+        }
+        else if (encode_application_properties_into_cache(encoding_cache, message_batch_container, message_handle) != RESULT_OK)
+        {
+            LogError("encode_application_properties_into_cache() failed");
+            result = MU_FAILURE;
+        }
+        else if (create_message_annotations_to_encode(message_handle, &message_annotations, &message_annotations_length) != RESULT_OK)
+        {
+            LogError("create_message_annotations_to_encode() failed");
+            result = MU_FAILURE;
+        }
+        else if (message_annotations_length > 0 &&
+            (ensure_encoding_buffer_capacity(encoding_cache, message_annotations_length) != RESULT_OK ||
+             amqpvalue_encode(message_annotations, &encoding_cache_encode_callback, encoding_cache) != RESULT_OK))
+        {
+            LogError("amqpvalue_encode() for message annotations failed");
+            result = MU_FAILURE;
+        }
+        else if (encode_data_into_cache(encoding_cache, message_handle) != RESULT_OK)
+        {
+            LogError("encode_data_into_cache() failed");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            body_binary_data->bytes = encoding_cache->encoding_buffer;
+            body_binary_data->length = encoding_cache->encoded_length;
+            result = RESULT_OK;
+        }
+
+        if (NULL != message_annotations)
+        {
+            amqpvalue_destroy(message_annotations);
+        }
+
+        if (NULL != message_properties)
+        {
+            amqpvalue_destroy(message_properties);
+        }
+    }
+
+    return result;
+}
+
 static int readMessageIdFromuAQMPMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, PROPERTIES_HANDLE uamqp_message_properties)
 {
     int result;
@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <string.h>
+#include <stdbool.h>
 #endif
 
 static void* my_gballoc_malloc(size_t size)
@@ -30,6 +31,7 @@ static void my_gballoc_free(void* s)
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/shared_util_options.h"
+#include "azure_c_shared_utility/threadapi.h"
 #undef ENABLE_MOCKS
 
 #include "internal/blob.h"
@@ -102,6 +104,37 @@ static void my_STRING_delete(STRING_HANDLE h)
     my_gballoc_free((void*)h);
 }
 
+static STRING_HANDLE my_STRING_new(void)
+{
+    return (STRING_HANDLE)my_gballoc_malloc(1);
+}
+
+static BUFFER_HANDLE my_BUFFER_new(void)
+{
+    return (BUFFER_HANDLE)my_gballoc_malloc(1);
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    /*the block is uploaded before ThreadAPI_Create returns, so the order of the calls is known*/
+    *threadHandle = (THREAD_HANDLE)my_gballoc_malloc(1);
+    (void)func(arg);
+    return THREADAPI_OK;
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Join(THREAD_HANDLE threadHandle, int* res)
+{
+    *res = 0;
+    my_gballoc_free(threadHandle);
+    return THREADAPI_OK;
+}
+
+static BUFFER_HANDLE my_Azure_Base64_Decode(const char* source)
+{
+    (void)source;
+    return (BUFFER_HANDLE)my_gballoc_malloc(1);
+}
+
 static STRING_HANDLE my_Azure_Base64_Encode_Bytes(const unsigned char* source, size_t size)
 {
     (void)source;
@@ -260,8 +293,19 @@ TEST_SUITE_INITIALIZE(TestSuiteInitialize)
 
     REGISTER_GLOBAL_MOCK_HOOK(STRING_construct, my_STRING_construct);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_construct, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_new, my_STRING_new);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_new, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_new, my_BUFFER_new);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_new, NULL);
+    REGISTER_GLOBAL_MOCK_RETURNS(BUFFER_build, 0, MU_FAILURE);
+
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Join, my_ThreadAPI_Join);
     REGISTER_GLOBAL_MOCK_HOOK(Azure_Base64_Encode_Bytes, my_Azure_Base64_Encode_Bytes);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(Azure_Base64_Encode_Bytes, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Azure_Base64_Decode, my_Azure_Base64_Decode);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Azure_Base64_Decode, NULL);
 
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_concat, MU_FAILURE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_concat_with_STRING, MU_FAILURE);
@@ -278,6 +322,9 @@ TEST_SUITE_INITIALIZE(TestSuiteInitialize)
 
     REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
 
     REGISTER_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE);
     REGISTER_TYPE(HTTPAPIEX_RESULT, HTTPAPIEX_RESULT);
@@ -318,7 +365,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_NULL_SasUri_fails)
     ///arrange
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(NULL, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(NULL, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0, NULL, NULL, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
@@ -333,7 +380,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_NULL_getDataCallBack_and_
     ///arrange
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, NULL, &context, &httpResponse, testValidBufferHandle, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, NULL, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0, NULL, NULL, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
@@ -410,7 +457,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_succeeds_when_HTTP_status_code
         .IgnoreArgument_ptr();
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0, NULL, NULL, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
@@ -488,7 +535,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_fails_when_HTTPAPIEX_ExecuteRe
         .IgnoreArgument_ptr();
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0, NULL, NULL, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_HTTP_ERROR, result);
@@ -527,7 +574,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_fails_when_BUFFER_create_fails
     }
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0, NULL, NULL, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
@@ -555,7 +602,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_fails_when_HTTPAPIEX_Create_fa
     }
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0, NULL, NULL, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_ERROR, result);
@@ -578,7 +625,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_fails_when_malloc_fails)
         ;
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0, NULL, NULL, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_ERROR, result);
@@ -597,7 +644,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_when_SasUri_is_wrong_fails_1)
     context.toUpload = context.size;
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https:/h.h/doms", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL); /*wrong format for protocol, notice it is actually http:\h.h\doms (missing a \ from http)*/
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https:/h.h/doms", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0, NULL, NULL, NULL); /*wrong format for protocol, notice it is actually http:\h.h\doms (missing a \ from http)*/
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
@@ -616,7 +663,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_when_SasUri_is_wrong_fails_2)
     context.toUpload = context.size;
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL); /*there's no relative path here*/
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0, NULL, NULL, NULL); /*there's no relative path here*/
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
@@ -758,7 +805,7 @@ static void Blob_UploadMultipleBlocksFromSasUri_various_sizes_happy_path_Impl(HT
             .IgnoreArgument_ptr();
 
         ///act
-        BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, proxyOptions);
+        BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, proxyOptions, 0, NULL, NULL, NULL);
 
         ///assert
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
@@ -940,7 +987,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_various_sizes_with_certificate
             .IgnoreArgument_ptr();
 
         ///act
-        BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, "a", NULL);
+        BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, "a", NULL, 0, NULL, NULL, NULL);
 
         ///assert
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
@@ -1166,7 +1213,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_64MB_unhappy_paths)
 
             ///act
             context.toUpload = context.size; /* Reinit context */
-            BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL);
+            BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0, NULL, NULL, NULL);
 
             ///assert
             ASSERT_ARE_NOT_EQUAL(BLOB_RESULT, BLOB_OK, result, temp_str);
@@ -1396,7 +1443,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_64MB_with_certificate_unhappy_
 
             ///act
             context.toUpload = context.size; /* Reinit context */
-            BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, "a", NULL);
+            BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, "a", NULL, 0, NULL, NULL, NULL);
 
             ///assert
             ASSERT_ARE_NOT_EQUAL(BLOB_RESULT, BLOB_OK, result, temp_str);
@@ -1488,7 +1535,7 @@ TEST_FUNCTION(Blob_UploadFromSasUri_when_http_code_is_404_it_immediately_succeed
         .IgnoreArgument_ptr();
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0, NULL, NULL, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
@@ -1499,19 +1546,20 @@ TEST_FUNCTION(Blob_UploadFromSasUri_when_http_code_is_404_it_immediately_succeed
 
 }
 
-/*Tests_SRS_BLOB_99_001: [ If the size of the block returned by `getDataCallback` is bigger than 4MB, then `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
+/*Tests_SRS_BLOB_99_001: [ If the size of the block returned by `getDataCallbackEx` is bigger than `MAX_BLOCK_SIZE` (100MB), then `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
 TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_when_blockSize_too_big_fails)
 {
     ///arrange
     BLOB_UPLOAD_CONTEXT_FAKE fakeContext;
     fakeContext.blockSent = 0;
-    fakeContext.blockSize = BLOCK_SIZE + 1;
+    fakeContext.blockSize = MAX_BLOCK_SIZE + 1;
     fakeContext.blocksCount = 1;
-    fakeContext.fakeData = NULL;
+    // the block is rejected before being read, no need to allocate all of it
+    fakeContext.fakeData = (unsigned char*)gballoc_malloc(1);
     fakeContext.abortOnBlockNumber = -1;
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, 0, NULL, NULL, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
@@ -1520,7 +1568,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_when_blockSize_too_big_fails)
     gballoc_free(fakeContext.fakeData);
 }
 
-/*Tests_SRS_BLOB_99_001: [ If the size of the block returned by `getDataCallback` is bigger than 4MB, then `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
+/*Tests_SRS_BLOB_99_001: [ If the size of the block returned by `getDataCallbackEx` is bigger than `MAX_BLOCK_SIZE` (100MB), then `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
 TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_when_blockSize_is_4MB_succeeds)
 {
     ///arrange
@@ -1532,7 +1580,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_when_blockSize_is_4MB_succeeds
     fakeContext.abortOnBlockNumber = -1;
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, 0, NULL, NULL, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
@@ -1553,7 +1601,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_when_blockCount_is_maximum_suc
     fakeContext.abortOnBlockNumber = -1;
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, 0, NULL, NULL, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
@@ -1574,7 +1622,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_when_blockCount_is_one_over_ma
     fakeContext.abortOnBlockNumber = -1;
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, 0, NULL, NULL, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
@@ -1595,7 +1643,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_returns_BLOB_ABORTED_when_call
     fakeContext.abortOnBlockNumber = 0;
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, 0, NULL, NULL, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_ABORTED, result);
@@ -1616,7 +1664,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_returns_BLOB_ABORTED_when_call
     fakeContext.abortOnBlockNumber = 5;
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, 0, NULL, NULL, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_ABORTED, result);
@@ -1625,4 +1673,588 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_returns_BLOB_ABORTED_when_call
     gballoc_free(fakeContext.fakeData);
 }
 
+/*Tests_SRS_BLOB_09_001: [ If `concurrentBlocks` is bigger than `MAX_CONCURRENT_BLOCKS` then `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_concurrentBlocks_over_maximum_fails)
+{
+    ///arrange
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, MAX_CONCURRENT_BLOCKS + 1, NULL, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+}
+
+static void setup_concurrent_block_expected_calls(bool createHttpApiExHandle)
+{
+    if (createHttpApiExHandle)
+    {
+        STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h")); /*this is the connection of this slot*/
+    }
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, 1)); /*this is the content to be uploaded*/
+    STRICT_EXPECTED_CALL(STRING_new()); /*this is the <Latest> element of the block*/
+    STRICT_EXPECTED_CALL(BUFFER_new()); /*this is the HTTP response of the block*/
+}
+
+static void setup_Blob_UploadBlock_expected_calls(unsigned int* statusCode)
+{
+    STRICT_EXPECTED_CALL(Azure_Base64_Encode_Bytes(IGNORED_PTR_ARG, 6));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>"));
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>"));
+    STRICT_EXPECTED_CALL(STRING_construct("/something?a=b"));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid="));
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    if (statusCode != NULL)
+    {
+        STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer_statusCode(statusCode, sizeof(*statusCode));
+    }
+    else
+    {
+        STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG));
+    }
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)); /*this is the relativePath of the block*/
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)); /*this is the base64 representation of the blockID*/
+}
+
+static void setup_release_slot_expected_calls(void)
+{
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)); /*this is the content uploaded*/
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)); /*this is the <Latest> element of the block*/
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)); /*this is the HTTP response of the block*/
+}
+
+static void setup_Put_Block_List_expected_calls(void)
+{
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</BlockList>"));
+    STRICT_EXPECTED_CALL(STRING_construct("/something?a=b"));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=blocklist"));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, &httpResponse, NULL, testValidBufferHandle))
+        .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+}
+
+/*Tests_SRS_BLOB_09_002: [ `Blob_UploadMultipleBlocksFromSasUri` shall get from `getDataCallbackEx` up to `concurrentBlocks` blocks, copied to one BUFFER_HANDLE each, before uploading them. ]*/
+/*Tests_SRS_BLOB_09_003: [ Each block after the first of a round shall be uploaded over its own `HTTPAPIEX_HANDLE`, created with the hostname, `certificates` and `proxyOptions` the first time it is needed and kept for the next rounds. ]*/
+/*Tests_SRS_BLOB_09_004: [ The blocks of a round shall be uploaded concurrently with `Blob_UploadBlock`, the first one on the calling thread and the others on threads created with `ThreadAPI_Create`. ]*/
+/*Tests_SRS_BLOB_09_006: [ The block ids of a round shall be appended to the XML in block order, and the first block of the round that failed shall be reported as if the blocks were uploaded one at a time. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_concurrently_happy_path)
+{
+    ///arrange
+    BLOB_UPLOAD_CONTEXT_FAKE fakeContext;
+    fakeContext.blockSent = 0;
+    fakeContext.blockSize = 1;
+    fakeContext.blocksCount = 3;
+    fakeContext.fakeData = (unsigned char*)gballoc_malloc(1);
+    fakeContext.abortOnBlockNumber = -1;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*this is creating a copy of the hostname */
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h"));
+    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>"));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*these are the block upload slots*/
+
+    /*first round, blocks 0 and 1*/
+    setup_concurrent_block_expected_calls(false);
+    setup_concurrent_block_expected_calls(true);
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    setup_Blob_UploadBlock_expected_calls(NULL); /*block 1, uploaded by the thread*/
+    setup_Blob_UploadBlock_expected_calls(NULL); /*block 0, uploaded by the calling thread*/
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*block 0 added to the XML*/
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*block 1 added to the XML*/
+    setup_release_slot_expected_calls();
+    setup_release_slot_expected_calls();
+
+    /*second round, block 2*/
+    setup_concurrent_block_expected_calls(false);
+    setup_Blob_UploadBlock_expected_calls(NULL);
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    setup_release_slot_expected_calls();
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG)); /*this is the connection of the second slot*/
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*these are the block upload slots*/
+
+    setup_Put_Block_List_expected_calls();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)); /*this is the XML string used for Put Block List operation*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*this is freeing the copy of the hostname*/
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, 2, NULL, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 200, (int)httpResponse);
+
+    ///cleanup
+    gballoc_free(fakeContext.fakeData);
+}
+
+/*Tests_SRS_BLOB_09_005: [ If `ThreadAPI_Create` fails, the block shall be uploaded on the calling thread. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_concurrently_when_ThreadAPI_Create_fails_uploads_on_the_calling_thread)
+{
+    ///arrange
+    BLOB_UPLOAD_CONTEXT_FAKE fakeContext;
+    fakeContext.blockSent = 0;
+    fakeContext.blockSize = 1;
+    fakeContext.blocksCount = 2;
+    fakeContext.fakeData = (unsigned char*)gballoc_malloc(1);
+    fakeContext.abortOnBlockNumber = -1;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h"));
+    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>"));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    setup_concurrent_block_expected_calls(false);
+    setup_concurrent_block_expected_calls(true);
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(THREADAPI_ERROR);
+    setup_Blob_UploadBlock_expected_calls(NULL); /*block 1*/
+    setup_Blob_UploadBlock_expected_calls(NULL); /*block 0*/
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    setup_release_slot_expected_calls();
+    setup_release_slot_expected_calls();
+
+    /*second round, no more blocks*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    setup_Put_Block_List_expected_calls();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, 2, NULL, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    gballoc_free(fakeContext.fakeData);
+}
+
+/*Tests_SRS_BLOB_09_006: [ The block ids of a round shall be appended to the XML in block order, and the first block of the round that failed shall be reported as if the blocks were uploaded one at a time. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_concurrently_when_HTTP_status_code_is_404_it_succeeds_without_Put_Block_List)
+{
+    ///arrange
+    unsigned int notFound = 404;
+    BLOB_UPLOAD_CONTEXT_FAKE fakeContext;
+    fakeContext.blockSent = 0;
+    fakeContext.blockSize = 1;
+    fakeContext.blocksCount = 4;
+    fakeContext.fakeData = (unsigned char*)gballoc_malloc(1);
+    fakeContext.abortOnBlockNumber = -1;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h"));
+    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>"));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    setup_concurrent_block_expected_calls(false);
+    setup_concurrent_block_expected_calls(true);
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    setup_Blob_UploadBlock_expected_calls(&notFound); /*block 1 fails*/
+    setup_Blob_UploadBlock_expected_calls(NULL); /*block 0 succeeds*/
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*block 0 added to the XML*/
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG)); /*the response of block 1 is reported*/
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_build(testValidBufferHandle, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    setup_release_slot_expected_calls();
+    setup_release_slot_expected_calls();
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, 2, NULL, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 404, (int)httpResponse);
+    ASSERT_ARE_EQUAL(int, 2, (int)fakeContext.blockSent);
+
+    ///cleanup
+    gballoc_free(fakeContext.fakeData);
+}
+
+static void setup_skip_block_expected_calls(void)
+{
+    STRICT_EXPECTED_CALL(Azure_Base64_Encode_Bytes(IGNORED_PTR_ARG, 6));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>"));
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>"));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)); /*this is the base64 representation of the blockID*/
+}
+
+/*Tests_SRS_BLOB_09_007: [ If `uploadedBlockCount` points to a value bigger than 0, `Blob_UploadMultipleBlocksFromSasUri` shall get that many blocks from `getDataCallbackEx` without uploading them and add their block ids to the XML. ]*/
+/*Tests_SRS_BLOB_09_008: [ If `uploadedBlockCount` is not NULL, `Blob_UploadMultipleBlocksFromSasUri` shall set it to the count of blocks uploaded in order, the skipped ones included. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_skips_uploaded_blocks_happy_path)
+{
+    ///arrange
+    unsigned int statusCode = 200;
+    unsigned int uploadedBlockCount = 2;
+    BLOB_UPLOAD_CONTEXT_FAKE fakeContext;
+    fakeContext.blockSent = 0;
+    fakeContext.blockSize = 1;
+    fakeContext.blocksCount = 3;
+    fakeContext.fakeData = (unsigned char*)gballoc_malloc(1);
+    fakeContext.abortOnBlockNumber = -1;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*this is creating a copy of the hostname */
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h"));
+    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>"));
+
+    setup_skip_block_expected_calls(); /*block 0*/
+    setup_skip_block_expected_calls(); /*block 1*/
+
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, 1)); /*block 2 is the only one uploaded*/
+    setup_Blob_UploadBlock_expected_calls(&statusCode);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+
+    setup_Put_Block_List_expected_calls();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)); /*this is the XML string used for Put Block List operation*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*this is freeing the copy of the hostname*/
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, 0, &uploadedBlockCount, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 3, (int)uploadedBlockCount);
+
+    ///cleanup
+    gballoc_free(fakeContext.fakeData);
+}
+
+#define TEST_MAX_PROGRESS_REPORTS 4
+
+typedef struct UPLOAD_PROGRESS_REPORTS_TAG
+{
+    size_t count;
+    unsigned int uploadedBlockCount[TEST_MAX_PROGRESS_REPORTS];
+} UPLOAD_PROGRESS_REPORTS;
+
+static void test_upload_progress_callback(unsigned int uploadedBlockCount, void* context)
+{
+    UPLOAD_PROGRESS_REPORTS* reports = (UPLOAD_PROGRESS_REPORTS*)context;
+    ASSERT_IS_TRUE(reports->count < TEST_MAX_PROGRESS_REPORTS);
+    reports->uploadedBlockCount[reports->count++] = uploadedBlockCount;
+}
+
+/*Tests_SRS_BLOB_09_016: [ If `uploadProgressCallback` is not NULL, `Blob_UploadMultipleBlocksFromSasUri` shall call it with `uploadProgressContext` and the count of blocks uploaded in order, the skipped ones included, each time a block, or a round of concurrent blocks, is uploaded. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_reports_progress_after_each_block)
+{
+    ///arrange
+    unsigned int statusCode = 200;
+    unsigned int uploadedBlockCount = 1;
+    UPLOAD_PROGRESS_REPORTS reports;
+    BLOB_UPLOAD_CONTEXT_FAKE fakeContext;
+    fakeContext.blockSent = 0;
+    fakeContext.blockSize = 1;
+    fakeContext.blocksCount = 3;
+    fakeContext.fakeData = (unsigned char*)gballoc_malloc(1);
+    fakeContext.abortOnBlockNumber = -1;
+    reports.count = 0;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*this is creating a copy of the hostname */
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h"));
+    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>"));
+
+    setup_skip_block_expected_calls(); /*block 0*/
+
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, 1)); /*block 1*/
+    setup_Blob_UploadBlock_expected_calls(&statusCode);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, 1)); /*block 2*/
+    setup_Blob_UploadBlock_expected_calls(&statusCode);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+
+    setup_Put_Block_List_expected_calls();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)); /*this is the XML string used for Put Block List operation*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*this is freeing the copy of the hostname*/
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, 0, &uploadedBlockCount, test_upload_progress_callback, &reports);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 2, (int)reports.count);
+    ASSERT_ARE_EQUAL(int, 2, (int)reports.uploadedBlockCount[0]);
+    ASSERT_ARE_EQUAL(int, 3, (int)reports.uploadedBlockCount[1]);
+
+    ///cleanup
+    gballoc_free(fakeContext.fakeData);
+}
+
+/*Tests_SRS_BLOB_09_016: [ If `uploadProgressCallback` is not NULL, `Blob_UploadMultipleBlocksFromSasUri` shall call it with `uploadProgressContext` and the count of blocks uploaded in order, the skipped ones included, each time a block, or a round of concurrent blocks, is uploaded. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_concurrently_reports_progress_after_each_round)
+{
+    ///arrange
+    UPLOAD_PROGRESS_REPORTS reports;
+    BLOB_UPLOAD_CONTEXT_FAKE fakeContext;
+    fakeContext.blockSent = 0;
+    fakeContext.blockSize = 1;
+    fakeContext.blocksCount = 3;
+    fakeContext.fakeData = (unsigned char*)gballoc_malloc(1);
+    fakeContext.abortOnBlockNumber = -1;
+    reports.count = 0;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*this is creating a copy of the hostname */
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h"));
+    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>"));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*these are the block upload slots*/
+
+    /*first round, blocks 0 and 1*/
+    setup_concurrent_block_expected_calls(false);
+    setup_concurrent_block_expected_calls(true);
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    setup_Blob_UploadBlock_expected_calls(NULL); /*block 1, uploaded by the thread*/
+    setup_Blob_UploadBlock_expected_calls(NULL); /*block 0, uploaded by the calling thread*/
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*block 0 added to the XML*/
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*block 1 added to the XML*/
+    setup_release_slot_expected_calls();
+    setup_release_slot_expected_calls();
+
+    /*second round, block 2*/
+    setup_concurrent_block_expected_calls(false);
+    setup_Blob_UploadBlock_expected_calls(NULL);
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    setup_release_slot_expected_calls();
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG)); /*this is the connection of the second slot*/
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*these are the block upload slots*/
+
+    setup_Put_Block_List_expected_calls();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)); /*this is the XML string used for Put Block List operation*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*this is freeing the copy of the hostname*/
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, 2, NULL, test_upload_progress_callback, &reports);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 2, (int)reports.count);
+    ASSERT_ARE_EQUAL(int, 2, (int)reports.uploadedBlockCount[0]);
+    ASSERT_ARE_EQUAL(int, 3, (int)reports.uploadedBlockCount[1]);
+
+    ///cleanup
+    gballoc_free(fakeContext.fakeData);
+}
+
+/*Tests_SRS_BLOB_09_009: [ If `getDataCallbackEx` returns less blocks than `uploadedBlockCount`, `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_less_blocks_than_uploadedBlockCount_fails)
+{
+    ///arrange
+    unsigned int uploadedBlockCount = 2;
+    BLOB_UPLOAD_CONTEXT_FAKE fakeContext;
+    fakeContext.blockSent = 0;
+    fakeContext.blockSize = 1;
+    fakeContext.blocksCount = 1;
+    fakeContext.fakeData = (unsigned char*)gballoc_malloc(1);
+    fakeContext.abortOnBlockNumber = -1;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h"));
+    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>"));
+    setup_skip_block_expected_calls(); /*block 0, the data ends before block 1*/
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, 0, &uploadedBlockCount, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, (int)uploadedBlockCount);
+
+    ///cleanup
+    gballoc_free(fakeContext.fakeData);
+}
+
+/*Tests_SRS_BLOB_09_010: [ If `SASURI` or `blockCount` are NULL then `Blob_GetUncommittedBlockCount` shall fail and return `BLOB_INVALID_ARG`. ]*/
+TEST_FUNCTION(Blob_GetUncommittedBlockCount_with_NULL_SasUri_fails)
+{
+    ///arrange
+    unsigned int blockCount;
+
+    ///act
+    BLOB_RESULT result = Blob_GetUncommittedBlockCount(NULL, NULL, NULL, &blockCount);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_09_010: [ If `SASURI` or `blockCount` are NULL then `Blob_GetUncommittedBlockCount` shall fail and return `BLOB_INVALID_ARG`. ]*/
+TEST_FUNCTION(Blob_GetUncommittedBlockCount_with_NULL_blockCount_fails)
+{
+    ///arrange
+
+    ///act
+    BLOB_RESULT result = Blob_GetUncommittedBlockCount("https://h.h/something?a=b", NULL, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+}
+
+static void setup_Get_Block_List_expected_calls(const unsigned int* statusCode)
+{
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*this is creating a copy of the hostname */
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h"));
+    STRICT_EXPECTED_CALL(STRING_construct("/something?a=b"));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=blocklist&blocklisttype=uncommitted"));
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    if (statusCode != NULL)
+    {
+        STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, NULL, NULL, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer_statusCode(statusCode, sizeof(*statusCode));
+    }
+    else
+    {
+        STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, NULL, NULL, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG))
+            .SetReturn(HTTPAPIEX_ERROR);
+    }
+}
+
+static void setup_Get_Block_List_cleanup_expected_calls(void)
+{
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)); /*this is the HTTP response*/
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)); /*this is the relative path of the request*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*this is freeing the copy of the hostname*/
+}
+
+static void setup_listed_block_expected_calls(const char* encodedBlockID, const char* blockID)
+{
+    STRICT_EXPECTED_CALL(Azure_Base64_Decode(encodedBlockID));
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG))
+        .SetReturn(6);
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn((unsigned char*)blockID);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+}
+
+/*Tests_SRS_BLOB_09_011: [ `Blob_GetUncommittedBlockCount` shall call `HTTPAPIEX_ExecuteRequest` with a GET operation on the base relative path + "&comp=blocklist&blocklisttype=uncommitted". ]*/
+/*Tests_SRS_BLOB_09_014: [ `Blob_GetUncommittedBlockCount` shall decode the block ids of the response and set `blockCount` to the count of consecutive block ids listed starting at 0. ]*/
+TEST_FUNCTION(Blob_GetUncommittedBlockCount_counts_consecutive_blocks)
+{
+    ///arrange
+    unsigned int statusCode = 200;
+    unsigned int blockCount = 42;
+    const char* blockList =
+        "<?xml version=\"1.0\" encoding=\"utf-8\"?><BlockList><UncommittedBlocks>"
+        "<Block><Name>ICAgICAx</Name><Size>1</Size></Block>"
+        "<Block><Name>ICAgICAw</Name><Size>1</Size></Block>"
+        "<Block><Name>ICAgICAz</Name><Size>1</Size></Block>"
+        "</UncommittedBlocks></BlockList>";
+
+    setup_Get_Block_List_expected_calls(&statusCode);
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG))
+        .SetReturn(strlen(blockList));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*this is the block list as a string*/
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*these are the listed block ids*/
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn((unsigned char*)blockList);
+    setup_listed_block_expected_calls("ICAgICAx", "     1");
+    setup_listed_block_expected_calls("ICAgICAw", "     0");
+    setup_listed_block_expected_calls("ICAgICAz", "     3");
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*this is the block list as a string*/
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*these are the listed block ids*/
+    setup_Get_Block_List_cleanup_expected_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_GetUncommittedBlockCount("https://h.h/something?a=b", NULL, NULL, &blockCount);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 2, (int)blockCount);
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_09_013: [ If the HTTP response code is >=300 then `Blob_GetUncommittedBlockCount` shall set `blockCount` to 0 and return `BLOB_OK`. ]*/
+TEST_FUNCTION(Blob_GetUncommittedBlockCount_when_HTTP_status_code_is_404_returns_0_blocks)
+{
+    ///arrange
+    unsigned int statusCode = 404;
+    unsigned int blockCount = 42;
+
+    setup_Get_Block_List_expected_calls(&statusCode);
+    STRICT_EXPECTED_CALL(gballoc_free(NULL)); /*no block ids were listed*/
+    setup_Get_Block_List_cleanup_expected_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_GetUncommittedBlockCount("https://h.h/something?a=b", NULL, NULL, &blockCount);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, (int)blockCount);
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_09_012: [ If `HTTPAPIEX_ExecuteRequest` fails then `Blob_GetUncommittedBlockCount` shall fail and return `BLOB_HTTP_ERROR`. ]*/
+TEST_FUNCTION(Blob_GetUncommittedBlockCount_when_HTTPAPIEX_ExecuteRequest_fails)
+{
+    ///arrange
+    unsigned int blockCount;
+
+    setup_Get_Block_List_expected_calls(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    setup_Get_Block_List_cleanup_expected_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_GetUncommittedBlockCount("https://h.h/something?a=b", NULL, NULL, &blockCount);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_HTTP_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+}
+
 END_TEST_SUITE(blob_ut);
@@ -12,6 +12,11 @@ static void* my_gballoc_malloc(size_t size)
     return malloc(size);
 }
 
+static void* my_gballoc_calloc(size_t nmemb, size_t size)
+{
+    return calloc(nmemb, size);
+}
+
 static void my_gballoc_free(void* ptr)
 {
     free(ptr);
@@ -32,6 +37,9 @@ static void my_gballoc_free(void* ptr)
 #include "azure_c_shared_utility/xio.h"
 #include "azure_c_shared_utility/buffer_.h"
 #include "azure_c_shared_utility/azure_base64.h"
+#include "azure_c_shared_utility/urlencode.h"
+#include "azure_c_shared_utility/lock.h"
+#include "internal/iothub_client_hmacsha256_batch.h"
 
 #ifdef USE_PROV_MODULE
 #include "azure_prov_client/internal/iothub_auth_client.h"
@@ -93,6 +101,19 @@ static void my_STRING_delete(STRING_HANDLE handle)
     my_gballoc_free(handle);
 }
 
+static STRING_HANDLE my_Azure_Base64_Encode_Bytes(const unsigned char* source, size_t size)
+{
+    (void)source;
+    (void)size;
+    return (STRING_HANDLE)my_gballoc_malloc(1);
+}
+
+static STRING_HANDLE my_URL_Encode(STRING_HANDLE input)
+{
+    (void)input;
+    return (STRING_HANDLE)my_gballoc_malloc(1);
+}
+
 #ifdef USE_PROV_MODULE
 static IOTHUB_SECURITY_HANDLE my_iothub_device_auth_create(void)
 {
@@ -142,9 +163,14 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(time_t, long long);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HMACSHA256_BATCH_ITEM*, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_calloc, my_gballoc_calloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_calloc, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
 
     REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
@@ -157,10 +183,15 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(get_time, ((time_t)(-1)));
 
     REGISTER_GLOBAL_MOCK_RETURNS(Azure_Base64_Decode, (BUFFER_HANDLE)0x1, NULL);
+    REGISTER_GLOBAL_MOCK_RETURNS(Lock_Init, (LOCK_HANDLE)0x2, NULL);
+    REGISTER_GLOBAL_MOCK_RETURNS(Lock, LOCK_OK, LOCK_ERROR);
 
     REGISTER_GLOBAL_MOCK_RETURN(STRING_c_str, TEST_STRING_VALUE);
     REGISTER_GLOBAL_MOCK_HOOK(STRING_delete, my_STRING_delete);
     REGISTER_GLOBAL_MOCK_HOOK(STRING_construct, my_STRING_construct);
+    REGISTER_GLOBAL_MOCK_HOOK(Azure_Base64_Encode_Bytes, my_Azure_Base64_Encode_Bytes);
+    REGISTER_GLOBAL_MOCK_HOOK(URL_Encode, my_URL_Encode);
+    REGISTER_GLOBAL_MOCK_RETURN(HMACSHA256_Batch_ComputeHashes, 0);
     REGISTER_GLOBAL_MOCK_RETURN(SASToken_Validate, true);
 
 #ifdef USE_PROV_MODULE
@@ -207,6 +238,7 @@ static void setup_IoTHubClient_Auth_CreateFromDeviceAuth_mocks(bool module_id, D
     {
         STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, MODULE_ID));
     }
+    STRICT_EXPECTED_CALL(Lock_Init());
     STRICT_EXPECTED_CALL(iothub_device_auth_create());
     STRICT_EXPECTED_CALL(iothub_device_auth_get_type(IGNORED_PTR_ARG)).SetReturn(auth_type);
 }
@@ -226,6 +258,7 @@ static void setup_IoTHubClient_Auth_Create_mocks(bool device_key, bool module_id
     {
         STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, MODULE_ID));
     }
+    STRICT_EXPECTED_CALL(Lock_Init());
     if (device_key)
     {
         STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, DEVICE_KEY));
@@ -236,9 +269,13 @@ static void setup_IoTHubClient_Auth_Get_ConnString_mocks()
 {
     STRICT_EXPECTED_CALL(get_time(NULL));
     STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(SASToken_CreateString(IGNORED_PTR_ARG, SCOPE_NAME, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
 }
 
@@ -515,6 +552,7 @@ TEST_FUNCTION(IoTHubClient_Auth_Destroy_succeed)
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
     //act
@@ -877,7 +915,8 @@ TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_fail)
 
     umock_c_negative_tests_snapshot();
 
-    size_t calls_cannot_fail[] = { 1, 3, 5 };
+    // Without the cache lock the token is still created, only not cached
+    size_t calls_cannot_fail[] = { 1, 2, 3, 5, 7, 8, 9 };
 
     //act
     size_t count = umock_c_negative_tests_call_count();
@@ -1047,6 +1086,9 @@ TEST_FUNCTION(IoTHubClient_Auth_Set_SasToken_Expiry_succeed)
     IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(NULL, DEVICE_ID, TEST_SAS_TOKEN, NULL);
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
     //act
     int result = IoTHubClient_Auth_Set_SasToken_Expiry(handle, expiry_time);
 
@@ -1093,4 +1135,268 @@ TEST_FUNCTION(IoTHubClient_Auth_Get_SasToken_Expiry_succeed)
     IoTHubClient_Auth_Destroy(handle);
 }
 
+static void setup_cached_sas_token_mocks(void)
+{
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, SCOPE_NAME));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_STRING_VALUE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+}
+
+static IOTHUB_AUTHORIZATION_HANDLE create_auth_with_cached_sas_token(void)
+{
+    IOTHUB_AUTHORIZATION_HANDLE result = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL, NULL);
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_Auth_Set_SasToken_Cache_Refresh_Percent(result, 10));
+    free(IoTHubClient_Auth_Get_SasToken(result, SCOPE_NAME, TEST_EXPIRY_TIME, NULL));
+    umock_c_reset_all_calls();
+    return result;
+}
+
+/* Tests_SRS_IoTHub_Authorization_09_001: [ If the sas token cache is on and holds a token for scope and key_name that is not due for refresh, IoTHubClient_Auth_Get_SasToken shall return a copy of it instead of creating a new one. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_SasToken_returns_cached_token)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = create_auth_with_cached_sas_token();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(359.0);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_STRING_VALUE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    char* sas_token = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, TEST_STRING_VALUE, sas_token);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(sas_token);
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Tests_SRS_IoTHub_Authorization_09_002: [ A cached token shall be regenerated once the configured percentage of the token lifetime has passed since it was created, or if the clock went back. ] */
+/* Tests_SRS_IoTHub_Authorization_09_003: [ A new token shall take a free cache entry, or the entry of the oldest cached token if there is none. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_SasToken_recreates_cached_token_due_for_refresh)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = create_auth_with_cached_sas_token();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(360.0); /*10% of the default 3600 seconds lifetime*/
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(SASToken_CreateString(IGNORED_PTR_ARG, SCOPE_NAME, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    setup_cached_sas_token_mocks();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+
+    //act
+    char* sas_token = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME, NULL);
+
+    //assert
+    ASSERT_IS_NOT_NULL(sas_token);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(sas_token);
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Tests_SRS_IoTHub_Authorization_09_004: [ Changing the token lifetime shall drop the cached sas tokens. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Set_SasToken_Expiry_drops_cached_tokens)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = create_auth_with_cached_sas_token();
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_Auth_Set_SasToken_Expiry(handle, 4800));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(SASToken_CreateString(IGNORED_PTR_ARG, SCOPE_NAME, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    setup_cached_sas_token_mocks();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+
+    //act
+    char* sas_token = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME, NULL);
+
+    //assert
+    ASSERT_IS_NOT_NULL(sas_token);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(sas_token);
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Tests_SRS_IoTHub_Authorization_09_015: [ The sas token cache shall only be read and changed while holding the lock of the handle. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Set_SasToken_Expiry_Lock_fails)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = create_auth_with_cached_sas_token();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).SetReturn(LOCK_ERROR);
+
+    //act
+    int result = IoTHubClient_Auth_Set_SasToken_Expiry(handle, 4800);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 3600, IoTHubClient_Auth_Get_SasToken_Expiry(handle));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Tests_SRS_IoTHub_Authorization_09_005: [ IoTHubClient_Auth_Set_SasToken_Cache_Refresh_Percent shall fail if refresh_percent is over MAX_SAS_TOKEN_CACHE_REFRESH_PERCENT. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Set_SasToken_Cache_Refresh_Percent_over_max_fails)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL, NULL);
+    umock_c_reset_all_calls();
+
+    //act
+    int result = IoTHubClient_Auth_Set_SasToken_Cache_Refresh_Percent(handle, 16);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Tests_SRS_IoTHub_Authorization_09_007: [ If `requests` is NULL or `request_count` is 0, IoTHubClient_Auth_Get_SasToken_Batch shall fail and return non-zero. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_SasToken_Batch_requests_NULL_fails)
+{
+    //arrange
+
+    //act
+    int result = IoTHubClient_Auth_Get_SasToken_Batch(NULL, 1);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+static void setup_IoTHubClient_Auth_Get_SasToken_Batch_signing_mocks(int compute_hashes_result)
+{
+    STRICT_EXPECTED_CALL(gballoc_calloc(1, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_calloc(1, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Azure_Base64_Decode(DEVICE_KEY));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HMACSHA256_Batch_ComputeHashes(IGNORED_PTR_ARG, 1)).SetReturn(compute_hashes_result);
+    if (compute_hashes_result == 0)
+    {
+        STRICT_EXPECTED_CALL(Azure_Base64_Encode_Bytes(IGNORED_PTR_ARG, HMACSHA256_BATCH_HASH_SIZE));
+        STRICT_EXPECTED_CALL(URL_Encode(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    }
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+}
+
+/* Tests_SRS_IoTHub_Authorization_09_011: [ The other device key requests shall be signed together with HMACSHA256_Batch_ComputeHashes, over the same string to sign as SASToken_CreateString. ] */
+/* Tests_SRS_IoTHub_Authorization_09_012: [ Each signed token shall have the SASToken_CreateString format and be cached when the sas token cache is on. ] */
+/* Tests_SRS_IoTHub_Authorization_09_014: [ Otherwise IoTHubClient_Auth_Get_SasToken_Batch shall return 0. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_SasToken_Batch_signs_device_key_token)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL, NULL);
+    IOTHUB_SAS_TOKEN_REQUEST request = { handle, SCOPE_NAME, NULL, NULL };
+    umock_c_reset_all_calls();
+
+    setup_IoTHubClient_Auth_Get_SasToken_Batch_signing_mocks(0);
+
+    //act
+    int result = IoTHubClient_Auth_Get_SasToken_Batch(&request, 1);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, "SharedAccessSignature sr=Scope_name&sig=Test_string_value&se=3600", request.sas_token);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(request.sas_token);
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Tests_SRS_IoTHub_Authorization_09_013: [ A request whose token cannot be created shall be left with a NULL `sas_token`. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_SasToken_Batch_compute_hashes_fails)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL, NULL);
+    IOTHUB_SAS_TOKEN_REQUEST request = { handle, SCOPE_NAME, NULL, NULL };
+    umock_c_reset_all_calls();
+
+    setup_IoTHubClient_Auth_Get_SasToken_Batch_signing_mocks(__LINE__);
+
+    //act
+    int result = IoTHubClient_Auth_Get_SasToken_Batch(&request, 1);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_NULL(request.sas_token);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Tests_SRS_IoTHub_Authorization_09_010: [ A device key request with a usable cached token shall get a copy of it, as in IoTHubClient_Auth_Get_SasToken. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_SasToken_Batch_returns_cached_token)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = create_auth_with_cached_sas_token();
+    IOTHUB_SAS_TOKEN_REQUEST request = { handle, SCOPE_NAME, NULL, NULL };
+
+    STRICT_EXPECTED_CALL(gballoc_calloc(1, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_calloc(1, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(359.0);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_STRING_VALUE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    int result = IoTHubClient_Auth_Get_SasToken_Batch(&request, 1);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_STRING_VALUE, request.sas_token);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(request.sas_token);
+    IoTHubClient_Auth_Destroy(handle);
+}
+
 END_TEST_SUITE(iothub_client_authorization_ut)
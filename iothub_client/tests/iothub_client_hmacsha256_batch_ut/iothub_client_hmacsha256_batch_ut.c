@@ -0,0 +1,356 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdbool.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_charptr.h"
+#include "umock_c/umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/hmacsha256.h"
+#undef ENABLE_MOCKS
+
+#include "internal/iothub_client_hmacsha256_batch.h"
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", MU_ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+#define TEST_BUFFER_HANDLE (BUFFER_HANDLE)0x4243
+#define TEST_SCALAR_HASH_BYTE 0x5a
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static unsigned char g_scalar_hash[HMACSHA256_BATCH_HASH_SIZE];
+static char g_hash_string[2 * HMACSHA256_BATCH_HASH_SIZE + 1];
+
+// RFC 4231 test cases 1 to 4 and 6
+static const unsigned char TEST_KEY_1[20] = { 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b };
+static const char* TEST_DATA_1 = "Hi There";
+static const char* TEST_HASH_1 = "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7";
+static const char* TEST_KEY_2 = "Jefe";
+static const char* TEST_DATA_2 = "what do ya want for nothing?";
+static const char* TEST_HASH_2 = "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843";
+static const char* TEST_HASH_3 = "773ea91e36800e46854db8ebd09181a72959098b3ef8c122d9635514ced565fe";
+static const char* TEST_HASH_4 = "82558a389a443c0ea4cc819899f2083a85f0faa3e578f8077a2e3ff46729665b";
+static const char* TEST_DATA_6 = "Test Using Larger Than Block-Size Key - Hash Key First";
+
+// HMAC-SHA256("key", "a" * length), around the one and two block padding boundaries
+static const size_t TEST_PAYLOAD_LENGTHS[] = { 0, 55, 56, 64, 119, 200 };
+static const char* TEST_PAYLOAD_HASHES[] =
+{
+    "5d5d139563c95b5967b9bd9a8c9b233a9dedb45072794cd232dc1b74832607d0",
+    "5c753ac4cf15a28e7b5a045ba8ce75e02545a313f326021d770912f768fb53ef",
+    "e9613a403652aa5873dba8b56f223826236e87559a8d8ac63190613796d2319a",
+    "77207571ea4243ad8e0f220679a62f9033b6d2f59f8d44517d8e9c4857b96fa0",
+    "4ffbedd6a1157e63e62d3fa284549bcfe39fb98dbb77ac48a89120aed5747d6b",
+    "c4b4cbc1820e3b38f721e087a109495e5be7e58eba4e608758a62acf7d7e5341"
+};
+
+static BUFFER_HANDLE my_BUFFER_new(void)
+{
+    return TEST_BUFFER_HANDLE;
+}
+
+static unsigned char* my_BUFFER_u_char(BUFFER_HANDLE handle)
+{
+    (void)handle;
+    return g_scalar_hash;
+}
+
+static size_t my_BUFFER_length(BUFFER_HANDLE handle)
+{
+    (void)handle;
+    return sizeof(g_scalar_hash);
+}
+
+static HMACSHA256_RESULT my_HMACSHA256_ComputeHash(const unsigned char* key, size_t keyLen, const unsigned char* payload, size_t payloadLen, BUFFER_HANDLE hash)
+{
+    (void)key;
+    (void)keyLen;
+    (void)payload;
+    (void)payloadLen;
+    (void)hash;
+    (void)memset(g_scalar_hash, TEST_SCALAR_HASH_BYTE, sizeof(g_scalar_hash));
+    return HMACSHA256_OK;
+}
+
+static const char* hash_to_string(const unsigned char* hash)
+{
+    size_t i;
+    for (i = 0; i < HMACSHA256_BATCH_HASH_SIZE; i++)
+    {
+        (void)sprintf(g_hash_string + 2 * i, "%02x", hash[i]);
+    }
+    return g_hash_string;
+}
+
+static void set_item(HMACSHA256_BATCH_ITEM* item, const void* key, size_t key_length, const void* payload, size_t payload_length)
+{
+    (void)memset(item, 0, sizeof(HMACSHA256_BATCH_ITEM));
+    item->key = (const unsigned char*)key;
+    item->key_length = key_length;
+    item->payload = (const unsigned char*)payload;
+    item->payload_length = payload_length;
+}
+
+static void set_compute_hash_one_by_one_expected_calls(void)
+{
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(HMACSHA256_ComputeHash(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, TEST_BUFFER_HANDLE));
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_BUFFER_HANDLE));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_BUFFER_HANDLE));
+    STRICT_EXPECTED_CALL(BUFFER_delete(TEST_BUFFER_HANDLE));
+}
+
+BEGIN_TEST_SUITE(iothub_client_hmacsha256_batch_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    (void)umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HMACSHA256_RESULT, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_new, my_BUFFER_new);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_new, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, my_BUFFER_u_char);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_length, my_BUFFER_length);
+    REGISTER_GLOBAL_MOCK_HOOK(HMACSHA256_ComputeHash, my_HMACSHA256_ComputeHash);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HMACSHA256_ComputeHash, HMACSHA256_ERROR);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+    umock_c_reset_all_calls();
+    (void)memset(g_scalar_hash, 0, sizeof(g_scalar_hash));
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_HMACSHA256_BATCH_09_001: [ If `items` is NULL or `item_count` is zero, HMACSHA256_Batch_ComputeHashes shall fail and return non-zero. ] */
+TEST_FUNCTION(HMACSHA256_Batch_ComputeHashes_NULL_items_fails)
+{
+    //arrange
+    HMACSHA256_BATCH_ITEM item;
+    set_item(&item, TEST_KEY_2, strlen(TEST_KEY_2), TEST_DATA_2, strlen(TEST_DATA_2));
+
+    //act
+    int null_result = HMACSHA256_Batch_ComputeHashes(NULL, 1);
+    int zero_result = HMACSHA256_Batch_ComputeHashes(&item, 0);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, null_result);
+    ASSERT_ARE_NOT_EQUAL(int, 0, zero_result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_HMACSHA256_BATCH_09_002: [ If any item has a NULL `payload` with a non-zero `payload_length`, or a NULL `key` with a non-zero `key_length`, HMACSHA256_Batch_ComputeHashes shall fail and return non-zero. ] */
+TEST_FUNCTION(HMACSHA256_Batch_ComputeHashes_NULL_payload_fails)
+{
+    //arrange
+    HMACSHA256_BATCH_ITEM items[2];
+    set_item(&items[0], TEST_KEY_2, strlen(TEST_KEY_2), NULL, 4);
+    set_item(&items[1], NULL, 4, TEST_DATA_2, strlen(TEST_DATA_2));
+
+    //act
+    int result = HMACSHA256_Batch_ComputeHashes(items, 2);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_HMACSHA256_BATCH_09_004: [ The other items shall be signed in groups of up to 8, each item in its own lane of the SHA-256 compression. ] */
+TEST_FUNCTION(HMACSHA256_Batch_ComputeHashes_rfc4231_vectors_succeed)
+{
+    //arrange
+    unsigned char key_3[20];
+    unsigned char data_3[50];
+    unsigned char key_4[25];
+    unsigned char data_4[50];
+    HMACSHA256_BATCH_ITEM items[4];
+    size_t i;
+
+    (void)memset(key_3, 0xaa, sizeof(key_3));
+    (void)memset(data_3, 0xdd, sizeof(data_3));
+    for (i = 0; i < sizeof(key_4); i++)
+    {
+        key_4[i] = (unsigned char)(i + 1);
+    }
+    (void)memset(data_4, 0xcd, sizeof(data_4));
+
+    set_item(&items[0], TEST_KEY_1, sizeof(TEST_KEY_1), TEST_DATA_1, strlen(TEST_DATA_1));
+    set_item(&items[1], TEST_KEY_2, strlen(TEST_KEY_2), TEST_DATA_2, strlen(TEST_DATA_2));
+    set_item(&items[2], key_3, sizeof(key_3), data_3, sizeof(data_3));
+    set_item(&items[3], key_4, sizeof(key_4), data_4, sizeof(data_4));
+
+    //act
+    int result = HMACSHA256_Batch_ComputeHashes(items, 4);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_HASH_1, hash_to_string(items[0].hash));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_HASH_2, hash_to_string(items[1].hash));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_HASH_3, hash_to_string(items[2].hash));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_HASH_4, hash_to_string(items[3].hash));
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_HMACSHA256_BATCH_09_004: [ The other items shall be signed in groups of up to 8, each item in its own lane of the SHA-256 compression. ] */
+TEST_FUNCTION(HMACSHA256_Batch_ComputeHashes_payloads_of_different_block_counts_succeed)
+{
+    //arrange
+    size_t count = sizeof(TEST_PAYLOAD_LENGTHS) / sizeof(TEST_PAYLOAD_LENGTHS[0]);
+    HMACSHA256_BATCH_ITEM items[sizeof(TEST_PAYLOAD_LENGTHS) / sizeof(TEST_PAYLOAD_LENGTHS[0])];
+    unsigned char payload[200];
+    size_t i;
+
+    (void)memset(payload, 'a', sizeof(payload));
+    for (i = 0; i < count; i++)
+    {
+        set_item(&items[i], "key", 3, payload, TEST_PAYLOAD_LENGTHS[i]);
+    }
+
+    //act
+    int result = HMACSHA256_Batch_ComputeHashes(items, count);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    for (i = 0; i < count; i++)
+    {
+        ASSERT_ARE_EQUAL(char_ptr, TEST_PAYLOAD_HASHES[i], hash_to_string(items[i].hash));
+    }
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_HMACSHA256_BATCH_09_004: [ The other items shall be signed in groups of up to 8, each item in its own lane of the SHA-256 compression. ] */
+/* Tests_SRS_IOTHUB_CLIENT_HMACSHA256_BATCH_09_005: [ A group of a single item shall be signed with HMACSHA256_ComputeHash. ] */
+TEST_FUNCTION(HMACSHA256_Batch_ComputeHashes_9_items_signs_the_last_one_alone)
+{
+    //arrange
+    HMACSHA256_BATCH_ITEM items[9];
+    size_t i;
+
+    for (i = 0; i < 9; i++)
+    {
+        set_item(&items[i], TEST_KEY_2, strlen(TEST_KEY_2), TEST_DATA_2, strlen(TEST_DATA_2));
+    }
+
+    set_compute_hash_one_by_one_expected_calls();
+
+    //act
+    int result = HMACSHA256_Batch_ComputeHashes(items, 9);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    for (i = 0; i < 8; i++)
+    {
+        ASSERT_ARE_EQUAL(char_ptr, TEST_HASH_2, hash_to_string(items[i].hash));
+    }
+    ASSERT_ARE_EQUAL(int, TEST_SCALAR_HASH_BYTE, (int)items[8].hash[0]);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_HMACSHA256_BATCH_09_003: [ Items with a key longer than 64 bytes shall be signed with HMACSHA256_ComputeHash. ] */
+TEST_FUNCTION(HMACSHA256_Batch_ComputeHashes_long_key_signed_alone)
+{
+    //arrange
+    unsigned char long_key[131];
+    HMACSHA256_BATCH_ITEM items[3];
+
+    (void)memset(long_key, 0xaa, sizeof(long_key));
+    set_item(&items[0], TEST_KEY_1, sizeof(TEST_KEY_1), TEST_DATA_1, strlen(TEST_DATA_1));
+    set_item(&items[1], long_key, sizeof(long_key), TEST_DATA_6, strlen(TEST_DATA_6));
+    set_item(&items[2], TEST_KEY_2, strlen(TEST_KEY_2), TEST_DATA_2, strlen(TEST_DATA_2));
+
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(HMACSHA256_ComputeHash(IGNORED_PTR_ARG, sizeof(long_key), IGNORED_PTR_ARG, strlen(TEST_DATA_6), TEST_BUFFER_HANDLE));
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_BUFFER_HANDLE));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_BUFFER_HANDLE));
+    STRICT_EXPECTED_CALL(BUFFER_delete(TEST_BUFFER_HANDLE));
+
+    //act
+    int result = HMACSHA256_Batch_ComputeHashes(items, 3);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_HASH_1, hash_to_string(items[0].hash));
+    ASSERT_ARE_EQUAL(int, TEST_SCALAR_HASH_BYTE, (int)items[1].hash[0]);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_HASH_2, hash_to_string(items[2].hash));
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_HMACSHA256_BATCH_09_005: [ A group of a single item shall be signed with HMACSHA256_ComputeHash. ] */
+TEST_FUNCTION(HMACSHA256_Batch_ComputeHashes_single_item_HMACSHA256_ComputeHash_fails)
+{
+    //arrange
+    HMACSHA256_BATCH_ITEM item;
+    set_item(&item, TEST_KEY_2, strlen(TEST_KEY_2), TEST_DATA_2, strlen(TEST_DATA_2));
+
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(HMACSHA256_ComputeHash(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, TEST_BUFFER_HANDLE))
+        .SetReturn(HMACSHA256_ERROR);
+    STRICT_EXPECTED_CALL(BUFFER_delete(TEST_BUFFER_HANDLE));
+
+    //act
+    int result = HMACSHA256_Batch_ComputeHashes(&item, 1);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothub_client_hmacsha256_batch_ut)
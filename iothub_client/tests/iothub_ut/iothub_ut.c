@@ -19,6 +19,9 @@
 
 #define ENABLE_MOCKS
 #include "azure_c_shared_utility/platform.h"
+#ifdef USE_EDGE_MODULES
+#include "internal/iothub_client_trust_bundle.h"
+#endif
 #undef ENABLE_MOCKS
 
 #include "iothub.h"
@@ -44,6 +47,9 @@ TEST_SUITE_INITIALIZE(suite_init)
 
     REGISTER_GLOBAL_MOCK_RETURN(platform_init, 0);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(platform_init, __LINE__);
+#ifdef USE_EDGE_MODULES
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_TrustBundle_Init, 0);
+#endif
 }
 
 TEST_SUITE_CLEANUP(suite_cleanup)
@@ -56,6 +62,9 @@ TEST_FUNCTION(IoTHub_Init_succeed)
 {
     //arrange
     STRICT_EXPECTED_CALL(platform_init());
+#ifdef USE_EDGE_MODULES
+    STRICT_EXPECTED_CALL(IoTHubClient_TrustBundle_Init());
+#endif
 
     //act
     int result = IoTHub_Init();
@@ -78,9 +87,29 @@ TEST_FUNCTION(IoTHub_Init_fail)
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
+#ifdef USE_EDGE_MODULES
+TEST_FUNCTION(IoTHub_Init_trust_bundle_fail)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(platform_init());
+    STRICT_EXPECTED_CALL(IoTHubClient_TrustBundle_Init()).SetReturn(__LINE__);
+    STRICT_EXPECTED_CALL(platform_deinit());
+
+    //act
+    int result = IoTHub_Init();
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+#endif
+
 TEST_FUNCTION(IoTHub_Deinit_succeed)
 {
     //arrange
+#ifdef USE_EDGE_MODULES
+    STRICT_EXPECTED_CALL(IoTHubClient_TrustBundle_Deinit());
+#endif
     STRICT_EXPECTED_CALL(platform_deinit());
 
     //act
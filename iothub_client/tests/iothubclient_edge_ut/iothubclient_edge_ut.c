@@ -42,7 +42,9 @@ static void real_free(void* ptr)
 #include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/envvariable.h"
+#include "azure_c_shared_utility/lock.h"
 #include "internal/iothub_client_authorization.h"
+#include "internal/iothub_client_trust_bundle.h"
 #include "parson.h"
 
 MOCKABLE_FUNCTION(, JSON_Value*, json_parse_string, const char*, string);
@@ -105,9 +107,11 @@ extern "C"
 #endif
 
 static const IOTHUB_AUTHORIZATION_HANDLE TEST_AUTHORIZATION_HANDLE = (IOTHUB_AUTHORIZATION_HANDLE)0x0001;
+static const char* TEST_TRUST_BUNDLE = "test_trust_bundle";
 static const IOTHUB_CLIENT_EDGE_HANDLE TEST_MODULE_CLIENT_METHOD_HANDLE = (IOTHUB_CLIENT_EDGE_HANDLE)0x0002;
 static JSON_Object* DUMMY_JSON_OBJECT = (JSON_Object*)0x0003;
 static JSON_Value* DUMMY_JSON_VALUE = (JSON_Value*)0x0004;
+static LOCK_HANDLE TEST_LOCK_HANDLE = (LOCK_HANDLE)0x0005;
 
 static const char* TEST_DEVICE_ID = "deviceId";
 static const char* TEST_DEVICE_ID2 = "otherDeviceId";
@@ -230,13 +234,6 @@ static char* my_IoTHubClient_Auth_Get_SasToken(IOTHUB_AUTHORIZATION_HANDLE handl
     return (char*)real_malloc(1);
 }
 
-static char* my_IoTHubClient_Auth_Get_TrustBundle(IOTHUB_AUTHORIZATION_HANDLE handle, const char* certificate_file_name)
-{
-    (void)handle;
-    (void)certificate_file_name;
-    return (char*)real_malloc(1);
-}
-
 static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 {
     char temp_str[256];
@@ -280,7 +277,7 @@ static void createMethodPayloadExpectedCalls()
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));   //cannot fail
 }
 
-static void sendHttpRequestMethodExpectedCalls()
+static void sendHttpRequestMethodExpectedCalls(bool newConnection)
 {
     STRICT_EXPECTED_CALL(environment_get_variable(IGNORED_PTR_ARG)).CallCannotFail();
     STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
@@ -303,14 +300,37 @@ static void sendHttpRequestMethodExpectedCalls()
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));    //cannot fail
 
     STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_TrustBundle(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(HTTPAPIEX_SetOption(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    if (newConnection)
+    {
+        // Only the first invoke on a handle acquires the trust bundle and opens a connection, later ones reuse it;
+        // their failures are covered by the IoTHubClient_Edge_DeviceMethodInvoke_*_FAIL tests on a new handle.
+        STRICT_EXPECTED_CALL(IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, IGNORED_PTR_ARG)).CallCannotFail();
+        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG)).CallCannotFail();
+        STRICT_EXPECTED_CALL(HTTPAPIEX_SetOption(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).CallCannotFail();
+    }
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE)).CallCannotFail();
     STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));    //cannot fail
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));       //cannot fail
-    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));   //cannot fail
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));        //cannot fail
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE)).CallCannotFail();  //the connection is closed instead of kept
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE)).CallCannotFail();
+}
+
+static void destroyHandleExpectedCalls(size_t idleConnectionCount, const char* trustBundle)
+{
+    size_t index;
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    for (index = 0; index < idleConnectionCount; index++)
+    {
+        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    }
+    STRICT_EXPECTED_CALL(IoTHubClient_TrustBundle_Release(trustBundle));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 }
 
 static void parseResponseJsonExpectedCalls()
@@ -354,6 +374,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_AUTHORIZATION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPI_REQUEST_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
 
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
@@ -416,8 +438,15 @@ TEST_SUITE_INITIALIZE(suite_init)
 
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_Auth_Get_SasToken, my_IoTHubClient_Auth_Get_SasToken);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_Auth_Get_SasToken, NULL);
-    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_Auth_Get_TrustBundle, my_IoTHubClient_Auth_Get_TrustBundle);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_Auth_Get_TrustBundle, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_TrustBundle_Acquire, TEST_TRUST_BUNDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_TrustBundle_Acquire, NULL);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Unlock, LOCK_ERROR);
 }
 
 TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
@@ -496,6 +525,7 @@ TEST_FUNCTION(IoTHubClient_EdgeHandle_Create_SUCCESS)
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
 
     //act
     IOTHUB_CLIENT_EDGE_HANDLE handle = IoTHubClient_EdgeHandle_Create(&config, TEST_AUTHORIZATION_HANDLE, TEST_MODULE_ID);
@@ -522,6 +552,7 @@ TEST_FUNCTION(IoTHubClient_EdgeHandle_Create_FAIL)
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
 
     umock_c_negative_tests_snapshot();
 
@@ -573,10 +604,7 @@ TEST_FUNCTION(IoTHubClient_EdgeHandle_Destroy_SUCCESS)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    destroyHandleExpectedCalls(0, NULL);
 
     //act
     IoTHubClient_EdgeHandle_Destroy(handle);
@@ -739,7 +767,7 @@ TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvoke_SUCCESS)
 
     createMethodPayloadExpectedCalls();
     STRICT_EXPECTED_CALL(BUFFER_new());
-    sendHttpRequestMethodExpectedCalls();
+    sendHttpRequestMethodExpectedCalls(true);
     parseResponseJsonExpectedCalls();
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));   //cannot fail
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));   //cannot fail
@@ -771,7 +799,7 @@ TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvoke_FAIL)
 
     createMethodPayloadExpectedCalls();
     STRICT_EXPECTED_CALL(BUFFER_new());
-    sendHttpRequestMethodExpectedCalls();
+    sendHttpRequestMethodExpectedCalls(true);
     parseResponseJsonExpectedCalls();
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
@@ -801,6 +829,165 @@ TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvoke_FAIL)
     umock_c_negative_tests_deinit();
 }
 
+TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvoke_second_call_reuses_connection)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    int responseStatus;
+    unsigned char* responsePayload;
+    size_t responsePayloadSize;
+
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Edge_DeviceMethodInvoke(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, &responseStatus, &responsePayload, &responsePayloadSize);
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_OK);
+    free(responsePayload);
+
+    umock_c_reset_all_calls();
+
+    createMethodPayloadExpectedCalls();
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    sendHttpRequestMethodExpectedCalls(false);
+    parseResponseJsonExpectedCalls();
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));   //cannot fail
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));   //cannot fail
+
+    //act
+    result = IoTHubClient_Edge_DeviceMethodInvoke(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, &responseStatus, &responsePayload, &responsePayloadSize);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_OK);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(responsePayload);
+    umock_c_reset_all_calls();
+    destroyHandleExpectedCalls(1, TEST_TRUST_BUNDLE);
+    IoTHubClient_EdgeHandle_Destroy(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvoke_failed_request_closes_connection)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    int responseStatus;
+    unsigned char* responsePayload;
+    size_t responsePayloadSize;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG))
+        .SetReturn(HTTPAPIEX_ERROR);
+    STRICT_EXPECTED_CALL(IoTHubClient_TrustBundle_Release(TEST_TRUST_BUNDLE));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Edge_DeviceMethodInvoke(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, &responseStatus, &responsePayload, &responsePayloadSize);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_ERROR);
+
+    //cleanup
+    umock_c_reset_all_calls();
+    destroyHandleExpectedCalls(0, NULL);
+    IoTHubClient_EdgeHandle_Destroy(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvoke_after_failed_request_acquires_trust_bundle_again)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    int responseStatus;
+    unsigned char* responsePayload;
+    size_t responsePayloadSize;
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG))
+        .SetReturn(HTTPAPIEX_ERROR);
+    ASSERT_IS_TRUE(IoTHubClient_Edge_DeviceMethodInvoke(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, &responseStatus, &responsePayload, &responsePayloadSize) == IOTHUB_CLIENT_ERROR);
+    umock_c_reset_all_calls();
+
+    createMethodPayloadExpectedCalls();
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    sendHttpRequestMethodExpectedCalls(true);
+    parseResponseJsonExpectedCalls();
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Edge_DeviceMethodInvoke(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, &responseStatus, &responsePayload, &responsePayloadSize);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_OK);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(responsePayload);
+    IoTHubClient_EdgeHandle_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvoke_trust_bundle_FAIL)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    int responseStatus;
+    unsigned char* responsePayload;
+    size_t responsePayloadSize;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, IGNORED_PTR_ARG)).SetReturn(NULL);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Edge_DeviceMethodInvoke(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, &responseStatus, &responsePayload, &responsePayloadSize);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_ERROR);
+
+    //cleanup
+    IoTHubClient_EdgeHandle_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvoke_HTTPAPIEX_Create_FAIL)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    int responseStatus;
+    unsigned char* responsePayload;
+    size_t responsePayloadSize;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG)).SetReturn(NULL);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Edge_DeviceMethodInvoke(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, &responseStatus, &responsePayload, &responsePayloadSize);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_ERROR);
+
+    //cleanup
+    IoTHubClient_EdgeHandle_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvoke_HTTPAPIEX_SetOption_FAIL)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    int responseStatus;
+    unsigned char* responsePayload;
+    size_t responsePayloadSize;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SetOption(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn(HTTPAPIEX_ERROR);
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Edge_DeviceMethodInvoke(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, &responseStatus, &responsePayload, &responsePayloadSize);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_ERROR);
+
+    //cleanup
+    IoTHubClient_EdgeHandle_Destroy(handle);
+}
+
 TEST_FUNCTION(IoTHubClient_Edge_ModuleMethodInvoke_NULL_ARG_moduleMethodHandle)
 {
     //arrange
@@ -974,7 +1161,7 @@ TEST_FUNCTION(IoTHubClient_Edge_ModuleMethodInvoke_SUCCESS)
 
     createMethodPayloadExpectedCalls();
     STRICT_EXPECTED_CALL(BUFFER_new());
-    sendHttpRequestMethodExpectedCalls();
+    sendHttpRequestMethodExpectedCalls(true);
     parseResponseJsonExpectedCalls();
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));   //cannot fail
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));   //cannot fail
@@ -1006,7 +1193,7 @@ TEST_FUNCTION(IoTHubClient_Edge_ModuleMethodInvoke_FAIL)
 
     createMethodPayloadExpectedCalls();
     STRICT_EXPECTED_CALL(BUFFER_new());
-    sendHttpRequestMethodExpectedCalls();
+    sendHttpRequestMethodExpectedCalls(true);
     parseResponseJsonExpectedCalls();
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));   //cannot fail
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));   //cannot fail
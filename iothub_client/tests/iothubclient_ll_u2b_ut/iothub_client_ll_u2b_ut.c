@@ -3,9 +3,15 @@
 
 #ifdef __cplusplus
 #include <cstdlib>
+#include <cstdio>
+#include <cstdint>
 #else
 #include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
 #endif
+#include <sys/types.h>
+#include <sys/stat.h>
 
 static void* my_gballoc_malloc(size_t size)
 {
@@ -44,6 +50,7 @@ static void* my_gballoc_calloc(size_t nmemb, size_t size)
 #include "azure_c_shared_utility/urlencode.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/shared_util_options.h"
+#include "azure_c_shared_utility/sha.h"
 
 #include "internal/blob.h"
 #include "internal/iothub_client_authorization.h"
@@ -52,6 +59,10 @@ static void* my_gballoc_calloc(size_t nmemb, size_t size)
 
 #define BLOCK_SIZE (4*1024*1024)
 
+MOCKABLE_FUNCTION(, int, SHA256Reset, SHA256Context*, ctx);
+MOCKABLE_FUNCTION(, int, SHA256Input, SHA256Context*, ctx, const uint8_t*, bytes, unsigned int, bytecount);
+MOCKABLE_FUNCTION(, int, SHA256Result, SHA256Context*, ctx, uint8_t*, Message_Digest);
+
 MOCKABLE_FUNCTION(, JSON_Value*, json_parse_string, const char *, string);
 MOCKABLE_FUNCTION(, const char*, json_object_get_string, const JSON_Object *, object, const char *, name);
 MOCKABLE_FUNCTION(, void, json_value_free, JSON_Value *, value);
@@ -79,6 +90,9 @@ static const char* const TEST_CERT = "test_cert";
 static const unsigned char* TEST_SOURCE = (const unsigned char*)0x3;
 static const size_t TEST_SOURCE_LENGTH = 3;
 static const char* const TEST_DESTINATION_FILENAME = "text.txt";
+static const char* const TEST_UPLOAD_SOURCE_FILE = "iothub_client_ll_u2b_ut_source.txt";
+static const char* const TEST_UPLOAD_CHECKPOINT_FILE = "iothub_client_ll_u2b_ut_checkpoint.txt";
+static const uint8_t TEST_SOURCE_DIGEST[32] = { 0 };
 
 #ifdef __cplusplus
 extern "C"
@@ -297,6 +311,49 @@ static int my_IoTHubClient_Auth_Get_x509_info(IOTHUB_AUTHORIZATION_HANDLE handle
     return 0;
 }
 
+/*the bytes of the test source file, 251 being prime the blocks do not start on a page boundary of the pattern*/
+#define TEST_SOURCE_FILE_BYTE(offset) ((unsigned char)((offset) % 251))
+
+static size_t g_uploaded_block_count;
+static size_t g_uploaded_size;
+static bool g_uploaded_blocks_match_source;
+
+/*hands out all the blocks of the source like Blob_UploadMultipleBlocksFromSasUri, checking them against the test source file*/
+static BLOB_RESULT my_Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, HTTP_PROXY_OPTIONS* proxyOptions, size_t concurrentBlocks, unsigned int* uploadedBlockCount, BLOB_UPLOAD_PROGRESS_CALLBACK uploadProgressCallback, void* uploadProgressContext)
+{
+    unsigned char const * data;
+    size_t size;
+    (void)SASURI;
+    (void)httpStatus;
+    (void)httpResponse;
+    (void)certificates;
+    (void)proxyOptions;
+    (void)concurrentBlocks;
+    (void)uploadedBlockCount;
+    (void)uploadProgressCallback;
+    (void)uploadProgressContext;
+
+    g_uploaded_block_count = 0;
+    g_uploaded_size = 0;
+    g_uploaded_blocks_match_source = true;
+
+    while (getDataCallbackEx(FILE_UPLOAD_OK, &data, &size, context) == IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_OK && data != NULL && size > 0)
+    {
+        size_t i;
+        for (i = 0; i < size; i++)
+        {
+            if (data[i] != TEST_SOURCE_FILE_BYTE(g_uploaded_size + i))
+            {
+                g_uploaded_blocks_match_source = false;
+            }
+        }
+        g_uploaded_size += size;
+        g_uploaded_block_count++;
+    }
+
+    return BLOB_OK;
+}
+
 /**
  * BLOB_UPLOAD_CONTEXT and FileUpload_GetData_Callback
  * allow to simulate a user who wants to upload
@@ -491,8 +548,12 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_SAS_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(const unsigned char*, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const uint8_t*, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(uint8_t*, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(SHA256Context*, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(BLOB_UPLOAD_PROGRESS_CALLBACK, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_AUTHORIZATION_HANDLE, void*);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
@@ -565,6 +626,15 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 
     REGISTER_GLOBAL_MOCK_RETURN(Blob_UploadMultipleBlocksFromSasUri, BLOB_OK);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(Blob_UploadMultipleBlocksFromSasUri, BLOB_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Blob_GetUncommittedBlockCount, BLOB_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Blob_GetUncommittedBlockCount, BLOB_ERROR);
+
+    REGISTER_GLOBAL_MOCK_RETURN(SHA256Reset, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(SHA256Reset, MU_FAILURE);
+    REGISTER_GLOBAL_MOCK_RETURN(SHA256Input, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(SHA256Input, MU_FAILURE);
+    REGISTER_GLOBAL_MOCK_RETURN(SHA256Result, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(SHA256Result, MU_FAILURE);
 
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, MU_FAILURE);
     REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
@@ -719,18 +789,34 @@ static void setup_steps_3(IOTHUB_CREDENTIAL_TYPE cred_type)
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
 }
 
-static void setup_Blob_UploadMultipleBlocksFromSasUri_mocks(IOTHUB_CREDENTIAL_TYPE cred_type, BLOB_RESULT blob_result, bool null_buffer)
+static void setup_Blob_UploadMultipleBlocksFromSasUri_mocks(IOTHUB_CREDENTIAL_TYPE cred_type, BLOB_RESULT blob_result, bool null_buffer, bool read_checkpoint, bool resume)
 {
     STRICT_EXPECTED_CALL(BUFFER_new());
     STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).CallCannotFail();
+    if (read_checkpoint)
+    {
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*the name of the checkpoint of the blob*/
+        STRICT_EXPECTED_CALL(gballoc_calloc(1, IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    }
+    if (resume)
+    {
+        unsigned int uncommitted_block_count = 2;
+        STRICT_EXPECTED_CALL(Blob_GetUncommittedBlockCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer_blockCount(&uncommitted_block_count, sizeof(uncommitted_block_count));
+    }
 
     unsigned int status_code;
     if (BLOB_OK != blob_result)
     {
         status_code = 404;
-        STRICT_EXPECTED_CALL(Blob_UploadMultipleBlocksFromSasUri(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(Blob_UploadMultipleBlocksFromSasUri(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .CopyOutArgumentBuffer_httpStatus(&status_code, sizeof(status_code))
             .SetReturn(blob_result);
+        if (read_checkpoint)
+        {
+            STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        }
         STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(STRING_length(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
@@ -742,8 +828,12 @@ static void setup_Blob_UploadMultipleBlocksFromSasUri_mocks(IOTHUB_CREDENTIAL_TY
     else
     {
         status_code = 200;
-        STRICT_EXPECTED_CALL(Blob_UploadMultipleBlocksFromSasUri(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(Blob_UploadMultipleBlocksFromSasUri(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .CopyOutArgumentBuffer_httpStatus(&status_code, sizeof(status_code)).CallCannotFail();
+        if (read_checkpoint)
+        {
+            STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        }
 
         if (null_buffer)
         {
@@ -764,7 +854,7 @@ static void setup_Blob_UploadMultipleBlocksFromSasUri_mocks(IOTHUB_CREDENTIAL_TY
     }
 }
 
-static void setup_upload_blocks_mocks(IOTHUB_CREDENTIAL_TYPE cred_type, bool proxy, bool set_timeout, bool trusted_cert, BLOB_RESULT blob_result, bool null_buffer)
+static void setup_upload_blocks_mocks_ex(IOTHUB_CREDENTIAL_TYPE cred_type, bool proxy, bool set_timeout, bool trusted_cert, BLOB_RESULT blob_result, bool null_buffer, bool read_checkpoint, bool resume)
 {
     STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG));
     if (set_timeout)
@@ -791,7 +881,7 @@ static void setup_upload_blocks_mocks(IOTHUB_CREDENTIAL_TYPE cred_type, bool pro
 
     setup_steps_1_and_2_mocks(cred_type);
 
-    setup_Blob_UploadMultipleBlocksFromSasUri_mocks(cred_type, blob_result, null_buffer);
+    setup_Blob_UploadMultipleBlocksFromSasUri_mocks(cred_type, blob_result, null_buffer, read_checkpoint, resume);
 
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
@@ -799,6 +889,101 @@ static void setup_upload_blocks_mocks(IOTHUB_CREDENTIAL_TYPE cred_type, bool pro
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
 }
+
+static void setup_upload_blocks_mocks(IOTHUB_CREDENTIAL_TYPE cred_type, bool proxy, bool set_timeout, bool trusted_cert, BLOB_RESULT blob_result, bool null_buffer)
+{
+    setup_upload_blocks_mocks_ex(cred_type, proxy, set_timeout, trusted_cert, blob_result, null_buffer, false, false);
+}
+
+/*each blob has its own checkpoint, named after the FNV-1a hash of the blob uri, the sas uri returned by STRING_c_str without its query*/
+static const char* get_test_checkpoint_file_name(void)
+{
+    static char file_name[128];
+    uint32_t hash = 2166136261u;
+    const char* c;
+    for (c = TEST_DEFAULT_STRING_VALUE; *c != '\0' && *c != '?'; c++)
+    {
+        hash = (hash ^ (unsigned char)*c) * 16777619u;
+    }
+    (void)snprintf(file_name, sizeof(file_name), "%s.%08lx", TEST_UPLOAD_CHECKPOINT_FILE, (unsigned long)hash);
+    return file_name;
+}
+
+static void write_test_checkpoint(const char* source_id)
+{
+    FILE* checkpoint = fopen(get_test_checkpoint_file_name(), "w");
+    ASSERT_IS_NOT_NULL(checkpoint);
+    /*the blob uri is the sas uri returned by STRING_c_str without its query*/
+    ASSERT_IS_TRUE(fprintf(checkpoint, "2\n%s\n%s\n", TEST_DEFAULT_STRING_VALUE, source_id) > 0);
+    (void)fclose(checkpoint);
+}
+
+static void write_test_source_file(void)
+{
+    FILE* source_file = fopen(TEST_UPLOAD_SOURCE_FILE, "wb");
+    ASSERT_IS_NOT_NULL(source_file);
+    ASSERT_ARE_EQUAL(size_t, TEST_SOURCE_LENGTH, fwrite("0123456789", 1, TEST_SOURCE_LENGTH, source_file));
+    (void)fclose(source_file);
+}
+
+static void get_test_source_file_id(size_t block_size, char* source_id, size_t source_id_size)
+{
+#ifdef _WIN32
+    struct _stat64 file_stat;
+    ASSERT_ARE_EQUAL(int, 0, _stat64(TEST_UPLOAD_SOURCE_FILE, &file_stat));
+#else
+    struct stat file_stat;
+    ASSERT_ARE_EQUAL(int, 0, stat(TEST_UPLOAD_SOURCE_FILE, &file_stat));
+#endif
+    (void)snprintf(source_id, source_id_size, "%lu %llu %lld", (unsigned long)block_size, (unsigned long long)file_stat.st_size, (long long)file_stat.st_mtime);
+}
+
+/*uploads the next block only, failing like Blob_UploadMultipleBlocksFromSasUri does when getDataCallbackEx aborts*/
+static BLOB_RESULT my_Blob_UploadMultipleBlocksFromSasUri_gets_next_block(const char* SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, HTTP_PROXY_OPTIONS* proxyOptions, size_t concurrentBlocks, unsigned int* uploadedBlockCount, BLOB_UPLOAD_PROGRESS_CALLBACK uploadProgressCallback, void* uploadProgressContext)
+{
+    unsigned char const * data;
+    size_t size;
+    (void)SASURI;
+    (void)httpStatus;
+    (void)httpResponse;
+    (void)certificates;
+    (void)proxyOptions;
+    (void)concurrentBlocks;
+    (void)uploadedBlockCount;
+    (void)uploadProgressCallback;
+    (void)uploadProgressContext;
+
+    return (getDataCallbackEx(FILE_UPLOAD_OK, &data, &size, context) == IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_ABORT) ? BLOB_ABORTED : BLOB_OK;
+}
+
+static char g_checkpoint_during_upload[256];
+
+/*reports the first block as uploaded and keeps what the checkpoint of the blob holds at that point*/
+static BLOB_RESULT my_Blob_UploadMultipleBlocksFromSasUri_reports_progress(const char* SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, HTTP_PROXY_OPTIONS* proxyOptions, size_t concurrentBlocks, unsigned int* uploadedBlockCount, BLOB_UPLOAD_PROGRESS_CALLBACK uploadProgressCallback, void* uploadProgressContext)
+{
+    FILE* checkpoint;
+    size_t length = 0;
+    (void)SASURI;
+    (void)getDataCallbackEx;
+    (void)context;
+    (void)httpStatus;
+    (void)httpResponse;
+    (void)certificates;
+    (void)proxyOptions;
+    (void)concurrentBlocks;
+
+    *uploadedBlockCount = 1;
+    uploadProgressCallback(*uploadedBlockCount, uploadProgressContext);
+
+    if ((checkpoint = fopen(get_test_checkpoint_file_name(), "r")) != NULL)
+    {
+        length = fread(g_checkpoint_during_upload, 1, sizeof(g_checkpoint_during_upload) - 1, checkpoint);
+        (void)fclose(checkpoint);
+    }
+    g_checkpoint_during_upload[length] = '\0';
+
+    return BLOB_OK;
+}
 TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_Create_sas_token_succeeds)
 {
     //arrange
@@ -1039,6 +1224,389 @@ TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_Impl_succeeds)
     IoTHubClient_LL_UploadToBlob_Destroy(h);
 }
 
+/*Tests_SRS_IOTHUBCLIENT_LL_09_074: [ If `handle`, `destinationFileName` or `sourceFilePath` are NULL, `IoTHubClient_LL_UploadFileToBlob` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_Impl_handle_NULL_fails)
+{
+    //arrange
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob_Impl(NULL, TEST_DESTINATION_FILENAME, TEST_UPLOAD_SOURCE_FILE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_074: [ If `handle`, `destinationFileName` or `sourceFilePath` are NULL, `IoTHubClient_LL_UploadFileToBlob` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_Impl_sourceFilePath_NULL_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob_Impl(h, TEST_DESTINATION_FILENAME, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_076: [ If `sourceFilePath` fails to be opened, `IoTHubClient_LL_UploadFileToBlob` shall fail and return `IOTHUB_CLIENT_ERROR`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_Impl_missing_file_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)remove(TEST_UPLOAD_SOURCE_FILE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_UPLOAD_SOURCE_FILE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_075: [ `IoTHubClient_LL_UploadFileToBlob` shall open `sourceFilePath` read-only, without mapping nor reading its content. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_09_077: [ `IoTHubClient_LL_UploadFileToBlob` shall call `IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl` with `FileUpload_GetData_Callback`, which maps the next `blob_upload_block_size` bytes of the file read-only for each block, releasing the mapping of the previous block, or reads them in a buffer of one block on platforms without memory mapped files. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_09_078: [ `IoTHubClient_LL_UploadFileToBlob` shall release the mapping of the last block and close `sourceFilePath` once the upload finishes. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_Impl_succeeds)
+{
+    //arrange
+    FILE* source_file = fopen(TEST_UPLOAD_SOURCE_FILE, "wb");
+    ASSERT_IS_NOT_NULL(source_file);
+    ASSERT_ARE_EQUAL(size_t, TEST_SOURCE_LENGTH, fwrite("0123456789", 1, TEST_SOURCE_LENGTH, source_file));
+    (void)fclose(source_file);
+
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_TRUSTED_CERT, TEST_CERT);
+    umock_c_reset_all_calls();
+
+    setup_upload_blocks_mocks(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN, false, false, true, BLOB_OK, false);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_UPLOAD_SOURCE_FILE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+    (void)remove(TEST_UPLOAD_SOURCE_FILE);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_077: [ `IoTHubClient_LL_UploadFileToBlob` shall call `IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl` with `FileUpload_GetData_Callback`, which maps the next `blob_upload_block_size` bytes of the file read-only for each block, releasing the mapping of the previous block, or reads them in a buffer of one block on platforms without memory mapped files. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_Impl_hands_out_the_file_block_by_block)
+{
+    //arrange
+    size_t i;
+    FILE* source_file = fopen(TEST_UPLOAD_SOURCE_FILE, "wb");
+    ASSERT_IS_NOT_NULL(source_file);
+    for (i = 0; i < BLOCK_SIZE + TEST_SOURCE_LENGTH; i++)
+    {
+        ASSERT_ARE_NOT_EQUAL(int, EOF, fputc(TEST_SOURCE_FILE_BYTE(i), source_file));
+    }
+    (void)fclose(source_file);
+
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_TRUSTED_CERT, TEST_CERT);
+    umock_c_reset_all_calls();
+
+    REGISTER_GLOBAL_MOCK_HOOK(Blob_UploadMultipleBlocksFromSasUri, my_Blob_UploadMultipleBlocksFromSasUri);
+    setup_upload_blocks_mocks(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN, false, false, true, BLOB_OK, false);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_UPLOAD_SOURCE_FILE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, g_uploaded_block_count);
+    ASSERT_ARE_EQUAL(size_t, BLOCK_SIZE + TEST_SOURCE_LENGTH, g_uploaded_size);
+    ASSERT_IS_TRUE(g_uploaded_blocks_match_source);
+
+    //cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(Blob_UploadMultipleBlocksFromSasUri, NULL);
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+    (void)remove(TEST_UPLOAD_SOURCE_FILE);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_069: [ If `blob_upload_checkpoint_file` is set and the checkpoint of the blob records blocks uploaded from the same source, `IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)` shall resume after the blocks that are also listed by `Blob_GetUncommittedBlockCount`. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_09_091: [ If `blob_upload_checkpoint_file` is set, `IoTHubClient_LL_UploadFileToBlob` shall identify `sourceFilePath` in the checkpoint by the block size, the size of the file and the time it was last modified. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_Impl_resumes_from_checkpoint_of_same_file)
+{
+    //arrange
+    char source_id[128];
+    write_test_source_file();
+    get_test_source_file_id(BLOCK_SIZE, source_id, sizeof(source_id));
+    write_test_checkpoint(source_id);
+
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_CHECKPOINT_FILE, TEST_UPLOAD_CHECKPOINT_FILE);
+    umock_c_reset_all_calls();
+
+    setup_upload_blocks_mocks_ex(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN, false, false, false, BLOB_OK, false, true, true);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_UPLOAD_SOURCE_FILE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+    (void)remove(get_test_checkpoint_file_name());
+    (void)remove(TEST_UPLOAD_SOURCE_FILE);
+}
+
+#ifdef __linux__
+/*Tests_SRS_IOTHUBCLIENT_LL_09_092: [ If the next block of the file fails to be mapped or read, `FileUpload_GetData_Callback` shall return `IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_ABORT` and report the source as failed. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_09_093: [ If the upload was aborted because the source failed to be read, `IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)` shall handle it as a failure of `Blob_UploadMultipleBlocksFromSasUri`, keeping the checkpoint of the blob. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_Impl_read_failure_fails_and_keeps_checkpoint)
+{
+    //arrange
+    char source_id[128];
+    char expected_checkpoint[256];
+    char checkpoint_content[256];
+    size_t checkpoint_length;
+    FILE* checkpoint;
+    /*a directory opens like a file on Linux, but cannot be mapped*/
+    ASSERT_ARE_EQUAL(int, 0, mkdir(TEST_UPLOAD_SOURCE_FILE, 0700));
+    get_test_source_file_id(BLOCK_SIZE, source_id, sizeof(source_id));
+    write_test_checkpoint(source_id);
+    (void)snprintf(expected_checkpoint, sizeof(expected_checkpoint), "2\n%s\n%s\n", TEST_DEFAULT_STRING_VALUE, source_id);
+
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_CHECKPOINT_FILE, TEST_UPLOAD_CHECKPOINT_FILE);
+    umock_c_reset_all_calls();
+
+    REGISTER_GLOBAL_MOCK_HOOK(Blob_UploadMultipleBlocksFromSasUri, my_Blob_UploadMultipleBlocksFromSasUri_gets_next_block);
+    setup_upload_blocks_mocks_ex(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN, false, false, false, BLOB_ABORTED, false, true, true);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_UPLOAD_SOURCE_FILE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    checkpoint = fopen(get_test_checkpoint_file_name(), "r");
+    ASSERT_IS_NOT_NULL(checkpoint);
+    checkpoint_length = fread(checkpoint_content, 1, sizeof(checkpoint_content) - 1, checkpoint);
+    checkpoint_content[checkpoint_length] = '\0';
+    ASSERT_ARE_EQUAL(char_ptr, expected_checkpoint, checkpoint_content);
+
+    //cleanup
+    (void)fclose(checkpoint);
+    REGISTER_GLOBAL_MOCK_HOOK(Blob_UploadMultipleBlocksFromSasUri, NULL);
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+    (void)remove(get_test_checkpoint_file_name());
+    (void)remove(TEST_UPLOAD_SOURCE_FILE);
+}
+#endif
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_070: [ If `blob_upload_checkpoint_file` is set, `IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)` shall record in the checkpoint of the blob the blob, the source and the count of blocks uploaded each time `Blob_UploadMultipleBlocksFromSasUri` reports progress, and delete that checkpoint once the upload completes or is aborted. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_Impl_records_progress_in_checkpoint_of_the_blob)
+{
+    //arrange
+    char source_id[128];
+    char expected_checkpoint[256];
+    FILE* other_blob_checkpoint;
+    write_test_source_file();
+    get_test_source_file_id(BLOCK_SIZE, source_id, sizeof(source_id));
+    write_test_checkpoint("other source");
+    (void)snprintf(expected_checkpoint, sizeof(expected_checkpoint), "1\n%s\n%s\n", TEST_DEFAULT_STRING_VALUE, source_id);
+
+    /*a file that is not the checkpoint of this blob, such as the one of another blob, is left alone*/
+    other_blob_checkpoint = fopen(TEST_UPLOAD_CHECKPOINT_FILE, "w");
+    ASSERT_IS_NOT_NULL(other_blob_checkpoint);
+    (void)fclose(other_blob_checkpoint);
+
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_CHECKPOINT_FILE, TEST_UPLOAD_CHECKPOINT_FILE);
+    umock_c_reset_all_calls();
+
+    REGISTER_GLOBAL_MOCK_HOOK(Blob_UploadMultipleBlocksFromSasUri, my_Blob_UploadMultipleBlocksFromSasUri_reports_progress);
+    setup_upload_blocks_mocks_ex(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN, false, false, false, BLOB_OK, false, true, false);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_UPLOAD_SOURCE_FILE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, expected_checkpoint, g_checkpoint_during_upload);
+    ASSERT_IS_NULL(fopen(get_test_checkpoint_file_name(), "r"));
+    other_blob_checkpoint = fopen(TEST_UPLOAD_CHECKPOINT_FILE, "r");
+    ASSERT_IS_NOT_NULL(other_blob_checkpoint);
+
+    //cleanup
+    (void)fclose(other_blob_checkpoint);
+    REGISTER_GLOBAL_MOCK_HOOK(Blob_UploadMultipleBlocksFromSasUri, NULL);
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+    (void)remove(TEST_UPLOAD_CHECKPOINT_FILE);
+    (void)remove(TEST_UPLOAD_SOURCE_FILE);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_091: [ If `blob_upload_checkpoint_file` is set, `IoTHubClient_LL_UploadFileToBlob` shall identify `sourceFilePath` in the checkpoint by the block size, the size of the file and the time it was last modified. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_Impl_does_not_resume_checkpoint_of_other_block_size)
+{
+    //arrange
+    char source_id[128];
+    write_test_source_file();
+    get_test_source_file_id(2 * BLOCK_SIZE, source_id, sizeof(source_id));
+    write_test_checkpoint(source_id);
+
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_CHECKPOINT_FILE, TEST_UPLOAD_CHECKPOINT_FILE);
+    umock_c_reset_all_calls();
+
+    setup_upload_blocks_mocks_ex(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN, false, false, false, BLOB_OK, false, true, false);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_UPLOAD_SOURCE_FILE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+    (void)remove(get_test_checkpoint_file_name());
+    (void)remove(TEST_UPLOAD_SOURCE_FILE);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_091: [ If `blob_upload_checkpoint_file` is set, `IoTHubClient_LL_UploadFileToBlob` shall identify `sourceFilePath` in the checkpoint by the block size, the size of the file and the time it was last modified. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_Impl_does_not_resume_checkpoint_of_modified_file)
+{
+    //arrange
+    char source_id[128];
+    char modified_source_id[128];
+    write_test_source_file();
+    get_test_source_file_id(BLOCK_SIZE, source_id, sizeof(source_id));
+    /*same block size and file size, written at another time*/
+    (void)snprintf(modified_source_id, sizeof(modified_source_id), "%s1", source_id);
+    write_test_checkpoint(modified_source_id);
+
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_CHECKPOINT_FILE, TEST_UPLOAD_CHECKPOINT_FILE);
+    umock_c_reset_all_calls();
+
+    setup_upload_blocks_mocks_ex(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN, false, false, false, BLOB_OK, false, true, false);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_UPLOAD_SOURCE_FILE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+    (void)remove(get_test_checkpoint_file_name());
+    (void)remove(TEST_UPLOAD_SOURCE_FILE);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_090: [ If `blob_upload_checkpoint_file` is set, `IoTHubClient_LL_UploadToBlob` shall identify `source` in the checkpoint by the block size, `size` and a SHA-256 digest of `source`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_Impl_resumes_from_checkpoint_of_same_source)
+{
+    //arrange
+    char source_id[128];
+    size_t i;
+    int length = snprintf(source_id, sizeof(source_id), "%lu %llu ", (unsigned long)BLOCK_SIZE, (unsigned long long)TEST_SOURCE_LENGTH);
+    for (i = 0; i < sizeof(TEST_SOURCE_DIGEST); i++)
+    {
+        length += snprintf(source_id + length, sizeof(source_id) - length, "%02x", TEST_SOURCE_DIGEST[i]);
+    }
+    write_test_checkpoint(source_id);
+
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_CHECKPOINT_FILE, TEST_UPLOAD_CHECKPOINT_FILE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(SHA256Reset(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(SHA256Input(IGNORED_PTR_ARG, TEST_SOURCE, (unsigned int)TEST_SOURCE_LENGTH));
+    STRICT_EXPECTED_CALL(SHA256Result(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_Message_Digest(TEST_SOURCE_DIGEST, sizeof(TEST_SOURCE_DIGEST));
+    setup_upload_blocks_mocks_ex(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN, false, false, false, BLOB_OK, false, true, true);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_SOURCE, TEST_SOURCE_LENGTH);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+    (void)remove(get_test_checkpoint_file_name());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_090: [ If `blob_upload_checkpoint_file` is set, `IoTHubClient_LL_UploadToBlob` shall identify `source` in the checkpoint by the block size, `size` and a SHA-256 digest of `source`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_Impl_digest_fails_does_not_resume)
+{
+    //arrange
+    write_test_checkpoint("any source");
+
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_CHECKPOINT_FILE, TEST_UPLOAD_CHECKPOINT_FILE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(SHA256Reset(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(SHA256Input(IGNORED_PTR_ARG, TEST_SOURCE, (unsigned int)TEST_SOURCE_LENGTH))
+        .SetReturn(MU_FAILURE);
+    setup_upload_blocks_mocks(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN, false, false, false, BLOB_OK, false);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_SOURCE, TEST_SOURCE_LENGTH);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+    (void)remove(get_test_checkpoint_file_name());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_089: [ `IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)` shall not resume nor record uploads of data handed out by `getDataCallbackEx`, since it cannot tell whether the data changed between two uploads. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl_does_not_resume_from_checkpoint)
+{
+    //arrange
+    write_test_checkpoint("any source");
+
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_CHECKPOINT_FILE, TEST_UPLOAD_CHECKPOINT_FILE);
+    umock_c_reset_all_calls();
+
+    context.source = TEST_SOURCE;
+    context.size = TEST_SOURCE_LENGTH;
+    context.toUpload = TEST_SOURCE_LENGTH;
+    setup_upload_blocks_mocks(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN, false, false, false, BLOB_OK, false);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(h, TEST_DESTINATION_FILENAME, FileUpload_GetData_Callback, &context);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+    (void)remove(get_test_checkpoint_file_name());
+}
+
 TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_Impl_device_key_succeeds)
 {
     //arrange
@@ -1411,4 +1979,174 @@ TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_x509_timeout_succeeds)
     IoTHubClient_LL_UploadToBlob_Destroy(h);
 }
 
+/*Tests_SRS_IOTHUBCLIENT_LL_09_065: [ `blob_upload_concurrent_blocks` - shall set the count of blocks uploaded at the same time, passed to `Blob_UploadMultipleBlocksFromSasUri`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_concurrent_blocks_succeeds)
+{
+    //arrange
+    size_t concurrent_blocks = MAX_CONCURRENT_BLOCKS;
+
+    setup_uploadtoblob_create_mocks(IOTHUB_CREDENTIAL_TYPE_X509);
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_CONCURRENT_BLOCKS, &concurrent_blocks);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_066: [ If `blob_upload_concurrent_blocks` is bigger than `MAX_CONCURRENT_BLOCKS`, `IoTHubClient_LL_UploadToBlob_SetOption` shall return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_concurrent_blocks_over_maximum_fails)
+{
+    //arrange
+    size_t concurrent_blocks = MAX_CONCURRENT_BLOCKS + 1;
+
+    setup_uploadtoblob_create_mocks(IOTHUB_CREDENTIAL_TYPE_X509);
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_CONCURRENT_BLOCKS, &concurrent_blocks);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_072: [ `blob_upload_block_size` - shall set the size of the blocks `IoTHubClient_LL_UploadToBlob` and `IoTHubClient_LL_UploadFileToBlob` split the source into. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_block_size_succeeds)
+{
+    //arrange
+    size_t block_size = MAX_BLOCK_SIZE;
+
+    setup_uploadtoblob_create_mocks(IOTHUB_CREDENTIAL_TYPE_X509);
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_BLOCK_SIZE, &block_size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_073: [ If `blob_upload_block_size` is smaller than `BLOCK_SIZE` or bigger than `MAX_BLOCK_SIZE`, `IoTHubClient_LL_UploadToBlob_SetOption` shall return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_block_size_under_minimum_fails)
+{
+    //arrange
+    size_t block_size = BLOCK_SIZE - 1;
+
+    setup_uploadtoblob_create_mocks(IOTHUB_CREDENTIAL_TYPE_X509);
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_BLOCK_SIZE, &block_size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_073: [ If `blob_upload_block_size` is smaller than `BLOCK_SIZE` or bigger than `MAX_BLOCK_SIZE`, `IoTHubClient_LL_UploadToBlob_SetOption` shall return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_block_size_over_maximum_fails)
+{
+    //arrange
+    size_t block_size = MAX_BLOCK_SIZE + 1;
+
+    setup_uploadtoblob_create_mocks(IOTHUB_CREDENTIAL_TYPE_X509);
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_BLOCK_SIZE, &block_size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_068: [ `blob_upload_checkpoint_file` - shall set the path of the files recording the progress of the uploads, one per blob named after the path and a hash of the blob URI, or disable resumable uploads if the value is NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_checkpoint_file_succeeds)
+{
+    //arrange
+    setup_uploadtoblob_create_mocks(IOTHUB_CREDENTIAL_TYPE_X509);
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, "upload.checkpoint"));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_CHECKPOINT_FILE, "upload.checkpoint");
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_068: [ `blob_upload_checkpoint_file` - shall set the path of the files recording the progress of the uploads, one per blob named after the path and a hash of the blob URI, or disable resumable uploads if the value is NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_checkpoint_file_NULL_disables_it)
+{
+    //arrange
+    setup_uploadtoblob_create_mocks(IOTHUB_CREDENTIAL_TYPE_X509);
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_CHECKPOINT_FILE, "upload.checkpoint");
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_CHECKPOINT_FILE, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_068: [ `blob_upload_checkpoint_file` - shall set the path of the files recording the progress of the uploads, one per blob named after the path and a hash of the blob URI, or disable resumable uploads if the value is NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_checkpoint_file_fails_when_mallocAndStrcpy_s_fails)
+{
+    //arrange
+    setup_uploadtoblob_create_mocks(IOTHUB_CREDENTIAL_TYPE_X509);
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, "upload.checkpoint"))
+        .SetReturn(MU_FAILURE);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_CHECKPOINT_FILE, "upload.checkpoint");
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
 END_TEST_SUITE(iothubclient_ll_uploadtoblob_ut)
@@ -0,0 +1,435 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_charptr.h"
+#include "umock_c/umock_c_negative_tests.h"
+#include "umock_c/umocktypes_stdint.h"
+#include "umock_c/umocktypes_bool.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_rate_limiter.h"
+#include "internal/iothub_client_rate_limiter_private.h"
+
+TEST_DEFINE_ENUM_TYPE(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", MU_ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static tickcounter_ms_t g_current_ms;
+
+static LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)my_gballoc_malloc(1);
+}
+
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    my_gballoc_free(handle);
+    return LOCK_OK;
+}
+
+static TICK_COUNTER_HANDLE my_tickcounter_create(void)
+{
+    return (TICK_COUNTER_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_tickcounter_destroy(TICK_COUNTER_HANDLE tick_counter)
+{
+    my_gballoc_free(tick_counter);
+}
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = g_current_ms;
+    return 0;
+}
+
+static IOTHUB_CLIENT_RATE_LIMITER_HANDLE create_rate_limiter_with_limit(IOTHUB_CLIENT_RATE_LIMIT_CLASS operationClass, size_t operationsPerSecond, size_t burst)
+{
+    IOTHUB_CLIENT_RATE_LIMITER_HANDLE result = IoTHubClient_RateLimiter_Create();
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClient_RateLimiter_SetLimit(result, operationClass, operationsPerSecond, burst));
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static void set_try_acquire_limited_expected_calls(void)
+{
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+}
+
+BEGIN_TEST_SUITE(iothubclient_rate_limiter_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    (void)umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_create, my_tickcounter_create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_destroy, my_tickcounter_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_get_current_ms, MU_FAILURE);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+    umock_c_reset_all_calls();
+    g_current_ms = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_RATE_LIMITER_09_001: [ `IoTHubClient_RateLimiter_Create` shall allocate a rate limiter with a lock and a tick counter, with no limit on any operation class. ]*/
+TEST_FUNCTION(IoTHubClient_RateLimiter_Create_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_RATE_LIMITER_HANDLE result;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(tickcounter_create());
+
+    //act
+    result = IoTHubClient_RateLimiter_Create();
+
+    //assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_RateLimiter_Destroy(result);
+}
+
+/* Tests_SRS_IOTHUB_RATE_LIMITER_09_002: [ If any failure occurs, `IoTHubClient_RateLimiter_Create` shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_RateLimiter_Create_fail)
+{
+    //arrange
+    size_t i;
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        IOTHUB_CLIENT_RATE_LIMITER_HANDLE result;
+        char tmp_msg[64];
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        //act
+        result = IoTHubClient_RateLimiter_Create();
+
+        //assert
+        (void)sprintf(tmp_msg, "IoTHubClient_RateLimiter_Create failure in test %lu", (unsigned long)i);
+        ASSERT_IS_NULL(result, tmp_msg);
+    }
+
+    //cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/* Tests_SRS_IOTHUB_RATE_LIMITER_09_003: [ `IoTHubClient_RateLimiter_Destroy` shall free the rate limiter, or do nothing if `rateLimiter` is NULL. ]*/
+TEST_FUNCTION(IoTHubClient_RateLimiter_Destroy_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_RATE_LIMITER_HANDLE rate_limiter = IoTHubClient_RateLimiter_Create();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(rate_limiter));
+
+    //act
+    IoTHubClient_RateLimiter_Destroy(rate_limiter);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_RateLimiter_Destroy(NULL);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_RATE_LIMITER_09_004: [ If `rateLimiter` is NULL or `operationClass` is not a valid class, `IoTHubClient_RateLimiter_SetLimit` shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_RateLimiter_SetLimit_invalid_args_fail)
+{
+    //arrange
+    IOTHUB_CLIENT_RATE_LIMITER_HANDLE rate_limiter = IoTHubClient_RateLimiter_Create();
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result1 = IoTHubClient_RateLimiter_SetLimit(NULL, IOTHUB_CLIENT_RATE_LIMIT_D2C, 10, 0);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubClient_RateLimiter_SetLimit(rate_limiter, (IOTHUB_CLIENT_RATE_LIMIT_CLASS)3, 10, 0);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_RateLimiter_Destroy(rate_limiter);
+}
+
+/* Tests_SRS_IOTHUB_RATE_LIMITER_09_005: [ `IoTHubClient_RateLimiter_SetLimit` shall set the rate and the burst of `operationClass` and fill its bucket; a `burst` of 0 shall allow one second worth of operations. ]*/
+/* Tests_SRS_IOTHUB_RATE_LIMITER_09_010: [ `IoTHubClient_RateLimiter_TryAcquire` shall take one token and return true if the bucket of `operationClass` has one, and return false otherwise. ]*/
+TEST_FUNCTION(IoTHubClient_RateLimiter_TryAcquire_burst_then_refuses)
+{
+    //arrange
+    IOTHUB_CLIENT_RATE_LIMITER_HANDLE rate_limiter = create_rate_limiter_with_limit(IOTHUB_CLIENT_RATE_LIMIT_D2C, 2, 0);
+    bool result1, result2, result3;
+
+    set_try_acquire_limited_expected_calls();
+    set_try_acquire_limited_expected_calls();
+    set_try_acquire_limited_expected_calls();
+
+    //act
+    result1 = IoTHubClient_RateLimiter_TryAcquire(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_D2C, 0);
+    result2 = IoTHubClient_RateLimiter_TryAcquire(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_D2C, 0);
+    result3 = IoTHubClient_RateLimiter_TryAcquire(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_D2C, 0);
+
+    //assert
+    ASSERT_IS_TRUE(result1);
+    ASSERT_IS_TRUE(result2);
+    ASSERT_IS_FALSE(result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_RateLimiter_Destroy(rate_limiter);
+}
+
+/* Tests_SRS_IOTHUB_RATE_LIMITER_09_008: [ A limited class shall gain `operationsPerSecond` tokens per second, up to its burst. ]*/
+TEST_FUNCTION(IoTHubClient_RateLimiter_TryAcquire_refills_over_time)
+{
+    //arrange
+    IOTHUB_CLIENT_RATE_LIMITER_HANDLE rate_limiter = create_rate_limiter_with_limit(IOTHUB_CLIENT_RATE_LIMIT_TWIN_UPDATE, 2, 1);
+    bool result1, result2, result3, result4;
+
+    //act
+    result1 = IoTHubClient_RateLimiter_TryAcquire(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_TWIN_UPDATE, 0);
+    g_current_ms = 499;
+    result2 = IoTHubClient_RateLimiter_TryAcquire(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_TWIN_UPDATE, 0);
+    g_current_ms = 500;
+    result3 = IoTHubClient_RateLimiter_TryAcquire(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_TWIN_UPDATE, 0);
+    g_current_ms = 10000;
+    (void)IoTHubClient_RateLimiter_TryAcquire(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_TWIN_UPDATE, 0);
+    result4 = IoTHubClient_RateLimiter_TryAcquire(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_TWIN_UPDATE, 0);
+
+    //assert
+    ASSERT_IS_TRUE(result1);
+    ASSERT_IS_FALSE(result2);
+    ASSERT_IS_TRUE(result3);
+    // burst of 1 caps the refill after an idle period
+    ASSERT_IS_FALSE(result4);
+
+    //cleanup
+    IoTHubClient_RateLimiter_Destroy(rate_limiter);
+}
+
+/* Tests_SRS_IOTHUB_RATE_LIMITER_09_009: [ `IoTHubClient_RateLimiter_TryAcquire` shall always admit an operation of a class without limit. ]*/
+TEST_FUNCTION(IoTHubClient_RateLimiter_TryAcquire_unlimited_class_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_RATE_LIMITER_HANDLE rate_limiter = create_rate_limiter_with_limit(IOTHUB_CLIENT_RATE_LIMIT_D2C, 1, 1);
+    size_t i;
+
+    //act
+    for (i = 0; i < 100; i++)
+    {
+        //assert
+        ASSERT_IS_TRUE(IoTHubClient_RateLimiter_TryAcquire(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_METHOD_RESPONSE, 0));
+    }
+
+    //cleanup
+    IoTHubClient_RateLimiter_Destroy(rate_limiter);
+}
+
+/* Tests_SRS_IOTHUB_RATE_LIMITER_09_012: [ If the rate limiter cannot be locked, `IoTHubClient_RateLimiter_TryAcquire` shall let the operation go out rather than hold it back indefinitely. ]*/
+TEST_FUNCTION(IoTHubClient_RateLimiter_TryAcquire_Lock_fails_admits)
+{
+    //arrange
+    IOTHUB_CLIENT_RATE_LIMITER_HANDLE rate_limiter = create_rate_limiter_with_limit(IOTHUB_CLIENT_RATE_LIMIT_D2C, 1, 1);
+    bool result;
+
+    (void)IoTHubClient_RateLimiter_TryAcquire(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_D2C, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).SetReturn(LOCK_ERROR);
+
+    //act
+    result = IoTHubClient_RateLimiter_TryAcquire(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_D2C, 0);
+
+    //assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_RateLimiter_Destroy(rate_limiter);
+}
+
+/* Tests_SRS_IOTHUB_RATE_LIMITER_09_013: [ `IoTHubClient_RateLimiter_Refund` shall put one token back in the bucket of `operationClass`, up to its burst, and undo the statistics recorded for the admission. ]*/
+TEST_FUNCTION(IoTHubClient_RateLimiter_Refund_gives_token_back)
+{
+    //arrange
+    IOTHUB_CLIENT_RATE_LIMITER_HANDLE rate_limiter = create_rate_limiter_with_limit(IOTHUB_CLIENT_RATE_LIMIT_METHOD_RESPONSE, 1, 1);
+    IOTHUB_CLIENT_RATE_LIMIT_STATISTICS statistics;
+
+    ASSERT_IS_TRUE(IoTHubClient_RateLimiter_TryAcquire(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_METHOD_RESPONSE, 0));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_RateLimiter_Refund(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_METHOD_RESPONSE, 0);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClient_RateLimiter_GetStatistics(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_METHOD_RESPONSE, &statistics));
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.available_tokens);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.admitted_count);
+    ASSERT_IS_TRUE(IoTHubClient_RateLimiter_TryAcquire(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_METHOD_RESPONSE, 0));
+
+    //cleanup
+    IoTHubClient_RateLimiter_Destroy(rate_limiter);
+}
+
+/* Tests_SRS_IOTHUB_RATE_LIMITER_09_006: [ If `rateLimiter` or `statistics` are NULL or `operationClass` is not a valid class, `IoTHubClient_RateLimiter_GetStatistics` shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_RateLimiter_GetStatistics_invalid_args_fail)
+{
+    //arrange
+    IOTHUB_CLIENT_RATE_LIMITER_HANDLE rate_limiter = IoTHubClient_RateLimiter_Create();
+    IOTHUB_CLIENT_RATE_LIMIT_STATISTICS statistics;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result1 = IoTHubClient_RateLimiter_GetStatistics(NULL, IOTHUB_CLIENT_RATE_LIMIT_D2C, &statistics);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubClient_RateLimiter_GetStatistics(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_D2C, NULL);
+    IOTHUB_CLIENT_RESULT result3 = IoTHubClient_RateLimiter_GetStatistics(rate_limiter, (IOTHUB_CLIENT_RATE_LIMIT_CLASS)3, &statistics);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_RateLimiter_Destroy(rate_limiter);
+}
+
+/* Tests_SRS_IOTHUB_RATE_LIMITER_09_007: [ `IoTHubClient_RateLimiter_GetStatistics` shall copy the statistics of `operationClass`, with the number of whole tokens currently in its bucket. ]*/
+/* Tests_SRS_IOTHUB_RATE_LIMITER_09_011: [ An admitted operation shall be counted in the statistics of its class, with `waitedMs` added to its wait time if not 0. ]*/
+TEST_FUNCTION(IoTHubClient_RateLimiter_GetStatistics_reports_waits)
+{
+    //arrange
+    IOTHUB_CLIENT_RATE_LIMITER_HANDLE rate_limiter = create_rate_limiter_with_limit(IOTHUB_CLIENT_RATE_LIMIT_D2C, 10, 5);
+    IOTHUB_CLIENT_RATE_LIMIT_STATISTICS statistics;
+    IOTHUB_CLIENT_RESULT result;
+
+    (void)IoTHubClient_RateLimiter_TryAcquire(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_D2C, 0);
+    (void)IoTHubClient_RateLimiter_TryAcquire(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_D2C, 40);
+    (void)IoTHubClient_RateLimiter_TryAcquire(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_D2C, 100);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    result = IoTHubClient_RateLimiter_GetStatistics(rate_limiter, IOTHUB_CLIENT_RATE_LIMIT_D2C, &statistics);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, statistics.available_tokens);
+    ASSERT_ARE_EQUAL(uint64_t, 3, statistics.admitted_count);
+    ASSERT_ARE_EQUAL(uint64_t, 2, statistics.delayed_count);
+    ASSERT_ARE_EQUAL(uint64_t, 140, statistics.total_wait_ms);
+    ASSERT_ARE_EQUAL(uint64_t, 100, statistics.max_wait_ms);
+
+    //cleanup
+    IoTHubClient_RateLimiter_Destroy(rate_limiter);
+}
+
+END_TEST_SUITE(iothubclient_rate_limiter_ut)
@@ -0,0 +1,509 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdbool.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_charptr.h"
+#include "umock_c/umock_c_negative_tests.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/agenttime.h"
+#include "internal/iothub_client_authorization.h"
+#undef ENABLE_MOCKS
+
+#include "internal/iothub_client_trust_bundle.h"
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", MU_ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+static const IOTHUB_AUTHORIZATION_HANDLE TEST_AUTHORIZATION_HANDLE = (IOTHUB_AUTHORIZATION_HANDLE)0x4242;
+static const char* TEST_CERTIFICATE_FILE = "/certs/edge_ca.pem";
+static const char* TEST_OTHER_CERTIFICATE_FILE = "/certs/other_ca.pem";
+static const char* TEST_TRUST_BUNDLE = "-----BEGIN CERTIFICATE-----";
+static const char* TEST_ROTATED_TRUST_BUNDLE = "-----BEGIN CERTIFICATE-----rotated";
+static const time_t TEST_TIME = (time_t)1000;
+
+static const char* g_trust_bundle;
+
+static LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)my_gballoc_malloc(1);
+}
+
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    my_gballoc_free(handle);
+    return LOCK_OK;
+}
+
+static int my_mallocAndStrcpy_s(char** destination, const char* source)
+{
+    *destination = (char*)my_gballoc_malloc(strlen(source) + 1);
+    (void)strcpy(*destination, source);
+    return 0;
+}
+
+static char* my_IoTHubClient_Auth_Get_TrustBundle(IOTHUB_AUTHORIZATION_HANDLE handle, const char* certificate_file_name)
+{
+    char* result;
+    (void)handle;
+    (void)certificate_file_name;
+    (void)my_mallocAndStrcpy_s(&result, g_trust_bundle);
+    return result;
+}
+
+static void set_acquire_uncached_expected_calls(const char* certificate_file_name)
+{
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_TrustBundle(TEST_AUTHORIZATION_HANDLE, certificate_file_name));
+    if (certificate_file_name != NULL)
+    {
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, certificate_file_name));
+    }
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+}
+
+static void set_acquire_cached_expected_calls(double seconds_since_loaded)
+{
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(TEST_TIME, TEST_TIME)).SetReturn(seconds_since_loaded);
+}
+
+BEGIN_TEST_SUITE(iothubclient_trust_bundle_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    (void)umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_AUTHORIZATION_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(time_t, long long);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, MU_FAILURE);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_Auth_Get_TrustBundle, my_IoTHubClient_Auth_Get_TrustBundle);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_Auth_Get_TrustBundle, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(get_time, TEST_TIME);
+    REGISTER_GLOBAL_MOCK_RETURN(get_difftime, 0);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+    g_trust_bundle = TEST_TRUST_BUNDLE;
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    IoTHubClient_TrustBundle_Deinit();
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_001: [ If the cache is already initialized, `IoTHubClient_TrustBundle_Init` shall return 0. ]*/
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_002: [ `IoTHubClient_TrustBundle_Init` shall create the lock of the cache. ]*/
+TEST_FUNCTION(IoTHubClient_TrustBundle_Init_succeed)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(Lock_Init());
+
+    //act
+    int result1 = IoTHubClient_TrustBundle_Init();
+    int result2 = IoTHubClient_TrustBundle_Init();
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_003: [ If the lock fails to be created, `IoTHubClient_TrustBundle_Init` shall return a non-zero value. ]*/
+TEST_FUNCTION(IoTHubClient_TrustBundle_Init_fail)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(Lock_Init()).SetReturn(NULL);
+
+    //act
+    int result = IoTHubClient_TrustBundle_Init();
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_004: [ `IoTHubClient_TrustBundle_Deinit` shall free the cached trust bundle and the lock of the cache. ]*/
+TEST_FUNCTION(IoTHubClient_TrustBundle_Deinit_frees_cache)
+{
+    //arrange
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_TrustBundle_Init());
+    ASSERT_IS_NOT_NULL(IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_TrustBundle_Deinit();
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_005: [ If `authorization_handle` is NULL, `IoTHubClient_TrustBundle_Acquire` shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_TrustBundle_Acquire_NULL_handle_fail)
+{
+    //arrange
+
+    //act
+    const char* result = IoTHubClient_TrustBundle_Acquire(NULL, TEST_CERTIFICATE_FILE);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_006: [ If the cache is not initialized, `IoTHubClient_TrustBundle_Acquire` shall return a copy of the trust bundle owned by the caller, obtained with `IoTHubClient_Auth_Get_TrustBundle`. ]*/
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_012: [ If `trust_bundle` is a copy owned by the caller, `IoTHubClient_TrustBundle_Release` shall free it. ]*/
+TEST_FUNCTION(IoTHubClient_TrustBundle_Acquire_without_init_returns_copy)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_TrustBundle(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    const char* result = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+    IoTHubClient_TrustBundle_Release(result);
+
+    //assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_007: [ If the cache holds the trust bundle of `certificate_file_name`, `IoTHubClient_TrustBundle_Acquire` shall add a reference to it and return it. ]*/
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_009: [ Otherwise `IoTHubClient_TrustBundle_Acquire` shall load the trust bundle with `IoTHubClient_Auth_Get_TrustBundle`, cache it with one reference and return it. ]*/
+TEST_FUNCTION(IoTHubClient_TrustBundle_Acquire_loads_once)
+{
+    //arrange
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_TrustBundle_Init());
+    umock_c_reset_all_calls();
+
+    set_acquire_uncached_expected_calls(TEST_CERTIFICATE_FILE);
+    set_acquire_cached_expected_calls(0);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    const char* result1 = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+    const char* result2 = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+
+    //assert
+    ASSERT_IS_NOT_NULL(result1);
+    ASSERT_ARE_EQUAL(void_ptr, result1, result2);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_TRUST_BUNDLE, result1);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_TrustBundle_Release(result1);
+    IoTHubClient_TrustBundle_Release(result2);
+}
+
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_009: [ Otherwise `IoTHubClient_TrustBundle_Acquire` shall load the trust bundle with `IoTHubClient_Auth_Get_TrustBundle`, cache it with one reference and return it. ]*/
+TEST_FUNCTION(IoTHubClient_TrustBundle_Acquire_hsm_trust_bundle_loads_once)
+{
+    //arrange
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_TrustBundle_Init());
+    umock_c_reset_all_calls();
+
+    set_acquire_uncached_expected_calls(NULL);
+    set_acquire_cached_expected_calls(0);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    const char* result1 = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, NULL);
+    const char* result2 = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, NULL);
+
+    //assert
+    ASSERT_IS_NOT_NULL(result1);
+    ASSERT_ARE_EQUAL(void_ptr, result1, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_TrustBundle_Release(result1);
+    IoTHubClient_TrustBundle_Release(result2);
+}
+
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_008: [ If the cache holds the trust bundle of another certificate file, `IoTHubClient_TrustBundle_Acquire` shall return a copy owned by the caller. ]*/
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_012: [ If `trust_bundle` is a copy owned by the caller, `IoTHubClient_TrustBundle_Release` shall free it. ]*/
+TEST_FUNCTION(IoTHubClient_TrustBundle_Acquire_other_file_returns_copy)
+{
+    //arrange
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_TrustBundle_Init());
+    const char* cached = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_TrustBundle(TEST_AUTHORIZATION_HANDLE, TEST_OTHER_CERTIFICATE_FILE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    const char* result = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_OTHER_CERTIFICATE_FILE);
+    IoTHubClient_TrustBundle_Release(result);
+
+    //assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, cached, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_TrustBundle_Release(cached);
+}
+
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_014: [ If the cached trust bundle of `certificate_file_name` was loaded `TRUST_BUNDLE_CACHE_LIFETIME_SECS` or more ago, `IoTHubClient_TrustBundle_Acquire` shall load it again with `IoTHubClient_Auth_Get_TrustBundle`, add a reference to it and return it. ]*/
+TEST_FUNCTION(IoTHubClient_TrustBundle_Acquire_expired_same_trust_bundle_keeps_cache)
+{
+    //arrange
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_TrustBundle_Init());
+    const char* cached = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+    umock_c_reset_all_calls();
+
+    set_acquire_cached_expected_calls(300);
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_TrustBundle(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    const char* result = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+
+    //assert
+    ASSERT_ARE_EQUAL(void_ptr, cached, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_TrustBundle_Release(cached);
+    IoTHubClient_TrustBundle_Release(result);
+}
+
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_015: [ If the loaded trust bundle differs from the cached one, `IoTHubClient_TrustBundle_Acquire` shall cache it in place of the cached one, which stays valid until its last reference is released. ]*/
+TEST_FUNCTION(IoTHubClient_TrustBundle_Acquire_expired_rotated_trust_bundle_replaces_cache)
+{
+    //arrange
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_TrustBundle_Init());
+    const char* cached = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+    g_trust_bundle = TEST_ROTATED_TRUST_BUNDLE;
+    umock_c_reset_all_calls();
+
+    set_acquire_cached_expected_calls(300);
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_TrustBundle(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    set_acquire_cached_expected_calls(0);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    const char* result1 = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+    const char* result2 = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(void_ptr, cached, result1);
+    ASSERT_ARE_EQUAL(void_ptr, result1, result2);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_ROTATED_TRUST_BUNDLE, result1);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_TRUST_BUNDLE, cached);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_TrustBundle_Release(result1);
+    IoTHubClient_TrustBundle_Release(result2);
+    IoTHubClient_TrustBundle_Release(cached);
+}
+
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_016: [ If the trust bundle fails to be loaded again, `IoTHubClient_TrustBundle_Acquire` shall add a reference to the cached trust bundle and return it. ]*/
+TEST_FUNCTION(IoTHubClient_TrustBundle_Acquire_expired_load_fails_keeps_cache)
+{
+    //arrange
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_TrustBundle_Init());
+    const char* cached = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+    umock_c_reset_all_calls();
+
+    set_acquire_cached_expected_calls(300);
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_TrustBundle(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    const char* result = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+
+    //assert
+    ASSERT_ARE_EQUAL(void_ptr, cached, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_TrustBundle_Release(cached);
+    IoTHubClient_TrustBundle_Release(result);
+}
+
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_010: [ If any failure occurs, `IoTHubClient_TrustBundle_Acquire` shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_TrustBundle_Acquire_fail)
+{
+    //arrange
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_TrustBundle_Init());
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_TrustBundle(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).SetReturn(LOCK_ERROR);
+
+    //act
+    const char* result1 = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+    const char* result2 = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+
+    //assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_011: [ If `trust_bundle` is NULL, `IoTHubClient_TrustBundle_Release` shall return. ]*/
+TEST_FUNCTION(IoTHubClient_TrustBundle_Release_NULL_succeed)
+{
+    //arrange
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_TrustBundle_Init());
+    umock_c_reset_all_calls();
+
+    //act
+    IoTHubClient_TrustBundle_Release(NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_013: [ `IoTHubClient_TrustBundle_Release` shall remove a reference to the cached trust bundle, and free it with its last reference. ]*/
+TEST_FUNCTION(IoTHubClient_TrustBundle_Release_last_reference_frees_cache)
+{
+    //arrange
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_TrustBundle_Init());
+    const char* trust_bundle1 = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+    const char* trust_bundle2 = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_TrustBundle_Release(trust_bundle1);
+    IoTHubClient_TrustBundle_Release(trust_bundle2);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    umock_c_reset_all_calls();
+    set_acquire_uncached_expected_calls(TEST_CERTIFICATE_FILE);
+    trust_bundle1 = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    IoTHubClient_TrustBundle_Release(trust_bundle1);
+}
+
+/* Tests_SRS_IOTHUB_TRUST_BUNDLE_09_017: [ `IoTHubClient_TrustBundle_Release` shall remove a reference to a retired trust bundle, and free it with its last reference. ]*/
+TEST_FUNCTION(IoTHubClient_TrustBundle_Release_last_reference_frees_retired_trust_bundle)
+{
+    //arrange
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_TrustBundle_Init());
+    const char* retired1 = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+    const char* retired2 = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+    const char* cached;
+    g_trust_bundle = TEST_ROTATED_TRUST_BUNDLE;
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(300);
+    cached = IoTHubClient_TrustBundle_Acquire(TEST_AUTHORIZATION_HANDLE, TEST_CERTIFICATE_FILE);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, retired1, cached);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_TrustBundle_Release(retired1);
+    IoTHubClient_TrustBundle_Release(retired2);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_ROTATED_TRUST_BUNDLE, cached);
+
+    //cleanup
+    IoTHubClient_TrustBundle_Release(cached);
+}
+
+END_TEST_SUITE(iothubclient_trust_bundle_ut)
@@ -0,0 +1,507 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdbool.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_charptr.h"
+#include "umock_c/umock_c_negative_tests.h"
+#include "umock_c/umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_twin_cache.h"
+#include "internal/iothub_client_twin_cache_private.h"
+
+TEST_DEFINE_ENUM_TYPE(TWIN_CACHE_UPDATE_RESULT, TWIN_CACHE_UPDATE_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
+
+static const char* TEST_FULL_TWIN = "{\"desired\":{\"mode\":\"eco\",\"rate\":5,\"config\":{\"enabled\":true,\"unit\":\"s\"},\"$version\":3},\"reported\":{\"$version\":1}}";
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", MU_ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+static TWIN_CACHE_UPDATE_RESULT update_cache(IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache, DEVICE_TWIN_UPDATE_STATE update_state, const char* json)
+{
+    return IoTHubClient_TwinCache_Update(twin_cache, update_state, (const unsigned char*)json, strlen(json));
+}
+
+static IOTHUB_CLIENT_TWIN_CACHE_HANDLE create_cache_with_full_twin(void)
+{
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE result = IoTHubClient_TwinCache_Create();
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(TWIN_CACHE_UPDATE_RESULT, TWIN_CACHE_UPDATE_CHANGED, update_cache(result, DEVICE_TWIN_UPDATE_COMPLETE, TEST_FULL_TWIN));
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static void assert_changed_names(IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache, const char** expected, size_t expected_count)
+{
+    size_t i;
+
+    ASSERT_ARE_EQUAL(size_t, expected_count, IoTHubClient_TwinCache_GetChangedCount(twin_cache));
+    for (i = 0; i < expected_count; i++)
+    {
+        ASSERT_ARE_EQUAL(char_ptr, expected[i], IoTHubClient_TwinCache_GetChangedName(twin_cache, i));
+    }
+    ASSERT_IS_NULL(IoTHubClient_TwinCache_GetChangedName(twin_cache, expected_count));
+}
+
+static void set_update_expected_calls(const char* json)
+{
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(json) + 1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+}
+
+BEGIN_TEST_SUITE(iothubclient_twin_cache_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    (void)umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_001: [ IoTHubClient_TwinCache_Create shall allocate an empty twin cache. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_Create_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE result;
+    uint32_t version;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    result = IoTHubClient_TwinCache_Create();
+
+    //assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, IoTHubClient_TwinCache_GetDesiredVersion(result, &version));
+    ASSERT_ARE_EQUAL(size_t, 0, IoTHubClient_TwinCache_GetChangedCount(result));
+
+    //cleanup
+    IoTHubClient_TwinCache_Destroy(result);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_002: [ If any failure occurs, IoTHubClient_TwinCache_Create shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_Create_malloc_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE result;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    //act
+    result = IoTHubClient_TwinCache_Create();
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(IoTHubClient_TwinCache_Destroy_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache = create_cache_with_full_twin();
+
+    STRICT_EXPECTED_CALL(gballoc_free(twin_cache));
+
+    //act
+    IoTHubClient_TwinCache_Destroy(twin_cache);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_003: [ If `twinCache` or `payload` are NULL, or `size` is 0, IoTHubClient_TwinCache_Update shall return TWIN_CACHE_UPDATE_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_Update_NULL_handle_fails)
+{
+    //act
+    TWIN_CACHE_UPDATE_RESULT result = update_cache(NULL, DEVICE_TWIN_UPDATE_COMPLETE, TEST_FULL_TWIN);
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_UPDATE_RESULT, TWIN_CACHE_UPDATE_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_003: [ If `twinCache` or `payload` are NULL, or `size` is 0, IoTHubClient_TwinCache_Update shall return TWIN_CACHE_UPDATE_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_Update_zero_size_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache = create_cache_with_full_twin();
+    TWIN_CACHE_UPDATE_RESULT result;
+
+    //act
+    result = IoTHubClient_TwinCache_Update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, (const unsigned char*)TEST_FULL_TWIN, 0);
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_UPDATE_RESULT, TWIN_CACHE_UPDATE_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_TwinCache_Destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_004: [ A full twin document shall replace the cached document. ]*/
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_005: [ For a full twin document, the changed properties shall be the top level desired properties added, modified or removed compared to the cached document. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_Update_first_full_twin_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache = IoTHubClient_TwinCache_Create();
+    const char* expected_names[] = { "mode", "rate", "config" };
+    TWIN_CACHE_UPDATE_RESULT result;
+    uint32_t version = 0;
+    umock_c_reset_all_calls();
+
+    set_update_expected_calls(TEST_FULL_TWIN);
+
+    //act
+    result = update_cache(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, TEST_FULL_TWIN);
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_UPDATE_RESULT, TWIN_CACHE_UPDATE_CHANGED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClient_TwinCache_GetDesiredVersion(twin_cache, &version));
+    ASSERT_ARE_EQUAL(uint32_t, 3, version);
+    assert_changed_names(twin_cache, expected_names, sizeof(expected_names) / sizeof(expected_names[0]));
+
+    //cleanup
+    IoTHubClient_TwinCache_Destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_006: [ If a full twin document has the same desired `$version` and desired properties as the cache, IoTHubClient_TwinCache_Update shall replace the cached document and return TWIN_CACHE_UPDATE_UNCHANGED. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_Update_same_version_full_twin_unchanged)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache = create_cache_with_full_twin();
+    const char* full_twin = "{\"desired\":{\"mode\":\"eco\",\"rate\":5,\"config\":{\"enabled\":true,\"unit\":\"s\"},\"$version\":3},\"reported\":{\"battery\":80,\"$version\":2}}";
+    TWIN_CACHE_UPDATE_RESULT result;
+    double battery = 0;
+
+    set_update_expected_calls(full_twin);
+
+    //act
+    result = update_cache(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, full_twin);
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_UPDATE_RESULT, TWIN_CACHE_UPDATE_UNCHANGED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, IoTHubClient_TwinCache_GetChangedCount(twin_cache));
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClient_TwinCache_GetNumber(twin_cache, "reported.battery", &battery));
+    ASSERT_ARE_EQUAL(int, 80, (int)battery);
+
+    //cleanup
+    IoTHubClient_TwinCache_Destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_005: [ For a full twin document, the changed properties shall be the top level desired properties added, modified or removed compared to the cached document. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_Update_newer_full_twin_reports_diff)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache = create_cache_with_full_twin();
+    const char* full_twin = "{\"desired\":{\"mode\":\"eco\",\"rate\":10,\"alarm\":false,\"$version\":7},\"reported\":{\"$version\":1}}";
+    const char* expected_names[] = { "rate", "alarm", "config" };
+    TWIN_CACHE_UPDATE_RESULT result;
+
+    //act
+    result = update_cache(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, full_twin);
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_UPDATE_RESULT, TWIN_CACHE_UPDATE_CHANGED, result);
+    assert_changed_names(twin_cache, expected_names, sizeof(expected_names) / sizeof(expected_names[0]));
+
+    //cleanup
+    IoTHubClient_TwinCache_Destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_008: [ A newer partial update shall be merged into the cached desired properties following JSON merge patch rules; a null member shall remove the property. ]*/
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_009: [ For a partial update, the changed properties shall be the top level members of the update. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_Update_partial_merges_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache = create_cache_with_full_twin();
+    const char* patch = "{\"mode\":null,\"config\":{\"unit\":\"ms\"},\"$version\":4}";
+    const char* expected_names[] = { "mode", "config" };
+    TWIN_CACHE_UPDATE_RESULT result;
+    uint32_t version = 0;
+    bool enabled = false;
+
+    set_update_expected_calls(patch);
+
+    //act
+    result = update_cache(twin_cache, DEVICE_TWIN_UPDATE_PARTIAL, patch);
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_UPDATE_RESULT, TWIN_CACHE_UPDATE_CHANGED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    assert_changed_names(twin_cache, expected_names, sizeof(expected_names) / sizeof(expected_names[0]));
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClient_TwinCache_GetDesiredVersion(twin_cache, &version));
+    ASSERT_ARE_EQUAL(uint32_t, 4, version);
+    ASSERT_IS_NULL(IoTHubClient_TwinCache_GetString(twin_cache, "desired.mode"));
+    ASSERT_ARE_EQUAL(char_ptr, "ms", IoTHubClient_TwinCache_GetString(twin_cache, "desired.config.unit"));
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClient_TwinCache_GetBool(twin_cache, "desired.config.enabled", &enabled));
+    ASSERT_IS_TRUE(enabled);
+
+    //cleanup
+    IoTHubClient_TwinCache_Destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_007: [ A partial update with a `$version` not newer than the cache shall be ignored and IoTHubClient_TwinCache_Update shall return TWIN_CACHE_UPDATE_UNCHANGED. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_Update_partial_stale_version_unchanged)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache = create_cache_with_full_twin();
+    const char* patch = "{\"mode\":\"boost\",\"$version\":3}";
+    TWIN_CACHE_UPDATE_RESULT result;
+
+    //act
+    result = update_cache(twin_cache, DEVICE_TWIN_UPDATE_PARTIAL, patch);
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_UPDATE_RESULT, TWIN_CACHE_UPDATE_UNCHANGED, result);
+    ASSERT_ARE_EQUAL(size_t, 0, IoTHubClient_TwinCache_GetChangedCount(twin_cache));
+    ASSERT_ARE_EQUAL(char_ptr, "eco", IoTHubClient_TwinCache_GetString(twin_cache, "desired.mode"));
+
+    //cleanup
+    IoTHubClient_TwinCache_Destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_010: [ If no full twin document was received yet, IoTHubClient_TwinCache_Update shall ignore a partial update and return TWIN_CACHE_UPDATE_OUT_OF_SYNC. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_Update_partial_without_full_twin_out_of_sync)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache = IoTHubClient_TwinCache_Create();
+    TWIN_CACHE_UPDATE_RESULT result;
+
+    //act
+    result = update_cache(twin_cache, DEVICE_TWIN_UPDATE_PARTIAL, "{\"mode\":\"boost\",\"$version\":4}");
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_UPDATE_RESULT, TWIN_CACHE_UPDATE_OUT_OF_SYNC, result);
+    ASSERT_IS_NULL(IoTHubClient_TwinCache_GetString(twin_cache, "desired.mode"));
+
+    //cleanup
+    IoTHubClient_TwinCache_Destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_011: [ If the partial update skips one or more versions, IoTHubClient_TwinCache_Update shall keep the cached desired `$version` and return TWIN_CACHE_UPDATE_OUT_OF_SYNC. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_Update_partial_version_gap_out_of_sync)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache = create_cache_with_full_twin();
+    TWIN_CACHE_UPDATE_RESULT result;
+    uint32_t version = 0;
+
+    //act
+    result = update_cache(twin_cache, DEVICE_TWIN_UPDATE_PARTIAL, "{\"mode\":\"boost\",\"$version\":6}");
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_UPDATE_RESULT, TWIN_CACHE_UPDATE_OUT_OF_SYNC, result);
+    ASSERT_ARE_EQUAL(char_ptr, "boost", IoTHubClient_TwinCache_GetString(twin_cache, "desired.mode"));
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClient_TwinCache_GetDesiredVersion(twin_cache, &version));
+    ASSERT_ARE_EQUAL(uint32_t, 3, version);
+
+    //cleanup
+    IoTHubClient_TwinCache_Destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_011: [ If the partial update skips one or more versions, IoTHubClient_TwinCache_Update shall keep the cached desired `$version` and return TWIN_CACHE_UPDATE_OUT_OF_SYNC. ]*/
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_005: [ For a full twin document, the changed properties shall be the top level desired properties added, modified or removed compared to the cached document. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_Update_resync_after_version_gap_changed)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache = create_cache_with_full_twin();
+    const char* full_twin = "{\"desired\":{\"mode\":\"boost\",\"rate\":9,\"$version\":6},\"reported\":{\"$version\":1}}";
+    const char* expected_names[] = { "rate", "config" };
+    TWIN_CACHE_UPDATE_RESULT result;
+    uint32_t version = 0;
+    ASSERT_ARE_EQUAL(TWIN_CACHE_UPDATE_RESULT, TWIN_CACHE_UPDATE_OUT_OF_SYNC, update_cache(twin_cache, DEVICE_TWIN_UPDATE_PARTIAL, "{\"mode\":\"boost\",\"$version\":6}"));
+
+    //act
+    result = update_cache(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, full_twin);
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_UPDATE_RESULT, TWIN_CACHE_UPDATE_CHANGED, result);
+    assert_changed_names(twin_cache, expected_names, sizeof(expected_names) / sizeof(expected_names[0]));
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClient_TwinCache_GetDesiredVersion(twin_cache, &version));
+    ASSERT_ARE_EQUAL(uint32_t, 6, version);
+
+    //cleanup
+    IoTHubClient_TwinCache_Destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_006: [ If a full twin document has the same desired `$version` and desired properties as the cache, IoTHubClient_TwinCache_Update shall replace the cached document and return TWIN_CACHE_UPDATE_UNCHANGED. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_Update_same_version_different_full_twin_changed)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache = create_cache_with_full_twin();
+    const char* full_twin = "{\"desired\":{\"mode\":\"boost\",\"rate\":5,\"config\":{\"enabled\":true,\"unit\":\"s\"},\"$version\":3},\"reported\":{\"$version\":1}}";
+    const char* expected_names[] = { "mode" };
+    TWIN_CACHE_UPDATE_RESULT result;
+
+    //act
+    result = update_cache(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, full_twin);
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_UPDATE_RESULT, TWIN_CACHE_UPDATE_CHANGED, result);
+    assert_changed_names(twin_cache, expected_names, sizeof(expected_names) / sizeof(expected_names[0]));
+
+    //cleanup
+    IoTHubClient_TwinCache_Destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_012: [ If the update fails, the list of changed properties shall be empty. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_Update_invalid_json_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache = create_cache_with_full_twin();
+    const char* patch = "{\"mode\":";
+    TWIN_CACHE_UPDATE_RESULT result;
+
+    set_update_expected_calls(patch);
+
+    //act
+    result = update_cache(twin_cache, DEVICE_TWIN_UPDATE_PARTIAL, patch);
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_UPDATE_RESULT, TWIN_CACHE_UPDATE_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, IoTHubClient_TwinCache_GetChangedCount(twin_cache));
+    ASSERT_ARE_EQUAL(char_ptr, "eco", IoTHubClient_TwinCache_GetString(twin_cache, "desired.mode"));
+
+    //cleanup
+    IoTHubClient_TwinCache_Destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_012: [ If the update fails, the list of changed properties shall be empty. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_Update_malloc_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache = create_cache_with_full_twin();
+    const char* patch = "{\"mode\":\"boost\",\"$version\":4}";
+    TWIN_CACHE_UPDATE_RESULT result;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(patch) + 1)).SetReturn(NULL);
+
+    //act
+    result = update_cache(twin_cache, DEVICE_TWIN_UPDATE_PARTIAL, patch);
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_UPDATE_RESULT, TWIN_CACHE_UPDATE_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_TwinCache_Destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_013: [ If `twinCache` or `version` are NULL, IoTHubClient_TwinCache_GetDesiredVersion shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_GetDesiredVersion_NULL_version_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache = create_cache_with_full_twin();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_TwinCache_GetDesiredVersion(twin_cache, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+
+    //cleanup
+    IoTHubClient_TwinCache_Destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_015: [ The typed getters shall look up `path` as a dot separated path from the root of the cached twin document. ]*/
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_016: [ If the property does not exist or is not of the requested type, the typed getters shall fail. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_typed_getters_check_type)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_HANDLE twin_cache = create_cache_with_full_twin();
+    double rate = 0;
+    bool flag = false;
+
+    //act & assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClient_TwinCache_GetNumber(twin_cache, "desired.rate", &rate));
+    ASSERT_ARE_EQUAL(int, 5, (int)rate);
+    ASSERT_IS_NULL(IoTHubClient_TwinCache_GetString(twin_cache, "desired.rate"));
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, IoTHubClient_TwinCache_GetNumber(twin_cache, "desired.mode", &rate));
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, IoTHubClient_TwinCache_GetBool(twin_cache, "desired.missing", &flag));
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, IoTHubClient_TwinCache_GetBool(twin_cache, "desired.config.enabled", NULL));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_TwinCache_Destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_CACHE_09_017: [ IoTHubClient_TwinCache_GetChangedCount and IoTHubClient_TwinCache_GetChangedName shall expose the properties changed by the last update. ]*/
+TEST_FUNCTION(IoTHubClient_TwinCache_GetChangedCount_NULL_handle_returns_zero)
+{
+    //act & assert
+    ASSERT_ARE_EQUAL(size_t, 0, IoTHubClient_TwinCache_GetChangedCount(NULL));
+    ASSERT_IS_NULL(IoTHubClient_TwinCache_GetChangedName(NULL, 0));
+}
+
+END_TEST_SUITE(iothubclient_twin_cache_ut)
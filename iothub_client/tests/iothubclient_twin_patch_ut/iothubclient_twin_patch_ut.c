@@ -0,0 +1,419 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_charptr.h"
+#include "umock_c/umock_c_negative_tests.h"
+#include "umock_c/umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/constbuffer.h"
+#undef ENABLE_MOCKS
+
+#include "internal/iothub_client_twin_patch.h"
+
+typedef struct TEST_CONSTBUFFER_TAG
+{
+    CONSTBUFFER content;
+    unsigned char* buffer;
+} TEST_CONSTBUFFER;
+
+static CONSTBUFFER_HANDLE my_CONSTBUFFER_Create(const unsigned char* source, size_t size)
+{
+    TEST_CONSTBUFFER* result = (TEST_CONSTBUFFER*)my_gballoc_malloc(sizeof(TEST_CONSTBUFFER));
+    ASSERT_IS_NOT_NULL(result);
+    result->buffer = (unsigned char*)my_gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(result->buffer);
+    (void)memcpy(result->buffer, source, size);
+    result->content.buffer = result->buffer;
+    result->content.size = size;
+    return (CONSTBUFFER_HANDLE)result;
+}
+
+static const CONSTBUFFER* my_CONSTBUFFER_GetContent(CONSTBUFFER_HANDLE constbufferHandle)
+{
+    return &((TEST_CONSTBUFFER*)constbufferHandle)->content;
+}
+
+static void my_CONSTBUFFER_DecRef(CONSTBUFFER_HANDLE constbufferHandle)
+{
+    my_gballoc_free(((TEST_CONSTBUFFER*)constbufferHandle)->buffer);
+    my_gballoc_free(constbufferHandle);
+}
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", MU_ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+static int should_skip_index(size_t current_index, const size_t skip_array[], size_t length)
+{
+    int result = 0;
+    if (skip_array != NULL)
+    {
+        for (size_t index = 0; index < length; index++)
+        {
+            if (current_index == skip_array[index])
+            {
+                result = __LINE__;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+static CONSTBUFFER_HANDLE create_patch(const char* json)
+{
+    CONSTBUFFER_HANDLE result = my_CONSTBUFFER_Create((const unsigned char*)json, strlen(json));
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static void assert_merged_patch(const char* expected, CONSTBUFFER_HANDLE merged_patch)
+{
+    const CONSTBUFFER* content;
+    char* actual;
+
+    ASSERT_IS_NOT_NULL(merged_patch);
+    content = my_CONSTBUFFER_GetContent(merged_patch);
+    actual = (char*)my_gballoc_malloc(content->size + 1);
+    ASSERT_IS_NOT_NULL(actual);
+    (void)memcpy(actual, content->buffer, content->size);
+    actual[content->size] = '\0';
+    ASSERT_ARE_EQUAL(char_ptr, expected, actual);
+    my_gballoc_free(actual);
+}
+
+static void set_merge_expected_calls(size_t patch_size, size_t next_patch_size)
+{
+    STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(patch_size + 1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(next_patch_size + 1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+}
+
+BEGIN_TEST_SUITE(iothubclient_twin_patch_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    (void)umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(CONSTBUFFER_HANDLE, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_Create, my_CONSTBUFFER_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(CONSTBUFFER_Create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_GetContent, my_CONSTBUFFER_GetContent);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(CONSTBUFFER_GetContent, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_DecRef, my_CONSTBUFFER_DecRef);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_PATCH_09_001: [ If `patch` or `next_patch` are NULL, or `next_patch_size` is 0, IoTHubClient_TwinPatch_Merge shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_TwinPatch_Merge_NULL_patch_fails)
+{
+    //arrange
+    const char* next_patch = "{\"a\":1}";
+
+    //act
+    CONSTBUFFER_HANDLE result = IoTHubClient_TwinPatch_Merge(NULL, (const unsigned char*)next_patch, strlen(next_patch));
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_TWIN_PATCH_09_001: [ If `patch` or `next_patch` are NULL, or `next_patch_size` is 0, IoTHubClient_TwinPatch_Merge shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_TwinPatch_Merge_NULL_next_patch_fails)
+{
+    //arrange
+    CONSTBUFFER_HANDLE patch = create_patch("{\"a\":1}");
+
+    //act
+    CONSTBUFFER_HANDLE result = IoTHubClient_TwinPatch_Merge(patch, NULL, 7);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    my_CONSTBUFFER_DecRef(patch);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_PATCH_09_001: [ If `patch` or `next_patch` are NULL, or `next_patch_size` is 0, IoTHubClient_TwinPatch_Merge shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_TwinPatch_Merge_zero_size_fails)
+{
+    //arrange
+    CONSTBUFFER_HANDLE patch = create_patch("{\"a\":1}");
+
+    //act
+    CONSTBUFFER_HANDLE result = IoTHubClient_TwinPatch_Merge(patch, (const unsigned char*)"{}", 0);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    my_CONSTBUFFER_DecRef(patch);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_PATCH_09_002: [ IoTHubClient_TwinPatch_Merge shall parse both patches as JSON. ]*/
+/* Tests_SRS_IOTHUB_TWIN_PATCH_09_004: [ Every other member of `next_patch`, including null ones, shall replace the member with the same name in `patch`. ]*/
+/* Tests_SRS_IOTHUB_TWIN_PATCH_09_006: [ IoTHubClient_TwinPatch_Merge shall return the serialized merged patch in a new CONSTBUFFER_HANDLE. ]*/
+TEST_FUNCTION(IoTHubClient_TwinPatch_Merge_replaces_members_succeed)
+{
+    //arrange
+    const char* patch_json = "{\"temperature\":20,\"mode\":\"eco\"}";
+    const char* next_patch = "{\"temperature\":21,\"fan\":true,\"mode\":null}";
+    CONSTBUFFER_HANDLE patch = create_patch(patch_json);
+    CONSTBUFFER_HANDLE result;
+
+    set_merge_expected_calls(strlen(patch_json), strlen(next_patch));
+
+    //act
+    result = IoTHubClient_TwinPatch_Merge(patch, (const unsigned char*)next_patch, strlen(next_patch));
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    assert_merged_patch("{\"temperature\":21,\"mode\":null,\"fan\":true}", result);
+
+    //cleanup
+    my_CONSTBUFFER_DecRef(result);
+    my_CONSTBUFFER_DecRef(patch);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_PATCH_09_005: [ Members that are JSON objects in both patches shall be merged recursively. ]*/
+TEST_FUNCTION(IoTHubClient_TwinPatch_Merge_nested_objects_succeed)
+{
+    //arrange
+    const char* patch_json = "{\"config\":{\"rate\":5,\"unit\":\"s\"},\"fw\":{\"version\":\"1.0\"}}";
+    const char* next_patch = "{\"config\":{\"rate\":10},\"fw\":\"none\"}";
+    CONSTBUFFER_HANDLE patch = create_patch(patch_json);
+    CONSTBUFFER_HANDLE result;
+
+    set_merge_expected_calls(strlen(patch_json), strlen(next_patch));
+
+    //act
+    result = IoTHubClient_TwinPatch_Merge(patch, (const unsigned char*)next_patch, strlen(next_patch));
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    assert_merged_patch("{\"config\":{\"rate\":10,\"unit\":\"s\"},\"fw\":\"none\"}", result);
+
+    //cleanup
+    my_CONSTBUFFER_DecRef(result);
+    my_CONSTBUFFER_DecRef(patch);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_PATCH_09_008: [ If a member of `next_patch` is a JSON object and the same member of `patch` is null or not a JSON object, IoTHubClient_TwinPatch_Merge shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_TwinPatch_Merge_object_over_null_member_fails)
+{
+    //arrange
+    const char* patch_json = "{\"a\":null}";
+    const char* next_patch = "{\"a\":{\"x\":1}}";
+    CONSTBUFFER_HANDLE patch = create_patch(patch_json);
+    CONSTBUFFER_HANDLE result;
+
+    STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(patch_json) + 1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(next_patch) + 1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    result = IoTHubClient_TwinPatch_Merge(patch, (const unsigned char*)next_patch, strlen(next_patch));
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    my_CONSTBUFFER_DecRef(patch);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_PATCH_09_008: [ If a member of `next_patch` is a JSON object and the same member of `patch` is null or not a JSON object, IoTHubClient_TwinPatch_Merge shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_TwinPatch_Merge_object_over_scalar_member_fails)
+{
+    //arrange
+    const char* patch_json = "{\"a\":5}";
+    const char* next_patch = "{\"a\":{\"x\":1}}";
+    CONSTBUFFER_HANDLE patch = create_patch(patch_json);
+    CONSTBUFFER_HANDLE result;
+
+    STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(patch_json) + 1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(next_patch) + 1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    result = IoTHubClient_TwinPatch_Merge(patch, (const unsigned char*)next_patch, strlen(next_patch));
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    my_CONSTBUFFER_DecRef(patch);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_PATCH_09_003: [ If either patch is not a JSON object, IoTHubClient_TwinPatch_Merge shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_TwinPatch_Merge_next_patch_not_object_fails)
+{
+    //arrange
+    const char* patch_json = "{\"a\":1}";
+    const char* next_patch = "[1,2]";
+    CONSTBUFFER_HANDLE patch = create_patch(patch_json);
+    CONSTBUFFER_HANDLE result;
+
+    STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(patch_json) + 1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(next_patch) + 1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    result = IoTHubClient_TwinPatch_Merge(patch, (const unsigned char*)next_patch, strlen(next_patch));
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    my_CONSTBUFFER_DecRef(patch);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_PATCH_09_003: [ If either patch is not a JSON object, IoTHubClient_TwinPatch_Merge shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_TwinPatch_Merge_invalid_patch_fails)
+{
+    //arrange
+    const char* patch_json = "{\"a\":";
+    const char* next_patch = "{\"a\":1}";
+    CONSTBUFFER_HANDLE patch = create_patch(patch_json);
+    CONSTBUFFER_HANDLE result;
+
+    STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(patch_json) + 1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    result = IoTHubClient_TwinPatch_Merge(patch, (const unsigned char*)next_patch, strlen(next_patch));
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    my_CONSTBUFFER_DecRef(patch);
+}
+
+/* Tests_SRS_IOTHUB_TWIN_PATCH_09_007: [ If any failure occurs, IoTHubClient_TwinPatch_Merge shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_TwinPatch_Merge_negative_tests)
+{
+    //arrange
+    const char* patch_json = "{\"a\":1}";
+    const char* next_patch = "{\"b\":2}";
+    CONSTBUFFER_HANDLE patch = create_patch(patch_json);
+    size_t calls_cannot_fail[] = { 2, 4 };
+    size_t count;
+    size_t index;
+
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    set_merge_expected_calls(strlen(patch_json), strlen(next_patch));
+    umock_c_negative_tests_snapshot();
+
+    count = umock_c_negative_tests_call_count();
+    for (index = 0; index < count; index++)
+    {
+        char tmp_msg[64];
+        CONSTBUFFER_HANDLE result;
+
+        if (should_skip_index(index, calls_cannot_fail, sizeof(calls_cannot_fail) / sizeof(calls_cannot_fail[0])) != 0)
+        {
+            continue;
+        }
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        sprintf(tmp_msg, "IoTHubClient_TwinPatch_Merge failure in test %lu/%lu", (unsigned long)index, (unsigned long)count);
+
+        //act
+        result = IoTHubClient_TwinPatch_Merge(patch, (const unsigned char*)next_patch, strlen(next_patch));
+
+        //assert
+        ASSERT_IS_NULL(result, tmp_msg);
+    }
+
+    //cleanup
+    umock_c_negative_tests_deinit();
+    my_CONSTBUFFER_DecRef(patch);
+}
+
+END_TEST_SUITE(iothubclient_twin_patch_ut)
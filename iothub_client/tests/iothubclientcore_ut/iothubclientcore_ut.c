@@ -61,6 +61,7 @@ void* my_gballoc_realloc(void* ptr, size_t size)
 
 #define ENABLE_MOCKS
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/agenttime.h"
@@ -73,6 +74,7 @@ void* my_gballoc_realloc(void* ptr, size_t size)
 #undef IOTHUB_CLIENT_CORE_H
 
 #include "iothub_client_core.h"
+#include "iothub_client_options.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -189,6 +191,8 @@ static LOCK_TEST_INFO g_transport_lock;
 
 static THREAD_START_FUNC g_thread_func;
 static void* g_thread_func_arg;
+static THREAD_START_FUNC g_method_worker_func;
+static void* g_method_worker_func_arg;
 static IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK g_eventConfirmationCallback;
 static IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK g_deviceTwinCallback;
 static IOTHUB_CLIENT_REPORTED_STATE_CALLBACK g_reportedStateCallback;
@@ -214,6 +218,7 @@ static IOTHUB_CLIENT_DEVICE_CONFIG* TEST_CLIENT_DEVICE_CONFIG = (IOTHUB_CLIENT_D
 static METHOD_HANDLE TEST_METHOD_ID = (METHOD_HANDLE)0x111B;
 static STRING_HANDLE TEST_STRING_HANDLE = (STRING_HANDLE)0x111C;
 static BUFFER_HANDLE TEST_BUFFER_HANDLE = (BUFFER_HANDLE)0x111D;
+static COND_HANDLE TEST_COND_HANDLE = (COND_HANDLE)0x111E;
 
 static const char* TEST_CONNECTION_STRING = "Test_connection_string";
 static const char* TEST_DEVICE_ID = "theidofTheDevice";
@@ -281,6 +286,35 @@ static THREADAPI_RESULT my_ThreadAPI_Join(THREAD_HANDLE threadHandle, int *res)
     return THREADAPI_OK;
 }
 
+#ifndef DONT_USE_UPLOADTOBLOB
+static IOTHUB_CLIENT_CORE_HANDLE g_upload_while_http_worker_waits;
+static size_t g_http_workers_to_run_on_sleep;
+#endif
+
+static COND_RESULT my_Condition_Wait(COND_HANDLE handle, LOCK_HANDLE lock, int timeout_milliseconds)
+{
+    COND_RESULT result;
+    (void)handle;
+    (void)lock;
+    (void)timeout_milliseconds;
+
+#ifndef DONT_USE_UPLOADTOBLOB
+    if (g_upload_while_http_worker_waits != NULL)
+    {
+        IOTHUB_CLIENT_CORE_HANDLE iothub_handle = g_upload_while_http_worker_waits;
+        g_upload_while_http_worker_waits = NULL;
+        (void)IoTHubClientCore_UploadToBlobAsync(iothub_handle, "someFileName.txt", (const unsigned char*)"a", 1, test_file_upload_callback, (void*)1);
+        result = COND_OK;
+    }
+    else
+#endif
+    {
+        result = COND_TIMEOUT;
+    }
+
+    return result;
+}
+
 static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
 {
     *threadHandle = TEST_THREAD_HANDLE;
@@ -289,6 +323,14 @@ static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_
     return THREADAPI_OK;
 }
 
+static THREADAPI_RESULT my_ThreadAPI_Create_method_worker(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    *threadHandle = TEST_THREAD_HANDLE;
+    g_method_worker_func = func;
+    g_method_worker_func_arg = arg;
+    return THREADAPI_OK;
+}
+
 static void my_ThreadAPI_Sleep(unsigned int milliseconds)
 {
     (void)milliseconds;
@@ -297,6 +339,13 @@ static void my_ThreadAPI_Sleep(unsigned int milliseconds)
     {
         *(sig_atomic_t*)(((char*)g_thread_func_arg) + IoTHubClientCore_ThreadTerminationOffset) = 1; /*tell the thread to stop*/
     }
+#ifndef DONT_USE_UPLOADTOBLOB
+    while (g_http_workers_to_run_on_sleep > 0)
+    {
+        g_http_workers_to_run_on_sleep--;
+        g_thread_func(g_thread_func_arg); /*stands in for an HTTP worker that IoTHubClient_Destroy waits for*/
+    }
+#endif
 }
 
 static IOTHUB_CLIENT_RESULT my_IoTHubClientCore_LL_GetSendStatus(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
@@ -480,6 +529,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONNECTION_STATUS_REASON, int);
     REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC_EX, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK, void*);
@@ -488,6 +539,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_FILE_UPLOAD_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_RETRY_POLICY, int);
     REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LIST_MATCH_FUNCTION, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK, void*);
     REGISTER_UMOCK_ALIAS_TYPE(VECTOR_HANDLE, void*);
@@ -593,6 +645,13 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(Unlock, my_Unlock);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(Unlock, LOCK_ERROR);
 
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Init, TEST_COND_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Post, COND_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Wait, my_Condition_Wait);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Wait, COND_ERROR);
+
     REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Sleep, my_ThreadAPI_Sleep);
     REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Join, my_ThreadAPI_Join);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Join, THREADAPI_ERROR);
@@ -639,6 +698,12 @@ static void reset_test_data()
 {
     g_thread_func = NULL;
     g_thread_func_arg = NULL;
+#ifndef DONT_USE_UPLOADTOBLOB
+    g_upload_while_http_worker_waits = NULL;
+    g_http_workers_to_run_on_sleep = 0;
+#endif
+    g_method_worker_func = NULL;
+    g_method_worker_func_arg = NULL;
     g_userContextCallback = NULL;
     g_how_thread_loops = 0;
     g_thread_loop_count = 0;
@@ -759,35 +824,55 @@ static void setup_iothubclient_sendeventasync(bool use_threads)
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).CallCannotFail();
 }
 
-#ifndef DONT_USE_UPLOADTOBLOB
-static void setup_gargageCollection(void* saved_data, bool can_item_be_collected)
+#if !defined(DONT_USE_UPLOADTOBLOB) || defined(USE_EDGE_MODULES)
+static void set_expected_calls_queue_http_job(bool create_job_list, bool worker_starts, const void** job)
 {
-    EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE))
-        .SetReturn(TEST_LIST_HANDLE);
-    EXPECTED_CALL(singlylinkedlist_item_get_value(TEST_LIST_HANDLE))
-        .SetReturn(saved_data);
-    EXPECTED_CALL(singlylinkedlist_get_next_item(TEST_LIST_HANDLE))
-        .SetReturn(NULL);
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
-
-    if (can_item_be_collected)
+    if (create_job_list)
+    {
+        STRICT_EXPECTED_CALL(singlylinkedlist_create());
+        STRICT_EXPECTED_CALL(Condition_Init());
+    }
+    if (job != NULL)
     {
-        EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-        EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-        EXPECTED_CALL(free(IGNORED_PTR_ARG));
-        EXPECTED_CALL(free(IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
-        EXPECTED_CALL(free(IGNORED_PTR_ARG));
-        EXPECTED_CALL(free(IGNORED_PTR_ARG));
-        EXPECTED_CALL(free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_SLL_HANDLE, IGNORED_PTR_ARG))
+            .CaptureArgumentValue_item(job);
     }
     else
     {
-        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_SLL_HANDLE, IGNORED_PTR_ARG));
+    }
+    if (worker_starts)
+    {
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     }
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+}
+
+static void set_expected_calls_http_worker_takes_job(const void* job)
+{
+    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE)).SetReturn(TEST_LIST_HANDLE);
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(TEST_LIST_HANDLE)).SetReturn(job);
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_SLL_HANDLE, TEST_LIST_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+}
+
+static void set_expected_calls_http_worker_exits_after_waiting(void)
+{
+    STRICT_EXPECTED_CALL(Condition_Wait(TEST_COND_HANDLE, IGNORED_PTR_ARG, IGNORED_NUM_ARG)); /*idle timeout*/
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
 }
 
+static void set_expected_calls_http_worker_exits(void)
+{
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    set_expected_calls_http_worker_exits_after_waiting();
+}
 
 static void setup_IothubClient_Destroy_after_garbage_collection()
 {
@@ -801,28 +886,55 @@ static void setup_IothubClient_Destroy_after_garbage_collection()
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 }
 
-static void setup_iothubclient_uploadtoblobasync()
+static void setup_IothubClient_Destroy_after_http_job()
 {
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*this is creating a HTTPWORKER_THREAD_INFO*/
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*this is making a copy of the filename*/
-    STRICT_EXPECTED_CALL(Lock_Init());
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*this is creating a UPLOADTOBLOB_SAVED_DATA*/
-    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*this is adding HTTPWORKER_THREAD_INFO to the list of HTTPWORKER_THREAD_INFO's to be cleaned*/
-    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
 
-    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).CallCannotFail();
-    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_UploadToBlob(TEST_IOTHUB_CLIENT_CORE_LL_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1)); /*this is the thread calling into _LL layer*/
-    STRICT_EXPECTED_CALL(test_file_upload_callback(FILE_UPLOAD_OK, IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    /*destroy_http_workers, the HTTP worker already exited*/
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    setup_IothubClient_Destroy_after_garbage_collection();
+}
+#endif
+
+#ifndef DONT_USE_UPLOADTOBLOB
+static void setup_iothubclient_uploadtoblobasync(const void** job)
+{
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*this is creating a HTTPWORKER_THREAD_INFO*/
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*this is making a copy of the filename*/
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*this is creating a UPLOADTOBLOB_SAVED_DATA*/
+    set_expected_calls_queue_http_job(true, true, job);
+}
+
+/*runs the last HTTP worker started until it took all the jobs*/
+static void run_http_worker_on_jobs(const void** jobs, size_t job_count)
+{
+    size_t index;
+
+    umock_c_reset_all_calls();
+    for (index = 0; index < job_count; index++)
+    {
+        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE)).SetReturn(TEST_LIST_HANDLE);
+        STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(TEST_LIST_HANDLE)).SetReturn(jobs[index]);
+    }
+
+    g_thread_func(g_thread_func_arg);
 }
 
+static void set_expected_calls_for_freeUploadToBlobThreadInfo()
+{
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+}
 #endif
 
 // Initial time we loop through ScheduleWork, including DoWork and into the always run dispatch_user_callbacks functions.
@@ -831,7 +943,6 @@ static void set_expected_calls_first_ScheduleWork_Thread_loop(size_t expected_ca
     STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).CallCannotFail();
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(IoTHubClientCore_LL_DoWork(TEST_IOTHUB_CLIENT_CORE_LL_HANDLE));
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
     STRICT_EXPECTED_CALL(VECTOR_move(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG)).SetReturn(expected_callbacks_length);
@@ -1430,6 +1541,70 @@ TEST_FUNCTION(IoTHubClient_SendEventAsync_fail)
     IoTHubClientCore_Destroy(iothub_handle);
 }
 
+/* Tests_SRS_IOTHUBCLIENT_09_022: [ If the send queue full policy is `IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK`, `IoTHubClient_SendEventAsync` shall call `IoTHubClientCore_LL_CheckSendQueueRoom` and, while it returns `IOTHUB_CLIENT_QUEUE_FULL`, release the lock, sleep for `do_work_freq_ms` and check again. ]*/
+/* Tests_SRS_IOTHUBCLIENT_09_023: [ If parameter `optionName` is `OPTION_SEND_QUEUE_FULL_POLICY` and `IoTHubClientCore_LL_SetOption` succeeds, `IoTHubClientCore_SetOption` shall keep the policy to carry out `IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK`. ]*/
+TEST_FUNCTION(IoTHubClient_SendEventAsync_block_policy_waits_while_send_queue_is_full)
+{
+    // arrange
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK;
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    (void)IoTHubClientCore_SetOption(iothub_handle, OPTION_SEND_QUEUE_FULL_POLICY, &policy);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_CheckSendQueueRoom(IGNORED_PTR_ARG, TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUB_CLIENT_QUEUE_FULL);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Sleep(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_CheckSendQueueRoom(IGNORED_PTR_ARG, TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUB_CLIENT_OK);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_SendEventAsync(IGNORED_PTR_ARG, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_09_033: [ An event that can never fit in the send queue shall not be waited for; `IoTHubClient_SendEventAsync` shall return the result of `IoTHubClientCore_LL_SendEventAsync` for it. ]*/
+TEST_FUNCTION(IoTHubClient_SendEventAsync_block_policy_does_not_wait_for_event_larger_than_send_queue)
+{
+    // arrange
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK;
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    (void)IoTHubClientCore_SetOption(iothub_handle, OPTION_SEND_QUEUE_FULL_POLICY, &policy);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_CheckSendQueueRoom(IGNORED_PTR_ARG, TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUB_CLIENT_INVALID_ARG);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_SendEventAsync(IGNORED_PTR_ARG, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(IOTHUB_CLIENT_INVALID_ARG);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
 /* Tests_SRS_IOTHUBCLIENT_07_001: [ IoTHubClientCore_SendEventAsync shall allocate a IOTHUB_QUEUE_CONTEXT object to be sent to the IoTHubClientCore_LL_SendEventAsync function as a user context. ] */
 TEST_FUNCTION(IoTHubClient_SendEventAsync_event_confirm_callback_succeed)
 {
@@ -2193,7 +2368,6 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_DO_WORK_FREQ_IN_MS_success)
     STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).CallCannotFail();
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(IoTHubClientCore_LL_DoWork(TEST_IOTHUB_CLIENT_CORE_LL_HANDLE));
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
     STRICT_EXPECTED_CALL(VECTOR_move(IGNORED_PTR_ARG)).SetReturn(NULL);
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(ThreadAPI_Sleep(57));
@@ -2213,6 +2387,72 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_DO_WORK_FREQ_IN_MS_success)
 }
 
 
+/* Tests_SRS_IOTHUBCLIENT_09_016: [ If parameter `optionName` is `OPTION_METHOD_MAX_CONCURRENCY` then `IoTHubClientCore_SetOption` shall set `method_max_concurrency` parameter of `IoTHubClientInstance` ]*/
+TEST_FUNCTION(IoTHubClientCore_SetOption_METHOD_MAX_CONCURRENCY_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    size_t max_concurrency = 4;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_create());
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_SetOption(iothub_handle, OPTION_METHOD_MAX_CONCURRENCY, &max_concurrency);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_SetOption_METHOD_MAX_CONCURRENCY_list_create_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    size_t max_concurrency = 4;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_SetOption(iothub_handle, OPTION_METHOD_MAX_CONCURRENCY, &max_concurrency);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_SetOption_METHOD_MAX_CONCURRENCY_zero_does_not_create_list)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    size_t max_concurrency = 0;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_SetOption(iothub_handle, OPTION_METHOD_MAX_CONCURRENCY, &max_concurrency);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
 /* Tests_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClientCore_SetOption shall call IoTHubClientCore_LL_SetOption passing the same parameters and return what IoTHubClientCore_LL_SetOption returns.]*/
 /* Tests_SRS_IOTHUBCLIENT_01_042: [If acquiring the lock fails, IoTHubClientCore_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_ERROR. ]*/
 /* Tests_SRS_IOTHUBCLIENT_10_007: [IoTHubClientCore_SetDeviceTwinCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL. ]*/
@@ -2962,23 +3202,36 @@ TEST_FUNCTION(IoTHubClientCore_UploadToBlobAsync_with_NULL_source_and_size_1_fai
 }
 
 /*Tests_SRS_IOTHUBCLIENT_02_051: [ IoTHubClientCore_UploadToBlobAsync shall copy the source, size, iotHubClientFileUploadCallback, context and a non-initialized(1) THREAD_HANDLE parameters into a structure. ]*/
-/*Tests_SRS_IOTHUBCLIENT_02_058: [ IoTHubClientCore_UploadToBlobAsync shall add the structure to the list of structures that need to be cleaned once file upload finishes. ]*/
-/*Tests_SRS_IOTHUBCLIENT_02_052: [ IoTHubClientCore_UploadToBlobAsync shall spawn a thread passing the structure build in SRS IOTHUBCLIENT 02 051 as thread data.]*/
+/*Tests_SRS_IOTHUBCLIENT_02_052: [ IoTHubClientCore_UploadToBlobAsync shall queue the structure build in SRS IOTHUBCLIENT 02 051 as an HTTP job. ]*/
+/*Tests_SRS_IOTHUBCLIENT_09_028: [ The structure shall be queued as a job for the HTTP worker threads of the client. ]*/
+/*Tests_SRS_IOTHUBCLIENT_09_030: [ An HTTP worker thread shall run the queued method invokes and the queued uploads each in the order they were queued and exit when none is left after waiting, or when `IoTHubClient_Destroy` stops it. ]*/
+/*Tests_SRS_IOTHUBCLIENT_09_034: [ An HTTP worker thread with no job to run shall wait up to `HTTP_WORKER_IDLE_TIMEOUT_MS` for a new job before exiting. ]*/
 /*Tests_SRS_IOTHUBCLIENT_02_054: [ The thread shall call IoTHubClientCore_LL_UploadToBlob passing the information packed in the structure. ]*/
 /*Tests_SRS_IOTHUBCLIENT_02_056: [ Otherwise the thread iotHubClientFileUploadCallbackInternal passing as result FILE_UPLOAD_OK and the structure from SRS IOTHUBCLIENT 02 051. ]*/
-/*Tests_SRS_IOTHUBCLIENT_02_071: [ The thread shall mark itself as disposable. ]*/
+/*Tests_SRS_IOTHUBCLIENT_02_071: [ The structure shall be freed by the HTTP worker thread once the upload completes. ]*/
+/*Tests_SRS_IOTHUBCLIENT_09_036: [ `IoTHubClient_Destroy` shall wake up each of the HTTP worker threads waiting for a job so that they exit. ]*/
+/*Tests_SRS_IOTHUBCLIENT_09_032: [ IoTHubClient_Destroy shall wait for the HTTP worker threads to run the queued HTTP jobs and join them. ]*/
 TEST_FUNCTION(IoTHubClientCore_UploadToBlobAsync_succeeds)
 {
     //arrange
     IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    const void* job = NULL;
     umock_c_reset_all_calls();
 
-    setup_iothubclient_uploadtoblobasync();
+    setup_iothubclient_uploadtoblobasync(&job);
 
     //act
     IOTHUB_CLIENT_RESULT result = IoTHubClientCore_UploadToBlobAsync(iothub_handle, "someFileName.txt", (const unsigned char*)"a", 1, test_file_upload_callback, (void*)1);
 
-    g_thread_func(g_thread_func_arg); /*this is the thread uploading function*/
+    ASSERT_IS_NOT_NULL(job);
+    set_expected_calls_http_worker_takes_job(job);
+    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_UploadToBlob(TEST_IOTHUB_CLIENT_CORE_LL_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1)); /*this is the job calling into _LL layer*/
+    STRICT_EXPECTED_CALL(test_file_upload_callback(FILE_UPLOAD_OK, IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    set_expected_calls_for_freeUploadToBlobThreadInfo();
+    set_expected_calls_http_worker_exits();
+
+    g_thread_func(g_thread_func_arg); /*this is the HTTP worker*/
 
     //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
@@ -2986,64 +3239,277 @@ TEST_FUNCTION(IoTHubClientCore_UploadToBlobAsync_succeeds)
 
     // cleanup
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
-
-    EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-
-    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
-    EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE))
-        .SetReturn(TEST_LIST_HANDLE);
-
-    setup_gargageCollection(my_malloc_items[2], true);
-    setup_IothubClient_Destroy_after_garbage_collection();
+    setup_IothubClient_Destroy_after_http_job();
 
     IoTHubClientCore_Destroy(iothub_handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-static void set_expected_calls_for_freeUploadToBlobThreadInfo()
+/*Tests_SRS_IOTHUBCLIENT_09_029: [ A new HTTP worker thread shall be started only while fewer than `HTTP_WORKER_POOL_SIZE` are running; otherwise the job waits for a running worker. ]*/
+TEST_FUNCTION(IoTHubClientCore_UploadToBlobAsync_does_not_start_a_worker_when_all_http_workers_run)
 {
-    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
-    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-}
+    //arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    const void* jobs[5] = { NULL };
+    size_t index;
+
+    for (index = 0; index < 4; index++)
+    {
+        umock_c_reset_all_calls();
+        STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_SLL_HANDLE, IGNORED_PTR_ARG))
+            .CaptureArgumentValue_item(&jobs[index]);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClientCore_UploadToBlobAsync(iothub_handle, "someFileName.txt", (const unsigned char*)"a", 1, test_file_upload_callback, (void*)1));
+    }
+    umock_c_reset_all_calls();
 
-static void set_expected_calls_for_allocateUploadToBlob()
-{
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Lock_Init());
-}
-
-/*Tests_SRS_IOTHUBCLIENT_99_072: [ If `iotHubClientHandle` is `NULL` then `IoTHubClientCore_UploadMultipleBlocksToBlobAsync(Ex)` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
-TEST_FUNCTION(IoTHubClientCore_UploadMultipleBlocksToBlobAsync_fails_when_handle_is_NULL)
-{
-    ///arrange
-    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = NULL;
-    int context = 1;
-    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    set_expected_calls_queue_http_job(false, false, &jobs[4]);
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_UploadMultipleBlocksToBlobAsync(iothub_handle, "someFileName.txt", my_FileUpload_GetData_Callback, NULL, &context);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_UploadToBlobAsync(iothub_handle, "someFileName.txt", (const unsigned char*)"a", 1, test_file_upload_callback, (void*)1);
 
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
+    run_http_worker_on_jobs(jobs, 5);
+    for (index = 1; index < 4; index++)
+    {
+        g_thread_func(g_thread_func_arg); /*stands in for the other workers, which find no job left*/
+    }
     IoTHubClientCore_Destroy(iothub_handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_99_073: [ If `destinationFileName` is `NULL` then `IoTHubClientCore_UploadMultipleBlocksToBlobAsync(Ex)` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
-TEST_FUNCTION(IoTHubClientCore_UploadMultipleBlocksToBlobAsync_fails_when_destinationFileName_is_NULL)
+/*Tests_SRS_IOTHUBCLIENT_09_036: [ `IoTHubClient_Destroy` shall wake up each of the HTTP worker threads waiting for a job so that they exit. ]*/
+/*Tests_SRS_IOTHUBCLIENT_09_032: [ IoTHubClient_Destroy shall wait for the HTTP worker threads to run the queued HTTP jobs and join them. ]*/
+TEST_FUNCTION(IoTHubClientCore_Destroy_wakes_up_every_http_worker)
 {
-    ///arrange
+    //arrange
     IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
-    int context = 1;
+    const void* jobs[2] = { NULL };
+    size_t index;
+
+    for (index = 0; index < 2; index++)
+    {
+        umock_c_reset_all_calls();
+        STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_SLL_HANDLE, IGNORED_PTR_ARG))
+            .CaptureArgumentValue_item(&jobs[index]);
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClientCore_UploadToBlobAsync(iothub_handle, "someFileName.txt", (const unsigned char*)"a", 1, test_file_upload_callback, (void*)1));
+    }
     umock_c_reset_all_calls();
+    g_http_workers_to_run_on_sleep = 2;
 
-    ///act
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    /*destroy_http_workers*/
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
+    /*the first HTTP worker runs both jobs and exits*/
+    set_expected_calls_http_worker_takes_job(jobs[0]);
+    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_UploadToBlob(TEST_IOTHUB_CLIENT_CORE_LL_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(test_file_upload_callback(FILE_UPLOAD_OK, IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    set_expected_calls_for_freeUploadToBlobThreadInfo();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE)).SetReturn(TEST_LIST_HANDLE);
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(TEST_LIST_HANDLE)).SetReturn(jobs[1]);
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_SLL_HANDLE, TEST_LIST_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_UploadToBlob(TEST_IOTHUB_CLIENT_CORE_LL_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(test_file_upload_callback(FILE_UPLOAD_OK, IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    set_expected_calls_for_freeUploadToBlobThreadInfo();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+    /*the second HTTP worker finds no job and exits*/
+    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    setup_IothubClient_Destroy_after_garbage_collection();
+
+    //act
+    IoTHubClientCore_Destroy(iothub_handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_09_034: [ An HTTP worker thread with no job to run shall wait up to `HTTP_WORKER_IDLE_TIMEOUT_MS` for a new job before exiting. ]*/
+/*Tests_SRS_IOTHUBCLIENT_09_035: [ If an HTTP worker thread is waiting for a job, it shall be woken up to run the job instead of starting a new worker thread. ]*/
+TEST_FUNCTION(IoTHubClientCore_UploadToBlobAsync_wakes_up_the_waiting_http_worker)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    const void* jobs[2] = { NULL };
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_SLL_HANDLE, IGNORED_PTR_ARG))
+        .CaptureArgumentValue_item(&jobs[0]);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClientCore_UploadToBlobAsync(iothub_handle, "someFileName.txt", (const unsigned char*)"a", 1, test_file_upload_callback, (void*)1));
+    umock_c_reset_all_calls();
+    g_upload_while_http_worker_waits = iothub_handle;
+
+    set_expected_calls_http_worker_takes_job(jobs[0]);
+    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_UploadToBlob(TEST_IOTHUB_CLIENT_CORE_LL_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(test_file_upload_callback(FILE_UPLOAD_OK, IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    set_expected_calls_for_freeUploadToBlobThreadInfo();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Wait(TEST_COND_HANDLE, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    /*the upload queued while the worker waits*/
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_SLL_HANDLE, IGNORED_PTR_ARG))
+        .CaptureArgumentValue_item(&jobs[1]);
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    /*the woken up worker finds no job, as if another worker took it, so it waits again*/
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    set_expected_calls_http_worker_exits_after_waiting();
+
+    //act
+    g_thread_func(g_thread_func_arg); /*this is the HTTP worker*/
+
+    //assert
+    ASSERT_IS_NOT_NULL(jobs[1]);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    run_http_worker_on_jobs(&jobs[1], 1);
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_09_031: [ An HTTP worker thread that exited shall be joined before a new worker thread takes its place. ]*/
+TEST_FUNCTION(IoTHubClientCore_UploadToBlobAsync_joins_the_exited_http_worker_it_replaces)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    const void* job = NULL;
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_SLL_HANDLE, IGNORED_PTR_ARG))
+        .CaptureArgumentValue_item(&job);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClientCore_UploadToBlobAsync(iothub_handle, "someFileName.txt", (const unsigned char*)"a", 1, test_file_upload_callback, (void*)1));
+    run_http_worker_on_jobs(&job, 1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_SLL_HANDLE, IGNORED_PTR_ARG))
+        .CaptureArgumentValue_item(&job);
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_UploadToBlobAsync(iothub_handle, "someFileName.txt", (const unsigned char*)"a", 1, test_file_upload_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    run_http_worker_on_jobs(&job, 1);
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_09_024: [ If `iotHubClientHandle`, `destinationFileName` or `sourceFilePath` are NULL, `IoTHubClientCore_UploadFileToBlobAsync` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+TEST_FUNCTION(IoTHubClientCore_UploadFileToBlobAsync_with_NULL_sourceFilePath_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_UploadFileToBlobAsync(iothub_handle, "someFileName.txt", NULL, test_file_upload_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+static void set_expected_calls_for_allocateUploadToBlob()
+{
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+}
+
+/*Tests_SRS_IOTHUBCLIENT_09_027: [ If copying to the structure or spawning the thread fails, `IoTHubClientCore_UploadFileToBlobAsync` shall fail and return `IOTHUB_CLIENT_ERROR`. ]*/
+TEST_FUNCTION(IoTHubClientCore_UploadFileToBlobAsync_fails_when_copying_sourceFilePath_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    set_expected_calls_for_allocateUploadToBlob();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, "/tmp/source.bin"))
+        .SetReturn(MU_FAILURE);
+    set_expected_calls_for_freeUploadToBlobThreadInfo();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_UploadFileToBlobAsync(iothub_handle, "someFileName.txt", "/tmp/source.bin", test_file_upload_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_99_072: [ If `iotHubClientHandle` is `NULL` then `IoTHubClientCore_UploadMultipleBlocksToBlobAsync(Ex)` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+TEST_FUNCTION(IoTHubClientCore_UploadMultipleBlocksToBlobAsync_fails_when_handle_is_NULL)
+{
+    ///arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = NULL;
+    int context = 1;
+    umock_c_reset_all_calls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_UploadMultipleBlocksToBlobAsync(iothub_handle, "someFileName.txt", my_FileUpload_GetData_Callback, NULL, &context);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_99_073: [ If `destinationFileName` is `NULL` then `IoTHubClientCore_UploadMultipleBlocksToBlobAsync(Ex)` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+TEST_FUNCTION(IoTHubClientCore_UploadMultipleBlocksToBlobAsync_fails_when_destinationFileName_is_NULL)
+{
+    ///arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    int context = 1;
+    umock_c_reset_all_calls();
+
+    ///act
     IOTHUB_CLIENT_RESULT result = IoTHubClientCore_UploadMultipleBlocksToBlobAsync(iothub_handle, NULL, my_FileUpload_GetData_Callback, NULL, &context);
 
     ///assert
@@ -3078,42 +3544,38 @@ static void IoTHubClientCore_UploadMultipleBlocksToBlobAsync_succeeds_Impl(bool
     ///arrange
     IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
     int context = 1;
+    const void* job = NULL;
     umock_c_reset_all_calls();
 
     set_expected_calls_for_allocateUploadToBlob();
-    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    set_expected_calls_queue_http_job(true, true, &job);
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*this is adding HTTPWORKER_THREAD_INFO to the list of HTTPWORKER_THREAD_INFO's to be cleaned*/
-    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
-
-    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).CallCannotFail();
-
-    /* thread uploading function */
+    ///act
+    IOTHUB_CLIENT_RESULT result;
     if (exCall)
     {
-        STRICT_EXPECTED_CALL(IoTHubClientCore_LL_UploadMultipleBlocksToBlobEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        result = IoTHubClientCore_UploadMultipleBlocksToBlobAsync(iothub_handle, "someFileName.txt", NULL, my_FileUpload_GetData_CallbackEx, &context);
     }
     else
     {
-        STRICT_EXPECTED_CALL(IoTHubClientCore_LL_UploadMultipleBlocksToBlob(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        result = IoTHubClientCore_UploadMultipleBlocksToBlobAsync(iothub_handle, "someFileName.txt", my_FileUpload_GetData_Callback, NULL, &context);
     }
-    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
 
-    ///act
-    IOTHUB_CLIENT_RESULT result;
+    ASSERT_IS_NOT_NULL(job);
+    set_expected_calls_http_worker_takes_job(job);
+    /* uploading job */
     if (exCall)
     {
-        result = IoTHubClientCore_UploadMultipleBlocksToBlobAsync(iothub_handle, "someFileName.txt", NULL, my_FileUpload_GetData_CallbackEx, &context);
+        STRICT_EXPECTED_CALL(IoTHubClientCore_LL_UploadMultipleBlocksToBlobEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     }
     else
     {
-        result = IoTHubClientCore_UploadMultipleBlocksToBlobAsync(iothub_handle, "someFileName.txt", my_FileUpload_GetData_Callback, NULL, &context);
+        STRICT_EXPECTED_CALL(IoTHubClientCore_LL_UploadMultipleBlocksToBlob(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     }
-    g_thread_func(g_thread_func_arg); /*this is the thread uploading function*/
+    set_expected_calls_for_freeUploadToBlobThreadInfo();
+    set_expected_calls_http_worker_exits();
+
+    g_thread_func(g_thread_func_arg); /*this is the HTTP worker*/
 
     ///assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
@@ -3121,24 +3583,13 @@ static void IoTHubClientCore_UploadMultipleBlocksToBlobAsync_succeeds_Impl(bool
 
     ///cleanup
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
-
-    EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-
-    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
-    EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE))
-        .SetReturn(TEST_LIST_HANDLE);
-
-    setup_gargageCollection(my_malloc_items[2], true);
-    setup_IothubClient_Destroy_after_garbage_collection();
+    setup_IothubClient_Destroy_after_http_job();
 
     IoTHubClientCore_Destroy(iothub_handle);
-
 }
 
 /*Tests_SRS_IOTHUBCLIENT_99_075: [ IoTHubClientCore_UploadMultipleBlocksToBlobAsync(Ex) shall copy the destinationFileName, getDataCallback, context  and iotHubClientHandle into a structure. ]*/
-/*Tests_SRS_IOTHUBCLIENT_99_076: [ IoTHubClientCore_UploadMultipleBlocksToBlobAsync(Ex) shall spawn a thread passing the structure build in SRS IOTHUBCLIENT 99 075 as thread data.]*/
+/*Tests_SRS_IOTHUBCLIENT_99_076: [ IoTHubClientCore_UploadMultipleBlocksToBlobAsync(Ex) shall queue the structure build in SRS IOTHUBCLIENT 99 075 as an HTTP job. ]*/
 /*Tests_SRS_IOTHUBCLIENT_99_078: [ The thread shall call IoTHubClientCore_LL_UploadMultipleBlocksToBlob or IoTHubClientCore_LL_UploadMultipleBlocksToBlobEx passing the information packed in the structure. ]*/
 /*Tests_SRS_IOTHUBCLIENT_99_077: [ If copying to the structure and spawning the thread succeeds, then IoTHubClientCore_UploadMultipleBlocksToBlobAsync(Ex) shall return IOTHUB_CLIENT_OK. ]*/
 TEST_FUNCTION(IoTHubClientCore_UploadMultipleBlocksToBlobAsync_succeeds)
@@ -3147,7 +3598,7 @@ TEST_FUNCTION(IoTHubClientCore_UploadMultipleBlocksToBlobAsync_succeeds)
 }
 
 /*Tests_SRS_IOTHUBCLIENT_99_075: [ IoTHubClientCore_UploadMultipleBlocksToBlobAsync(Ex) shall copy the destinationFileName, getDataCallback, context  and iotHubClientHandle into a structure. ]*/
-/*Tests_SRS_IOTHUBCLIENT_99_076: [ IoTHubClientCore_UploadMultipleBlocksToBlobAsync(Ex) shall spawn a thread passing the structure build in SRS IOTHUBCLIENT 99 075 as thread data.]*/
+/*Tests_SRS_IOTHUBCLIENT_99_076: [ IoTHubClientCore_UploadMultipleBlocksToBlobAsync(Ex) shall queue the structure build in SRS IOTHUBCLIENT 99 075 as an HTTP job. ]*/
 /*Tests_SRS_IOTHUBCLIENT_99_078: [ The thread shall call IoTHubClientCore_LL_UploadMultipleBlocksToBlob or IoTHubClientCore_LL_UploadMultipleBlocksToBlobEx passing the information packed in the structure. ]*/
 /*Tests_SRS_IOTHUBCLIENT_99_077: [ If copying to the structure and spawning the thread succeeds, then IoTHubClientCore_UploadMultipleBlocksToBlobAsync(Ex) shall return IOTHUB_CLIENT_OK. ]*/
 TEST_FUNCTION(IoTHubClientCore_UploadMultipleBlocksToBlobAsyncEx_succeeds)
@@ -3164,14 +3615,12 @@ static void IoTHubClientCore_UploadMultipleBlocksToBlobAsync_fails_when_ThreadAP
     umock_c_reset_all_calls();
 
     set_expected_calls_for_allocateUploadToBlob();
-    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*this is adding HTTPWORKER_THREAD_INFO to the list of HTTPWORKER_THREAD_INFO's to be cleaned*/
-
+    STRICT_EXPECTED_CALL(singlylinkedlist_create());
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_SLL_HANDLE, IGNORED_PTR_ARG)); /*this is queuing the HTTP job*/
     STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetReturn(THREADAPI_ERROR);
-    STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_SLL_HANDLE, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
     set_expected_calls_for_freeUploadToBlobThreadInfo();
 
@@ -3309,7 +3758,6 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_method_callback_VECTOR_move_FAILS
     STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).CallCannotFail();
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(IoTHubClientCore_LL_DoWork(TEST_IOTHUB_CLIENT_CORE_LL_HANDLE));
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
     STRICT_EXPECTED_CALL(VECTOR_move(IGNORED_PTR_ARG)).SetReturn(NULL);
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
@@ -3531,6 +3979,173 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_repeated_method_callback_succeed)
     IoTHubClientCore_Destroy(iothub_handle);
 }
 
+static IOTHUB_CLIENT_CORE_HANDLE create_client_with_method_max_concurrency(size_t max_concurrency)
+{
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    (void)IoTHubClientCore_SetOption(iothub_handle, OPTION_METHOD_MAX_CONCURRENCY, &max_concurrency);
+    (void)IoTHubClientCore_SetDeviceMethodCallback(iothub_handle, my_DeviceMethodCallback, CALLBACK_CONTEXT);
+    (void)g_inboundDeviceCallback(TEST_METHOD_NAME, TEST_DEVICE_METHOD_RESPONSE, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, g_userContextCallback);
+
+    /*method worker threads are captured apart from the client thread, which the test runs and stops*/
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create_method_worker);
+    return iothub_handle;
+}
+
+static void set_expected_calls_queue_device_method_invocation(bool worker_starts, const void** invocation)
+{
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*this is creating a DEVICE_METHOD_INVOCATION*/
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_SLL_HANDLE, IGNORED_PTR_ARG))
+        .CaptureArgumentValue_item(invocation);
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE)); /*joining the method workers that exited*/
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*this is creating a HTTPWORKER_THREAD_INFO*/
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_SLL_HANDLE, IGNORED_PTR_ARG));
+    if (worker_starts)
+    {
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    }
+    else
+    {
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn(THREADAPI_ERROR);
+    }
+}
+
+static void set_expected_calls_device_method_invoke()
+{
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(my_DeviceMethodCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG, IGNORED_NUM_ARG, CALLBACK_CONTEXT));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_DeviceMethodResponse(TEST_IOTHUB_CLIENT_CORE_LL_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+}
+
+/* Tests_SRS_IOTHUBCLIENT_09_017: [ If `method_max_concurrency` is greater than 0, the device method shall be queued to run on a method worker thread. ]*/
+/* Tests_SRS_IOTHUBCLIENT_09_018: [ A new method worker thread shall be started only while fewer than `method_max_concurrency` are running; otherwise the invocation waits for a running worker. ]*/
+/* Tests_SRS_IOTHUBCLIENT_09_019: [ A method worker thread shall exit when no queued device method can run or when IoTHubClient_Destroy is called. ]*/
+TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_method_callback_runs_on_method_worker_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = create_client_with_method_max_concurrency(2);
+    THREAD_START_FUNC client_thread_func = g_thread_func;
+    void* client_thread_func_arg = g_thread_func_arg;
+    const void* invocation = NULL;
+    umock_c_reset_all_calls();
+
+    g_how_thread_loops = 1;
+
+    set_expected_calls_first_ScheduleWork_Thread_loop(1);
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
+    set_expected_calls_queue_device_method_invocation(true, &invocation);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+    set_expected_calls_final_ScheduleWork_Thread_loop();
+
+    // act
+    client_thread_func(client_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(g_method_worker_func);
+
+    ASSERT_IS_NOT_NULL(invocation);
+
+    // arrange
+    void* worker_thread_info = g_method_worker_func_arg;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE)).SetReturn(TEST_LIST_HANDLE);
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(TEST_LIST_HANDLE)).SetReturn(invocation);
+    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_SLL_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(TEST_LIST_HANDLE)).SetReturn(invocation);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    set_expected_calls_device_method_invoke();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(TEST_LIST_HANDLE)).SetReturn(invocation);
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_SLL_HANDLE, TEST_LIST_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free((void*)invocation));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    // act
+    g_method_worker_func(g_method_worker_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE)).SetReturn(TEST_LIST_HANDLE);
+    EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE)).SetReturn(TEST_LIST_HANDLE);
+    EXPECTED_CALL(singlylinkedlist_item_get_value(TEST_LIST_HANDLE)).SetReturn(worker_thread_info);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(TEST_LIST_HANDLE)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_09_020: [ If no method worker thread is running and starting one fails, the device method shall be invoked on the callback thread. ]*/
+TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_method_callback_method_worker_fails_runs_inline)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = create_client_with_method_max_concurrency(2);
+    THREAD_START_FUNC client_thread_func = g_thread_func;
+    void* client_thread_func_arg = g_thread_func_arg;
+    const void* invocation = NULL;
+    umock_c_reset_all_calls();
+
+    g_how_thread_loops = 1;
+
+    set_expected_calls_first_ScheduleWork_Thread_loop(1);
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
+    set_expected_calls_queue_device_method_invocation(false, &invocation);
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_SLL_HANDLE, TEST_LIST_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_SLL_HANDLE, TEST_LIST_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    set_expected_calls_device_method_invoke();
+    STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+    set_expected_calls_final_ScheduleWork_Thread_loop();
+
+    // act
+    client_thread_func(client_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(g_method_worker_func);
+
+    // cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
 /* ASYNC DEVICE METHOD */
 TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_STRING_construct_FAILS_fail)
 {
@@ -4196,14 +4811,14 @@ TEST_FUNCTION(IoTHubClient_SetInputMessageCallback_fail)
 }
 
 #ifdef USE_EDGE_MODULES
-typedef enum METHOD_INVOKE_TEST_THREAD_TAG
+typedef enum METHOD_INVOKE_TEST_JOB_LIST_TAG
 {
-    METHOD_INVOKE_TEST_MOCK_CREATE_THREAD,
-    METHOD_INVOKE_TEST_SKIP_CREATE_THREAD
-} METHOD_INVOKE_TEST_THREAD;
+    METHOD_INVOKE_TEST_CREATE_JOB_LIST,
+    METHOD_INVOKE_TEST_JOB_LIST_EXISTS
+} METHOD_INVOKE_TEST_JOB_LIST;
 
 
-static void set_expected_calls_for_IotHubClientCore_GenericMethodInvoke(METHOD_INVOKE_TEST_THREAD testThreadType, METHOD_INVOKE_TEST_TARGET testTarget)
+static void set_expected_calls_for_IotHubClientCore_GenericMethodInvoke(METHOD_INVOKE_TEST_JOB_LIST testJobList, METHOD_INVOKE_TEST_TARGET testTarget, const void** job)
 {
     current_method_invoke_test = testTarget;
 
@@ -4216,20 +4831,10 @@ static void set_expected_calls_for_IotHubClientCore_GenericMethodInvoke(METHOD_I
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_METHOD_NAME));
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_METHOD_PAYLOAD));
 
-    STRICT_EXPECTED_CALL(Lock_Init());
-
-    if (testThreadType == METHOD_INVOKE_TEST_MOCK_CREATE_THREAD)
-    {
-        EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    }
-
-    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*this is adding HTTPWORKER_THREAD_INFO to the list of HTTPWORKER_THREAD_INFO's to be cleaned*/
-    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    set_expected_calls_queue_http_job(testJobList == METHOD_INVOKE_TEST_CREATE_JOB_LIST, true, job);
 }
 
-static void set_expected_calls_For_MethodInvokeThread()
+static void set_expected_calls_For_MethodInvokeJob(const void* job)
 {
     int responseStatus = 200;
     int responseSize = 1221;
@@ -4238,7 +4843,7 @@ static void set_expected_calls_For_MethodInvokeThread()
     unsigned char* responseData = (unsigned char* )my_gballoc_malloc(1);
     ASSERT_IS_NOT_NULL(responseData, "failed allocating responseData");
 
-    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).CallCannotFail();
+    set_expected_calls_http_worker_takes_job(job);
     STRICT_EXPECTED_CALL(IoTHubClientCore_LL_GenericMethodInvoke(TEST_IOTHUB_CLIENT_CORE_LL_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG,
                                                                  IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
                             .CopyOutArgumentBuffer(7, &responseStatus, sizeof(responseStatus))
@@ -4247,20 +4852,23 @@ static void set_expected_calls_For_MethodInvokeThread()
                             ;
     STRICT_EXPECTED_CALL(test_method_invoke_callback(IOTHUB_CLIENT_OK, responseStatus, responseData, responseSize, CALLBACK_CONTEXT));
 
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*responseData*/
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*deviceId*/
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*moduleId*/
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*methodName*/
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*methodPayload*/
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*HTTPWORKER_THREAD_INFO*/
+    set_expected_calls_http_worker_exits();
 }
 
 static void IoTHubClientCore_GenericMethodInvoke_Impl(METHOD_INVOKE_TEST_TARGET testTarget)
 {
     //arrange
     IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    const void* job = NULL;
     umock_c_reset_all_calls();
 
-    set_expected_calls_for_IotHubClientCore_GenericMethodInvoke(METHOD_INVOKE_TEST_MOCK_CREATE_THREAD, testTarget);
-    set_expected_calls_For_MethodInvokeThread();
+    set_expected_calls_for_IotHubClientCore_GenericMethodInvoke(METHOD_INVOKE_TEST_CREATE_JOB_LIST, testTarget, &job);
 
     //act
     IOTHUB_CLIENT_RESULT result = IoTHubClientCore_GenericMethodInvoke(iothub_handle, TEST_DEVICE_ID,
@@ -4268,7 +4876,10 @@ static void IoTHubClientCore_GenericMethodInvoke_Impl(METHOD_INVOKE_TEST_TARGET
                                                                        TEST_METHOD_NAME,  TEST_METHOD_PAYLOAD, TEST_INVOKE_TIMEOUT,
                                                                        test_method_invoke_callback, CALLBACK_CONTEXT);
 
-    g_thread_func(g_thread_func_arg); /*this is the thread invoking module function, captured during the CreateThread mock*/
+    ASSERT_IS_NOT_NULL(job);
+    set_expected_calls_For_MethodInvokeJob(job);
+
+    g_thread_func(g_thread_func_arg); /*this is the HTTP worker, captured during the CreateThread mock*/
 
     //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
@@ -4276,17 +4887,7 @@ static void IoTHubClientCore_GenericMethodInvoke_Impl(METHOD_INVOKE_TEST_TARGET
 
     // cleanup
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
-
-    EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-
-    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
-    EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE))
-        .SetReturn(TEST_LIST_HANDLE);
-
-    setup_gargageCollection(my_malloc_items[3], true);
-    setup_IothubClient_Destroy_after_garbage_collection();
+    setup_IothubClient_Destroy_after_http_job();
 
     IoTHubClientCore_Destroy(iothub_handle);
 
@@ -4302,6 +4903,88 @@ TEST_FUNCTION(IoTHubClientCore_GenericMethodInvoke_on_Module_succeeds)
     IoTHubClientCore_GenericMethodInvoke_Impl(METHOD_INVOKE_TEST_TARGET_MODULE);
 }
 
+#ifndef DONT_USE_UPLOADTOBLOB
+/*Tests_SRS_IOTHUBCLIENT_09_037: [ An HTTP worker thread shall run the queued method invokes before the queued uploads. ]*/
+/*Tests_SRS_IOTHUBCLIENT_09_039: [ Method invokes shall be queued apart from uploads, so that they do not wait behind long uploads. ]*/
+TEST_FUNCTION(IoTHubClientCore_GenericMethodInvoke_runs_before_a_queued_upload)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    SINGLYLINKEDLIST_HANDLE invoke_job_list = (SINGLYLINKEDLIST_HANDLE)0x1120;
+    const void* upload_job = NULL;
+    const void* invoke_job = NULL;
+    void* upload_worker_arg;
+    int responseStatus = 200;
+    int responseSize = 1221;
+    unsigned char* responseData = (unsigned char*)my_gballoc_malloc(1);
+    ASSERT_IS_NOT_NULL(responseData, "failed allocating responseData");
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_SLL_HANDLE, IGNORED_PTR_ARG))
+        .CaptureArgumentValue_item(&upload_job);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClientCore_UploadToBlobAsync(iothub_handle, "someFileName.txt", (const unsigned char*)"a", 1, test_file_upload_callback, (void*)1));
+    upload_worker_arg = g_thread_func_arg;
+    umock_c_reset_all_calls();
+
+    current_method_invoke_test = METHOD_INVOKE_TEST_TARGET_MODULE;
+    STRICT_EXPECTED_CALL(singlylinkedlist_create())
+        .SetReturn(invoke_job_list);
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(invoke_job_list, IGNORED_PTR_ARG))
+        .CaptureArgumentValue_item(&invoke_job);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClientCore_GenericMethodInvoke(iothub_handle, TEST_DEVICE_ID, TEST_MODULE_ID, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_INVOKE_TIMEOUT, test_method_invoke_callback, CALLBACK_CONTEXT));
+    ASSERT_IS_NOT_NULL(upload_job);
+    ASSERT_IS_NOT_NULL(invoke_job);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(invoke_job_list)).SetReturn(TEST_LIST_HANDLE);
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(TEST_LIST_HANDLE)).SetReturn(invoke_job);
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(invoke_job_list, TEST_LIST_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_GenericMethodInvoke(TEST_IOTHUB_CLIENT_CORE_LL_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG,
+                                                                 IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+                            .CopyOutArgumentBuffer(7, &responseStatus, sizeof(responseStatus))
+                            .CopyOutArgumentBuffer(8, &responseData, sizeof(responseData))
+                            .CopyOutArgumentBuffer(9, &responseSize, sizeof(responseSize));
+    STRICT_EXPECTED_CALL(test_method_invoke_callback(IOTHUB_CLIENT_OK, responseStatus, responseData, responseSize, CALLBACK_CONTEXT));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*responseData*/
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*deviceId*/
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*moduleId*/
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*methodName*/
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*methodPayload*/
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*HTTPWORKER_THREAD_INFO*/
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(invoke_job_list));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE)).SetReturn(TEST_LIST_HANDLE);
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(TEST_LIST_HANDLE)).SetReturn(upload_job);
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_SLL_HANDLE, TEST_LIST_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_UploadToBlob(TEST_IOTHUB_CLIENT_CORE_LL_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(test_file_upload_callback(FILE_UPLOAD_OK, IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    set_expected_calls_for_freeUploadToBlobThreadInfo();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(invoke_job_list));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Wait(TEST_COND_HANDLE, IGNORED_PTR_ARG, IGNORED_NUM_ARG)); /*idle timeout*/
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(invoke_job_list));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    //act
+    g_thread_func(g_thread_func_arg); /*this is the HTTP worker started for the method invoke*/
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    g_thread_func(upload_worker_arg); /*the worker started for the upload finds no job left*/
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+#endif
+
 TEST_FUNCTION(IoTHubClientCore_GenericMethodInvoke_NULL_handle_fails)
 {
     //act
@@ -4366,12 +5049,12 @@ TEST_FUNCTION(IoTHubClientCore_GenericMethodInvoke_fail)
     int negativeTestsInitResult = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
 
-    set_expected_calls_for_IotHubClientCore_GenericMethodInvoke(METHOD_INVOKE_TEST_MOCK_CREATE_THREAD, METHOD_INVOKE_TEST_TARGET_MODULE);
+    set_expected_calls_for_IotHubClientCore_GenericMethodInvoke(METHOD_INVOKE_TEST_CREATE_JOB_LIST, METHOD_INVOKE_TEST_TARGET_MODULE, NULL);
     printf("Expected:: %s\n", umockcallrecorder_get_expected_calls(umock_c_get_call_recorder()));
     umock_c_negative_tests_snapshot();
 
     // act
-    size_t count = 7; // stop after ThreadAPI_Create() for first run
+    size_t count = 9; // stop after singlylinkedlist_add() for first run, which leaves the job list and its condition created
     for (size_t index = 0; index < count; index++)
     {
         umock_c_negative_tests_reset();
@@ -4389,8 +5072,8 @@ TEST_FUNCTION(IoTHubClientCore_GenericMethodInvoke_fail)
     }
 
     //
-    // We need to de-init and then re-init the test framework due to how IoTHubClient_LL_SetInputMessageCallback is implemented,
-    // namely its ThreadAPI_Create is not going to called after initial success.
+    // We need to de-init and then re-init the test framework due to how the HTTP job list is created,
+    // namely its singlylinkedlist_create is not going to called after initial success.
     //
     umock_c_negative_tests_deinit();
     umock_c_reset_all_calls();
@@ -4398,7 +5081,7 @@ TEST_FUNCTION(IoTHubClientCore_GenericMethodInvoke_fail)
     negativeTestsInitResult = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
 
-    set_expected_calls_for_IotHubClientCore_GenericMethodInvoke(METHOD_INVOKE_TEST_SKIP_CREATE_THREAD, METHOD_INVOKE_TEST_TARGET_MODULE);
+    set_expected_calls_for_IotHubClientCore_GenericMethodInvoke(METHOD_INVOKE_TEST_JOB_LIST_EXISTS, METHOD_INVOKE_TEST_TARGET_MODULE, NULL);
     printf("Expected:: %s\n", umockcallrecorder_get_expected_calls(umock_c_get_call_recorder()));
     umock_c_negative_tests_snapshot();
 
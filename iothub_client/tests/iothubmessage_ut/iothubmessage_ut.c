@@ -2148,6 +2148,113 @@ TEST_FUNCTION(IoTHubMessage_IsSecurityMessage_false_Succeed)
     IoTHubMessage_Destroy(h);
 }
 
+// Tests_SRS_IOTHUBMESSAGE_09_012: [If iotHubMessageHandle is NULL or priority is not a valid IOTHUB_MESSAGE_PRIORITY value, IoTHubMessage_SetPriority shall return IOTHUB_MESSAGE_INVALID_ARG.]
+TEST_FUNCTION(IoTHubMessage_SetPriority_handle_NULL_fail)
+{
+    //arrange
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetPriority(NULL, IOTHUB_MESSAGE_PRIORITY_HIGH);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGE_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+// Tests_SRS_IOTHUBMESSAGE_09_012: [If iotHubMessageHandle is NULL or priority is not a valid IOTHUB_MESSAGE_PRIORITY value, IoTHubMessage_SetPriority shall return IOTHUB_MESSAGE_INVALID_ARG.]
+TEST_FUNCTION(IoTHubMessage_SetPriority_invalid_priority_fail)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetPriority(h, (IOTHUB_MESSAGE_PRIORITY)(IOTHUB_MESSAGE_PRIORITY_HIGH + 1));
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGE_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGE_PRIORITY_NORMAL, IoTHubMessage_GetPriority(h));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+// Tests_SRS_IOTHUBMESSAGE_09_013: [IoTHubMessage_SetPriority shall store priority in the message and return IOTHUB_MESSAGE_OK.]
+// Tests_SRS_IOTHUBMESSAGE_09_015: [IoTHubMessage_GetPriority shall return the priority of the message.]
+TEST_FUNCTION(IoTHubMessage_SetPriority_Succeed)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString("a");
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetPriority(h, IOTHUB_MESSAGE_PRIORITY_HIGH);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGE_PRIORITY_HIGH, IoTHubMessage_GetPriority(h));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+// Tests_SRS_IOTHUBMESSAGE_09_014: [If iotHubMessageHandle is NULL, IoTHubMessage_GetPriority shall return IOTHUB_MESSAGE_PRIORITY_NORMAL.]
+TEST_FUNCTION(IoTHubMessage_GetPriority_handle_NULL_returns_NORMAL)
+{
+    //arrange
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_PRIORITY result = IoTHubMessage_GetPriority(NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGE_PRIORITY_NORMAL, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+TEST_FUNCTION(IoTHubMessage_GetPriority_default_is_NORMAL)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_PRIORITY result = IoTHubMessage_GetPriority(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGE_PRIORITY_NORMAL, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubMessage_Clone_Priority_Succeed)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetPriority(h, IOTHUB_MESSAGE_PRIORITY_LOW);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_HANDLE clone_msg = IoTHubMessage_Clone(h);
+    IOTHUB_MESSAGE_PRIORITY result = IoTHubMessage_GetPriority(clone_msg);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGE_PRIORITY_LOW, result);
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+    IoTHubMessage_Destroy(clone_msg);
+}
+
 END_TEST_SUITE(iothubmessage_ut)
 
 
@@ -151,6 +151,9 @@ static SINGLYLINKEDLIST_HANDLE TEST_IN_PROGRESS_LIST;
 #define TEST_CALLBACK_LIST1                               (SINGLYLINKEDLIST_HANDLE)0x4486
 #define INDEFINITE_TIME                                   ((time_t)-1)
 #define TEST_DISPOSITION_AMQP_VALUE                       (AMQP_VALUE)0x4487
+#define TEST_TICK_COUNTER_HANDLE                          (TICK_COUNTER_HANDLE)0x4488
+#define TEST_EVENT_BODY_SIZE                              128
+#define TEST_ENCODING_CACHE_HANDLE                        (MESSAGE_ENCODING_CACHE_HANDLE)0x4489
 
 static delivery_number TEST_DELIVERY_NUMBER;
 
@@ -460,10 +463,11 @@ static MESSENGER_DO_WORK_EXP_CALL_PROFILE* get_msgr_do_work_exp_call_profile(TEL
     return &g_do_work_profile;
 }
 
-static int TEST_message_create_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, BINARY_DATA* body_binary_data)
+static int TEST_message_create_uamqp_encoding_from_iothub_message_with_cache(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, MESSAGE_ENCODING_CACHE_HANDLE encoding_cache, BINARY_DATA* body_binary_data)
 {
     (void)message_batch_container;
     (void)message_handle;
+    (void)encoding_cache;
     (void)body_binary_data;
     return 0;
 }
@@ -783,6 +787,7 @@ static void set_expected_calls_for_telemetry_messenger_create(TELEMETRY_MESSENGE
     STRICT_EXPECTED_CALL(STRING_construct(config->iothub_host_fqdn)).SetReturn(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE);
     STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(TEST_WAIT_TO_SEND_LIST);
     STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(TEST_IN_PROGRESS_LIST);
+    STRICT_EXPECTED_CALL(message_encoding_cache_create());
 }
 
 static void set_expected_calls_for_attach_device_client_type_to_link(LINK_HANDLE link_handle, int amqpvalue_set_map_value_result, int link_set_attach_properties_result)
@@ -1383,8 +1388,8 @@ static void set_expected_calls_for_message_do_work_send_pending_events(SEND_PEND
 
         TEST_amqp_data.length = test_config->test_events[i].number_bytes_encoded;
 
-        STRICT_EXPECTED_CALL(message_create_uamqp_encoding_from_iothub_message(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .CopyOutArgumentBuffer(3, &TEST_amqp_data, sizeof(TEST_amqp_data)).SetReturn(message_create_uamqp_encoding_from_iothub_message_return);
+        STRICT_EXPECTED_CALL(message_create_uamqp_encoding_from_iothub_message_with_cache(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_ENCODING_CACHE_HANDLE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(4, &TEST_amqp_data, sizeof(TEST_amqp_data)).SetReturn(message_create_uamqp_encoding_from_iothub_message_return);
 
         if ((SEND_PENDING_EXPECT_ERROR_TOO_LARGE == expected_action) || (SEND_PENDING_EXPECT_CREATE_MESSAGE_FAILURE == expected_action))
         {
@@ -1530,6 +1535,7 @@ static void set_expected_calls_for_telemetry_messenger_destroy(TELEMETRY_MESSENG
     STRICT_EXPECTED_CALL(STRING_delete(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
     STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICE_ID_STRING_HANDLE));
     STRICT_EXPECTED_CALL(STRING_delete(testing_modules ? TEST_MODULE_ID_STRING_HANDLE : NULL));
+    STRICT_EXPECTED_CALL(message_encoding_cache_destroy(TEST_ENCODING_CACHE_HANDLE));
     STRICT_EXPECTED_CALL(free(messenger_handle));
 }
 
@@ -1808,6 +1814,11 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(delivery_number, int);
     REGISTER_UMOCK_ALIAS_TYPE(LIST_ACTION_FUNCTION, void*);
     REGISTER_UMOCK_ALIAS_TYPE(tickcounter_ms_t, unsigned long long);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_ENCODING_CACHE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_PRIORITY, int);
 
     REGISTER_UMOCK_VALUE_TYPE(BINARY_DATA);
     REGISTER_UMOCK_VALUE_TYPE(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO);
@@ -1818,7 +1829,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_HOOK(messagesender_send_async, TEST_messagesender_send_async);
     REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_create, TEST_messagereceiver_create);
     REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_open, TEST_messagereceiver_open);
-    REGISTER_GLOBAL_MOCK_HOOK(message_create_uamqp_encoding_from_iothub_message, TEST_message_create_uamqp_encoding_from_iothub_message);
+    REGISTER_GLOBAL_MOCK_HOOK(message_create_uamqp_encoding_from_iothub_message_with_cache, TEST_message_create_uamqp_encoding_from_iothub_message_with_cache);
     REGISTER_GLOBAL_MOCK_HOOK(message_create_IoTHubMessage_from_uamqp_message, TEST_message_create_IoTHubMessage_from_uamqp_message);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_add, TEST_singlylinkedlist_add);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_head_item, TEST_singlylinkedlist_get_head_item);
@@ -1923,6 +1934,15 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(message_add_body_amqp_data, 0);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_add_body_amqp_data, 1);
 
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_get_current_ms, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_get_current_ms, 1);
+
+    REGISTER_GLOBAL_MOCK_RETURN(message_encoding_cache_create, TEST_ENCODING_CACHE_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_encoding_cache_create, NULL);
+
     TEST_IOTHUB_MESSAGE_LIST_HANDLE = (IOTHUB_MESSAGE_LIST*)real_malloc(sizeof(IOTHUB_MESSAGE_LIST));
     ASSERT_IS_NOT_NULL(TEST_IOTHUB_MESSAGE_LIST_HANDLE);
     TEST_IOTHUB_MESSAGE_LIST_HANDLE->messageHandle = TEST_IOTHUB_MESSAGE_HANDLE;
@@ -3405,6 +3425,122 @@ TEST_FUNCTION(telemetry_messenger_set_option_EVENT_SEND_TIMEOUT_SECS)
     telemetry_messenger_destroy(handle);
 }
 
+TEST_FUNCTION(telemetry_messenger_set_option_EVENT_SEND_BATCH_LINGER_MS)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t value = 20;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(tickcounter_create());
+
+    // act
+    int result = telemetry_messenger_set_option(handle, TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_MS, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+TEST_FUNCTION(telemetry_messenger_set_option_EVENT_SEND_BATCH_LINGER_MS_tickcounter_create_fails)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t value = 20;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(tickcounter_create()).SetReturn(NULL);
+
+    // act
+    int result = telemetry_messenger_set_option(handle, TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_MS, &value);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+TEST_FUNCTION(telemetry_messenger_set_option_EVENT_SEND_BATCH_LINGER_MS_zero_does_not_create_tickcounter)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t value = 0;
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = telemetry_messenger_set_option(handle, TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_MS, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+TEST_FUNCTION(telemetry_messenger_set_option_EVENT_SEND_BATCH_MIN_BYTES)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t value = 4096;
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = telemetry_messenger_set_option(handle, TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_MIN_BYTES, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+TEST_FUNCTION(telemetry_messenger_send_async_with_batch_linger_saves_enqueue_time_and_size)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t linger_ms = 20;
+    size_t body_size = TEST_EVENT_BODY_SIZE;
+    ASSERT_ARE_EQUAL(int, 0, telemetry_messenger_set_option(handle, TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_MS, &linger_ms));
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_telemetry_messenger_send_async();
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(IOTHUBMESSAGE_BYTEARRAY);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_size(&body_size, sizeof(body_size))
+        .SetReturn(IOTHUB_MESSAGE_OK);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(IOTHUB_MESSAGE_PRIORITY_NORMAL);
+
+    // act
+    int result = telemetry_messenger_send_async(handle, TEST_IOTHUB_MESSAGE_LIST_HANDLE, TEST_on_event_send_complete, TEST_IOTHUB_CLIENT_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_169: [If name matches TELEMETRY_MESSENGER_OPTION_SAVED_OPTIONS, `value` shall be applied using OptionHandler_FeedOptions]
 TEST_FUNCTION(telemetry_messenger_set_option_SAVED_OPTIONS)
 {
@@ -3655,6 +3791,10 @@ static void set_expected_calls_for_telemetry_messenger_retrieve_options()
 
     STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, TELEMETRY_MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS, IGNORED_PTR_ARG))
         .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_MS, IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_MIN_BYTES, IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_173: [If `messenger_handle` is NULL, telemetry_messenger_retrieve_options shall fail and return NULL]
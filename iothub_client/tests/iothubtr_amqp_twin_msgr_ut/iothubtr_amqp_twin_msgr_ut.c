@@ -6,12 +6,14 @@
 #include <cstdlib>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #else
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #endif
 
 #if defined _MSC_VER
@@ -247,6 +249,17 @@ static AMQP_MESSENGER_HANDLE TEST_amqp_messenger_create(const AMQP_MESSENGER_CON
     return TEST_amqp_messenger_create_return;
 }
 
+static ON_AMQP_MESSENGER_MESSAGE_RECEIVED TEST_amqp_messenger_subscribe_for_messages_on_message_received_callback;
+static void* TEST_amqp_messenger_subscribe_for_messages_context;
+static int TEST_amqp_messenger_subscribe_for_messages(AMQP_MESSENGER_HANDLE messenger_handle, ON_AMQP_MESSENGER_MESSAGE_RECEIVED on_message_received_callback, void* context)
+{
+    (void)messenger_handle;
+    TEST_amqp_messenger_subscribe_for_messages_on_message_received_callback = on_message_received_callback;
+    TEST_amqp_messenger_subscribe_for_messages_context = context;
+
+    return 0;
+}
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -410,6 +423,30 @@ static void set_generate_unique_id_expected_calls()
     STRICT_EXPECTED_CALL(UniqueId_Generate(IGNORED_PTR_ARG, UNIQUE_ID_BUFFER_SIZE));
 }
 
+// Expected calls for an incoming TWIN message with `correlation_id`, no annotations and no body.
+static void set_on_amqp_message_received_callback_expected_calls(const char** correlation_id, char** correlation_id_copy)
+{
+    PROPERTIES_HANDLE properties = TEST_PROPERTIES_HANDLE;
+    AMQP_VALUE correlation_id_value = TEST_STRING_AMQP_VALUE;
+    annotations message_annotations = NULL;
+    MESSAGE_BODY_TYPE body_type = MESSAGE_BODY_TYPE_NONE;
+
+    STRICT_EXPECTED_CALL(amqp_messenger_destroy_disposition_info(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_get_properties(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &properties, sizeof(properties));
+    STRICT_EXPECTED_CALL(properties_get_correlation_id(TEST_PROPERTIES_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &correlation_id_value, sizeof(correlation_id_value));
+    STRICT_EXPECTED_CALL(amqpvalue_get_string(TEST_STRING_AMQP_VALUE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, correlation_id, sizeof(*correlation_id));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, *correlation_id))
+        .CopyOutArgumentBuffer(1, correlation_id_copy, sizeof(*correlation_id_copy));
+    STRICT_EXPECTED_CALL(properties_destroy(TEST_PROPERTIES_HANDLE));
+    STRICT_EXPECTED_CALL(message_get_message_annotations(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &message_annotations, sizeof(message_annotations));
+    STRICT_EXPECTED_CALL(message_get_body_type(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &body_type, sizeof(body_type));
+}
+
 static void set_generate_twin_correlation_id_expected_calls()
 {
     set_generate_unique_id_expected_calls();
@@ -502,7 +539,6 @@ static void set_process_timeouts_expected_calls(time_t current_time, size_t numb
     for (i = 0; i < number_of_expired_pending_operations; i++)
     {
         STRICT_EXPECTED_CALL(get_difftime(current_time, IGNORED_NUM_ARG)).SetReturn(10000000); // Simulate it's expired for sure.
-        STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG)); // correlation id
         STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     }
 
@@ -515,7 +551,6 @@ static void set_process_timeouts_expected_calls(time_t current_time, size_t numb
 static void set_create_twin_operation_context_expected_calls()
 {
     STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
-    set_generate_unique_id_expected_calls();
 }
 
 static void set_add_map_item_expected_calls(const char* name, const char* value)
@@ -637,7 +672,6 @@ static void set_twin_messenger_do_work_expected_calls(DOWORK_TEST_PROFILE* dwtp)
         if (dwtp->subscription_state == TWIN_SUBSCRIPTION_STATE_GET_COMPLETE_PROPERTIES)
         {
             STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG)); // creating context.
-            set_generate_unique_id_expected_calls();
             STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
             set_send_twin_operation_request_expected_calls(dwtp->current_time, TWIN_OPERATION_TYPE_GET);
         }
@@ -753,6 +787,7 @@ static void register_global_mock_hooks()
     REGISTER_GLOBAL_MOCK_HOOK(malloc, TEST_malloc);
     REGISTER_GLOBAL_MOCK_HOOK(free, TEST_free);
     REGISTER_GLOBAL_MOCK_HOOK(amqp_messenger_create, TEST_amqp_messenger_create);
+    REGISTER_GLOBAL_MOCK_HOOK(amqp_messenger_subscribe_for_messages, TEST_amqp_messenger_subscribe_for_messages);
     REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_IncRef, real_CONSTBUFFER_IncRef);
     REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_DecRef, real_CONSTBUFFER_DecRef);
     REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_GetContent, real_CONSTBUFFER_GetContent);
@@ -928,6 +963,12 @@ static void reset_test_data()
 
     memset(&TEST_amqp_messenger_create_config, 0, sizeof(TEST_amqp_messenger_create_config));
     TEST_amqp_messenger_create_return = TEST_AMQP_MESSENGER_HANDLE;
+    TEST_amqp_messenger_subscribe_for_messages_on_message_received_callback = NULL;
+    TEST_amqp_messenger_subscribe_for_messages_context = NULL;
+
+    get_twin_completed_payload = NULL;
+    get_twin_completed_size = 0;
+    get_twin_completed_context = NULL;
 
     TEST_on_report_state_complete_callback_result = TWIN_REPORT_STATE_RESULT_SUCCESS;
     TEST_on_report_state_complete_callback_reason = TWIN_REPORT_STATE_REASON_NONE;
@@ -1693,7 +1734,7 @@ TEST_FUNCTION(twin_messenger_get_twin_async_failure_checks)
     TWIN_MESSENGER_HANDLE handle = create_twin_messenger(config);
 
     umock_c_reset_all_calls();
-    set_create_twin_operation_context_expected_calls(); // 0 - 2
+    set_create_twin_operation_context_expected_calls(); // 0
     STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     set_create_amqp_message_for_twin_operation_expected_calls(TWIN_OPERATION_TYPE_GET);
@@ -1727,6 +1768,87 @@ TEST_FUNCTION(twin_messenger_get_twin_async_failure_checks)
     umock_c_negative_tests_deinit();
 }
 
+// Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_117: [Each TWIN operation shall be given the next non-zero value of a per-messenger counter as id, and its correlation-id shall be that id formatted once as a decimal string]
+TEST_FUNCTION(twin_messenger_get_twin_async_sequential_correlation_ids_success)
+{
+    // arrange
+    TWIN_MESSENGER_CONFIG* config = get_twin_messenger_config();
+    TWIN_MESSENGER_HANDLE handle = create_twin_messenger(config);
+
+    umock_c_reset_all_calls();
+    (void)twin_messenger_get_twin_async(handle, on_twin_get_completed_callback, (void*)0x4567);
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "amqpvalue_create_string(\"1\")"));
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = twin_messenger_get_twin_async(handle, on_twin_get_completed_callback, (void*)0x4567);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "amqpvalue_create_string(\"2\")"));
+
+    // cleanup
+    twin_messenger_destroy(handle);
+}
+
+static void test_incoming_message_does_not_match_get_twin_request(const char* correlation_id)
+{
+    // arrange
+    TWIN_MESSENGER_CONFIG* config = get_twin_messenger_config();
+    TWIN_MESSENGER_HANDLE handle = create_twin_messenger(config);
+    ASSERT_IS_NOT_NULL(TEST_amqp_messenger_subscribe_for_messages_on_message_received_callback);
+
+    // The outstanding GET request gets correlation-id "1".
+    umock_c_reset_all_calls();
+    ASSERT_ARE_EQUAL(int, 0, twin_messenger_get_twin_async(handle, on_twin_get_completed_callback, (void*)0x4567));
+
+    char correlation_id_buffer[32];
+    char* correlation_id_copy = correlation_id_buffer;
+    (void)strcpy(correlation_id_buffer, correlation_id);
+
+    umock_c_reset_all_calls();
+    set_on_amqp_message_received_callback_expected_calls(&correlation_id, &correlation_id_copy);
+    STRICT_EXPECTED_CALL(free(correlation_id_copy));
+
+    // act
+    AMQP_MESSENGER_DISPOSITION_RESULT result = TEST_amqp_messenger_subscribe_for_messages_on_message_received_callback(
+        TEST_MESSAGE_HANDLE, (AMQP_MESSENGER_MESSAGE_DISPOSITION_INFO*)0x4568, TEST_amqp_messenger_subscribe_for_messages_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, AMQP_MESSENGER_DISPOSITION_RESULT_ACCEPTED, result);
+    ASSERT_IS_NULL(get_twin_completed_context);
+
+    // cleanup
+    twin_messenger_destroy(handle);
+}
+
+// Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_119: [If the correlation-id is not a decimal number or no outstanding operation has it, the incoming message shall not be matched to any TWIN request]
+TEST_FUNCTION(twin_msgr_on_amqp_message_received_unknown_correlation_id)
+{
+    test_incoming_message_does_not_match_get_twin_request("2");
+}
+
+// Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_119: [If the correlation-id is not a decimal number or no outstanding operation has it, the incoming message shall not be matched to any TWIN request]
+TEST_FUNCTION(twin_msgr_on_amqp_message_received_non_numeric_correlation_id)
+{
+    test_incoming_message_does_not_match_get_twin_request("twin:1");
+}
+
+// Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_119: [If the correlation-id is not a decimal number or no outstanding operation has it, the incoming message shall not be matched to any TWIN request]
+TEST_FUNCTION(twin_msgr_on_amqp_message_received_correlation_id_with_trailing_characters)
+{
+    test_incoming_message_does_not_match_get_twin_request("1abc");
+}
+
+// Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_119: [If the correlation-id is not a decimal number or no outstanding operation has it, the incoming message shall not be matched to any TWIN request]
+TEST_FUNCTION(twin_msgr_on_amqp_message_received_out_of_range_correlation_id)
+{
+    // UINT32_MAX + 2 would alias the outstanding id 1 if it were truncated to 32 bits.
+    test_incoming_message_does_not_match_get_twin_request("4294967297");
+}
+
 // Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_083: [twin_messenger_do_work() shall invoke amqp_messenger_do_work() passing `twin_msgr->amqp_msgr`]
 TEST_FUNCTION(twin_msgr_do_work_not_started_success)
 {
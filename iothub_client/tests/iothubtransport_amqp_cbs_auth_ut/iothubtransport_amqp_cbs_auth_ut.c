@@ -24,6 +24,11 @@ void* real_malloc(size_t size)
     return malloc(size);
 }
 
+void* real_calloc(size_t nmemb, size_t size)
+{
+    return calloc(nmemb, size);
+}
+
 void real_free(void* ptr)
 {
     free(ptr);
@@ -59,6 +64,7 @@ static int real_strcmp(const char* str1, const char* str2)
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "umock_c/umock_c_prod.h"
 #include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "internal/iothub_client_authorization.h"
 #undef ENABLE_MOCKS
@@ -108,6 +114,7 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define SAS_TOKEN_TYPE                                    "servicebus.windows.net:sastoken"
 #define TEST_OPTIONHANDLER_HANDLE                         (OPTIONHANDLER_HANDLE)0x4455
 #define TEST_AUTHORIZATION_MODULE_HANDLE                  (IOTHUB_AUTHORIZATION_HANDLE)0x4456
+#define TEST_TICK_COUNTER_HANDLE                          (TICK_COUNTER_HANDLE)0x4457
 
 
 static AUTHENTICATION_CONFIG global_auth_config;
@@ -124,6 +131,11 @@ static void* TEST_malloc(size_t size)
     return saved_malloc_returns[saved_malloc_returns_count++];
 }
 
+static void* TEST_calloc(size_t nmemb, size_t size)
+{
+    return real_calloc(nmemb, size);
+}
+
 static void TEST_free(void* ptr)
 {
     int i, j;
@@ -173,6 +185,28 @@ static char* TEST_IoTHubClient_Auth_Get_SasToken(IOTHUB_AUTHORIZATION_HANDLE han
     return result;
 }
 
+static int TEST_IoTHubClient_Auth_Get_SasToken_Batch(IOTHUB_SAS_TOKEN_REQUEST* requests, size_t request_count)
+{
+    size_t index;
+
+    for (index = 0; index < request_count; index++)
+    {
+        requests[index].sas_token = (char*)real_malloc(strlen(TEST_GENERATED_SAS_TOKEN) + 1);
+        strcpy(requests[index].sas_token, TEST_GENERATED_SAS_TOKEN);
+    }
+
+    return 0;
+}
+
+static tickcounter_ms_t TEST_tickcounter_current_ms;
+
+static int TEST_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = TEST_tickcounter_current_ms;
+    return 0;
+}
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -235,14 +269,19 @@ static void register_umock_alias_types()
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_AUTHORIZATION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(SAS_TOKEN_STATUS, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CREDENTIAL_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_SAS_TOKEN_REQUEST*, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
 }
 
 static void register_global_mock_hooks()
 {
     REGISTER_GLOBAL_MOCK_HOOK(malloc, TEST_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(calloc, TEST_calloc);
     REGISTER_GLOBAL_MOCK_HOOK(free, TEST_free);
     REGISTER_GLOBAL_MOCK_HOOK(cbs_put_token_async, TEST_cbs_put_token_async);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_Auth_Get_SasToken, TEST_IoTHubClient_Auth_Get_SasToken);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_Auth_Get_SasToken_Batch, TEST_IoTHubClient_Auth_Get_SasToken_Batch);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, TEST_tickcounter_get_current_ms);
 }
 
 static void register_global_mock_returns()
@@ -1390,6 +1429,332 @@ TEST_FUNCTION(authentication_do_work_DEVICE_KEYS_sas_token_refresh)
     authentication_destroy(handle);
 }
 
+static AUTHENTICATION_HANDLE create_and_authenticate_with_refresh_scheduler(AUTHENTICATION_REFRESH_SCHEDULER* scheduler, time_t current_time)
+{
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    config->refresh_scheduler = scheduler;
+
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config, false);
+
+    AUTHENTICATION_DO_WORK_EXPECTED_STATE *exp_state = get_do_work_expected_state_struct();
+    exp_state->current_state = AUTHENTICATION_STATE_STARTING;
+    exp_state->sas_token_to_use = TEST_PRIMARY_DEVICE_KEY_STRING_HANDLE;
+
+    crank_authentication_do_work(config, handle, current_time, exp_state, IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    saved_cbs_put_token_on_operation_complete(saved_cbs_put_token_context, CBS_OPERATION_RESULT_OK, 0, "all good");
+
+    return handle;
+}
+
+static void set_expected_calls_for_sas_token_refresh_check(time_t current_time, time_t put_time, double elapsed_secs)
+{
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(IGNORED_PTR_ARG)).SetReturn(IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_SasToken_Expiry(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+    STRICT_EXPECTED_CALL(get_difftime(current_time, put_time)).SetReturn(elapsed_secs);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_129: [authentication_create() shall save `config->refresh_scheduler` into `instance->refresh_scheduler`, and a hash of the device and module ids used to stagger the SAS token refreshes]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_133: [If `instance->refresh_scheduler->refresh_spread_secs` is not zero, the SAS token refresh shall be brought forward by the device hash modulo (`refresh_spread_secs` + 1) seconds]
+TEST_FUNCTION(authentication_do_work_sas_token_refresh_brought_forward_by_spread)
+{
+    // arrange
+    AUTHENTICATION_REFRESH_SCHEDULER scheduler;
+    memset(&scheduler, 0, sizeof(AUTHENTICATION_REFRESH_SCHEDULER));
+    scheduler.refresh_spread_secs = 100; // Offset of TEST_DEVICE_ID is 49 secs; refresh is due at 2880 - 49 secs.
+
+    time_t current_time = time(NULL);
+    time_t next_time = add_seconds(current_time, 2840);
+    ASSERT_IS_TRUE(INDEFINITE_TIME != next_time, "failed to computer 'next_time'");
+
+    AUTHENTICATION_HANDLE handle = create_and_authenticate_with_refresh_scheduler(&scheduler, current_time);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_sas_token_refresh_check(next_time, current_time, 2840);
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
+    set_expected_calls_for_put_SAS_token_to_cbs(handle, next_time, TEST_GENERATED_SAS_TOKEN_STRING_HANDLE);
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICES_PATH_STRING_HANDLE));
+
+    // act
+    authentication_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, scheduler.refreshes_in_progress);
+
+    // cleanup
+    authentication_destroy(handle);
+    ASSERT_ARE_EQUAL(size_t, 0, scheduler.refreshes_in_progress);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_130: [If `instance->refresh_scheduler` already has `max_concurrent_refreshes` SAS token refreshes in progress, the refresh shall be postponed to a later authentication_do_work() call]
+TEST_FUNCTION(authentication_do_work_sas_token_refresh_deferred_at_max_concurrent_refreshes)
+{
+    // arrange
+    AUTHENTICATION_REFRESH_SCHEDULER scheduler;
+    memset(&scheduler, 0, sizeof(AUTHENTICATION_REFRESH_SCHEDULER));
+    scheduler.max_concurrent_refreshes = 1;
+
+    time_t current_time = time(NULL);
+    time_t next_time = add_seconds(current_time, 2900);
+    ASSERT_IS_TRUE(INDEFINITE_TIME != next_time, "failed to computer 'next_time'");
+
+    AUTHENTICATION_HANDLE handle = create_and_authenticate_with_refresh_scheduler(&scheduler, current_time);
+    scheduler.refreshes_in_progress = 1; // Refresh of another device.
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_sas_token_refresh_check(next_time, current_time, 2900);
+
+    // act
+    authentication_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, scheduler.refreshes_in_progress);
+    ASSERT_ARE_EQUAL(size_t, 1, scheduler.metrics.refresh_deferred_count);
+    ASSERT_ARE_EQUAL(int, AUTHENTICATION_STATE_STARTED, saved_on_state_changed_callback_new_state);
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_132: [If a SAS token refresh slot is held, it shall be released and the refresh result and latency recorded in `instance->refresh_scheduler->metrics`, the latency in milliseconds since the put-token request as read with tickcounter_get_current_ms()]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_142: [If a SAS token refresh slot is held and `instance->refresh_scheduler->tick_counter` is not NULL, the time of the put-token request shall be read with tickcounter_get_current_ms() to measure the refresh latency]
+TEST_FUNCTION(authentication_sas_token_refresh_complete_records_metrics)
+{
+    // arrange
+    AUTHENTICATION_REFRESH_SCHEDULER scheduler;
+    memset(&scheduler, 0, sizeof(AUTHENTICATION_REFRESH_SCHEDULER));
+    scheduler.max_concurrent_refreshes = 1;
+    scheduler.tick_counter = TEST_TICK_COUNTER_HANDLE;
+
+    time_t current_time = time(NULL);
+    time_t next_time = add_seconds(current_time, 2900);
+    ASSERT_IS_TRUE(INDEFINITE_TIME != next_time, "failed to computer 'next_time'");
+
+    AUTHENTICATION_HANDLE handle = create_and_authenticate_with_refresh_scheduler(&scheduler, current_time);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_sas_token_refresh_check(next_time, current_time, 2900);
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
+    set_expected_calls_for_put_SAS_token_to_cbs(handle, next_time, TEST_GENERATED_SAS_TOKEN_STRING_HANDLE);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICES_PATH_STRING_HANDLE));
+    TEST_tickcounter_current_ms = 10000;
+    authentication_do_work(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    TEST_tickcounter_current_ms = 10250;
+
+    // act
+    saved_cbs_put_token_on_operation_complete(saved_cbs_put_token_context, CBS_OPERATION_RESULT_OK, 0, "all good");
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, scheduler.refreshes_in_progress);
+    ASSERT_ARE_EQUAL(size_t, 1, scheduler.metrics.refresh_count);
+    ASSERT_ARE_EQUAL(size_t, 0, scheduler.metrics.refresh_failure_count);
+    ASSERT_ARE_EQUAL(uint64_t, 250, scheduler.metrics.last_refresh_latency_ms);
+    ASSERT_ARE_EQUAL(uint64_t, 250, scheduler.metrics.max_refresh_latency_ms);
+    ASSERT_ARE_EQUAL(uint64_t, 250, scheduler.metrics.total_refresh_latency_ms);
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+static AUTHENTICATION_HANDLE create_and_queue_with_batch_signing(AUTHENTICATION_REFRESH_SCHEDULER* scheduler)
+{
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    config->refresh_scheduler = scheduler;
+    scheduler->batch_sas_token_signing = true;
+
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config, false);
+
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(TEST_AUTHORIZATION_MODULE_HANDLE)).SetReturn(IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    authentication_do_work(handle);
+    umock_c_reset_all_calls();
+
+    return handle;
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_134: [If `instance->refresh_scheduler->batch_sas_token_signing` is TRUE and device keys are used, authentication_do_work() shall queue `instance` on `instance->refresh_scheduler->pending_sas_tokens` instead of creating the SAS token]
+TEST_FUNCTION(authentication_do_work_batch_signing_queues_sas_token)
+{
+    // arrange
+    AUTHENTICATION_REFRESH_SCHEDULER scheduler;
+    memset(&scheduler, 0, sizeof(AUTHENTICATION_REFRESH_SCHEDULER));
+    scheduler.batch_sas_token_signing = true;
+
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    config->refresh_scheduler = &scheduler;
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config, false);
+
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(TEST_AUTHORIZATION_MODULE_HANDLE)).SetReturn(IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+
+    // act
+    authentication_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, (void*)handle, (void*)scheduler.pending_sas_tokens);
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_135: [If `instance` is waiting for authentication_sign_pending_sas_tokens() to sign its SAS token, authentication_do_work() shall return]
+TEST_FUNCTION(authentication_do_work_batch_signing_pending_sas_token_no_op)
+{
+    // arrange
+    AUTHENTICATION_REFRESH_SCHEDULER scheduler;
+    memset(&scheduler, 0, sizeof(AUTHENTICATION_REFRESH_SCHEDULER));
+    AUTHENTICATION_HANDLE handle = create_and_queue_with_batch_signing(&scheduler);
+
+    // act
+    authentication_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, (void*)handle, (void*)scheduler.pending_sas_tokens);
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_136: [If `instance` is waiting for its SAS token to be signed, it shall be removed from `instance->refresh_scheduler->pending_sas_tokens`]
+TEST_FUNCTION(authentication_stop_removes_pending_sas_token)
+{
+    // arrange
+    AUTHENTICATION_REFRESH_SCHEDULER scheduler;
+    memset(&scheduler, 0, sizeof(AUTHENTICATION_REFRESH_SCHEDULER));
+    AUTHENTICATION_HANDLE handle = create_and_queue_with_batch_signing(&scheduler);
+
+    // act
+    int result = authentication_stop(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_NULL(scheduler.pending_sas_tokens);
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_137: [If `refresh_scheduler` is NULL, authentication_sign_pending_sas_tokens() shall return]
+TEST_FUNCTION(authentication_sign_pending_sas_tokens_NULL_refresh_scheduler)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    authentication_sign_pending_sas_tokens(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_138: [authentication_sign_pending_sas_tokens() shall create the `devices_and_modules_path` of each pending instance and sign all their SAS tokens with a single call to IoTHubClient_Auth_Get_SasToken_Batch]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_139: [Each SAS token shall be put to CBS as in authentication_do_work()]
+TEST_FUNCTION(authentication_sign_pending_sas_tokens_succeeds)
+{
+    // arrange
+    AUTHENTICATION_REFRESH_SCHEDULER scheduler;
+    memset(&scheduler, 0, sizeof(AUTHENTICATION_REFRESH_SCHEDULER));
+    AUTHENTICATION_HANDLE handle = create_and_queue_with_batch_signing(&scheduler);
+    time_t current_time = time(NULL);
+
+    STRICT_EXPECTED_CALL(calloc(1, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(calloc(1, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICES_PATH_STRING_HANDLE)).SetReturn(TEST_DEVICES_PATH);
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_SasToken_Batch(IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICES_PATH_STRING_HANDLE)).SetReturn(TEST_DEVICES_PATH);
+    STRICT_EXPECTED_CALL(cbs_put_token_async(TEST_CBS_HANDLE, SAS_TOKEN_TYPE, TEST_DEVICES_PATH, TEST_GENERATED_SAS_TOKEN, IGNORED_PTR_ARG, handle));
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICES_PATH_STRING_HANDLE));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    // act
+    authentication_sign_pending_sas_tokens(&scheduler);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(scheduler.pending_sas_tokens);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)handle, saved_cbs_put_token_context);
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_140: [If a SAS token cannot be created or put to CBS, `instance->state` shall be updated to AUTHENTICATION_STATE_ERROR and `instance->on_error_callback` invoked as in authentication_do_work()]
+TEST_FUNCTION(authentication_sign_pending_sas_tokens_cbs_put_token_fails)
+{
+    // arrange
+    AUTHENTICATION_REFRESH_SCHEDULER scheduler;
+    memset(&scheduler, 0, sizeof(AUTHENTICATION_REFRESH_SCHEDULER));
+    AUTHENTICATION_HANDLE handle = create_and_queue_with_batch_signing(&scheduler);
+    TEST_cbs_put_token_async_return = 1;
+
+    STRICT_EXPECTED_CALL(calloc(1, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(calloc(1, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICES_PATH_STRING_HANDLE)).SetReturn(TEST_DEVICES_PATH);
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_SasToken_Batch(IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICES_PATH_STRING_HANDLE)).SetReturn(TEST_DEVICES_PATH);
+    STRICT_EXPECTED_CALL(cbs_put_token_async(TEST_CBS_HANDLE, SAS_TOKEN_TYPE, TEST_DEVICES_PATH, TEST_GENERATED_SAS_TOKEN, IGNORED_PTR_ARG, handle));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICES_PATH_STRING_HANDLE));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    // act
+    authentication_sign_pending_sas_tokens(&scheduler);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, AUTHENTICATION_STATE_ERROR, saved_on_state_changed_callback_new_state);
+    ASSERT_ARE_EQUAL(int, AUTHENTICATION_ERROR_AUTH_FAILED, saved_on_error_callback_error_code);
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_141: [If the batch cannot be allocated, each pending SAS token shall be created and put to CBS as in authentication_do_work()]
+TEST_FUNCTION(authentication_sign_pending_sas_tokens_calloc_fails_puts_tokens_one_by_one)
+{
+    // arrange
+    AUTHENTICATION_REFRESH_SCHEDULER scheduler;
+    memset(&scheduler, 0, sizeof(AUTHENTICATION_REFRESH_SCHEDULER));
+    AUTHENTICATION_HANDLE handle = create_and_queue_with_batch_signing(&scheduler);
+    time_t current_time = time(NULL);
+
+    STRICT_EXPECTED_CALL(calloc(1, IGNORED_NUM_ARG)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(calloc(1, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
+    set_expected_calls_for_put_SAS_token_to_cbs(handle, current_time, TEST_GENERATED_SAS_TOKEN_STRING_HANDLE);
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICES_PATH_STRING_HANDLE));
+    STRICT_EXPECTED_CALL(free(NULL));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    // act
+    authentication_sign_pending_sas_tokens(&scheduler);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(scheduler.pending_sas_tokens);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)handle, saved_cbs_put_token_context);
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_021: [authentication_create() shall set `instance->cbs_request_timeout_secs` with the default value of UINT32_MAX]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_038: [If `instance->is_cbs_put_token_in_progress` is TRUE, authentication_do_work() shall only verify the authentication timeout]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_043: [authentication_do_work() shall set `instance->is_cbs_put_token_in_progress` to TRUE]
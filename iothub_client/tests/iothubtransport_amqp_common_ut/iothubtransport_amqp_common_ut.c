@@ -112,6 +112,7 @@ extern "C"
 #include "internal/iothubtransportamqp_methods.h"
 #include "internal/iothubtransport_amqp_connection.h"
 #include "internal/iothubtransport_amqp_device.h"
+#include "internal/iothubtransport_amqp_cbs_auth.h"
 
 #include "internal/iothub_transport_ll_private.h"
 
@@ -215,13 +216,6 @@ extern "C"
         return item_found == 1 ? 0 : 1;
     }
 
-    static LIST_ITEM_HANDLE TEST_singlylinkedlist_find(SINGLYLINKEDLIST_HANDLE list, LIST_MATCH_FUNCTION match_function, const void* match_context)
-    {
-        (void)list;
-        (void)match_function;
-        return (LIST_ITEM_HANDLE)match_context;
-    }
-
     static SINGLYLINKEDLIST_HANDLE TEST_singlylinkedlist_foreach_list;
     static LIST_ACTION_FUNCTION TEST_singlylinkedlist_foreach_action_function;
     static const void* TEST_singlylinkedlist_foreach_context;
@@ -370,6 +364,9 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 
 #define INDEFINITE_TIME                            ((time_t)-1)
 #define TEST_DEVICE_ID_CHAR_PTR                    "deviceid"
+#define TEST_MODULE_ID_CHAR_PTR                    "moduleid"
+#define TEST_MODULE_ID_2_CHAR_PTR                  "moduleid2"
+#define TEST_UNREGISTERED_DEVICE_ID_CHAR_PTR       "unregistereddeviceid"
 #define TEST_PRODUCT_INFO_CHAR_PTR                 "product info"
 #define TEST_DEVICE_ID_2_CHAR_PTR                  "deviceid2"
 #define TEST_DEVICE_KEY                            "devicekey"
@@ -422,6 +419,7 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define TEST_X509_PRIVATE_KEY                      "Raphael Rabello"
 #define TEST_MESSAGE_SOURCE_CHAR_PTR               "messagereceiver_link_name"
 #define TEST_RETRY_CONTROL_HANDLE                  (RETRY_CONTROL_HANDLE)0x4276
+#define TEST_TICK_COUNTER_HANDLE                   (TICK_COUNTER_HANDLE)0x4277
 
 static TRANSPORT_CALLBACKS_INFO transport_cb_info;
 static void* transport_cb_ctx = (void*)0x499922;
@@ -460,6 +458,8 @@ static void set_expected_calls_for_Create(IOTHUBTRANSPORT_CONFIG* transport_conf
 
     STRICT_EXPECTED_CALL(singlylinkedlist_create())
         .SetReturn(TEST_REGISTERED_DEVICES_LIST);
+    EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_create());
 }
 
 static void set_expected_calls_for_GetSendStatus(bool is_waiting_to_send_list_empty, DEVICE_SEND_STATUS send_status)
@@ -487,12 +487,11 @@ static void set_expected_calls_for_GetHostname()
     STRICT_EXPECTED_CALL(STRING_clone(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE)).SetReturn(TEST_IOTHUB_HOST_FQDN_CLONE_STRING_HANDLE);
 }
 
-static void set_expected_calls_for_is_device_registered_ex(IOTHUB_DEVICE_CONFIG* device_config, IOTHUB_DEVICE_HANDLE registered_device)
+static void set_expected_calls_for_find_device_in_index()
 {
-    (void)device_config;
-
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .SetReturn((LIST_ITEM_HANDLE)registered_device).CallCannotFail();
+    // The registered device with the same id hash has its id compared.
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
+        .SetReturn(TEST_DEVICE_ID_CHAR_PTR).CallCannotFail();
 }
 
 static MESSAGE_DISPOSITION_CONTEXT* TRANSPORT_CONTEXT_DATA_create2(IOTHUB_DEVICE_HANDLE device_handle)
@@ -559,15 +558,19 @@ static void set_expected_calls_for_SendMessageDisposition(IOTHUBMESSAGE_DISPOSIT
 //     or NULL if the intent is to return "not registered".
 static void set_expected_calls_for_is_device_registered(IOTHUB_DEVICE_CONFIG* device_config, IOTHUB_DEVICE_HANDLE registered_device)
 {
+    (void)device_config;
+
+    // An id other than the registered one makes the device index lookup fail.
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
-        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
+        .SetReturn(registered_device != NULL ? TEST_DEVICE_ID_CHAR_PTR : TEST_UNREGISTERED_DEVICE_ID_CHAR_PTR);
 
-    set_expected_calls_for_is_device_registered_ex(device_config, registered_device);
+    set_expected_calls_for_find_device_in_index();
 }
 
 static void set_expected_calls_for_Register(IOTHUB_DEVICE_CONFIG* device_config, bool is_using_cbs)
 {
-    set_expected_calls_for_is_device_registered_ex(device_config, NULL);
+    // find_device_in_index
+    // Nothing to expect (no device with the same id hash is registered).
 
     // is_device_credential_acceptable
     // Nothing to expect.
@@ -575,6 +578,12 @@ static void set_expected_calls_for_Register(IOTHUB_DEVICE_CONFIG* device_config,
     EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(STRING_construct(device_config->deviceId))
         .SetReturn(TEST_DEVICE_ID_STRING_HANDLE);
+
+    if (device_config->moduleId != NULL)
+    {
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, device_config->moduleId));
+    }
+
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE))
         .SetReturn(TEST_IOTHUB_HOST_FQDN_CHAR_PTR).CallCannotFail();
     EXPECTED_CALL(amqp_device_create(IGNORED_PTR_ARG));
@@ -582,7 +591,7 @@ static void set_expected_calls_for_Register(IOTHUB_DEVICE_CONFIG* device_config,
         .SetReturn(NULL).CallCannotFail();
 
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE)).SetReturn(TEST_IOTHUB_HOST_FQDN_CHAR_PTR).CallCannotFail();
-    EXPECTED_CALL(iothubtransportamqp_methods_create(TEST_IOTHUB_HOST_FQDN_CHAR_PTR, device_config->deviceId, NULL));
+    EXPECTED_CALL(iothubtransportamqp_methods_create(TEST_IOTHUB_HOST_FQDN_CHAR_PTR, device_config->deviceId, device_config->moduleId));
 
     // replicate_device_options_to
     STRICT_EXPECTED_CALL(amqp_device_set_option(TEST_DEVICE_HANDLE, DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS, IGNORED_PTR_ARG));
@@ -600,13 +609,9 @@ static void set_expected_calls_for_Unregister(IOTHUB_DEVICE_HANDLE iothub_device
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
         .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .SetReturn((LIST_ITEM_HANDLE)iothub_device_handle);
+    set_expected_calls_for_find_device_in_index();
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG))
-        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_REGISTERED_DEVICES_LIST, (LIST_ITEM_HANDLE)iothub_device_handle));
 
     STRICT_EXPECTED_CALL(iothubtransportamqp_methods_destroy(TEST_IOTHUBTRANSPORTAMQP_METHODS));
 
@@ -772,6 +777,8 @@ static void set_expected_calls_for_Destroy(int number_of_registered_devices, IOT
     STRICT_EXPECTED_CALL(xio_destroy(TEST_UNDERLYING_IO_TRANSPORT));
     STRICT_EXPECTED_CALL(retry_control_destroy(TEST_RETRY_CONTROL_HANDLE));
     STRICT_EXPECTED_CALL(STRING_delete(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+    EXPECTED_CALL(free(IGNORED_PTR_ARG));
     EXPECTED_CALL(free(IGNORED_PTR_ARG));
 }
 
@@ -859,6 +866,9 @@ static ON_AMQP_CONNECTION_STATE_CHANGED TEST_amqp_connection_create_saved_on_sta
 static const void* TEST_amqp_connection_create_saved_on_state_changed_context;
 static size_t TEST_amqp_connection_create_saved_c2d_keep_alive_freq_secs;
 static double TEST_amqp_connection_create_saved_cl2svc_keep_alive_send_ratio;
+static size_t TEST_amqp_connection_create_saved_session_count;
+static uint32_t TEST_amqp_connection_create_saved_session_incoming_window;
+static uint32_t TEST_amqp_connection_create_saved_session_outgoing_window;
 static AMQP_CONNECTION_HANDLE TEST_amqp_connection_create_return;
 static AMQP_CONNECTION_HANDLE TEST_amqp_connection_create(AMQP_CONNECTION_CONFIG* config)
 {
@@ -868,6 +878,9 @@ static AMQP_CONNECTION_HANDLE TEST_amqp_connection_create(AMQP_CONNECTION_CONFIG
     TEST_amqp_connection_create_saved_on_state_changed_context = config->on_state_changed_context;
     TEST_amqp_connection_create_saved_c2d_keep_alive_freq_secs = config->svc2cl_keep_alive_timeout_secs;
     TEST_amqp_connection_create_saved_cl2svc_keep_alive_send_ratio = config->cl2svc_keep_alive_send_ratio;
+    TEST_amqp_connection_create_saved_session_count = config->session_count;
+    TEST_amqp_connection_create_saved_session_incoming_window = config->session_incoming_window;
+    TEST_amqp_connection_create_saved_session_outgoing_window = config->session_outgoing_window;
 
     return TEST_amqp_connection_create_return;
 }
@@ -1084,6 +1097,7 @@ static void register_umock_alias_types()
     REGISTER_UMOCK_ALIAS_TYPE(AMQP_VALUE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(CBS_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AUTHENTICATION_REFRESH_SCHEDULER*, void*);
     REGISTER_UMOCK_ALIAS_TYPE(CONNECTION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(AMQP_DEVICE_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(DEVICE_MESSAGE_DISPOSITION_RESULT, int);
@@ -1117,6 +1131,7 @@ static void register_umock_alias_types()
     REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
     REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, void*);
     REGISTER_UMOCK_ALIAS_TYPE(RETRY_CONTROL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(SESSION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
@@ -1144,7 +1159,6 @@ static void register_global_mock_hooks()
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_remove, TEST_singlylinkedlist_remove);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_head_item, TEST_singlylinkedlist_get_head_item);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_next_item, TEST_singlylinkedlist_get_next_item);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_find, TEST_singlylinkedlist_find);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_foreach, TEST_singlylinkedlist_foreach);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_item_get_value, TEST_singlylinkedlist_item_get_value);
 
@@ -1217,6 +1231,9 @@ static void register_global_mock_returns()
     REGISTER_GLOBAL_MOCK_RETURN(retry_control_create, TEST_RETRY_CONTROL_HANDLE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(retry_control_create, NULL);
 
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+
     REGISTER_GLOBAL_MOCK_RETURN(retry_control_set_option, 0);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(retry_control_set_option, 1);
 }
@@ -2016,6 +2033,8 @@ TEST_FUNCTION(GetHostName_success)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_010: [`get_io_transport` shall be saved on `instance->underlying_io_transport_provider`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_012: [If IoTHubTransport_AMQP_Common_Create succeeds it shall return a pointer to `instance`.]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_124: [`instance->connection_retry_control` shall be set using retry_control_create(), passing defaults EXPONENTIAL_BACKOFF_WITH_JITTER and 0]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_160: [`instance->device_index_buckets` shall be allocated with DEVICE_INDEX_INITIAL_BUCKET_COUNT empty buckets]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_181: [`instance->sas_token_refresh_scheduler.tick_counter` shall be set using tickcounter_create()]
 TEST_FUNCTION(Create_success)
 {
     // arrange
@@ -2061,7 +2080,9 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_Create_callbacks_NULL_fail)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_007: [If `instance->iothub_target_fqdn` fails to be set, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_009: [If singlylinkedlist_create() fails, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_011: [If IoTHubTransport_AMQP_Common_Create fails it shall free any memory it allocated]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_161: [If the device index fails to be allocated, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_125: [If retry_control_create() fails, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_182: [If tickcounter_create() fails, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
 TEST_FUNCTION(Create_failure_checks)
 {
     // arrange
@@ -2217,10 +2238,73 @@ TEST_FUNCTION(Register_device_already_registered)
     TRANSPORT_LL_HANDLE handle = create_transport();
 
     IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle1 = register_device(handle, device_config, &TEST_waitingToSend, true);
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config->deviceId))
-        .IgnoreArgument(2)
-        .SetReturn(TEST_LIST_ITEM_HANDLE);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
+        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
+
+    // act
+    IOTHUB_DEVICE_HANDLE device_handle2 = IoTHubTransport_AMQP_Common_Register(handle, device_config, &TEST_waitingToSend);
+
+    // assert
+    ASSERT_IS_NOT_NULL(device_handle1);
+    ASSERT_IS_NULL(device_handle2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle1, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_183: [A device is considered already registered only if both its `deviceId` and `moduleId` match a registered device.]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_184: [If `config->moduleId` is not NULL, a copy of it shall be saved into `device_state->module_id`]
+TEST_FUNCTION(Register_two_modules_of_same_device_succeeds)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    device_config->moduleId = TEST_MODULE_ID_CHAR_PTR;
+    IOTHUB_DEVICE_HANDLE device_handle1 = register_device(handle, device_config, &TEST_waitingToSend, true);
+
+    device_config->moduleId = TEST_MODULE_ID_2_CHAR_PTR;
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_Register(device_config, true);
+
+    // act
+    IOTHUB_DEVICE_HANDLE device_handle2 = IoTHubTransport_AMQP_Common_Register(handle, device_config, &TEST_waitingToSend);
+
+    // assert
+    ASSERT_IS_NOT_NULL(device_handle1);
+    ASSERT_IS_NOT_NULL(device_handle2);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, device_handle1, device_handle2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    device_config->moduleId = NULL;
+    destroy_transport(handle, device_handle1, device_handle2);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_185: [If mallocAndStrcpy_s() fails, IoTHubTransport_AMQP_Common_Register shall fail and return NULL]
+TEST_FUNCTION(Register_module_id_copy_fails)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    device_config->moduleId = TEST_MODULE_ID_CHAR_PTR;
+
+    umock_c_reset_all_calls();
+    EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(STRING_construct(device_config->deviceId))
+        .SetReturn(TEST_DEVICE_ID_STRING_HANDLE);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MODULE_ID_CHAR_PTR))
+        .SetReturn(MU_FAILURE);
+    STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICE_ID_STRING_HANDLE));
+    EXPECTED_CALL(free(IGNORED_PTR_ARG));
 
     // act
     IOTHUB_DEVICE_HANDLE device_handle = IoTHubTransport_AMQP_Common_Register(handle, device_config, &TEST_waitingToSend);
@@ -2230,7 +2314,8 @@ TEST_FUNCTION(Register_device_already_registered)
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     // cleanup
-    destroy_transport(handle, device_handle, NULL);
+    device_config->moduleId = NULL;
+    destroy_transport(handle, NULL, NULL);
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_065: [IoTHubTransport_AMQP_Common_Register shall fail and return NULL if the device is not using an authentication mode compatible with the currently used by the transport.]
@@ -2249,10 +2334,6 @@ TEST_FUNCTION(Register_CBS_transport_X509_credentials)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config2->deviceId))
-        .IgnoreArgument(2)
-        .SetReturn(NULL);
-
     // act
     IOTHUB_DEVICE_HANDLE device_handle2 = IoTHubTransport_AMQP_Common_Register(handle, device_config2, &TEST_waitingToSend);
 
@@ -2281,10 +2362,6 @@ TEST_FUNCTION(Register_X509_transport_CBS_credentials)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config2->deviceId))
-        .IgnoreArgument(2)
-        .SetReturn(NULL);
-
     // act
     IOTHUB_DEVICE_HANDLE device_handle2 = IoTHubTransport_AMQP_Common_Register(handle, device_config2, &TEST_waitingToSend);
 
@@ -2320,7 +2397,7 @@ TEST_FUNCTION(Register_failure_checks)
     size_t i, n = umock_c_negative_tests_call_count();
     for (i = 0; i < n; i++)
     {
-        if (i == 0 || i == 2 || i == 3 || i == 4 || i >= 5)
+        if (i >= 1)
         {
             // These expected calls do not cause the API to fail.
             continue;
@@ -2355,6 +2432,7 @@ TEST_FUNCTION(Register_failure_checks)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_074: [IoTHubTransport_AMQP_Common_Register shall add the `amqp_device_instance` to `instance->registered_devices`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_076: [If the device is the first being registered on the transport, IoTHubTransport_AMQP_Common_Register shall save its authentication mode as the transport preferred authentication mode]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_078: [IoTHubTransport_AMQP_Common_Register shall return a handle to `amqp_device_instance` as a IOTHUB_DEVICE_HANDLE]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_162: [IoTHubTransport_AMQP_Common_Register shall add the `amqp_device_instance` to the transport device index]
 TEST_FUNCTION(Register_succeeds)
 {
     // arrange
@@ -3099,6 +3177,164 @@ TEST_FUNCTION(SetOption_cl2svc_keep_alive_send_ratio_success_for_0875)
     destroy_transport(handle, device_handle, NULL);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_165: [If `option` is OPTION_IDLE_DEVICE_DO_WORK_INTERVAL_SECS, `value` shall be saved as the maximum interval idle devices can go without a device-specific do_work]
+TEST_FUNCTION(SetOption_idle_device_do_work_interval_secs_succeeds)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    umock_c_reset_all_calls();
+    size_t value = 10;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_IDLE_DEVICE_DO_WORK_INTERVAL_SECS, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_168: [If `option` is OPTION_AMQP_SESSION_COUNT, `value` shall be saved as the number of AMQP sessions used on the next connection]
+TEST_FUNCTION(SetOption_amqp_session_count_succeeds)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    umock_c_reset_all_calls();
+    size_t value = 4;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_SESSION_COUNT, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_169: [If OPTION_AMQP_SESSION_COUNT or a session window size is zero, IoTHubTransport_AMQP_Common_SetOption shall fail and return IOTHUB_CLIENT_INVALID_ARG]
+TEST_FUNCTION(SetOption_amqp_session_count_zero_fails)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    umock_c_reset_all_calls();
+    size_t value = 0;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_SESSION_COUNT, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_169: [If OPTION_AMQP_SESSION_COUNT or a session window size is zero, IoTHubTransport_AMQP_Common_SetOption shall fail and return IOTHUB_CLIENT_INVALID_ARG]
+TEST_FUNCTION(SetOption_amqp_session_window_zero_fails)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    umock_c_reset_all_calls();
+    size_t value = 0;
+
+    // act
+    IOTHUB_CLIENT_RESULT result_incoming = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_SESSION_INCOMING_WINDOW, &value);
+    IOTHUB_CLIENT_RESULT result_outgoing = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_SESSION_OUTGOING_WINDOW, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_INVALID_ARG, result_incoming);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_INVALID_ARG, result_outgoing);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_171: [If `option` is OPTION_SAS_TOKEN_REFRESH_SPREAD_SECS, `value` shall be saved as the window the SAS token refreshes of the registered devices are spread across]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_172: [If `option` is OPTION_MAX_CONCURRENT_SAS_TOKEN_REFRESHES, `value` shall be saved as the maximum number of SAS token refreshes in progress at a time]
+TEST_FUNCTION(SetOption_sas_token_refresh_scheduler_options_succeed)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    umock_c_reset_all_calls();
+    size_t spread_secs = 600;
+    size_t max_concurrent_refreshes = 8;
+
+    // act
+    IOTHUB_CLIENT_RESULT result_spread = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_SAS_TOKEN_REFRESH_SPREAD_SECS, &spread_secs);
+    IOTHUB_CLIENT_RESULT result_max = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_MAX_CONCURRENT_SAS_TOKEN_REFRESHES, &max_concurrent_refreshes);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result_spread);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result_max);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_180: [If `option` is OPTION_SAS_TOKEN_BATCH_SIGNING, `value` shall be saved as whether the SAS tokens of the registered devices are signed together]
+TEST_FUNCTION(SetOption_sas_token_batch_signing_succeeds)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    umock_c_reset_all_calls();
+    bool batch_signing = true;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_SAS_TOKEN_BATCH_SIGNING, &batch_signing);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_173: [If `option` is OPTION_SAS_TOKEN_REFRESH_METRICS, the IOTHUB_SAS_TOKEN_REFRESH_METRICS pointed to by `value` shall be set with the SAS token refresh metrics of all devices registered on the transport]
+TEST_FUNCTION(SetOption_sas_token_refresh_metrics_succeeds)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+    IOTHUB_SAS_TOKEN_REFRESH_METRICS metrics;
+    memset(&metrics, 0xFF, sizeof(IOTHUB_SAS_TOKEN_REFRESH_METRICS));
+
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_SAS_TOKEN_REFRESH_METRICS, &metrics);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, metrics.refresh_count);
+    ASSERT_ARE_EQUAL(size_t, 0, metrics.refresh_failure_count);
+    ASSERT_ARE_EQUAL(size_t, 0, metrics.refresh_deferred_count);
+    ASSERT_ARE_EQUAL(uint64_t, 0, metrics.max_refresh_latency_ms);
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
 /* Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_032: [ If `option` is `proxy_data`, `value` shall be used as an `HTTP_PROXY_OPTIONS*`. ]*/
 /* Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_033: [ The fields `host_address`, `port`, `username` and `password` shall be saved for later used (needed when creating the underlying IO to be used by the transport). ]*/
 /* Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_039: [ If setting the `proxy_data` option succeeds, `IoTHubTransport_AMQP_Common_SetOption` shall return `IOTHUB_CLIENT_OK` ]*/
@@ -3937,6 +4173,8 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_Destroy_frees_proxy_options)
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
 
     // act
@@ -3974,8 +4212,8 @@ TEST_FUNCTION(Unregister_device_not_registered)
 
     umock_c_reset_all_calls();
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
-        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
-    set_expected_calls_for_is_device_registered_ex(device_config, NULL);
+        .SetReturn(TEST_UNREGISTERED_DEVICE_ID_CHAR_PTR);
+    set_expected_calls_for_find_device_in_index();
 
     // act
     IoTHubTransport_AMQP_Common_Unregister(device_handle);
@@ -3991,6 +4229,7 @@ TEST_FUNCTION(Unregister_device_not_registered)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_082: [`device_instance` shall be removed from `instance->registered_devices`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_012: [IoTHubTransport_AMQP_Common_Unregister shall destroy the C2D methods handler by calling iothubtransportamqp_methods_destroy]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_083: [IoTHubTransport_AMQP_Common_Unregister shall free all the memory allocated for the `device_instance`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_163: [`device_instance` shall be removed from the transport device index]
 TEST_FUNCTION(Unregister_succeeds)
 {
     // arrange
@@ -4165,6 +4404,188 @@ TEST_FUNCTION(DoWork_success)
     destroy_transport(handle, device_handle, NULL);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_164: [If OPTION_IDLE_DEVICE_DO_WORK_INTERVAL_SECS is set, the device-specific do_work shall be skipped for started devices with no pending work whose last do_work ran within that interval]
+TEST_FUNCTION(DoWork_skips_idle_device_within_interval)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    crank_transport_ready_after_create(handle, &TEST_waitingToSend, 0, false, true, 1, TEST_current_time, false);
+
+    size_t interval_secs = 10;
+    DEVICE_SEND_STATUS send_status = DEVICE_SEND_STATUS_IDLE;
+    bool is_timed_out = true;
+    bool is_not_timed_out = false;
+    (void)IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_IDLE_DEVICE_DO_WORK_INTERVAL_SECS, &interval_secs);
+
+    umock_c_reset_all_calls();
+    // First call: the device has no recorded do_work yet, so it is serviced.
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&TEST_waitingToSend)).SetReturn(1);
+    STRICT_EXPECTED_CALL(amqp_device_get_send_status(TEST_DEVICE_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &send_status, sizeof(DEVICE_SEND_STATUS));
+    STRICT_EXPECTED_CALL(is_timeout_reached(INDEFINITE_TIME, 10, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_is_timed_out(&is_timed_out, sizeof(bool));
+    set_expected_calls_for_Device_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STARTED, true, TEST_current_time, false);
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(TEST_current_time);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_connection_do_work(TEST_AMQP_CONNECTION_HANDLE));
+
+    // Second call: within the interval and idle, so amqp_device_do_work is not invoked.
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&TEST_waitingToSend)).SetReturn(1);
+    STRICT_EXPECTED_CALL(amqp_device_get_send_status(TEST_DEVICE_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &send_status, sizeof(DEVICE_SEND_STATUS));
+    STRICT_EXPECTED_CALL(is_timeout_reached(TEST_current_time, 10, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_is_timed_out(&is_not_timed_out, sizeof(bool));
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_connection_do_work(TEST_AMQP_CONNECTION_HANDLE));
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_164: [If OPTION_IDLE_DEVICE_DO_WORK_INTERVAL_SECS is set, the device-specific do_work shall be skipped for started devices with no pending work whose last do_work ran within that interval]
+TEST_FUNCTION(DoWork_does_not_skip_device_with_events_in_flight)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    crank_transport_ready_after_create(handle, &TEST_waitingToSend, 0, false, true, 1, TEST_current_time, false);
+
+    size_t interval_secs = 10;
+    DEVICE_SEND_STATUS send_status = DEVICE_SEND_STATUS_BUSY;
+    (void)IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_IDLE_DEVICE_DO_WORK_INTERVAL_SECS, &interval_secs);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&TEST_waitingToSend)).SetReturn(1);
+    STRICT_EXPECTED_CALL(amqp_device_get_send_status(TEST_DEVICE_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &send_status, sizeof(DEVICE_SEND_STATUS));
+    set_expected_calls_for_Device_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STARTED, true, TEST_current_time, false);
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(TEST_current_time);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_connection_do_work(TEST_AMQP_CONNECTION_HANDLE));
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_179: [If OPTION_SAS_TOKEN_BATCH_SIGNING is set, the SAS tokens queued by the device-specific do_work calls shall be signed together with authentication_sign_pending_sas_tokens()]
+TEST_FUNCTION(DoWork_signs_pending_sas_tokens_after_device_do_work_when_batch_signing)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    crank_transport_ready_after_create(handle, &TEST_waitingToSend, 0, false, true, 1, TEST_current_time, false);
+
+    bool batch_signing = true;
+    (void)IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_SAS_TOKEN_BATCH_SIGNING, &batch_signing);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    set_expected_calls_for_Device_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STARTED, true, TEST_current_time, false);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(authentication_sign_pending_sas_tokens(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_connection_do_work(TEST_AMQP_CONNECTION_HANDLE));
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
+static void DoWork_does_not_skip_device_after_DeviceTwin_subscription_change_Impl(bool subscribe)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    crank_transport_ready_after_create(handle, &TEST_waitingToSend, 0, false, true, 1, TEST_current_time, false);
+
+    size_t interval_secs = 10;
+    (void)IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_IDLE_DEVICE_DO_WORK_INTERVAL_SECS, &interval_secs);
+
+    if (subscribe)
+    {
+        ASSERT_ARE_EQUAL(int, 0, IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin(handle));
+    }
+    else
+    {
+        IoTHubTransport_AMQP_Common_Unsubscribe_DeviceTwin(handle);
+    }
+
+    umock_c_reset_all_calls();
+    // The device-specific do_work runs without checking if the device is idle.
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    set_expected_calls_for_Device_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STARTED, true, TEST_current_time, false);
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(TEST_current_time);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_connection_do_work(TEST_AMQP_CONNECTION_HANDLE));
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_177: [If amqp_device_subscribe_for_twin_updates() succeeds, the next IoTHubTransport_AMQP_Common_DoWork shall not skip the device as idle]
+TEST_FUNCTION(DoWork_does_not_skip_device_after_Subscribe_DeviceTwin)
+{
+    DoWork_does_not_skip_device_after_DeviceTwin_subscription_change_Impl(true);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_178: [If amqp_device_unsubscribe_for_twin_updates() succeeds, the next IoTHubTransport_AMQP_Common_DoWork shall not skip the device as idle]
+TEST_FUNCTION(DoWork_does_not_skip_device_after_Unsubscribe_DeviceTwin)
+{
+    DoWork_does_not_skip_device_after_DeviceTwin_subscription_change_Impl(false);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_115: [If the AMQP connection is closed by the service side, the connection retry logic shall be triggered]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_126: [The connection retry shall be attempted only if retry_control_should_retry() returns RETRY_ACTION_NOW, or if it fails]
 TEST_FUNCTION(on_amqp_connection_state_changed_CLOSED_unexpectedly)
@@ -4343,6 +4764,42 @@ TEST_FUNCTION(DoWork_configures_AMQP_connection_using_c2d_keep_alive_freq_secs)
     // cleanup
     destroy_transport(handle, device_handle, NULL);
 }
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_167: [AMQP connection will be configured using the session count and window sizes set with SetOption]
+TEST_FUNCTION(DoWork_configures_AMQP_connection_using_session_windows)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    const char* certificate = TEST_X509_CERTIFICATE;
+    const char* private_key = TEST_X509_PRIVATE_KEY;
+    size_t incoming_window = 5000;
+    size_t outgoing_window = 20;
+    (void)IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_X509_CERT, certificate);
+    (void)IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_X509_PRIVATE_KEY, private_key);
+    (void)IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_SESSION_INCOMING_WINDOW, &incoming_window);
+    (void)IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_SESSION_OUTGOING_WINDOW, &outgoing_window);
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config_for_x509(TEST_DEVICE_ID_CHAR_PTR);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, false);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, true, true, false, false, 1, TEST_current_time, false);
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, TEST_amqp_connection_create_saved_session_count);
+    ASSERT_ARE_EQUAL(uint32_t, 5000, TEST_amqp_connection_create_saved_session_incoming_window);
+    ASSERT_ARE_EQUAL(uint32_t, 20, TEST_amqp_connection_create_saved_session_outgoing_window);
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_99_001: [AMQP connection will be configured using the `cl2svc_keep_alive_send_ratio` value from SetOption ]
 TEST_FUNCTION(DoWork_configures_AMQP_connection_using_cl2svc_keep_alive_send_ratio)
 {
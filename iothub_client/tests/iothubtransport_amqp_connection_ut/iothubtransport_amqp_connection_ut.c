@@ -82,6 +82,7 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define TEST_CONNECTION_HANDLE                            (CONNECTION_HANDLE)0x4452
 #define TEST_UNIQUE_ID                                    "ab345cd00829ef12"
 #define TEST_SESSION_HANDLE                               (SESSION_HANDLE)0x4453
+#define TEST_EXTRA_SESSION_HANDLE(index)                  (SESSION_HANDLE)(0x4500 + (index))
 #define TEST_CBS_HANDLE                                   (CBS_HANDLE)0x4454
 
 // Helpers
@@ -166,6 +167,9 @@ static AMQP_CONNECTION_CONFIG* get_amqp_connection_config()
     global_amqp_connection_config.is_trace_on = true;
     global_amqp_connection_config.svc2cl_keep_alive_timeout_secs = 123;
     global_amqp_connection_config.cl2svc_keep_alive_send_ratio   = 0.5;
+    global_amqp_connection_config.session_count = 0;
+    global_amqp_connection_config.session_incoming_window = 0;
+    global_amqp_connection_config.session_outgoing_window = 0;
 
     return &global_amqp_connection_config;
 }
@@ -173,6 +177,8 @@ static AMQP_CONNECTION_CONFIG* get_amqp_connection_config()
 static void set_exp_calls_for_amqp_connection_create(AMQP_CONNECTION_CONFIG* amqp_connection_config)
 {
     XIO_HANDLE target_underlying_io;
+    uint32_t incoming_window;
+    uint32_t outgoing_window;
 
     STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG)).IgnoreArgument(1);
     STRICT_EXPECTED_CALL(STRING_construct(amqp_connection_config->iothub_host_fqdn));
@@ -218,9 +224,27 @@ static void set_exp_calls_for_amqp_connection_create(AMQP_CONNECTION_CONFIG* amq
     EXPECTED_CALL(free(IGNORED_PTR_ARG)); // UniqueId container.
 
     // Session
+    incoming_window = (amqp_connection_config->session_incoming_window != 0 ? amqp_connection_config->session_incoming_window : (uint32_t)DEFAULT_INCOMING_WINDOW_SIZE);
+    outgoing_window = (amqp_connection_config->session_outgoing_window != 0 ? amqp_connection_config->session_outgoing_window : (uint32_t)DEFAULT_OUTGOING_WINDOW_SIZE);
+
     STRICT_EXPECTED_CALL(session_create(TEST_CONNECTION_HANDLE, NULL, NULL));
-    STRICT_EXPECTED_CALL(session_set_incoming_window(TEST_SESSION_HANDLE, (uint32_t)DEFAULT_INCOMING_WINDOW_SIZE));
-    STRICT_EXPECTED_CALL(session_set_outgoing_window(TEST_SESSION_HANDLE, (uint32_t)DEFAULT_OUTGOING_WINDOW_SIZE));
+    STRICT_EXPECTED_CALL(session_set_incoming_window(TEST_SESSION_HANDLE, incoming_window));
+    STRICT_EXPECTED_CALL(session_set_outgoing_window(TEST_SESSION_HANDLE, outgoing_window));
+
+    if (amqp_connection_config->session_count > 1)
+    {
+        size_t i;
+
+        EXPECTED_CALL(malloc(IGNORED_NUM_ARG)); // Additional sessions.
+
+        for (i = 0; i < amqp_connection_config->session_count - 1; i++)
+        {
+            STRICT_EXPECTED_CALL(session_create(TEST_CONNECTION_HANDLE, NULL, NULL))
+                .SetReturn(TEST_EXTRA_SESSION_HANDLE(i));
+            STRICT_EXPECTED_CALL(session_set_incoming_window(TEST_EXTRA_SESSION_HANDLE(i), incoming_window));
+            STRICT_EXPECTED_CALL(session_set_outgoing_window(TEST_EXTRA_SESSION_HANDLE(i), outgoing_window));
+        }
+    }
 
     // CBS
     if (amqp_connection_config->create_cbs_connection)
@@ -237,6 +261,18 @@ static void set_exp_calls_for_amqp_connection_destroy(AMQP_CONNECTION_CONFIG* co
         STRICT_EXPECTED_CALL(cbs_destroy(TEST_CBS_HANDLE));
     }
 
+    if (config->session_count > 1)
+    {
+        size_t i;
+
+        for (i = 0; i < config->session_count - 1; i++)
+        {
+            STRICT_EXPECTED_CALL(session_destroy(TEST_EXTRA_SESSION_HANDLE(i)));
+        }
+
+        EXPECTED_CALL(free(IGNORED_PTR_ARG)); // Additional sessions.
+    }
+
     STRICT_EXPECTED_CALL(session_destroy(TEST_SESSION_HANDLE));
     STRICT_EXPECTED_CALL(connection_destroy(TEST_CONNECTION_HANDLE));
 
@@ -518,6 +554,74 @@ TEST_FUNCTION(amqp_connection_create_no_SASL_no_CBS_success)
     amqp_connection_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_080: [If `config->session_incoming_window` is not zero, it shall be used instead of the default incoming window size]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_081: [If `config->session_outgoing_window` is not zero, it shall be used instead of the default outgoing window size]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_082: [If `config->session_count` is greater than 1, amqp_connection_create() shall create `config->session_count` - 1 additional sessions on the same connection]
+TEST_FUNCTION(amqp_connection_create_multiple_sessions_success)
+{
+    // arrange
+    AMQP_CONNECTION_CONFIG* config = get_amqp_connection_config();
+    config->session_count = 3;
+    config->session_incoming_window = 5000;
+    config->session_outgoing_window = 20;
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_amqp_connection_create(config);
+
+    // act
+    AMQP_CONNECTION_HANDLE handle = amqp_connection_create(config);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, (void*)handle, (void*)saved_malloc_returns[0]);
+
+    // cleanup
+    amqp_connection_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_083: [If any of the additional sessions fails to be created, amqp_connection_create() shall fail and return NULL]
+TEST_FUNCTION(amqp_connection_create_multiple_sessions_negative_checks)
+{
+    // arrange
+    size_t failing_calls[] = {
+        18, // malloc(extra_session_handles)
+        19, // session_create (first additional session)
+        22  // session_create (second additional session)
+    };
+    size_t i;
+
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    AMQP_CONNECTION_CONFIG* config = get_amqp_connection_config();
+    config->session_count = 3;
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_amqp_connection_create(config);
+    umock_c_negative_tests_snapshot();
+
+    // act
+    for (i = 0; i < sizeof(failing_calls) / sizeof(failing_calls[0]); i++)
+    {
+        // arrange
+        char error_msg[64];
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(failing_calls[i]);
+
+        TEST_connection_create2_result = TEST_CONNECTION_HANDLE;
+
+        AMQP_CONNECTION_HANDLE handle = amqp_connection_create(config);
+
+        // assert
+        sprintf(error_msg, "On failed call %lu", (unsigned long)failing_calls[i]);
+        ASSERT_IS_NULL(handle, error_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_reset();
+    umock_c_negative_tests_deinit();
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_058: [If malloc() fails, amqp_connection_create() shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_066: [If STRING_construct() fails, amqp_connection_create() shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_013: [If saslmechanism_create() fails, amqp_connection_create() shall fail and return NULL]
@@ -837,6 +941,30 @@ TEST_FUNCTION(amqp_connection_destroy_no_SASL_no_CBS_success)
     // cleanup
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_084: [amqp_connection_destroy() shall destroy the additional sessions, if any, using session_destroy()]
+TEST_FUNCTION(amqp_connection_destroy_multiple_sessions_success)
+{
+    // arrange
+    AMQP_CONNECTION_CONFIG* config = get_amqp_connection_config();
+    config->session_count = 3;
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_amqp_connection_create(config);
+
+    AMQP_CONNECTION_HANDLE handle = amqp_connection_create(config);
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_amqp_connection_destroy(config, handle);
+
+    // act
+    amqp_connection_destroy(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_041: [If `conn_handle` is NULL, amqp_connection_do_work() shall fail and return]
 TEST_FUNCTION(amqp_connection_do_work_NULL_handle)
 {
@@ -944,6 +1072,116 @@ TEST_FUNCTION(amqp_connection_get_session_handle_success)
     amqp_connection_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_085: [If `conn_handle` or `session_handle` are NULL, amqp_connection_get_shard_session_handle() shall fail and return MU_FAILURE]
+TEST_FUNCTION(amqp_connection_get_shard_session_handle_NULL_handle)
+{
+    // arrange
+    SESSION_HANDLE session_handle;
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = amqp_connection_get_shard_session_handle(NULL, 1, &session_handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, result, 0);
+
+    // cleanup
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_085: [If `conn_handle` or `session_handle` are NULL, amqp_connection_get_shard_session_handle() shall fail and return MU_FAILURE]
+TEST_FUNCTION(amqp_connection_get_shard_session_handle_NULL_session_handle)
+{
+    // arrange
+    AMQP_CONNECTION_CONFIG* config = get_amqp_connection_config();
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_amqp_connection_create(config);
+
+    AMQP_CONNECTION_HANDLE handle = amqp_connection_create(config);
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = amqp_connection_get_shard_session_handle(handle, 1, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, result, 0);
+
+    // cleanup
+    amqp_connection_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_086: [`session_handle` shall be set to the session at index `shard_key` modulo the number of sessions, where index 0 is `instance->session_handle`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_087: [amqp_connection_get_shard_session_handle() shall return success code 0]
+TEST_FUNCTION(amqp_connection_get_shard_session_handle_multiple_sessions_success)
+{
+    // arrange
+    AMQP_CONNECTION_CONFIG* config = get_amqp_connection_config();
+    config->session_count = 3;
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_amqp_connection_create(config);
+
+    AMQP_CONNECTION_HANDLE handle = amqp_connection_create(config);
+
+    umock_c_reset_all_calls();
+
+    SESSION_HANDLE session_handle_0;
+    SESSION_HANDLE session_handle_1;
+    SESSION_HANDLE session_handle_2;
+    SESSION_HANDLE session_handle_3;
+
+    // act
+    int result_0 = amqp_connection_get_shard_session_handle(handle, 0, &session_handle_0);
+    int result_1 = amqp_connection_get_shard_session_handle(handle, 1, &session_handle_1);
+    int result_2 = amqp_connection_get_shard_session_handle(handle, 2, &session_handle_2);
+    int result_3 = amqp_connection_get_shard_session_handle(handle, 3, &session_handle_3);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, result_0, 0);
+    ASSERT_ARE_EQUAL(int, result_1, 0);
+    ASSERT_ARE_EQUAL(int, result_2, 0);
+    ASSERT_ARE_EQUAL(int, result_3, 0);
+    ASSERT_ARE_EQUAL(void_ptr, session_handle_0, TEST_SESSION_HANDLE);
+    ASSERT_ARE_EQUAL(void_ptr, session_handle_1, TEST_EXTRA_SESSION_HANDLE(0));
+    ASSERT_ARE_EQUAL(void_ptr, session_handle_2, TEST_EXTRA_SESSION_HANDLE(1));
+    ASSERT_ARE_EQUAL(void_ptr, session_handle_3, TEST_SESSION_HANDLE);
+
+    // cleanup
+    amqp_connection_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_086: [`session_handle` shall be set to the session at index `shard_key` modulo the number of sessions, where index 0 is `instance->session_handle`]
+TEST_FUNCTION(amqp_connection_get_shard_session_handle_single_session_success)
+{
+    // arrange
+    AMQP_CONNECTION_CONFIG* config = get_amqp_connection_config();
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_amqp_connection_create(config);
+
+    AMQP_CONNECTION_HANDLE handle = amqp_connection_create(config);
+
+    umock_c_reset_all_calls();
+
+    SESSION_HANDLE session_handle;
+
+    // act
+    int result = amqp_connection_get_shard_session_handle(handle, 12345, &session_handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_ARE_EQUAL(void_ptr, session_handle, TEST_SESSION_HANDLE);
+
+    // cleanup
+    amqp_connection_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_047: [If `conn_handle` is NULL, amqp_connection_get_cbs_handle() shall fail and return MU_FAILURE]
 TEST_FUNCTION(amqp_connection_get_cbs_handle_NULL_handle)
 {
@@ -694,6 +694,14 @@ static void set_expected_calls_for_device_set_option(AMQP_DEVICE_HANDLE handle,
     {
         STRICT_EXPECTED_CALL(telemetry_messenger_set_option(TEST_TELEMETRY_MESSENGER_HANDLE, TELEMETRY_MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS, option_value));
     }
+    else if (strcmp(DEVICE_OPTION_EVENT_SEND_BATCH_LINGER_MS, option_name) == 0)
+    {
+        STRICT_EXPECTED_CALL(telemetry_messenger_set_option(TEST_TELEMETRY_MESSENGER_HANDLE, TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_MS, option_value));
+    }
+    else if (strcmp(DEVICE_OPTION_EVENT_SEND_BATCH_MIN_BYTES, option_name) == 0)
+    {
+        STRICT_EXPECTED_CALL(telemetry_messenger_set_option(TEST_TELEMETRY_MESSENGER_HANDLE, TELEMETRY_MESSENGER_OPTION_EVENT_SEND_BATCH_MIN_BYTES, option_value));
+    }
     else if (strcmp(DEVICE_OPTION_SAVED_MESSENGER_OPTIONS, option_name) == 0)
     {
         STRICT_EXPECTED_CALL(OptionHandler_FeedOptions((OPTIONHANDLER_HANDLE)option_value, TEST_TELEMETRY_MESSENGER_HANDLE));
@@ -1892,6 +1900,63 @@ TEST_FUNCTION(device_set_option_saved_msgr_options_fails)
     amqp_device_destroy(handle);
 }
 
+TEST_FUNCTION(device_set_option_EVENT_SEND_BATCH_LINGER_MS_succeeds)
+{
+    // arrange
+    ASSERT_IS_TRUE(INDEFINITE_TIME != TEST_current_time, "Failed setting TEST_current_time");
+
+    AMQP_DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_CBS);
+    AMQP_DEVICE_HANDLE handle = create_and_start_device(config, TEST_current_time);
+
+    size_t value = 20;
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_device_set_option(handle, config, DEVICE_OPTION_EVENT_SEND_BATCH_LINGER_MS, &value);
+
+    // act
+    int result = amqp_device_set_option(handle, DEVICE_OPTION_EVENT_SEND_BATCH_LINGER_MS, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    amqp_device_destroy(handle);
+}
+
+TEST_FUNCTION(device_set_option_EVENT_SEND_BATCH_MIN_BYTES_fails)
+{
+    // arrange
+    ASSERT_IS_TRUE(INDEFINITE_TIME != TEST_current_time, "Failed setting TEST_current_time");
+
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    AMQP_DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_CBS);
+    AMQP_DEVICE_HANDLE handle = create_and_start_device(config, TEST_current_time);
+
+    size_t value = 4096;
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_device_set_option(handle, config, DEVICE_OPTION_EVENT_SEND_BATCH_MIN_BYTES, &value);
+    umock_c_negative_tests_snapshot();
+
+    umock_c_negative_tests_reset();
+    umock_c_negative_tests_fail_call(0);
+
+    // act
+    int result = amqp_device_set_option(handle, DEVICE_OPTION_EVENT_SEND_BATCH_MIN_BYTES, &value);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_NOT_NULL(handle);
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+    umock_c_reset_all_calls();
+
+    amqp_device_destroy(handle);
+}
+
 // Tests_SRS_DEVICE_09_084: [If `name` refers to authentication, it shall be passed along with `value` to authentication_set_option]
 // Tests_SRS_DEVICE_09_092: [If no failures occur, amqp_device_set_option shall return 0]
 TEST_FUNCTION(device_set_option_CBS_AUTH_succeeds)
@@ -0,0 +1,459 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <string.h>
+#endif
+#include "testrunnerswitcher.h"
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_charptr.h"
+
+#if defined _MSC_VER
+#pragma warning(disable: 4054) /* MSC incorrectly fires this */
+#endif
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/xio.h"
+#include "azure_c_shared_utility/socketio.h"
+#include "azure_c_shared_utility/envvariable.h"
+#include "internal/iothubtransport_mqtt_common.h"
+#include "internal/iothubtransport.h"
+
+#undef ENABLE_MOCKS
+
+#include "azure_c_shared_utility/shared_util_options.h"
+#include "iothubtransportmqtt_uds.h"
+
+static const char* TEST_STRING_VALUE = "FULLY_QUALIFIED_HOSTNAME";
+static const char* TEST_EDGEHUB_URI = "unix:///var/run/iotedge/mqtt.sock";
+static const char* TEST_SOCKET_PATH = "/var/run/iotedge/mqtt.sock";
+static const char* TEST_DEVICE_ID = "thisIsDeviceID";
+static const char* TEST_DEVICE_KEY = "thisIsDeviceKey";
+static const char* TEST_IOTHUB_NAME = "thisIsIotHubName";
+static const char* TEST_IOTHUB_SUFFIX = "thisIsIotHubSuffix";
+
+static const char* TEST_OPTION_NAME = "TEST_OPTION_NAME";
+static const char* TEST_OPTION_VALUE = "test_option_value";
+
+static const TRANSPORT_LL_HANDLE TEST_TRANSPORT_HANDLE = (TRANSPORT_LL_HANDLE)0x4444;
+static XIO_HANDLE TEST_XIO_HANDLE = (XIO_HANDLE)0x1126;
+
+static IO_INTERFACE_DESCRIPTION* TEST_SOCKETIO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1184;
+
+static TRANSPORT_CALLBACKS_INFO* g_transport_cb_info = (TRANSPORT_CALLBACKS_INFO*)0x227733;
+
+static IOTHUB_CLIENT_CONFIG g_iothubClientConfig = { 0 };
+static DLIST_ENTRY g_waitingToSend;
+
+static MQTT_GET_IO_TRANSPORT g_get_io_transport;
+
+// Copied out of the SOCKETIO_CONFIG given to xio_create, which lives on the stack of getUdsIOTransport.
+static char g_socketio_hostname[64];
+static int g_socketio_port;
+static void* g_socketio_accepted_socket;
+
+TEST_DEFINE_ENUM_TYPE(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
+
+static TEST_MUTEX_HANDLE test_serialize_mutex;
+
+static pfIoTHubTransport_SetOption                  IoTHubTransportMqtt_UDS_SetOption;
+static pfIoTHubTransport_Create                     IoTHubTransportMqtt_UDS_Create;
+static pfIoTHubTransport_Destroy                    IoTHubTransportMqtt_UDS_Destroy;
+static pfIoTHubTransport_DoWork                     IoTHubTransportMqtt_UDS_DoWork;
+
+static TRANSPORT_LL_HANDLE my_IoTHubTransport_MQTT_Common_Create(const IOTHUBTRANSPORT_CONFIG* config, MQTT_GET_IO_TRANSPORT get_io_transport, TRANSPORT_CALLBACKS_INFO* cb_info, void* ctx)
+{
+    (void)config;
+    (void)cb_info;
+    (void)ctx;
+    g_get_io_transport = get_io_transport;
+    return TEST_TRANSPORT_HANDLE;
+}
+
+static XIO_HANDLE my_xio_create(const IO_INTERFACE_DESCRIPTION* io_interface_description, const void* xio_create_parameters)
+{
+    const SOCKETIO_CONFIG* socketio_config = (const SOCKETIO_CONFIG*)xio_create_parameters;
+    (void)io_interface_description;
+
+    (void)strncpy(g_socketio_hostname, socketio_config->hostname, sizeof(g_socketio_hostname) - 1);
+    g_socketio_port = socketio_config->port;
+    g_socketio_accepted_socket = socketio_config->accepted_socket;
+    return TEST_XIO_HANDLE;
+}
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    ASSERT_FAIL("umock_c reported error :%s", MU_ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+}
+
+BEGIN_TEST_SUITE(iothubtransportmqtt_uds_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    test_serialize_mutex = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(test_serialize_mutex);
+
+    umock_c_init(on_umock_c_error);
+
+    ASSERT_ARE_EQUAL(int, 0, umocktypes_charptr_register_types());
+
+    REGISTER_UMOCK_ALIAS_TYPE(XIO_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MQTT_GET_IO_TRANSPORT, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_DEVICE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TRANSPORT_LL_HANDLE, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubTransport_MQTT_Common_Create, my_IoTHubTransport_MQTT_Common_Create);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_SetOption, IOTHUB_CLIENT_OK);
+
+    REGISTER_GLOBAL_MOCK_RETURN(environment_get_variable, TEST_EDGEHUB_URI);
+    REGISTER_GLOBAL_MOCK_RETURN(socketio_get_interface_description, TEST_SOCKETIO_INTERFACE_DESCRIPTION);
+    REGISTER_GLOBAL_MOCK_HOOK(xio_create, my_xio_create);
+    REGISTER_GLOBAL_MOCK_RETURN(xio_setoption, 0);
+
+    IoTHubTransportMqtt_UDS_SetOption = ((TRANSPORT_PROVIDER*)MQTT_UDS_Protocol())->IoTHubTransport_SetOption;
+    IoTHubTransportMqtt_UDS_Create = ((TRANSPORT_PROVIDER*)MQTT_UDS_Protocol())->IoTHubTransport_Create;
+    IoTHubTransportMqtt_UDS_Destroy = ((TRANSPORT_PROVIDER*)MQTT_UDS_Protocol())->IoTHubTransport_Destroy;
+    IoTHubTransportMqtt_UDS_DoWork = ((TRANSPORT_PROVIDER*)MQTT_UDS_Protocol())->IoTHubTransport_DoWork;
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(test_serialize_mutex);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    TEST_MUTEX_ACQUIRE(test_serialize_mutex);
+
+    (void)memset(g_socketio_hostname, 0, sizeof(g_socketio_hostname));
+    g_socketio_port = -1;
+    g_socketio_accepted_socket = (void*)0x1;
+    g_get_io_transport = NULL;
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(test_serialize_mutex);
+}
+
+static TRANSPORT_LL_HANDLE create_transport(void)
+{
+    TRANSPORT_LL_HANDLE result;
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+
+    g_iothubClientConfig.protocol = MQTT_UDS_Protocol;
+    g_iothubClientConfig.deviceId = TEST_DEVICE_ID;
+    g_iothubClientConfig.deviceKey = TEST_DEVICE_KEY;
+    g_iothubClientConfig.iotHubName = TEST_IOTHUB_NAME;
+    g_iothubClientConfig.iotHubSuffix = TEST_IOTHUB_SUFFIX;
+    config.waitingToSend = &g_waitingToSend;
+    config.upperConfig = &g_iothubClientConfig;
+
+    result = IoTHubTransportMqtt_UDS_Create(&config, g_transport_cb_info, NULL);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_009: [ `IoTHubTransportMqtt_UDS_Create` shall create a TRANSPORT_LL_HANDLE by calling into the `IoTHubTransport_MQTT_Common_Create` function with `getUdsIOTransport`. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_UDS_Create_success)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    config.waitingToSend = &g_waitingToSend;
+    config.upperConfig = &g_iothubClientConfig;
+
+    STRICT_EXPECTED_CALL(IoTHubTransport_MQTT_Common_Create(&config, IGNORED_PTR_ARG, g_transport_cb_info, NULL));
+
+    // act
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportMqtt_UDS_Create(&config, g_transport_cb_info, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_TRANSPORT_HANDLE, handle);
+    ASSERT_IS_NOT_NULL(g_get_io_transport);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_002: [ `getUdsIOTransport` shall read the socket of edgeHub from the `IOTEDGE_EDGEHUBURI` environment variable, as `unix://` followed by the path of the socket. ] */
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_004: [ `getUdsIOTransport` shall obtain the socket IO interface handle by calling `socketio_get_interface_description`. ] */
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_006: [ `getUdsIOTransport` shall call `xio_create` with a `SOCKETIO_CONFIG` whose `hostname` is the path of the socket, `port` is 0 and `accepted_socket` is NULL. ] */
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_008: [ `getUdsIOTransport` shall set `OPTION_ADDRESS_TYPE` to `OPTION_ADDRESS_TYPE_DOMAIN_SOCKET` on the socket IO and return it. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_UDS_getUdsIOTransport_success)
+{
+    // arrange
+    XIO_HANDLE xioTest;
+    (void)create_transport();
+
+    STRICT_EXPECTED_CALL(environment_get_variable("IOTEDGE_EDGEHUBURI"));
+    STRICT_EXPECTED_CALL(socketio_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_SOCKETIO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, OPTION_ADDRESS_TYPE, OPTION_ADDRESS_TYPE_DOMAIN_SOCKET))
+        .ValidateArgumentValue_value_AsType(UMOCK_TYPE(char*));
+    ASSERT_IS_NOT_NULL(g_get_io_transport);
+
+    // act
+    xioTest = g_get_io_transport(TEST_STRING_VALUE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_XIO_HANDLE, xioTest);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_SOCKET_PATH, g_socketio_hostname);
+    ASSERT_ARE_EQUAL(int, 0, g_socketio_port);
+    ASSERT_IS_NULL(g_socketio_accepted_socket);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_001: [ If `mqtt_transport_proxy_options` is not NULL, `getUdsIOTransport` shall return NULL. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_UDS_getUdsIOTransport_with_proxy_options_fails)
+{
+    // arrange
+    MQTT_TRANSPORT_PROXY_OPTIONS mqtt_proxy_options;
+    XIO_HANDLE xioTest;
+    (void)create_transport();
+
+    mqtt_proxy_options.host_address = "some_host";
+    mqtt_proxy_options.port = 444;
+    mqtt_proxy_options.username = "me";
+    mqtt_proxy_options.password = "shhhh";
+
+    // act
+    xioTest = g_get_io_transport(TEST_STRING_VALUE, &mqtt_proxy_options);
+
+    // assert
+    ASSERT_IS_NULL(xioTest);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_003: [ If the variable is not set, does not start with `unix://` or has no path, `getUdsIOTransport` shall return NULL. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_UDS_getUdsIOTransport_edgehub_uri_not_set_fails)
+{
+    // arrange
+    XIO_HANDLE xioTest;
+    (void)create_transport();
+
+    STRICT_EXPECTED_CALL(environment_get_variable("IOTEDGE_EDGEHUBURI")).SetReturn(NULL);
+
+    // act
+    xioTest = g_get_io_transport(TEST_STRING_VALUE, NULL);
+
+    // assert
+    ASSERT_IS_NULL(xioTest);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_003: [ If the variable is not set, does not start with `unix://` or has no path, `getUdsIOTransport` shall return NULL. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_UDS_getUdsIOTransport_edgehub_uri_not_unix_fails)
+{
+    // arrange
+    XIO_HANDLE xioTest;
+    (void)create_transport();
+
+    STRICT_EXPECTED_CALL(environment_get_variable("IOTEDGE_EDGEHUBURI")).SetReturn("mqtts://edgeHub:8883");
+
+    // act
+    xioTest = g_get_io_transport(TEST_STRING_VALUE, NULL);
+
+    // assert
+    ASSERT_IS_NULL(xioTest);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_003: [ If the variable is not set, does not start with `unix://` or has no path, `getUdsIOTransport` shall return NULL. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_UDS_getUdsIOTransport_edgehub_uri_without_path_fails)
+{
+    // arrange
+    XIO_HANDLE xioTest;
+    (void)create_transport();
+
+    STRICT_EXPECTED_CALL(environment_get_variable("IOTEDGE_EDGEHUBURI")).SetReturn("unix://");
+
+    // act
+    xioTest = g_get_io_transport(TEST_STRING_VALUE, NULL);
+
+    // assert
+    ASSERT_IS_NULL(xioTest);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_005: [ If `socketio_get_interface_description` returns NULL, `getUdsIOTransport` shall return NULL. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_UDS_getUdsIOTransport_socketio_get_interface_description_NULL_fails)
+{
+    // arrange
+    XIO_HANDLE xioTest;
+    (void)create_transport();
+
+    STRICT_EXPECTED_CALL(environment_get_variable("IOTEDGE_EDGEHUBURI"));
+    STRICT_EXPECTED_CALL(socketio_get_interface_description()).SetReturn(NULL);
+
+    // act
+    xioTest = g_get_io_transport(TEST_STRING_VALUE, NULL);
+
+    // assert
+    ASSERT_IS_NULL(xioTest);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_007: [ If `xio_create` or `xio_setoption` fails, `getUdsIOTransport` shall return NULL. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_UDS_getUdsIOTransport_xio_create_fails)
+{
+    // arrange
+    XIO_HANDLE xioTest;
+    (void)create_transport();
+
+    STRICT_EXPECTED_CALL(environment_get_variable("IOTEDGE_EDGEHUBURI"));
+    STRICT_EXPECTED_CALL(socketio_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_SOCKETIO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG)).SetReturn(NULL);
+
+    // act
+    xioTest = g_get_io_transport(TEST_STRING_VALUE, NULL);
+
+    // assert
+    ASSERT_IS_NULL(xioTest);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_007: [ If `xio_create` or `xio_setoption` fails, `getUdsIOTransport` shall return NULL. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_UDS_getUdsIOTransport_xio_setoption_fails)
+{
+    // arrange
+    XIO_HANDLE xioTest;
+    (void)create_transport();
+
+    STRICT_EXPECTED_CALL(environment_get_variable("IOTEDGE_EDGEHUBURI"));
+    STRICT_EXPECTED_CALL(socketio_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_SOCKETIO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, OPTION_ADDRESS_TYPE, IGNORED_PTR_ARG)).SetReturn(MU_FAILURE);
+    STRICT_EXPECTED_CALL(xio_destroy(TEST_XIO_HANDLE));
+
+    // act
+    xioTest = g_get_io_transport(TEST_STRING_VALUE, NULL);
+
+    // assert
+    ASSERT_IS_NULL(xioTest);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(IoTHubTransportMqtt_UDS_Destroy_success)
+{
+    // arrange
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    STRICT_EXPECTED_CALL(IoTHubTransport_MQTT_Common_Destroy(handle));
+
+    // act
+    IoTHubTransportMqtt_UDS_Destroy(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(IoTHubTransportMqtt_UDS_DoWork_success)
+{
+    // arrange
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    STRICT_EXPECTED_CALL(IoTHubTransport_MQTT_Common_DoWork(handle));
+
+    // act
+    IoTHubTransportMqtt_UDS_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_012: [ Otherwise `IoTHubTransportMqtt_UDS_SetOption` shall call into the `IoTHubTransport_MQTT_Common_SetOption` function. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_UDS_SetOption_success)
+{
+    // arrange
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    STRICT_EXPECTED_CALL(IoTHubTransport_MQTT_Common_SetOption(handle, TEST_OPTION_NAME, TEST_OPTION_VALUE));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportMqtt_UDS_SetOption(handle, TEST_OPTION_NAME, TEST_OPTION_VALUE);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_011: [ `IoTHubTransportMqtt_UDS_SetOption` shall ignore the `OPTION_TRUSTED_CERT` option and return `IOTHUB_CLIENT_OK`. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_UDS_SetOption_trusted_cert_ignored)
+{
+    // arrange
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportMqtt_UDS_SetOption(handle, OPTION_TRUSTED_CERT, TEST_OPTION_VALUE);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_010: [ If `handle`, `option` or `value` is NULL, `IoTHubTransportMqtt_UDS_SetOption` shall return `IOTHUB_CLIENT_INVALID_ARG`. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_UDS_SetOption_NULL_handle_fails)
+{
+    // arrange
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportMqtt_UDS_SetOption(NULL, TEST_OPTION_NAME, TEST_OPTION_VALUE);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_010: [ If `handle`, `option` or `value` is NULL, `IoTHubTransportMqtt_UDS_SetOption` shall return `IOTHUB_CLIENT_INVALID_ARG`. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_UDS_SetOption_NULL_option_fails)
+{
+    // arrange
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportMqtt_UDS_SetOption(handle, NULL, TEST_OPTION_VALUE);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_010: [ If `handle`, `option` or `value` is NULL, `IoTHubTransportMqtt_UDS_SetOption` shall return `IOTHUB_CLIENT_INVALID_ARG`. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_UDS_SetOption_NULL_value_fails)
+{
+    // arrange
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportMqtt_UDS_SetOption(handle, TEST_OPTION_NAME, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_UDS_TRANSPORT_09_013: [ `MQTT_UDS_Protocol` shall return a pointer to a structure of type TRANSPORT_PROVIDER whose other functions call into the IoTHubTransport_MQTT_Common functions. ] */
+TEST_FUNCTION(MQTT_UDS_Protocol_success)
+{
+    // arrange
+
+    // act
+    const TRANSPORT_PROVIDER* provider = MQTT_UDS_Protocol();
+
+    // assert
+    ASSERT_IS_NOT_NULL(provider);
+    ASSERT_IS_NOT_NULL(provider->IoTHubTransport_Register);
+    ASSERT_IS_NOT_NULL(provider->IoTHubTransport_GetSupportedPlatformInfo);
+}
+
+END_TEST_SUITE(iothubtransportmqtt_uds_ut)
@@ -42,7 +42,7 @@ void real_free(void* ptr)
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/optionhandler.h"
 #include "azure_c_shared_utility/agenttime.h"
-#include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
 #undef ENABLE_MOCKS
 
 #include "internal/message_queue.h"
@@ -69,8 +69,6 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define USE_DEFAULT_CONFIG                  NULL
 #define TEST_SOME_OTHER_MESSAGE             (MQ_MESSAGE_HANDLE)0x7777
 #define TEST_MQ_MESSAGE_HANDLE_2            (MQ_MESSAGE_HANDLE)0x7778
-#define TEST_LIST_ITEM_HANDLE               (LIST_ITEM_HANDLE)0x7779
-#define TEST_LIST_ITEM_VALUE                (void*)0x7780
 #define TEST_REASON                         (void*)0x7781
 
 
@@ -82,12 +80,8 @@ typedef struct TEST_MESSAGE_EXPIRATION_PROFILE_TAG
 {
     double max_message_enqueued_time_secs;
     double max_message_processing_time_secs;
-    size_t* expired_pending_messages;
-    size_t expired_pending_messages_size;
-    size_t* expired_enqueued_in_progress_messages;
-    size_t expired_enqueued_in_progress_messages_size;
-    size_t* expired_in_progress_messages;
-    size_t expired_in_progress_messages_size;
+    size_t expired_enqueued_messages;        // Oldest messages (pending or in progress) past max_message_enqueued_time_secs.
+    size_t expired_in_progress_messages;     // Oldest in-progress messages past max_message_processing_time_secs.
 } TEST_MESSAGE_EXPIRATION_PROFILE;
 
 static TEST_MESSAGE_EXPIRATION_PROFILE TEST_test_message_expiration_profile;
@@ -134,14 +128,13 @@ extern "C"
 {
 #endif
 
-    SINGLYLINKEDLIST_HANDLE real_singlylinkedlist_create(void);
-    void real_singlylinkedlist_destroy(SINGLYLINKEDLIST_HANDLE list);
-    LIST_ITEM_HANDLE real_singlylinkedlist_add(SINGLYLINKEDLIST_HANDLE list, const void* item);
-    int real_singlylinkedlist_remove(SINGLYLINKEDLIST_HANDLE list, LIST_ITEM_HANDLE item_handle);
-    LIST_ITEM_HANDLE real_singlylinkedlist_get_head_item(SINGLYLINKEDLIST_HANDLE list);
-    LIST_ITEM_HANDLE real_singlylinkedlist_get_next_item(LIST_ITEM_HANDLE item_handle);
-    LIST_ITEM_HANDLE real_singlylinkedlist_find(SINGLYLINKEDLIST_HANDLE list, LIST_MATCH_FUNCTION match_function, const void* match_context);
-    const void* real_singlylinkedlist_item_get_value(LIST_ITEM_HANDLE item_handle);
+    void real_DList_InitializeListHead(PDLIST_ENTRY listHead);
+    int real_DList_IsListEmpty(const PDLIST_ENTRY listHead);
+    void real_DList_InsertTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_InsertHeadList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_AppendTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY ListToAppend);
+    int real_DList_RemoveEntryList(PDLIST_ENTRY listEntry);
+    PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY listHead);
 
 #ifdef __cplusplus
 }
@@ -224,42 +217,30 @@ static MESSAGE_QUEUE_CONFIG* get_message_queue_config()
 static void set_message_queue_create_expected_calls()
 {
     STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(singlylinkedlist_create());
-    STRICT_EXPECTED_CALL(singlylinkedlist_create());
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
 }
 
 static void set_dequeue_message_and_fire_callback_expected_calls()
 {
-    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
 }
 
 static void set_retry_sending_message_expected_calls()
 {
-    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 }
 
-static void set_on_message_processing_completed_callback_expected_calls(int number_of_messages, int message_order_in_list, bool should_retry)
+static void set_on_message_processing_completed_callback_expected_calls(bool is_message_in_progress, bool should_retry)
 {
-    int i;
-
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-
-    for (i = 0; i < number_of_messages; i++)
+    // Looking up the message in the in-progress index does not invoke any dependencies.
+    if (is_message_in_progress)
     {
-        // Invoked by singlylinkedlist_find.
-        STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-
-        if (i == message_order_in_list) break;
-    }
-
-    if (i == message_order_in_list)
-    {
-        STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-
         if (should_retry)
         {
             set_retry_sending_message_expected_calls();
@@ -275,29 +256,28 @@ static void set_message_queue_remove_all_expected_calls(size_t number_of_message
 {
     size_t i;
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-
-    for (i = 0; i < number_of_messages_pending; i++)
+    for (i = 0; i < number_of_messages_in_progress; i++)
     {
+        STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
         set_dequeue_message_and_fire_callback_expected_calls();
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
     }
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
 
-    for (i = 0; i < number_of_messages_in_progress; i++)
+    for (i = 0; i < number_of_messages_pending; i++)
     {
+        STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
         set_dequeue_message_and_fire_callback_expected_calls();
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
     }
+
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
 }
 
 static void set_message_queue_destroy_expected_calls(size_t number_of_messages_pending, size_t number_of_messages_in_progress)
 {
     set_message_queue_remove_all_expected_calls(number_of_messages_pending, number_of_messages_in_progress);
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_destroy(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(singlylinkedlist_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
 }
 
@@ -305,7 +285,8 @@ static void set_message_queue_add_expected_calls(time_t current_time)
 {
     STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
-    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 }
 
 static void add_messages(MESSAGE_QUEUE_HANDLE mq, size_t number_of_messages, time_t current_time)
@@ -333,8 +314,9 @@ static MESSAGE_QUEUE_HANDLE create_message_queue(MESSAGE_QUEUE_CONFIG* config)
     return message_queue_create(config);
 }
 
+// `number_of_messages_in_progress` is the number of in-progress messages left after the enqueue-time expirations.
 static void set_process_timeouts_expected_calls(MESSAGE_QUEUE_HANDLE mq, time_t current_time,
-    size_t number_of_messages_pending, size_t number_of_messages_in_progress,
+    size_t number_of_messages, size_t number_of_messages_in_progress,
     TEST_MESSAGE_EXPIRATION_PROFILE* expiration_profile
     )
 {
@@ -343,77 +325,41 @@ static void set_process_timeouts_expected_calls(MESSAGE_QUEUE_HANDLE mq, time_t
 
     if (expiration_profile->max_message_enqueued_time_secs > 0)
     {
-        size_t i, j;
-
-        // pending messages, max queued time
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+        size_t i;
 
-        for (i = 0, j = 0; i < number_of_messages_pending; i++)
+        // all messages, oldest first, max queued time
+        for (i = 0; i < expiration_profile->expired_enqueued_messages; i++)
         {
-            STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-            STRICT_EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
-
-            if (j < expiration_profile->expired_pending_messages_size && i == expiration_profile->expired_pending_messages[j])
-            {
-                STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(expiration_profile->max_message_enqueued_time_secs + 1);
-                set_dequeue_message_and_fire_callback_expected_calls();
-                number_of_messages_pending--;
-                j++;
-            }
-            else
-            {
-                STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(0);
-                break;
-            }
+            STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+            STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(expiration_profile->max_message_enqueued_time_secs + 1);
+            set_dequeue_message_and_fire_callback_expected_calls();
         }
 
-        // in progress messages, max queued time
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
 
-        for (i = 0, j = 0; i < number_of_messages_in_progress; i++)
+        if (number_of_messages > expiration_profile->expired_enqueued_messages)
         {
-            STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-            STRICT_EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
-
-            if (j < expiration_profile->expired_enqueued_in_progress_messages_size && i == expiration_profile->expired_enqueued_in_progress_messages[j])
-            {
-                STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(expiration_profile->max_message_enqueued_time_secs + 1);
-                set_dequeue_message_and_fire_callback_expected_calls();
-                //set_dequeue_message_and_fire_callback_expected_calls(number_of_messages_in_progress, expiration_profile->expired_enqueued_in_progress_messages[j] - i, false);
-                number_of_messages_in_progress--;
-                j++;
-            }
-            else
-            {
-                STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(0);
-            }
+            STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(0);
         }
     }
 
     if (expiration_profile->max_message_processing_time_secs > 0)
     {
-        size_t i, j;
+        size_t i;
+
+        // in progress messages, oldest first, max in progress time
+        for (i = 0; i < expiration_profile->expired_in_progress_messages; i++)
+        {
+            STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+            STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(expiration_profile->max_message_processing_time_secs + 1);
+            set_dequeue_message_and_fire_callback_expected_calls();
+        }
 
-        // in progress messages, max in progress time
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
 
-        for (i = 0, j = 0; i < number_of_messages_in_progress; i++)
+        if (number_of_messages_in_progress > expiration_profile->expired_in_progress_messages)
         {
-            STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-            STRICT_EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
-
-            if (j < expiration_profile->expired_in_progress_messages_size && i == expiration_profile->expired_in_progress_messages[j])
-            {
-                STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(expiration_profile->max_message_processing_time_secs + 1);
-                set_dequeue_message_and_fire_callback_expected_calls();
-                number_of_messages_in_progress--;
-                j++;
-            }
-            else
-            {
-                STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(0);
-                break;
-            }
+            STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(0);
         }
     }
 }
@@ -421,26 +367,24 @@ static void set_process_timeouts_expected_calls(MESSAGE_QUEUE_HANDLE mq, time_t
 static void set_process_pending_messages_calls(MESSAGE_QUEUE_HANDLE mq, time_t current_time, size_t number_of_messages_pending)
 {
     (void)mq;
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
 
     size_t i;
 
     for (i = 0; i < number_of_messages_pending; i++)
     {
-        STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
-        STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     }
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
 }
 
 static void set_message_queue_do_work_expected_calls(MESSAGE_QUEUE_HANDLE mq, time_t current_time,
     size_t number_of_messages_pending, size_t number_of_messages_in_progress,
     TEST_MESSAGE_EXPIRATION_PROFILE* expiration_profile)
 {
-    set_process_timeouts_expected_calls(mq, current_time, number_of_messages_pending, number_of_messages_in_progress, expiration_profile);
+    set_process_timeouts_expected_calls(mq, current_time, number_of_messages_pending + number_of_messages_in_progress, number_of_messages_in_progress, expiration_profile);
     set_process_pending_messages_calls(mq, current_time, number_of_messages_pending);
 }
 
@@ -462,12 +406,26 @@ static void set_message_queue_is_empty_expected_calls(size_t number_of_messages_
 {
     (void)number_of_messages_in_progress;
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
 
     if (number_of_messages_pending == 0) // this statement will only be evaluated if the first boolean check (in code) succeeds.
     {
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    }
+}
+
+static void set_message_queue_move_all_back_to_pending_expected_calls(size_t number_of_messages_in_progress)
+{
+    size_t i;
+
+    for (i = 0; i < number_of_messages_in_progress; i++)
+    {
+        STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(DList_InsertHeadList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     }
+
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
 }
 
 static void set_message_queue_retrieve_options_expected_calls()
@@ -502,12 +460,8 @@ static void reset_test_data()
     TEST_on_message_processing_completed_callback_ERROR_result_count = 0;
     TEST_on_message_processing_completed_callback_TIMEOUT_result_count = 0;
 
-    TEST_test_message_expiration_profile.expired_enqueued_in_progress_messages = NULL;
-    TEST_test_message_expiration_profile.expired_enqueued_in_progress_messages_size = 0;
-    TEST_test_message_expiration_profile.expired_in_progress_messages = NULL;
-    TEST_test_message_expiration_profile.expired_in_progress_messages_size = 0;
-    TEST_test_message_expiration_profile.expired_pending_messages = NULL;
-    TEST_test_message_expiration_profile.expired_pending_messages_size = 0;
+    TEST_test_message_expiration_profile.expired_enqueued_messages = 0;
+    TEST_test_message_expiration_profile.expired_in_progress_messages = 0;
     TEST_test_message_expiration_profile.max_message_enqueued_time_secs = 0;
     TEST_test_message_expiration_profile.max_message_processing_time_secs = 0;
 }
@@ -520,9 +474,8 @@ static void register_umock_alias_types()
     REGISTER_UMOCK_ALIAS_TYPE(pfCloneOption, void*);
     REGISTER_UMOCK_ALIAS_TYPE(pfDestroyOption, void*);
     REGISTER_UMOCK_ALIAS_TYPE(pfSetOption, void*);
-    REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
-    REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
-    REGISTER_UMOCK_ALIAS_TYPE(LIST_MATCH_FUNCTION, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, void*);
     REGISTER_UMOCK_ALIAS_TYPE(MQ_MESSAGE_HANDLE, void*);
 }
 
@@ -531,14 +484,13 @@ static void register_global_mock_hooks()
     REGISTER_GLOBAL_MOCK_HOOK(malloc, TEST_malloc);
     REGISTER_GLOBAL_MOCK_HOOK(free, TEST_free);
     REGISTER_GLOBAL_MOCK_HOOK(OptionHandler_AddOption, TEST_OptionHandler_AddOption);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_create, real_singlylinkedlist_create);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_destroy, real_singlylinkedlist_destroy);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_add, real_singlylinkedlist_add);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_remove, real_singlylinkedlist_remove);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_head_item, real_singlylinkedlist_get_head_item);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_next_item, real_singlylinkedlist_get_next_item);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_find, real_singlylinkedlist_find);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_item_get_value, real_singlylinkedlist_item_get_value);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_IsListEmpty, real_DList_IsListEmpty);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, real_DList_InsertTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertHeadList, real_DList_InsertHeadList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_AppendTailList, real_DList_AppendTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
 }
 
 static void register_global_mock_returns()
@@ -552,17 +504,7 @@ static void register_global_mock_returns()
     REGISTER_GLOBAL_MOCK_RETURN(OptionHandler_FeedOptions, OPTIONHANDLER_OK);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(OptionHandler_FeedOptions, OPTIONHANDLER_ERROR);
 
-    REGISTER_GLOBAL_MOCK_RETURN(singlylinkedlist_add, TEST_LIST_ITEM_HANDLE);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_add, NULL);
-
-    REGISTER_GLOBAL_MOCK_RETURN(singlylinkedlist_remove, 0);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_remove, 1);
-
-    REGISTER_GLOBAL_MOCK_RETURN(singlylinkedlist_get_head_item, TEST_LIST_ITEM_HANDLE);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_get_head_item, NULL);
-
-    REGISTER_GLOBAL_MOCK_RETURN(singlylinkedlist_item_get_value, TEST_LIST_ITEM_VALUE);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_item_get_value, NULL);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(malloc, NULL);
 
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(get_time, INDEFINITE_TIME);
 }
@@ -669,8 +611,7 @@ TEST_FUNCTION(create_NULL_on_process_message_callback)
 }
 
 // Tests_SRS_MESSAGE_QUEUE_09_005: [If `instance` cannot be allocated, message_queue_create shall fail and return NULL]
-// Tests_SRS_MESSAGE_QUEUE_09_007: [If singlylinkedlist_create fails, message_queue_create shall fail and return NULL]
-// Tests_SRS_MESSAGE_QUEUE_09_009: [If singlylinkedlist_create fails, message_queue_create shall fail and return NULL]
+// Tests_SRS_MESSAGE_QUEUE_09_075: [If `message_queue->in_progress_index` cannot be allocated, message_queue_create shall fail and return NULL]
 // Tests_SRS_MESSAGE_QUEUE_09_011: [If any failures occur, message_queue_create shall release all memory it has allocated]
 TEST_FUNCTION(create_failure_checks)
 {
@@ -684,6 +625,11 @@ TEST_FUNCTION(create_failure_checks)
     size_t i;
     for (i = 0; i < umock_c_negative_tests_call_count(); i++)
     {
+        if (!umock_c_negative_tests_can_call_fail(i))
+        {
+            continue;
+        }
+
         // arrange
         char error_msg[64];
         sprintf(error_msg, "On failed call %lu", (unsigned long)i);
@@ -705,8 +651,8 @@ TEST_FUNCTION(create_failure_checks)
 }
 
 // Tests_SRS_MESSAGE_QUEUE_09_004: [Memory shall be allocated for the MESSAGE_QUEUE data structure (aka `message_queue`)]
-// Tests_SRS_MESSAGE_QUEUE_09_006: [`message_queue->pending` shall be set using singlylinkedlist_create()]
-// Tests_SRS_MESSAGE_QUEUE_09_008: [`message_queue->in_progress` shall be set using singlylinkedlist_create()]
+// Tests_SRS_MESSAGE_QUEUE_09_006: [`message_queue->pending`, `message_queue->in_progress` and `message_queue->by_enqueue_time` shall be initialized using DList_InitializeListHead()]
+// Tests_SRS_MESSAGE_QUEUE_09_074: [`message_queue->in_progress_index` shall be allocated with DEFAULT_IN_PROGRESS_INDEX_SIZE buckets]
 // Tests_SRS_MESSAGE_QUEUE_09_010: [All arguments in `config` shall be saved into `message_queue`]
 // Tests_SRS_MESSAGE_QUEUE_09_012: [If no failures occur, message_queue_create shall return the `message_queue` pointer]
 TEST_FUNCTION(create_success)
@@ -844,7 +790,7 @@ TEST_FUNCTION(add_NULL_message_handle)
 
 // Tests_SRS_MESSAGE_QUEUE_09_017: [message_queue_add shall allocate a structure (aka `mq_item`) to save the `message`]
 // Tests_SRS_MESSAGE_QUEUE_09_019: [`mq_item->enqueue_time` shall be set using get_time()]
-// Tests_SRS_MESSAGE_QUEUE_09_021: [`mq_item` shall be added to `message_queue->pending` list]
+// Tests_SRS_MESSAGE_QUEUE_09_021: [`mq_item` shall be added to the tail of `message_queue->pending` and `message_queue->by_enqueue_time`]
 // Tests_SRS_MESSAGE_QUEUE_09_023: [`message` shall be saved into `mq_item->message`]
 // Tests_SRS_MESSAGE_QUEUE_09_025: [If no failures occur, message_queue_add shall return 0]
 TEST_FUNCTION(add_success)
@@ -868,7 +814,6 @@ TEST_FUNCTION(add_success)
 
 // Tests_SRS_MESSAGE_QUEUE_09_018: [If `mq_item` cannot be allocated, message_queue_add shall fail and return non-zero]
 // Tests_SRS_MESSAGE_QUEUE_09_020: [If get_time fails, message_queue_add shall fail and return non-zero]
-// Tests_SRS_MESSAGE_QUEUE_09_022: [`mq_item` fails to be added to `message_queue->pending`, message_queue_add shall fail and return non-zero]
 // Tests_SRS_MESSAGE_QUEUE_09_024: [If any failures occur, message_queue_add shall release all memory it has allocated]
 TEST_FUNCTION(add_failure_checks)
 {
@@ -883,6 +828,11 @@ TEST_FUNCTION(add_failure_checks)
     size_t i;
     for (i = 0; i < umock_c_negative_tests_call_count(); i++)
     {
+        if (!umock_c_negative_tests_can_call_fail(i))
+        {
+            continue;
+        }
+
         // arrange
         char error_msg[64];
         sprintf(error_msg, "On failed call %lu", (unsigned long)i);
@@ -1081,64 +1031,37 @@ TEST_FUNCTION(do_work_NO_EXPIRATION_success)
     message_queue_destroy(mq);
 }
 
-// Tests_SRS_MESSAGE_QUEUE_09_041: [If get_time() fails, `mq_item` shall be removed from `message_queue->in_progress`]
+// Tests_SRS_MESSAGE_QUEUE_09_041: [If get_time() fails, `mq_item` shall be removed from `message_queue->by_enqueue_time`]
 // Tests_SRS_MESSAGE_QUEUE_09_042: [If any failures occur, `mq_item->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_ERROR and `mq_item` freed]
-TEST_FUNCTION(do_work_NO_EXPIRATION_failure_checks)
+TEST_FUNCTION(do_work_NO_EXPIRATION_get_time_fails)
 {
     // arrange
-    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
     MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
 
-    size_t i, j;
-    for (i = 0, j = 1; i < j; i++)
-    {
-        if (i == 6)
-        {
-            continue;
-        }
-
-        // arrange
-        TEST_on_message_processing_completed_callback_message = NULL;
-        TEST_on_message_processing_completed_callback_result = MESSAGE_QUEUE_TIMEOUT;
-
-        char error_msg[64];
-        sprintf(error_msg, "On failed call %lu", (unsigned long)i);
-
-        if (i >= 3 && i != 4)
-        {
-            add_messages(mq, 1, TEST_current_time);
-        }
-
-        umock_c_reset_all_calls();
-        set_message_queue_do_work_expected_calls(mq, TEST_current_time, 1, 0, &TEST_test_message_expiration_profile);
-        umock_c_negative_tests_snapshot();
-
-        j = umock_c_negative_tests_call_count();
-
-        umock_c_negative_tests_reset();
-        umock_c_negative_tests_fail_call(i);
+    add_messages(mq, 1, TEST_current_time);
 
-        // act
-        message_queue_do_work(mq);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(TEST_current_time);
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(INDEFINITE_TIME);
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
 
-        // assert
-        if (i == 1 || i == 2)
-        {
-            ASSERT_IS_NULL(TEST_on_process_message_callback_message, error_msg);
-            ASSERT_IS_NULL(TEST_on_message_processing_completed_callback_message, error_msg);
-        }
-        else if (i >= 3)
-        {
-            ASSERT_IS_NOT_NULL(TEST_on_message_processing_completed_callback_message, error_msg);
-            ASSERT_ARE_EQUAL(int, (int)MESSAGE_QUEUE_ERROR, (int)TEST_on_message_processing_completed_callback_result, error_msg);
-        }
+    // act
+    message_queue_do_work(mq);
 
-        umock_c_reset_all_calls();
-    }
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(TEST_on_process_message_callback_message);
+    ASSERT_ARE_EQUAL(void_ptr, (void_ptr)TEST_BASE_MQ_MESSAGE_HANDLE[0], (void_ptr)TEST_on_message_processing_completed_callback_message);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_QUEUE_ERROR, (int)TEST_on_message_processing_completed_callback_result);
 
     // cleanup
+    umock_c_reset_all_calls();
+    set_message_queue_destroy_expected_calls(0, 0);
     message_queue_destroy(mq);
-    umock_c_negative_tests_deinit();
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
 // Tests_SRS_MESSAGE_QUEUE_09_059: [If `message_queue` is NULL, message_queue_set_max_retry_count shall fail and return non-zero]
@@ -1387,7 +1310,7 @@ TEST_FUNCTION(on_message_processing_completed_callback_MESSAGE_not_present)
     crank_message_queue(mq, TEST_current_time, 1, 0, NULL);
 
     umock_c_reset_all_calls();
-    set_on_message_processing_completed_callback_expected_calls(1, -1, false);
+    set_on_message_processing_completed_callback_expected_calls(false, false);
 
     // act
     TEST_on_process_message_callback_on_process_message_completed_callback(mq, TEST_SOME_OTHER_MESSAGE, MESSAGE_QUEUE_SUCCESS, TEST_REASON);
@@ -1419,7 +1342,7 @@ TEST_FUNCTION(on_message_processing_completed_callback_success)
     ASSERT_ARE_EQUAL(void_ptr, (void*)TEST_USER_CONTEXT, (void*)TEST_on_process_message_callback_context);
 
     umock_c_reset_all_calls();
-    set_on_message_processing_completed_callback_expected_calls(1, 0, false);
+    set_on_message_processing_completed_callback_expected_calls(true, false);
 
     // act
     TEST_on_process_message_callback_on_process_message_completed_callback(mq, TEST_on_process_message_callback_message, MESSAGE_QUEUE_SUCCESS, TEST_REASON);
@@ -1448,11 +1371,11 @@ TEST_FUNCTION(on_message_processing_completed_callback_RETRYABLE_ERROR)
     crank_message_queue(mq, TEST_current_time, 1, 0, NULL);
 
     umock_c_reset_all_calls();
-    set_on_message_processing_completed_callback_expected_calls(1, 0, true);
+    set_on_message_processing_completed_callback_expected_calls(true, true);
     set_message_queue_do_work_expected_calls(mq, TEST_current_time, 1, 0, &TEST_test_message_expiration_profile);
-    set_on_message_processing_completed_callback_expected_calls(1, 0, true);
+    set_on_message_processing_completed_callback_expected_calls(true, true);
     set_message_queue_do_work_expected_calls(mq, TEST_current_time, 1, 0, &TEST_test_message_expiration_profile);
-    set_on_message_processing_completed_callback_expected_calls(1, 0, false);
+    set_on_message_processing_completed_callback_expected_calls(true, false);
 
     // act
     TEST_on_process_message_callback_on_process_message_completed_callback(mq,
@@ -1491,13 +1414,8 @@ TEST_FUNCTION(do_work_pending_queue_timeout)
     TEST_MESSAGE_EXPIRATION_PROFILE exp_prof;
     exp_prof.max_message_enqueued_time_secs = 10;
     exp_prof.max_message_processing_time_secs = 0;
-    size_t expired_pending_messages[] = { 0 };
-    exp_prof.expired_pending_messages = expired_pending_messages;
-    exp_prof.expired_pending_messages_size = 1;
-    exp_prof.expired_in_progress_messages = NULL;
-    exp_prof.expired_in_progress_messages_size = 0;
-    exp_prof.expired_enqueued_in_progress_messages = NULL;
-    exp_prof.expired_enqueued_in_progress_messages_size = 0;
+    exp_prof.expired_enqueued_messages = 1;
+    exp_prof.expired_in_progress_messages = 0;
 
     umock_c_reset_all_calls();
     set_process_timeouts_expected_calls(mq, t1, 1, 0, &exp_prof);
@@ -1534,16 +1452,11 @@ TEST_FUNCTION(do_work_in_progress_processing_timeout)
     TEST_MESSAGE_EXPIRATION_PROFILE exp_prof;
     exp_prof.max_message_enqueued_time_secs = 0;
     exp_prof.max_message_processing_time_secs = 10;
-    exp_prof.expired_pending_messages = NULL;
-    exp_prof.expired_pending_messages_size = 0;
-    size_t expired_in_progress_messages[] = { 0 };
-    exp_prof.expired_in_progress_messages = expired_in_progress_messages;
-    exp_prof.expired_in_progress_messages_size = 1;
-    exp_prof.expired_enqueued_in_progress_messages = NULL;
-    exp_prof.expired_enqueued_in_progress_messages_size = 0;
+    exp_prof.expired_enqueued_messages = 0;
+    exp_prof.expired_in_progress_messages = 1;
 
     umock_c_reset_all_calls();
-    set_process_timeouts_expected_calls(mq, t1, 0, 1, &exp_prof);
+    set_process_timeouts_expected_calls(mq, t1, 1, 1, &exp_prof);
     set_process_pending_messages_calls(mq, t1, 0);
 
     // act
@@ -1577,16 +1490,11 @@ TEST_FUNCTION(do_work_in_progress_queue_timeout)
     TEST_MESSAGE_EXPIRATION_PROFILE exp_prof;
     exp_prof.max_message_enqueued_time_secs = 10;
     exp_prof.max_message_processing_time_secs = 0;
-    exp_prof.expired_pending_messages = NULL;
-    exp_prof.expired_pending_messages_size = 0;
-    exp_prof.expired_in_progress_messages = NULL;
-    exp_prof.expired_in_progress_messages_size = 0;
-    size_t expired_enqueued_in_progress_messages[] = { 0 };
-    exp_prof.expired_enqueued_in_progress_messages = expired_enqueued_in_progress_messages;
-    exp_prof.expired_enqueued_in_progress_messages_size = 1;
+    exp_prof.expired_enqueued_messages = 1;
+    exp_prof.expired_in_progress_messages = 0;
 
     umock_c_reset_all_calls();
-    set_process_timeouts_expected_calls(mq, t1, 0, 1, &exp_prof);
+    set_process_timeouts_expected_calls(mq, t1, 1, 0, &exp_prof);
     set_process_pending_messages_calls(mq, t1, 0);
 
     // act
@@ -1610,22 +1518,11 @@ TEST_FUNCTION(message_queue_move_all_back_to_pending_with_in_progress_and_pendin
     MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
 
     add_messages(mq, 2, TEST_current_time);
-    crank_message_queue(mq, TEST_current_time, 1, 0, NULL);
-    add_messages(mq, 2, TEST_current_time);
+    crank_message_queue(mq, TEST_current_time, 2, 0, NULL);
+    add_messages(mq, 3, TEST_current_time);
 
     umock_c_reset_all_calls();
-    for (int i = 0; i < 2; i++)
-    {
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-        set_retry_sending_message_expected_calls();
-    }
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-    for (int i = 0; i < 4; i++)
-    {
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-        set_retry_sending_message_expected_calls();
-    }
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    set_message_queue_move_all_back_to_pending_expected_calls(2);
 
     // act
     int result = message_queue_move_all_back_to_pending(mq);
@@ -1634,26 +1531,25 @@ TEST_FUNCTION(message_queue_move_all_back_to_pending_with_in_progress_and_pendin
     ASSERT_ARE_EQUAL(int, 0, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
+    crank_message_queue(mq, TEST_current_time, 5, 0, NULL);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, (void_ptr)TEST_BASE_MQ_MESSAGE_HANDLE[2], (void_ptr)TEST_on_process_message_callback_message);
+
     // cleanup
     message_queue_destroy(mq);
 }
 
+// Tests_SRS_MESSAGE_QUEUE_21_070: [The message_queue_move_all_back_to_pending shall add all in_progress message in front of the pending messages.]
 TEST_FUNCTION(message_queue_move_all_back_to_pending_with_only_in_progress_succeed)
 {
     // arrange
     MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
 
     add_messages(mq, 2, TEST_current_time);
-    crank_message_queue(mq, TEST_current_time, 1, 0, NULL);
+    crank_message_queue(mq, TEST_current_time, 2, 0, NULL);
 
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-    for (int i = 0; i < 2; i++)
-    {
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-        set_retry_sending_message_expected_calls();
-    }
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    set_message_queue_move_all_back_to_pending_expected_calls(2);
 
     // act
     int result = message_queue_move_all_back_to_pending(mq);
@@ -1666,6 +1562,7 @@ TEST_FUNCTION(message_queue_move_all_back_to_pending_with_only_in_progress_succe
     message_queue_destroy(mq);
 }
 
+// Tests_SRS_MESSAGE_QUEUE_21_070: [The message_queue_move_all_back_to_pending shall add all in_progress message in front of the pending messages.]
 TEST_FUNCTION(message_queue_move_all_back_to_pending_with_only_pending_succeed)
 {
     // arrange
@@ -1674,18 +1571,7 @@ TEST_FUNCTION(message_queue_move_all_back_to_pending_with_only_pending_succeed)
     add_messages(mq, 2, TEST_current_time);
 
     umock_c_reset_all_calls();
-    for (int i = 0; i < 2; i++)
-    {
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-        set_retry_sending_message_expected_calls();
-    }
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-    for (int i = 0; i < 2; i++)
-    {
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-        set_retry_sending_message_expected_calls();
-    }
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    set_message_queue_move_all_back_to_pending_expected_calls(0);
 
     // act
     int result = message_queue_move_all_back_to_pending(mq);
@@ -1713,78 +1599,78 @@ TEST_FUNCTION(message_queue_move_all_back_to_pending_null_message_queue_failed)
     // cleanup
 }
 
-// Tests_SRS_MESSAGE_QUEUE_21_072: [If move pending messages failed, the message_queue_move_all_back_to_pending shall delete all elements in the queue and return non-zero.]
-TEST_FUNCTION(message_queue_move_all_back_to_pending_move_pending_failed)
+// Tests_SRS_MESSAGE_QUEUE_09_045: [If `message` is present in `message_queue->in_progress`, it shall be removed]
+// Tests_SRS_MESSAGE_QUEUE_09_050: [The `mq_item` related to `message` shall be freed]
+TEST_FUNCTION(on_message_processing_completed_callback_out_of_order_success)
 {
     // arrange
     MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
 
-    add_messages(mq, 2, TEST_current_time);
-    crank_message_queue(mq, TEST_current_time, 1, 0, NULL);
-    add_messages(mq, 2, TEST_current_time);
+    add_messages(mq, 3, TEST_current_time);
+    crank_message_queue(mq, TEST_current_time, 3, 0, NULL);
 
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn(1);
-    for (int i = 0; i < 2; i++)
-    {
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-        set_dequeue_message_and_fire_callback_expected_calls();
-    }
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-    for (int i = 0; i < 2; i++)
-    {
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-        set_dequeue_message_and_fire_callback_expected_calls();
-    }
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    set_on_message_processing_completed_callback_expected_calls(true, false);
+    set_on_message_processing_completed_callback_expected_calls(false, false);
 
     // act
-    int result = message_queue_move_all_back_to_pending(mq);
+    TEST_on_process_message_callback_on_process_message_completed_callback(mq, TEST_BASE_MQ_MESSAGE_HANDLE[1], MESSAGE_QUEUE_SUCCESS, TEST_REASON);
+    TEST_on_process_message_callback_on_process_message_completed_callback(mq, TEST_BASE_MQ_MESSAGE_HANDLE[1], MESSAGE_QUEUE_SUCCESS, TEST_REASON);
 
     // assert
-    ASSERT_ARE_NOT_EQUAL(int, 0, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 1, (int)TEST_on_message_processing_completed_callback_SUCCESS_result_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void_ptr)TEST_BASE_MQ_MESSAGE_HANDLE[1], (void_ptr)TEST_on_message_processing_completed_callback_message);
+
+    umock_c_reset_all_calls();
+    set_message_queue_remove_all_expected_calls(0, 2);
+    message_queue_remove_all(mq);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 2, (int)TEST_on_message_processing_completed_callback_CANCELLED_result_count);
 
     // cleanup
     message_queue_destroy(mq);
 }
 
-// Tests_SRS_MESSAGE_QUEUE_21_073: [If move in_progress messages failed, the message_queue_move_all_back_to_pending shall delete all elements in the queue and return non-zero.]
-TEST_FUNCTION(message_queue_move_all_back_to_pending_move_in_progress_failed)
+// Tests_SRS_MESSAGE_QUEUE_09_035: [If `message_queue->max_message_enqueued_time_secs` is greater than zero, `message_queue->by_enqueue_time` items shall be checked for timeout, oldest first, until one has not expired]
+// Tests_SRS_MESSAGE_QUEUE_09_036: [If any items are in `message_queue` lists for `message_queue->max_message_enqueued_time_secs` or more, they shall be removed and `message_queue->on_message_processing_completed_callback` invoked with MESSAGE_QUEUE_TIMEOUT]
+TEST_FUNCTION(do_work_retried_message_queue_timeout)
 {
     // arrange
     MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+    (void)message_queue_set_max_retry_count(mq, 1);
 
-    add_messages(mq, 2, TEST_current_time);
+    add_messages(mq, 1, TEST_current_time);
     crank_message_queue(mq, TEST_current_time, 1, 0, NULL);
-    add_messages(mq, 2, TEST_current_time);
 
+    // TEST_BASE_MQ_MESSAGE_HANDLE[0] is retried, ending up in `pending` behind the newer TEST_BASE_MQ_MESSAGE_HANDLE[1].
     umock_c_reset_all_calls();
-    for (int i = 0; i < 2; i++)
-    {
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-        set_retry_sending_message_expected_calls();
-    }
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn(1);
-    for (int i = 0; i < 4; i++)
-    {
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-        set_dequeue_message_and_fire_callback_expected_calls();
-    }
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    set_message_queue_add_expected_calls(add_seconds(TEST_current_time, 5));
+    (void)message_queue_add(mq, TEST_BASE_MQ_MESSAGE_HANDLE[1], TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT);
+    TEST_on_process_message_callback_on_process_message_completed_callback(mq, TEST_BASE_MQ_MESSAGE_HANDLE[0], MESSAGE_QUEUE_RETRYABLE_ERROR, NULL);
+
+    (void)message_queue_set_max_message_enqueued_time_secs(mq, 10);
+
+    time_t t1 = add_seconds(TEST_current_time, 10);
+
+    TEST_MESSAGE_EXPIRATION_PROFILE exp_prof;
+    exp_prof.max_message_enqueued_time_secs = 10;
+    exp_prof.max_message_processing_time_secs = 0;
+    exp_prof.expired_enqueued_messages = 1;
+    exp_prof.expired_in_progress_messages = 0;
+
+    umock_c_reset_all_calls();
+    set_process_timeouts_expected_calls(mq, t1, 2, 0, &exp_prof);
+    set_process_pending_messages_calls(mq, t1, 1);
 
     // act
-    int result = message_queue_move_all_back_to_pending(mq);
+    message_queue_do_work(mq);
 
     // assert
-    ASSERT_ARE_NOT_EQUAL(int, 0, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 1, (int)TEST_on_message_processing_completed_callback_TIMEOUT_result_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void_ptr)TEST_BASE_MQ_MESSAGE_HANDLE[0], (void_ptr)TEST_on_message_processing_completed_callback_message);
+    ASSERT_ARE_EQUAL(void_ptr, (void_ptr)TEST_BASE_MQ_MESSAGE_HANDLE[1], (void_ptr)TEST_on_process_message_callback_message);
 
     // cleanup
     message_queue_destroy(mq);
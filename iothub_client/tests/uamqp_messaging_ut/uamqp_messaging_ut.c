@@ -15,6 +15,11 @@ static void* real_malloc(size_t size)
     return malloc(size);
 }
 
+static void* real_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
 static void real_free(void* ptr)
 {
     free(ptr);
@@ -40,6 +45,28 @@ static void* TEST_malloc(size_t size)
     return saved_malloc_returns[saved_malloc_returns_count++];
 }
 
+static void* TEST_realloc(void* ptr, size_t size)
+{
+    int i;
+    void* result = real_realloc(ptr, size);
+
+    for (i = 0; i < saved_malloc_returns_count; i++)
+    {
+        if (saved_malloc_returns[i] == ptr)
+        {
+            saved_malloc_returns[i] = result;
+            break;
+        }
+    }
+
+    if (i == saved_malloc_returns_count)
+    {
+        saved_malloc_returns[saved_malloc_returns_count++] = result;
+    }
+
+    return result;
+}
+
 static void TEST_free(void* ptr)
 {
     int i, j;
@@ -57,6 +84,14 @@ static void TEST_free(void* ptr)
     if (i != j) saved_malloc_returns_count--;
 }
 
+static int TEST_mallocAndStrcpy_s(char** destination, const char* source)
+{
+    size_t length = strlen(source);
+    *destination = (char*)TEST_malloc(length + 1);
+    (void)memcpy(*destination, source, length + 1);
+    return 0;
+}
+
 #define ENABLE_MOCKS
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
@@ -95,6 +130,8 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 
 static char g_encoding_buffer[TEST_AMQP_ENCODING_SIZE * 3];
 
+static const unsigned char TEST_MESSAGE_BODY[] = { 'h', 'e', 'l', 'l', 'o' };
+
 #define UUID_N_OF_OCTECTS 16
 #define UUID_STRING_SIZE 37
 
@@ -354,6 +391,58 @@ static void set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message(
     STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
 }
 
+static void set_exp_calls_for_encoded_data_with_cache(void)
+{
+    static const unsigned char* message_body = TEST_MESSAGE_BODY;
+    size_t message_body_size = sizeof(TEST_MESSAGE_BODY);
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(IOTHUBMESSAGE_BYTEARRAY);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &message_body, sizeof(message_body))
+        .CopyOutArgumentBuffer(3, &message_body_size, sizeof(message_body_size));
+}
+
+static void set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message_with_cache(size_t number_of_app_properties, bool is_first_message, bool has_diag_properties)
+{
+    set_exp_calls_for_create_encoded_message_properties(true, true, TEST_CONTENT_TYPE, TEST_CONTENT_ENCODING);
+
+    if (is_first_message)
+    {
+        STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+    }
+    STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &TEST_MAP_KEYS, sizeof(TEST_MAP_KEYS))
+        .CopyOutArgumentBuffer(3, &TEST_MAP_VALUES, sizeof(TEST_MAP_VALUES))
+        .CopyOutArgumentBuffer(4, &number_of_app_properties, sizeof(number_of_app_properties));
+
+    if (is_first_message)
+    {
+        for (size_t i = 0; i < number_of_app_properties; i++)
+        {
+            // Failing to cache a key is not fatal; the key is then encoded in-line.
+            STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MAP_KEYS[i])).CallCannotFail();
+            STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).CallCannotFail();
+        }
+    }
+
+    set_exp_calls_for_create_encoded_annotations_properties(has_diag_properties, false);
+    if (has_diag_properties)
+    {
+        STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    }
+
+    set_exp_calls_for_encoded_data_with_cache();
+
+    if (has_diag_properties)
+    {
+        STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+    }
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+}
+
 static void set_exp_calls_for_message_create_IoTHubMessage_from_uamqp_message(
     size_t number_of_properties,
     bool has_message_id,
@@ -615,6 +704,10 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, TEST_free);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, TEST_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, TEST_mallocAndStrcpy_s);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, 1);
 
     REGISTER_GLOBAL_MOCK_HOOK(properties_get_message_id, test_properties_get_message_id);
     REGISTER_GLOBAL_MOCK_HOOK(properties_get_correlation_id, test_properties_get_correlation_id);
@@ -1061,6 +1154,185 @@ TEST_FUNCTION(message_create_from_iothub_message_STRING_return_errors_fails)
     umock_c_negative_tests_deinit();
 }
 
+TEST_FUNCTION(message_encoding_cache_create_succeeds)
+{
+    // arrange
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    // act
+    MESSAGE_ENCODING_CACHE_HANDLE encoding_cache = message_encoding_cache_create();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(encoding_cache);
+
+    // cleanup
+    message_encoding_cache_destroy(encoding_cache);
+}
+
+TEST_FUNCTION(message_encoding_cache_create_malloc_fails)
+{
+    // arrange
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    // act
+    MESSAGE_ENCODING_CACHE_HANDLE encoding_cache = message_encoding_cache_create();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(encoding_cache);
+}
+
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_with_cache_NULL_cache_fails)
+{
+    // arrange
+    BINARY_DATA binary_data;
+    memset(&binary_data, 0, sizeof(binary_data));
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_create_uamqp_encoding_from_iothub_message_with_cache(NULL, TEST_IOTHUB_MESSAGE_HANDLE, NULL, &binary_data);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_with_cache_succeeds)
+{
+    // arrange
+    MESSAGE_ENCODING_CACHE_HANDLE encoding_cache = message_encoding_cache_create();
+    BINARY_DATA binary_data;
+    memset(&binary_data, 0, sizeof(binary_data));
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message_with_cache(1, true, true);
+
+    // act
+    int result = message_create_uamqp_encoding_from_iothub_message_with_cache(NULL, TEST_IOTHUB_MESSAGE_HANDLE, encoding_cache, &binary_data);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_NOT_NULL(binary_data.bytes);
+    // application-properties (described map32 of 1 pair) followed by the data section (vbin8).
+    ASSERT_ARE_EQUAL(size_t, (size_t)(12 + 2 + strlen(TEST_MAP_KEYS[0]) + 2 + strlen(TEST_MAP_VALUES[0]) + 5 + sizeof(TEST_MESSAGE_BODY)), binary_data.length);
+    ASSERT_ARE_EQUAL(int, 0x00, binary_data.bytes[0]);
+    ASSERT_ARE_EQUAL(int, 0x53, binary_data.bytes[1]);
+    ASSERT_ARE_EQUAL(int, 0x74, binary_data.bytes[2]);
+    ASSERT_ARE_EQUAL(int, 0xd1, binary_data.bytes[3]);
+    ASSERT_ARE_EQUAL(int, 2, binary_data.bytes[11]);
+    ASSERT_ARE_EQUAL(int, 0xa1, binary_data.bytes[12]);
+    ASSERT_ARE_EQUAL(int, (int)strlen(TEST_MAP_KEYS[0]), binary_data.bytes[13]);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(binary_data.bytes + binary_data.length - sizeof(TEST_MESSAGE_BODY), TEST_MESSAGE_BODY, sizeof(TEST_MESSAGE_BODY)));
+
+    // cleanup
+    message_encoding_cache_destroy(encoding_cache);
+}
+
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_with_cache_reuses_cached_keys)
+{
+    // arrange
+    MESSAGE_ENCODING_CACHE_HANDLE encoding_cache = message_encoding_cache_create();
+    BINARY_DATA binary_data;
+    memset(&binary_data, 0, sizeof(binary_data));
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message_with_cache(1, true, false);
+    ASSERT_ARE_EQUAL(int, 0, message_create_uamqp_encoding_from_iothub_message_with_cache(NULL, TEST_IOTHUB_MESSAGE_HANDLE, encoding_cache, &binary_data));
+    size_t first_length = binary_data.length;
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message_with_cache(1, false, false);
+
+    // act
+    int result = message_create_uamqp_encoding_from_iothub_message_with_cache(NULL, TEST_IOTHUB_MESSAGE_HANDLE, encoding_cache, &binary_data);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, first_length, binary_data.length);
+
+    // cleanup
+    message_encoding_cache_destroy(encoding_cache);
+}
+
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_with_cache_key_caching_failure_succeeds)
+{
+    // arrange
+    MESSAGE_ENCODING_CACHE_HANDLE encoding_cache = message_encoding_cache_create();
+    BINARY_DATA binary_data;
+    memset(&binary_data, 0, sizeof(binary_data));
+    size_t number_of_app_properties = 1;
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_create_encoded_message_properties(true, true, TEST_CONTENT_TYPE, TEST_CONTENT_ENCODING);
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &TEST_MAP_KEYS, sizeof(TEST_MAP_KEYS))
+        .CopyOutArgumentBuffer(3, &TEST_MAP_VALUES, sizeof(TEST_MAP_VALUES))
+        .CopyOutArgumentBuffer(4, &number_of_app_properties, sizeof(number_of_app_properties));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MAP_KEYS[0])).SetReturn(1);
+    set_exp_calls_for_create_encoded_annotations_properties(false, false);
+    set_exp_calls_for_encoded_data_with_cache();
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+
+    // act
+    int result = message_create_uamqp_encoding_from_iothub_message_with_cache(NULL, TEST_IOTHUB_MESSAGE_HANDLE, encoding_cache, &binary_data);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, (size_t)(12 + 2 + strlen(TEST_MAP_KEYS[0]) + 2 + strlen(TEST_MAP_VALUES[0]) + 5 + sizeof(TEST_MESSAGE_BODY)), binary_data.length);
+
+    // cleanup
+    message_encoding_cache_destroy(encoding_cache);
+}
+
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_with_cache_negative_tests)
+{
+    // arrange
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message_with_cache(1, true, true);
+    umock_c_negative_tests_snapshot();
+
+    // act
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        if (!umock_c_negative_tests_can_call_fail(i))
+        {
+            continue;
+        }
+
+        // arrange
+        MESSAGE_ENCODING_CACHE_HANDLE encoding_cache = message_encoding_cache_create();
+        BINARY_DATA binary_data;
+        memset(&binary_data, 0, sizeof(binary_data));
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        int result = message_create_uamqp_encoding_from_iothub_message_with_cache(NULL, TEST_IOTHUB_MESSAGE_HANDLE, encoding_cache, &binary_data);
+
+        // assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result, "On failed call %lu", (unsigned long)i);
+        ASSERT_IS_NULL(binary_data.bytes);
+
+        // cleanup
+        message_encoding_cache_destroy(encoding_cache);
+    }
+
+    // cleanup
+    umock_c_negative_tests_reset();
+    umock_c_negative_tests_deinit();
+}
+
 // Tests_SRS_UAMQP_MESSAGING_09_001: [The body type of the uAMQP message shall be retrieved using message_get_body_type().]
 // Tests_SRS_UAMQP_MESSAGING_09_003: [If the uAMQP message body type is MESSAGE_BODY_TYPE_DATA, the body data shall be treated as binary data.]
 // Tests_SRS_UAMQP_MESSAGING_09_004: [The uAMQP message body data shall be retrieved using message_get_body_amqp_data_in_place().]
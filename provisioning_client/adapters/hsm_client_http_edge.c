@@ -13,6 +13,8 @@
 #include "azure_c_shared_utility/socketio.h"
 #include "azure_c_shared_utility/azure_base64.h"
 #include "azure_c_shared_utility/shared_util_options.h"
+#include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/lock.h"
 #include "azure_uhttp_c/uhttp.h"
 
 #include "azure_c_shared_utility/envvariable.h"
@@ -32,6 +34,13 @@ static const char* HSM_EDGE_TRUSTED_CERTIFICATE_JSON_CERTIFICATE = "certificate"
 
 static const int HSM_HTTP_EDGE_MAXIMUM_REQUEST_TIME = 60; // 1 Minute
 
+// Identical signing requests (same token scope and expiry) within this time are answered from the cache.
+static const int HSM_HTTP_EDGE_SIGNATURE_CACHE_LIFETIME = 60; // 1 Minute
+// The trust bundle is requested again after this time, picking up a rotated edge CA.
+static const int HSM_HTTP_EDGE_TRUST_BUNDLE_CACHE_LIFETIME = 300; // 5 Minutes
+
+#define HSM_HTTP_EDGE_SIGNATURE_CACHE_SIZE 4
+
 
 #include "hsm_client_http_edge.h"
 
@@ -46,6 +55,14 @@ static const char* ENVIRONMENT_VAR_WORKLOADURI = "IOTEDGE_WORKLOADURI";
 static const char* ENVIRONMENT_VAR_MODULE_GENERATION_ID = "IOTEDGE_MODULEGENERATIONID";
 static const char* ENVIRONMENT_VAR_EDGEMODULEID = "IOTEDGE_MODULEID";
 
+typedef struct SIGNATURE_CACHE_ENTRY_TAG
+{
+    unsigned char* data;
+    size_t data_len;
+    char* signed_value;
+    time_t signed_time;
+} SIGNATURE_CACHE_ENTRY;
+
 typedef struct HSM_CLIENT_HTTP_EDGE
 {
     WORKLOAD_PROTOCOL_TYPE workload_protocol_type;
@@ -53,6 +70,13 @@ typedef struct HSM_CLIENT_HTTP_EDGE
     int   workload_portnumber;
     char* edge_module_generation_id;
     char* module_id;
+
+    LOCK_HANDLE lock;                               // requests share the workload connection
+    HTTP_CLIENT_HANDLE http_handle;                 // kept open across requests, NULL until the first one
+    HSM_HTTP_WORKLOAD_CONTEXT workload_context;
+    SIGNATURE_CACHE_ENTRY signature_cache[HSM_HTTP_EDGE_SIGNATURE_CACHE_SIZE];
+    char* trust_bundle;
+    time_t trust_bundle_time;
 } HSM_CLIENT_HTTP_EDGE;
 
 static const char http_prefix[] = "http://";
@@ -219,15 +243,58 @@ HSM_CLIENT_HANDLE hsm_client_http_edge_create()
             hsm_client_http_edge_destroy((HSM_CLIENT_HANDLE)result);
             result = NULL;
         }
+        else if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("Failure creating lock.");
+            hsm_client_http_edge_destroy((HSM_CLIENT_HANDLE)result);
+            result = NULL;
+        }
     }
     return (HSM_CLIENT_HANDLE)result;
 }
 
+static void close_workload_connection(HSM_CLIENT_HTTP_EDGE* hsm_client_http_edge)
+{
+    if (hsm_client_http_edge->http_handle != NULL)
+    {
+        uhttp_client_close(hsm_client_http_edge->http_handle, NULL, NULL);
+        uhttp_client_destroy(hsm_client_http_edge->http_handle);
+        hsm_client_http_edge->http_handle = NULL;
+    }
+}
+
+static void clear_signature_cache_entry(SIGNATURE_CACHE_ENTRY* entry)
+{
+    if (entry->data != NULL)
+    {
+        free(entry->data);
+        free(entry->signed_value);
+        entry->data = NULL;
+        entry->data_len = 0;
+        entry->signed_value = NULL;
+    }
+}
+
 void hsm_client_http_edge_destroy(HSM_CLIENT_HANDLE handle)
 {
     if (handle != NULL)
     {
         HSM_CLIENT_HTTP_EDGE* hsm_client_http_edge = (HSM_CLIENT_HTTP_EDGE*)handle;
+        size_t index;
+
+        close_workload_connection(hsm_client_http_edge);
+        for (index = 0; index < HSM_HTTP_EDGE_SIGNATURE_CACHE_SIZE; index++)
+        {
+            clear_signature_cache_entry(&hsm_client_http_edge->signature_cache[index]);
+        }
+        if (hsm_client_http_edge->trust_bundle != NULL)
+        {
+            free(hsm_client_http_edge->trust_bundle);
+        }
+        if (hsm_client_http_edge->lock != NULL)
+        {
+            (void)Lock_Deinit(hsm_client_http_edge->lock);
+        }
         free(hsm_client_http_edge->workload_hostname);
         free(hsm_client_http_edge->edge_module_generation_id);
         free(hsm_client_http_edge->module_id);
@@ -435,40 +502,54 @@ static int send_request_to_edge_workload(HTTP_CLIENT_HANDLE http_handle, HTTP_HE
     return (workload_context->http_response != NULL) ? 0 : MU_FAILURE;
 }
 
-static BUFFER_HANDLE send_http_workload_request(HSM_CLIENT_HTTP_EDGE* hsm_client_http_edge, const char* uri_path, BUFFER_HANDLE json_to_send)
+static int open_workload_connection(HSM_CLIENT_HTTP_EDGE* hsm_client_http_edge)
 {
     int result;
-    HTTP_CLIENT_HANDLE http_handle = NULL;
-    HTTP_HEADERS_HANDLE http_headers_handle = NULL;
-
     HTTP_CLIENT_RESULT http_open_result;
-    HTTP_HEADERS_RESULT http_headers_result;
 
     SOCKETIO_CONFIG config;
     config.accepted_socket = NULL;
     config.hostname = hsm_client_http_edge->workload_hostname;
     config.port = hsm_client_http_edge->workload_portnumber;
 
-    HSM_HTTP_WORKLOAD_CONTEXT workload_context;
-    workload_context.continue_running = true;
-    workload_context.http_response = NULL;
-
-    if ((http_handle = uhttp_client_create(socketio_get_interface_description(), &config, on_edge_hsm_http_error, &workload_context)) == NULL)
+    if ((hsm_client_http_edge->http_handle = uhttp_client_create(socketio_get_interface_description(), &config, on_edge_hsm_http_error, &hsm_client_http_edge->workload_context)) == NULL)
     {
         LogError("uhttp_client_create failed");
         result = MU_FAILURE;
     }
     else if ((hsm_client_http_edge->workload_protocol_type == WORKLOAD_PROTOCOL_TYPE_UNIX_DOMAIN_SOCKET) &&
-             (uhttp_client_set_option(http_handle, OPTION_ADDRESS_TYPE, OPTION_ADDRESS_TYPE_DOMAIN_SOCKET) != HTTP_CLIENT_OK))
+             (uhttp_client_set_option(hsm_client_http_edge->http_handle, OPTION_ADDRESS_TYPE, OPTION_ADDRESS_TYPE_DOMAIN_SOCKET) != HTTP_CLIENT_OK))
     {
         LogError("setting unix domain socket option failed");
         result = MU_FAILURE;
     }
-    else if ((http_open_result = uhttp_client_open(http_handle, hsm_client_http_edge->workload_hostname, hsm_client_http_edge->workload_portnumber, on_edge_hsm_http_connected, &workload_context)) != HTTP_CLIENT_OK)
+    else if ((http_open_result = uhttp_client_open(hsm_client_http_edge->http_handle, hsm_client_http_edge->workload_hostname, hsm_client_http_edge->workload_portnumber, on_edge_hsm_http_connected, &hsm_client_http_edge->workload_context)) != HTTP_CLIENT_OK)
     {
         LogError("uhttp_client_open failed, err=%d", http_open_result);
         result = MU_FAILURE;
     }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static BUFFER_HANDLE execute_http_workload_request(HSM_CLIENT_HTTP_EDGE* hsm_client_http_edge, const char* uri_path, BUFFER_HANDLE json_to_send)
+{
+    int result;
+    HTTP_HEADERS_HANDLE http_headers_handle = NULL;
+    HTTP_HEADERS_RESULT http_headers_result;
+
+    hsm_client_http_edge->workload_context.continue_running = true;
+    hsm_client_http_edge->workload_context.http_response = NULL;
+
+    if ((hsm_client_http_edge->http_handle == NULL) && (open_workload_connection(hsm_client_http_edge) != 0))
+    {
+        LogError("open_workload_connection failed");
+        result = MU_FAILURE;
+    }
     else if ((json_to_send != NULL) && ((http_headers_handle = HTTPHeaders_Alloc()) == NULL))
     {
         LogError("HTTPAPIEX_Create failed");
@@ -479,7 +560,7 @@ static BUFFER_HANDLE send_http_workload_request(HSM_CLIENT_HTTP_EDGE* hsm_client
         LogError("HTTPHeaders_AddHeaderNameValuePair failed, error=%d", http_headers_result);
         result = MU_FAILURE;
     }
-    else if (send_request_to_edge_workload(http_handle, http_headers_handle, uri_path, json_to_send, &workload_context) != 0)
+    else if (send_request_to_edge_workload(hsm_client_http_edge->http_handle, http_headers_handle, uri_path, json_to_send, &hsm_client_http_edge->workload_context) != 0)
     {
         LogError("send_request_to_edge_workload failed");
         result = MU_FAILURE;
@@ -490,16 +571,31 @@ static BUFFER_HANDLE send_http_workload_request(HSM_CLIENT_HTTP_EDGE* hsm_client
     }
 
     HTTPHeaders_Free(http_headers_handle);
-    uhttp_client_close(http_handle, NULL, NULL);
-    uhttp_client_destroy(http_handle);
 
     if (result != 0)
     {
-        BUFFER_delete(workload_context.http_response);
-        workload_context.http_response = NULL;
+        // The state of the connection is unknown after a failed request, the next request opens a new one.
+        close_workload_connection(hsm_client_http_edge);
+        BUFFER_delete(hsm_client_http_edge->workload_context.http_response);
+        hsm_client_http_edge->workload_context.http_response = NULL;
+    }
+
+    return hsm_client_http_edge->workload_context.http_response;
+}
+
+static BUFFER_HANDLE send_http_workload_request(HSM_CLIENT_HTTP_EDGE* hsm_client_http_edge, const char* uri_path, BUFFER_HANDLE json_to_send)
+{
+    bool reused_connection = (hsm_client_http_edge->http_handle != NULL);
+    BUFFER_HANDLE http_response;
+
+    if (((http_response = execute_http_workload_request(hsm_client_http_edge, uri_path, json_to_send)) == NULL) && reused_connection)
+    {
+        // The workload API may have closed the connection while it was idle.
+        LogInfo("Request on the open workload connection failed, retrying on a new connection");
+        http_response = execute_http_workload_request(hsm_client_http_edge, uri_path, json_to_send);
     }
 
-    return workload_context.http_response;
+    return http_response;
 }
 
 
@@ -547,6 +643,72 @@ static int parse_json_signing_response(BUFFER_HANDLE http_response, unsigned cha
     return result;
 }
 
+static int get_cached_signature(HSM_CLIENT_HTTP_EDGE* hsm_client_http_edge, const unsigned char* data, size_t data_len, unsigned char** signed_value, size_t* signed_len)
+{
+    int result = MU_FAILURE;
+    size_t index;
+
+    for (index = 0; index < HSM_HTTP_EDGE_SIGNATURE_CACHE_SIZE; index++)
+    {
+        SIGNATURE_CACHE_ENTRY* entry = &hsm_client_http_edge->signature_cache[index];
+
+        if (entry->data != NULL && entry->data_len == data_len && memcmp(entry->data, data, data_len) == 0)
+        {
+            if (difftime(get_time(NULL), entry->signed_time) >= HSM_HTTP_EDGE_SIGNATURE_CACHE_LIFETIME)
+            {
+                clear_signature_cache_entry(entry);
+            }
+            else if (mallocAndStrcpy_s((char**)signed_value, entry->signed_value) != 0)
+            {
+                LogError("Allocating signed_value failed");
+            }
+            else
+            {
+                *signed_len = strlen(entry->signed_value);
+                result = 0;
+            }
+            break;
+        }
+    }
+
+    return result;
+}
+
+// Replaces a free or the oldest entry. Failing to cache does not fail the signing.
+static void cache_signature(HSM_CLIENT_HTTP_EDGE* hsm_client_http_edge, const unsigned char* data, size_t data_len, const unsigned char* signed_value)
+{
+    SIGNATURE_CACHE_ENTRY* entry = &hsm_client_http_edge->signature_cache[0];
+    size_t index;
+
+    for (index = 1; index < HSM_HTTP_EDGE_SIGNATURE_CACHE_SIZE && entry->data != NULL; index++)
+    {
+        if (hsm_client_http_edge->signature_cache[index].data == NULL ||
+            hsm_client_http_edge->signature_cache[index].signed_time < entry->signed_time)
+        {
+            entry = &hsm_client_http_edge->signature_cache[index];
+        }
+    }
+
+    clear_signature_cache_entry(entry);
+    entry->signed_time = get_time(NULL);
+
+    if ((entry->data = malloc(data_len)) == NULL)
+    {
+        LogError("Allocating cached data failed");
+    }
+    else if (mallocAndStrcpy_s(&entry->signed_value, (const char*)signed_value) != 0)
+    {
+        LogError("Allocating cached signed_value failed");
+        free(entry->data);
+        entry->data = NULL;
+    }
+    else
+    {
+        memcpy(entry->data, data, data_len);
+        entry->data_len = data_len;
+    }
+}
+
 int hsm_client_http_edge_sign_data(HSM_CLIENT_HANDLE handle, const unsigned char* data, size_t data_len, unsigned char** signed_value, size_t* signed_len)
 {
     int result;
@@ -559,11 +721,20 @@ int hsm_client_http_edge_sign_data(HSM_CLIENT_HANDLE handle, const unsigned char
         LogError("Invalid handle value specified handle: %p, data: %p, data_len: %zu, signed_value: %p, signed_len: %p", handle, data, data_len, signed_value, signed_len);
         result = MU_FAILURE;
     }
+    else if (Lock(((HSM_CLIENT_HTTP_EDGE*)handle)->lock) != LOCK_OK)
+    {
+        LogError("Failed locking the http edge handle");
+        result = MU_FAILURE;
+    }
     else
     {
         HSM_CLIENT_HTTP_EDGE* hsm_client_http_edge = (HSM_CLIENT_HTTP_EDGE*)handle;
 
-        if ((uri_path = STRING_construct_sprintf("/modules/%s/genid/%s/sign?api-version=%s", hsm_client_http_edge->module_id, hsm_client_http_edge->edge_module_generation_id, HSM_HTTP_EDGE_VERSION)) == NULL)
+        if (get_cached_signature(hsm_client_http_edge, data, data_len, signed_value, signed_len) == 0)
+        {
+            result = 0;
+        }
+        else if ((uri_path = STRING_construct_sprintf("/modules/%s/genid/%s/sign?api-version=%s", hsm_client_http_edge->module_id, hsm_client_http_edge->edge_module_generation_id, HSM_HTTP_EDGE_VERSION)) == NULL)
         {
             LogError("STRING_construct_sprintf failed");
             result = MU_FAILURE;
@@ -585,8 +756,11 @@ int hsm_client_http_edge_sign_data(HSM_CLIENT_HANDLE handle, const unsigned char
         }
         else
         {
+            cache_signature(hsm_client_http_edge, data, data_len, *signed_value);
             result = 0;
         }
+
+        (void)Unlock(hsm_client_http_edge->lock);
     }
 
     BUFFER_delete(json_to_send);
@@ -645,11 +819,25 @@ char* hsm_client_http_edge_get_trust_bundle(HSM_CLIENT_HANDLE handle)
         LogError("Invalid handle value specified handle: %p", handle);
         trusted_certificates = NULL;
     }
+    else if (Lock(((HSM_CLIENT_HTTP_EDGE*)handle)->lock) != LOCK_OK)
+    {
+        LogError("Failed locking the http edge handle");
+        trusted_certificates = NULL;
+    }
     else
     {
         HSM_CLIENT_HTTP_EDGE* hsm_client_http_edge = (HSM_CLIENT_HTTP_EDGE*)handle;
 
-        if ((uri_path = STRING_construct_sprintf("/trust-bundle?api-version=%s", HSM_HTTP_EDGE_VERSION)) == NULL)
+        if (hsm_client_http_edge->trust_bundle != NULL &&
+            difftime(get_time(NULL), hsm_client_http_edge->trust_bundle_time) < HSM_HTTP_EDGE_TRUST_BUNDLE_CACHE_LIFETIME)
+        {
+            if (mallocAndStrcpy_s(&trusted_certificates, hsm_client_http_edge->trust_bundle) != 0)
+            {
+                LogError("Allocating trusted_certificates failed");
+                trusted_certificates = NULL;
+            }
+        }
+        else if ((uri_path = STRING_construct_sprintf("/trust-bundle?api-version=%s", HSM_HTTP_EDGE_VERSION)) == NULL)
         {
             LogError("STRING_construct_sprintf failed");
             trusted_certificates = NULL;
@@ -663,6 +851,23 @@ char* hsm_client_http_edge_get_trust_bundle(HSM_CLIENT_HANDLE handle)
         {
             LogError("parse_json_certificate_response failed");
         }
+        else
+        {
+            // Failing to cache does not fail the request.
+            if (hsm_client_http_edge->trust_bundle != NULL)
+            {
+                free(hsm_client_http_edge->trust_bundle);
+                hsm_client_http_edge->trust_bundle = NULL;
+            }
+            if (mallocAndStrcpy_s(&hsm_client_http_edge->trust_bundle, trusted_certificates) != 0)
+            {
+                LogError("Allocating cached trust bundle failed");
+                hsm_client_http_edge->trust_bundle = NULL;
+            }
+            hsm_client_http_edge->trust_bundle_time = get_time(NULL);
+        }
+
+        (void)Unlock(hsm_client_http_edge->lock);
     }
 
     STRING_delete(uri_path);
@@ -71,6 +71,7 @@ static void _Bool_ToString(char* string, size_t bufferSize, _Bool val)
 #include "azure_c_shared_utility/envvariable.h"
 #include "azure_c_shared_utility/azure_base64.h"
 #include "azure_c_shared_utility/urlencode.h"
+#include "azure_c_shared_utility/lock.h"
 
 #include "parson.h"
 
@@ -92,6 +93,7 @@ static const char * const TEST_ENV_WORKLOADURI_DOMAIN_SOCKET_NO_NAME = "unix://"
 
 static const unsigned char* TEST_SIGNING_DATA = (const unsigned char* )"Test/Data/To/Sign\nExpiry";
 static const int TEST_SIGNING_DATA_LENGTH = sizeof(TEST_SIGNING_DATA) - 1;
+static const unsigned char* TEST_OTHER_SIGNING_DATA = (const unsigned char* )"Other/Data/To/Sign\nExpiry";
 
 typedef enum TEST_PROTOCOL_TAG
 {
@@ -128,6 +130,7 @@ MOCKABLE_FUNCTION(, void, json_value_free, JSON_Value*, value);
 #define TEST_HTTP_CLIENT_HANDLE (HTTP_CLIENT_HANDLE)0x49
 #define TEST_HTTP_HEADERS_HANDLE (HTTP_HEADERS_HANDLE)0x50
 #define TEST_SOCKETIO_INTERFACE_DESCRIPTION     (const IO_INTERFACE_DESCRIPTION*)0x51
+#define TEST_LOCK_HANDLE (LOCK_HANDLE)0x53
 
 static int my_mallocAndStrcpy_s(char** destination, const char* source)
 {
@@ -277,6 +280,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(HTTP_CLIENT_REQUEST_TYPE, int);
     REGISTER_UMOCK_ALIAS_TYPE(ON_HTTP_REQUEST_CALLBACK, void*);
     REGISTER_UMOCK_ALIAS_TYPE(ON_HTTP_CLOSED_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
 
     REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_close, my_uhttp_client_close);
 
@@ -363,6 +368,13 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_concat, 1);
 
     REGISTER_GLOBAL_MOCK_RETURN(BUFFER_u_char, TEST_BUFFER_1);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Unlock, LOCK_ERROR);
 }
 
 TEST_SUITE_CLEANUP(suite_cleanup)
@@ -390,33 +402,19 @@ TEST_FUNCTION_CLEANUP(method_cleanup)
     ;
 }
 
-static int should_skip_index(size_t current_index, const size_t skip_array[], size_t length)
-{
-    int result = 0;
-    for (size_t index = 0; index < length; index++)
-    {
-        if (current_index == skip_array[index])
-        {
-            result = __LINE__;
-            break;
-        }
-    }
-    return result;
-}
-
-
 static void setup_hsm_client_http_edge_create_http_mock(const char* edge_uri_env, bool valid_edge_uri)
 {
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(environment_get_variable(IGNORED_PTR_ARG)).SetReturn(TEST_ENV_MODULE_GENERATION_ID);
-    STRICT_EXPECTED_CALL(environment_get_variable(IGNORED_PTR_ARG)).SetReturn(TEST_ENV_EDGEMODULEID);
-    STRICT_EXPECTED_CALL(environment_get_variable(IGNORED_PTR_ARG)).SetReturn(edge_uri_env);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(environment_get_variable(IGNORED_PTR_ARG)).SetReturn(TEST_ENV_MODULE_GENERATION_ID).CallCannotFail();
+    STRICT_EXPECTED_CALL(environment_get_variable(IGNORED_PTR_ARG)).SetReturn(TEST_ENV_EDGEMODULEID).CallCannotFail();
+    STRICT_EXPECTED_CALL(environment_get_variable(IGNORED_PTR_ARG)).SetReturn(edge_uri_env).CallCannotFail();
 
     if (valid_edge_uri == true)
     {
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).CallCannotFail();
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)).CallCannotFail();
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)).CallCannotFail();
+        STRICT_EXPECTED_CALL(Lock_Init()).CallCannotFail();
     }
     else
     {
@@ -505,6 +503,7 @@ TEST_FUNCTION(hsm_client_http_edge_destroy_success)
 
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
@@ -545,40 +544,40 @@ static void set_expected_calls_construct_json_signing_blob()
     STRICT_EXPECTED_CALL(STRING_construct_n(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(URL_Encode(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).CallCannotFail();
     STRICT_EXPECTED_CALL(Azure_Base64_Encode_Bytes(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(json_value_init_object());
     STRICT_EXPECTED_CALL(json_value_get_object(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(json_object_set_string(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(json_object_set_string(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).CallCannotFail();
     STRICT_EXPECTED_CALL(json_object_set_string(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(json_serialize_to_string(TEST_JSON_VALUE));
     STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(json_free_serialized_string(TEST_CHAR_PTR));
-    STRICT_EXPECTED_CALL(json_object_clear(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(json_value_free(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(json_free_serialized_string(TEST_CHAR_PTR)).CallCannotFail();
+    STRICT_EXPECTED_CALL(json_object_clear(IGNORED_NUM_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(json_value_free(IGNORED_NUM_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_NUM_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_NUM_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_NUM_ARG)).CallCannotFail();
 }
 
 static void set_expected_calls_send_and_poll_http_signing_request(bool post_data)
 {
-    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_NUM_ARG)).SetReturn(post_data ? (unsigned char*)TEST_STRING_1 : NULL);
-    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).SetReturn(TEST_TIME_T);
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_NUM_ARG)).SetReturn(post_data ? (unsigned char*)TEST_STRING_1 : NULL).CallCannotFail();
+    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).SetReturn(TEST_TIME_T).CallCannotFail();
     STRICT_EXPECTED_CALL(uhttp_client_execute_request(IGNORED_PTR_ARG, post_data ? HTTP_CLIENT_REQUEST_POST : HTTP_CLIENT_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).SetReturn(timed_out ? TEST_TIME_FOR_TIMEOUT_T : TEST_TIME_T);
-    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_NUM_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).SetReturn(timed_out ? TEST_TIME_FOR_TIMEOUT_T : TEST_TIME_T).CallCannotFail();
+    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_NUM_ARG)).CallCannotFail();
     STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).SetReturn(TEST_TIME_T);
+    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).SetReturn(TEST_TIME_T).CallCannotFail();
 }
 
-static void set_expected_calls_send_http_workload_request(bool expect_success, bool post_data, TEST_PROTOCOL testProtocol)
+static void set_expected_calls_open_workload_connection(TEST_PROTOCOL testProtocol)
 {
-    STRICT_EXPECTED_CALL(socketio_get_interface_description());
+    STRICT_EXPECTED_CALL(socketio_get_interface_description()).CallCannotFail();
     STRICT_EXPECTED_CALL(uhttp_client_create(IGNORED_NUM_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     if (testProtocol == TEST_DOMAIN_SOCKET_PROTOCOL)
     {
@@ -586,19 +585,29 @@ static void set_expected_calls_send_http_workload_request(bool expect_success, b
     }
 
     STRICT_EXPECTED_CALL(uhttp_client_open(IGNORED_NUM_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+}
+
+static void set_expected_calls_send_http_workload_request(bool expect_success, bool post_data, TEST_PROTOCOL testProtocol, bool open_connection)
+{
+    if (open_connection)
+    {
+        set_expected_calls_open_workload_connection(testProtocol);
+    }
+
     if (post_data)
     {
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_NUM_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     }
     set_expected_calls_send_and_poll_http_signing_request(post_data);
-    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(uhttp_client_close(IGNORED_NUM_ARG, NULL, NULL));
-    STRICT_EXPECTED_CALL(uhttp_client_destroy(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_NUM_ARG)).CallCannotFail();
 
+    // The connection is kept open for the next request unless this one failed
     if (expect_success == false)
     {
-        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(uhttp_client_close(IGNORED_NUM_ARG, NULL, NULL)).CallCannotFail();
+        STRICT_EXPECTED_CALL(uhttp_client_destroy(IGNORED_NUM_ARG)).CallCannotFail();
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_NUM_ARG)).CallCannotFail();
     }
 }
 
@@ -609,19 +618,59 @@ static void set_expected_calls_parse_json_workload_response()
     STRICT_EXPECTED_CALL(json_value_get_object(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(json_object_dotget_string(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(json_object_clear(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(json_value_free(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(json_object_clear(IGNORED_NUM_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(json_value_free(IGNORED_NUM_ARG)).CallCannotFail();
 }
 
-static void set_expected_calls_hsm_client_http_edge_sign_data(TEST_PROTOCOL testProtocol)
+static void set_expected_calls_cache_signature()
+{
+    // Failing to cache the signature does not fail the signing
+    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)).CallCannotFail();
+}
+
+static void set_expected_calls_request_signature(TEST_PROTOCOL testProtocol, bool open_connection)
 {
     set_expected_calls_construct_json_signing_blob();
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).SetReturn(TEST_STRING_1);
-    set_expected_calls_send_http_workload_request(true, true, testProtocol);
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).SetReturn(TEST_STRING_1).CallCannotFail();
+    set_expected_calls_send_http_workload_request(true, true, testProtocol, open_connection);
     set_expected_calls_parse_json_workload_response();
-    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_NUM_ARG));
+    set_expected_calls_cache_signature();
+}
+
+static void set_expected_calls_sign_data_cleanup()
+{
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE)).CallCannotFail();
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_NUM_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_NUM_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_NUM_ARG)).CallCannotFail();
+}
+
+static void set_expected_calls_hsm_client_http_edge_sign_data(TEST_PROTOCOL testProtocol)
+{
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    set_expected_calls_request_signature(testProtocol, true);
+    set_expected_calls_sign_data_cleanup();
+}
+
+static HSM_CLIENT_HANDLE create_http_edge_with_signature(void)
+{
+    unsigned char* signed_value = NULL;
+    size_t signed_len;
+
+    setup_hsm_client_http_edge_create_http_mock(TEST_ENV_WORKLOADURI_HTTP, true);
+    HSM_CLIENT_HANDLE sec_handle = hsm_client_http_edge_create();
+    ASSERT_IS_NOT_NULL(sec_handle);
+
+    int result = hsm_client_http_edge_sign_data(sec_handle, TEST_SIGNING_DATA, TEST_SIGNING_DATA_LENGTH, &signed_value, &signed_len);
+    ASSERT_ARE_EQUAL(int, result, 0);
+    free(signed_value);
+
+    umock_c_reset_all_calls();
+    g_uhttp_client_dowork_call_count = 0;
+
+    return sec_handle;
 }
 
 TEST_FUNCTION(hsm_client_http_edge_sign_data_succeed)
@@ -725,53 +774,21 @@ TEST_FUNCTION(hsm_client_http_edge_sign_data_http_fail)
     int negativeTestsInitResult = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
 
-    setup_hsm_client_http_edge_create_http_mock(TEST_ENV_WORKLOADURI_HTTP, true);
-
-    HSM_CLIENT_HANDLE sec_handle = hsm_client_http_edge_create();
     unsigned char* signed_value = NULL;
     size_t signed_len;
 
-    ASSERT_IS_NOT_NULL(sec_handle);
-
-    umock_c_reset_all_calls();
-
+    // Every attempt uses a new handle, the previous one may have kept its connection open
+    setup_hsm_client_http_edge_create_http_mock(TEST_ENV_WORKLOADURI_HTTP, true);
     set_expected_calls_hsm_client_http_edge_sign_data(TEST_HTTP_PROTOCOL);
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE)).CallCannotFail();
 
     umock_c_negative_tests_snapshot();
 
-    size_t calls_cannot_fail[] = {
-        3, // STRING_c_str
-        4, // STRING_c_str
-        10, // STRING_c_str
-        14, // json_free_serialized_string
-        15, // json_object_clear
-        16 , // json_value_free
-        17, // STRING_delete
-        18, // STRING_delete
-        19, // STRING_delete
-        20, // STRING_c_str
-        21, // socketio_get_interface_description
-        26, // BUFFER_u_char
-        27, // get_time
-        29, // uhttp_client_dowork
-        30, // get_time
-        31, // uhttp_client_dowork
-        33, // get_time
-        34, // HTTPHeaders_Free
-        35, // uhttp_client_close
-        36, // uhttp_client_destroy
-        42, // json_object_clear
-        43, // json_value_free
-        44, // BUFFER_delete
-        45, // BUFFER_delete
-        46 // STRING_delete
-    };
-
     // act
     size_t count = umock_c_negative_tests_call_count();
     for (size_t index = 0; index < count; index++)
     {
-        if (should_skip_index(index, calls_cannot_fail, sizeof(calls_cannot_fail)/sizeof(calls_cannot_fail[0])) != 0)
+        if (!umock_c_negative_tests_can_call_fail(index))
         {
             continue;
         }
@@ -780,26 +797,170 @@ TEST_FUNCTION(hsm_client_http_edge_sign_data_http_fail)
         umock_c_negative_tests_reset();
         umock_c_negative_tests_fail_call(index);
 
+        HSM_CLIENT_HANDLE sec_handle = hsm_client_http_edge_create();
+        ASSERT_IS_NOT_NULL(sec_handle);
+
         char tmp_msg[128];
         sprintf(tmp_msg, "hsm_client_http_edge_sign_data failure in test %zu/%zu", index, count);
         int result = hsm_client_http_edge_sign_data(sec_handle, TEST_SIGNING_DATA, TEST_SIGNING_DATA_LENGTH, &signed_value, &signed_len);
         ASSERT_ARE_NOT_EQUAL(int, result, 0, tmp_msg);
+
+        hsm_client_http_edge_destroy(sec_handle);
     }
 
     // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+TEST_FUNCTION(hsm_client_http_edge_sign_data_same_data_uses_cached_signature)
+{
+    HSM_CLIENT_HANDLE sec_handle = create_http_edge_with_signature();
+    unsigned char* signed_value = NULL;
+    size_t signed_len;
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    set_expected_calls_sign_data_cleanup();
+
+    int result = hsm_client_http_edge_sign_data(sec_handle, TEST_SIGNING_DATA, TEST_SIGNING_DATA_LENGTH, &signed_value, &signed_len);
+    ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_CONST_CHAR_PTR, (const char*)signed_value);
+    ASSERT_ARE_EQUAL(size_t, strlen(TEST_CONST_CHAR_PTR), signed_len);
 
     hsm_client_http_edge_destroy(sec_handle);
-    umock_c_negative_tests_deinit();
+    free(signed_value);
 }
 
+TEST_FUNCTION(hsm_client_http_edge_sign_data_expired_signature_is_requested_again)
+{
+    HSM_CLIENT_HANDLE sec_handle = create_http_edge_with_signature();
+    unsigned char* signed_value = NULL;
+    size_t signed_len;
 
-static void set_expected_calls_hsm_client_http_edge_get_trust_bundle(TEST_PROTOCOL testProtocol)
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).SetReturn(TEST_TIME_T + 60);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    set_expected_calls_request_signature(TEST_HTTP_PROTOCOL, false);
+    set_expected_calls_sign_data_cleanup();
+
+    int result = hsm_client_http_edge_sign_data(sec_handle, TEST_SIGNING_DATA, TEST_SIGNING_DATA_LENGTH, &signed_value, &signed_len);
+    ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    hsm_client_http_edge_destroy(sec_handle);
+    free(signed_value);
+}
+
+TEST_FUNCTION(hsm_client_http_edge_sign_data_reuses_connection)
 {
+    HSM_CLIENT_HANDLE sec_handle = create_http_edge_with_signature();
+    unsigned char* signed_value = NULL;
+    size_t signed_len;
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    set_expected_calls_request_signature(TEST_HTTP_PROTOCOL, false);
+    set_expected_calls_sign_data_cleanup();
+
+    int result = hsm_client_http_edge_sign_data(sec_handle, TEST_OTHER_SIGNING_DATA, TEST_SIGNING_DATA_LENGTH, &signed_value, &signed_len);
+    ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    hsm_client_http_edge_destroy(sec_handle);
+    free(signed_value);
+}
+
+TEST_FUNCTION(hsm_client_http_edge_sign_data_retries_when_reused_connection_fails)
+{
+    HSM_CLIENT_HANDLE sec_handle = create_http_edge_with_signature();
+    unsigned char* signed_value = NULL;
+    size_t signed_len;
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    set_expected_calls_construct_json_signing_blob();
     STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).SetReturn(TEST_STRING_1);
-    set_expected_calls_send_http_workload_request(true, false, testProtocol);
-    set_expected_calls_parse_json_workload_response();
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_NUM_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_NUM_ARG)).SetReturn((unsigned char*)TEST_STRING_1);
+    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(uhttp_client_execute_request(IGNORED_PTR_ARG, HTTP_CLIENT_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn(HTTP_CLIENT_ERROR);
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(uhttp_client_close(IGNORED_NUM_ARG, NULL, NULL));
+    STRICT_EXPECTED_CALL(uhttp_client_destroy(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_NUM_ARG));
+    set_expected_calls_send_http_workload_request(true, true, TEST_HTTP_PROTOCOL, true);
+    set_expected_calls_parse_json_workload_response();
+    set_expected_calls_cache_signature();
+    set_expected_calls_sign_data_cleanup();
+
+    int result = hsm_client_http_edge_sign_data(sec_handle, TEST_OTHER_SIGNING_DATA, TEST_SIGNING_DATA_LENGTH, &signed_value, &signed_len);
+    ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    hsm_client_http_edge_destroy(sec_handle);
+    free(signed_value);
+}
+
+TEST_FUNCTION(hsm_client_http_edge_destroy_closes_connection)
+{
+    HSM_CLIENT_HANDLE sec_handle = create_http_edge_with_signature();
+
+    STRICT_EXPECTED_CALL(uhttp_client_close(IGNORED_NUM_ARG, NULL, NULL));
+    STRICT_EXPECTED_CALL(uhttp_client_destroy(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    hsm_client_http_edge_destroy(sec_handle);
+
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+
+static void set_expected_calls_request_trust_bundle(TEST_PROTOCOL testProtocol, bool open_connection)
+{
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).SetReturn(TEST_STRING_1).CallCannotFail();
+    set_expected_calls_send_http_workload_request(true, false, testProtocol, open_connection);
+    set_expected_calls_parse_json_workload_response();
+    // Failing to cache the trust bundle does not fail the request
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).CallCannotFail();
+}
+
+static void set_expected_calls_get_trust_bundle_cleanup()
+{
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE)).CallCannotFail();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_NUM_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_NUM_ARG)).CallCannotFail();
+}
+
+static void set_expected_calls_hsm_client_http_edge_get_trust_bundle(TEST_PROTOCOL testProtocol)
+{
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    set_expected_calls_request_trust_bundle(testProtocol, true);
+    set_expected_calls_get_trust_bundle_cleanup();
+}
+
+static HSM_CLIENT_HANDLE create_http_edge_with_trust_bundle(void)
+{
+    setup_hsm_client_http_edge_create_http_mock(TEST_ENV_WORKLOADURI_HTTP, true);
+    HSM_CLIENT_HANDLE sec_handle = hsm_client_http_edge_create();
+    ASSERT_IS_NOT_NULL(sec_handle);
+
+    char* trusted_certificate = hsm_client_http_edge_get_trust_bundle(sec_handle);
+    ASSERT_IS_NOT_NULL(trusted_certificate);
+    free(trusted_certificate);
+
+    umock_c_reset_all_calls();
+    g_uhttp_client_dowork_call_count = 0;
+
+    return sec_handle;
 }
 
 TEST_FUNCTION(hsm_client_http_edge_get_trust_bundle_success)
@@ -864,41 +1025,18 @@ TEST_FUNCTION(hsm_client_http_edge_get_trust_bundle_fail)
     int negativeTestsInitResult = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
 
+    // Every attempt uses a new handle, the previous one may have kept its connection open
     setup_hsm_client_http_edge_create_http_mock(TEST_ENV_WORKLOADURI_HTTP, true);
-
-    HSM_CLIENT_HANDLE sec_handle = hsm_client_http_edge_create();
-
-    ASSERT_IS_NOT_NULL(sec_handle);
-
-    umock_c_reset_all_calls();
-
     set_expected_calls_hsm_client_http_edge_get_trust_bundle(TEST_HTTP_PROTOCOL);
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE)).CallCannotFail();
 
     umock_c_negative_tests_snapshot();
 
-    size_t calls_cannot_fail[] = {
-        0, // STRING_c_str
-        1, // socketio_get_interface_description
-        4, // BUFFER_u_char
-        5, // get_time
-        7, // uhttp_client_dowork
-        8, // get_time
-        9, // uhttp_client_dowork
-        11, // get_time
-        12, // HTTPHeaders_Free
-        14, // uhttp_client_destroy
-        13, // uhttp_client_close
-        20, // json_object_clear
-        21, // json_value_free
-        22, // BUFFER_delete
-        23 // BUFFER_delete
-    };
-
     // act
     size_t count = umock_c_negative_tests_call_count();
     for (size_t index = 0; index < count; index++)
     {
-        if (should_skip_index(index, calls_cannot_fail, sizeof(calls_cannot_fail)/sizeof(calls_cannot_fail[0])) != 0)
+        if (!umock_c_negative_tests_can_call_fail(index))
         {
             continue;
         }
@@ -907,17 +1045,58 @@ TEST_FUNCTION(hsm_client_http_edge_get_trust_bundle_fail)
         umock_c_negative_tests_reset();
         umock_c_negative_tests_fail_call(index);
 
+        HSM_CLIENT_HANDLE sec_handle = hsm_client_http_edge_create();
+        ASSERT_IS_NOT_NULL(sec_handle);
+
         char tmp_msg[128];
         sprintf(tmp_msg, "hsm_client_http_edge_get_trust_bundle failure in test %zu/%zu", index, count);
         const char* trusted_certificate = hsm_client_http_edge_get_trust_bundle(sec_handle);
         ASSERT_IS_NULL(trusted_certificate, tmp_msg);
+
+        hsm_client_http_edge_destroy(sec_handle);
     }
 
     // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+TEST_FUNCTION(hsm_client_http_edge_get_trust_bundle_uses_cached_trust_bundle)
+{
+    HSM_CLIENT_HANDLE sec_handle = create_http_edge_with_trust_bundle();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    set_expected_calls_get_trust_bundle_cleanup();
+
+    char* trusted_certificate = hsm_client_http_edge_get_trust_bundle(sec_handle);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_CONST_CHAR_PTR, trusted_certificate);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     hsm_client_http_edge_destroy(sec_handle);
-    umock_c_negative_tests_deinit();
+    free(trusted_certificate);
+}
+
+TEST_FUNCTION(hsm_client_http_edge_get_trust_bundle_expired_trust_bundle_is_requested_again)
+{
+    HSM_CLIENT_HANDLE sec_handle = create_http_edge_with_trust_bundle();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).SetReturn(TEST_TIME_T + 300);
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).SetReturn(TEST_STRING_1);
+    set_expected_calls_send_http_workload_request(true, false, TEST_HTTP_PROTOCOL, false);
+    set_expected_calls_parse_json_workload_response();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG));
+    set_expected_calls_get_trust_bundle_cleanup();
 
+    char* trusted_certificate = hsm_client_http_edge_get_trust_bundle(sec_handle);
+    ASSERT_IS_NOT_NULL(trusted_certificate);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    hsm_client_http_edge_destroy(sec_handle);
+    free(trusted_certificate);
 }
 
 